@@ -0,0 +1,182 @@
+// Measures the time from selected instructions to an object file on disk,
+// through the assembly writer and the GNU assembler, and through the
+// encoder and the ELF writer in process. The C functions are lowered,
+// optimized and selected once, then written out again and again. For each
+// workload it prints the size of the object and the time per iteration of
+// both paths, the first one split into writing the assembly and running
+// the assembler.
+//
+// Usage: object-emission-bench [iterations] [assembler]
+//
+// The assembler defaults to "as".
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tplcc/assembly-writer.h"
+#include "tplcc/ast.h"
+#include "tplcc/buffered-writer.h"
+#include "tplcc/cfg-simplification.h"
+#include "tplcc/code-generation.h"
+#include "tplcc/constant-propagation.h"
+#include "tplcc/dead-code-elimination.h"
+#include "tplcc/global-value-numbering.h"
+#include "tplcc/ir.h"
+#include "tplcc/lowering.h"
+#include "tplcc/object-writer.h"
+#include "tplcc/parser.h"
+#include "tplcc/sema.h"
+#include "tplcc/string-interner.h"
+#include "tplcc/string-scanner.h"
+
+namespace {
+struct IgnoreErrors : IReportError {
+  std::size_t count = 0;
+  void reportsError(Error) override { count++; }
+};
+
+struct Workload {
+  const char* name;
+  std::string source;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Many small functions with branches, loads and stores, the common case.
+std::string smallFunctions(int functions) {
+  std::string source = "int table[256];\nconst char *names[4];\n";
+  for (int f = 0; f < functions; f++) {
+    const auto n = std::to_string(f);
+    source += "int lookup_" + n +
+              "(int key, int fallback) {\n"
+              "  if (key < 0 || key >= 256) return fallback;\n"
+              "  int v = table[key];\n"
+              "  if (v == 0) { table[key] = key * " + n +
+              " + 1; return fallback; }\n"
+              "  return v + (names[key & 3] != 0);\n}\n";
+  }
+  return source;
+}
+
+// Long functions, loop nests with many jumps, some of them long.
+std::string longFunctions(int functions) {
+  std::string source;
+  for (int f = 0; f < functions; f++) {
+    source += "unsigned mix_" + std::to_string(f) +
+              "(unsigned *s, int n) {\n"
+              "  unsigned a = 1, b = 2, c = 3, d = 4;\n"
+              "  for (int i = 0; i < n; i++) {\n";
+    for (int i = 0; i < 24; i++) {
+      const auto k = std::to_string(i);
+      source += "    if ((a ^ " + k + ") & 1) a += b * " + k +
+                "; else b ^= a >> 3;\n"
+                "    c = (c << 5 | c >> 27) + s[(i + " + k +
+                ") & 15]; d -= c / (a | 1);\n";
+    }
+    source += "  }\n  return a ^ b ^ c ^ d;\n}\n";
+  }
+  return source;
+}
+
+void run(const Workload& workload, int iterations, const std::string& as) {
+  IgnoreErrors errOut;
+  AST ast;
+  StringInterner strings;
+  TypeTable types;
+  Module module;
+  StringScanner scanner(workload.source);
+  Lexer lexer(scanner, errOut);
+  Parser parser(lexer, ast, strings, errOut);
+  const auto translationUnit = parser.parseTranslationUnit();
+  Sema sema(ast, strings, types, errOut);
+  sema.check();
+  Lowering(ast, strings, sema, module, errOut).lower(translationUnit);
+  std::vector<MachineFunction> functions;
+  std::size_t instructions = 0;
+  for (auto& function : module.functions) {
+    propagateConstants(function);
+    eliminateDeadCode(function);
+    simplifyControlFlow(function);
+    numberGlobalValues(function);
+    eliminateDeadCode(function);
+    functions.push_back(generateCode(function, module));
+    instructions += functions.back().code.size();
+  }
+
+  const auto directory = std::filesystem::temp_directory_path();
+  const auto assemblyPath = (directory / "object-emission-bench.s").string();
+  const auto assembledPath =
+      (directory / "object-emission-bench-as.o").string();
+  const auto objectPath = (directory / "object-emission-bench.o").string();
+  const auto command = as + " -o \"" + assembledPath + "\" \"" + assemblyPath +
+                       "\"";
+
+  double writing = 0, assembling = 0, direct = 0;
+  for (int i = 0; i < iterations; i++) {
+    auto start = Clock::now();
+    {
+      std::ofstream file(assemblyPath, std::ios::binary);
+      BufferedWriter out(file, 1 << 20);
+      writeAssembly(module, functions, out);
+    }
+    writing += millisecondsSince(start);
+
+    start = Clock::now();
+    if (std::system(command.c_str()) != 0) {
+      std::cerr << "The assembler failed: " << command << "\n";
+      return;
+    }
+    assembling += millisecondsSince(start);
+
+    start = Clock::now();
+    {
+      std::ofstream file(objectPath, std::ios::binary);
+      BufferedWriter out(file, 1 << 20);
+      writeObject(module, functions, out);
+    }
+    direct += millisecondsSince(start);
+  }
+
+  const auto assemblySize = std::filesystem::file_size(assemblyPath);
+  const auto objectSize = std::filesystem::file_size(objectPath);
+  std::filesystem::remove(assemblyPath);
+  std::filesystem::remove(assembledPath);
+  std::filesystem::remove(objectPath);
+
+  std::cout << std::left << std::setw(8) << workload.name << std::right
+            << std::setw(8) << instructions << " insts" << std::setw(9)
+            << assemblySize / 1024 << " KiB .s" << std::setw(7)
+            << objectSize / 1024 << " KiB .o" << std::fixed
+            << std::setprecision(2) << "  assembly " << std::setw(8)
+            << (writing + assembling) / iterations << " ms (write "
+            << writing / iterations << ", as " << assembling / iterations
+            << ")  direct " << std::setw(7) << direct / iterations
+            << " ms  " << std::setprecision(1)
+            << (writing + assembling) / direct << "x";
+  if (errOut.count != 0) std::cout << "  (" << errOut.count << " errors!)";
+  std::cout << "\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 10;
+  const std::string as = argc > 2 ? argv[2] : "as";
+
+  const std::vector<Workload> workloads{
+      {"small", smallFunctions(2000)},
+      {"long", longFunctions(100)},
+  };
+  for (const auto& workload : workloads) run(workload, iterations, as);
+  return 0;
+}
@@ -0,0 +1,140 @@
+// Measures the backend of one big translation unit on thread pools of
+// different sizes: the IR passes, register allocation, instruction
+// selection and encoding into an object file, function by function on the
+// pool's threads. The front end runs once, on one thread, outside the
+// measured time. For every number of threads it prints the time per
+// iteration, the speedup over one thread, and whether the object is the
+// same as the one thread's.
+//
+// Usage: parallel-codegen-bench [iterations] [max threads]
+//
+// The threads go up in powers of 2 to the number of hardware threads.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tplcc/ast.h"
+#include "tplcc/buffered-writer.h"
+#include "tplcc/cfg-simplification.h"
+#include "tplcc/code-generation.h"
+#include "tplcc/constant-propagation.h"
+#include "tplcc/dead-code-elimination.h"
+#include "tplcc/global-value-numbering.h"
+#include "tplcc/ir.h"
+#include "tplcc/lowering.h"
+#include "tplcc/object-writer.h"
+#include "tplcc/parser.h"
+#include "tplcc/sema.h"
+#include "tplcc/string-interner.h"
+#include "tplcc/string-scanner.h"
+#include "tplcc/thread-pool.h"
+
+namespace {
+struct IgnoreErrors : IReportError {
+  std::size_t count = 0;
+  void reportsError(Error) override { count++; }
+};
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Thousands of functions of different sizes, like an amalgamation.
+std::string amalgamation(int functions) {
+  std::string source = "int table[256];\n";
+  for (int f = 0; f < functions; f++) {
+    const auto n = std::to_string(f);
+    source += "unsigned f" + n +
+              "(unsigned *s, int n) {\n"
+              "  unsigned a = " + n + ", b = 2;\n"
+              "  for (int i = 0; i < n; i++) {\n";
+    for (int i = 0; i < 1 + f % 12; i++) {
+      const auto k = std::to_string(i);
+      source += "    if ((a ^ " + k + ") & 1) a += b * " + k +
+                "; else b ^= a >> 3;\n"
+                "    table[(a + " + k + ") & 255] = s[i & 15] + b;\n";
+    }
+    source += "  }\n  return a ^ b;\n}\n";
+  }
+  return source;
+}
+
+// Changes the module, every iteration gets a copy of the lowered one.
+std::string compileAndWrite(Module& module, ThreadPool* pool) {
+  std::vector<MachineFunction> functions(module.functions.size());
+  parallelFor(pool, functions.size(), [&](std::size_t i) {
+    auto& function = module.functions[i];
+    propagateConstants(function);
+    eliminateDeadCode(function);
+    simplifyControlFlow(function);
+    numberGlobalValues(function);
+    eliminateDeadCode(function);
+    functions[i] = generateCode(function, module);
+  });
+  std::ostringstream os;
+  {
+    BufferedWriter out(os, 1 << 20);
+    writeObject(module, functions, out, pool);
+  }
+  return os.str();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 5;
+  const unsigned maxThreads =
+      argc > 2 ? static_cast<unsigned>(std::atoi(argv[2]))
+               : std::max(1u, std::thread::hardware_concurrency());
+
+  IgnoreErrors errOut;
+  AST ast;
+  StringInterner strings;
+  TypeTable types;
+  Module module;
+  const auto source = amalgamation(3000);
+  StringScanner scanner(source);
+  Lexer lexer(scanner, errOut);
+  Parser parser(lexer, ast, strings, errOut);
+  const auto translationUnit = parser.parseTranslationUnit();
+  Sema sema(ast, strings, types, errOut);
+  sema.check();
+  Lowering(ast, strings, sema, module, errOut).lower(translationUnit);
+  if (errOut.count != 0) {
+    std::cerr << errOut.count << " errors in the workload\n";
+    return 1;
+  }
+
+  std::cout << module.functions.size() << " functions\n";
+  std::string serialObject;
+  double serial = 0;
+  for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+    // The thread running the bench is one of them.
+    ThreadPool pool(threads - 1);
+    ThreadPool* const parallel = threads > 1 ? &pool : nullptr;
+    std::vector<Module> copies(iterations, module);
+    std::string object;
+    const auto start = Clock::now();
+    for (auto& copy : copies) object = compileAndWrite(copy, parallel);
+    const auto time = millisecondsSince(start) / iterations;
+    if (threads == 1) {
+      serial = time;
+      serialObject = object;
+    }
+    std::cout << std::setw(3) << threads << " threads " << std::fixed
+              << std::setprecision(2) << std::setw(9) << time << " ms  "
+              << std::setprecision(1) << serial / time << "x"
+              << (object == serialObject ? "" : "  (different object!)")
+              << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,148 @@
+// Measures the parser on expression-dense code: cryptographic rounds, DSP
+// filter kernels and deeply nested arithmetic. For each workload it prints
+// the throughput and how many expression parsing calls the parser makes per
+// primary expression, which should stay the same whatever the shape of the
+// expressions is.
+//
+// Usage: parser-bench [iterations]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tplcc/ast.h"
+#include "tplcc/parser.h"
+#include "tplcc/string-interner.h"
+#include "tplcc/string-scanner.h"
+
+namespace {
+struct IgnoreErrors : IReportError {
+  std::size_t count = 0;
+  void reportsError(Error) override { count++; }
+};
+
+struct Workload {
+  const char* name;
+  std::string source;
+};
+
+// SHA-256 compression rounds with the rotations written out.
+std::string sha256Rounds(int functions) {
+  std::string source;
+  for (int f = 0; f < functions; f++) {
+    source += "void sha256_" + std::to_string(f) +
+              "(unsigned *s, const unsigned *w, const unsigned *k) {\n"
+              "  unsigned a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], "
+              "f = s[5], g = s[6], h = s[7], t1, t2;\n";
+    for (int i = 0; i < 64; i++) {
+      const auto index = std::to_string(i);
+      source +=
+          "  t1 = h + ((e >> 6 | e << 26) ^ (e >> 11 | e << 21) ^ (e >> 25 | e "
+          "<< 7)) + ((e & f) ^ (~e & g)) + k[" + index + "] + w[" + index +
+          "];\n"
+          "  t2 = ((a >> 2 | a << 30) ^ (a >> 13 | a << 19) ^ (a >> 22 | a << "
+          "10)) + ((a & b) ^ (a & c) ^ (b & c));\n"
+          "  h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + "
+          "t2;\n";
+    }
+    source += "  s[0] += a; s[1] += b; s[2] += c; s[3] += d;\n"
+              "  s[4] += e; s[5] += f; s[6] += g; s[7] += h;\n}\n";
+  }
+  return source;
+}
+
+// Unrolled FIR filters and biquad sections, long flat sums of products.
+std::string dspKernels(int functions) {
+  std::string source;
+  for (int f = 0; f < functions; f++) {
+    source += "void fir_" + std::to_string(f) +
+              "(const float *x, const float *c, float *y, int n) {\n"
+              "  for (int i = 31; i < n; i++) {\n    y[i] = ";
+    for (int tap = 0; tap < 32; tap++) {
+      if (tap > 0) source += "\n      + ";
+      source += "x[i - " + std::to_string(tap) + "] * c[" +
+                std::to_string(tap) + "]";
+    }
+    source += ";\n  }\n}\n";
+
+    source += "void biquad_" + std::to_string(f) +
+              "(const float *x, float *y, const float *b, const float *a, "
+              "float *z, int n) {\n"
+              "  for (int i = 0; i < n; i++) {\n"
+              "    float out = b[0] * x[i] + z[0];\n"
+              "    z[0] = b[1] * x[i] - a[1] * out + z[1];\n"
+              "    z[1] = b[2] * x[i] - a[2] * out;\n"
+              "    y[i] = out > 1.0f ? 1.0f : out < -1.0f ? -1.0f : out;\n"
+              "  }\n}\n";
+  }
+  return source;
+}
+
+// Expressions nested by parentheses and mixing every precedence level.
+std::string nestedExpressions(int functions) {
+  std::string source;
+  for (int f = 0; f < functions; f++) {
+    source += "int nested_" + std::to_string(f) +
+              "(int a, int b, int c, int d) {\n  return ";
+    for (int depth = 0; depth < 32; depth++) source += "(a + ";
+    source += "b";
+    for (int depth = 0; depth < 32; depth++) source += ") * c";
+    source += ";\n}\n";
+
+    source += "int mixed_" + std::to_string(f) +
+              "(int a, int b, int c, int d) {\n"
+              "  return a || b && c | d ^ a & b == c < d << a + b * c "
+              "|| a * b + c << d < a == b & c ^ d | a && b;\n}\n";
+  }
+  return source;
+}
+
+void run(const Workload& workload, int iterations) {
+  AST ast;
+  StringInterner strings;
+  Parser::Statistics stats;
+  std::size_t errors = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    IgnoreErrors errOut;
+    StringScanner scanner(workload.source);
+    Lexer lexer(scanner, errOut);
+    Parser parser(lexer, ast, strings, errOut);
+    parser.parseTranslationUnit();
+    stats = parser.stats();
+    errors += errOut.count;
+    ast.reset();
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  const double megabytes =
+      static_cast<double>(workload.source.size()) * iterations / 1e6;
+  std::cout << std::left << std::setw(10) << workload.name << std::right
+            << std::setw(10) << workload.source.size() << " bytes"
+            << std::setw(10) << stats.primaryExpressions << " primaries"
+            << std::fixed << std::setprecision(2) << std::setw(8)
+            << static_cast<double>(stats.expressionCalls) /
+                   static_cast<double>(stats.primaryExpressions)
+            << " calls/primary" << std::setw(10) << megabytes / elapsed.count()
+            << " MB/s";
+  if (errors != 0) std::cout << "  (" << errors << " errors!)";
+  std::cout << "\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+
+  const std::vector<Workload> workloads{
+      {"sha256", sha256Rounds(8)},
+      {"dsp", dspKernels(64)},
+      {"nested", nestedExpressions(64)},
+  };
+  for (const auto& workload : workloads) run(workload, iterations);
+  return 0;
+}
@@ -0,0 +1,187 @@
+// Measures the register allocator on C functions with different kinds of
+// register pressure: long straight-line rounds with many values live at
+// once, loops nested in loops, and calls with values live across them. The
+// functions are lowered and optimized once, then allocated again and again.
+// For each workload it prints the time per 1000 instructions and how many
+// of the intervals got split and spilled.
+//
+// Usage: register-allocation-bench [iterations]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tplcc/ast.h"
+#include "tplcc/cfg-simplification.h"
+#include "tplcc/constant-propagation.h"
+#include "tplcc/dead-code-elimination.h"
+#include "tplcc/global-value-numbering.h"
+#include "tplcc/ir.h"
+#include "tplcc/lowering.h"
+#include "tplcc/parser.h"
+#include "tplcc/register-allocation.h"
+#include "tplcc/sema.h"
+#include "tplcc/string-interner.h"
+#include "tplcc/string-scanner.h"
+
+namespace {
+struct IgnoreErrors : IReportError {
+  std::size_t count = 0;
+  void reportsError(Error) override { count++; }
+};
+
+struct Workload {
+  const char* name;
+  std::string source;
+};
+
+// SHA-256 compression rounds, the eight working variables and the
+// temporaries of a round are live at once.
+std::string sha256Rounds(int functions) {
+  std::string source;
+  for (int f = 0; f < functions; f++) {
+    source += "void sha256_" + std::to_string(f) +
+              "(unsigned *s, const unsigned *w, const unsigned *k) {\n"
+              "  unsigned a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], "
+              "f = s[5], g = s[6], h = s[7], t1, t2;\n"
+              "  for (int i = 0; i < 64; i += 4) {\n";
+    for (int i = 0; i < 4; i++) {
+      const auto index = "i + " + std::to_string(i);
+      source +=
+          "    t1 = h + ((e >> 6 | e << 26) ^ (e >> 11 | e << 21) ^ (e >> 25 | "
+          "e << 7)) + ((e & f) ^ (~e & g)) + k[" + index + "] + w[" + index +
+          "];\n"
+          "    t2 = ((a >> 2 | a << 30) ^ (a >> 13 | a << 19) ^ (a >> 22 | a "
+          "<< 10)) + ((a & b) ^ (a & c) ^ (b & c));\n"
+          "    h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + "
+          "t2;\n";
+    }
+    source += "  }\n"
+              "  s[0] += a; s[1] += b; s[2] += c; s[3] += d;\n"
+              "  s[4] += e; s[5] += f; s[6] += g; s[7] += h;\n}\n";
+  }
+  return source;
+}
+
+// Matrix products and a sort, loop nests with induction variables and
+// bounds live across the inner loops, and divisions.
+std::string loopNests(int functions) {
+  std::string source;
+  for (int f = 0; f < functions; f++) {
+    source += "void matmul_" + std::to_string(f) +
+              "(const int *a, const int *b, int *c, int n, int m, int p) {\n"
+              "  for (int i = 0; i < n; i++)\n"
+              "    for (int j = 0; j < p; j++) {\n"
+              "      int sum = 0;\n"
+              "      for (int k = 0; k < m; k++) sum += a[i * m + k] * b[k * "
+              "p + j];\n"
+              "      c[i * p + j] = sum / (n + 1) + sum % (p + 1);\n"
+              "    }\n}\n";
+    source += "void sort_" + std::to_string(f) +
+              "(int *x, int n) {\n"
+              "  for (int gap = n / 2; gap > 0; gap /= 2)\n"
+              "    for (int i = gap; i < n; i++) {\n"
+              "      int v = x[i], j = i;\n"
+              "      while (j >= gap && x[j - gap] > v) {\n"
+              "        x[j] = x[j - gap];\n"
+              "        j -= gap;\n"
+              "      }\n"
+              "      x[j] = v;\n"
+              "    }\n}\n";
+  }
+  return source;
+}
+
+// Calls with several arguments and values that have to survive them.
+std::string calls(int functions) {
+  std::string source =
+      "long mix(long a, long b, long c, long d, long e, long f, long g);\n";
+  for (int f = 0; f < functions; f++) {
+    source += "long chain_" + std::to_string(f) +
+              "(long a, long b, long c, long d, long e, long f) {\n"
+              "  long x = mix(a, b, c, d, e, f, a + b);\n";
+    for (int i = 0; i < 16; i++) {
+      source += "  x = mix(x, a + " + std::to_string(i) +
+                ", b, c * x, d, e ^ x, f - x) + a * b - c;\n";
+    }
+    source += "  return x + a + b + c + d + e + f;\n}\n";
+  }
+  return source;
+}
+
+void run(const Workload& workload, int iterations, bool optimize) {
+  IgnoreErrors errOut;
+  AST ast;
+  StringInterner strings;
+  TypeTable types;
+  Module module;
+  StringScanner scanner(workload.source);
+  Lexer lexer(scanner, errOut);
+  Parser parser(lexer, ast, strings, errOut);
+  const auto translationUnit = parser.parseTranslationUnit();
+  Sema sema(ast, strings, types, errOut);
+  sema.check();
+  Lowering(ast, strings, sema, module, errOut).lower(translationUnit);
+  for (auto& function : module.functions) {
+    if (!optimize) continue;
+    propagateConstants(function);
+    eliminateDeadCode(function);
+    simplifyControlFlow(function);
+    numberGlobalValues(function);
+    eliminateDeadCode(function);
+  }
+
+  RegisterAllocation::Statistics total;
+  std::size_t slots = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    total = {};
+    slots = 0;
+    for (auto& function : module.functions) {
+      const RegisterAllocation allocation(function);
+      const auto& stats = allocation.statistics();
+      total.instructions += stats.instructions;
+      total.intervals += stats.intervals;
+      total.splits += stats.splits;
+      total.spilledIntervals += stats.spilledIntervals;
+      total.moves += stats.moves;
+      slots += allocation.numberOfSpillSlots();
+    }
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  const double microseconds = elapsed.count() * 1e6 / iterations;
+  std::cout << std::left << std::setw(10) << workload.name
+            << std::setw(4) << (optimize ? "-O" : "") << std::right
+            << std::setw(8) << total.instructions << " insts" << std::setw(8)
+            << total.intervals << " values" << std::setw(7) << total.splits
+            << " splits" << std::setw(7) << total.spilledIntervals
+            << " spilled" << std::setw(6) << slots << " slots"
+            << std::setw(7) << total.moves << " moves" << std::fixed
+            << std::setprecision(2) << std::setw(9)
+            << microseconds * 1000 /
+                   static_cast<double>(total.instructions)
+            << " us/1000 insts";
+  if (errOut.count != 0) std::cout << "  (" << errOut.count << " errors!)";
+  std::cout << "\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+
+  const std::vector<Workload> workloads{
+      {"sha256", sha256Rounds(16)},
+      {"loops", loopNests(32)},
+      {"calls", calls(32)},
+  };
+  for (const auto& workload : workloads) {
+    run(workload, iterations, false);
+    run(workload, iterations, true);
+  }
+  return 0;
+}
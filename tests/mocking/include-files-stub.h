@@ -0,0 +1,29 @@
+#ifndef TPLCC_TESTS_MOCKING_INCLUDE_FILES_STUB_H
+#define TPLCC_TESTS_MOCKING_INCLUDE_FILES_STUB_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tplcc/include-files.h"
+
+// Files in memory by name, <name> and "name" alike. Remembers who asked.
+struct IncludeFilesStub : IIncludeFiles {
+  std::map<std::string, std::string, std::less<>> files{};
+  // The include guards of the files that have one.
+  std::map<std::string, std::string, std::less<>> includeGuards{};
+  std::vector<std::string> includers{};
+
+  std::optional<File> find(std::string_view name, bool,
+                           std::string_view includer) override {
+    includers.emplace_back(includer);
+    const auto it = files.find(name);
+    if (it == files.end()) return std::nullopt;
+    const auto guard = includeGuards.find(name);
+    return File{it->first, it->second,
+                guard == includeGuards.end() ? std::string_view()
+                                             : guard->second};
+  }
+};
+
+#endif
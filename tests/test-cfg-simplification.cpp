@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "./utils/helpers.h"
+#include "tplcc/cfg-simplification.h"
+
+TEST(TestCFGSimplification, merges_straight_line_blocks) {
+  EXPECT_EQ(runPass("function i32 @f(i32 %x) {\n"
+                    "b0:\n"
+                    "  %a = add i32 %x, i32 1\n"
+                    "  jmp b1\n"
+                    "b1:\n"
+                    "  %p = phi i32 [%a, b0]\n"
+                    "  %b = mul i32 %p, i32 2\n"
+                    "  jmp b2\n"
+                    "b2:\n"
+                    "  ret %b\n"
+                    "}\n",
+                    simplifyControlFlow),
+            "function i32 @f(i32 %0) {\n"
+            "b0:\n"
+            "  %1 = add i32 %0, i32 1\n"
+            "  %2 = mul i32 %1, i32 2\n"
+            "  ret %2\n"
+            "}\n");
+}
+
+TEST(TestCFGSimplification, threads_jumps_over_empty_blocks) {
+  // The edge from b2 stays: b0 can't give b3 both 0 and x.
+  EXPECT_EQ(runPass("function i32 @f(i32 %c, i32 %x) {\n"
+                    "b0:\n"
+                    "  br %c, b1, b2\n"
+                    "b1:\n"
+                    "  jmp b3\n"
+                    "b2:\n"
+                    "  jmp b3\n"
+                    "b3:\n"
+                    "  %p = phi i32 [%x, b1], [i32 0, b2]\n"
+                    "  ret %p\n"
+                    "}\n",
+                    simplifyControlFlow),
+            "function i32 @f(i32 %0, i32 %1) {\n"
+            "b0:\n"
+            "  br %0, b2, b1\n"
+            "b1:\n"
+            "  jmp b2\n"
+            "b2:\n"
+            "  %2 = phi i32 [i32 0, b1], [%1, b0]\n"
+            "  ret %2\n"
+            "}\n");
+}
+
+TEST(TestCFGSimplification, folds_branches_and_removes_unreachable_blocks) {
+  EXPECT_EQ(runPass("function i32 @f(i32 %x) {\n"
+                    "b0:\n"
+                    "  br i32 0, b1, b2\n"
+                    "b1:\n"
+                    "  %a = add i32 %x, i32 1\n"
+                    "  jmp b3\n"
+                    "b2:\n"
+                    "  jmp b3\n"
+                    "b3:\n"
+                    "  %p = phi i32 [%a, b1], [%x, b2]\n"
+                    "  br %p, b4, b4\n"
+                    "b4:\n"
+                    "  ret %p\n"
+                    "dead:\n"
+                    "  jmp dead\n"
+                    "}\n",
+                    simplifyControlFlow),
+            "function i32 @f(i32 %0) {\n"
+            "b0:\n"
+            "  ret %0\n"
+            "}\n");
+}
+
+TEST(TestCFGSimplification, removes_trivial_phis) {
+  // Neither variable changes in the loop.
+  EXPECT_EQ(runPass("function i32 @f(i32 %x, i32 %c) {\n"
+                    "b0:\n"
+                    "  jmp loop\n"
+                    "loop:\n"
+                    "  %p = phi i32 [%x, b0], [%q, body]\n"
+                    "  br %c, body, exit\n"
+                    "body:\n"
+                    "  %q = phi i32 [%p, loop]\n"
+                    "  %r = add i32 %q, i32 1\n"
+                    "  br %r, loop, exit\n"
+                    "exit:\n"
+                    "  ret %p\n"
+                    "}\n",
+                    simplifyControlFlow),
+            "function i32 @f(i32 %0, i32 %1) {\n"
+            "b0:\n"
+            "  jmp b1\n"
+            "b1:\n"
+            "  br %1, b2, b3\n"
+            "b2:\n"
+            "  %2 = add i32 %0, i32 1\n"
+            "  br %2, b1, b3\n"
+            "b3:\n"
+            "  ret %0\n"
+            "}\n");
+}
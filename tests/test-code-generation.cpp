@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./mocking/report-error-stub.h"
+#include "tplcc/assembly-writer.h"
+#include "tplcc/buffered-writer.h"
+#include "tplcc/code-generation.h"
+#include "tplcc/ir-text.h"
+#include "tplcc/ir.h"
+
+namespace {
+std::string assemble(std::string_view text) {
+  Module module;
+  ReportErrorStub errOut;
+  EXPECT_TRUE(parseModule(text, module, errOut));
+  std::vector<MachineFunction> functions;
+  for (auto& function : module.functions) {
+    functions.push_back(generateCode(function, module));
+  }
+  std::ostringstream os;
+  {
+    BufferedWriter out(os);
+    writeAssembly(module, functions, out);
+  }
+  return os.str();
+}
+}  // namespace
+
+TEST(TestCodeGeneration, two_address_arithmetic) {
+  EXPECT_EQ(assemble("function i64 @f(i64 %a, i64 %b) {\n"
+                     "b0:\n"
+                     "  %s = add i64 %a, %b\n"
+                     "  ret %s\n"
+                     "}\n"),
+            "\t.text\n"
+            "\t.globl\tf\n"
+            "\t.type\tf, @function\n"
+            "f:\n"
+            "\tpushq\t%rbp\n"
+            "\tmovq\t%rsp, %rbp\n"
+            ".LBB0_0:\n"
+            "\tmovq\t%rdi, %rax\n"
+            "\taddq\t%rsi, %rax\n"
+            "\tleave\n"
+            "\tret\n"
+            "\t.size\tf, .-f\n"
+            "\t.section\t.note.GNU-stack,\"\",@progbits\n");
+}
+
+TEST(TestCodeGeneration, comparison_fused_with_branch) {
+  const auto text = assemble("function i32 @f(i32 %n) {\n"
+                             "b0:\n"
+                             "  %c = slt i32 %n, i32 10\n"
+                             "  br %c, b1, b2\n"
+                             "b1:\n"
+                             "  ret i32 1\n"
+                             "b2:\n"
+                             "  ret i32 2\n"
+                             "}\n");
+  EXPECT_NE(text.find(".LBB0_0:\n"
+                      "\tcmpl\t$10, %edi\n"
+                      "\tjl\t.LBB0_2\n"
+                      ".LBB0_1:\n"
+                      "\tmovl\t$2, %eax\n"),
+            std::string::npos)
+      << text;
+  EXPECT_EQ(text.find("set"), std::string::npos) << text;
+}
+
+TEST(TestCodeGeneration, calls_and_globals) {
+  EXPECT_EQ(
+      assemble("extern function @printf\n"
+               "static global @s, size 4, align 1, readonly, bytes \"%d\\0a\"\n"
+               "global @n, size 4, align 4, bytes \"\\07\"\n"
+               "global @p, size 8, align 8, reloc 0 @n + 4\n"
+               "global @z, size 64, align 16\n"
+               "function i32 @main() {\n"
+               "b0:\n"
+               "  %v = load i32 @n\n"
+               "  %r = call variadic i32 @printf(@s, %v)\n"
+               "  ret i32 0\n"
+               "}\n"),
+      "\t.text\n"
+      "\t.globl\tmain\n"
+      "\t.type\tmain, @function\n"
+      "main:\n"
+      "\tpushq\t%rbp\n"
+      "\tmovq\t%rsp, %rbp\n"
+      ".LBB0_0:\n"
+      "\tmovl\tn(%rip), %esi\n"
+      "\tleaq\ts(%rip), %rdi\n"
+      "\tmovl\t$0, %eax\n"
+      "\tcall\tprintf@PLT\n"
+      "\tmovl\t$0, %eax\n"
+      "\tleave\n"
+      "\tret\n"
+      "\t.size\tmain, .-main\n"
+      "\t.section\t.rodata\n"
+      "\t.balign\t1\n"
+      "\t.type\ts, @object\n"
+      "s:\n"
+      "\t.size\ts, 4\n"
+      "\t.byte\t37,100,10\n"
+      "\t.zero\t1\n"
+      "\t.data\n"
+      "\t.balign\t4\n"
+      "\t.globl\tn\n"
+      "\t.type\tn, @object\n"
+      "n:\n"
+      "\t.size\tn, 4\n"
+      "\t.byte\t7\n"
+      "\t.zero\t3\n"
+      "\t.balign\t8\n"
+      "\t.globl\tp\n"
+      "\t.type\tp, @object\n"
+      "p:\n"
+      "\t.size\tp, 8\n"
+      "\t.quad\tn+4\n"
+      "\t.bss\n"
+      "\t.balign\t16\n"
+      "\t.globl\tz\n"
+      "\t.type\tz, @object\n"
+      "z:\n"
+      "\t.size\tz, 64\n"
+      "\t.zero\t64\n"
+      "\t.section\t.note.GNU-stack,\"\",@progbits\n");
+}
+
+TEST(TestCodeGeneration, spills_and_callee_saved_registers) {
+  // 20 values live at once and across a call.
+  std::string text = "extern function @g\n\nfunction i64 @f(ptr %p) {\nb0:\n";
+  for (int i = 0; i < 20; i++) {
+    text += "  %v" + std::to_string(i) + " = load i64 %p\n";
+  }
+  text += "  call void @g()\n  %s0 = add i64 %v0, %v1\n";
+  for (int i = 2; i < 20; i++) {
+    text += "  %s" + std::to_string(i - 1) + " = add i64 %s" +
+            std::to_string(i - 2) + ", %v" + std::to_string(i) + "\n";
+  }
+  text += "  ret %s18\n}\n";
+  const auto assembly = assemble(text);
+  // All five callee-saved registers are pushed, the frame below them keeps
+  // the stack aligned at the call and is unwound through RBP.
+  EXPECT_NE(assembly.find("\tpushq\t%rbx\n"
+                          "\tpushq\t%r12\n"
+                          "\tpushq\t%r13\n"
+                          "\tpushq\t%r14\n"
+                          "\tpushq\t%r15\n"
+                          "\tsubq\t$"),
+            std::string::npos)
+      << assembly;
+  EXPECT_NE(assembly.find("\tleaq\t-40(%rbp), %rsp\n"
+                          "\tpopq\t%r15\n"
+                          "\tpopq\t%r14\n"
+                          "\tpopq\t%r13\n"
+                          "\tpopq\t%r12\n"
+                          "\tpopq\t%rbx\n"
+                          "\tpopq\t%rbp\n"
+                          "\tret\n"),
+            std::string::npos)
+      << assembly;
+  EXPECT_NE(assembly.find("(%rbp), %rax\n"), std::string::npos) << assembly;
+}
@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "./mocking/include-files-stub.h"
+#include "./mocking/report-error-stub.h"
+#include "tplcc/code-buffer.h"
+#include "tplcc/compilation.h"
+#include "tplcc/machine-code.h"
+#include "tplcc/time-report.h"
+
+TEST(TestCompilation, preprocess_with_macros_and_include_files) {
+  IncludeFilesStub files;
+  files.files["twice.h"] = "#define TWICE(x) ((x) * 2)\n";
+  CompileOptions options;
+  options.macros = {"N=21", "ON", "ADD(a, b)=a + b"};
+  options.includeFiles = &files;
+
+  CodeBuffer codeBuffer(
+      "#include \"twice.h\"\n"
+      "int f(void) { return TWICE(N) + ON + ADD(1, 2); }");
+  PreprocessedText text;
+  ReportErrorStub errOut;
+  ASSERT_TRUE(preprocess(codeBuffer, text, errOut, options));
+  EXPECT_EQ(text.text, "int f(void) { return ((21) * 2) + 1 + 1 + 2; }");
+  ASSERT_EQ(text.origins.size(), text.text.size());
+  // "int" comes from the source file, right after the #include line.
+  EXPECT_EQ(text.origins[0], 19);
+
+  CompiledModule compiled;
+  EXPECT_TRUE(compile(text, compiled, errOut, options));
+  EXPECT_TRUE(errOut.listOfErrors.empty());
+  EXPECT_EQ(compiled.functions.size(), 1);
+}
+
+TEST(TestCompilation, errors_in_preprocessed_text_are_reported_in_source) {
+  CodeBuffer codeBuffer(
+      "#define FOO 1\n"
+      "int f(void) { return x; }");
+  PreprocessedText text;
+  ReportErrorStub errOut;
+  ASSERT_TRUE(preprocess(codeBuffer, text, errOut));
+
+  CompiledModule compiled;
+  EXPECT_FALSE(compile(text, compiled, errOut));
+  ASSERT_EQ(errOut.listOfErrors.size(), 1);
+  const auto [start, end] = errOut.listOfErrors[0].range();
+  EXPECT_EQ(start, 35);
+  EXPECT_EQ(end, 36);
+  EXPECT_EQ(codeBuffer[start], 'x');
+}
+
+TEST(TestCompilation, errors_in_macros_are_reported_at_their_invocation) {
+  // The first N is the local n, the second is undeclared.
+  CodeBuffer codeBuffer(
+      "#define N n\n"
+      "int f(void) { int n = 1; return N; }\n"
+      "int g(void) { return N; }\n");
+  PreprocessedText text;
+  ReportErrorStub errOut;
+  ASSERT_TRUE(preprocess(codeBuffer, text, errOut));
+
+  CompiledModule compiled;
+  EXPECT_FALSE(compile(text, compiled, errOut));
+  ASSERT_EQ(errOut.listOfErrors.size(), 1);
+  const auto [start, end] = errOut.listOfErrors[0].range();
+  const auto section = codeBuffer.sectionOf(start);
+  ASSERT_NE(section, 0);
+  const auto& origin = codeBuffer.sectionOrigin(section);
+  EXPECT_EQ(origin.invocationStart, 70);
+  EXPECT_EQ(origin.invocationEnd, 71);
+  EXPECT_EQ(codeBuffer[origin.invocationStart], 'N');
+}
+
+TEST(TestCompilation, time_report_measures_the_phases_that_ran) {
+  static AllocationCount counter;
+  TimeReport report([] {
+    counter.bytes += 16;
+    counter.allocations += 1;
+    return counter;
+  });
+  CompileOptions options;
+  options.timeReport = &report;
+
+  CompiledModule compiled;
+  ReportErrorStub errOut;
+  ASSERT_TRUE(compile("int f(void) { return 1; }", compiled, errOut, options));
+
+  std::ostringstream os;
+  report.print(os, "f.c");
+  const auto table = os.str();
+  EXPECT_EQ(table.rfind("Time report for f.c:\n", 0), 0);
+  for (const char* phase : {"lex", "parse", "sema", "codegen", "total"}) {
+    EXPECT_NE(table.find("  " + std::string(phase) + " "), std::string::npos)
+        << phase;
+  }
+  EXPECT_EQ(table.find("preprocess"), std::string::npos);
+  // The fake counter allocates 16 bytes for every look, at the start and
+  // the end of each phase. The parser reads 11 tokens, the looks around
+  // lexing each of them are taken out of parse and counted for lex.
+  EXPECT_NE(table.find("            176           11\n  parse"),
+            std::string::npos)
+      << table;
+  EXPECT_NE(table.find("            400           25\n"), std::string::npos)
+      << table;
+}
+
+TEST(TestCompilation, shared_macro_table) {
+  const auto table = macroTableOf({"N=1", "N=2", "TWICE(x)=(x) * 2"});
+  ASSERT_EQ(table.size(), 2);
+  EXPECT_EQ(table.find(std::string("N"))->body, "2");
+
+  CompileOptions options;
+  options.predefinedMacroTable = &table;
+  options.macros = {"M=3"};
+  for (int i = 0; i < 2; i++) {
+    CodeBuffer codeBuffer("TWICE(N) + M");
+    PreprocessedText text;
+    ReportErrorStub errOut;
+    ASSERT_TRUE(preprocess(codeBuffer, text, errOut, options));
+    EXPECT_EQ(text.text, "(2) * 2 + 3");
+  }
+}
+
+TEST(TestCompilation, functions_compiled_on_a_pool_are_the_same) {
+  std::string source;
+  for (int i = 0; i < 30; i++) {
+    const auto n = std::to_string(i);
+    source += "int f" + n + "(int x) { int s = 0; for (int i = 0; i < x; i++) "
+              "s += i * " + n + "; return s; }\n";
+  }
+
+  CompiledModule serial;
+  ReportErrorStub errOut;
+  ASSERT_TRUE(compile(source, serial, errOut));
+  ThreadPool pool(3);
+  CompileOptions options;
+  options.pool = &pool;
+  CompiledModule parallel;
+  ASSERT_TRUE(compile(source, parallel, errOut, options));
+
+  ASSERT_EQ(parallel.functions.size(), serial.functions.size());
+  for (std::size_t i = 0; i < serial.functions.size(); i++) {
+    EXPECT_EQ(parallel.functions[i].symbol, serial.functions[i].symbol);
+    MachineCode serialCode;
+    MachineCode parallelCode;
+    encode(serial.functions[i], serialCode);
+    encode(parallel.functions[i], parallelCode);
+    EXPECT_EQ(parallelCode.bytes, serialCode.bytes) << "f" << i;
+  }
+}
+
+namespace {
+// Run the compiler with the arguments, returning what it prints to the
+// standard output, and to the standard error too if it is redirected.
+std::string runTplcc(const std::string& arguments) {
+  const auto command = std::string(TPLCC_EXECUTABLE) + " " + arguments;
+  std::string output;
+  if (FILE* pipe = popen(command.c_str(), "r")) {
+    char buffer[4096];
+    for (std::size_t size; (size = fread(buffer, 1, sizeof(buffer), pipe));) {
+      output.append(buffer, size);
+    }
+    pclose(pipe);
+  }
+  return output;
+}
+
+std::string writeSource(const std::string& name, const std::string& source) {
+  const auto path = testing::TempDir() + name;
+  std::ofstream(path) << source;
+  return path;
+}
+
+std::size_t count(const std::string& text, const std::string& part) {
+  std::size_t number = 0;
+  for (auto i = text.find(part); i != std::string::npos;
+       i = text.find(part, i + 1)) {
+    number++;
+  }
+  return number;
+}
+}  // namespace
+
+TEST(TestDriver, error_limit_drops_the_errors_after_it) {
+  const auto path = writeSource(
+      "tplcc-driver-limit.c",
+      "int f(void) { return a; }\n"
+      "int g(void) { return b; }\n"
+      "int h(void) { return c; }\n");
+  const auto all = runTplcc("-S -o /dev/null " + path + " 2>&1");
+  EXPECT_EQ(count(all, "Use of undeclared identifier"), 3) << all;
+
+  const auto limited =
+      runTplcc("-S -o /dev/null -ferror-limit=1 " + path + " 2>&1");
+  EXPECT_EQ(count(limited, "Use of undeclared identifier"), 1) << limited;
+  EXPECT_NE(limited.find("too many errors emitted, 2 more error(s)"),
+            std::string::npos)
+      << limited;
+}
+
+TEST(TestDriver, diagnostics_as_json_lines_or_sarif) {
+  const auto path = writeSource(
+      "tplcc-driver-format.c",
+      "int f(void) { return a; }\n"
+      "int g(void) { return b; }\n");
+  const auto lines = runTplcc("-S -o /dev/null -fdiagnostics-format=json " +
+                              path + " 2>&1");
+  EXPECT_EQ(count(lines, "\n{"), 1) << lines;
+  EXPECT_EQ(lines.rfind("{", 0), 0) << lines;
+  EXPECT_EQ(count(lines, "undeclared"), 2) << lines;
+
+  const auto sarif = runTplcc("-S -o /dev/null -fdiagnostics-format=sarif " +
+                              path + " 2>&1");
+  EXPECT_EQ(sarif.rfind("{\"version\":\"2.1.0\"", 0), 0) << sarif;
+  EXPECT_EQ(count(sarif, "\"ruleId\""), 2) << sarif;
+  EXPECT_TRUE(sarif.ends_with("]}]}\n")) << sarif;
+
+  EXPECT_NE(runTplcc("-S -fdiagnostics-format=xml " + path + " 2>&1")
+                .find("unknown diagnostics format xml"),
+            std::string::npos);
+}
+
+TEST(TestDriver, output_to_dash_is_the_standard_output) {
+  const auto path = writeSource("tplcc-driver-output.c",
+                                "int f(void) { return 1; }\n");
+  const auto file = testing::TempDir() + "tplcc-driver-output.s";
+  runTplcc("-S -o " + file + " " + path);
+  std::ostringstream written;
+  written << std::ifstream(file).rdbuf();
+
+  EXPECT_EQ(runTplcc("-S -o - " + path + " 2>/dev/null"), written.str());
+  EXPECT_NE(written.str().find("f:"), std::string::npos);
+  EXPECT_EQ(runTplcc("-E -o - " + path), "int f(void) { return 1; } \n");
+}
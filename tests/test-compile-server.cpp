@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "tplcc/compile-server.h"
+#include "tplcc/include-files.h"
+#include "tplcc/string-interner.h"
+
+#ifndef _WIN32
+TEST(TestCompileServer, runs_command_lines_of_clients) {
+  const std::string socketPath = testing::TempDir() + "tplcc-test.sock";
+  const auto directory = std::filesystem::current_path().string();
+  std::vector<std::vector<std::string>> handled;
+  std::vector<std::string> directories;
+  std::string problem;
+  std::thread server([&] {
+    EXPECT_TRUE(serve(
+        socketPath,
+        [&](const std::vector<std::string>& arguments, std::ostream& output,
+            std::ostream& diagnostics) {
+          handled.push_back(arguments);
+          directories.push_back(std::filesystem::current_path().string());
+          output << "out " << arguments.size();
+          diagnostics << "err";
+          return static_cast<int>(arguments.size()) + 2;
+        },
+        &problem))
+        << problem;
+  });
+
+  // The server may not listen yet.
+  std::optional<int> exitCode;
+  std::ostringstream output;
+  std::ostringstream diagnostics;
+  std::string clientProblem;
+  for (int attempt = 0; attempt < 500 && !exitCode; attempt++) {
+    exitCode = runOnServer(socketPath, {"-c", "a b.c"}, output, diagnostics,
+                           &clientProblem);
+    if (!exitCode) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(exitCode, 4) << clientProblem;
+  EXPECT_EQ(output.str(), "out 2");
+  EXPECT_EQ(diagnostics.str(), "err");
+
+  EXPECT_EQ(runOnServer(socketPath, {}, output, diagnostics, &clientProblem),
+            2);
+  EXPECT_TRUE(stopServer(socketPath, &clientProblem)) << clientProblem;
+  server.join();
+
+  EXPECT_EQ(handled, (std::vector<std::vector<std::string>>{
+                         {"-c", "a b.c"}, {}}));
+  EXPECT_EQ(directories, (std::vector<std::string>{directory, directory}));
+  EXPECT_FALSE(std::filesystem::exists(socketPath));
+  EXPECT_FALSE(stopServer(socketPath, &clientProblem));
+}
+#endif
+
+TEST(TestIncludeGuard, finds_the_macro_of_the_whole_file) {
+  EXPECT_EQ(includeGuardOf("// a.h\n"
+                           "#ifndef A_H\n"
+                           "#define A_H\n"
+                           "#if X\n"
+                           "int a;\n"
+                           "#else\n"
+                           "int b;\n"
+                           "#endif\n"
+                           "#endif /* A_H */\n"),
+            "A_H");
+  EXPECT_EQ(includeGuardOf("/* a.h */ # if !defined( A_H )\n"
+                           "#define A_H\n"
+                           "#endif"),
+            "A_H");
+  // The #endif in the comment and the string doesn't end the group.
+  EXPECT_EQ(includeGuardOf("#ifndef A_H\n"
+                           "/*\n#endif\n*/\n"
+                           "const char* s = \"\\\n#endif\";\n"
+                           "#endif\n"),
+            "A_H");
+}
+
+TEST(TestIncludeGuard, none_if_something_is_outside_of_the_group) {
+  EXPECT_EQ(includeGuardOf("int a;\n"), "");
+  EXPECT_EQ(includeGuardOf("int b;\n#ifndef A_H\n#endif\n"), "");
+  EXPECT_EQ(includeGuardOf("#ifndef A_H\n#endif\nint b;\n"), "");
+  EXPECT_EQ(includeGuardOf("#ifndef A_H\n#else\nint b;\n#endif\n"), "");
+  EXPECT_EQ(includeGuardOf("#ifndef A_H\n#elif B\n#endif\n"), "");
+  EXPECT_EQ(includeGuardOf("#ifndef A_H\n#endif\n#ifndef B_H\n#endif\n"),
+            "");
+  EXPECT_EQ(includeGuardOf("#ifdef A_H\n#endif\n"), "");
+  EXPECT_EQ(includeGuardOf("#if !defined(A_H) || B\n#endif\n"), "");
+  EXPECT_EQ(includeGuardOf("#ifndef A_H\nint a;\n"), "");
+}
+
+TEST(TestFileCache, forgets_files_that_changed) {
+  const std::string path = testing::TempDir() + "tplcc-changing-file.h";
+  std::ofstream(path) << "#ifndef C_H\n#endif\n";
+
+  FileCache cache;
+  const auto* file = cache.read(path);
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(file->includeGuard, "C_H");
+  cache.forgetChangedFiles();
+  EXPECT_EQ(cache.read(path), file);
+
+  std::ofstream(path) << "int changed;\n";
+  cache.forgetChangedFiles();
+  file = cache.read(path);
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(file->content, "int changed;\n");
+  EXPECT_EQ(file->includeGuard, "");
+
+  // A file that couldn't be read is looked for again.
+  const std::string created = testing::TempDir() + "tplcc-created-file.h";
+  std::filesystem::remove(created);
+  EXPECT_EQ(cache.read(created), nullptr);
+  std::ofstream(created) << "int created;\n";
+  EXPECT_EQ(cache.read(created), nullptr);
+  cache.forgetChangedFiles();
+  ASSERT_NE(cache.read(created), nullptr);
+}
+
+TEST(TestWarmStrings, interners_keep_the_ids_of_the_base) {
+  WarmStrings warm;
+  {
+    StringInterner strings(&warm.base());
+    EXPECT_EQ(strings.intern(""), 0);
+    EXPECT_EQ(strings.intern("main"), 1);
+    EXPECT_EQ(strings.intern("argc"), 2);
+    warm.learn(strings);
+  }
+  {
+    // Learned strings only reach the base when it is updated.
+    StringInterner strings(&warm.base());
+    EXPECT_EQ(strings.firstOwnID(), 1);
+    warm.learn(strings);
+  }
+  warm.update(16);
+  EXPECT_EQ(warm.base().size(), 3);
+
+  StringInterner strings(&warm.base());
+  EXPECT_EQ(strings.firstOwnID(), 3);
+  EXPECT_EQ(strings.intern("argc"), 2);
+  EXPECT_EQ(strings.intern("argv"), 3);
+  EXPECT_EQ(strings.view(1), "main");
+  EXPECT_EQ(strings.view(3), "argv");
+  ASSERT_NE(strings.find("main"), nullptr);
+  EXPECT_EQ(*strings.find("main"), 1);
+  EXPECT_EQ(warm.base().find("argv"), nullptr);
+}
+
+TEST(TestWarmStrings, base_starts_over_past_the_limit) {
+  WarmStrings warm;
+  auto learn = [&warm](std::initializer_list<std::string_view> names) {
+    StringInterner strings(&warm.base());
+    for (const auto name : names) strings.intern(name);
+    warm.learn(strings);
+  };
+  learn({"a", "b", "c"});
+  warm.update(5);
+  EXPECT_EQ(warm.base().size(), 4);
+
+  learn({"a", "d", "e"});
+  warm.update(5);
+  EXPECT_EQ(warm.base().size(), 3);
+  EXPECT_NE(warm.base().find("d"), nullptr);
+  EXPECT_EQ(warm.base().find("a"), nullptr);
+
+  // What is learned in one go is cut at the limit.
+  learn({"f", "g", "h", "i", "j", "k"});
+  warm.update(5);
+  EXPECT_EQ(warm.base().size(), 5);
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./mocking/report-error-stub.h"
+#include "tplcc/concurrent-error-sink.h"
+
+namespace {
+// Each worker reports errors for its own part of the input [begin, end), in
+// source order, like a lexer working on a chunk of a file would.
+void reportErrorsInPart(ConcurrentErrorSink& sink, CodeBuffer::Offset begin,
+                        CodeBuffer::Offset end) {
+  for (auto offset = begin; offset < end && !sink.hasReachedErrorLimit();
+       offset += 2) {
+    sink.reportsError({ErrorID::InvalidOctalNumber, {offset, offset + 1}});
+  }
+}
+}  // namespace
+
+TEST(TestConcurrentErrorSink, merged_errors_are_ordered_by_position) {
+  CodeBuffer codeBuffer(std::string(8000, ' '));
+  ConcurrentErrorSink sink(codeBuffer);
+
+  std::vector<std::thread> workers;
+  for (CodeBuffer::Offset part = 8; part-- > 0;) {
+    workers.emplace_back(reportErrorsInPart, std::ref(sink), part * 1000,
+                         (part + 1) * 1000);
+  }
+  for (auto& worker : workers) worker.join();
+
+  ReportErrorStub errOut;
+  sink.mergeInto(errOut);
+
+  ASSERT_EQ(errOut.listOfErrors.size(), 4000);
+  for (std::size_t i = 0; i < errOut.listOfErrors.size(); i++) {
+    EXPECT_EQ(std::get<0>(errOut.listOfErrors[i].range()), i * 2);
+  }
+}
+
+TEST(TestConcurrentErrorSink, errors_in_expansions_are_ordered_by_invocation) {
+  CodeBuffer codeBuffer(
+      "#define Z 08\n"
+      "#include \"a.h\"\n"
+      "int a = Z; int b = @;\n");
+  // Z at 36, the #include at 13.
+  const auto expansion = codeBuffer.section(
+      codeBuffer.addSection("08", {36, 37, 0, 12}));
+  const auto included = codeBuffer.section(
+      codeBuffer.addSection("int c = 09;\n", {13, 27, 0, 0, "a.h"}));
+  ConcurrentErrorSink sink(codeBuffer);
+
+  std::thread worker([&] {
+    sink.reportsError({ErrorID::StrayCharacter, {47, 48}, {"@"}});
+    sink.reportsError({ErrorID::InvalidOctalNumber,
+                       {expansion, expansion + 2}});
+  });
+  worker.join();
+  sink.reportsError({ErrorID::InvalidOctalNumber,
+                     {included + 8, included + 10}});
+
+  ReportErrorStub errOut;
+  sink.mergeInto(errOut);
+
+  ASSERT_EQ(errOut.listOfErrors.size(), 3);
+  EXPECT_EQ(std::get<0>(errOut.listOfErrors[0].range()), included + 8);
+  EXPECT_EQ(std::get<0>(errOut.listOfErrors[1].range()), expansion);
+  EXPECT_EQ(std::get<0>(errOut.listOfErrors[2].range()), 47);
+}
+
+TEST(TestConcurrentErrorSink, errors_at_same_position_have_a_stable_order) {
+  CodeBuffer codeBuffer(std::string(8000, ' '));
+  ConcurrentErrorSink sink(codeBuffer);
+
+  std::thread first([&sink] {
+    sink.reportsError({ErrorID::StrayCharacter, {0, 1}, {"@"}});
+  });
+  first.join();
+  sink.reportsError({ErrorID::InvalidOctalNumber, {0, 1}});
+  sink.reportsError({ErrorID::StrayCharacter, {0, 1}, {"$"}});
+
+  ReportErrorStub errOut;
+  sink.mergeInto(errOut);
+
+  ASSERT_EQ(errOut.listOfErrors.size(), 3);
+  EXPECT_EQ(errOut.listOfErrors[0].id(), ErrorID::InvalidOctalNumber);
+  EXPECT_EQ(errOut.listOfErrors[1].message(), "Stray \"$\" in program.");
+  EXPECT_EQ(errOut.listOfErrors[2].message(), "Stray \"@\" in program.");
+}
+
+TEST(TestConcurrentErrorSink, error_limit_keeps_the_first_errors_of_a_serial_run) {
+  CodeBuffer codeBuffer(std::string(4000, ' '));
+  ConcurrentErrorSink sink(codeBuffer, 10);
+
+  std::vector<std::thread> workers;
+  for (CodeBuffer::Offset part = 0; part < 4; part++) {
+    workers.emplace_back(reportErrorsInPart, std::ref(sink), part * 1000,
+                         (part + 1) * 1000);
+  }
+  for (auto& worker : workers) worker.join();
+
+  ReportErrorStub errOut;
+  sink.mergeInto(errOut);
+
+  ASSERT_EQ(errOut.listOfErrors.size(), 40);
+  for (std::size_t i = 0; i < 10; i++) {
+    EXPECT_EQ(std::get<0>(errOut.listOfErrors[i].range()), i * 2);
+  }
+}
+
+TEST(TestConcurrentErrorSink, sink_is_empty_after_merging) {
+  CodeBuffer codeBuffer(std::string(8000, ' '));
+  ConcurrentErrorSink sink(codeBuffer);
+  sink.reportsError({ErrorID::InvalidOctalNumber, {0, 1}});
+
+  ReportErrorStub errOut;
+  sink.mergeInto(errOut);
+  sink.mergeInto(errOut);
+  EXPECT_EQ(errOut.listOfErrors.size(), 1);
+
+  sink.reportsError({ErrorID::InvalidOctalNumber, {2, 3}});
+  sink.mergeInto(errOut);
+  EXPECT_EQ(errOut.listOfErrors.size(), 2);
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "./mocking/report-error-stub.h"
+#include "./mocking/simple-string-scanner.h"
+#include "tplcc/constant-evaluator.h"
+
+namespace {
+IntegerValue intValue(std::int64_t value) {
+  return IntegerValue::of(static_cast<std::uint64_t>(value), 32, false);
+}
+IntegerValue unsignedValue(std::uint64_t value) {
+  return IntegerValue::of(value, 32, true);
+}
+
+struct EvaluatedLine {
+  ReportErrorStub errOut;
+  std::optional<IntegerValue> value;
+
+  explicit EvaluatedLine(const std::string& line) {
+    SimpleStringScanner scanner(line);
+    Lexer lexer(scanner, errOut);
+    std::vector<Token> tokens;
+    for (auto token = lexer.next(); *token != Token(EOI);
+         token = lexer.next()) {
+      tokens.push_back(*token);
+    }
+    value = evaluatePreprocessorExpression(tokens, {0, 1}, errOut);
+  }
+};
+}  // namespace
+
+TEST(TestConstantEvaluator, values_wrap_around_to_their_type) {
+  EXPECT_EQ(IntegerValue::of(0xFFFFFFFF, 32, false).asSigned(), -1);
+  EXPECT_EQ(IntegerValue::of(0xFFFFFFFF, 32, true).bits, 0xFFFFFFFF);
+  EXPECT_EQ(IntegerValue::of(0x1FF, 8, true).bits, 0xFF);
+  EXPECT_EQ(IntegerValue::of(0x180, 8, false).asSigned(), -128);
+}
+
+TEST(TestConstantEvaluator, signed_arithmetic_reports_overflow) {
+  const auto max = intValue(INT32_MAX);
+  const auto sum = foldBinary(Operator::Add, max, intValue(1));
+  EXPECT_EQ(sum.status, FoldStatus::Overflow);
+  EXPECT_EQ(sum.value.asSigned(), INT32_MIN);
+
+  EXPECT_EQ(foldUnary(Operator::Minus, intValue(INT32_MIN)).status,
+            FoldStatus::Overflow);
+  EXPECT_EQ(foldBinary(Operator::Divide, intValue(INT32_MIN), intValue(-1))
+                .status,
+            FoldStatus::Overflow);
+  EXPECT_EQ(foldBinary(Operator::Multiply, intValue(65536), intValue(65536))
+                .status,
+            FoldStatus::Overflow);
+  EXPECT_EQ(foldBinary(Operator::ShiftLeft, intValue(1), intValue(31)).status,
+            FoldStatus::Overflow);
+  // Shifting out copies of the sign bit is fine.
+  const auto shifted = foldBinary(Operator::ShiftLeft, intValue(-1), intValue(2));
+  EXPECT_EQ(shifted.status, FoldStatus::Ok);
+  EXPECT_EQ(shifted.value.asSigned(), -4);
+}
+
+TEST(TestConstantEvaluator, unsigned_arithmetic_wraps) {
+  const auto difference =
+      foldBinary(Operator::Subtract, unsignedValue(0), unsignedValue(1));
+  EXPECT_EQ(difference.status, FoldStatus::Ok);
+  EXPECT_EQ(difference.value.bits, 0xFFFFFFFF);
+
+  const auto max64 = IntegerValue::of(UINT64_MAX, 64, true);
+  const auto product = foldBinary(Operator::Multiply, max64, max64);
+  EXPECT_EQ(product.status, FoldStatus::Ok);
+  EXPECT_EQ(product.value.bits, 1);
+
+  // -1 converted to unsigned int is the largest value.
+  EXPECT_EQ(foldBinary(Operator::Less, unsignedValue(1), unsignedValue(-1))
+                .value,
+            intValue(1));
+  EXPECT_EQ(foldBinary(Operator::Less, intValue(1), intValue(-1)).value,
+            intValue(0));
+}
+
+TEST(TestConstantEvaluator, division_and_shifts_are_checked) {
+  EXPECT_EQ(foldBinary(Operator::Remainder, intValue(1), intValue(0)).status,
+            FoldStatus::DivisionByZero);
+  EXPECT_EQ(foldBinary(Operator::Divide, intValue(-7), intValue(2)).value,
+            intValue(-3));
+  EXPECT_EQ(foldBinary(Operator::Remainder, intValue(-7), intValue(2)).value,
+            intValue(-1));
+  EXPECT_EQ(foldBinary(Operator::ShiftRight, intValue(-8), intValue(1)).value,
+            intValue(-4));
+  EXPECT_EQ(foldBinary(Operator::ShiftLeft, intValue(1), intValue(32)).status,
+            FoldStatus::InvalidShift);
+  EXPECT_EQ(foldBinary(Operator::ShiftLeft, intValue(1), intValue(-1)).status,
+            FoldStatus::InvalidShift);
+}
+
+TEST(TestConstantEvaluator, preprocessor_expressions_use_intmax_t) {
+  EXPECT_EQ(EvaluatedLine("1 + 2 * 3").value->bits, 7);
+  EXPECT_EQ(EvaluatedLine("(1 + 2) * 3").value->bits, 9);
+  EXPECT_EQ(EvaluatedLine("1 << 40 > 0").value->bits, 1);
+  EXPECT_EQ(EvaluatedLine("-1 < 0u").value->bits, 0);
+  EXPECT_EQ(EvaluatedLine("0xFFFFFFFFFFFFFFFF == -1").value->bits, 1);
+  EXPECT_EQ(EvaluatedLine("1 ? 2 : 3").value->bits, 2);
+  EXPECT_EQ(EvaluatedLine("'a' == 97 && !UNDEFINED").value->bits, 1);
+
+  const EvaluatedLine unevaluated("0 && 1 / 0 || 1 ? 5 : 1 / 0");
+  EXPECT_TRUE(unevaluated.errOut.listOfErrors.empty());
+  EXPECT_EQ(unevaluated.value->bits, 5);
+}
+
+TEST(TestConstantEvaluator, invalid_preprocessor_expressions) {
+  const EvaluatedLine division("1 / 0");
+  ASSERT_EQ(division.errOut.listOfErrors.size(), 1);
+  EXPECT_EQ(division.errOut.listOfErrors[0].id(), ErrorID::DivisionByZero);
+
+  const EvaluatedLine overflow("0x7FFFFFFFFFFFFFFF + 1");
+  ASSERT_EQ(overflow.errOut.listOfErrors.size(), 1);
+  EXPECT_EQ(overflow.errOut.listOfErrors[0].id(), ErrorID::ConstantOverflow);
+
+  const EvaluatedLine floating("1.0");
+  EXPECT_FALSE(floating.value);
+  EXPECT_EQ(floating.errOut.listOfErrors[0].id(),
+            ErrorID::NotIntegerConstant);
+
+  const EvaluatedLine unbalanced("(1 + 2");
+  EXPECT_FALSE(unbalanced.value);
+  EXPECT_EQ(unbalanced.errOut.listOfErrors[0].message(), "Expected \")\" here.");
+
+  const EvaluatedLine trailing("1 2");
+  EXPECT_FALSE(trailing.value);
+  EXPECT_EQ(trailing.errOut.listOfErrors[0].message(), "Unexpected \"2\".");
+
+  EXPECT_FALSE(EvaluatedLine("").value);
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "./utils/helpers.h"
+#include "tplcc/constant-propagation.h"
+
+TEST(TestConstantPropagation, folds_arithmetic) {
+  EXPECT_EQ(runPass("function i32 @f(i32 %x) {\n"
+                    "b0:\n"
+                    "  %a = shl i32 i32 1, i32 4\n"
+                    "  %b = or i32 %a, i32 3\n"
+                    "  %c = sub i32 %b, i32 20\n"
+                    "  %d = zext i64 %c\n"
+                    "  %e = udiv i64 %d, i64 2\n"
+                    "  %f = trunc i8 %e\n"
+                    "  %g = sext i32 %f\n"
+                    "  %h = and i32 %x, %b\n"
+                    "  %i = add i32 %h, %g\n"
+                    "  ret %i\n"
+                    "}\n",
+                    propagateConstants),
+            "function i32 @f(i32 %0) {\n"
+            "b0:\n"
+            "  %1 = and i32 %0, i32 19\n"
+            "  %2 = add i32 %1, i32 -1\n"
+            "  ret %2\n"
+            "}\n");
+}
+
+TEST(TestConstantPropagation, leaves_undefined_arithmetic) {
+  EXPECT_EQ(runPass("function i32 @f() {\n"
+                    "b0:\n"
+                    "  %a = sdiv i32 i32 1, i32 0\n"
+                    "  %b = shl i32 i32 1, i32 32\n"
+                    "  %c = ult i32 i32 -1, i32 1\n"
+                    "  %d = add i32 %a, %b\n"
+                    "  %e = add i32 %d, %c\n"
+                    "  ret %e\n"
+                    "}\n",
+                    propagateConstants),
+            "function i32 @f() {\n"
+            "b0:\n"
+            "  %0 = sdiv i32 i32 1, i32 0\n"
+            "  %1 = shl i32 i32 1, i32 32\n"
+            "  %2 = add i32 %0, %1\n"
+            "  %3 = add i32 %2, i32 0\n"
+            "  ret %3\n"
+            "}\n");
+}
+
+TEST(TestConstantPropagation, constants_through_loops_and_branches) {
+  // x stays 1: the block that would change it is never reached.
+  EXPECT_EQ(runPass("function i32 @f(i32 %n) {\n"
+                    "b0:\n"
+                    "  jmp loop\n"
+                    "loop:\n"
+                    "  %x = phi i32 [i32 1, b0], [%x2, next]\n"
+                    "  %i = phi i32 [i32 0, b0], [%i2, next]\n"
+                    "  %c = slt i32 %i, %n\n"
+                    "  br %c, body, exit\n"
+                    "body:\n"
+                    "  %t = ne i32 %x, i32 1\n"
+                    "  br %t, change, next\n"
+                    "change:\n"
+                    "  %x3 = add i32 %x, i32 1\n"
+                    "  jmp next\n"
+                    "next:\n"
+                    "  %x2 = phi i32 [%x, body], [%x3, change]\n"
+                    "  %i2 = add i32 %i, i32 1\n"
+                    "  jmp loop\n"
+                    "exit:\n"
+                    "  ret %x\n"
+                    "}\n",
+                    propagateConstants),
+            "function i32 @f(i32 %0) {\n"
+            "b0:\n"
+            "  jmp b1\n"
+            "b1:\n"
+            "  %1 = phi i32 [i32 0, b0], [%3, b3]\n"
+            "  %2 = slt i32 %1, %0\n"
+            "  br %2, b2, b4\n"
+            "b2:\n"
+            "  jmp b3\n"
+            "b3:\n"
+            "  %3 = add i32 %1, i32 1\n"
+            "  jmp b1\n"
+            "b4:\n"
+            "  ret i32 1\n"
+            "}\n");
+}
+
+TEST(TestConstantPropagation, keeps_phis_of_different_constants) {
+  EXPECT_EQ(runPass("function i32 @f(i32 %c) {\n"
+                    "b0:\n"
+                    "  br %c, b1, b2\n"
+                    "b1:\n"
+                    "  jmp b2\n"
+                    "b2:\n"
+                    "  %p = phi i32 [i32 5, b0], [i32 6, b1]\n"
+                    "  %k = mul i32 i32 6, i32 7\n"
+                    "  %t = eq i32 %k, i32 42\n"
+                    "  br %t, b3, b4\n"
+                    "b3:\n"
+                    "  ret %p\n"
+                    "b4:\n"
+                    "  ret %k\n"
+                    "}\n",
+                    propagateConstants),
+            "function i32 @f(i32 %0) {\n"
+            "b0:\n"
+            "  br %0, b1, b2\n"
+            "b1:\n"
+            "  jmp b2\n"
+            "b2:\n"
+            "  %1 = phi i32 [i32 5, b0], [i32 6, b1]\n"
+            "  jmp b3\n"
+            "b3:\n"
+            "  ret %1\n"
+            "}\n");
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "./utils/helpers.h"
+#include "tplcc/dead-code-elimination.h"
+
+TEST(TestDeadCodeElimination, keeps_side_effects_and_their_operands) {
+  EXPECT_EQ(runPass("extern function @g\n"
+                    "\n"
+                    "function void @f(ptr %p, i32 %x) {\n"
+                    "b0:\n"
+                    "  %a = add i32 %x, i32 1\n"
+                    "  %b = mul i32 %a, i32 2\n"
+                    "  %c = sub i32 %x, i32 3\n"
+                    "  %d = call i32 @g(%c)\n"
+                    "  store %p, %a\n"
+                    "  ret\n"
+                    "}\n",
+                    eliminateDeadCode),
+            "extern function @g\n"
+            "\n"
+            "function void @f(ptr %0, i32 %1) {\n"
+            "b0:\n"
+            "  %2 = add i32 %1, i32 1\n"
+            "  %3 = sub i32 %1, i32 3\n"
+            "  %4 = call i32 @g(%3)\n"
+            "  store %0, %2\n"
+            "  ret\n"
+            "}\n");
+}
+
+TEST(TestDeadCodeElimination, removes_dead_phi_cycles) {
+  // sum only feeds itself around the loop.
+  EXPECT_EQ(runPass("function i32 @f(i32 %n) {\n"
+                    "b0:\n"
+                    "  jmp loop\n"
+                    "loop:\n"
+                    "  %i = phi i32 [i32 0, b0], [%i2, loop]\n"
+                    "  %sum = phi i32 [i32 0, b0], [%sum2, loop]\n"
+                    "  %sum2 = add i32 %sum, %i\n"
+                    "  %i2 = add i32 %i, i32 1\n"
+                    "  %c = slt i32 %i2, %n\n"
+                    "  br %c, loop, exit\n"
+                    "exit:\n"
+                    "  ret %i2\n"
+                    "}\n",
+                    eliminateDeadCode),
+            "function i32 @f(i32 %0) {\n"
+            "b0:\n"
+            "  jmp b1\n"
+            "b1:\n"
+            "  %1 = phi i32 [i32 0, b0], [%2, b1]\n"
+            "  %2 = add i32 %1, i32 1\n"
+            "  %3 = slt i32 %2, %0\n"
+            "  br %3, b1, b2\n"
+            "b2:\n"
+            "  ret %2\n"
+            "}\n");
+}
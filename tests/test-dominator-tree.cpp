@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "./mocking/report-error-stub.h"
+#include "tplcc/dominator-tree.h"
+#include "tplcc/ir-text.h"
+#include "tplcc/ir.h"
+
+TEST(TestDominatorTree, loops_and_diamonds) {
+  Module module;
+  ReportErrorStub errOut;
+  ASSERT_TRUE(parseModule("function void @f(i32 %c) {\n"
+                          "b0:\n"
+                          "  jmp b1\n"
+                          "b1:\n"
+                          "  br %c, b2, b3\n"
+                          "b2:\n"
+                          "  jmp b4\n"
+                          "b3:\n"
+                          "  jmp b4\n"
+                          "b4:\n"
+                          "  br %c, b1, b5\n"
+                          "b5:\n"
+                          "  ret\n"
+                          "b6:\n"
+                          "  jmp b4\n"
+                          "}\n",
+                          module, errOut));
+  // Block n of the text is block n + 1.
+  const DominatorTree tree(module.functions[0]);
+  EXPECT_EQ(tree.immediateDominator(1), 0u);
+  EXPECT_EQ(tree.immediateDominator(2), 1u);
+  EXPECT_EQ(tree.immediateDominator(3), 2u);
+  EXPECT_EQ(tree.immediateDominator(4), 2u);
+  EXPECT_EQ(tree.immediateDominator(5), 2u);
+  EXPECT_EQ(tree.immediateDominator(6), 5u);
+  EXPECT_FALSE(tree.isReachable(7));
+  EXPECT_EQ(tree.immediateDominator(7), 0u);
+
+  // In reverse postorder, b2 is left last by the depth-first search.
+  const auto children = tree.children(2);
+  EXPECT_EQ(std::vector<BlockID>(children.begin(), children.end()),
+            (std::vector<BlockID>{4, 3, 5}));
+  EXPECT_EQ(tree.reversePostorder().front(), Function::ENTRY);
+  EXPECT_EQ(tree.reversePostorder().size(), 6u);
+
+  EXPECT_TRUE(tree.dominates(2, 6));
+  EXPECT_TRUE(tree.dominates(5, 5));
+  EXPECT_FALSE(tree.dominates(3, 5));
+  EXPECT_FALSE(tree.dominates(5, 2));
+  EXPECT_FALSE(tree.dominates(1, 7));
+}
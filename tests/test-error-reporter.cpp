@@ -0,0 +1,233 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "tplcc/code-buffer.h"
+#include "tplcc/error.h"
+
+TEST(TestError, message_is_rendered_from_id_and_arguments) {
+  Error error(ErrorID::DuplicatedMacroParameter, {3, 5}, {"x", "FOO"});
+  EXPECT_EQ(error.message(),
+            "Duplicated parameter \"x\" in the function-like macro \"FOO\".");
+  EXPECT_EQ(error.hint(), "");
+  EXPECT_EQ(error.argument(0), "x");
+  EXPECT_EQ(error.argument(1), "FOO");
+  EXPECT_EQ(error.argument(2), "");
+}
+
+TEST(TestError, custom_error_keeps_message_and_hint) {
+  Error error({1, 2}, "Something went wrong.", "here");
+  EXPECT_EQ(error.id(), ErrorID::Custom);
+  EXPECT_EQ(error.message(), "Something went wrong.");
+  EXPECT_EQ(error.hint(), "here");
+}
+
+TEST(TestError, errors_with_same_text_and_range_are_equal) {
+  EXPECT_EQ(Error(ErrorID::InvalidOctalNumber, {0, 3}),
+            Error({0, 3}, "Invalid octal number.", "Invalid octal number."));
+  EXPECT_FALSE(Error(ErrorID::InvalidOctalNumber, {0, 3}) ==
+               Error(ErrorID::InvalidOctalNumber, {0, 4}));
+}
+
+TEST(TestErrorReporter, output_source_line_with_carets) {
+  CodeBuffer codeBuffer("int main() {\n    int a = 0x1.3;\n}\n");
+  ErrorReporter reporter("foo.c", codeBuffer);
+
+  reporter.reportsError({ErrorID::HexFloatHasNoExponent, {25, 30}, {"0x1.3"}});
+
+  std::ostringstream os;
+  reporter.outputErrorMessagesTo(os);
+  EXPECT_EQ(os.str(),
+            "foo.c: Hexadecimal floating point 0x1.3 has no exponent part.\n"
+            "\n"
+            "2 |     int a = 0x1.3;\n"
+            "                ^^^^^ (Hex float has no exponent part.)\n"
+            "\n");
+}
+
+TEST(TestErrorReporter, carets_keep_tabs_of_the_source_line) {
+  CodeBuffer codeBuffer("\tx = `;");
+  ErrorReporter reporter("foo.c", codeBuffer);
+
+  reporter.reportsError({ErrorID::StrayCharacter, {5, 6}, {"`"}});
+
+  std::ostringstream os;
+  reporter.outputErrorMessagesTo(os);
+  EXPECT_EQ(os.str(),
+            "foo.c: Stray \"`\" in program.\n"
+            "\n"
+            "1 | \tx = `;\n"
+            "    \t    ^ (Invalid character.)\n"
+            "\n");
+}
+
+TEST(TestErrorReporter, stops_collecting_errors_at_error_limit) {
+  CodeBuffer codeBuffer("a\nb\nc\n");
+  ErrorReporter reporter("foo.c", codeBuffer, 2);
+
+  reporter.reportsError({ErrorID::InvalidOctalNumber, {0, 1}});
+  EXPECT_FALSE(reporter.hasReachedErrorLimit());
+  reporter.reportsError({ErrorID::InvalidOctalNumber, {2, 3}});
+  EXPECT_TRUE(reporter.hasReachedErrorLimit());
+  reporter.reportsError({ErrorID::InvalidOctalNumber, {4, 5}});
+  EXPECT_EQ(reporter.errorCount(), 3);
+
+  std::ostringstream os;
+  reporter.outputErrorMessagesTo(os);
+  EXPECT_EQ(os.str(),
+            "foo.c: Invalid octal number.\n"
+            "\n"
+            "1 | a\n"
+            "    ^ (Invalid octal number.)\n"
+            "\n"
+            "foo.c: Invalid octal number.\n"
+            "\n"
+            "2 | b\n"
+            "    ^ (Invalid octal number.)\n"
+            "\n"
+            "foo.c: too many errors emitted, 1 more error(s) are not shown.\n");
+}
+
+TEST(TestErrorReporter, output_macro_expansion_of_error) {
+  CodeBuffer codeBuffer("#define ZERO 0x1.3\nint a = ZERO;\n");
+  codeBuffer.addSection("0x1.3", {27, 31, 0, 18});
+  ErrorReporter reporter("foo.c", codeBuffer);
+
+  reporter.reportsError({ErrorID::HexFloatHasNoExponent, {33, 38}, {"0x1.3"}});
+
+  std::ostringstream os;
+  reporter.outputErrorMessagesTo(os);
+  EXPECT_EQ(os.str(),
+            "foo.c: Hexadecimal floating point 0x1.3 has no exponent part.\n"
+            "\n"
+            "It occurs in this macro:\n"
+            "\n"
+            "2 | int a = ZERO;\n"
+            "            ^^^^\n"
+            "\n"
+            "The macro has following definition:\n"
+            "\n"
+            "1 | #define ZERO 0x1.3\n"
+            "\n"
+            "and is expanded into following text:\n"
+            "\n"
+            "  | 0x1.3\n"
+            "    ^^^^^ (Hex float has no exponent part.)\n"
+            "\n");
+}
+
+TEST(TestErrorReporter, output_nested_macro_expansions_of_error) {
+  CodeBuffer codeBuffer(
+      "#define A 1 + B\n"  // [0, 15)
+      "#define B `\n"      // [16, 27)
+      "A;\n");             // [28, 31)
+  const auto a = codeBuffer.addSection("1 + B", {28, 29, 0, 15});
+  const auto b = codeBuffer.section(a) + 4;
+  const auto stray = codeBuffer.section(codeBuffer.addSection("`", {b, b + 1, 16, 27}));
+  ErrorReporter reporter("foo.c", codeBuffer);
+
+  reporter.reportsError({ErrorID::StrayCharacter, {stray, stray + 1}, {"`"}});
+
+  std::ostringstream os;
+  reporter.outputErrorMessagesTo(os);
+  EXPECT_EQ(os.str(),
+            "foo.c: Stray \"`\" in program.\n"
+            "\n"
+            "It occurs in this macro:\n"
+            "\n"
+            "3 | A;\n"
+            "    ^\n"
+            "\n"
+            "The macro has following definition:\n"
+            "\n"
+            "1 | #define A 1 + B\n"
+            "\n"
+            "and is expanded into following text:\n"
+            "\n"
+            "  | 1 + B\n"
+            "        ^\n"
+            "\n"
+            "The macro has following definition:\n"
+            "\n"
+            "2 | #define B `\n"
+            "\n"
+            "and is expanded into following text:\n"
+            "\n"
+            "  | `\n"
+            "    ^ (Invalid character.)\n"
+            "\n");
+}
+
+TEST(TestErrorReporter, output_error_in_included_file) {
+  CodeBuffer codeBuffer("#include \"a.h\"\nint b;\n");
+  CodeBuffer::SectionOrigin origin{0, 14};
+  origin.includedFile = "inc/a.h";
+  const auto header = codeBuffer.section(
+      codeBuffer.addSection("int a;\nint c = 0x1.3;\n", std::move(origin)));
+  ErrorReporter reporter("foo.c", codeBuffer);
+
+  const auto hex = header + 15;
+  reporter.reportsError(
+      {ErrorID::HexFloatHasNoExponent, {hex, hex + 5}, {"0x1.3"}});
+
+  std::ostringstream os;
+  reporter.outputErrorMessagesTo(os);
+  EXPECT_EQ(os.str(),
+            "In the included file \"inc/a.h\"\n"
+            "\n"
+            "foo.c: Hexadecimal floating point 0x1.3 has no exponent part.\n"
+            "\n"
+            "2 | int c = 0x1.3;\n"
+            "            ^^^^^ (Hex float has no exponent part.)\n"
+            "\n");
+}
+
+TEST(TestErrorReporter, stream_errors_as_json_lines) {
+  CodeBuffer codeBuffer("#define ZERO 0x1.3\nint a = ZERO;\nchar* s = L\"\\t\";\n");
+  codeBuffer.addSection("0x1.3", {27, 31, 0, 18});
+  std::ostringstream os;
+  ErrorReporter reporter("foo.c", codeBuffer, DiagnosticFormat::JSONLines, os);
+
+  reporter.reportsError({ErrorID::InvalidStringLiteralPrefix, {43, 48}, {"L"}});
+  reporter.reportsError({ErrorID::HexFloatHasNoExponent, {50, 55}, {"0x1.3"}});
+  reporter.finish();
+
+  EXPECT_EQ(os.str(),
+            "{\"file\":\"foo.c\",\"startLine\":3,\"startColumn\":11,"
+            "\"endLine\":3,\"endColumn\":16,"
+            "\"message\":\"\\\"L\\\" is not a valid prefix for a string "
+            "literal.\",\"hint\":\"Invalid prefix.\",\"expansions\":[]}\n"
+            "{\"file\":\"foo.c\",\"startLine\":2,\"startColumn\":9,"
+            "\"endLine\":2,\"endColumn\":13,"
+            "\"message\":\"Hexadecimal floating point 0x1.3 has no exponent "
+            "part.\",\"hint\":\"Hex float has no exponent part.\","
+            "\"expansions\":[{\"expandedText\":\"0x1.3\",\"startColumn\":1,"
+            "\"endColumn\":6,\"definition\":{\"startLine\":1,"
+            "\"startColumn\":1,\"endLine\":1,\"endColumn\":19}}]}\n");
+}
+
+TEST(TestErrorReporter, stream_errors_as_sarif_log) {
+  CodeBuffer codeBuffer("a\n");
+  std::ostringstream os;
+  {
+    ErrorReporter reporter("foo.c", codeBuffer, DiagnosticFormat::SARIF, os, 1);
+    reporter.reportsError({ErrorID::InvalidOctalNumber, {0, 1}});
+    reporter.reportsError({ErrorID::InvalidOctalNumber, {0, 1}});
+    EXPECT_EQ(reporter.errorCount(), 2);
+  }
+
+  EXPECT_EQ(os.str(),
+            "{\"version\":\"2.1.0\","
+            "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+            "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"tplcc\"}},"
+            "\"columnKind\":\"unicodeCodePoints\",\"results\":[\n"
+            "{\"ruleId\":\"invalid-octal-number\",\"level\":\"error\","
+            "\"message\":{\"text\":\"Invalid octal number.\"},"
+            "\"locations\":[{\"physicalLocation\":{\"artifactLocation\":"
+            "{\"uri\":\"foo.c\"},\"region\":{\"startLine\":1,"
+            "\"startColumn\":1,\"endLine\":1,\"endColumn\":2}}}],"
+            "\"properties\":{\"hint\":\"Invalid octal number.\","
+            "\"expansions\":[]}}"
+            "\n]}]}\n");
+}
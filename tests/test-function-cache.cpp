@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+#include "./mocking/report-error-stub.h"
+#include "tplcc/buffered-writer.h"
+#include "tplcc/compilation.h"
+#include "tplcc/function-cache.h"
+#include "tplcc/object-writer.h"
+#include "tplcc/result-cache.h"
+#include "tplcc/thread-pool.h"
+
+namespace {
+// Ten functions that stay the same, f4 changes in the second version.
+std::string functions(bool isSecondVersion) {
+  std::string source;
+  for (int i = 0; i < 10; i++) {
+    const auto n = std::to_string(i);
+    const auto factor = isSecondVersion && i == 4 ? "7" : n;
+    source += "int f" + n + "(int x) { int s = g; for (int i = 0; i < x; " +
+              "i++) s += helper(i) * " + factor + "; return s; }\n";
+  }
+  return source;
+}
+
+// The second version has a global more before everything, so the symbols
+// all get other IDs, defines ext, which caller only declared, and returns
+// another string from name.
+std::string firstVersion() {
+  return "int g;\n"
+         "int ext(int x);\n"
+         "static int helper(int x) { return x * 3; }\n" +
+         functions(false) +
+         "const char *name(void) { return \"first\"; }\n"
+         "int caller(int x) { return ext(x) + g; }\n";
+}
+
+std::string secondVersion() {
+  return "int h;\n"
+         "int g;\n"
+         "int ext(int x);\n"
+         "static int helper(int x) { return x * 3; }\n" +
+         functions(true) +
+         "const char *name(void) { return \"second\"; }\n"
+         "int ext(int x) { return x + h; }\n"
+         "int caller(int x) { return ext(x) + g; }\n";
+}
+
+std::string objectOf(const CompiledModule& compiled) {
+  std::ostringstream os;
+  {
+    BufferedWriter out(os);
+    writeObject(compiled.module, compiled.functions, out);
+  }
+  return os.str();
+}
+}  // namespace
+
+TEST(TestFunctionCache, compiles_only_the_functions_that_changed) {
+  FunctionCache cache;
+  CompileOptions options;
+  options.functionCache = &cache;
+  ReportErrorStub errOut;
+  CompiledModule first;
+  ASSERT_TRUE(compile(firstVersion(), first, errOut, options));
+  EXPECT_EQ(cache.statistics().generated, 13);
+  EXPECT_EQ(cache.statistics().reused, 0);
+
+  CompiledModule incremental;
+  ASSERT_TRUE(compile(secondVersion(), incremental, errOut, options));
+  // f4 changed, ext is new and caller calls it directly now.
+  EXPECT_EQ(cache.statistics().generated, 16);
+  EXPECT_EQ(cache.statistics().reused, 11);
+
+  CompiledModule full;
+  ASSERT_TRUE(compile(secondVersion(), full, errOut));
+  EXPECT_EQ(objectOf(incremental), objectOf(full));
+}
+
+TEST(TestFunctionCache, same_on_a_pool_and_without_optimizing) {
+  FunctionCache cache;
+  ThreadPool pool(3);
+  ReportErrorStub errOut;
+  for (const bool optimize : {true, false}) {
+    CompileOptions options;
+    options.optimize = optimize;
+    options.functionCache = &cache;
+    options.pool = &pool;
+    CompiledModule first;
+    ASSERT_TRUE(compile(firstVersion(), first, errOut, options));
+    CompiledModule incremental;
+    ASSERT_TRUE(compile(secondVersion(), incremental, errOut, options));
+
+    CompileOptions fullOptions;
+    fullOptions.optimize = optimize;
+    CompiledModule full;
+    ASSERT_TRUE(compile(secondVersion(), full, errOut, fullOptions));
+    EXPECT_EQ(objectOf(incremental), objectOf(full)) << optimize;
+  }
+  // Code generated without optimizing is another function.
+  EXPECT_EQ(cache.statistics().generated, 32);
+}
+
+TEST(TestFunctionCache, trim_keeps_the_most_recently_used) {
+  FunctionCache cache;
+  CompileOptions options;
+  options.functionCache = &cache;
+  ReportErrorStub errOut;
+  CompiledModule ab;
+  ASSERT_TRUE(compile("int a(void) { return 1; }\n"
+                      "int b(void) { return 2; }\n",
+                      ab, errOut, options));
+  cache.trim(10);
+  CompiledModule bc;
+  ASSERT_TRUE(compile("int b(void) { return 2; }\n"
+                      "int c(void) { return 3; }\n",
+                      bc, errOut, options));
+  EXPECT_EQ(cache.size(), 3);
+  // a was last used in the generation before.
+  cache.trim(2);
+  EXPECT_EQ(cache.size(), 2);
+  const auto reused = cache.statistics().reused;
+  CompiledModule bca;
+  ASSERT_TRUE(compile("int b(void) { return 2; }\n"
+                      "int c(void) { return 3; }\n"
+                      "int a(void) { return 1; }\n",
+                      bca, errOut, options));
+  EXPECT_EQ(cache.statistics().reused, reused + 2);
+  cache.trim(0);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(TestFunctionCache, later_compilers_find_the_functions_on_disk) {
+  const auto directory = testing::TempDir() + "tplcc-function-cache";
+  std::filesystem::remove_all(directory);
+  ResultCache disk(directory);
+  ReportErrorStub errOut;
+  {
+    FunctionCache cache;
+    cache.persistIn(&disk, "compiler 1");
+    CompileOptions options;
+    options.functionCache = &cache;
+    CompiledModule first;
+    ASSERT_TRUE(compile(firstVersion(), first, errOut, options));
+  }
+
+  // Another process, with nothing in memory.
+  FunctionCache cache;
+  cache.persistIn(&disk, "compiler 1");
+  CompileOptions options;
+  options.functionCache = &cache;
+  CompiledModule incremental;
+  ASSERT_TRUE(compile(secondVersion(), incremental, errOut, options));
+  EXPECT_EQ(cache.statistics().generated, 3);
+  EXPECT_EQ(cache.statistics().reused, 11);
+  CompiledModule full;
+  ASSERT_TRUE(compile(secondVersion(), full, errOut));
+  EXPECT_EQ(objectOf(incremental), objectOf(full));
+
+  // The code of another compiler isn't taken.
+  FunctionCache other;
+  other.persistIn(&disk, "compiler 2");
+  options.functionCache = &other;
+  CompiledModule again;
+  ASSERT_TRUE(compile(secondVersion(), again, errOut, options));
+  EXPECT_EQ(other.statistics().reused, 0);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "./utils/helpers.h"
+#include "tplcc/global-value-numbering.h"
+
+TEST(TestGlobalValueNumbering, repeated_addresses_and_loads) {
+  // p->a[i] + p->a[i]
+  EXPECT_EQ(runPass("function i32 @f(ptr %p, i64 %i) {\n"
+                    "b0:\n"
+                    "  %a = add ptr %p, i64 8\n"
+                    "  %o = mul i64 %i, i64 4\n"
+                    "  %e = add ptr %a, %o\n"
+                    "  %x = load i32 %e\n"
+                    "  %a2 = add ptr %p, i64 8\n"
+                    "  %o2 = mul i64 i64 4, %i\n"
+                    "  %e2 = add ptr %a2, %o2\n"
+                    "  %y = load i32 %e2\n"
+                    "  %s = add i32 %x, %y\n"
+                    "  ret %s\n"
+                    "}\n",
+                    numberGlobalValues),
+            "function i32 @f(ptr %0, i64 %1) {\n"
+            "b0:\n"
+            "  %2 = add ptr %0, i64 8\n"
+            "  %3 = mul i64 %1, i64 4\n"
+            "  %4 = add ptr %2, %3\n"
+            "  %5 = load i32 %4\n"
+            "  %6 = add i32 %5, %5\n"
+            "  ret %6\n"
+            "}\n");
+}
+
+TEST(TestGlobalValueNumbering, only_dominating_values_are_reused) {
+  EXPECT_EQ(runPass("function i32 @f(i32 %x, i32 %y) {\n"
+                    "b0:\n"
+                    "  %s = sub i32 %x, %y\n"
+                    "  br %s, b1, b2\n"
+                    "b1:\n"
+                    "  %m = mul i32 %x, %y\n"
+                    "  %t = sub i32 %x, %y\n"
+                    "  %u = sub i32 %y, %x\n"
+                    "  %r = add i32 %m, %t\n"
+                    "  %q = add i32 %r, %u\n"
+                    "  ret %q\n"
+                    "b2:\n"
+                    "  %n = mul i32 %y, %x\n"
+                    "  ret %n\n"
+                    "}\n",
+                    numberGlobalValues),
+            "function i32 @f(i32 %0, i32 %1) {\n"
+            "b0:\n"
+            "  %2 = sub i32 %0, %1\n"
+            "  br %2, b1, b2\n"
+            "b1:\n"
+            "  %3 = mul i32 %0, %1\n"
+            "  %4 = sub i32 %1, %0\n"
+            "  %5 = add i32 %3, %2\n"
+            "  %6 = add i32 %5, %4\n"
+            "  ret %6\n"
+            "b2:\n"
+            "  %7 = mul i32 %1, %0\n"
+            "  ret %7\n"
+            "}\n");
+}
+
+TEST(TestGlobalValueNumbering, loads_are_not_reused_across_stores) {
+  EXPECT_EQ(runPass("extern function @g\n"
+                    "\n"
+                    "function i32 @f(ptr %p, i32 %c) {\n"
+                    "b0:\n"
+                    "  %a = load i32 %p\n"
+                    "  br %c, b1, b2\n"
+                    "b1:\n"
+                    "  %b = load i32 %p\n"
+                    "  store %b, %p\n"
+                    "  %d = load i32 %p\n"
+                    "  jmp b2\n"
+                    "b2:\n"
+                    "  %e = load i32 %p\n"
+                    "  call void @g()\n"
+                    "  %f = load i32 %p\n"
+                    "  %v = load volatile i32 %p\n"
+                    "  %w = load volatile i32 %p\n"
+                    "  ret %f\n"
+                    "}\n",
+                    numberGlobalValues),
+            "extern function @g\n"
+            "\n"
+            "function i32 @f(ptr %0, i32 %1) {\n"
+            "b0:\n"
+            "  %2 = load i32 %0\n"
+            "  br %1, b1, b2\n"
+            "b1:\n"
+            "  store %2, %0\n"
+            "  %3 = load i32 %0\n"
+            "  jmp b2\n"
+            "b2:\n"
+            "  %4 = load i32 %0\n"
+            "  call void @g()\n"
+            "  %5 = load i32 %0\n"
+            "  %6 = load volatile i32 %0\n"
+            "  %7 = load volatile i32 %0\n"
+            "  ret %5\n"
+            "}\n");
+}
+
+TEST(TestGlobalValueNumbering, phis_with_the_same_operands) {
+  EXPECT_EQ(runPass("function i32 @f(i32 %c, i32 %x) {\n"
+                    "b0:\n"
+                    "  br %c, b1, b2\n"
+                    "b1:\n"
+                    "  jmp b2\n"
+                    "b2:\n"
+                    "  %p = phi i32 [%x, b0], [i32 1, b1]\n"
+                    "  %q = phi i32 [%x, b0], [i32 1, b1]\n"
+                    "  %s = add i32 %p, %q\n"
+                    "  ret %s\n"
+                    "}\n",
+                    numberGlobalValues),
+            "function i32 @f(i32 %0, i32 %1) {\n"
+            "b0:\n"
+            "  br %0, b1, b2\n"
+            "b1:\n"
+            "  jmp b2\n"
+            "b2:\n"
+            "  %2 = phi i32 [%1, b0], [i32 1, b1]\n"
+            "  %3 = add i32 %2, %2\n"
+            "  ret %3\n"
+            "}\n");
+}
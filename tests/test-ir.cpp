@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "./mocking/report-error-stub.h"
+#include "tplcc/ir-text.h"
+#include "tplcc/ir.h"
+
+namespace {
+// Parse a module that must be valid and print it again.
+std::string roundTrip(std::string_view text) {
+  Module module;
+  ReportErrorStub errOut;
+  EXPECT_TRUE(parseModule(text, module, errOut));
+  for (const auto& error : errOut.listOfErrors) {
+    ADD_FAILURE() << error.message();
+  }
+  return toText(module);
+}
+
+std::string parseError(std::string_view text) {
+  Module module;
+  ReportErrorStub errOut;
+  EXPECT_FALSE(parseModule(text, module, errOut));
+  return errOut.listOfErrors.empty() ? ""
+                                     : errOut.listOfErrors[0].message();
+}
+}  // namespace
+
+TEST(TestIR, build_a_function) {
+  Module module;
+  module.functions.emplace_back();
+  auto& f = module.functions.back();
+  f.symbol = module.symbol("max");
+  module[f.symbol].isFunction = module[f.symbol].isDefined = true;
+  f.returnType = IRType::I32;
+
+  const auto a = f.addParam(IRType::I32);
+  const auto b = f.addParam(IRType::I32);
+  const auto entry = f.addBlock();
+  const auto then = f.addBlock();
+  const auto join = f.addBlock();
+
+  const ValueID compared[] = {a, b};
+  const auto less = f.append(entry, Opcode::SLt, IRType::I32, compared);
+  f.branch(entry, less, then, join);
+  f.jump(then, join);
+  const auto phi = f.addPhi(join, IRType::I32);
+  f.addPhiOperand(phi, a);
+  f.addPhiOperand(phi, b);
+  const ValueID sum[] = {phi, f.constant(IRType::I32, -1)};
+  f.ret(join, f.append(join, Opcode::Add, IRType::I32, sum));
+
+  EXPECT_EQ(entry, Function::ENTRY);
+  EXPECT_EQ(f.constant(IRType::I32, 0xFFFFFFFF), f.constant(IRType::I32, -1));
+  EXPECT_NE(f.constant(IRType::I64, 0xFFFFFFFF), f.constant(IRType::I32, -1));
+
+  std::string problem;
+  EXPECT_TRUE(verify(f, &problem)) << problem;
+  EXPECT_EQ(toText(module),
+            "function i32 @max(i32 %0, i32 %1) {\n"
+            "b0:\n"
+            "  %2 = slt i32 %0, %1\n"
+            "  br %2, b1, b2\n"
+            "b1:\n"
+            "  jmp b2\n"
+            "b2:\n"
+            "  %3 = phi i32 [%0, b0], [%1, b1]\n"
+            "  %4 = add i32 %3, i32 -1\n"
+            "  ret %4\n"
+            "}\n");
+}
+
+TEST(TestIR, text_round_trips) {
+  const std::string text =
+      "extern function @printf\n"
+      "extern @errno\n"
+      "static global @s, size 7, align 1, readonly, bytes \"hi\\0a\\22\"\n"
+      "global @p, size 16, align 8, reloc 0 @s + 1, reloc 8 @errno - 4\n"
+      "\n"
+      "function i32 @main(i32 %0, ptr %1) {\n"
+      "b0:\n"
+      "  %2 = alloca 8, 8\n"
+      "  store volatile ptr 0, %2\n"
+      "  jmp b1\n"
+      "b1:\n"
+      "  %3 = phi i32 [i32 0, b0], [%6, b2]\n"
+      "  %4 = slt i32 %3, %0\n"
+      "  br %4, b2, b3\n"
+      "b2:\n"
+      "  %5 = call variadic i32 @printf(@s, %3)\n"
+      "  %6 = add i32 %3, i32 1\n"
+      "  jmp b1\n"
+      "b3:\n"
+      "  %7 = load i64 %1\n"
+      "  %8 = trunc i32 %7\n"
+      "  ret %8\n"
+      "}\n"
+      "\n"
+      "static function void @f(...) {\n"
+      "b0:\n"
+      "  call void @f()\n"
+      "  unreachable\n"
+      "}\n";
+  EXPECT_EQ(roundTrip(text), text);
+}
+
+TEST(TestIR, parser_renumbers_and_orders_phi_operands) {
+  EXPECT_EQ(roundTrip("function i64 @f(i64 %n) {\n"
+                      "entry:\n"
+                      "  br %n, loop, exit  ; comment\n"
+                      "exit:\n"
+                      "  %r = phi i64 [%next, loop], [%n, entry]\n"
+                      "  ret %r\n"
+                      "loop:\n"
+                      "  %next = sub i64 %n, i64 1\n"
+                      "  jmp exit\n"
+                      "}\n"),
+            "function i64 @f(i64 %0) {\n"
+            "b0:\n"
+            "  br %0, b2, b1\n"
+            "b1:\n"
+            "  %1 = phi i64 [%0, b0], [%2, b2]\n"
+            "  ret %1\n"
+            "b2:\n"
+            "  %2 = sub i64 %0, i64 1\n"
+            "  jmp b1\n"
+            "}\n");
+}
+
+TEST(TestIR, use_lists) {
+  Module module;
+  ReportErrorStub errOut;
+  ASSERT_TRUE(parseModule("function i32 @f(i32 %a) {\n"
+                          "b0:\n"
+                          "  %b = mul i32 %a, %a\n"
+                          "  %c = add i32 %b, %a\n"
+                          "  ret %c\n"
+                          "}\n",
+                          module, errOut));
+  const auto& f = module.functions[0];
+  const auto a = f.parameters()[0];
+  const auto& insts = f.block(Function::ENTRY).insts;
+  const UseLists uses(f);
+
+  const auto usesOfA = uses.of(a);
+  ASSERT_EQ(usesOfA.size(), 3);
+  EXPECT_EQ(usesOfA[0].user, insts[0]);
+  EXPECT_EQ(usesOfA[0].index, 0);
+  EXPECT_EQ(usesOfA[1].user, insts[0]);
+  EXPECT_EQ(usesOfA[1].index, 1);
+  EXPECT_EQ(usesOfA[2].user, insts[1]);
+  EXPECT_EQ(usesOfA[2].index, 1);
+
+  ASSERT_EQ(uses.of(insts[1]).size(), 1);
+  EXPECT_EQ(uses.of(insts[1])[0].user, insts[2]);
+  EXPECT_TRUE(uses.of(insts[2]).empty());
+}
+
+TEST(TestIR, edit_the_cfg) {
+  Module module;
+  ReportErrorStub errOut;
+  ASSERT_TRUE(parseModule("function i32 @f(i32 %a) {\n"
+                          "b0:\n"
+                          "  br %a, b1, b2\n"
+                          "b1:\n"
+                          "  %b = neg i32 %a\n"
+                          "  jmp b2\n"
+                          "b2:\n"
+                          "  %c = phi i32 [%a, b0], [%b, b1]\n"
+                          "  ret %c\n"
+                          "}\n",
+                          module, errOut));
+  auto& f = module.functions[0];
+
+  // Make b0 jump to b2 only.
+  const auto branch = f.terminator(1);
+  f.remove(branch);
+  f.sweep();
+  f.block(1).numberOfSuccessors = 0;
+  f.removePredecessor(2, 1);
+  f.removePredecessor(3, 1);
+  f.jump(1, 3);
+  f.addPhiOperand(f.block(3).phis[0], f.parameters()[0]);
+  f.removeBlock(2);
+  f.sweep();
+
+  std::string problem;
+  EXPECT_TRUE(verify(f, &problem)) << problem;
+  EXPECT_EQ(toText(f, module),
+            "function i32 @f(i32 %0) {\n"
+            "b0:\n"
+            "  jmp b1\n"
+            "b1:\n"
+            "  %1 = phi i32 [%0, b0]\n"
+            "  ret %1\n"
+            "}\n");
+}
+
+TEST(TestIR, verifier_finds_broken_functions) {
+  Module module;
+  module.functions.emplace_back();
+  auto& f = module.functions.back();
+  const auto entry = f.addBlock();
+  const auto next = f.addBlock();
+  f.jump(entry, next);
+
+  std::string problem;
+  EXPECT_FALSE(verify(f, &problem));
+  EXPECT_EQ(problem, "b2 has no terminator.");
+
+  const auto phi = f.addPhi(next, IRType::I32);
+  f.ret(next, phi);
+  EXPECT_FALSE(verify(f, &problem));
+  EXPECT_EQ(problem, "The phi %2 has 0 operand(s) for 1 predecessor(s).");
+
+  f.addPhiOperand(phi, f.constant(IRType::I32, 1));
+  EXPECT_TRUE(verify(f, &problem)) << problem;
+  f.remove(f.block(next).insts[0]);
+  const ValueID operands[] = {phi};
+  f.append(next, Opcode::Ret, IRType::Void, operands);
+  f.remove(phi);
+  EXPECT_FALSE(verify(f, &problem));
+  EXPECT_EQ(problem, "%2 in the phis of b2 is not a phi of the block.");
+}
+
+TEST(TestIR, parse_errors) {
+  EXPECT_EQ(parseError("function i32 @f() {\n"
+                       "b0:\n"
+                       "  ret %x\n"
+                       "}\n"),
+            "Undefined value %x.");
+  EXPECT_EQ(parseError("function i32 @f() {\n"
+                       "b0:\n"
+                       "  %x = frob i32 1\n"
+                       "}\n"),
+            "Expected an instruction here.");
+  EXPECT_EQ(parseError("function void @f() {\n"
+                       "b0:\n"
+                       "  jmp b1\n"
+                       "}\n"),
+            "Expected a block name here.");
+  EXPECT_EQ(parseError("function void @f() {\n"
+                       "b0:\n"
+                       "  %x = add i32 i32 1, i32 2\n"
+                       "}\n"),
+            "b1 has no terminator.");
+  EXPECT_EQ(parseError("global @g, size 4\n"), "Expected \",\" here.");
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "./mocking/report-error-stub.h"
+#include "tplcc/compilation.h"
+#include "tplcc/jit.h"
+
+namespace {
+struct Loaded {
+  CompiledModule compiled;
+  LoadedModule module;
+  std::string problem;
+  bool isLoaded = false;
+
+  explicit Loaded(std::string_view source,
+                  const LoadedModule::Resolver& resolve = nullptr) {
+    ReportErrorStub errOut;
+    EXPECT_TRUE(compile(source, compiled, errOut));
+    EXPECT_TRUE(errOut.listOfErrors.empty());
+    isLoaded = module.load(compiled.module, compiled.functions, &problem,
+                           resolve);
+  }
+
+  template <typename F>
+  F function(std::string_view name) const {
+    return reinterpret_cast<F>(module.address(name));
+  }
+};
+
+int hostCounter = 0;
+int hostTwice(int x) { return 2 * x + hostCounter; }
+}  // namespace
+
+TEST(TestJit, calls_functions_of_the_module) {
+  Loaded loaded(
+      "int add(int a, int b) { return a + b; }\n"
+      "long fact(long n) { return n <= 1 ? 1 : n * fact(n - 1); }\n");
+  ASSERT_TRUE(loaded.isLoaded) << loaded.problem;
+  EXPECT_EQ(loaded.function<int (*)(int, int)>("add")(20, 22), 42);
+  EXPECT_EQ(loaded.function<long (*)(long)>("fact")(10), 3628800);
+  EXPECT_EQ(loaded.module.address("mul"), nullptr);
+}
+
+TEST(TestJit, calls_into_the_process) {
+  Loaded loaded(
+      "unsigned long strlen(const char *s);\n"
+      "int snprintf(char *buf, unsigned long n, const char *fmt, ...);\n"
+      "char buffer[32];\n"
+      "long f(int x) {\n"
+      "  snprintf(buffer, 32, \"<%d:%s>\", x, \"abc\");\n"
+      "  return strlen(buffer);\n"
+      "}\n");
+  ASSERT_TRUE(loaded.isLoaded) << loaded.problem;
+  EXPECT_EQ(loaded.function<long (*)(int)>("f")(-123), 10);
+  EXPECT_STREQ(static_cast<const char*>(loaded.module.address("buffer")),
+               "<-123:abc>");
+}
+
+TEST(TestJit, resolves_through_the_resolver) {
+  Loaded loaded(
+      "extern int counter;\n"
+      "int twice(int x);\n"
+      "int f(int x) { counter += 1; return twice(x) + counter; }\n",
+      [](const std::string& name) -> void* {
+        if (name == "counter") return &hostCounter;
+        if (name == "twice") return reinterpret_cast<void*>(&hostTwice);
+        return nullptr;
+      });
+  ASSERT_TRUE(loaded.isLoaded) << loaded.problem;
+  hostCounter = 10;
+  EXPECT_EQ(loaded.function<int (*)(int)>("f")(5), 10 + 11 + 11);
+  EXPECT_EQ(hostCounter, 11);
+}
+
+TEST(TestJit, runs_main_with_relocated_globals) {
+  Loaded loaded(
+      "const char *const names[] = {\"zero\", \"one\", \"two\"};\n"
+      "int lengths[3];\n"
+      "int *last = &lengths[2];\n"
+      "int main(int argc, char **argv) {\n"
+      "  for (int i = 0; i < 3; i++)\n"
+      "    for (const char *p = names[i]; *p; p++) lengths[i]++;\n"
+      "  return *last * 10 + argc + (argv[1][0] == 'x');\n"
+      "}\n");
+  ASSERT_TRUE(loaded.isLoaded) << loaded.problem;
+  char program[] = "program";
+  char argument[] = "x";
+  char* argv[] = {program, argument, nullptr};
+  EXPECT_EQ(loaded.module.runMain(2, argv), 33);
+}
+
+TEST(TestJit, reports_unresolved_symbols) {
+  Loaded loaded(
+      "int missing(int x);\n"
+      "int f(int x) { return missing(x); }\n",
+      [](const std::string&) -> void* { return nullptr; });
+  EXPECT_FALSE(loaded.isLoaded);
+  EXPECT_EQ(loaded.problem, "Can't resolve the symbol missing.");
+  EXPECT_EQ(loaded.module.address("f"), nullptr);
+}
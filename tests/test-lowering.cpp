@@ -0,0 +1,274 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "./mocking/report-error-stub.h"
+#include "./mocking/simple-string-scanner.h"
+#include "tplcc/ir-text.h"
+#include "tplcc/ir.h"
+#include "tplcc/lowering.h"
+#include "tplcc/parser.h"
+#include "tplcc/sema.h"
+
+namespace {
+struct Lowered {
+  ReportErrorStub errOut;
+  AST ast;
+  StringInterner strings;
+  TypeTable types;
+  Module module;
+
+  explicit Lowered(const std::string& source) {
+    SimpleStringScanner scanner(source);
+    Lexer lexer(scanner, errOut);
+    Parser parser(lexer, ast, strings, errOut);
+    const auto translationUnit = parser.parseTranslationUnit();
+    Sema sema(ast, strings, types, errOut);
+    sema.check();
+    EXPECT_TRUE(errOut.listOfErrors.empty());
+    Lowering(ast, strings, sema, module, errOut).lower(translationUnit);
+
+    for (const auto& function : module.functions) {
+      std::string problem;
+      EXPECT_TRUE(verify(function, &problem)) << problem;
+    }
+  }
+
+  std::string text() const { return toText(module); }
+};
+
+// The text of a function that must lower without errors.
+std::string lower(const std::string& source) {
+  Lowered lowered(source);
+  for (const auto& error : lowered.errOut.listOfErrors) {
+    ADD_FAILURE() << error.message();
+  }
+  return lowered.text();
+}
+}  // namespace
+
+TEST(TestLowering, scalar_locals_are_values) {
+  EXPECT_EQ(lower("int f(int a, int b) { int x = a + b; x = x * 2; return x; }"),
+            "function i32 @f(i32 %0, i32 %1) {\n"
+            "b0:\n"
+            "  %2 = add i32 %0, %1\n"
+            "  %3 = mul i32 %2, i32 2\n"
+            "  ret %3\n"
+            "}\n");
+}
+
+TEST(TestLowering, phis_where_definitions_meet) {
+  EXPECT_EQ(lower("int max(int a, int b) {\n"
+                  "  int m;\n"
+                  "  if (a > b) m = a; else m = b;\n"
+                  "  return m;\n"
+                  "}\n"),
+            "function i32 @max(i32 %0, i32 %1) {\n"
+            "b0:\n"
+            "  %2 = sgt i32 %0, %1\n"
+            "  br %2, b1, b2\n"
+            "b1:\n"
+            "  jmp b3\n"
+            "b2:\n"
+            "  jmp b3\n"
+            "b3:\n"
+            "  %3 = phi i32 [%0, b1], [%1, b2]\n"
+            "  ret %3\n"
+            "}\n");
+  EXPECT_EQ(lower("int sum(int n) {\n"
+                  "  int s = 0;\n"
+                  "  for (int i = 0; i < n; i++) s += i;\n"
+                  "  return s;\n"
+                  "}\n"),
+            "function i32 @sum(i32 %0) {\n"
+            "b0:\n"
+            "  jmp b1\n"
+            "b1:\n"
+            "  %1 = phi i32 [i32 0, b0], [%5, b3]\n"
+            "  %2 = phi i32 [i32 0, b0], [%4, b3]\n"
+            "  %3 = slt i32 %1, %0\n"
+            "  br %3, b2, b4\n"
+            "b2:\n"
+            "  %4 = add i32 %2, %1\n"
+            "  jmp b3\n"
+            "b3:\n"
+            "  %5 = add i32 %1, i32 1\n"
+            "  jmp b1\n"
+            "b4:\n"
+            "  ret %2\n"
+            "}\n");
+}
+
+TEST(TestLowering, trivial_phis_are_removed) {
+  // k is only read in the loop, the labels are sealed last.
+  EXPECT_EQ(lower("int f(int n, int k) { while (n) n = n - k; return k; }"),
+            "function i32 @f(i32 %0, i32 %1) {\n"
+            "b0:\n"
+            "  jmp b1\n"
+            "b1:\n"
+            "  %2 = phi i32 [%0, b0], [%3, b2]\n"
+            "  br %2, b2, b3\n"
+            "b2:\n"
+            "  %3 = sub i32 %2, %1\n"
+            "  jmp b1\n"
+            "b3:\n"
+            "  ret %1\n"
+            "}\n");
+  EXPECT_EQ(lower("int f(int n) {\n"
+                  "  int r = 0;\n"
+                  "top:\n"
+                  "  if (n) { r += n; n--; goto top; }\n"
+                  "  return r;\n"
+                  "}\n"),
+            "function i32 @f(i32 %0) {\n"
+            "b0:\n"
+            "  jmp b1\n"
+            "b1:\n"
+            "  %1 = phi i32 [%0, b0], [%4, b2]\n"
+            "  %2 = phi i32 [i32 0, b0], [%3, b2]\n"
+            "  br %1, b2, b3\n"
+            "b2:\n"
+            "  %3 = add i32 %2, %1\n"
+            "  %4 = sub i32 %1, i32 1\n"
+            "  jmp b1\n"
+            "b3:\n"
+            "  ret %2\n"
+            "}\n");
+}
+
+TEST(TestLowering, short_circuit_and_switch) {
+  EXPECT_EQ(lower("int f(int a, int b) { return a && b || !a; }"),
+            "function i32 @f(i32 %0, i32 %1) {\n"
+            "b0:\n"
+            "  br %0, b5, b4\n"
+            "b1:\n"
+            "  jmp b3\n"
+            "b2:\n"
+            "  jmp b3\n"
+            "b3:\n"
+            "  %2 = phi i32 [i32 1, b1], [i32 0, b2]\n"
+            "  ret %2\n"
+            "b4:\n"
+            "  br %0, b2, b1\n"
+            "b5:\n"
+            "  br %1, b1, b4\n"
+            "}\n");
+  EXPECT_EQ(lower("int f(int v) {\n"
+                  "  switch (v) { case 1: return 10; case 2: v++; default: break; }\n"
+                  "  return v;\n"
+                  "}\n"),
+            "function i32 @f(i32 %0) {\n"
+            "b0:\n"
+            "  %1 = eq i32 %0, i32 1\n"
+            "  br %1, b2, b5\n"
+            "b1:\n"
+            "  ret %3\n"
+            "b2:\n"
+            "  ret i32 10\n"
+            "b3:\n"
+            "  %2 = add i32 %0, i32 1\n"
+            "  jmp b4\n"
+            "b4:\n"
+            "  %3 = phi i32 [%0, b6], [%2, b3]\n"
+            "  jmp b1\n"
+            "b5:\n"
+            "  %4 = eq i32 %0, i32 2\n"
+            "  br %4, b3, b6\n"
+            "b6:\n"
+            "  jmp b4\n"
+            "}\n");
+}
+
+TEST(TestLowering, objects_in_memory) {
+  EXPECT_EQ(lower("void g(int *);\n"
+                  "int f(void) { int x = 1; g(&x); return x; }\n"),
+            "extern function @g\n"
+            "\n"
+            "function i32 @f() {\n"
+            "b0:\n"
+            "  %0 = alloca 4, 4\n"
+            "  store i32 1, %0\n"
+            "  call void @g(%0)\n"
+            "  %1 = load i32 %0\n"
+            "  ret %1\n"
+            "}\n");
+  EXPECT_EQ(lower("struct S { int x; char c[3]; long y; };\n"
+                  "long f(int v) {\n"
+                  "  struct S s = {v, \"ab\"};\n"
+                  "  struct S u = s;\n"
+                  "  return u.y + s.x;\n"
+                  "}\n"),
+            "extern function @memset\n"
+            "extern function @memcpy\n"
+            "static global @.L.str.0, size 3, align 1, readonly, bytes \"ab\"\n"
+            "\n"
+            "function i64 @f(i32 %0) {\n"
+            "b0:\n"
+            "  %1 = alloca 16, 8\n"
+            "  %2 = alloca 16, 8\n"
+            "  %3 = call ptr @memset(%1, i32 0, i64 16)\n"
+            "  store %0, %1\n"
+            "  %4 = add ptr %1, i64 4\n"
+            "  %5 = call ptr @memcpy(%4, @.L.str.0, i64 3)\n"
+            "  %6 = call ptr @memcpy(%2, %1, i64 16)\n"
+            "  %7 = add ptr %2, i64 8\n"
+            "  %8 = load i64 %7\n"
+            "  %9 = load i32 %1\n"
+            "  %10 = sext i64 %9\n"
+            "  %11 = add i64 %8, %10\n"
+            "  ret %11\n"
+            "}\n");
+}
+
+TEST(TestLowering, pointer_arithmetic) {
+  EXPECT_EQ(lower("long f(int *p, int *q) { return q - p + *(p - 1) + p[2]; }"),
+            "function i64 @f(ptr %0, ptr %1) {\n"
+            "b0:\n"
+            "  %2 = copy i64 %1\n"
+            "  %3 = copy i64 %0\n"
+            "  %4 = sub i64 %2, %3\n"
+            "  %5 = sdiv i64 %4, i64 4\n"
+            "  %6 = add ptr %0, i64 -4\n"
+            "  %7 = load i32 %6\n"
+            "  %8 = sext i64 %7\n"
+            "  %9 = add i64 %5, %8\n"
+            "  %10 = add ptr %0, i64 8\n"
+            "  %11 = load i32 %10\n"
+            "  %12 = sext i64 %11\n"
+            "  %13 = add i64 %9, %12\n"
+            "  ret %13\n"
+            "}\n");
+}
+
+TEST(TestLowering, globals_and_string_literals) {
+  EXPECT_EQ(lower("static const char *s = \"hi\";\n"
+                  "int a[3] = {1, 2};\n"
+                  "int *p = &a[1];\n"
+                  "extern int e;\n"
+                  "char *f(void) { static char buf[4]; return \"hi\" + e; }\n"),
+            "extern @e\n"
+            "static global @.L.str.0, size 3, align 1, readonly, bytes \"hi\"\n"
+            "static global @s, size 8, align 8, reloc 0 @.L.str.0\n"
+            "global @a, size 12, align 4, bytes \"\\01\\00\\00\\00\\02\\00\\00\\00\"\n"
+            "global @p, size 8, align 8, reloc 0 @a + 4\n"
+            "static global @buf.0, size 4, align 1\n"
+            "\n"
+            "function ptr @f() {\n"
+            "b0:\n"
+            "  %0 = load i32 @e\n"
+            "  %1 = sext i64 %0\n"
+            "  %2 = add ptr @.L.str.0, %1\n"
+            "  ret %2\n"
+            "}\n");
+}
+
+TEST(TestLowering, unsupported_constructs) {
+  Lowered lowered("double f(double x) { return x * 2; }\n"
+                  "int g;\n"
+                  "int *p = (int *)&g + g;\n");
+  ASSERT_EQ(lowered.errOut.listOfErrors.size(), 3);
+  EXPECT_EQ(lowered.errOut.listOfErrors[0].id(),
+            ErrorID::UnsupportedConstruct);
+  EXPECT_EQ(lowered.errOut.listOfErrors[2].id(),
+            ErrorID::NotConstantInitializer);
+}
@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "./mocking/report-error-stub.h"
+#include "tplcc/buffered-writer.h"
+#include "tplcc/code-generation.h"
+#include "tplcc/ir-text.h"
+#include "tplcc/machine-code.h"
+#include "tplcc/object-writer.h"
+#include "tplcc/thread-pool.h"
+
+namespace {
+using X86::Condition;
+using X86::Instruction;
+using X86::Mnemonic;
+using X86::Operand;
+
+Operand reg(X86::Register reg) { return Operand::registerOperand(reg); }
+
+std::string encodeOne(Instruction inst) {
+  MachineFunction function;
+  function.code.push_back(inst);
+  MachineCode code;
+  encode(function, code);
+  return code.bytes;
+}
+
+std::uint64_t field(const std::string& bytes, std::size_t offset,
+                    std::size_t size) {
+  std::uint64_t value = 0;
+  for (std::size_t i = size; i-- > 0;) {
+    value = value << 8 | static_cast<unsigned char>(bytes[offset + i]);
+  }
+  return value;
+}
+}  // namespace
+
+TEST(TestMachineCode, instructions) {
+  EXPECT_EQ(encodeOne({Mnemonic::Mov, 8, 0, {}, reg(X86::RAX), reg(X86::RDI)}),
+            "\x48\x89\xf8");
+  EXPECT_EQ(encodeOne({Mnemonic::Add, 4, 0, {}, reg(X86::RAX),
+                       Operand::immediate(1000)}),
+            std::string("\x05\xe8\x03\x00\x00", 5));
+  EXPECT_EQ(encodeOne({Mnemonic::Sub, 8, 0, {}, reg(X86::RSP),
+                       Operand::immediate(16)}),
+            "\x48\x83\xec\x10");
+  EXPECT_EQ(encodeOne({Mnemonic::MovZX, 4, 1, {}, reg(X86::RAX),
+                       reg(X86::RSI)}),
+            "\x40\x0f\xb6\xc6");
+  EXPECT_EQ(encodeOne({Mnemonic::SetCC, 1, 0, Condition::Less, reg(X86::RDI)}),
+            "\x40\x0f\x9c\xc7");
+  EXPECT_EQ(encodeOne({Mnemonic::Mov, 8, 0, {},
+                       Operand::memory(X86::RBP, -8), reg(X86::R12)}),
+            "\x4c\x89\x65\xf8");
+  EXPECT_EQ(encodeOne({Mnemonic::Lea, 8, 0, {}, reg(X86::R13),
+                       Operand::memory(X86::RSP, 0)}),
+            "\x4c\x8d\x2c\x24");
+  EXPECT_EQ(encodeOne({Mnemonic::Mov, 8, 0, {}, reg(X86::R10),
+                       Operand::immediate(0x123456789)}),
+            std::string("\x49\xba\x89\x67\x45\x23\x01\x00\x00\x00", 10));
+  EXPECT_EQ(encodeOne({Mnemonic::Shl, 4, 0, {}, reg(X86::RDX), reg(X86::RCX)}),
+            "\xd3\xe2");
+  EXPECT_EQ(encodeOne({Mnemonic::IDiv, 8, 0, {}, reg(X86::R10)}),
+            "\x49\xf7\xfa");
+  EXPECT_EQ(encodeOne({Mnemonic::Push, 8, 0, {}, reg(X86::R15)}), "\x41\x57");
+  EXPECT_EQ(encodeOne({Mnemonic::Call, 8, 0, {}, reg(X86::R10)}),
+            "\x41\xff\xd2");
+}
+
+TEST(TestMachineCode, relocations_are_relative_to_the_instruction_end) {
+  // movl $5, sym+8(%rip): the immediate comes after the displacement.
+  MachineFunction function;
+  function.code.push_back({Mnemonic::Mov, 4, 0, {},
+                           Operand::ripRelative(7, false, 8),
+                           Operand::immediate(5)});
+  function.code.push_back({Mnemonic::Call, 8, 0, {},
+                           Operand::symbolOperand(9, true)});
+  MachineCode code;
+  code.bytes = "\x90";
+  encode(function, code);
+  ASSERT_EQ(code.relocations.size(), 2u);
+  EXPECT_EQ(code.relocations[0].offset, 3u);
+  EXPECT_EQ(code.relocations[0].symbol, 7u);
+  EXPECT_EQ(code.relocations[0].kind, CodeRelocation::Kind::PC32);
+  EXPECT_EQ(code.relocations[0].addend, 8 - 8);
+  EXPECT_EQ(code.relocations[1].offset, 12u);
+  EXPECT_EQ(code.relocations[1].kind, CodeRelocation::Kind::PLT32);
+  EXPECT_EQ(code.relocations[1].addend, -4);
+}
+
+TEST(TestMachineCode, jumps_grow_when_they_dont_reach) {
+  // A conditional jump over 40 four-byte instructions, 160 bytes, and a
+  // jump back over a short one to the start.
+  MachineFunction function;
+  function.numberOfLabels = 2;
+  function.code.push_back({Mnemonic::Label, 8, 0, {}, Operand::label(0)});
+  function.code.push_back(
+      {Mnemonic::Jcc, 1, 0, Condition::Equal, Operand::label(1)});
+  for (int i = 0; i < 40; i++) {
+    function.code.push_back({Mnemonic::Add, 8, 0, {}, reg(X86::RAX),
+                             Operand::immediate(1)});
+  }
+  function.code.push_back({Mnemonic::Label, 8, 0, {}, Operand::label(1)});
+  function.code.push_back({Mnemonic::Jmp, 8, 0, {}, Operand::label(1)});
+  function.code.push_back({Mnemonic::Jmp, 8, 0, {}, Operand::label(0)});
+  MachineCode code;
+  encode(function, code);
+
+  ASSERT_EQ(code.bytes.size(), 6u + 160 + 2 + 5);
+  EXPECT_EQ(code.bytes.substr(0, 2), "\x0f\x84");
+  EXPECT_EQ(field(code.bytes, 2, 4), 160u);
+  EXPECT_EQ(code.bytes.substr(166, 2), "\xeb\xfe");
+  EXPECT_EQ(static_cast<unsigned char>(code.bytes[168]), 0xe9);
+  EXPECT_EQ(static_cast<std::int32_t>(field(code.bytes, 169, 4)), -173);
+}
+
+TEST(TestMachineCode, object_file) {
+  Module module;
+  ReportErrorStub errOut;
+  ASSERT_TRUE(parseModule(
+      "extern function @g\n"
+      "static global @s, size 3, align 1, readonly, bytes \"hi\"\n"
+      "global @p, size 8, align 8, reloc 0 @s + 1\n"
+      "function i32 @f() {\n"
+      "b0:\n"
+      "  %r = call i32 @g(@s)\n"
+      "  ret %r\n"
+      "}\n",
+      module, errOut));
+  std::vector<MachineFunction> functions;
+  for (auto& function : module.functions) {
+    functions.push_back(generateCode(function, module));
+  }
+  std::ostringstream os;
+  {
+    BufferedWriter out(os);
+    writeObject(module, functions, out);
+  }
+  const auto object = os.str();
+
+  ASSERT_GE(object.size(), 64u);
+  EXPECT_EQ(object.substr(0, 4), "\x7f" "ELF");
+  EXPECT_EQ(field(object, 16, 2), 1u);   // ET_REL
+  EXPECT_EQ(field(object, 18, 2), 62u);  // EM_X86_64
+  const auto headers = field(object, 40, 8);
+  const auto count = field(object, 60, 2);
+  const auto names = field(object, 62, 2);
+  ASSERT_EQ(object.size(), headers + 64 * count);
+  const auto nameTable = field(object, headers + 64 * names + 24, 8);
+
+  std::vector<std::string> sections;
+  std::uint64_t symbolTable = 0;
+  for (std::uint64_t i = 0; i < count; i++) {
+    const auto header = headers + 64 * i;
+    sections.emplace_back(object.c_str() + nameTable +
+                          field(object, header, 4));
+    if (field(object, header + 4, 4) == 2) symbolTable = header;
+  }
+  EXPECT_EQ(sections,
+            (std::vector<std::string>{"", ".text", ".data", ".data.rel.ro",
+                                      ".rodata", ".bss", ".note.GNU-stack",
+                                      ".rela.text", ".rela.data", ".symtab",
+                                      ".strtab", ".shstrtab"}));
+
+  // The local s first, then the defined p and f, then g.
+  ASSERT_NE(symbolTable, 0u);
+  const auto symbols = field(object, symbolTable + 24, 8);
+  const auto strings =
+      field(object, headers + 64 * field(object, symbolTable + 40, 4) + 24, 8);
+  EXPECT_EQ(field(object, symbolTable + 32, 8), 5u * 24);
+  EXPECT_EQ(field(object, symbolTable + 44, 4), 2u);
+  std::vector<std::string> symbolNames;
+  for (int i = 1; i < 5; i++) {
+    symbolNames.emplace_back(object.c_str() + strings +
+                             field(object, symbols + 24 * i, 4));
+  }
+  EXPECT_EQ(symbolNames, (std::vector<std::string>{"s", "p", "f", "g"}));
+}
+
+TEST(TestMachineCode, encoding_on_a_pool_joins_functions_in_order) {
+  std::vector<MachineFunction> functions(20);
+  for (std::uint32_t i = 0; i < functions.size(); i++) {
+    for (std::uint32_t j = 0; j <= i; j++) {
+      functions[i].code.push_back({Mnemonic::Add, 8, 0, {}, reg(X86::RAX),
+                                   Operand::immediate(j)});
+    }
+    functions[i].code.push_back({Mnemonic::Call, 8, 0, {},
+                                 Operand::symbolOperand(i, true)});
+  }
+
+  MachineCode serial;
+  const auto serialStarts = encodeAll(functions, serial);
+  ThreadPool pool(3);
+  MachineCode parallel;
+  const auto parallelStarts = encodeAll(functions, parallel, &pool);
+
+  EXPECT_EQ(parallel.bytes, serial.bytes);
+  EXPECT_EQ(parallelStarts, serialStarts);
+  ASSERT_EQ(parallel.relocations.size(), functions.size());
+  for (std::size_t i = 0; i < functions.size(); i++) {
+    EXPECT_EQ(parallel.relocations[i].offset, serial.relocations[i].offset);
+    EXPECT_EQ(parallel.relocations[i].symbol, i);
+  }
+}
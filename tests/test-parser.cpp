@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "./mocking/report-error-stub.h"
+#include "./mocking/simple-string-scanner.h"
+#include "tplcc/ast.h"
+#include "tplcc/parser.h"
+
+namespace {
+struct ParseResult {
+  std::string tree;
+  std::vector<Error> errors;
+};
+
+ParseResult parseTranslationUnit(const std::string& source) {
+  ReportErrorStub errOut;
+  SimpleStringScanner scanner(source);
+  Lexer lexer(scanner, errOut);
+  AST ast;
+  StringInterner strings;
+  Parser parser(lexer, ast, strings, errOut);
+
+  const auto unit = parser.parseTranslationUnit();
+  return {toSExpression(ast, strings, unit), errOut.listOfErrors};
+}
+
+std::string parseExpression(const std::string& source) {
+  ReportErrorStub errOut;
+  SimpleStringScanner scanner(source);
+  Lexer lexer(scanner, errOut);
+  AST ast;
+  StringInterner strings;
+  Parser parser(lexer, ast, strings, errOut);
+
+  const auto expr = parser.parseExpression();
+  EXPECT_TRUE(errOut.listOfErrors.empty());
+  return toSExpression(ast, strings, expr);
+}
+}  // namespace
+
+TEST(TestParser, binary_operators_follow_precedence_and_associativity) {
+  EXPECT_EQ(parseExpression("a + b * c - d"), "(- (+ a (* b c)) d)");
+  EXPECT_EQ(parseExpression("a || b && c | d ^ e & f == g < h << i"),
+            "(|| a (&& b (| c (^ d (& e (== f (< g (<< h i))))))))");
+  EXPECT_EQ(parseExpression("a = b += c ? d : e ? f : g"),
+            "(= a (+= b (? c d (? e f g))))");
+  EXPECT_EQ(parseExpression("a, b = 1"), "(, a (= b 1))");
+}
+
+TEST(TestParser, unary_and_postfix_operators) {
+  EXPECT_EQ(parseExpression("-*p++"), "(- (* (post++ p)))");
+  EXPECT_EQ(parseExpression("!~++x"), "(! (~ (pre++ x)))");
+  EXPECT_EQ(parseExpression("f(a, b)[1].x->y"),
+            "(-> (. ([] (call f a b) 1) x) y)");
+  EXPECT_EQ(parseExpression("sizeof x + sizeof(int*)"),
+            "(+ (sizeof x) (sizeof (* int)))");
+  EXPECT_EQ(parseExpression("(unsigned long long)1.5e3"),
+            "(cast unsigned long long 1.5e3)");
+}
+
+TEST(TestParser, adjacent_string_literals_are_concatenated) {
+  EXPECT_EQ(parseExpression("\"a\\tb\" \"\\x41\\101\""), "\"a\tbAA\"");
+}
+
+TEST(TestParser, declarators_build_types_inside_out) {
+  const auto result = parseTranslationUnit(
+      "int *a[3];\n"
+      "int (*p)[3];\n"
+      "char *(*f)(int, ...);\n"
+      "const unsigned x = 1, *const y;\n");
+  EXPECT_TRUE(result.errors.empty());
+  EXPECT_EQ(result.tree,
+            "(translation-unit"
+            " (decls (var a ([] (* int) 3)))"
+            " (decls (var p (* ([] int 3))))"
+            " (decls (var f (* (fn (* char) (param int) ...))))"
+            " (decls (var x const unsigned 1) (var y (* const const unsigned)))"
+            ")");
+}
+
+TEST(TestParser, typedef_names_disambiguate_casts) {
+  const auto result = parseTranslationUnit(
+      "typedef int T;\n"
+      "int a, x;\n"
+      "void f(void) { a = (T)*x; a = (a)*x; }\n"
+      "void g(void) { int T; a = (T)*x; }\n");
+  EXPECT_TRUE(result.errors.empty());
+  EXPECT_EQ(result.tree,
+            "(translation-unit"
+            " (decls (typedef T int))"
+            " (decls (var a int) (var x int))"
+            " (function-definition (function f (fn void))"
+            " (compound (expr (= a (cast T (* x)))) (expr (= a (* a x)))))"
+            " (function-definition (function g (fn void))"
+            " (compound (decls (var T int)) (expr (= a (* T x)))))"
+            ")");
+}
+
+TEST(TestParser, struct_and_enum_definitions) {
+  const auto result = parseTranslationUnit(
+      "struct list { int value : 4; struct list *next; };\n"
+      "enum color { RED, GREEN = 2, };\n"
+      "union u { int i; float f; } v = { .f = 1.0, [0] = 2 };\n");
+  EXPECT_TRUE(result.errors.empty());
+  EXPECT_EQ(result.tree,
+            "(translation-unit"
+            " (decls (struct list (field value int 4) (field next (* (struct list)))))"
+            " (decls (enum color (enumerator RED) (enumerator GREEN 2)))"
+            " (decls (var v (union u (field i int) (field f float))"
+            " {(designation .f 1.0) (designation [0] 2)}))"
+            ")");
+}
+
+TEST(TestParser, statements) {
+  const auto result = parseTranslationUnit(
+      "int f(int n) {\n"
+      "  for (int i = 0; i < n; i++) { if (i) continue; else break; }\n"
+      "  switch (n) { case 1: return 1; default: ; }\n"
+      "  do n--; while (n);\n"
+      "again:\n"
+      "  while (n) goto again;\n"
+      "  return;\n"
+      "}\n");
+  EXPECT_TRUE(result.errors.empty());
+  EXPECT_EQ(result.tree,
+            "(translation-unit"
+            " (function-definition (function f (fn int (param n int)))"
+            " (compound"
+            " (for (decls (var i int 0)) (< i n) (post++ i)"
+            " (compound (if i (continue) (break))))"
+            " (switch n (compound (case 1 (return 1)) (default (expr))))"
+            " (do (expr (post-- n)) n)"
+            " (label again (while n (goto again)))"
+            " (return)))"
+            ")");
+}
+
+TEST(TestParser, identifiers_are_resolved_to_declarations) {
+  ReportErrorStub errOut;
+  SimpleStringScanner scanner(
+      "int x;\n"
+      "int f(int x) { { int x; x; } return x + y; }\n");
+  Lexer lexer(scanner, errOut);
+  AST ast;
+  StringInterner strings;
+  Parser parser(lexer, ast, strings, errOut);
+  parser.parseTranslationUnit();
+
+  std::vector<NodeID> references;
+  for (NodeID id = 1; id < ast.size(); id++) {
+    if (ast[id].kind == NodeKind::Identifier) references.push_back(id);
+  }
+  ASSERT_EQ(references.size(), 3);
+  EXPECT_EQ(ast[ast[references[0]].a].kind, NodeKind::VarDecl);
+  EXPECT_EQ(ast[ast[references[1]].a].kind, NodeKind::ParamDecl);
+  EXPECT_EQ(ast[references[2]].a, 0);
+}
+
+TEST(TestParser, recovers_from_syntax_errors) {
+  const auto result = parseTranslationUnit(
+      "int a = ;\n"
+      "int f(void) { a = 1 b = 2; return a; }\n"
+      "int c;\n");
+  ASSERT_EQ(result.errors.size(), 2);
+  EXPECT_EQ(result.errors[0].id(), ErrorID::ExpectedExpression);
+  EXPECT_EQ(result.errors[0].range(), std::make_tuple(8u, 9u));
+  EXPECT_EQ(result.errors[1].message(), "Expected ';' here.");
+  EXPECT_EQ(result.tree,
+            "(translation-unit"
+            " (function-definition (function f (fn int))"
+            " (compound (return a)))"
+            " (decls (var c int))"
+            ")");
+}
+
+TEST(TestParser, reports_misplaced_jumps_and_labels) {
+  const auto result = parseTranslationUnit(
+      "void f(void) { break; continue; case 1: ; goto out; }\n");
+  ASSERT_EQ(result.errors.size(), 4);
+  EXPECT_EQ(result.errors[0].id(), ErrorID::BreakOutsideLoopOrSwitch);
+  EXPECT_EQ(result.errors[1].id(), ErrorID::ContinueOutsideLoop);
+  EXPECT_EQ(result.errors[2].message(),
+            "The case label is not in a switch statement.");
+  EXPECT_EQ(result.errors[3].message(), "Use of undefined label \"out\".");
+}
+
+TEST(TestAST, reset_keeps_only_the_null_node) {
+  AST ast;
+  Node node;
+  node.kind = NodeKind::BreakStmt;
+  const auto first = ast.add(node);
+  EXPECT_EQ(first, 1);
+
+  const auto mark = ast.beginList();
+  ast.pushToList(first);
+  EXPECT_EQ(ast.list(ast.endList(mark)).size(), 1);
+
+  ast.reset();
+  EXPECT_EQ(ast.size(), 1);
+  EXPECT_EQ(ast.add(node), 1);
+}
+
+TEST(TestParser, expression_parsing_calls_per_operand_are_constant) {
+  const auto callsPerPrimary = [](const std::string& source) {
+    ReportErrorStub errOut;
+    SimpleStringScanner scanner(source);
+    Lexer lexer(scanner, errOut);
+    AST ast;
+    StringInterner strings;
+    Parser parser(lexer, ast, strings, errOut);
+    parser.parseExpression();
+    return static_cast<double>(parser.stats().expressionCalls) /
+           static_cast<double>(parser.stats().primaryExpressions);
+  };
+
+  // A primary expression costs one call of each of parseExpression,
+  // parseCastExpression, parseUnaryExpression and parsePrimaryExpression,
+  // however many precedence levels lie between the operators.
+  EXPECT_EQ(callsPerPrimary("a"), 4);
+  EXPECT_EQ(callsPerPrimary("a * b * c * d"), 4);
+  EXPECT_EQ(callsPerPrimary("a || b && c | d ^ e & f == g < h << i + j * k"), 4);
+  EXPECT_EQ(callsPerPrimary("a * b + c << d < e == f & g ^ h | i && j || k"), 4);
+}
@@ -3,6 +3,7 @@
 #include <memory>
 #include <string>
 
+#include "./mocking/include-files-stub.h"
 #include "./mocking/report-error-stub.h"
 #include "./utils/helpers.h"
 #include "tplcc/code-buffer.h"
@@ -14,15 +15,18 @@ class TestPreprocessor : public ::testing::Test {
   std::unique_ptr<Preprocessor<>> pp;
   std::unique_ptr<CodeBuffer> codeBuffer;
 
-  std::string scanInput(const std::string& inputStr) {
-    setUpPreprocessor(inputStr);
+  std::string scanInput(const std::string& inputStr,
+                        PreprocessorOptions options = {}) {
+    setUpPreprocessor(inputStr, std::move(options));
     return exhaustPreprocessor();
   }
 
-  void setUpPreprocessor(const std::string& inputStr) {
+  void setUpPreprocessor(const std::string& inputStr,
+                         PreprocessorOptions options = {}) {
     codeBuffer = std::make_unique<CodeBuffer>(inputStr);
     errOut = std::make_unique<ReportErrorStub>();
-    pp = std::make_unique<Preprocessor<>>(*codeBuffer, *errOut);
+    pp = std::make_unique<Preprocessor<>>(*codeBuffer, *errOut,
+                                          std::move(options));
   }
 
  private:
@@ -127,6 +131,188 @@ TEST_F(TestPreprocessor, define_directive_in_a_string) {
   EXPECT_EQ(scanInput(s), s);
 }
 
+TEST_F(TestPreprocessor, conditional_inclusion) {
+  EXPECT_EQ(scanInput("#define FOO 2\n"
+                      "#if FOO * 2 == 4 && defined(FOO) && !defined BAR\n"
+                      "a\n"
+                      "#else\n"
+                      "b\n"
+                      "#endif\n"),
+            "a");
+
+  EXPECT_EQ(scanInput("#ifdef FOO\n"
+                      "a\n"
+                      "#elif UNDEFINED + 1\n"
+                      "b\n"
+                      "#elif 1\n"
+                      "c\n"
+                      "#endif\n"),
+            "b");
+
+  // Nested groups are skipped as a whole, and so are the directives and the
+  // comments in them.
+  EXPECT_EQ(scanInput("#ifndef FOO\n"
+                      "#define FOO 1\n"
+                      "#endif\n"
+                      "#if 0\n"
+                      "#if 1\n"
+                      "a /*\n"
+                      "#else */ it's\n"
+                      "#endif\n"
+                      "#define FOO 0\n"
+                      "#else\n"
+                      "FOO\n"
+                      "#endif\n"),
+            "1");
+  EXPECT_TRUE(errOut->listOfErrors.empty());
+
+  // Function-like macros are expanded in the condition.
+  EXPECT_EQ(scanInput("#define MAX(a, b) ((a) > (b) ? (a) : (b))\n"
+                      "#if MAX(1, 3) == 3\n"
+                      "x\n"
+                      "#endif\n"),
+            "x");
+}
+
+TEST_F(TestPreprocessor, unbalanced_conditional_directives) {
+  scanInput("#endif\n"
+            "#if 1\n"
+            "#else\n"
+            "#else\n"
+            "#endif\n"
+            "#if 1 / 0\n"
+            "#endif\n"
+            "#ifdef FOO\n");
+  const auto& errors = errOut->listOfErrors;
+  ASSERT_EQ(errors.size(), 4);
+  EXPECT_EQ(errors[0].message(), "#endif without #if.");
+  EXPECT_EQ(errors[1].message(), "#else after #else.");
+  EXPECT_EQ(errors[2].id(), ErrorID::DivisionByZero);
+  EXPECT_EQ(errors[3].id(), ErrorID::UnterminatedConditional);
+}
+
+TEST_F(TestPreprocessor, expansion_records_invocation_and_definition) {
+  EXPECT_EQ(scanInput("#define FOO 1\n"
+                      "#define BAR(x) x + FOO\n"
+                      "int a = BAR(2);"),
+            "int a = 2 + 1;");
+  ASSERT_EQ(codeBuffer->sectionCount(), 3);
+
+  // BAR(2) is expanded first, FOO is invoked inside BAR's expansion.
+  const auto& bar = codeBuffer->sectionOrigin(1);
+  EXPECT_EQ(bar.invocationStart, 45);
+  EXPECT_EQ(bar.invocationEnd, 51);
+  EXPECT_EQ(bar.definitionStart, 14);
+  EXPECT_EQ(bar.definitionEnd, 36);
+
+  const auto& foo = codeBuffer->sectionOrigin(2);
+  EXPECT_EQ(codeBuffer->sectionOf(foo.invocationStart), 1);
+  EXPECT_EQ(foo.invocationEnd - foo.invocationStart, 3);
+  EXPECT_EQ(foo.definitionStart, 0);
+  EXPECT_EQ(foo.definitionEnd, 13);
+}
+
+TEST_F(TestPreprocessor, directives_keep_tokens_apart) {
+  EXPECT_EQ(scanInput("a\n"
+                      "#define X 1\n"
+                      "b"),
+            "a b");
+}
+
+TEST_F(TestPreprocessor, identifiers_with_underscores_and_digits) {
+  EXPECT_EQ(scanInput("#define FOO_BAR2 1\n"
+                      "FOO_BAR2 FOO"),
+            "1 FOO");
+}
+
+TEST_F(TestPreprocessor, predefined_macros) {
+  PreprocessorOptions options;
+  options.predefinedMacros.emplace_back("N", "1");
+  options.predefinedMacros.emplace_back("N", "2");
+  options.predefinedMacros.emplace_back(
+      "ADD", std::vector<std::string>{"a", "b"}, "a + b");
+  EXPECT_EQ(scanInput("ADD(N, 3)", std::move(options)), "2 + 3");
+  EXPECT_TRUE(errOut->listOfErrors.empty());
+}
+
+TEST_F(TestPreprocessor, include_files) {
+  IncludeFilesStub files;
+  files.files["a.h"] =
+      "#ifndef A_H\n"
+      "#define A_H\n"
+      "#include <b.h>\n"
+      "int a = B;\n"
+      "#endif";
+  files.files["b.h"] = "#define B 2\n";
+  PreprocessorOptions options;
+  options.includeFiles = &files;
+
+  EXPECT_EQ(scanInput("#include \"a.h\"\n"
+                      "#include \"a.h\"\n"
+                      "int c = B;",
+                      std::move(options)),
+            "int a = 2; int c = 2;");
+  EXPECT_TRUE(errOut->listOfErrors.empty());
+  EXPECT_EQ(files.includers, (std::vector<std::string>{"", "a.h", ""}));
+
+  // a.h is the first section, invoked by the directive.
+  const auto& a = codeBuffer->sectionOrigin(1);
+  EXPECT_EQ(a.includedFile, "a.h");
+  EXPECT_EQ(a.invocationStart, 0);
+  EXPECT_EQ(a.invocationEnd, 14);
+  EXPECT_TRUE(codeBuffer->isFileSection(0));
+  EXPECT_TRUE(codeBuffer->isFileSection(1));
+}
+
+TEST_F(TestPreprocessor, include_guard_skips_the_file) {
+  IncludeFilesStub files;
+  files.files["a.h"] =
+      "#ifndef A_H\n"
+      "#define A_H\n"
+      "int a;\n"
+      "#endif\n";
+  files.includeGuards["a.h"] = "A_H";
+  PreprocessorOptions options;
+  options.includeFiles = &files;
+
+  EXPECT_EQ(scanInput("#include \"a.h\"\n"
+                      "#include \"a.h\"\n"
+                      "#include \"a.h\"\n",
+                      std::move(options)),
+            "int a;");
+  EXPECT_TRUE(errOut->listOfErrors.empty());
+  // Only the include while A_H isn't defined adds a section.
+  int numberOfIncludes = 0;
+  for (CodeBuffer::SectionID id = 0; id < codeBuffer->sectionCount(); id++) {
+    if (codeBuffer->sectionOrigin(id).includedFile == "a.h") {
+      numberOfIncludes++;
+    }
+  }
+  EXPECT_EQ(numberOfIncludes, 1);
+}
+
+TEST_F(TestPreprocessor, include_errors) {
+  IncludeFilesStub files;
+  files.files["self.h"] = "#include \"self.h\"\n";
+  PreprocessorOptions options;
+  options.includeFiles = &files;
+
+  scanInput("#include \"missing.h\"\n"
+            "#include missing.h\n"
+            "#include \"self.h\"\n",
+            std::move(options));
+  const auto& errors = errOut->listOfErrors;
+  ASSERT_EQ(errors.size(), 3);
+  EXPECT_EQ(errors[0].message(), "Can't find the included file missing.h.");
+  EXPECT_EQ(errors[1].id(), ErrorID::ExpectedHeaderName);
+  EXPECT_EQ(errors[2].id(), ErrorID::IncludeNestedTooDeeply);
+
+  // Without include files, there is nowhere to look.
+  scanInput("#include <stdio.h>\n");
+  ASSERT_EQ(errOut->listOfErrors.size(), 1);
+  EXPECT_EQ(errOut->listOfErrors[0].id(), ErrorID::IncludedFileNotFound);
+}
+
 TEST_F(TestPreprocessor, test_encoding) {
   const auto s = fromUTF8(std::u8string{u8""});
   setUpPreprocessor(s);
@@ -0,0 +1,363 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./mocking/report-error-stub.h"
+#include "./mocking/simple-string-scanner.h"
+#include "tplcc/ir-text.h"
+#include "tplcc/ir.h"
+#include "tplcc/lowering.h"
+#include "tplcc/parser.h"
+#include "tplcc/register-allocation.h"
+#include "tplcc/sema.h"
+
+namespace {
+using Key = std::pair<Location::Kind, std::uint32_t>;
+
+Key keyOf(const Location& location) {
+  return {location.kind, location.kind == Location::Kind::Register
+                             ? location.reg
+                             : location.slot};
+}
+
+bool isAllocated(const Function& function, ValueID id) {
+  const auto op = function[id].op;
+  return op != Opcode::Const && op != Opcode::Symbol && op != Opcode::Alloca &&
+         function[id].type != IRType::Void;
+}
+
+// Runs the function symbolically, keeping track of which value every
+// register and slot holds, and checks every operand is where the allocation
+// says it is when it is used, and every value live into a block is where the
+// block expects it.
+class Checker {
+  const Function& function;
+  const RegisterAllocation& allocation;
+  std::map<BlockID, std::set<ValueID>> liveIns;
+  std::map<Key, ValueID> state;
+
+ public:
+  Checker(const Function& function, const RegisterAllocation& allocation)
+      : function(function), allocation(allocation) {
+    computeLiveness();
+  }
+
+  void check() {
+    for (const auto id : allocation.blockOrder()) checkBlock(id);
+  }
+
+ private:
+  void computeLiveness() {
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (const auto id : allocation.blockOrder()) {
+        std::set<ValueID> live;
+        const auto& block = function.block(id);
+        for (const auto successor : block.successors()) {
+          const auto& next = function.block(successor);
+          live.insert(liveIns[successor].begin(), liveIns[successor].end());
+          const auto index =
+              std::find(next.predecessors.begin(), next.predecessors.end(),
+                        id) -
+              next.predecessors.begin();
+          for (const auto phi : next.phis) {
+            const auto operand = function.operands(phi)[index];
+            if (isAllocated(function, operand)) live.insert(operand);
+          }
+        }
+        for (auto it = block.insts.rbegin(); it != block.insts.rend(); ++it) {
+          live.erase(*it);
+          for (const auto operand : function.operands(*it)) {
+            if (isAllocated(function, operand)) live.insert(operand);
+          }
+        }
+        for (const auto phi : block.phis) live.erase(phi);
+        if (live != liveIns[id]) {
+          liveIns[id] = live;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  void apply(std::vector<Move> moves) {
+    for (const auto& move : sequentialize(std::move(moves))) {
+      if (move.from.kind == Location::Kind::None) {
+        state[keyOf(move.to)] = move.value;
+      } else {
+        state[keyOf(move.to)] = state[keyOf(move.from)];
+      }
+    }
+  }
+
+  void apply(std::span<const Move> moves) {
+    apply(std::vector<Move>(moves.begin(), moves.end()));
+  }
+
+  void expect(ValueID value, const Location& location) {
+    ASSERT_NE(location.kind, Location::Kind::None) << "%" << value;
+    EXPECT_EQ(state[keyOf(location)], value) << "%" << value;
+  }
+
+  void checkBlock(BlockID id) {
+    const auto& block = function.block(id);
+    const auto start = allocation.blockStart(id);
+    state.clear();
+    for (const auto value : liveIns[id]) {
+      state[keyOf(allocation.locationAt(value, start))] = value;
+    }
+    for (const auto phi : block.phis) {
+      state[keyOf(allocation.locationAt(phi, start))] = phi;
+    }
+    if (id == Function::ENTRY) {
+      for (const auto param : function.parameters()) {
+        state[keyOf(allocation.locationAt(param, 0))] = param;
+      }
+    }
+    apply(allocation.movesAt(start + 1));
+
+    for (const auto inst : block.insts) {
+      const auto& value = function[inst];
+      const auto position = allocation.position(inst);
+      if (isTerminator(value.op)) apply(allocation.exitMoves(id));
+      for (const auto operand : function.operands(inst)) {
+        if (!isAllocated(function, operand)) continue;
+        const auto location = allocation.locationAt(operand, position);
+        expect(operand, location);
+        if (value.op != Opcode::Call && value.op != Opcode::Ret) {
+          EXPECT_EQ(location.kind, Location::Kind::Register) << "%" << operand;
+        }
+      }
+
+      std::vector<X86::Register> clobbered;
+      if (value.op == Opcode::Call) {
+        clobbered = {X86::RAX, X86::RCX, X86::RDX, X86::RSI, X86::RDI,
+                     X86::R8,  X86::R9,  X86::R10, X86::R11};
+      } else if (value.op == Opcode::SDiv || value.op == Opcode::UDiv ||
+                 value.op == Opcode::SRem || value.op == Opcode::URem) {
+        clobbered = {X86::RAX, X86::RDX};
+      } else if ((value.op == Opcode::Shl || value.op == Opcode::LShr ||
+                  value.op == Opcode::AShr) &&
+                 function[function.operands(inst)[1]].op != Opcode::Const) {
+        clobbered = {X86::RCX};
+      }
+      for (const auto reg : clobbered) {
+        state[keyOf(Location::inRegister(reg))] = 0;
+      }
+
+      auto moves = std::vector<Move>(allocation.movesAt(position + 1).begin(),
+                                     allocation.movesAt(position + 1).end());
+      if (isAllocated(function, inst)) {
+        X86::Register reg;
+        if (lateResultRegister(value, &reg)) {
+          state[keyOf(Location::inRegister(reg))] = inst;
+          moves.push_back({inst, Location::inRegister(reg),
+                           allocation.resultLocation(function, inst)});
+        } else {
+          state[keyOf(allocation.resultLocation(function, inst))] = inst;
+        }
+      }
+      if (!isTerminator(value.op)) apply(std::move(moves));
+    }
+
+    const auto saved = state;
+    for (const auto successor : block.successors()) {
+      state = saved;
+      apply(allocation.entryMoves(successor));
+      const auto& next = function.block(successor);
+      const auto target = allocation.blockStart(successor);
+      for (const auto value : liveIns[successor]) {
+        expect(value, allocation.locationAt(value, target));
+      }
+      const auto index =
+          std::find(next.predecessors.begin(), next.predecessors.end(), id) -
+          next.predecessors.begin();
+      for (const auto phi : next.phis) {
+        expect(function.operands(phi)[index],
+               allocation.locationAt(phi, target));
+      }
+    }
+  }
+};
+
+struct Allocated {
+  Module module;
+  std::vector<RegisterAllocation> allocations;
+
+  explicit Allocated(std::string_view text) {
+    ReportErrorStub errOut;
+    EXPECT_TRUE(parseModule(text, module, errOut));
+    allocate();
+  }
+
+  // Lowers C source instead.
+  Allocated(const std::string& source, bool) {
+    ReportErrorStub errOut;
+    AST ast;
+    StringInterner strings;
+    TypeTable types;
+    SimpleStringScanner scanner(source);
+    Lexer lexer(scanner, errOut);
+    Parser parser(lexer, ast, strings, errOut);
+    const auto translationUnit = parser.parseTranslationUnit();
+    Sema sema(ast, strings, types, errOut);
+    sema.check();
+    Lowering(ast, strings, sema, module, errOut).lower(translationUnit);
+    EXPECT_TRUE(errOut.listOfErrors.empty());
+    allocate();
+  }
+
+  void allocate() {
+    allocations.reserve(module.functions.size());
+    for (auto& function : module.functions) {
+      allocations.emplace_back(function);
+      std::string problem;
+      EXPECT_TRUE(verify(function, &problem)) << problem;
+      Checker(function, allocations.back()).check();
+    }
+  }
+};
+}  // namespace
+
+TEST(TestRegisterAllocation, straight_line_code_uses_the_hints) {
+  Allocated allocated("function i64 @f(i64 %a, i64 %b) {\n"
+                      "b0:\n"
+                      "  %s = add i64 %a, %b\n"
+                      "  %t = mul i64 %s, %a\n"
+                      "  ret %t\n"
+                      "}\n");
+  const auto& function = allocated.module.functions[0];
+  const auto& allocation = allocated.allocations[0];
+  EXPECT_EQ(allocation.locationAt(function.parameters()[0], 0),
+            Location::inRegister(X86::RDI));
+  EXPECT_EQ(allocation.locationAt(function.parameters()[1], 0),
+            Location::inRegister(X86::RSI));
+  EXPECT_EQ(allocation.resultLocation(function,
+                                      function.block(Function::ENTRY).insts[1]),
+            Location::inRegister(X86::RAX));
+  EXPECT_EQ(allocation.numberOfSpillSlots(), 0u);
+  EXPECT_TRUE(allocation.calleeSavedRegisters().empty());
+}
+
+TEST(TestRegisterAllocation, values_live_across_calls) {
+  Allocated allocated("extern function @g\n"
+                      "\n"
+                      "function i64 @f(i64 %a, i64 %b) {\n"
+                      "b0:\n"
+                      "  %c = call i64 @g(%b, %a)\n"
+                      "  %d = add i64 %c, %a\n"
+                      "  %e = add i64 %d, %b\n"
+                      "  ret %e\n"
+                      "}\n");
+  const auto& function = allocated.module.functions[0];
+  const auto& allocation = allocated.allocations[0];
+  const auto call =
+      allocation.position(function.block(Function::ENTRY).insts[0]);
+  for (const auto param : function.parameters()) {
+    const auto location = allocation.locationAt(param, call + 1);
+    EXPECT_TRUE(location.kind == Location::Kind::Stack ||
+                X86::isCalleeSaved(location.reg));
+  }
+  EXPECT_EQ(allocation.calleeSavedRegisters().size(), 2u);
+}
+
+TEST(TestRegisterAllocation, spills_under_pressure) {
+  // 20 values live at once, more than there are registers.
+  std::string text = "function i64 @f(ptr %p) {\nb0:\n";
+  for (int i = 0; i < 20; i++) {
+    text += "  %a" + std::to_string(i) + " = add ptr %p, i64 " +
+            std::to_string(i * 8) + "\n";
+    text += "  %v" + std::to_string(i) + " = load i64 %a" + std::to_string(i) +
+            "\n";
+  }
+  text += "  %s0 = add i64 %v0, %v1\n";
+  for (int i = 2; i < 20; i++) {
+    text += "  %s" + std::to_string(i - 1) + " = add i64 %s" +
+            std::to_string(i - 2) + ", %v" + std::to_string(i) + "\n";
+  }
+  text += "  ret %s18\n}\n";
+  Allocated allocated(text);
+  const auto& allocation = allocated.allocations[0];
+  EXPECT_GT(allocation.statistics().spilledIntervals, 0u);
+  EXPECT_GT(allocation.numberOfSpillSlots(), 0u);
+  EXPECT_LT(allocation.numberOfSpillSlots(), 20u);
+}
+
+TEST(TestRegisterAllocation, loops_with_swapped_phis) {
+  // The phis swap a and b on every iteration, a cycle of moves on the back
+  // edge.
+  Allocated allocated("function i32 @f(i32 %n, i32 %x, i32 %y) {\n"
+                      "b0:\n"
+                      "  jmp loop\n"
+                      "loop:\n"
+                      "  %i = phi i32 [i32 0, b0], [%i2, loop]\n"
+                      "  %a = phi i32 [%x, b0], [%b, loop]\n"
+                      "  %b = phi i32 [%y, b0], [%a, loop]\n"
+                      "  %q = sdiv i32 %a, %b\n"
+                      "  %r = shl i32 %q, %i\n"
+                      "  %i2 = add i32 %i, i32 1\n"
+                      "  %c = slt i32 %i2, %n\n"
+                      "  br %c, loop, exit\n"
+                      "exit:\n"
+                      "  %s = add i32 %r, %a\n"
+                      "  ret %s\n"
+                      "}\n");
+  // The critical edge from the loop to itself got a block for the moves.
+  EXPECT_EQ(allocated.allocations[0].blockOrder().size(), 4u);
+}
+
+TEST(TestRegisterAllocation, sequentialize_breaks_cycles) {
+  const auto rax = Location::inRegister(X86::RAX);
+  const auto rcx = Location::inRegister(X86::RCX);
+  const auto rdx = Location::inRegister(X86::RDX);
+  const auto slot = Location::onStack(0);
+  const auto moves =
+      sequentialize({{1, rax, rcx}, {2, rcx, rdx}, {3, rdx, rax},
+                     {4, rdx, slot}, {5, rax, rax}});
+  std::map<Key, ValueID> state{
+      {keyOf(rax), 1}, {keyOf(rcx), 2}, {keyOf(rdx), 3}};
+  for (const auto& move : moves) state[keyOf(move.to)] = state[keyOf(move.from)];
+  EXPECT_EQ(state[keyOf(rcx)], 1u);
+  EXPECT_EQ(state[keyOf(rdx)], 2u);
+  EXPECT_EQ(state[keyOf(rax)], 3u);
+  EXPECT_EQ(state[keyOf(slot)], 3u);
+  EXPECT_EQ(moves.size(), 5u);
+}
+
+TEST(TestRegisterAllocation, lowered_functions) {
+  Allocated allocated(
+      "long g(long a, long b, long c, long d, long e, long f, long h);\n"
+      "long calls(long a, long b, long c, long d, long e, long f) {\n"
+      "  long x = g(a, b, c, d, e, f, a + b);\n"
+      "  for (int i = 0; i < 4; i++)\n"
+      "    x = g(x, a + i, b, c * x, d, e ^ x, f - x) + a * b - c;\n"
+      "  return x + a + b + c + d + e + f;\n"
+      "}\n"
+      "void sort(int *x, int n) {\n"
+      "  for (int gap = n / 2; gap > 0; gap /= 2)\n"
+      "    for (int i = gap; i < n; i++) {\n"
+      "      int v = x[i], j = i;\n"
+      "      while (j >= gap && x[j - gap] > v) {\n"
+      "        x[j] = x[j - gap];\n"
+      "        j -= gap;\n"
+      "      }\n"
+      "      x[j] = v % (n + 1) << (gap & 3);\n"
+      "    }\n"
+      "}\n"
+      "unsigned rounds(unsigned *s, const unsigned *w) {\n"
+      "  unsigned a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5],\n"
+      "           g = s[6], h = s[7];\n"
+      "  for (int i = 0; i < 64; i++) {\n"
+      "    unsigned t1 = h + (e >> 6 ^ e << 26) + (e & f ^ ~e & g) + w[i];\n"
+      "    unsigned t2 = (a >> 2 ^ a << 30) + (a & b ^ a & c ^ b & c);\n"
+      "    h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;\n"
+      "  }\n"
+      "  return a ^ b ^ c ^ d ^ e ^ f ^ g ^ h;\n"
+      "}\n",
+      true);
+  EXPECT_EQ(allocated.allocations.size(), 3u);
+}
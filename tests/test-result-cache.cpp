@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "tplcc/content-hash.h"
+#include "tplcc/result-cache.h"
+
+namespace {
+std::string emptyDirectory(const std::string& name) {
+  const auto directory = testing::TempDir() + name;
+  std::filesystem::remove_all(directory);
+  return directory;
+}
+}  // namespace
+
+TEST(TestContentHash, hashes_pieces_with_their_sizes) {
+  const auto hash = ContentHasher().add("ab").add("c").finish();
+  EXPECT_EQ(hash, ContentHasher().add("ab").add("c").finish());
+  EXPECT_NE(hash, ContentHasher().add("a").add("bc").finish());
+  EXPECT_NE(hash, ContentHasher().add("abc").finish());
+  // The zeros padding the last word aren't bytes of the piece.
+  EXPECT_NE(ContentHasher().add("a").finish(),
+            ContentHasher().add(std::string_view("a\0", 2)).finish());
+  EXPECT_NE(ContentHasher().add("").finish(), ContentHasher().finish());
+
+  std::set<std::string> hexes;
+  for (int i = 0; i < 1000; i++) {
+    hexes.insert(ContentHasher().add(std::to_string(i)).finish().hex());
+  }
+  EXPECT_EQ(hexes.size(), 1000);
+  EXPECT_EQ(hexes.begin()->size(), 32);
+  EXPECT_EQ((ContentHash{0x0123456789abcdef, 0xfedcba9876543210}.hex()),
+            "0123456789abcdeffedcba9876543210");
+}
+
+TEST(TestResultCache, finds_what_was_stored_by_key) {
+  ResultCache cache(emptyDirectory("tplcc-result-cache"));
+  const auto key = ResultCache::keyOf("int a ;", "-c -O");
+  EXPECT_NE(key, ResultCache::keyOf("int a ;", "-S -O"));
+  EXPECT_NE(key, ResultCache::keyOf("int b ;", "-c -O"));
+  EXPECT_FALSE(cache.find(key));
+
+  ResultCache::Entry entry;
+  entry.output = std::string("\x7f" "ELF\0\n\x01", 7);
+  entry.compileSeconds = 1.5;
+  ASSERT_TRUE(cache.store(key, entry));
+  const auto found = cache.find(key);
+  ASSERT_TRUE(found);
+  EXPECT_EQ(found->output, entry.output);
+  EXPECT_DOUBLE_EQ(found->compileSeconds, 1.5);
+
+  entry.output = "replaced";
+  ASSERT_TRUE(cache.store(key, entry));
+  EXPECT_EQ(cache.find(key)->output, "replaced");
+  EXPECT_FALSE(cache.find(ResultCache::keyOf("int a ;", "-S -O")));
+}
+
+TEST(TestResultCache, misses_entries_it_can_not_take) {
+  const auto directory = emptyDirectory("tplcc-result-cache-foreign");
+  ResultCache cache(directory);
+  const auto key = ResultCache::keyOf("int a ;", "-c -O");
+  ResultCache::Entry entry;
+  entry.output = "output";
+  ASSERT_TRUE(cache.store(key, entry));
+
+  // Whatever is at its path, the entry has to start like the cache's.
+  const auto hex = key.hex();
+  std::ofstream(directory + "/" + hex.substr(0, 2) + "/" + hex.substr(2))
+      << "something else\n";
+  EXPECT_FALSE(cache.find(key));
+}
+
+TEST(TestResultCache, adds_up_statistics) {
+  ResultCache cache(emptyDirectory("tplcc-result-cache-statistics"));
+  EXPECT_EQ(cache.statistics().hits, 0);
+
+  ResultCache::Statistics statistics;
+  statistics.hits = 2;
+  statistics.misses = 1;
+  statistics.savedSeconds = 0.25;
+  ASSERT_TRUE(cache.addToStatistics(statistics));
+  ASSERT_TRUE(cache.addToStatistics(statistics));
+  const auto total = cache.statistics();
+  EXPECT_EQ(total.hits, 4);
+  EXPECT_EQ(total.misses, 2);
+  EXPECT_DOUBLE_EQ(total.savedSeconds, 0.5);
+
+  std::ostringstream printed;
+  printStatistics(printed, "dir", total);
+  EXPECT_EQ(printed.str(),
+            "Cache in dir:\n"
+            "  hits                    4\n"
+            "  misses                  2\n"
+            "  saved time          0.500 s\n");
+}
@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "./mocking/report-error-stub.h"
+#include "./mocking/simple-string-scanner.h"
+#include "tplcc/ast.h"
+#include "tplcc/parser.h"
+#include "tplcc/sema.h"
+
+namespace {
+struct Checked {
+  ReportErrorStub errOut;
+  AST ast;
+  StringInterner strings;
+  TypeTable types;
+  std::unique_ptr<Sema> sema;
+
+  explicit Checked(const std::string& source) {
+    SimpleStringScanner scanner(source);
+    Lexer lexer(scanner, errOut);
+    Parser parser(lexer, ast, strings, errOut);
+    parser.parseTranslationUnit();
+    sema = std::make_unique<Sema>(ast, strings, types, errOut);
+    sema->check();
+  }
+
+  // The last node of the kind.
+  NodeID last(NodeKind kind) const {
+    for (auto id = static_cast<NodeID>(ast.size() - 1); id > 0; id--) {
+      if (ast[id].kind == kind) return id;
+    }
+    return 0;
+  }
+
+  NodeID declaration(std::string_view name) const {
+    for (NodeID id = 1; id < ast.size(); id++) {
+      const auto kind = ast[id].kind;
+      if ((kind == NodeKind::VarDecl || kind == NodeKind::FieldDecl) &&
+          strings.view(ast[id].name) == name) {
+        return id;
+      }
+    }
+    return 0;
+  }
+
+  std::string typeOf(NodeID id) const {
+    return types.toString(sema->typeOf(id), strings);
+  }
+  std::string convertedTypeOf(NodeID id) const {
+    return types.toString(sema->convertedTypeOf(id), strings);
+  }
+};
+}  // namespace
+
+TEST(TestSema, usual_arithmetic_conversions) {
+  Checked checked(
+      "char c; unsigned u; long l; float f;\n"
+      "void g(void) { c * c; u + l; u + 1; f * l; }\n");
+  ASSERT_TRUE(checked.errOut.listOfErrors.empty());
+
+  std::vector<NodeID> products;
+  for (NodeID id = 1; id < checked.ast.size(); id++) {
+    if (checked.ast[id].kind == NodeKind::Binary) products.push_back(id);
+  }
+  ASSERT_EQ(products.size(), 4);
+  // Both chars are promoted to int.
+  EXPECT_EQ(checked.typeOf(products[0]), "int");
+  EXPECT_EQ(checked.typeOf(checked.ast[products[0]].a), "char");
+  EXPECT_EQ(checked.convertedTypeOf(checked.ast[products[0]].a), "int");
+  // long can represent every unsigned int.
+  EXPECT_EQ(checked.typeOf(products[1]), "long");
+  EXPECT_EQ(checked.typeOf(products[2]), "unsigned int");
+  EXPECT_EQ(checked.typeOf(products[3]), "float");
+}
+
+TEST(TestSema, integer_literals_are_typed_by_value_and_suffix) {
+  Checked checked(
+      "long a = 2147483647; long b = 2147483648; long c = 0xFFFFFFFF;\n"
+      "long d = 1u; long e = 1ll; long f = 'a'; double g = 1.0f;\n");
+  ASSERT_TRUE(checked.errOut.listOfErrors.empty());
+  const auto initializerType = [&](std::string_view name) {
+    return checked.typeOf(checked.ast[checked.declaration(name)].b);
+  };
+  EXPECT_EQ(initializerType("a"), "int");
+  EXPECT_EQ(initializerType("b"), "long");
+  EXPECT_EQ(initializerType("c"), "unsigned int");
+  EXPECT_EQ(initializerType("d"), "unsigned int");
+  EXPECT_EQ(initializerType("e"), "long long");
+  EXPECT_EQ(initializerType("f"), "int");
+  EXPECT_EQ(initializerType("g"), "float");
+  EXPECT_EQ(checked.sema->valueOf(checked.ast[checked.declaration("f")].b),
+            97);
+  EXPECT_EQ(checked.convertedTypeOf(checked.ast[checked.declaration("g")].b),
+            "double");
+}
+
+TEST(TestSema, arrays_decay_and_members_are_laid_out) {
+  Checked checked(
+      "struct s { char c; int i; short b : 3, d : 4; double x; } v;\n"
+      "int a[] = {1, 2, 3};\n"
+      "char str[] = \"abc\";\n"
+      "int m[][2] = {1, 2, 3};\n"
+      "int *p = a;\n"
+      "unsigned long n = sizeof(struct s);\n");
+  ASSERT_TRUE(checked.errOut.listOfErrors.empty());
+
+  EXPECT_EQ(checked.typeOf(checked.declaration("a")), "int [3]");
+  EXPECT_EQ(checked.typeOf(checked.declaration("str")), "char [4]");
+  EXPECT_EQ(checked.typeOf(checked.declaration("m")), "int [2][2]");
+  EXPECT_EQ(checked.convertedTypeOf(checked.ast[checked.declaration("p")].b),
+            "int *");
+
+  EXPECT_EQ(checked.sema->valueOf(checked.declaration("i")), 32);
+  EXPECT_EQ(checked.sema->valueOf(checked.declaration("b")), 64);
+  EXPECT_EQ(checked.sema->valueOf(checked.declaration("d")), 67);
+  EXPECT_EQ(checked.sema->valueOf(checked.declaration("x")), 128);
+  EXPECT_EQ(checked.sema->valueOf(checked.last(NodeKind::SizeofType)), 24);
+}
+
+TEST(TestSema, enumerators_count_up) {
+  Checked checked(
+      "enum e { A, B = 5, C, D = -1, E };\n"
+      "int a[C];\n");
+  ASSERT_TRUE(checked.errOut.listOfErrors.empty());
+  std::vector<std::int64_t> values;
+  for (NodeID id = 1; id < checked.ast.size(); id++) {
+    if (checked.ast[id].kind == NodeKind::EnumConstantDecl) {
+      values.push_back(
+          static_cast<std::int64_t>(checked.sema->valueOf(id)));
+    }
+  }
+  EXPECT_EQ(values, (std::vector<std::int64_t>{0, 5, 6, -1, 0}));
+  EXPECT_EQ(checked.typeOf(checked.declaration("a")), "int [6]");
+}
+
+TEST(TestSema, calls_convert_arguments) {
+  Checked checked(
+      "int f(long, ...);\n"
+      "int k();\n"
+      "void g(void) { float x; f(1, x); k(x); }\n");
+  ASSERT_TRUE(checked.errOut.listOfErrors.empty());
+  const auto call = checked.last(NodeKind::Call);
+  const auto first = checked.ast.list(checked.ast[call].list)[0];
+  EXPECT_EQ(checked.convertedTypeOf(first), "double");
+
+  NodeID variadicCall = 0;
+  for (NodeID id = 1; id < call; id++) {
+    if (checked.ast[id].kind == NodeKind::Call) variadicCall = id;
+  }
+  const auto arguments = checked.ast.list(checked.ast[variadicCall].list);
+  EXPECT_EQ(checked.convertedTypeOf(arguments[0]), "long");
+  EXPECT_EQ(checked.convertedTypeOf(arguments[1]), "double");
+  EXPECT_EQ(checked.typeOf(variadicCall), "int");
+}
+
+TEST(TestSema, reports_type_errors) {
+  Checked checked(
+      "struct s { int a; } v;\n"
+      "const int c = 1;\n"
+      "int f(int);\n"
+      "void g(void) {\n"
+      "  y = 1;\n"
+      "  c = 2;\n"
+      "  v.b;\n"
+      "  v + 1;\n"
+      "  f(1, 2);\n"
+      "  int *p = 1.5;\n"
+      "  return 1;\n"
+      "}\n");
+  const auto& errors = checked.errOut.listOfErrors;
+  ASSERT_EQ(errors.size(), 7);
+  EXPECT_EQ(errors[0].message(), "Use of undeclared identifier \"y\".");
+  EXPECT_EQ(errors[1].id(), ErrorID::NotAssignable);
+  EXPECT_EQ(errors[2].message(), "\"struct s\" has no member named \"b\".");
+  EXPECT_EQ(errors[3].message(),
+            "Invalid operands to \"+\" (\"struct s\" and \"int\").");
+  EXPECT_EQ(errors[4].message(),
+            "The function takes 1 argument(s), but got 2.");
+  EXPECT_EQ(errors[5].message(), "Cannot convert \"double\" to \"int *\".");
+  EXPECT_EQ(errors[6].id(), ErrorID::VoidFunctionReturnsValue);
+}
+
+TEST(TestSema, constant_expressions) {
+  Checked checked(
+      "enum { N = 4, M = N * 2 + 1 };\n"
+      "int a[M << 1];\n"
+      "char b[(unsigned char)-1 == 255 ? 3 : 5];\n"
+      "int c[sizeof(int) * N - 1 && 1 ? 2 : 1 / 0];\n"
+      "int d[(int)2.9];\n"
+      "struct s { unsigned f : N + 1; };\n"
+      "void g(int x) { switch (x) { case N - 1: case -M: break; } }\n");
+  ASSERT_TRUE(checked.errOut.listOfErrors.empty());
+  EXPECT_EQ(checked.typeOf(checked.declaration("a")), "int [18]");
+  EXPECT_EQ(checked.typeOf(checked.declaration("b")), "char [3]");
+  EXPECT_EQ(checked.typeOf(checked.declaration("c")), "int [2]");
+  EXPECT_EQ(checked.typeOf(checked.declaration("d")), "int [2]");
+}
+
+TEST(TestSema, constant_expressions_report_errors) {
+  Checked checked(
+      "enum { A = 2147483647, B };\n"
+      "int a[(2147483647 + 1) & 1];\n"
+      "int b[1 / 0];\n"
+      "int c[1 << 40];\n"
+      "void g(int x, int y) { switch (x) { case y: break; } }\n");
+  const auto& errors = checked.errOut.listOfErrors;
+  ASSERT_EQ(errors.size(), 5);
+  EXPECT_EQ(errors[0].id(), ErrorID::ConstantOverflow);
+  EXPECT_EQ(errors[1].id(), ErrorID::ConstantOverflow);
+  EXPECT_EQ(errors[2].id(), ErrorID::DivisionByZero);
+  EXPECT_EQ(errors[3].id(), ErrorID::InvalidShiftCount);
+  EXPECT_EQ(errors[4].id(), ErrorID::NotIntegerConstant);
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include "tplcc/symbol-table.h"
+
+TEST(TestSymbolTable, inner_declarations_shadow_outer_ones) {
+  SymbolTable table;
+  EXPECT_EQ(table.declare(1, 10), 0);
+  EXPECT_EQ(table.lookup(1), 10);
+
+  table.enterScope();
+  EXPECT_EQ(table.lookup(1), 10);
+  EXPECT_EQ(table.lookupInCurrentScope(1), 0);
+  EXPECT_EQ(table.declare(1, 20), 0);
+  EXPECT_EQ(table.declare(2, 21), 0);
+  EXPECT_EQ(table.lookup(1), 20);
+
+  table.enterScope();
+  EXPECT_EQ(table.declare(1, 30), 0);
+  EXPECT_EQ(table.lookup(1), 30);
+  table.exitScope();
+
+  EXPECT_EQ(table.lookup(1), 20);
+  EXPECT_EQ(table.lookup(2), 21);
+  table.exitScope();
+
+  EXPECT_EQ(table.lookup(1), 10);
+  EXPECT_EQ(table.lookup(2), 0);
+  EXPECT_EQ(table.depth(), 1);
+}
+
+TEST(TestSymbolTable, redeclaration_in_same_scope_returns_previous_one) {
+  SymbolTable table;
+  table.enterScope();
+  EXPECT_EQ(table.declare(1, 10), 0);
+  EXPECT_EQ(table.declare(1, 11), 10);
+  EXPECT_EQ(table.lookupInCurrentScope(1), 11);
+  table.exitScope();
+  EXPECT_EQ(table.lookup(1), 0);
+}
+
+TEST(TestSymbolTable, many_scopes_unwind_to_file_scope) {
+  SymbolTable table;
+  for (StringID name = 1; name <= 1000; name++) table.declare(name, name);
+  for (StringID name = 1; name <= 1000; name++) {
+    table.enterScope();
+    table.declare(name, name + 1000);
+    table.declare(name + 1000, name);
+  }
+  EXPECT_EQ(table.lookup(500), 1500);
+  for (StringID name = 1; name <= 1000; name++) table.exitScope();
+
+  for (StringID name = 1; name <= 1000; name++) {
+    EXPECT_EQ(table.lookup(name), name);
+    EXPECT_EQ(table.lookup(name + 1000), 0);
+  }
+}
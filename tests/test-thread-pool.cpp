@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tplcc/include-files.h"
+#include "tplcc/thread-pool.h"
+
+TEST(TestThreadPool, runs_every_task_of_a_group) {
+  ThreadPool pool(3);
+  ThreadPool::TaskGroup group;
+  std::vector<std::atomic<int>> runs(1000);
+  for (auto& count : runs) {
+    pool.submit(group, [&count] { count++; });
+  }
+  pool.wait(group);
+  for (const auto& count : runs) EXPECT_EQ(count, 1);
+}
+
+TEST(TestThreadPool, without_workers_runs_tasks_in_order_when_waited_for) {
+  ThreadPool pool(0);
+  ThreadPool::TaskGroup group;
+  std::vector<int> order;
+  for (int i = 0; i < 5; i++) {
+    pool.submit(group, [&order, i] { order.push_back(i); });
+  }
+  EXPECT_TRUE(order.empty());
+  pool.wait(group);
+  EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+TEST(TestThreadPool, tasks_wait_for_the_tasks_they_submit) {
+  // More nested waits than workers, which would deadlock if a waiting
+  // worker didn't run the tasks of its group itself.
+  ThreadPool pool(2);
+  ThreadPool::TaskGroup files;
+  std::vector<std::size_t> sums(8);
+  for (std::size_t file = 0; file < sums.size(); file++) {
+    pool.submit(files, [&pool, &sums, file] {
+      ThreadPool::TaskGroup functions;
+      std::vector<std::size_t> parts(16);
+      for (std::size_t i = 0; i < parts.size(); i++) {
+        pool.submit(functions, [&parts, i, file] { parts[i] = i * file; });
+      }
+      pool.wait(functions);
+      for (const auto part : parts) sums[file] += part;
+    });
+  }
+  pool.wait(files);
+  for (std::size_t file = 0; file < sums.size(); file++) {
+    EXPECT_EQ(sums[file], 120 * file);
+  }
+}
+
+TEST(TestThreadPool, waiting_runs_only_the_tasks_of_the_group) {
+  ThreadPool pool(0);
+  ThreadPool::TaskGroup files;
+  std::vector<std::string> order;
+  pool.submit(files, [&] {
+    order.push_back("a");
+    ThreadPool::TaskGroup functions;
+    pool.submit(functions, [&] { order.push_back("a.f"); });
+    // b is queued before a.f, but belongs to another group.
+    pool.wait(functions);
+    order.push_back("a done");
+  });
+  pool.submit(files, [&] { order.push_back("b"); });
+  pool.wait(files);
+  EXPECT_EQ(order, (std::vector<std::string>{"a", "a.f", "a done", "b"}));
+}
+
+TEST(TestThreadPool, idle_workers_steal_queued_tasks) {
+  ThreadPool pool(2);
+  ThreadPool::TaskGroup group;
+  std::atomic<int> started{0};
+  // Both tasks are queued by this thread, they can only run at the same
+  // time if the workers take them from its queue.
+  for (int i = 0; i < 2; i++) {
+    pool.submit(group, [&started] {
+      started++;
+      while (started < 2) std::this_thread::yield();
+    });
+  }
+  pool.wait(group);
+  EXPECT_EQ(started, 2);
+}
+
+TEST(TestFileCache, reads_a_file_once_for_all_threads) {
+  const std::string path = testing::TempDir() + "tplcc-file-cache.h";
+  std::ofstream(path) << "int a;\n";
+
+  FileCache cache;
+  std::vector<const FileCache::File*> contents(8);
+  std::vector<std::thread> threads;
+  for (auto& content : contents) {
+    threads.emplace_back([&cache, &content, &path] {
+      content = cache.read(path);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  ASSERT_NE(contents[0], nullptr);
+  EXPECT_EQ(contents[0]->content, "int a;\n");
+  for (const auto content : contents) EXPECT_EQ(content, contents[0]);
+  EXPECT_EQ(cache.read(testing::TempDir() + "tplcc-no-such-file.h"), nullptr);
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "tplcc/types.h"
+
+TEST(TestTypes, identical_types_have_the_same_id) {
+  TypeTable types;
+  const auto intType = TypeTable::builtin(TypeKind::Int);
+  const auto size = types.size();
+
+  EXPECT_EQ(types.pointerTo(intType), types.pointerTo(intType));
+  EXPECT_EQ(types.arrayOf(intType, 3), types.arrayOf(intType, 3));
+  EXPECT_NE(types.arrayOf(intType, 3), types.arrayOf(intType, 4));
+  EXPECT_EQ(types.pointerTo(types.pointerTo(intType)),
+            types.pointerTo(types.pointerTo(intType)));
+  EXPECT_EQ(types.size(), size + 4);
+
+  const std::vector<TypeID> params{intType, types.pointerTo(intType)};
+  const auto fn = types.function(intType, params);
+  EXPECT_EQ(fn, types.function(intType, std::vector<TypeID>(params)));
+  EXPECT_NE(fn, types.function(intType, params, TypeFlag::Variadic));
+  EXPECT_EQ(types.params(fn).size(), 2);
+  EXPECT_EQ(types.params(fn)[1], types.pointerTo(intType));
+}
+
+TEST(TestTypes, qualified_types_know_their_unqualified_type) {
+  TypeTable types;
+  const auto intType = TypeTable::builtin(TypeKind::Int);
+  const auto constInt = types.qualified(intType, TypeQualifier::Const);
+  EXPECT_NE(constInt, intType);
+  EXPECT_EQ(types.unqualified(constInt), intType);
+  EXPECT_EQ(types.qualified(constInt, TypeQualifier::Const), constInt);
+  EXPECT_EQ(types.unqualified(intType), intType);
+
+  // The qualifiers of an array belong to its elements.
+  const auto array = types.arrayOf(intType, 2);
+  EXPECT_EQ(types.qualified(array, TypeQualifier::Const),
+            types.arrayOf(constInt, 2));
+}
+
+TEST(TestTypes, compatibility) {
+  TypeTable types;
+  const auto intType = TypeTable::builtin(TypeKind::Int);
+  const auto longType = TypeTable::builtin(TypeKind::Long);
+  const auto constInt = types.qualified(intType, TypeQualifier::Const);
+
+  EXPECT_FALSE(types.isCompatible(intType, longType));
+  EXPECT_FALSE(types.isCompatible(intType, constInt));
+  EXPECT_TRUE(types.isCompatible(TypeTable::ERROR, longType));
+  EXPECT_TRUE(types.isCompatible(types.arrayOf(intType, 3),
+                                 types.arrayOf(intType, 0, TypeFlag::Incomplete)));
+  EXPECT_FALSE(types.isCompatible(types.arrayOf(intType, 3),
+                                  types.arrayOf(intType, 4)));
+
+  // Top-level qualifiers of parameters don't matter, neither do the
+  // parameters of a function declared without a prototype.
+  const std::vector<TypeID> params{intType};
+  const std::vector<TypeID> constParams{constInt};
+  const auto fn = types.function(longType, params);
+  EXPECT_TRUE(types.isCompatible(fn, types.function(longType, constParams)));
+  EXPECT_TRUE(types.isCompatible(
+      fn, types.function(longType, {}, TypeFlag::NoPrototype)));
+  EXPECT_FALSE(types.isCompatible(fn, types.function(intType, params)));
+
+  const auto s1 = types.tagged(TypeKind::Struct, 10, 1);
+  const auto s2 = types.tagged(TypeKind::Struct, 20, 1);
+  EXPECT_EQ(s1, types.tagged(TypeKind::Struct, 10, 1));
+  EXPECT_FALSE(types.isCompatible(s1, s2));
+  EXPECT_TRUE(
+      types.isCompatible(types.tagged(TypeKind::Enum, 30, 0), intType));
+}
+
+TEST(TestTypes, to_string_spells_declarators_inside_out) {
+  TypeTable types;
+  StringInterner strings;
+  const auto intType = TypeTable::builtin(TypeKind::Int);
+  const auto constInt = types.qualified(intType, TypeQualifier::Const);
+  const std::vector<TypeID> params{intType};
+
+  EXPECT_EQ(types.toString(types.pointerTo(constInt), strings), "const int *");
+  EXPECT_EQ(types.toString(types.qualified(types.pointerTo(intType),
+                                           TypeQualifier::Const),
+                           strings),
+            "int * const");
+  EXPECT_EQ(types.toString(types.pointerTo(types.arrayOf(intType, 3)), strings),
+            "int (*)[3]");
+  EXPECT_EQ(types.toString(types.pointerTo(types.function(intType, params)),
+                           strings),
+            "int (*)(int)");
+  EXPECT_EQ(types.toString(types.function(intType, {}), strings), "int (void)");
+  EXPECT_EQ(types.toString(types.tagged(TypeKind::Struct, 1,
+                                        strings.intern("point")),
+                           strings),
+            "struct point");
+}
@@ -1,6 +1,10 @@
+#include <gtest/gtest.h>
+
 #include <string>
 
 #include "./helpers.h"
+#include "../mocking/report-error-stub.h"
+#include "tplcc/ir-text.h"
 
 std::string fromUTF8(std::u8string s) {
   return std::string(s.begin(), s.end());
@@ -10,4 +14,16 @@ std::string fromUTF16(std::u16string s) {
 }
 std::string fromUTF32(std::u32string s) {
   return std::string(s.begin(), s.end());
-}
\ No newline at end of file
+}
+
+std::string runPass(std::string_view ir, bool (*pass)(Function&)) {
+  Module module;
+  ReportErrorStub errOut;
+  EXPECT_TRUE(parseModule(ir, module, errOut));
+  for (auto& function : module.functions) {
+    pass(function);
+    std::string problem;
+    EXPECT_TRUE(verify(function, &problem)) << problem;
+  }
+  return toText(module);
+}
@@ -2,9 +2,16 @@
 #define TPLCC_TESTS_UTILS_HELPERS_H
 
 #include <string>
+#include <string_view>
+
+#include "tplcc/ir.h"
 
 std::string fromUTF8(std::u8string);
 std::string fromUTF16(std::u16string);
 std::string fromUTF32(std::u32string);
 
+// Run the pass on every function of a module in the text format, verify
+// them and print the module.
+std::string runPass(std::string_view ir, bool (*pass)(Function&));
+
 #endif
\ No newline at end of file
@@ -70,13 +70,16 @@ namespace {
 		"L"
 	};
 
-	static std::vector<std::pair<const char*, Keyword>> keywordPairs{
+	// Sorted by spelling for findKeyword. Never changes, so the lexers of all
+	// the threads share it.
+	static const std::vector<std::pair<const char*, Keyword>> keywordPairs{
 		{ "_Bool", Keyword::_Bool },
 		{ "_Complex", Keyword::_Complex },
 		{ "_Imaginary", Keyword::_Imaginary },
 		{ "auto", Keyword::Auto },
 		{ "break", Keyword::Break },
 		{ "case", Keyword::Case },
+		{ "char", Keyword::Char },
 		{ "const", Keyword::Const },
 		{ "continue", Keyword::Continue },
 		{ "default", Keyword::Default },
@@ -95,6 +98,7 @@ namespace {
 		{ "register", Keyword::Register },
 		{ "restrict", Keyword::Restrict },
 		{ "return", Keyword::Return },
+		{ "short", Keyword::Short },
 		{ "signed", Keyword::Signed },
 		{ "sizeof", Keyword::Sizeof },
 		{ "static", Keyword::Static },
@@ -180,23 +184,23 @@ namespace {
 			buffer.push_back(scanner.get());
 		}
 
+		// Each kind of suffix can appear once, in any order, e.g. "ul" and "lu".
 		for (size_t i = beginIndexOfSuffix; i < buffer.size();) {
-			const std::string* matched = nullptr;
+			bool hasMatched = false;
 
 			for (size_t j = 0; j < availableSuffixes.size(); j++) {
-				if (hasSeenSuffix[j]) {
-					goto fail;
-				}
+				if (hasSeenSuffix[j]) continue;
 
 				auto& vecOfSuffixes = **(availableSuffixes.begin() + j);
 				if (const auto matched = matchesSuffix(buffer, i, vecOfSuffixes)) {
 					hasSeenSuffix[j] = true;
 					i += matched->size();
-					continue;
+					hasMatched = true;
+					break;
 				}
-
-				goto fail;
 			}
+
+			if (!hasMatched) goto fail;
 		}
 
 		return true;
@@ -205,9 +209,9 @@ namespace {
 		const auto numberLiteralNoSuffix = buffer.substr(0, beginIndexOfSuffix);
 		const auto invalidSuffix = buffer.substr(beginIndexOfSuffix);
 		errOut.reportsError({
+			ErrorID::InvalidNumberLiteralSuffix,
 			{ startOffset, scanner.offset()},
-			"\"" + invalidSuffix + "\" is not a valid suffix for the number literal " + numberLiteralNoSuffix + ".",
-			"invalid suffix."
+			{ invalidSuffix, numberLiteralNoSuffix }
 			});
 		return false;
 	}
@@ -237,9 +241,9 @@ namespace {
 		if (exponentHasNoDigit) {
 			while (std::isalnum(scanner.peek())) buffer.push_back(scanner.get());
 			errOut.reportsError({
+				ErrorID::ExponentHasNoDigit,
 				{ startOffset, scanner.offset() },
-				"Exponent part of number literal " + buffer + " has no digit.",
-				"Exponent has no digit."
+				{ buffer }
 				});
 			return false;
 		}
@@ -299,9 +303,8 @@ namespace {
 				std::any_of(buffer.begin(), buffer.end(), std::not_fn(isOctalDigit))
 				) {
 				errOut.reportsError({
-					{ startOffset, scanner.offset() },
-					"Invalid octal number.",
-					"Invalid octal number."
+					ErrorID::InvalidOctalNumber,
+					{ startOffset, scanner.offset() }
 					});
 				return std::nullopt;
 			}
@@ -334,9 +337,9 @@ namespace {
 		if (numberBase == LiteralNumberBase::Hexadecimal && !hasExponentPart) {
 			while (std::isalnum(scanner.peek())) buffer.push_back(scanner.get());
 			errOut.reportsError({
+				ErrorID::HexFloatHasNoExponent,
 				{ startOffset, scanner.offset() },
-				"Hexadecimal floating point " + buffer + " has no exponent part.",
-				"Hex float has no exponent part."
+				{ buffer }
 				});
 			return std::nullopt;
 		}
@@ -374,11 +377,10 @@ void Lexer::scanCharSequenceContent(const char quote, std::string* output) {
 
 	if (scanner.reachedEndOfInput() || scanner.peek() == '\n') {
 		errOut.reportsError({
-			{ startOffset, scanner.offset() },
 			quote == '"'
-				? "The string literal has no ending quote."
-				: "The character literal has no ending quote.",
-			"No ending quote."
+				? ErrorID::UnterminatedStringLiteral
+				: ErrorID::UnterminatedCharacterLiteral,
+			{ startOffset, scanner.offset() }
 			});
 		throw std::exception("Irrecoverable error happened, compilation is interrupted.");
 	}
@@ -396,11 +398,11 @@ std::optional<Token> Lexer::scanCharSequence(const char quote, const std::string
 	else {
 		scanCharSequenceContent(quote, nullptr);
 		errOut.reportsError({
-			{ startOffset, scanner.offset() },
 			quote == '"'
-				? "\"" + prefixStr + "\" is not a valid prefix for a string literal."
-				: "\"" + prefixStr + "\" is not a valid prefix for a character literal.",
-			"Invalid prefix."
+				? ErrorID::InvalidStringLiteralPrefix
+				: ErrorID::InvalidCharacterLiteralPrefix,
+			{ startOffset, scanner.offset() },
+			{ prefixStr }
 			});
 		return std::nullopt;
 	}
@@ -423,8 +425,13 @@ std::optional<Token> Lexer::scanPunctuator()
 // Get the next token from given input stream.
 std::optional<Token> Lexer::next()
 {
+	// Nobody will see errors we find from now on, stop wasting time.
+	if (errOut.hasReachedErrorLimit()) return EOI;
+
 	while (std::isspace(scanner.peek())) scanner.ignore();
 
+	tokenStartOffset = scanner.offset();
+
 	if (scanner.reachedEndOfInput()) return EOI;
 
 	if (scanner.peekN(2) == "//") {
@@ -459,6 +466,11 @@ std::optional<Token> Lexer::next()
 		return scanCharSequence(scanner.peek(), "");
 	}
 
+	if (scanner.peekN(3) == "...") {
+		scanner.ignoreN(3);
+		return Punctuator{ "..." };
+	}
+
 	auto lookaheads = scanner.peekN(2);
 	if (lookaheads[0] == '.') {
 		if (std::isdigit(lookaheads[1])) {
@@ -481,10 +493,11 @@ std::optional<Token> Lexer::next()
 	auto startOffsetOfStrayChar = scanner.offset();
 	auto strayChar = scanner.get();
 
+	const char strayCharStr[] = { static_cast<char>(strayChar), '\0' };
 	errOut.reportsError({
+		ErrorID::StrayCharacter,
 		{ startOffsetOfStrayChar, scanner.offset() },
-		std::string("Stray \"") + (char)strayChar + "\" in program.",
-		"Invalid character."
+		{ strayCharStr }
 		});
 
 	throw std::exception(); // report errors and abort if there is invalid character in the source code. e.g. ` and @.
@@ -518,3 +531,46 @@ std::optional<Keyword> Lexer::findKeyword(const std::string& str)
 		return {};
 	}
 }
+
+std::optional<PunctuatorKind> punctuatorKind(const Punctuator& punctuator)
+{
+	using enum PunctuatorKind;
+	static const std::vector<std::pair<std::string, PunctuatorKind>> kinds{
+		{ "[", LeftBracket }, { "]", RightBracket },
+		{ "(", LeftParenthesis }, { ")", RightParenthesis },
+		{ "{", LeftBrace }, { "}", RightBrace },
+		{ ".", Dot }, { "->", Arrow },
+		{ "++", Increment }, { "--", Decrement },
+		{ "&", Ampersand }, { "*", Star }, { "+", Plus }, { "-", Minus },
+		{ "~", Tilde }, { "!", Exclamation },
+		{ "/", Slash }, { "%", Percent },
+		{ "<<", LeftShift }, { ">>", RightShift },
+		{ "<", Less }, { ">", Greater },
+		{ "<=", LessEqual }, { ">=", GreaterEqual },
+		{ "==", Equal }, { "!=", NotEqual },
+		{ "^", Caret }, { "|", Pipe },
+		{ "&&", LogicalAnd }, { "||", LogicalOr },
+		{ "?", Question }, { ":", Colon }, { ";", Semicolon },
+		{ "...", Ellipsis },
+		{ "=", Assign }, { "*=", StarAssign }, { "/=", SlashAssign },
+		{ "%=", PercentAssign }, { "+=", PlusAssign }, { "-=", MinusAssign },
+		{ "<<=", LeftShiftAssign }, { ">>=", RightShiftAssign },
+		{ "&=", AmpersandAssign }, { "^=", CaretAssign }, { "|=", PipeAssign },
+		{ ",", Comma },
+		{ "<:", LeftBracket }, { ":>", RightBracket },
+		{ "<%", LeftBrace }, { "%>", RightBrace }
+	};
+
+	for (const auto& [str, kind] : kinds) {
+		if (str == punctuator.str) return kind;
+	}
+	return std::nullopt;
+}
+
+const char* keywordSpelling(Keyword keyword)
+{
+	for (const auto& [spelling, kw] : keywordPairs) {
+		if (kw == keyword) return spelling;
+	}
+	return "";
+}
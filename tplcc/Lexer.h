@@ -8,6 +8,7 @@
 #include <optional>
 #include <variant>
 #include <concepts>
+#include <tuple>
 
 #include "scanner.h"
 #include "error.h"
@@ -25,24 +26,72 @@ struct Punctuator {
 	bool operator==(const Punctuator&) const = default;
 };
 
+// Punctuators as the parser sees them, digraphs are folded into the
+// punctuators they stand for (e.g. "<:" is LeftBracket).
+enum class PunctuatorKind : std::uint8_t {
+	LeftBracket,
+	RightBracket,
+	LeftParenthesis,
+	RightParenthesis,
+	LeftBrace,
+	RightBrace,
+	Dot,
+	Arrow,
+	Increment,
+	Decrement,
+	Ampersand,
+	Star,
+	Plus,
+	Minus,
+	Tilde,
+	Exclamation,
+	Slash,
+	Percent,
+	LeftShift,
+	RightShift,
+	Less,
+	Greater,
+	LessEqual,
+	GreaterEqual,
+	Equal,
+	NotEqual,
+	Caret,
+	Pipe,
+	LogicalAnd,
+	LogicalOr,
+	Question,
+	Colon,
+	Semicolon,
+	Ellipsis,
+	Assign,
+	StarAssign,
+	SlashAssign,
+	PercentAssign,
+	PlusAssign,
+	MinusAssign,
+	LeftShiftAssign,
+	RightShiftAssign,
+	AmpersandAssign,
+	CaretAssign,
+	PipeAssign,
+	Comma
+};
+
+constexpr std::size_t NUMBER_OF_PUNCTUATOR_KINDS =
+	static_cast<std::size_t>(PunctuatorKind::Comma) + 1;
+
+std::optional<PunctuatorKind> punctuatorKind(const Punctuator& punctuator);
+
 struct Identifier {
 	std::string str;
 	bool operator==(const Identifier&) const = default;
 };
 
-// The type of a number literal without a type suffix is uncertain
-// until we've parsed the expression surrounds it. for example:
-// 
-// ``` c
-// char a = 128;
-// int b = 128 * a; 
-// ```
-// 
-// Because the variable "a" is a "char", the literal should be a "char" too, and the 
-// whole expression should overflow even though we assign it to a larger type "int" later.
-// We cannot know what type the literal "128" is until we've parsed the whole expression.
-// So instead converting the string to a number here, it is better to store the string we've parsed
-// and let the parser to convert it to any type it needs.
+// A number literal is kept as it is spelled. Its type depends on its value
+// as well as on its suffix (an unsuffixed 2147483648 is a long, an unsuffixed
+// 0xFFFFFFFF an unsigned int), and the value is only needed once the literal
+// is used in an expression, so the semantic analysis (see sema.h) decodes it
+// and gives it its type.
 
 struct NumberLiteral {
 	std::string str;
@@ -96,6 +145,7 @@ enum class Keyword {
 	Register,
 	Restrict,
 	Return,
+	Short,
 	Signed,
 	Sizeof,
 	Static,
@@ -115,6 +165,8 @@ struct EndOfInput {
 
 constexpr const EndOfInput EOI;
 
+const char* keywordSpelling(Keyword keyword);
+
 using Token = std::variant<
 	Punctuator,
 	Identifier,
@@ -130,9 +182,15 @@ class Lexer {
 private:
 	ILexerScanner& scanner;
 	IReportError& errOut;
+	std::uint32_t tokenStartOffset = 0;
 public:
 	Lexer(ILexerScanner& is, IReportError& errOut): scanner(is), errOut(errOut){}
 	std::optional<Token> next();
+
+	// The range of the token that the last call of next() returned.
+	std::tuple<std::uint32_t, std::uint32_t> lastTokenRange() {
+		return { tokenStartOffset, scanner.offset() };
+	}
 private:
 	std::string readIdentString();
 	std::optional<Keyword> findKeyword(const std::string& str);
@@ -0,0 +1,284 @@
+#include "assembly-writer.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+using X86::Instruction;
+using X86::Mnemonic;
+using X86::Operand;
+
+constexpr const char* MNEMONICS[] = {
+    "",    "mov", "movs", "movz", "lea",  "add",  "sub",   "imul",
+    "and", "or",  "xor",  "cmp",  "test", "shl",  "shr",   "sar",
+    "neg", "not", "",     "idiv", "div",  "set",  "j",     "jmp",
+    "call", "ret", "push", "pop", "leave", "ud2",
+};
+
+char suffix(std::uint32_t size) {
+  switch (size) {
+    case 1: return 'b';
+    case 2: return 'w';
+    case 4: return 'l';
+    default: return 'q';
+  }
+}
+
+class AssemblyWriter {
+  const Module& module;
+  BufferedWriter& out;
+  std::size_t functionIndex = 0;
+  enum class Section { None, Text, Data, Relro, ReadOnly, Bss };
+  Section section = Section::None;
+
+ public:
+  AssemblyWriter(const Module& module, BufferedWriter& out)
+      : module(module), out(out) {}
+
+  void function(const MachineFunction& function, std::size_t index);
+  void global(const GlobalData& global);
+  void end();
+
+ private:
+  void switchTo(Section next);
+  void symbolHeader(std::uint32_t symbol, const char* type);
+  void instruction(const Instruction& inst);
+  void operand(const Operand& operand, std::uint32_t size);
+  void label(std::uint32_t label);
+  void bytes(const GlobalData& global, std::uint64_t from, std::uint64_t to);
+  void name(std::uint32_t symbol) { out.write(module[symbol].name); }
+};
+
+void AssemblyWriter::function(const MachineFunction& function,
+                              std::size_t index) {
+  functionIndex = index;
+  switchTo(Section::Text);
+  symbolHeader(function.symbol, "@function");
+  for (const auto& inst : function.code) instruction(inst);
+  out.write("\t.size\t");
+  name(function.symbol);
+  out.write(", .-");
+  name(function.symbol);
+  out.put('\n');
+}
+
+void AssemblyWriter::global(const GlobalData& global) {
+  const bool isZero = global.bytes.empty() && global.relocations.empty();
+  // Read-only data with addresses in it is written by the dynamic linker in
+  // position-independent executables.
+  switchTo(global.isReadOnly ? (global.relocations.empty() ? Section::ReadOnly
+                                                           : Section::Relro)
+           : isZero          ? Section::Bss
+                             : Section::Data);
+  out.write("\t.balign\t").writeUnsigned(global.align).put('\n');
+  symbolHeader(global.symbol, "@object");
+  out.write("\t.size\t");
+  name(global.symbol);
+  out.write(", ").writeUnsigned(global.size).put('\n');
+
+  auto relocations = global.relocations;
+  std::sort(relocations.begin(), relocations.end(),
+            [](const auto& a, const auto& b) { return a.offset < b.offset; });
+  std::uint64_t offset = 0;
+  for (const auto& relocation : relocations) {
+    bytes(global, offset, relocation.offset);
+    out.write("\t.quad\t");
+    name(relocation.symbol);
+    if (relocation.addend > 0) out.put('+');
+    if (relocation.addend != 0) out.writeSigned(relocation.addend);
+    out.put('\n');
+    offset = relocation.offset + 8;
+  }
+  bytes(global, offset, global.size);
+}
+
+void AssemblyWriter::end() {
+  // The stack doesn't have to be executable.
+  out.write("\t.section\t.note.GNU-stack,\"\",@progbits\n");
+}
+
+void AssemblyWriter::switchTo(Section next) {
+  if (section == next) return;
+  section = next;
+  switch (next) {
+    case Section::Text:
+      out.write("\t.text\n");
+      break;
+    case Section::Data:
+      out.write("\t.data\n");
+      break;
+    case Section::Relro:
+      out.write("\t.section\t.data.rel.ro,\"aw\"\n");
+      break;
+    case Section::ReadOnly:
+      out.write("\t.section\t.rodata\n");
+      break;
+    default:
+      out.write("\t.bss\n");
+      break;
+  }
+}
+
+void AssemblyWriter::symbolHeader(std::uint32_t symbol, const char* type) {
+  if (!module[symbol].isLocal) {
+    out.write("\t.globl\t");
+    name(symbol);
+    out.put('\n');
+  }
+  out.write("\t.type\t");
+  name(symbol);
+  out.write(", ").write(type).put('\n');
+  name(symbol);
+  out.write(":\n");
+}
+
+void AssemblyWriter::instruction(const Instruction& inst) {
+  if (inst.mnemonic == Mnemonic::Label) {
+    label(inst.destination.symbol);
+    out.write(":\n");
+    return;
+  }
+
+  out.put('\t');
+  const auto& source = inst.source;
+  const auto& destination = inst.destination;
+  auto sourceSize = static_cast<std::uint32_t>(inst.size);
+  auto destinationSize = static_cast<std::uint32_t>(inst.size);
+  switch (inst.mnemonic) {
+    case Mnemonic::Mov:
+      if (source.kind == Operand::Kind::Immediate && inst.size == 8 &&
+          source.value != static_cast<std::int32_t>(source.value)) {
+        out.write("movabsq");
+      } else {
+        out.write("mov").put(suffix(inst.size));
+      }
+      break;
+    case Mnemonic::MovSX:
+    case Mnemonic::MovZX:
+      sourceSize = inst.sourceSize;
+      if (inst.mnemonic == Mnemonic::MovSX && sourceSize == 4) {
+        out.write("movslq");
+      } else {
+        out.write(MNEMONICS[static_cast<std::size_t>(inst.mnemonic)])
+            .put(suffix(sourceSize))
+            .put(suffix(inst.size));
+      }
+      break;
+    case Mnemonic::SignExtendAccumulator:
+      out.write(inst.size == 8 ? "cqto\n" : "cltd\n");
+      return;
+    case Mnemonic::SetCC:
+    case Mnemonic::Jcc:
+      destinationSize = 1;
+      out.write(MNEMONICS[static_cast<std::size_t>(inst.mnemonic)])
+          .write(X86::conditionSuffix(inst.condition));
+      break;
+    case Mnemonic::Jmp:
+    case Mnemonic::Call:
+      out.write(MNEMONICS[static_cast<std::size_t>(inst.mnemonic)]);
+      if (destination.kind == Operand::Kind::Register) out.write("\t*");
+      break;
+    case Mnemonic::Ret:
+    case Mnemonic::Leave:
+    case Mnemonic::Ud2:
+      out.write(MNEMONICS[static_cast<std::size_t>(inst.mnemonic)]).put('\n');
+      return;
+    case Mnemonic::Shl:
+    case Mnemonic::Shr:
+    case Mnemonic::Sar:
+      // The count in CL.
+      sourceSize = 1;
+      [[fallthrough]];
+    default:
+      out.write(MNEMONICS[static_cast<std::size_t>(inst.mnemonic)])
+          .put(suffix(inst.size));
+      break;
+  }
+
+  if (destination.kind == Operand::Kind::Register &&
+      (inst.mnemonic == Mnemonic::Jmp || inst.mnemonic == Mnemonic::Call)) {
+    operand(destination, 8);
+    out.put('\n');
+    return;
+  }
+  out.put('\t');
+  if (source.kind != Operand::Kind::None) {
+    operand(source, sourceSize);
+    out.write(", ");
+  }
+  operand(destination, destinationSize);
+  out.put('\n');
+}
+
+void AssemblyWriter::operand(const Operand& operand, std::uint32_t size) {
+  switch (operand.kind) {
+    case Operand::Kind::Register:
+      out.put('%').write(X86::registerName(operand.reg, size));
+      break;
+    case Operand::Kind::Immediate:
+      out.put('$').writeSigned(operand.value);
+      break;
+    case Operand::Kind::Memory:
+      if (operand.symbol != 0) {
+        name(operand.symbol);
+        if (operand.isExternal) {
+          out.write("@GOTPCREL");
+        } else if (operand.value > 0) {
+          out.put('+').writeSigned(operand.value);
+        } else if (operand.value < 0) {
+          out.writeSigned(operand.value);
+        }
+        out.write("(%rip)");
+      } else {
+        if (operand.value != 0) out.writeSigned(operand.value);
+        out.write("(%").write(X86::registerName(operand.reg, 8)).put(')');
+      }
+      break;
+    case Operand::Kind::Symbol:
+      name(operand.symbol);
+      if (operand.isExternal) out.write("@PLT");
+      break;
+    case Operand::Kind::Label:
+      label(operand.symbol);
+      break;
+    default:
+      break;
+  }
+}
+
+void AssemblyWriter::label(std::uint32_t label) {
+  out.write(".LBB").writeUnsigned(functionIndex).put('_').writeUnsigned(label);
+}
+
+// The initial content from one offset to another, there are no relocations
+// in between.
+void AssemblyWriter::bytes(const GlobalData& global, std::uint64_t from,
+                           std::uint64_t to) {
+  const auto end = std::min<std::uint64_t>(to, global.bytes.size());
+  for (auto offset = from; offset < end;) {
+    out.write("\t.byte\t");
+    const auto lineEnd = std::min<std::uint64_t>(offset + 16, end);
+    for (auto i = offset; i < lineEnd; i++) {
+      if (i != offset) out.put(',');
+      out.writeUnsigned(static_cast<unsigned char>(global.bytes[i]));
+    }
+    out.put('\n');
+    offset = lineEnd;
+  }
+  const auto zerosFrom = std::max(from, end);
+  if (zerosFrom < to) {
+    out.write("\t.zero\t").writeUnsigned(to - zerosFrom).put('\n');
+  }
+}
+}  // namespace
+
+void writeAssembly(const Module& module,
+                   std::span<const MachineFunction> functions,
+                   BufferedWriter& out) {
+  AssemblyWriter writer(module, out);
+  for (std::size_t i = 0; i < functions.size(); i++) {
+    writer.function(functions[i], i);
+  }
+  for (const auto& global : module.globals) writer.global(global);
+  writer.end();
+}
@@ -0,0 +1,21 @@
+#ifndef TPLCC_ASSEMBLY_WRITER_H
+#define TPLCC_ASSEMBLY_WRITER_H
+
+#include <span>
+
+#include "buffered-writer.h"
+#include "code-generation.h"
+#include "ir.h"
+
+// Write a module as input for the GNU assembler, in AT&T syntax: the
+// functions, in the order given, in .text, then the globals in .data,
+// .data.rel.ro, .rodata or .bss. The labels of function i are
+// .LBB<i>_<label>.
+//
+// Everything is formatted by hand into the writer, no stream operation or
+// std::format per instruction, so give it a large buffer.
+void writeAssembly(const Module& module,
+                   std::span<const MachineFunction> functions,
+                   BufferedWriter& out);
+
+#endif
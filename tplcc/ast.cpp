@@ -0,0 +1,398 @@
+#include "ast.h"
+
+#include <string>
+
+const char* operatorSpelling(Operator op) {
+  switch (op) {
+    case Operator::None: return "";
+    case Operator::Plus: return "+";
+    case Operator::Minus: return "-";
+    case Operator::BitwiseNot: return "~";
+    case Operator::LogicalNot: return "!";
+    case Operator::Dereference: return "*";
+    case Operator::AddressOf: return "&";
+    case Operator::PreIncrement: return "pre++";
+    case Operator::PreDecrement: return "pre--";
+    case Operator::PostIncrement: return "post++";
+    case Operator::PostDecrement: return "post--";
+    case Operator::Multiply: return "*";
+    case Operator::Divide: return "/";
+    case Operator::Remainder: return "%";
+    case Operator::Add: return "+";
+    case Operator::Subtract: return "-";
+    case Operator::ShiftLeft: return "<<";
+    case Operator::ShiftRight: return ">>";
+    case Operator::Less: return "<";
+    case Operator::Greater: return ">";
+    case Operator::LessEqual: return "<=";
+    case Operator::GreaterEqual: return ">=";
+    case Operator::Equal: return "==";
+    case Operator::NotEqual: return "!=";
+    case Operator::BitwiseAnd: return "&";
+    case Operator::BitwiseXor: return "^";
+    case Operator::BitwiseOr: return "|";
+    case Operator::LogicalAnd: return "&&";
+    case Operator::LogicalOr: return "||";
+    case Operator::Comma: return ",";
+  }
+  return "";
+}
+
+namespace {
+const char* storageClassSpelling(StorageClass storage) {
+  switch (storage) {
+    case StorageClass::None: return "";
+    case StorageClass::Typedef: return "typedef ";
+    case StorageClass::Extern: return "extern ";
+    case StorageClass::Static: return "static ";
+    case StorageClass::Auto: return "auto ";
+    case StorageClass::Register: return "register ";
+  }
+  return "";
+}
+
+void appendQualifiers(std::string& output, std::uint8_t qualifiers) {
+  if (qualifiers & TypeQualifier::Const) output += "const ";
+  if (qualifiers & TypeQualifier::Volatile) output += "volatile ";
+  if (qualifiers & TypeQualifier::Restrict) output += "restrict ";
+}
+
+void appendSpecifiers(std::string& output, std::uint16_t specifiers) {
+  static const struct {
+    std::uint16_t specifier;
+    const char* spelling;
+  } SPELLINGS[] = {
+      {TypeSpecifier::Signed, "signed"},   {TypeSpecifier::Unsigned, "unsigned"},
+      {TypeSpecifier::Short, "short"},     {TypeSpecifier::Long, "long"},
+      {TypeSpecifier::LongLong, "long"},   {TypeSpecifier::Void, "void"},
+      {TypeSpecifier::Bool, "_Bool"},      {TypeSpecifier::Char, "char"},
+      {TypeSpecifier::Int, "int"},         {TypeSpecifier::Float, "float"},
+      {TypeSpecifier::Double, "double"},   {TypeSpecifier::Complex, "_Complex"},
+  };
+
+  bool isFirst = true;
+  for (const auto& [specifier, spelling] : SPELLINGS) {
+    if (!(specifiers & specifier)) continue;
+    if (!isFirst) output.push_back(' ');
+    output += spelling;
+    isFirst = false;
+  }
+}
+
+class SExpressionWriter {
+  const AST& ast;
+  const StringInterner& strings;
+  std::string output;
+
+ public:
+  SExpressionWriter(const AST& ast, const StringInterner& strings)
+      : ast(ast), strings(strings) {}
+
+  std::string take() { return std::move(output); }
+
+  void write(NodeID id) {
+    if (id == 0) {
+      output += "-";
+      return;
+    }
+
+    const Node& node = ast[id];
+    switch (node.kind) {
+      case NodeKind::Invalid: output += "<invalid>"; break;
+
+      case NodeKind::IntegerLiteral:
+      case NodeKind::FloatingLiteral:
+      case NodeKind::Identifier:
+      case NodeKind::FieldDesignator:
+        output += strings.view(node.name);
+        break;
+      case NodeKind::CharacterLiteral:
+        if (node.flags & NodeFlag::Wide) output += "L";
+        output += "'";
+        output += strings.view(node.name);
+        output += "'";
+        break;
+      case NodeKind::StringLiteral:
+        if (node.flags & NodeFlag::Wide) output += "L";
+        output += "\"";
+        output += strings.view(node.name);
+        output += "\"";
+        break;
+      case NodeKind::Unary:
+        open(operatorSpelling(node.oper()), {node.a});
+        break;
+      case NodeKind::Binary:
+        open(operatorSpelling(node.oper()), {node.a, node.b});
+        break;
+      case NodeKind::Assign:
+        output += "(";
+        output += operatorSpelling(node.oper());
+        output += "=";
+        children({node.a, node.b});
+        break;
+      case NodeKind::Conditional:
+        open("?", {node.a, node.b, node.c});
+        break;
+      case NodeKind::Cast: open("cast", {node.a, node.b}); break;
+      case NodeKind::SizeofExpr:
+      case NodeKind::SizeofType: open("sizeof", {node.a}); break;
+      case NodeKind::Call:
+        output += "(call ";
+        write(node.a);
+        list(node.list);
+        break;
+      case NodeKind::Subscript: open("[]", {node.a, node.b}); break;
+      case NodeKind::Member:
+        output += (node.flags & NodeFlag::Arrow) ? "(-> " : "(. ";
+        write(node.a);
+        output += " ";
+        output += strings.view(node.name);
+        output += ")";
+        break;
+      case NodeKind::CompoundLiteral:
+        open("compound-literal", {node.a, node.b});
+        break;
+      case NodeKind::InitList:
+        output += "{";
+        for (std::size_t i = 0; const auto element : ast.list(node.list)) {
+          if (i++ > 0) output += " ";
+          write(element);
+        }
+        output += "}";
+        break;
+      case NodeKind::Designation:
+        output += "(designation";
+        for (const auto designator : ast.list(node.list)) {
+          output += " ";
+          if (ast[designator].kind == NodeKind::FieldDesignator) {
+            output += ".";
+            write(designator);
+          } else {
+            output += "[";
+            write(ast[designator].a);
+            output += "]";
+          }
+        }
+        output += " ";
+        write(node.b);
+        output += ")";
+        break;
+      case NodeKind::ArrayDesignator: write(node.a); break;
+
+      case NodeKind::CompoundStmt:
+        output += "(compound";
+        list(node.list);
+        break;
+      case NodeKind::ExprStmt:
+        output += "(expr";
+        if (node.a != 0) {
+          output += " ";
+          write(node.a);
+        }
+        output += ")";
+        break;
+      case NodeKind::IfStmt:
+        if (node.c != 0) {
+          open("if", {node.a, node.b, node.c});
+        } else {
+          open("if", {node.a, node.b});
+        }
+        break;
+      case NodeKind::WhileStmt: open("while", {node.a, node.b}); break;
+      case NodeKind::DoStmt: open("do", {node.a, node.b}); break;
+      case NodeKind::ForStmt: open("for", {node.a, node.b, node.c, node.d}); break;
+      case NodeKind::SwitchStmt: open("switch", {node.a, node.b}); break;
+      case NodeKind::CaseStmt: open("case", {node.a, node.b}); break;
+      case NodeKind::DefaultStmt: open("default", {node.b}); break;
+      case NodeKind::LabelStmt:
+        named("label", node);
+        children({node.b});
+        break;
+      case NodeKind::GotoStmt:
+        named("goto", node);
+        output += ")";
+        break;
+      case NodeKind::BreakStmt: output += "(break)"; break;
+      case NodeKind::ContinueStmt: output += "(continue)"; break;
+      case NodeKind::ReturnStmt:
+        if (node.a != 0) {
+          open("return", {node.a});
+        } else {
+          output += "(return)";
+        }
+        break;
+
+      case NodeKind::TranslationUnit:
+        output += "(translation-unit";
+        list(node.list);
+        break;
+      case NodeKind::DeclGroup:
+        output += "(decls";
+        if (node.list.size == 0) {
+          output += " ";
+          write(node.a);
+        }
+        list(node.list);
+        break;
+      case NodeKind::VarDecl:
+        output += "(var ";
+        output += storageClassSpelling(static_cast<StorageClass>(node.op));
+        output += strings.view(node.name);
+        children(node.b != 0 ? std::initializer_list<NodeID>{node.a, node.b}
+                             : std::initializer_list<NodeID>{node.a});
+        break;
+      case NodeKind::FunctionDecl:
+        output += "(function ";
+        output += storageClassSpelling(static_cast<StorageClass>(node.op));
+        if (node.flags & NodeFlag::Inline) output += "inline ";
+        output += strings.view(node.name);
+        children({node.a});
+        break;
+      case NodeKind::FunctionDef:
+        open("function-definition", {node.a, node.b});
+        break;
+      case NodeKind::TypedefDecl:
+        named("typedef", node);
+        children({node.a});
+        break;
+      case NodeKind::ParamDecl:
+        if (node.name != 0) {
+          named("param", node);
+          children({node.a});
+        } else {
+          open("param", {node.a});
+        }
+        break;
+      case NodeKind::FieldDecl:
+        named("field", node);
+        children(node.b != 0 ? std::initializer_list<NodeID>{node.a, node.b}
+                             : std::initializer_list<NodeID>{node.a});
+        break;
+      case NodeKind::EnumConstantDecl:
+        named("enumerator", node);
+        if (node.a != 0) {
+          children({node.a});
+        } else {
+          output += ")";
+        }
+        break;
+      case NodeKind::RecordDefinition:
+      case NodeKind::EnumDefinition:
+        list(node.list, false);
+        break;
+
+      case NodeKind::BuiltinType:
+        appendQualifiers(output, node.op);
+        appendSpecifiers(output, node.flags);
+        break;
+      case NodeKind::PointerType:
+        output += "(* ";
+        appendQualifiers(output, node.op);
+        write(node.a);
+        output += ")";
+        break;
+      case NodeKind::ArrayType:
+        output += "([] ";
+        appendQualifiers(output, node.op);
+        if (node.flags & NodeFlag::StaticSize) output += "static ";
+        write(node.a);
+        if (node.b != 0) {
+          output += " ";
+          write(node.b);
+        } else if (node.flags & NodeFlag::VLAStar) {
+          output += " *";
+        }
+        output += ")";
+        break;
+      case NodeKind::FunctionType:
+        output += "(fn ";
+        write(node.a);
+        for (const auto param : ast.list(node.list)) {
+          output += " ";
+          write(param);
+        }
+        if (node.flags & NodeFlag::Variadic) output += " ...";
+        output += ")";
+        break;
+      case NodeKind::RecordType:
+      case NodeKind::EnumType:
+        output += "(";
+        output += node.kind == NodeKind::EnumType          ? "enum"
+                  : (node.flags & NodeFlag::Union) != 0 ? "union"
+                                                           : "struct";
+        if (node.name != 0) {
+          output += " ";
+          output += strings.view(node.name);
+        }
+        if (node.b != 0) write(node.b);
+        output += ")";
+        break;
+      case NodeKind::TypedefType:
+        output += strings.view(node.name);
+        break;
+      case NodeKind::QualifiedType:
+        appendQualifiers(output, node.op);
+        write(node.a);
+        break;
+    }
+  }
+
+ private:
+  void open(const char* head, std::initializer_list<NodeID> ids) {
+    output += "(";
+    output += head;
+    children(ids);
+  }
+
+  void named(const char* head, const Node& node) {
+    output += "(";
+    output += head;
+    output += " ";
+    output += strings.view(node.name);
+  }
+
+  void children(std::initializer_list<NodeID> ids) {
+    for (const auto id : ids) {
+      output += " ";
+      write(id);
+    }
+    output += ")";
+  }
+
+  void list(ListRef ref, bool close = true) {
+    for (const auto id : ast.list(ref)) {
+      output += " ";
+      write(id);
+    }
+    if (close) output += ")";
+  }
+};
+}  // namespace
+
+AST::AST() { nodes.emplace_back(); }
+
+ListRef AST::endList(std::size_t mark) {
+  const ListRef ref{static_cast<std::uint32_t>(lists.size()),
+                    static_cast<std::uint32_t>(scratch.size() - mark)};
+  lists.insert(lists.end(), scratch.begin() + mark, scratch.end());
+  scratch.resize(mark);
+  return ref;
+}
+
+void AST::reserve(std::size_t numberOfNodes) {
+  nodes.reserve(numberOfNodes);
+  lists.reserve(numberOfNodes);
+}
+
+void AST::reset() {
+  nodes.resize(1);
+  lists.clear();
+  scratch.clear();
+}
+
+std::string toSExpression(const AST& ast, const StringInterner& strings,
+                          NodeID id) {
+  SExpressionWriter writer(ast, strings);
+  writer.write(id);
+  return writer.take();
+}
@@ -0,0 +1,309 @@
+#ifndef TPLCC_AST_H
+#define TPLCC_AST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "code-buffer.h"
+#include "string-interner.h"
+
+// Nodes refer to each other by their indices in the AST, 0 means "no node".
+using NodeID = std::uint32_t;
+
+enum class NodeKind : std::uint8_t {
+  Invalid,
+
+  // Expressions
+  IntegerLiteral,
+  FloatingLiteral,
+  CharacterLiteral,
+  StringLiteral,
+  Identifier,
+  Unary,
+  Binary,
+  Assign,
+  Conditional,
+  Cast,
+  SizeofExpr,
+  SizeofType,
+  Call,
+  Subscript,
+  Member,
+  CompoundLiteral,
+  InitList,
+  Designation,
+  FieldDesignator,
+  ArrayDesignator,
+
+  // Statements
+  CompoundStmt,
+  ExprStmt,
+  IfStmt,
+  WhileStmt,
+  DoStmt,
+  ForStmt,
+  SwitchStmt,
+  CaseStmt,
+  DefaultStmt,
+  LabelStmt,
+  GotoStmt,
+  BreakStmt,
+  ContinueStmt,
+  ReturnStmt,
+
+  // Declarations
+  TranslationUnit,
+  DeclGroup,
+  VarDecl,
+  FunctionDecl,
+  FunctionDef,
+  TypedefDecl,
+  ParamDecl,
+  FieldDecl,
+  EnumConstantDecl,
+  RecordDefinition,
+  EnumDefinition,
+
+  // Types, as they are written in the source
+  BuiltinType,
+  PointerType,
+  ArrayType,
+  FunctionType,
+  RecordType,
+  EnumType,
+  TypedefType,
+  QualifiedType,
+};
+
+enum class Operator : std::uint8_t {
+  None,
+
+  // Unary
+  Plus,
+  Minus,
+  BitwiseNot,
+  LogicalNot,
+  Dereference,
+  AddressOf,
+  PreIncrement,
+  PreDecrement,
+  PostIncrement,
+  PostDecrement,
+
+  // Binary
+  Multiply,
+  Divide,
+  Remainder,
+  Add,
+  Subtract,
+  ShiftLeft,
+  ShiftRight,
+  Less,
+  Greater,
+  LessEqual,
+  GreaterEqual,
+  Equal,
+  NotEqual,
+  BitwiseAnd,
+  BitwiseXor,
+  BitwiseOr,
+  LogicalAnd,
+  LogicalOr,
+  Comma,
+};
+
+enum class StorageClass : std::uint8_t {
+  None,
+  Typedef,
+  Extern,
+  Static,
+  Auto,
+  Register,
+};
+
+namespace TypeQualifier {
+constexpr std::uint8_t Const = 1 << 0;
+constexpr std::uint8_t Volatile = 1 << 1;
+constexpr std::uint8_t Restrict = 1 << 2;
+}  // namespace TypeQualifier
+
+// The type specifiers of a BuiltinType, "long long" sets both Long and
+// LongLong.
+namespace TypeSpecifier {
+constexpr std::uint16_t Void = 1 << 0;
+constexpr std::uint16_t Char = 1 << 1;
+constexpr std::uint16_t Short = 1 << 2;
+constexpr std::uint16_t Int = 1 << 3;
+constexpr std::uint16_t Long = 1 << 4;
+constexpr std::uint16_t LongLong = 1 << 5;
+constexpr std::uint16_t Float = 1 << 6;
+constexpr std::uint16_t Double = 1 << 7;
+constexpr std::uint16_t Signed = 1 << 8;
+constexpr std::uint16_t Unsigned = 1 << 9;
+constexpr std::uint16_t Bool = 1 << 10;
+constexpr std::uint16_t Complex = 1 << 11;
+}  // namespace TypeSpecifier
+
+// Meaning of Node::flags, depending on the kind of the node.
+namespace NodeFlag {
+constexpr std::uint16_t Wide = 1 << 0;         // CharacterLiteral, StringLiteral
+constexpr std::uint16_t Arrow = 1 << 0;        // Member
+constexpr std::uint16_t Inline = 1 << 0;       // FunctionDecl
+constexpr std::uint16_t Union = 1 << 0;        // RecordType
+constexpr std::uint16_t Variadic = 1 << 0;     // FunctionType
+constexpr std::uint16_t NoPrototype = 1 << 1;  // FunctionType
+constexpr std::uint16_t StaticSize = 1 << 0;   // ArrayType
+constexpr std::uint16_t VLAStar = 1 << 1;      // ArrayType
+}  // namespace NodeFlag
+
+struct ListRef {
+  std::uint32_t first = 0;
+  std::uint32_t size = 0;
+};
+
+// Every node has the same compact layout, what the fields mean depends on the
+// kind of the node:
+//
+// IntegerLiteral    name: spelling
+// FloatingLiteral   name: spelling
+// CharacterLiteral  name: content as written between the quotes, flags: Wide
+// StringLiteral     name: content with escapes decoded and adjacent literals
+//                   concatenated, each element of a wide literal takes 4
+//                   little-endian bytes, flags: Wide
+// Identifier        name, a: the declaration it refers to (0 if undeclared)
+// Unary             op, a: operand
+// Binary            op, a: left, b: right
+// Assign            op: the operator of a compound assignment or None, a, b
+// Conditional       a ? b : c
+// Cast              a: type, b: operand
+// SizeofExpr        a: operand
+// SizeofType        a: type
+// Call              a: callee, list: arguments
+// Subscript         a[b]
+// Member            a: object, name: member, flags: Arrow
+// CompoundLiteral   a: type, b: InitList
+// InitList          list: expressions, InitLists and Designations
+// Designation       list: FieldDesignators and ArrayDesignators, b: initializer
+// FieldDesignator   name
+// ArrayDesignator   a: index
+//
+// CompoundStmt      list: statements and DeclGroups
+// ExprStmt          a: expression, 0 for a null statement
+// IfStmt            a: condition, b: then, c: else
+// WhileStmt         a: condition, b: body
+// DoStmt            a: body, b: condition
+// ForStmt           a: DeclGroup or ExprStmt, b: condition, c: step, d: body
+// SwitchStmt        a: condition, b: body, list: its CaseStmts and DefaultStmt
+// CaseStmt          a: value, b: statement
+// DefaultStmt       b: statement
+// LabelStmt         name, b: statement
+// GotoStmt          name, a: LabelStmt
+// ReturnStmt        a: value
+//
+// TranslationUnit   list: DeclGroups and FunctionDefs
+// DeclGroup         a: the type specified by the declaration specifiers,
+//                   list: the declarations
+// VarDecl           op: storage class, a: type, b: initializer, name
+// FunctionDecl      op: storage class, a: FunctionType, name, flags: Inline
+// FunctionDef       a: FunctionDecl, b: body
+// TypedefDecl       a: type, name
+// ParamDecl         a: type (0 for an identifier list parameter that isn't
+//                   declared), name (0 for abstract declarators)
+// FieldDecl         a: type, b: bit-field width, name
+// EnumConstantDecl  a: value, c: EnumType, name
+// RecordDefinition  a: RecordType, list: FieldDecls
+// EnumDefinition    a: EnumType, list: EnumConstantDecls
+//
+// BuiltinType       op: qualifiers, flags: type specifiers
+// PointerType       op: qualifiers, a: pointee
+// ArrayType         op: qualifiers, a: element, b: size, flags: StaticSize,
+//                   VLAStar
+// FunctionType      a: return type, list: ParamDecls, flags: Variadic,
+//                   NoPrototype
+// RecordType        name: tag, a: the RecordType declaring the tag (itself if
+//                   it does), b: RecordDefinition (set on the declaring node
+//                   and on the node followed by the definition), flags: Union
+// EnumType          name: tag, a: like RecordType, b: EnumDefinition
+// TypedefType       name, a: TypedefDecl
+// QualifiedType     op: qualifiers, a: the qualified RecordType, EnumType or
+//                   TypedefType
+//
+// Nodes are created in post-order, i.e. a node comes after its children in
+// the AST. The exceptions are declarations that can be referred to from
+// their own children: a VarDecl comes before its initializer, a FunctionDecl
+// before the body of its definition, a RecordType or EnumType declaring a
+// tag before its members and the ParamDecls of an identifier list before the
+// types given to them by the declaration list. Passes that only need the children first can
+// therefore walk the nodes linearly.
+struct Node {
+  NodeKind kind = NodeKind::Invalid;
+  std::uint8_t op = 0;
+  std::uint16_t flags = 0;
+  CodeBuffer::Offset offset = 0;
+  NodeID a = 0;
+  NodeID b = 0;
+  NodeID c = 0;
+  union {
+    NodeID d = 0;
+    StringID name;
+  };
+  ListRef list;
+
+  Operator oper() const { return static_cast<Operator>(op); }
+};
+
+static_assert(sizeof(Node) == 32);
+
+// The nodes of a translation unit. Nodes and lists are appended to two
+// contiguous arrays, which makes allocating a node as cheap as bumping an
+// index and throwing the whole tree away a matter of resetting the arrays.
+class AST {
+  std::vector<Node> nodes;
+  std::vector<NodeID> lists;
+  std::vector<NodeID> scratch;
+
+ public:
+  AST();
+
+  NodeID add(const Node& node) {
+    nodes.push_back(node);
+    return static_cast<NodeID>(nodes.size() - 1);
+  }
+
+  Node& operator[](NodeID id) { return nodes[id]; }
+  const Node& operator[](NodeID id) const { return nodes[id]; }
+
+  // Number of nodes, including the "no node" at index 0.
+  std::size_t size() const { return nodes.size(); }
+
+  // Lists are built on a scratch stack, because the elements of a list are
+  // often parsed along with the elements of nested lists. When the list is
+  // complete, endList moves its elements to a contiguous piece of storage.
+  std::size_t beginList() const { return scratch.size(); }
+  void pushToList(NodeID id) { scratch.push_back(id); }
+  ListRef endList(std::size_t mark);
+  void abandonList(std::size_t mark) { scratch.resize(mark); }
+
+  std::span<const NodeID> list(ListRef ref) const {
+    return {lists.data() + ref.first, ref.size};
+  }
+
+  void reserve(std::size_t numberOfNodes);
+
+  // Drop all nodes but keep the memory, so the next translation unit doesn't
+  // have to allocate it again.
+  void reset();
+};
+
+// The operator as toSExpression prints it, e.g. "+" or "post++".
+const char* operatorSpelling(Operator op);
+
+// Print the subtree as an S-expression, e.g. "(+ a (* b 2))". Used for
+// debugging and testing.
+std::string toSExpression(const AST& ast, const StringInterner& strings,
+                          NodeID id);
+
+#endif
@@ -0,0 +1,24 @@
+#include "buffered-writer.h"
+
+BufferedWriter& BufferedWriter::writeUnsigned(std::uint64_t value) {
+  char digits[20];
+  char* p = digits + sizeof(digits);
+  do {
+    *--p = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  return write(std::string_view(p, digits + sizeof(digits) - p));
+}
+
+BufferedWriter& BufferedWriter::writeSigned(std::int64_t value) {
+  if (value >= 0) return writeUnsigned(value);
+  put('-');
+  // Negate in unsigned arithmetic so that INT64_MIN doesn't overflow.
+  return writeUnsigned(~static_cast<std::uint64_t>(value) + 1);
+}
+
+void BufferedWriter::flush() {
+  if (_size == 0) return;
+  _os.write(_buffer.get(), _size);
+  _size = 0;
+}
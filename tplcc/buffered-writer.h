@@ -0,0 +1,52 @@
+#ifndef TPLCC_BUFFERED_WRITER_H
+#define TPLCC_BUFFERED_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+// Collects output in a fixed size buffer and hands it to the underlying
+// ostream in large chunks, so writers producing lots of small pieces of text
+// (diagnostics, assembly, ...) don't pay for a stream operation per piece.
+// Integers are formatted by hand for the same reason.
+class BufferedWriter {
+  std::ostream& _os;
+  std::unique_ptr<char[]> _buffer;
+  std::size_t _capacity;
+  std::size_t _size = 0;
+
+ public:
+  explicit BufferedWriter(std::ostream& os, std::size_t capacity = 1 << 16)
+      : _os(os), _buffer(new char[capacity]), _capacity(capacity) {}
+  BufferedWriter(const BufferedWriter&) = delete;
+  BufferedWriter& operator=(const BufferedWriter&) = delete;
+  ~BufferedWriter() { flush(); }
+
+  BufferedWriter& put(char ch) {
+    if (_size == _capacity) flush();
+    _buffer[_size++] = ch;
+    return *this;
+  }
+
+  BufferedWriter& write(std::string_view str) {
+    if (_size + str.size() > _capacity) {
+      flush();
+      if (str.size() > _capacity) {
+        _os.write(str.data(), str.size());
+        return *this;
+      }
+    }
+    std::memcpy(_buffer.get() + _size, str.data(), str.size());
+    _size += str.size();
+    return *this;
+  }
+
+  BufferedWriter& writeUnsigned(std::uint64_t value);
+  BufferedWriter& writeSigned(std::int64_t value);
+  void flush();
+};
+
+#endif
@@ -0,0 +1,336 @@
+#include "cfg-simplification.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+class ControlFlowSimplification {
+  Function& function;
+  std::vector<BlockID> worklist;
+  std::vector<bool> isQueued;
+  // The values removed phis were replaced by, 0 if not replaced.
+  std::vector<ValueID> replacements;
+  bool changed = false;
+
+ public:
+  explicit ControlFlowSimplification(Function& function)
+      : function(function),
+        isQueued(function.numberOfBlocks()),
+        replacements(function.size()) {}
+
+  bool run();
+
+ private:
+  void push(BlockID id);
+  void removeUnreachableBlocks();
+  void removeIfUnreachable(BlockID id);
+  bool foldBranch(BlockID id);
+  bool threadJumps(BlockID id);
+  bool mergeSuccessor(BlockID id);
+  void removeTrivialPhis();
+  void forwardUses();
+
+  bool hasSameOperands(BlockID target, std::size_t a, std::size_t b);
+  std::size_t predecessorIndex(BlockID block, BlockID predecessor) const;
+  void replace(ValueID id, ValueID value);
+  ValueID resolve(ValueID value);
+};
+
+bool ControlFlowSimplification::run() {
+  removeUnreachableBlocks();
+  const auto blocks = function.liveBlocks();
+  for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) push(*it);
+
+  while (!worklist.empty()) {
+    const auto id = worklist.back();
+    worklist.pop_back();
+    isQueued[id] = false;
+    if (function.block(id).isRemoved) continue;
+    if (foldBranch(id) || threadJumps(id)) continue;
+    mergeSuccessor(id);
+  }
+
+  removeTrivialPhis();
+  forwardUses();
+  if (changed) function.sweep();
+  return changed;
+}
+
+void ControlFlowSimplification::push(BlockID id) {
+  if (isQueued[id]) return;
+  isQueued[id] = true;
+  worklist.push_back(id);
+}
+
+void ControlFlowSimplification::removeUnreachableBlocks() {
+  std::vector<bool> isReachable(function.numberOfBlocks());
+  std::vector<BlockID> stack{Function::ENTRY};
+  isReachable[Function::ENTRY] = true;
+  while (!stack.empty()) {
+    const auto id = stack.back();
+    stack.pop_back();
+    for (const auto successor : function.block(id).successors()) {
+      if (isReachable[successor]) continue;
+      isReachable[successor] = true;
+      stack.push_back(successor);
+    }
+  }
+  for (const auto id : function.liveBlocks()) {
+    if (isReachable[id]) continue;
+    function.removeBlock(id);
+    changed = true;
+  }
+}
+
+// Remove a block that lost its last predecessor, and the blocks only it led
+// to.
+void ControlFlowSimplification::removeIfUnreachable(BlockID id) {
+  std::vector<BlockID> stack{id};
+  while (!stack.empty()) {
+    const auto block = stack.back();
+    stack.pop_back();
+    const auto& node = function.block(block);
+    if (block == Function::ENTRY || node.isRemoved ||
+        !node.predecessors.empty()) {
+      continue;
+    }
+    const auto successors = node.successorArray;
+    const auto count = node.numberOfSuccessors;
+    function.removeBlock(block);
+    changed = true;
+    for (std::uint8_t i = 0; i < count; i++) {
+      stack.push_back(successors[i]);
+      push(successors[i]);
+    }
+  }
+}
+
+bool ControlFlowSimplification::foldBranch(BlockID id) {
+  const auto terminator = function.terminator(id);
+  if (function[terminator].op != Opcode::Branch) return false;
+  const auto& block = function.block(id);
+  const auto ifTrue = block.successorArray[0];
+  const auto ifFalse = block.successorArray[1];
+
+  const auto condition = resolve(function.operands(terminator)[0]);
+  if (function[condition].op == Opcode::Const) {
+    const auto target = function[condition].imm != 0 ? ifTrue : ifFalse;
+    const auto other = target == ifTrue ? ifFalse : ifTrue;
+    function.simplifyBranch(id, target);
+    removeIfUnreachable(other);
+    push(other);
+  } else if (ifTrue == ifFalse) {
+    const auto first = predecessorIndex(ifTrue, id);
+    const auto second = std::find(function.block(ifTrue).predecessors.begin() +
+                                      static_cast<std::ptrdiff_t>(first) + 1,
+                                  function.block(ifTrue).predecessors.end(),
+                                  id) -
+                        function.block(ifTrue).predecessors.begin();
+    if (!hasSameOperands(ifTrue, first, static_cast<std::size_t>(second))) {
+      return false;
+    }
+    function.simplifyBranch(id, ifTrue);
+    push(ifTrue);
+  } else {
+    return false;
+  }
+  changed = true;
+  push(id);
+  return true;
+}
+
+// Make the predecessors of a block that only jumps jump to its target.
+bool ControlFlowSimplification::threadJumps(BlockID id) {
+  if (id == Function::ENTRY) return false;
+  const auto& block = function.block(id);
+  for (const auto phi : block.phis) {
+    if (function[phi].op != Opcode::Nop) return false;
+  }
+  for (const auto inst : block.insts) {
+    const auto op = function[inst].op;
+    if (op != Opcode::Nop && op != Opcode::Jump) return false;
+  }
+  const auto target = block.successorArray[0];
+  if (function[function.terminator(id)].op != Opcode::Jump || target == id) {
+    return false;
+  }
+
+  // The phi operands for the edge from the block are the same for the edges
+  // from its predecessors.
+  const auto& phis = function.block(target).phis;
+  std::vector<ValueID> values;
+  const auto index = predecessorIndex(target, id);
+  for (const auto phi : phis) {
+    values.push_back(function[phi].op == Opcode::Phi
+                         ? function.operands(phi)[index]
+                         : 0);
+  }
+
+  const auto predecessors = block.predecessors;
+  bool threaded = false;
+  for (const auto predecessor : predecessors) {
+    // A predecessor of both can't get two different operands for one edge.
+    const auto& targetPredecessors = function.block(target).predecessors;
+    const auto existing = std::find(targetPredecessors.begin(),
+                                    targetPredecessors.end(), predecessor);
+    if (existing != targetPredecessors.end()) {
+      const auto other =
+          static_cast<std::size_t>(existing - targetPredecessors.begin());
+      if (!hasSameOperands(target, index, other)) continue;
+    }
+
+    const auto successors = function.block(predecessor).successors();
+    const auto edges = std::count(successors.begin(), successors.end(), id);
+    for (std::ptrdiff_t i = 0; i < edges; i++) {
+      function.redirectEdge(predecessor, id, target);
+      for (std::size_t j = 0; j < phis.size(); j++) {
+        if (values[j] != 0) function.addPhiOperand(phis[j], values[j]);
+      }
+    }
+    push(predecessor);
+    threaded = true;
+  }
+  if (!threaded) return false;
+
+  changed = true;
+  push(target);
+  removeIfUnreachable(id);
+  return true;
+}
+
+// Append the successor of a block to it if the block is its only
+// predecessor.
+bool ControlFlowSimplification::mergeSuccessor(BlockID id) {
+  const auto terminator = function.terminator(id);
+  if (function[terminator].op != Opcode::Jump) return false;
+  auto& block = function.block(id);
+  const auto successorID = block.successorArray[0];
+  auto& successor = function.block(successorID);
+  if (successorID == id || successorID == Function::ENTRY ||
+      successor.predecessors.size() != 1) {
+    return false;
+  }
+
+  for (const auto phi : successor.phis) {
+    if (function[phi].op != Opcode::Phi) continue;
+    replace(phi, function.operands(phi)[0]);
+  }
+  function.remove(terminator);
+  for (const auto inst : successor.insts) {
+    if (function[inst].op == Opcode::Nop) continue;
+    function[inst].block = id;
+    block.insts.push_back(inst);
+  }
+
+  block.successorArray = successor.successorArray;
+  block.numberOfSuccessors = successor.numberOfSuccessors;
+  for (const auto next : successor.successors()) {
+    auto& predecessors = function.block(next).predecessors;
+    std::replace(predecessors.begin(), predecessors.end(), successorID, id);
+  }
+  successor.phis.clear();
+  successor.insts.clear();
+  successor.predecessors.clear();
+  successor.numberOfSuccessors = 0;
+  successor.isRemoved = true;
+
+  changed = true;
+  push(id);
+  return true;
+}
+
+void ControlFlowSimplification::removeTrivialPhis() {
+  const UseLists uses(function);
+  std::vector<ValueID> phis;
+  for (const auto id : function.liveBlocks()) {
+    for (const auto phi : function.block(id).phis) phis.push_back(phi);
+  }
+
+  while (!phis.empty()) {
+    const auto phi = phis.back();
+    phis.pop_back();
+    if (function[phi].op != Opcode::Phi) continue;
+
+    ValueID same = 0;
+    bool isTrivial = true;
+    for (const auto operand : function.operands(phi)) {
+      const auto value = resolve(operand);
+      if (value == same || value == phi) continue;
+      if (same != 0) {
+        isTrivial = false;
+        break;
+      }
+      same = value;
+    }
+    if (!isTrivial) continue;
+
+    // Only reachable from itself.
+    if (same == 0) same = function.constant(function[phi].type, 0);
+    replace(phi, same);
+    // Phis using this one may have become trivial.
+    for (const auto& use : uses.of(phi)) {
+      if (function[use.user].op == Opcode::Phi) phis.push_back(use.user);
+    }
+  }
+}
+
+void ControlFlowSimplification::forwardUses() {
+  for (const auto id : function.liveBlocks()) {
+    const auto& block = function.block(id);
+    for (const auto* list : {&block.phis, &block.insts}) {
+      for (const auto inst : *list) {
+        if (function[inst].op == Opcode::Nop) continue;
+        for (auto& operand : function.operands(inst)) {
+          operand = resolve(operand);
+        }
+      }
+    }
+  }
+}
+
+// Whether the phis of a block have the same operands for two of its
+// predecessors, given by their index.
+bool ControlFlowSimplification::hasSameOperands(BlockID target, std::size_t a,
+                                                std::size_t b) {
+  for (const auto phi : function.block(target).phis) {
+    if (function[phi].op != Opcode::Phi) continue;
+    const auto operands = function.operands(phi);
+    if (resolve(operands[a]) != resolve(operands[b])) return false;
+  }
+  return true;
+}
+
+std::size_t ControlFlowSimplification::predecessorIndex(
+    BlockID block, BlockID predecessor) const {
+  const auto& predecessors = function.block(block).predecessors;
+  return static_cast<std::size_t>(
+      std::find(predecessors.begin(), predecessors.end(), predecessor) -
+      predecessors.begin());
+}
+
+void ControlFlowSimplification::replace(ValueID id, ValueID value) {
+  if (replacements.size() < function.size()) {
+    replacements.resize(function.size());
+  }
+  replacements[id] = resolve(value);
+  function.remove(id);
+  changed = true;
+}
+
+ValueID ControlFlowSimplification::resolve(ValueID value) {
+  auto root = value;
+  while (root < replacements.size() && replacements[root] != 0) {
+    root = replacements[root];
+  }
+  while (value != root) {
+    const auto next = replacements[value];
+    replacements[value] = root;
+    value = next;
+  }
+  return root;
+}
+}  // namespace
+
+bool simplifyControlFlow(Function& function) {
+  return ControlFlowSimplification(function).run();
+}
@@ -0,0 +1,23 @@
+#ifndef TPLCC_CFG_SIMPLIFICATION_H
+#define TPLCC_CFG_SIMPLIFICATION_H
+
+#include "ir.h"
+
+// Clean up the control flow lowering leaves behind for if, for, switch, &&
+// and ||, and that constant propagation leaves after folding branches:
+//
+// - Blocks that can't be reached from the entry are removed.
+// - A branch on a constant, or with both targets the same, becomes a jump.
+// - A predecessor of a block that only jumps on jumps directly to its
+//   target, unless that would need two different phi operands for the same
+//   edge. The block is removed once nothing jumps to it.
+// - A block that jumps to a block with no other predecessor absorbs it.
+// - A phi whose operands are all the same value, or the phi itself, is
+//   replaced by that value.
+//
+// Each is done with a worklist of the blocks (phis) that changed, so the
+// pass takes time linear in the size of the function. Returns whether the
+// function changed.
+bool simplifyControlFlow(Function& function);
+
+#endif
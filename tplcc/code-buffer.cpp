@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <utility>
+
 #include "code-buffer.h"
 
 CodeBuffer::Offset CodeBuffer::section(SectionID id) const {
@@ -16,13 +19,35 @@ CodeBuffer::Offset CodeBuffer::sectionCount() const {
 }
 
 CodeBuffer::SectionID CodeBuffer::addSection(std::string content) {
+  return addSection(std::move(content), SectionOrigin());
+}
+
+CodeBuffer::SectionID CodeBuffer::addSection(std::string content,
+                                             SectionOrigin origin) {
   const size_t sectionStart = buf.size();
   const size_t sectionID = sectionOffsets.size();
   buf += std::move(content);
   sectionOffsets.push_back(sectionStart);
+  sectionOrigins.push_back(std::move(origin));
   return sectionOffsets.size() - 1;
 }
 
+const CodeBuffer::SectionOrigin& CodeBuffer::sectionOrigin(
+    SectionID id) const {
+  return sectionOrigins[id];
+}
+
+bool CodeBuffer::isFileSection(SectionID id) const {
+  return id == 0 || !sectionOrigins[id].includedFile.empty();
+}
+
+// Only used when rendering diagnostics, so a binary search is fast enough.
+CodeBuffer::SectionID CodeBuffer::sectionOf(CodeBuffer::Offset offset) const {
+  const auto it =
+      std::upper_bound(sectionOffsets.begin(), sectionOffsets.end(), offset);
+  return it == sectionOffsets.begin() ? 0 : (it - sectionOffsets.begin()) - 1;
+}
+
 std::uint8_t CodeBuffer::operator[](CodeBuffer::Offset index) const {
   return buf[index];
 }
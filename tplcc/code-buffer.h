@@ -11,20 +11,41 @@ class CodeBuffer {
   typedef std::uint32_t SectionID;
   typedef std::uint32_t Offset;
 
+  // Where the content of a section comes from. A section created for a macro
+  // expansion records the invocation it replaces (which may itself lie in
+  // another expansion) and the #define directive it expands. A section
+  // holding a file included by #include records the directive as the
+  // invocation and the path of the file. Both ranges are empty for the
+  // source file itself.
+  struct SectionOrigin {
+    Offset invocationStart = 0;
+    Offset invocationEnd = 0;
+    Offset definitionStart = 0;
+    Offset definitionEnd = 0;
+    std::string includedFile{};
+  };
+
  private:
   std::string buf;
   std::vector<Offset> sectionOffsets;
+  std::vector<SectionOrigin> sectionOrigins;
 
  public:
   CodeBuffer() = default;
   CodeBuffer(std::string sourceCode)
-      : buf(std::move(sourceCode)), sectionOffsets{0} {}
+      : buf(std::move(sourceCode)), sectionOffsets{0}, sectionOrigins(1) {}
   CodeBuffer::Offset section(SectionID id) const;
   CodeBuffer::Offset sectionEnd(SectionID id) const;
   CodeBuffer::Offset sectionSize(SectionID id) const;
   CodeBuffer::Offset sectionCount() const;
   const unsigned char* pos(CodeBuffer::Offset) const;
   SectionID addSection(std::string content);
+  SectionID addSection(std::string content, SectionOrigin origin);
+  const SectionOrigin& sectionOrigin(SectionID id) const;
+  SectionID sectionOf(CodeBuffer::Offset offset) const;
+  // Whether the section holds a file, the source file or an included one,
+  // rather than a macro expansion.
+  bool isFileSection(SectionID id) const;
   std::uint8_t operator[](CodeBuffer::Offset index) const;
 };
 
@@ -0,0 +1,787 @@
+#include "code-generation.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "register-allocation.h"
+
+namespace {
+using X86::Condition;
+using X86::Instruction;
+using X86::Mnemonic;
+using X86::Operand;
+
+bool fitsInInt32(std::int64_t value) {
+  return value == static_cast<std::int32_t>(value);
+}
+
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t align) {
+  return (value + align - 1) / align * align;
+}
+
+// Integers narrower than 32 bits are computed in 32-bit registers, the bits
+// above their type are undefined.
+std::uint8_t operationSize(IRType type) { return sizeOf(type) == 8 ? 8 : 4; }
+
+Condition conditionOf(Opcode op) {
+  switch (op) {
+    case Opcode::Eq: return Condition::Equal;
+    case Opcode::Ne: return Condition::NotEqual;
+    case Opcode::SLt: return Condition::Less;
+    case Opcode::SLe: return Condition::LessOrEqual;
+    case Opcode::SGt: return Condition::Greater;
+    case Opcode::SGe: return Condition::GreaterOrEqual;
+    case Opcode::ULt: return Condition::Below;
+    case Opcode::ULe: return Condition::BelowOrEqual;
+    case Opcode::UGt: return Condition::Above;
+    default: return Condition::AboveOrEqual;
+  }
+}
+
+// The condition that holds for b and a when the one given holds for a and
+// b.
+Condition swapOperands(Condition condition) {
+  switch (condition) {
+    case Condition::Less: return Condition::Greater;
+    case Condition::LessOrEqual: return Condition::GreaterOrEqual;
+    case Condition::Greater: return Condition::Less;
+    case Condition::GreaterOrEqual: return Condition::LessOrEqual;
+    case Condition::Below: return Condition::Above;
+    case Condition::BelowOrEqual: return Condition::AboveOrEqual;
+    case Condition::Above: return Condition::Below;
+    case Condition::AboveOrEqual: return Condition::BelowOrEqual;
+    default: return condition;
+  }
+}
+
+bool isSignedComparison(Opcode op) {
+  return op == Opcode::SLt || op == Opcode::SLe || op == Opcode::SGt ||
+         op == Opcode::SGe;
+}
+
+Operand reg(X86::Register reg) { return Operand::registerOperand(reg); }
+
+class CodeGenerator {
+  Function& function;
+  const Module& module;
+  const RegisterAllocation allocation;
+  // Built after the allocation split the critical edges.
+  const UseLists uses;
+  MachineFunction result;
+
+  std::vector<std::uint32_t> labels;
+  // The offsets of allocas from RBP.
+  std::vector<std::int32_t> allocaOffsets;
+  std::uint32_t savedBytes = 0;
+  std::uint32_t frameBytes = 0;
+  BlockID currentBlock = 0;
+  BlockID nextBlock = 0;
+  // A comparison whose only use is the branch after it, which jumps on the
+  // flags it set.
+  ValueID fusedComparison = 0;
+  Condition fusedCondition = Condition::Equal;
+
+ public:
+  CodeGenerator(Function& function, const Module& module)
+      : function(function),
+        module(module),
+        allocation(function),
+        uses(function),
+        labels(function.numberOfBlocks()),
+        allocaOffsets(function.size()) {
+    result.symbol = function.symbol;
+  }
+
+  MachineFunction run();
+
+ private:
+  void layOutFrame();
+  void prologue();
+  void epilogue();
+  void block(BlockID id);
+  void instruction(ValueID id);
+
+  void binary(ValueID id, Mnemonic mnemonic, bool isCommutative);
+  void shift(ValueID id, Mnemonic mnemonic);
+  void division(ValueID id);
+  void comparison(ValueID id);
+  void extension(ValueID id);
+  void load(ValueID id);
+  void store(ValueID id);
+  void call(ValueID id);
+  void branch(ValueID id);
+
+  Operand operand(ValueID value, std::uint32_t position) const;
+  Operand address(ValueID pointer, std::uint32_t position);
+  Operand slot(std::uint32_t slot) const;
+  Operand locationOperand(const Location& location) const;
+  X86::Register destination(ValueID id) const;
+  void writeResult(ValueID id, X86::Register source);
+  void loadInto(ValueID value, std::uint32_t position, X86::Register target);
+  void materialize(ValueID value, X86::Register target);
+  void extend(X86::Register target, std::uint32_t size, bool isSigned);
+  void parallelMove(std::vector<Move> moves);
+  void parallelMove(std::span<const Move> moves) {
+    parallelMove(std::vector<Move>(moves.begin(), moves.end()));
+  }
+  void move(const Move& move);
+  bool isExternal(std::uint32_t symbol) const {
+    return !module[symbol].isDefined;
+  }
+
+  void emit(Mnemonic mnemonic, std::uint8_t size, Operand destination = {},
+            Operand source = {}) {
+    result.code.push_back(
+        {mnemonic, size, 0, Condition::Overflow, destination, source});
+  }
+  void emitWithCondition(Mnemonic mnemonic, Condition condition,
+                         Operand destination) {
+    result.code.push_back({mnemonic, 1, 0, condition, destination, {}});
+  }
+  void emitExtension(Mnemonic mnemonic, std::uint8_t size,
+                     std::uint8_t sourceSize, X86::Register destination,
+                     Operand source) {
+    result.code.push_back({mnemonic, size, sourceSize, Condition::Overflow,
+                           reg(destination), source});
+  }
+};
+
+MachineFunction CodeGenerator::run() {
+  const auto order = allocation.blockOrder();
+  for (std::uint32_t i = 0; i < order.size(); i++) labels[order[i]] = i;
+  result.numberOfLabels = static_cast<std::uint32_t>(order.size());
+
+  layOutFrame();
+  prologue();
+  for (std::size_t i = 0; i < order.size(); i++) {
+    currentBlock = order[i];
+    nextBlock = i + 1 < order.size() ? order[i + 1] : 0;
+    block(currentBlock);
+  }
+  return std::move(result);
+}
+
+void CodeGenerator::layOutFrame() {
+  savedBytes =
+      8 * static_cast<std::uint32_t>(allocation.calleeSavedRegisters().size());
+  std::uint64_t offset = savedBytes + 8 * allocation.numberOfSpillSlots();
+  for (const auto id : allocation.blockOrder()) {
+    for (const auto inst : function.block(id).insts) {
+      const auto& value = function[inst];
+      if (value.op != Opcode::Alloca) continue;
+      // RBP is aligned to 16 bytes, more can't be had without realigning
+      // the stack.
+      const auto align = std::clamp<std::uint64_t>(value.flags, 1, 16);
+      offset = alignUp(offset + value.imm, align);
+      allocaOffsets[inst] = -static_cast<std::int32_t>(offset);
+    }
+  }
+  frameBytes = static_cast<std::uint32_t>(alignUp(offset, 16)) - savedBytes;
+}
+
+void CodeGenerator::prologue() {
+  emit(Mnemonic::Push, 8, reg(X86::RBP));
+  emit(Mnemonic::Mov, 8, reg(X86::RBP), reg(X86::RSP));
+  for (const auto saved : allocation.calleeSavedRegisters()) {
+    emit(Mnemonic::Push, 8, reg(saved));
+  }
+  if (frameBytes != 0) {
+    emit(Mnemonic::Sub, 8, reg(X86::RSP), Operand::immediate(frameBytes));
+  }
+
+  // The parameters in registers are moved to their locations at once, then
+  // the ones on the stack are loaded.
+  const auto params = function.parameters();
+  std::vector<Move> moves;
+  for (std::size_t i = 0;
+       i < params.size() && i < X86::ARGUMENT_REGISTERS.size(); i++) {
+    const auto to = allocation.locationAt(params[i], 0);
+    if (to.kind == Location::Kind::None) continue;
+    moves.push_back(
+        {params[i], Location::inRegister(X86::ARGUMENT_REGISTERS[i]), to});
+  }
+  parallelMove(std::move(moves));
+  for (std::size_t i = X86::ARGUMENT_REGISTERS.size(); i < params.size();
+       i++) {
+    const auto to = allocation.locationAt(params[i], 0);
+    const auto from = Operand::memory(
+        X86::RBP, 16 + 8 * static_cast<std::int64_t>(
+                               i - X86::ARGUMENT_REGISTERS.size()));
+    if (to.kind == Location::Kind::Register) {
+      emit(Mnemonic::Mov, 8, reg(to.reg), from);
+    } else if (to.kind == Location::Kind::Stack) {
+      emit(Mnemonic::Mov, 8, reg(X86::TEMPORARY), from);
+      emit(Mnemonic::Mov, 8, slot(to.slot), reg(X86::TEMPORARY));
+    }
+  }
+}
+
+void CodeGenerator::epilogue() {
+  const auto saved = allocation.calleeSavedRegisters();
+  if (saved.empty()) {
+    emit(Mnemonic::Leave, 8);
+  } else {
+    emit(Mnemonic::Lea, 8, reg(X86::RSP),
+         Operand::memory(X86::RBP, -static_cast<std::int64_t>(savedBytes)));
+    for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+      emit(Mnemonic::Pop, 8, reg(*it));
+    }
+    emit(Mnemonic::Pop, 8, reg(X86::RBP));
+  }
+  emit(Mnemonic::Ret, 8);
+}
+
+void CodeGenerator::block(BlockID id) {
+  const auto& block = function.block(id);
+  emit(Mnemonic::Label, 8, Operand::label(labels[id]));
+  parallelMove(allocation.entryMoves(id));
+  parallelMove(allocation.movesAt(allocation.blockStart(id) + 1));
+
+  for (std::size_t i = 0; i < block.insts.size(); i++) {
+    const auto inst = block.insts[i];
+    const auto& value = function[inst];
+    if (value.op == Opcode::Nop) continue;
+    const auto position = allocation.position(inst);
+    if (isTerminator(value.op)) {
+      parallelMove(allocation.exitMoves(id));
+      instruction(inst);
+      continue;
+    }
+
+    if (isComparison(value.op) && i + 1 < block.insts.size()) {
+      const auto next = block.insts[i + 1];
+      if (function[next].op == Opcode::Branch &&
+          function.operands(next)[0] == inst && uses.of(inst).size() == 1) {
+        fusedComparison = inst;
+      }
+    }
+    instruction(inst);
+
+    // The moves after it only copy, they leave the flags of a fused
+    // comparison alone.
+    const auto after = allocation.movesAt(position + 1);
+    std::vector<Move> moves(after.begin(), after.end());
+    X86::Register late;
+    if (lateResultRegister(value, &late)) {
+      const auto to = allocation.resultLocation(function, inst);
+      if (to.kind != Location::Kind::None) {
+        moves.push_back({inst, Location::inRegister(late), to});
+      }
+    }
+    parallelMove(std::move(moves));
+  }
+}
+
+void CodeGenerator::instruction(ValueID id) {
+  const auto& value = function[id];
+  const auto position = allocation.position(id);
+  switch (value.op) {
+    case Opcode::Add:
+      return binary(id, Mnemonic::Add, true);
+    case Opcode::Sub:
+      return binary(id, Mnemonic::Sub, false);
+    case Opcode::Mul:
+      return binary(id, Mnemonic::IMul, true);
+    case Opcode::And:
+      return binary(id, Mnemonic::And, true);
+    case Opcode::Or:
+      return binary(id, Mnemonic::Or, true);
+    case Opcode::Xor:
+      return binary(id, Mnemonic::Xor, true);
+    case Opcode::Shl:
+      return shift(id, Mnemonic::Shl);
+    case Opcode::LShr:
+      return shift(id, Mnemonic::Shr);
+    case Opcode::AShr:
+      return shift(id, Mnemonic::Sar);
+    case Opcode::SDiv:
+    case Opcode::UDiv:
+    case Opcode::SRem:
+    case Opcode::URem:
+      return division(id);
+    case Opcode::Eq:
+    case Opcode::Ne:
+    case Opcode::SLt:
+    case Opcode::SLe:
+    case Opcode::SGt:
+    case Opcode::SGe:
+    case Opcode::ULt:
+    case Opcode::ULe:
+    case Opcode::UGt:
+    case Opcode::UGe:
+      return comparison(id);
+    case Opcode::Neg:
+    case Opcode::Not: {
+      const auto result = destination(id);
+      loadInto(function.operands(id)[0], position, result);
+      emit(value.op == Opcode::Neg ? Mnemonic::Neg : Mnemonic::Not,
+           operationSize(value.type), reg(result));
+      return writeResult(id, result);
+    }
+    case Opcode::SExt:
+    case Opcode::ZExt:
+    case Opcode::Trunc:
+    case Opcode::Copy:
+      return extension(id);
+    case Opcode::Load:
+      return load(id);
+    case Opcode::Store:
+      return store(id);
+    case Opcode::Call:
+      return call(id);
+    case Opcode::Jump: {
+      const auto target = function.block(currentBlock).successorArray[0];
+      if (target != nextBlock) {
+        emit(Mnemonic::Jmp, 8, Operand::label(labels[target]));
+      }
+      return;
+    }
+    case Opcode::Branch:
+      return branch(id);
+    case Opcode::Ret:
+      if (value.numberOfOperands != 0) {
+        loadInto(function.operands(id)[0], position, X86::RAX);
+      }
+      return epilogue();
+    case Opcode::Unreachable:
+      return emit(Mnemonic::Ud2, 8);
+    default:
+      // Allocas are addressed where they are used, phis are moves on the
+      // edges.
+      return;
+  }
+}
+
+void CodeGenerator::binary(ValueID id, Mnemonic mnemonic,
+                           bool isCommutative) {
+  const auto position = allocation.position(id);
+  const auto size = operationSize(function[id].type);
+  const auto result = destination(id);
+  auto a = function.operands(id)[0];
+  auto b = function.operands(id)[1];
+
+  // Prefer an immediate, or the operand already in the register of the
+  // result, as the one applied to the other.
+  auto source = operand(b, position);
+  if (isCommutative) {
+    const auto first = operand(a, position);
+    if ((source.isRegister(result) && a != b) ||
+        (first.kind == Operand::Kind::Immediate &&
+         source.kind != Operand::Kind::Immediate)) {
+      std::swap(a, b);
+      source = first;
+    }
+  }
+  if ((source.isRegister(result) && a != b) ||
+      source.kind == Operand::Kind::None) {
+    loadInto(b, position, X86::TEMPORARY);
+    source = reg(X86::TEMPORARY);
+  }
+  loadInto(a, position, result);
+  emit(mnemonic, size, reg(result), source);
+  writeResult(id, result);
+}
+
+void CodeGenerator::shift(ValueID id, Mnemonic mnemonic) {
+  const auto position = allocation.position(id);
+  const auto& value = function[id];
+  const auto size = operationSize(value.type);
+  const auto result = destination(id);
+  const auto a = function.operands(id)[0];
+  const auto b = function.operands(id)[1];
+
+  Operand count;
+  if (function[b].op == Opcode::Const) {
+    loadInto(a, position, result);
+    count = Operand::immediate(function[b].signedImm() & (size * 8 - 1));
+  } else {
+    // The count has to be in CL, the register allocation left RCX free.
+    parallelMove({{a, allocation.locationAt(a, position),
+                   Location::inRegister(result)},
+                  {b, allocation.locationAt(b, position),
+                   Location::inRegister(X86::RCX)}});
+    count = reg(X86::RCX);
+  }
+  if (mnemonic != Mnemonic::Shl && sizeOf(value.type) < 4) {
+    extend(result, sizeOf(value.type), mnemonic == Mnemonic::Sar);
+  }
+  emit(mnemonic, size, reg(result), count);
+  writeResult(id, result);
+}
+
+// The dividend goes to RAX, extended into RDX, the divisor anywhere but
+// there. The result is in RAX or RDX, see lateResultRegister.
+void CodeGenerator::division(ValueID id) {
+  const auto position = allocation.position(id);
+  const auto& value = function[id];
+  const bool isSigned = value.op == Opcode::SDiv || value.op == Opcode::SRem;
+  const auto size = operationSize(value.type);
+  const auto a = function.operands(id)[0];
+  const auto b = function.operands(id)[1];
+
+  auto divisor = operand(b, position);
+  if (divisor.kind != Operand::Kind::Register ||
+      divisor.isRegister(X86::RAX) || divisor.isRegister(X86::RDX) ||
+      sizeOf(value.type) < 4) {
+    loadInto(b, position, X86::TEMPORARY);
+    divisor = reg(X86::TEMPORARY);
+    if (sizeOf(value.type) < 4) {
+      extend(X86::TEMPORARY, sizeOf(value.type), isSigned);
+    }
+  }
+  loadInto(a, position, X86::RAX);
+  if (sizeOf(value.type) < 4) extend(X86::RAX, sizeOf(value.type), isSigned);
+  if (isSigned) {
+    emit(Mnemonic::SignExtendAccumulator, size);
+  } else {
+    emit(Mnemonic::Xor, 4, reg(X86::RDX), reg(X86::RDX));
+  }
+  emit(isSigned ? Mnemonic::IDiv : Mnemonic::Div, size, divisor);
+}
+
+void CodeGenerator::comparison(ValueID id) {
+  const auto position = allocation.position(id);
+  const auto op = function[id].op;
+  auto a = function.operands(id)[0];
+  auto b = function.operands(id)[1];
+  const auto type = function[a].type;
+  const auto size = operationSize(type);
+  auto condition = conditionOf(op);
+
+  auto first = operand(a, position);
+  auto second = operand(b, position);
+  if (first.kind != Operand::Kind::Register &&
+      second.kind == Operand::Kind::Register) {
+    std::swap(a, b);
+    std::swap(first, second);
+    condition = swapOperands(condition);
+  }
+
+  if (sizeOf(type) < 4) {
+    // Compared in 32 bits, extended the way the comparison reads them.
+    const bool isSigned = isSignedComparison(op);
+    loadInto(a, position, X86::SCRATCH);
+    extend(X86::SCRATCH, sizeOf(type), isSigned);
+    first = reg(X86::SCRATCH);
+    if (function[b].op == Opcode::Const) {
+      const auto bits = function[b].imm;
+      const auto mask = (std::uint64_t{1} << (8 * sizeOf(type))) - 1;
+      second = Operand::immediate(
+          isSigned ? function[b].signedImm()
+                   : static_cast<std::int64_t>(bits & mask));
+    } else {
+      loadInto(b, position, X86::TEMPORARY);
+      extend(X86::TEMPORARY, sizeOf(type), isSigned);
+      second = reg(X86::TEMPORARY);
+    }
+  } else {
+    if (first.kind != Operand::Kind::Register) {
+      loadInto(a, position, X86::SCRATCH);
+      first = reg(X86::SCRATCH);
+    }
+    if (second.kind == Operand::Kind::None) {
+      loadInto(b, position, X86::TEMPORARY);
+      second = reg(X86::TEMPORARY);
+    }
+  }
+  emit(Mnemonic::Cmp, size, first, second);
+
+  if (fusedComparison == id) {
+    fusedCondition = condition;
+    return;
+  }
+  const auto result = destination(id);
+  emitWithCondition(Mnemonic::SetCC, condition, reg(result));
+  emitExtension(Mnemonic::MovZX, 4, 1, result, reg(result));
+  writeResult(id, result);
+}
+
+void CodeGenerator::extension(ValueID id) {
+  const auto position = allocation.position(id);
+  const auto& value = function[id];
+  const auto operandID = function.operands(id)[0];
+  const auto from = sizeOf(function[operandID].type);
+  const auto result = destination(id);
+
+  auto source = operand(operandID, position);
+  if (source.kind != Operand::Kind::Register) {
+    loadInto(operandID, position, result);
+    source = reg(result);
+  }
+  if (value.op == Opcode::SExt) {
+    emitExtension(Mnemonic::MovSX, operationSize(value.type),
+                  static_cast<std::uint8_t>(from), result, source);
+  } else if (value.op == Opcode::ZExt && from < 4) {
+    emitExtension(Mnemonic::MovZX, 4, static_cast<std::uint8_t>(from), result,
+                  source);
+  } else if (value.op == Opcode::ZExt) {
+    // Writing the 32-bit register clears the upper half.
+    emit(Mnemonic::Mov, 4, reg(result), source);
+  } else if (!source.isRegister(result)) {
+    emit(Mnemonic::Mov, operationSize(value.type), reg(result), source);
+  }
+  writeResult(id, result);
+}
+
+void CodeGenerator::load(ValueID id) {
+  const auto position = allocation.position(id);
+  const auto type = function[id].type;
+  const auto from = address(function.operands(id)[0], position);
+  const auto result = destination(id);
+  if (sizeOf(type) < 4) {
+    emitExtension(Mnemonic::MovZX, 4, static_cast<std::uint8_t>(sizeOf(type)),
+                  result, from);
+  } else {
+    emit(Mnemonic::Mov, static_cast<std::uint8_t>(sizeOf(type)), reg(result),
+         from);
+  }
+  writeResult(id, result);
+}
+
+void CodeGenerator::store(ValueID id) {
+  const auto position = allocation.position(id);
+  const auto value = function.operands(id)[0];
+  const auto size = static_cast<std::uint8_t>(sizeOf(function[value].type));
+  const auto to = address(function.operands(id)[1], position);
+  auto source = operand(value, position);
+  if (source.kind == Operand::Kind::None) {
+    loadInto(value, position, X86::SCRATCH);
+    source = reg(X86::SCRATCH);
+  }
+  emit(Mnemonic::Mov, size, to, source);
+}
+
+// System V: the first six arguments in registers, the rest pushed from the
+// last to the first with RSP aligned to 16 bytes at the call, AL the number
+// of vector registers used by a variadic call.
+void CodeGenerator::call(ValueID id) {
+  const auto position = allocation.position(id);
+  const auto operands = function.operands(id);
+  const auto callee = operands[0];
+  const auto arguments = operands.subspan(1);
+  const auto inRegisters =
+      std::min(arguments.size(), X86::ARGUMENT_REGISTERS.size());
+  const auto onStack = arguments.size() - inRegisters;
+
+  std::int64_t stackBytes = 0;
+  if (onStack % 2 != 0) {
+    emit(Mnemonic::Sub, 8, reg(X86::RSP), Operand::immediate(8));
+    stackBytes += 8;
+  }
+  for (auto i = arguments.size(); i-- > inRegisters;) {
+    auto source = operand(arguments[i], position);
+    if (source.kind == Operand::Kind::None) {
+      loadInto(arguments[i], position, X86::SCRATCH);
+      source = reg(X86::SCRATCH);
+    }
+    emit(Mnemonic::Push, 8, source);
+    stackBytes += 8;
+  }
+
+  Operand target;
+  if (function[callee].op == Opcode::Symbol) {
+    const auto symbol = static_cast<std::uint32_t>(function[callee].imm);
+    target = Operand::symbolOperand(symbol, isExternal(symbol));
+  } else {
+    loadInto(callee, position, X86::TEMPORARY);
+    target = reg(X86::TEMPORARY);
+  }
+
+  std::vector<Move> moves;
+  for (std::size_t i = 0; i < inRegisters; i++) {
+    moves.push_back({arguments[i], allocation.locationAt(arguments[i], position),
+                     Location::inRegister(X86::ARGUMENT_REGISTERS[i])});
+  }
+  parallelMove(std::move(moves));
+  if (function[id].flags & InstFlag::Variadic) {
+    emit(Mnemonic::Mov, 4, reg(X86::RAX), Operand::immediate(0));
+  }
+  emit(Mnemonic::Call, 8, target);
+  if (stackBytes != 0) {
+    emit(Mnemonic::Add, 8, reg(X86::RSP), Operand::immediate(stackBytes));
+  }
+}
+
+void CodeGenerator::branch(ValueID id) {
+  const auto position = allocation.position(id);
+  const auto& block = function.block(currentBlock);
+  const auto ifTrue = block.successorArray[0];
+  const auto ifFalse = block.successorArray[1];
+  const auto conditionID = function.operands(id)[0];
+
+  auto condition = Condition::NotEqual;
+  if (fusedComparison == conditionID) {
+    condition = fusedCondition;
+    fusedComparison = 0;
+  } else {
+    const auto source = operand(conditionID, position);
+    if (source.kind != Operand::Kind::Register) {
+      // A constant, or an address, which isn't null.
+      const bool isTrue = function[conditionID].op != Opcode::Const ||
+                          function[conditionID].imm != 0;
+      const auto target = isTrue ? ifTrue : ifFalse;
+      if (target != nextBlock) {
+        emit(Mnemonic::Jmp, 8, Operand::label(labels[target]));
+      }
+      return;
+    }
+    // Only the bits of its type are defined.
+    emit(Mnemonic::Test,
+         static_cast<std::uint8_t>(sizeOf(function[conditionID].type)),
+         source, source);
+  }
+
+  if (ifTrue == nextBlock) {
+    emitWithCondition(Mnemonic::Jcc, X86::negate(condition),
+                      Operand::label(labels[ifFalse]));
+    return;
+  }
+  emitWithCondition(Mnemonic::Jcc, condition, Operand::label(labels[ifTrue]));
+  if (ifFalse != nextBlock) {
+    emit(Mnemonic::Jmp, 8, Operand::label(labels[ifFalse]));
+  }
+}
+
+// A value as an operand: where the allocation put it, or an immediate.
+// Anything else has no operand and has to be computed into a register.
+Operand CodeGenerator::operand(ValueID value, std::uint32_t position) const {
+  const auto& inst = function[value];
+  switch (inst.op) {
+    case Opcode::Const:
+      return fitsInInt32(inst.signedImm()) ? Operand::immediate(inst.signedImm())
+                                           : Operand();
+    case Opcode::Symbol:
+    case Opcode::Alloca:
+      return {};
+    default:
+      return locationOperand(allocation.locationAt(value, position));
+  }
+}
+
+// The memory a pointer points to.
+Operand CodeGenerator::address(ValueID pointer, std::uint32_t position) {
+  const auto& inst = function[pointer];
+  if (inst.op == Opcode::Alloca) {
+    return Operand::memory(X86::RBP, allocaOffsets[pointer]);
+  }
+  if (inst.op == Opcode::Symbol &&
+      !isExternal(static_cast<std::uint32_t>(inst.imm))) {
+    return Operand::ripRelative(static_cast<std::uint32_t>(inst.imm), false);
+  }
+  const auto source = operand(pointer, position);
+  if (source.kind == Operand::Kind::Register) {
+    return Operand::memory(source.reg, 0);
+  }
+  loadInto(pointer, position, X86::TEMPORARY);
+  return Operand::memory(X86::TEMPORARY, 0);
+}
+
+Operand CodeGenerator::slot(std::uint32_t slot) const {
+  return Operand::memory(X86::RBP,
+                         -static_cast<std::int64_t>(savedBytes + 8 * slot + 8));
+}
+
+Operand CodeGenerator::locationOperand(const Location& location) const {
+  switch (location.kind) {
+    case Location::Kind::Register:
+      return reg(location.reg);
+    case Location::Kind::Stack:
+      return slot(location.slot);
+    default:
+      return {};
+  }
+}
+
+// The register to compute a result in, SCRATCH if it goes to a spill slot.
+X86::Register CodeGenerator::destination(ValueID id) const {
+  const auto location = allocation.resultLocation(function, id);
+  return location.kind == Location::Kind::Register ? location.reg
+                                                   : X86::SCRATCH;
+}
+
+void CodeGenerator::writeResult(ValueID id, X86::Register source) {
+  const auto location = allocation.resultLocation(function, id);
+  if (location.kind == Location::Kind::Stack) {
+    emit(Mnemonic::Mov, 8, slot(location.slot), reg(source));
+  }
+}
+
+void CodeGenerator::loadInto(ValueID value, std::uint32_t position,
+                             X86::Register target) {
+  const auto source = operand(value, position);
+  if (source.isRegister(target)) return;
+  if (source.kind == Operand::Kind::Register ||
+      source.kind == Operand::Kind::Memory) {
+    emit(Mnemonic::Mov, 8, reg(target), source);
+  } else {
+    materialize(value, target);
+  }
+}
+
+// Put the value of a constant, the address of a symbol or an alloca into a
+// register, with instructions that don't change the flags.
+void CodeGenerator::materialize(ValueID value, X86::Register target) {
+  const auto& inst = function[value];
+  switch (inst.op) {
+    case Opcode::Const:
+      // A MOV to the 32-bit register is shorter and clears the upper half.
+      emit(Mnemonic::Mov, inst.imm <= 0xffffffff ? 4 : 8, reg(target),
+           Operand::immediate(inst.signedImm()));
+      return;
+    case Opcode::Symbol: {
+      const auto symbol = static_cast<std::uint32_t>(inst.imm);
+      emit(isExternal(symbol) ? Mnemonic::Mov : Mnemonic::Lea, 8, reg(target),
+           Operand::ripRelative(symbol, isExternal(symbol)));
+      return;
+    }
+    case Opcode::Alloca:
+      emit(Mnemonic::Lea, 8, reg(target),
+           Operand::memory(X86::RBP, allocaOffsets[value]));
+      return;
+    default:
+      return;
+  }
+}
+
+void CodeGenerator::extend(X86::Register target, std::uint32_t size,
+                           bool isSigned) {
+  emitExtension(isSigned ? Mnemonic::MovSX : Mnemonic::MovZX, 4,
+                static_cast<std::uint8_t>(size), target, reg(target));
+}
+
+void CodeGenerator::parallelMove(std::vector<Move> moves) {
+  for (const auto& next : sequentialize(std::move(moves))) move(next);
+}
+
+void CodeGenerator::move(const Move& move) {
+  const auto to = locationOperand(move.to);
+  if (move.to.kind == Location::Kind::Register) {
+    if (move.from.kind == Location::Kind::None) {
+      materialize(move.value, move.to.reg);
+    } else {
+      emit(Mnemonic::Mov, 8, to, locationOperand(move.from));
+    }
+    return;
+  }
+
+  if (move.from.kind == Location::Kind::Register) {
+    emit(Mnemonic::Mov, 8, to, reg(move.from.reg));
+    return;
+  }
+  if (move.from.kind == Location::Kind::None) {
+    const auto& inst = function[move.value];
+    if (inst.op == Opcode::Const && fitsInInt32(inst.signedImm())) {
+      emit(Mnemonic::Mov, 8, to, Operand::immediate(inst.signedImm()));
+      return;
+    }
+    materialize(move.value, X86::TEMPORARY);
+  } else {
+    emit(Mnemonic::Mov, 8, reg(X86::TEMPORARY), locationOperand(move.from));
+  }
+  emit(Mnemonic::Mov, 8, to, reg(X86::TEMPORARY));
+}
+}  // namespace
+
+MachineFunction generateCode(Function& function, const Module& module) {
+  return CodeGenerator(function, module).run();
+}
@@ -0,0 +1,30 @@
+#ifndef TPLCC_CODE_GENERATION_H
+#define TPLCC_CODE_GENERATION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "ir.h"
+#include "x86-64.h"
+
+// The instructions of a function, shared by the assembly writer and the
+// encoder. Jumps go to labels numbered from 0 in every function.
+struct MachineFunction {
+  std::uint32_t symbol = 0;
+  std::vector<X86::Instruction> code;
+  std::uint32_t numberOfLabels = 0;
+};
+
+// Select the instructions for a function after allocating its registers,
+// see RegisterAllocation, which changes the function.
+//
+// The frame is addressed through RBP: the callee-saved registers the
+// function uses are pushed after it, below them are the spill slots and the
+// allocas. Every instruction is translated on its own, in two-address form:
+// the first operand is moved to the register of the result and the second
+// one, a register or an immediate, applied to it. The only exceptions are a
+// comparison followed by a branch on it, which become one CMP and Jcc, and
+// loads and stores of allocas and globals, which address them directly.
+MachineFunction generateCode(Function& function, const Module& module);
+
+#endif
@@ -0,0 +1,230 @@
+#include "compilation.h"
+
+#include <exception>
+
+#include "ast.h"
+#include "cfg-simplification.h"
+#include "constant-propagation.h"
+#include "dead-code-elimination.h"
+#include "global-value-numbering.h"
+#include "lowering.h"
+#include "parser.h"
+#include "preprocessor.h"
+#include "sema.h"
+#include "string-interner.h"
+#include "string-scanner.h"
+
+namespace {
+// Passes the errors on and counts them.
+struct CountErrors : IReportError {
+  IReportError& errOut;
+  std::size_t count = 0;
+
+  explicit CountErrors(IReportError& errOut) : errOut(errOut) {}
+
+  void reportsError(Error error) override {
+    count++;
+    errOut.reportsError(std::move(error));
+  }
+  bool hasReachedErrorLimit() const override {
+    return errOut.hasReachedErrorLimit();
+  }
+};
+
+// Passes the errors found in preprocessed text on at the offsets in the code
+// buffer the text comes from. An error at the end of the text is put right
+// after its last character.
+struct MapOffsets : IReportError {
+  IReportError& errOut;
+  const PreprocessedText& source;
+
+  MapOffsets(IReportError& errOut, const PreprocessedText& source)
+      : errOut(errOut), source(source) {}
+
+  void reportsError(Error error) override {
+    const auto [start, end] = error.range();
+    const auto mappedStart = map(start);
+    const auto mappedEnd =
+        end > start && end <= source.origins.size()
+            ? source.origins[end - 1] + 1
+            : mappedStart;
+    error.setRange({mappedStart, mappedEnd});
+    errOut.reportsError(std::move(error));
+  }
+  bool hasReachedErrorLimit() const override {
+    return errOut.hasReachedErrorLimit();
+  }
+
+ private:
+  CodeBuffer::Offset map(CodeBuffer::Offset offset) const {
+    const auto& origins = source.origins;
+    if (offset < origins.size()) return origins[offset];
+    return origins.empty() ? 0 : origins.back() + 1;
+  }
+};
+
+bool isBlank(char ch) { return ch == ' ' || ch == '\t'; }
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() && isBlank(text.front())) text.remove_prefix(1);
+  while (!text.empty() && isBlank(text.back())) text.remove_suffix(1);
+  return text;
+}
+
+// A macro as given to -D, see CompileOptions::macros.
+MacroDefinition macroFromOption(std::string_view option) {
+  const auto equals = option.find('=');
+  const auto head = option.substr(0, equals);
+  std::string body(equals == std::string_view::npos
+                       ? std::string_view("1")
+                       : option.substr(equals + 1));
+
+  const auto parenthesis = head.find('(');
+  if (parenthesis == std::string_view::npos) {
+    return MacroDefinition(std::string(trim(head)), std::move(body));
+  }
+  std::vector<std::string> parameters;
+  auto list = head.substr(parenthesis + 1);
+  list = list.substr(0, list.find(')'));
+  while (!trim(list).empty()) {
+    const auto comma = list.find(',');
+    parameters.emplace_back(trim(list.substr(0, comma)));
+    if (comma == std::string_view::npos) break;
+    list.remove_prefix(comma + 1);
+  }
+  return MacroDefinition(std::string(trim(head.substr(0, parenthesis))),
+                         std::move(parameters), std::move(body));
+}
+
+// Append a code point to the text as UTF-8, every byte of it coming from the
+// offset of the character.
+void append(PreprocessedText& result, int codepoint,
+            CodeBuffer::Offset offset) {
+  auto put = [&](int byte) {
+    result.text.push_back(static_cast<char>(byte));
+    result.origins.push_back(offset);
+  };
+  if (codepoint < 0x80) {
+    put(codepoint);
+  } else if (codepoint < 0x800) {
+    put(0xC0 | codepoint >> 6);
+    put(0x80 | (codepoint & 0x3F));
+  } else if (codepoint < 0x10000) {
+    put(0xE0 | codepoint >> 12);
+    put(0x80 | (codepoint >> 6 & 0x3F));
+    put(0x80 | (codepoint & 0x3F));
+  } else {
+    put(0xF0 | codepoint >> 18);
+    put(0x80 | (codepoint >> 12 & 0x3F));
+    put(0x80 | (codepoint >> 6 & 0x3F));
+    put(0x80 | (codepoint & 0x3F));
+  }
+}
+
+bool compileText(std::string_view source, CompiledModule& result,
+                 CountErrors& errors, const CompileOptions& options) {
+  auto* const report = options.timeReport;
+  AST ast;
+  StringInterner strings(options.warmStrings != nullptr
+                             ? &options.warmStrings->base()
+                             : nullptr);
+  TypeTable types;
+  StringScanner scanner(source);
+  Lexer lexer(scanner, errors);
+  Parser parser(lexer, ast, strings, errors, report);
+  NodeID translationUnit;
+  {
+    TimeReport::Scope scope(report, Phase::Parse);
+    // The lexer gives up on a stray character or an unterminated literal by
+    // throwing, once it has reported the error.
+    try {
+      translationUnit = parser.parseTranslationUnit();
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+  if (options.warmStrings != nullptr) options.warmStrings->learn(strings);
+  if (errors.count != 0) return false;
+  Sema sema(ast, strings, types, errors);
+  {
+    TimeReport::Scope scope(report, Phase::Sema);
+    sema.check();
+  }
+  if (errors.count != 0) return false;
+
+  TimeReport::Scope scope(report, Phase::Codegen);
+  Lowering(ast, strings, sema, result.module, errors).lower(translationUnit);
+  if (errors.count != 0) return false;
+
+  // A function's pipeline only changes the function and reads the symbols
+  // of the module, which are all there after lowering.
+  auto& functions = result.module.functions;
+  result.functions.clear();
+  result.functions.resize(functions.size());
+  auto* const cache = options.functionCache;
+  parallelFor(options.pool, functions.size(), [&](std::size_t i) {
+    TimeReport::HelperScope scope(report, Phase::Codegen);
+    auto& function = functions[i];
+    ContentHash fingerprint;
+    if (cache != nullptr) {
+      fingerprint = FunctionCache::fingerprintOf(function, result.module,
+                                                 options.optimize);
+      if (auto found = cache->find(fingerprint, result.module)) {
+        result.functions[i] = std::move(*found);
+        return;
+      }
+    }
+    if (options.optimize) {
+      propagateConstants(function);
+      eliminateDeadCode(function);
+      simplifyControlFlow(function);
+      numberGlobalValues(function);
+      eliminateDeadCode(function);
+    }
+    result.functions[i] = generateCode(function, result.module);
+    if (cache != nullptr) {
+      cache->store(fingerprint, result.functions[i], result.module);
+    }
+  });
+  return true;
+}
+}  // namespace
+
+MacroTable macroTableOf(const std::vector<std::string>& macros) {
+  MacroTable table;
+  for (const auto& macro : macros) defineMacro(table, macroFromOption(macro));
+  return table;
+}
+
+bool preprocess(CodeBuffer& source, PreprocessedText& result,
+                IReportError& errOut, const CompileOptions& options) {
+  TimeReport::Scope scope(options.timeReport, Phase::Preprocess);
+  CountErrors errors(errOut);
+  PreprocessorOptions preprocessorOptions;
+  preprocessorOptions.predefinedMacroTable = options.predefinedMacroTable;
+  for (const auto& macro : options.macros) {
+    preprocessorOptions.predefinedMacros.push_back(macroFromOption(macro));
+  }
+  preprocessorOptions.includeFiles = options.includeFiles;
+
+  result.text.clear();
+  result.origins.clear();
+  Preprocessor<> preprocessor(source, errors, std::move(preprocessorOptions));
+  for (auto ch = preprocessor.get(); ch != EOF; ch = preprocessor.get()) {
+    append(result, ch, ch.offset());
+  }
+  return errors.count == 0;
+}
+
+bool compile(std::string_view source, CompiledModule& result,
+             IReportError& errOut, const CompileOptions& options) {
+  CountErrors errors(errOut);
+  return compileText(source, result, errors, options);
+}
+
+bool compile(const PreprocessedText& source, CompiledModule& result,
+             IReportError& errOut, const CompileOptions& options) {
+  MapOffsets mapOffsets(errOut, source);
+  CountErrors errors(mapOffsets);
+  return compileText(source.text, result, errors, options);
+}
@@ -0,0 +1,82 @@
+#ifndef TPLCC_COMPILATION_H
+#define TPLCC_COMPILATION_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "code-buffer.h"
+#include "code-generation.h"
+#include "error.h"
+#include "function-cache.h"
+#include "include-files.h"
+#include "ir.h"
+#include "preprocessor.h"
+#include "string-interner.h"
+#include "thread-pool.h"
+#include "time-report.h"
+
+// A translation unit compiled down to selected instructions, ready for the
+// assembly writer, the object writer or to be loaded and run.
+struct CompiledModule {
+  Module module;
+  std::vector<MachineFunction> functions;
+};
+
+struct CompileOptions {
+  // Run the IR passes before register allocation.
+  bool optimize = true;
+  // Macros defined before the first line, as given to -D: "NAME",
+  // "NAME=BODY" or "NAME(PARAMETERS)=BODY". NAME alone defines it as 1.
+  std::vector<std::string> macros;
+  // Macros defined before those, built by macroTableOf once for all the
+  // files compiled with the same -D options.
+  const MacroTable* predefinedMacroTable = nullptr;
+  // Where #include finds files, it can't find any if this is nullptr.
+  IIncludeFiles* includeFiles = nullptr;
+  // Measures the phases if it isn't nullptr.
+  TimeReport* timeReport = nullptr;
+  // Runs the IR passes and the instruction selection of the functions on
+  // its threads, each function on its own, if it isn't nullptr. The
+  // functions come out in the same order and the same either way.
+  ThreadPool* pool = nullptr;
+  // The strings of earlier compilations, the base of the interner for this
+  // one, which hands its new strings in to learn. Must not be updated while
+  // the compilation runs.
+  WarmStrings* warmStrings = nullptr;
+  // The machine code of the functions of earlier compilations. Functions
+  // found in it skip the IR passes and the instruction selection, the
+  // others are added to it. The code is the same either way.
+  FunctionCache* functionCache = nullptr;
+};
+
+// The output of the preprocessor and, for every byte of it, where in the
+// code buffer it comes from, so errors found in the text can be reported
+// where the code was written, or expanded.
+struct PreprocessedText {
+  std::string text;
+  std::vector<CodeBuffer::Offset> origins;
+};
+
+// The macros of -D options, see CompileOptions::macros. A later definition
+// of a macro replaces an earlier one.
+MacroTable macroTableOf(const std::vector<std::string>& macros);
+
+// Run the preprocessor over the code buffer, which gets a section for every
+// macro expanded and every file included. Returns false if any errors were
+// reported.
+bool preprocess(CodeBuffer& source, PreprocessedText& result,
+                IReportError& errOut, const CompileOptions& options = {});
+
+// Lex, parse, check, lower, optimize and select instructions for a
+// translation unit. Returns false if any errors were reported, then the
+// module is incomplete.
+bool compile(std::string_view source, CompiledModule& result,
+             IReportError& errOut, const CompileOptions& options = {});
+
+// The same for preprocessed text, the errors are reported at the offsets in
+// the code buffer the text comes from.
+bool compile(const PreprocessedText& source, CompiledModule& result,
+             IReportError& errOut, const CompileOptions& options = {});
+
+#endif
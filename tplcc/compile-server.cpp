@@ -0,0 +1,301 @@
+#include "compile-server.h"
+
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <sstream>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#endif
+
+namespace {
+#ifndef _WIN32
+// A request is its kind, the working directory of the client and the
+// arguments, the response the exit code, the output and the diagnostics.
+// Numbers are 32 bits little-endian, strings their size and their bytes.
+enum class RequestKind : char { Run = 'R', Stop = 'S' };
+
+// Longer strings are taken for a client that speaks something else.
+constexpr std::uint32_t MAX_STRING_SIZE = 1u << 30;
+// How long the server waits for a client that stops sending halfway.
+constexpr int CLIENT_TIMEOUT_SECONDS = 30;
+
+volatile std::sig_atomic_t hasBeenAskedToStop = 0;
+
+extern "C" void askToStop(int) { hasBeenAskedToStop = 1; }
+
+void putNumber(std::string& message, std::uint32_t number) {
+  for (int i = 0; i < 4; i++) {
+    message.push_back(static_cast<char>(number >> 8 * i & 0xFF));
+  }
+}
+
+void putString(std::string& message, const std::string& str) {
+  putNumber(message, static_cast<std::uint32_t>(str.size()));
+  message += str;
+}
+
+// A connected socket, closed when it goes.
+class Connection {
+  int socket;
+
+ public:
+  explicit Connection(int socket) : socket(socket) {}
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+  ~Connection() {
+    if (socket >= 0) close(socket);
+  }
+
+  bool isOpen() const { return socket >= 0; }
+  int fd() const { return socket; }
+
+  bool send(const std::string& message) {
+    std::size_t sent = 0;
+    while (sent < message.size()) {
+      // A client that has gone mustn't kill the server with SIGPIPE.
+      const auto n = ::send(socket, message.data() + sent,
+                            message.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      sent += static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+
+  bool receive(char* data, std::size_t size) {
+    std::size_t received = 0;
+    while (received < size) {
+      const auto n = recv(socket, data + received, size - received, 0);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      received += static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+
+  bool receiveNumber(std::uint32_t& number) {
+    unsigned char bytes[4];
+    if (!receive(reinterpret_cast<char*>(bytes), 4)) return false;
+    number = 0;
+    for (int i = 3; i >= 0; i--) number = number << 8 | bytes[i];
+    return true;
+  }
+
+  bool receiveString(std::string& str) {
+    std::uint32_t size = 0;
+    if (!receiveNumber(size) || size > MAX_STRING_SIZE) return false;
+    str.resize(size);
+    return receive(str.data(), size);
+  }
+};
+
+bool addressOf(const std::string& socketPath, sockaddr_un& address,
+               std::string* problem) {
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    *problem = "The socket path " + socketPath + " is too long.";
+    return false;
+  }
+  std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+  return true;
+}
+
+int connectTo(const sockaddr_un& address) {
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&address),
+              sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+std::string systemError(const std::string& what) {
+  return what + ": " + std::strerror(errno) + ".";
+}
+
+// Send a request and receive the response, the exit code and what the
+// command line printed.
+bool request(const std::string& socketPath, RequestKind kind,
+             const std::vector<std::string>& arguments, int& exitCode,
+             std::string& output, std::string& diagnostics,
+             std::string* problem) {
+  sockaddr_un address;
+  if (!addressOf(socketPath, address, problem)) return false;
+  Connection server(connectTo(address));
+  if (!server.isOpen()) {
+    *problem = systemError("Can't connect to the server at " + socketPath);
+    return false;
+  }
+
+  std::string message(1, static_cast<char>(kind));
+  std::error_code error;
+  putString(message, std::filesystem::current_path(error).string());
+  putNumber(message, static_cast<std::uint32_t>(arguments.size()));
+  for (const auto& argument : arguments) putString(message, argument);
+  std::uint32_t code = 0;
+  if (!server.send(message) || !server.receiveNumber(code) ||
+      !server.receiveString(output) || !server.receiveString(diagnostics)) {
+    *problem = "The server at " + socketPath + " hung up.";
+    return false;
+  }
+  exitCode = static_cast<int>(code);
+  return true;
+}
+
+// Answer one client, false if it asked the server to stop.
+bool answer(Connection& client, const HandleCommandLine& handle) {
+  char kind = 0;
+  std::string workingDirectory;
+  std::uint32_t numberOfArguments = 0;
+  if (!client.receive(&kind, 1) || !client.receiveString(workingDirectory) ||
+      !client.receiveNumber(numberOfArguments)) {
+    return true;
+  }
+  std::vector<std::string> arguments;
+  for (std::uint32_t i = 0; i < numberOfArguments; i++) {
+    if (!client.receiveString(arguments.emplace_back())) return true;
+  }
+
+  int exitCode = 0;
+  std::ostringstream output;
+  std::ostringstream diagnostics;
+  if (kind == static_cast<char>(RequestKind::Run)) {
+    if (chdir(workingDirectory.c_str()) != 0) {
+      diagnostics << "tplcc: "
+                  << systemError("can't enter " + workingDirectory) << "\n";
+      exitCode = 1;
+    } else {
+      try {
+        exitCode = handle(arguments, output, diagnostics);
+      } catch (const std::exception& exception) {
+        diagnostics << "tplcc: " << exception.what() << "\n";
+        exitCode = 1;
+      }
+    }
+  }
+
+  std::string response;
+  putNumber(response, static_cast<std::uint32_t>(exitCode));
+  putString(response, std::move(output).str());
+  putString(response, std::move(diagnostics).str());
+  client.send(response);
+  return kind != static_cast<char>(RequestKind::Stop);
+}
+#endif
+}  // namespace
+
+bool serve(const std::string& socketPath, const HandleCommandLine& handle,
+           std::string* problem) {
+#ifdef _WIN32
+  (void)socketPath;
+  (void)handle;
+  *problem = "The server needs Unix sockets.";
+  return false;
+#else
+  // The server changes its working directory for every request.
+  std::error_code error;
+  const auto path = std::filesystem::absolute(socketPath, error).string();
+  sockaddr_un address;
+  if (!addressOf(path, address, problem)) return false;
+
+  // A socket left by a server that has gone is replaced, one that answers
+  // isn't.
+  if (Connection other(connectTo(address)); other.isOpen()) {
+    *problem = "Another server is listening on " + socketPath + ".";
+    return false;
+  }
+  unlink(path.c_str());
+
+  Connection listener(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  // Whoever connects runs command lines as the user of the server.
+  const auto oldMask = umask(0077);
+  const bool isBound =
+      listener.isOpen() &&
+      bind(listener.fd(), reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) == 0;
+  umask(oldMask);
+  if (!isBound || listen(listener.fd(), 16) != 0) {
+    *problem = systemError("Can't listen on " + socketPath);
+    return false;
+  }
+
+  // Without SA_RESTART, so the signals interrupt poll.
+  struct sigaction stop = {};
+  stop.sa_handler = askToStop;
+  sigemptyset(&stop.sa_mask);
+  struct sigaction oldInterrupt;
+  struct sigaction oldTerminate;
+  hasBeenAskedToStop = 0;
+  sigaction(SIGINT, &stop, &oldInterrupt);
+  sigaction(SIGTERM, &stop, &oldTerminate);
+
+  for (bool isRunning = true; isRunning && !hasBeenAskedToStop;) {
+    pollfd waiting = {listener.fd(), POLLIN, 0};
+    if (poll(&waiting, 1, -1) <= 0) continue;
+    Connection client(accept4(listener.fd(), nullptr, nullptr, SOCK_CLOEXEC));
+    if (!client.isOpen()) continue;
+    const timeval timeout = {CLIENT_TIMEOUT_SECONDS, 0};
+    setsockopt(client.fd(), SOL_SOCKET, SO_RCVTIMEO, &timeout,
+               sizeof(timeout));
+    isRunning = answer(client, handle);
+  }
+
+  sigaction(SIGINT, &oldInterrupt, nullptr);
+  sigaction(SIGTERM, &oldTerminate, nullptr);
+  unlink(path.c_str());
+  return true;
+#endif
+}
+
+std::optional<int> runOnServer(const std::string& socketPath,
+                               const std::vector<std::string>& arguments,
+                               std::ostream& output, std::ostream& diagnostics,
+                               std::string* problem) {
+#ifdef _WIN32
+  (void)socketPath;
+  (void)arguments;
+  (void)output;
+  (void)diagnostics;
+  *problem = "The server needs Unix sockets.";
+  return std::nullopt;
+#else
+  int exitCode = 0;
+  std::string printed;
+  std::string diagnosed;
+  if (!request(socketPath, RequestKind::Run, arguments, exitCode, printed,
+               diagnosed, problem)) {
+    return std::nullopt;
+  }
+  output << printed << std::flush;
+  diagnostics << diagnosed << std::flush;
+  return exitCode;
+#endif
+}
+
+bool stopServer(const std::string& socketPath, std::string* problem) {
+#ifdef _WIN32
+  (void)socketPath;
+  *problem = "The server needs Unix sockets.";
+  return false;
+#else
+  int exitCode = 0;
+  std::string output;
+  std::string diagnostics;
+  return request(socketPath, RequestKind::Stop, {}, exitCode, output,
+                 diagnostics, problem);
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef TPLCC_COMPILE_SERVER_H
+#define TPLCC_COMPILE_SERVER_H
+
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A process that stays around to run the command lines of its clients, so
+// what it keeps from one to the next, the files it has read and what it
+// learned about them, makes the next ones faster. The clients are thin:
+// they send their working directory and their command line over a Unix
+// socket, and get back the exit code and what the command line printed.
+//
+// Requests are served one after the other, each one in the working
+// directory of its client. Only on hosts with Unix sockets.
+
+// Run a command line, given without the program name, printing to output
+// and diagnostics instead of the standard output and error. Returns the
+// exit code.
+using HandleCommandLine =
+    std::function<int(const std::vector<std::string>& arguments,
+                      std::ostream& output, std::ostream& diagnostics)>;
+
+// Listen on the socket and handle the command lines sent to it until a
+// client asks the server to stop, or SIGINT or SIGTERM arrives, then remove
+// the socket. Only the user running the server can connect. Returns false
+// if it can't listen on the socket, e.g. because another server does.
+bool serve(const std::string& socketPath, const HandleCommandLine& handle,
+           std::string* problem);
+
+// Have the server on the socket run the command line in the current working
+// directory and print what it printed to output and diagnostics. Returns
+// the exit code, nullopt if the server can't be reached.
+std::optional<int> runOnServer(const std::string& socketPath,
+                               const std::vector<std::string>& arguments,
+                               std::ostream& output, std::ostream& diagnostics,
+                               std::string* problem);
+
+// Ask the server on the socket to stop once it has answered the requests
+// before. Returns false if the server can't be reached.
+bool stopServer(const std::string& socketPath, std::string* problem);
+
+#endif
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "concurrent-error-sink.h"
+
+namespace {
+// Every sink (and every round of a sink between two merges) gets a new
+// generation, so a thread never mistakes the buffer it cached for a sink that
+// has been destroyed or merged for one of the current sink.
+std::atomic<std::uint64_t> nextGeneration{1};
+
+struct CachedThreadBuffer {
+  std::uint64_t generation = 0;
+  void* buffer = nullptr;
+};
+
+// A thread usually reports to one sink at a time, so caching a single buffer
+// is enough. A thread that alternates between sinks keeps registering new
+// buffers, which is still correct, only slower.
+thread_local CachedThreadBuffer cachedThreadBuffer;
+
+// Where the offset is in the source file: the offset of the outermost
+// invocation or #include it comes from, then the offset in each section
+// down to its own.
+std::vector<CodeBuffer::Offset> positionOf(const CodeBuffer& codeBuffer,
+                                           CodeBuffer::Offset offset) {
+  std::vector<CodeBuffer::Offset> position;
+  for (;;) {
+    const auto section = codeBuffer.sectionOf(offset);
+    position.push_back(offset - codeBuffer.section(section));
+    if (section == 0) break;
+    offset = codeBuffer.sectionOrigin(section).invocationStart;
+  }
+  std::reverse(position.begin(), position.end());
+  return position;
+}
+
+struct PositionedError {
+  std::vector<CodeBuffer::Offset> position;
+  Error error;
+};
+
+bool precedes(const PositionedError& lhs, const PositionedError& rhs) {
+  if (lhs.position != rhs.position) return lhs.position < rhs.position;
+  if (lhs.error.range() != rhs.error.range()) {
+    return lhs.error.range() < rhs.error.range();
+  }
+  if (lhs.error.id() != rhs.error.id()) return lhs.error.id() < rhs.error.id();
+  return lhs.error.message() < rhs.error.message();
+}
+}  // namespace
+
+ConcurrentErrorSink::ConcurrentErrorSink(const CodeBuffer& codeBuffer,
+                                         std::size_t errorLimit)
+    : codeBuffer(codeBuffer),
+      generation(nextGeneration++),
+      errorLimit(errorLimit) {}
+
+void ConcurrentErrorSink::reportsError(Error error) {
+  bufferOfThisThread().errors.push_back(std::move(error));
+}
+
+bool ConcurrentErrorSink::hasReachedErrorLimit() const {
+  if (errorLimit == 0) return false;
+  const auto buffer = cachedBufferOfThisThread();
+  return buffer && buffer->errors.size() >= errorLimit;
+}
+
+void ConcurrentErrorSink::mergeInto(IReportError& errOut) {
+  std::vector<PositionedError> errors;
+  {
+    std::lock_guard lock(mutex);
+    std::size_t numberOfErrors = 0;
+    for (const auto& buffer : buffers) numberOfErrors += buffer.errors.size();
+    errors.reserve(numberOfErrors);
+    for (auto& buffer : buffers) {
+      for (auto& error : buffer.errors) {
+        auto position = positionOf(codeBuffer, std::get<0>(error.range()));
+        errors.push_back({std::move(position), std::move(error)});
+      }
+    }
+    buffers.clear();
+    generation = nextGeneration++;
+  }
+
+  std::sort(errors.begin(), errors.end(), precedes);
+  for (auto& [position, error] : errors) {
+    errOut.reportsError(std::move(error));
+  }
+}
+
+ConcurrentErrorSink::ThreadBuffer*
+ConcurrentErrorSink::cachedBufferOfThisThread() const {
+  return cachedThreadBuffer.generation == generation
+             ? static_cast<ThreadBuffer*>(cachedThreadBuffer.buffer)
+             : nullptr;
+}
+
+ConcurrentErrorSink::ThreadBuffer& ConcurrentErrorSink::bufferOfThisThread() {
+  if (const auto buffer = cachedBufferOfThisThread()) return *buffer;
+
+  std::lock_guard lock(mutex);
+  auto& buffer = buffers.emplace_back();
+  cachedThreadBuffer = {generation, &buffer};
+  return buffer;
+}
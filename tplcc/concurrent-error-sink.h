@@ -0,0 +1,57 @@
+#ifndef TPLCC_CONCURRENT_ERROR_SINK_H
+#define TPLCC_CONCURRENT_ERROR_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "code-buffer.h"
+#include "error.h"
+
+// An IReportError that can be shared by threads lexing, preprocessing or
+// compiling different parts of the input at the same time.
+//
+// Every thread reports into a buffer of its own, a thread only takes the lock
+// the first time it reports an error to the sink, so the reporting path has
+// no contention. When the work is done, mergeInto forwards all errors to
+// another reporter ordered by their positions in the source, hence the output
+// doesn't depend on how the work was split between threads or which thread
+// finished first. Positions are compared where the code is in the source
+// file: an error in a macro expansion or an included file sorts at its
+// invocation or #include, like the output of the preprocessor has it.
+class ConcurrentErrorSink : public IReportError {
+  struct ThreadBuffer {
+    std::vector<Error> errors;
+  };
+
+  const CodeBuffer& codeBuffer;
+  std::mutex mutex;  // guards `buffers` only, not the errors in them.
+  std::deque<ThreadBuffer> buffers;
+  std::uint64_t generation;
+  std::size_t errorLimit;
+
+ public:
+  // If errorLimit isn't zero, a thread reports hasReachedErrorLimit() once it
+  // has reported that many errors itself. As long as each thread reports the
+  // errors of its part of the input in source order, the first errorLimit
+  // errors after merging are the same as in a serial run.
+  explicit ConcurrentErrorSink(const CodeBuffer& codeBuffer,
+                               std::size_t errorLimit = 0);
+  ConcurrentErrorSink(const ConcurrentErrorSink&) = delete;
+  ConcurrentErrorSink& operator=(const ConcurrentErrorSink&) = delete;
+
+  void reportsError(Error error) override;
+  bool hasReachedErrorLimit() const override;
+
+  // Forward every error collected so far to errOut, sorted by source position,
+  // and empty the sink. Must not run concurrently with reportsError.
+  void mergeInto(IReportError& errOut);
+
+ private:
+  ThreadBuffer* cachedBufferOfThisThread() const;
+  ThreadBuffer& bufferOfThisThread();
+};
+
+#endif
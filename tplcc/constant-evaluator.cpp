@@ -0,0 +1,552 @@
+#include "constant-evaluator.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "helper.h"
+#include "literal.h"
+#include "sema.h"
+
+IntegerValue IntegerValue::of(std::uint64_t bits, std::uint8_t width,
+                              bool isUnsigned) {
+  if (width < 64) {
+    const auto mask = (std::uint64_t{1} << width) - 1;
+    bits &= mask;
+    if (!isUnsigned && (bits >> (width - 1)) != 0) bits |= ~mask;
+  }
+  return {bits, width, isUnsigned};
+}
+
+namespace {
+IntegerValue intValue(bool value) { return IntegerValue::of(value, 32, false); }
+
+// The arithmetic is done in 64 bits, where the result of an operation on
+// narrower operands is exact. A signed result overflows if it changes when
+// it is wrapped around to its type.
+FoldResult wrap(std::int64_t result, bool overflows, const IntegerValue& type) {
+  const auto value = IntegerValue::of(static_cast<std::uint64_t>(result),
+                                      type.width, type.isUnsigned);
+  if (type.isUnsigned) return {value};
+  overflows = overflows || value.asSigned() != result;
+  return {value, overflows ? FoldStatus::Overflow : FoldStatus::Ok};
+}
+}  // namespace
+
+FoldResult foldUnary(Operator op, IntegerValue operand) {
+  const auto width = operand.width;
+  const auto isUnsigned = operand.isUnsigned;
+  switch (op) {
+    case Operator::Minus: {
+      const auto result = IntegerValue::of(0 - operand.bits, width, isUnsigned);
+      // The most negative value is the only nonzero one that is its own
+      // negation.
+      const bool overflows =
+          !isUnsigned && !operand.isZero() && result == operand;
+      return {result, overflows ? FoldStatus::Overflow : FoldStatus::Ok};
+    }
+    case Operator::BitwiseNot:
+      return {IntegerValue::of(~operand.bits, width, isUnsigned)};
+    case Operator::LogicalNot:
+      return {intValue(operand.isZero())};
+    default:
+      return {operand};
+  }
+}
+
+FoldResult foldBinary(Operator op, IntegerValue left, IntegerValue right) {
+  const auto width = left.width;
+  const auto isUnsigned = left.isUnsigned;
+  const auto make = [&](std::uint64_t bits) {
+    return IntegerValue::of(bits, width, isUnsigned);
+  };
+  std::int64_t result = 0;
+
+  switch (op) {
+    case Operator::Multiply: {
+      const bool overflows =
+          __builtin_mul_overflow(left.asSigned(), right.asSigned(), &result);
+      return wrap(result, overflows, left);
+    }
+    case Operator::Add: {
+      const bool overflows =
+          __builtin_add_overflow(left.asSigned(), right.asSigned(), &result);
+      return wrap(result, overflows, left);
+    }
+    case Operator::Subtract: {
+      const bool overflows =
+          __builtin_sub_overflow(left.asSigned(), right.asSigned(), &result);
+      return wrap(result, overflows, left);
+    }
+    case Operator::Divide:
+    case Operator::Remainder: {
+      if (right.isZero()) return {make(0), FoldStatus::DivisionByZero};
+      if (isUnsigned) {
+        return {make(op == Operator::Divide ? left.bits / right.bits
+                                            : left.bits % right.bits)};
+      }
+      // Dividing the most negative value by -1 overflows, and so does
+      // taking its remainder in C11, the result of which is made 0 here.
+      if (right.asSigned() == -1) {
+        const auto negation = foldUnary(Operator::Minus, left);
+        if (op == Operator::Divide) return negation;
+        return {make(0), negation.status};
+      }
+      return {make(static_cast<std::uint64_t>(
+          op == Operator::Divide ? left.asSigned() / right.asSigned()
+                                 : left.asSigned() % right.asSigned()))};
+    }
+    case Operator::ShiftLeft:
+    case Operator::ShiftRight: {
+      if ((!right.isUnsigned && right.asSigned() < 0) || right.bits >= width) {
+        return {left, FoldStatus::InvalidShift};
+      }
+      const auto count = static_cast<unsigned>(right.bits);
+      if (op == Operator::ShiftRight) {
+        return {make(isUnsigned ? left.bits >> count
+                                : static_cast<std::uint64_t>(
+                                      left.asSigned() >> count))};
+      }
+      const auto shifted = make(left.bits << count);
+      // A signed shift overflows if it loses bits other than copies of the
+      // sign bit.
+      const bool overflows =
+          !isUnsigned && (shifted.asSigned() >> count) != left.asSigned();
+      return {shifted, overflows ? FoldStatus::Overflow : FoldStatus::Ok};
+    }
+    case Operator::Less:
+    case Operator::Greater:
+    case Operator::LessEqual:
+    case Operator::GreaterEqual: {
+      const bool less = isUnsigned ? left.bits < right.bits
+                                   : left.asSigned() < right.asSigned();
+      const bool equal = left.bits == right.bits;
+      switch (op) {
+        case Operator::Less: return {intValue(less)};
+        case Operator::Greater: return {intValue(!less && !equal)};
+        case Operator::LessEqual: return {intValue(less || equal)};
+        default: return {intValue(!less)};
+      }
+    }
+    case Operator::Equal: return {intValue(left.bits == right.bits)};
+    case Operator::NotEqual: return {intValue(left.bits != right.bits)};
+    case Operator::BitwiseAnd: return {make(left.bits & right.bits)};
+    case Operator::BitwiseXor: return {make(left.bits ^ right.bits)};
+    case Operator::BitwiseOr: return {make(left.bits | right.bits)};
+    case Operator::LogicalAnd:
+      return {intValue(!left.isZero() && !right.isZero())};
+    case Operator::LogicalOr:
+      return {intValue(!left.isZero() || !right.isZero())};
+    case Operator::Comma: return {right};
+    default: return {left};
+  }
+}
+
+namespace {
+ErrorID foldErrorID(FoldStatus status) {
+  switch (status) {
+    case FoldStatus::DivisionByZero: return ErrorID::DivisionByZero;
+    case FoldStatus::InvalidShift: return ErrorID::InvalidShiftCount;
+    default: return ErrorID::ConstantOverflow;
+  }
+}
+
+std::string tokenSpelling(const Token& token) {
+  return std::visit(
+      overload{
+          [](const Punctuator& p) { return p.str; },
+          [](const Identifier& i) { return i.str; },
+          [](const NumberLiteral& n) { return n.str; },
+          [](const StringLiteral& s) { return "\"" + s.str + "\""; },
+          [](const CharacterLiteral& c) { return "'" + c.str + "'"; },
+          [](Keyword k) { return std::string(keywordSpelling(k)); },
+          [](char c) { return std::string(1, c); },
+          [](EndOfInput) { return std::string(); },
+      },
+      token);
+}
+
+// The binary operators of #if lines and how tightly they bind, a higher
+// precedence binds tighter.
+struct BinaryOperator {
+  Operator op;
+  int precedence;
+};
+
+std::optional<BinaryOperator> binaryOperator(const Token& token) {
+  const auto punctuator = std::get_if<Punctuator>(&token);
+  if (!punctuator) return std::nullopt;
+  const auto kind = punctuatorKind(*punctuator);
+  if (!kind) return std::nullopt;
+  switch (*kind) {
+    case PunctuatorKind::LogicalOr: return BinaryOperator{Operator::LogicalOr, 1};
+    case PunctuatorKind::LogicalAnd:
+      return BinaryOperator{Operator::LogicalAnd, 2};
+    case PunctuatorKind::Pipe: return BinaryOperator{Operator::BitwiseOr, 3};
+    case PunctuatorKind::Caret: return BinaryOperator{Operator::BitwiseXor, 4};
+    case PunctuatorKind::Ampersand:
+      return BinaryOperator{Operator::BitwiseAnd, 5};
+    case PunctuatorKind::Equal: return BinaryOperator{Operator::Equal, 6};
+    case PunctuatorKind::NotEqual: return BinaryOperator{Operator::NotEqual, 6};
+    case PunctuatorKind::Less: return BinaryOperator{Operator::Less, 7};
+    case PunctuatorKind::Greater: return BinaryOperator{Operator::Greater, 7};
+    case PunctuatorKind::LessEqual:
+      return BinaryOperator{Operator::LessEqual, 7};
+    case PunctuatorKind::GreaterEqual:
+      return BinaryOperator{Operator::GreaterEqual, 7};
+    case PunctuatorKind::LeftShift:
+      return BinaryOperator{Operator::ShiftLeft, 8};
+    case PunctuatorKind::RightShift:
+      return BinaryOperator{Operator::ShiftRight, 8};
+    case PunctuatorKind::Plus: return BinaryOperator{Operator::Add, 9};
+    case PunctuatorKind::Minus: return BinaryOperator{Operator::Subtract, 9};
+    case PunctuatorKind::Star: return BinaryOperator{Operator::Multiply, 10};
+    case PunctuatorKind::Slash: return BinaryOperator{Operator::Divide, 10};
+    case PunctuatorKind::Percent:
+      return BinaryOperator{Operator::Remainder, 10};
+    default: return std::nullopt;
+  }
+}
+
+// In #if lines every value is an intmax_t or a uintmax_t.
+IntegerValue widen(IntegerValue value, bool isUnsigned) {
+  return IntegerValue::of(value.bits, 64, isUnsigned);
+}
+
+// A recursive descent parser that evaluates as it goes. The operands that
+// aren't evaluated ("0 && 1 / 0") are still parsed, their values are
+// computed but their errors are not reported.
+class PreprocessorExpression {
+  std::span<const Token> tokens;
+  std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range;
+  IReportError& errOut;
+  std::size_t position = 0;
+  int unevaluatedDepth = 0;
+  bool failed = false;
+
+ public:
+  PreprocessorExpression(
+      std::span<const Token> tokens,
+      std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range,
+      IReportError& errOut)
+      : tokens(tokens), range(range), errOut(errOut) {}
+
+  std::optional<IntegerValue> evaluate() {
+    const auto value = conditional();
+    if (!failed && position < tokens.size()) {
+      fail(Error{ErrorID::UnexpectedToken, range,
+                 {tokenSpelling(tokens[position])}});
+    }
+    if (failed) return std::nullopt;
+    return value;
+  }
+
+ private:
+  bool accept(PunctuatorKind kind) {
+    if (position == tokens.size()) return false;
+    const auto punctuator = std::get_if<Punctuator>(&tokens[position]);
+    if (!punctuator || punctuatorKind(*punctuator) != kind) return false;
+    position++;
+    return true;
+  }
+
+  void expect(PunctuatorKind kind, const char* spelling) {
+    if (!accept(kind)) fail(Error{ErrorID::ExpectedToken, range, {spelling}});
+  }
+
+  // Only the first syntax error of a line is reported.
+  void fail(Error error) {
+    if (!failed) errOut.reportsError(std::move(error));
+    failed = true;
+  }
+
+  IntegerValue check(FoldResult result) {
+    if (result.status != FoldStatus::Ok && unevaluatedDepth == 0 && !failed) {
+      errOut.reportsError(Error{foldErrorID(result.status), range});
+    }
+    return result.value;
+  }
+
+  IntegerValue conditional() {
+    const auto condition = binary(1);
+    if (!accept(PunctuatorKind::Question)) return condition;
+
+    const bool takesThen = !condition.isZero();
+    unevaluatedDepth += !takesThen;
+    const auto thenValue = conditional();
+    unevaluatedDepth -= !takesThen;
+    expect(PunctuatorKind::Colon, "\":\"");
+    unevaluatedDepth += takesThen;
+    const auto elseValue = conditional();
+    unevaluatedDepth -= takesThen;
+
+    return widen(takesThen ? thenValue : elseValue,
+                 thenValue.isUnsigned || elseValue.isUnsigned);
+  }
+
+  // Precedence climbing, like the parser does.
+  IntegerValue binary(int minPrecedence) {
+    auto left = unary();
+    while (!failed && position < tokens.size()) {
+      const auto binaryOp = binaryOperator(tokens[position]);
+      if (!binaryOp || binaryOp->precedence < minPrecedence) break;
+      position++;
+      const auto op = binaryOp->op;
+
+      if (op == Operator::LogicalAnd || op == Operator::LogicalOr) {
+        const bool decided = left.isZero() == (op == Operator::LogicalAnd);
+        unevaluatedDepth += decided;
+        const auto right = binary(binaryOp->precedence + 1);
+        unevaluatedDepth -= decided;
+        left = widen(foldBinary(op, left, right).value, false);
+        continue;
+      }
+
+      auto right = binary(binaryOp->precedence + 1);
+      // The usual arithmetic conversions, except for the operands of a
+      // shift.
+      if (op != Operator::ShiftLeft && op != Operator::ShiftRight) {
+        const bool isUnsigned = left.isUnsigned || right.isUnsigned;
+        left = widen(left, isUnsigned);
+        right = widen(right, isUnsigned);
+      }
+      const auto result = check(foldBinary(op, left, right));
+      left = widen(result, result.isUnsigned);
+    }
+    return left;
+  }
+
+  IntegerValue unary() {
+    if (position == tokens.size()) {
+      fail(Error{ErrorID::ExpectedExpression, range});
+      return {};
+    }
+
+    const auto& token = tokens[position];
+    if (const auto punctuator = std::get_if<Punctuator>(&token)) {
+      std::optional<Operator> op;
+      switch (punctuatorKind(*punctuator).value_or(PunctuatorKind::Comma)) {
+        case PunctuatorKind::Plus: op = Operator::Plus; break;
+        case PunctuatorKind::Minus: op = Operator::Minus; break;
+        case PunctuatorKind::Tilde: op = Operator::BitwiseNot; break;
+        case PunctuatorKind::Exclamation: op = Operator::LogicalNot; break;
+        case PunctuatorKind::LeftParenthesis: {
+          position++;
+          const auto value = conditional();
+          expect(PunctuatorKind::RightParenthesis, "\")\"");
+          return value;
+        }
+        default: break;
+      }
+      if (op) {
+        position++;
+        const auto result = check(foldUnary(*op, unary()));
+        return widen(result, result.isUnsigned);
+      }
+    }
+
+    position++;
+    if (const auto number = std::get_if<NumberLiteral>(&token)) {
+      return numberValue(number->str);
+    }
+    if (const auto character = std::get_if<CharacterLiteral>(&token)) {
+      const auto value = characterLiteralValue(
+          character->str, character->prefix == CharSequenceLiteralPrefix::L);
+      return widen(IntegerValue::of(value, 32, false), false);
+    }
+    // The identifiers that are left, keywords included, are not macros.
+    if (std::holds_alternative<Identifier>(token) ||
+        std::holds_alternative<Keyword>(token)) {
+      return widen({}, false);
+    }
+
+    position--;
+    fail(Error{ErrorID::ExpectedExpression, range});
+    return {};
+  }
+
+  IntegerValue numberValue(const std::string& spelling) {
+    const bool isHex = spelling.size() > 1 && spelling[0] == '0' &&
+                       (spelling[1] == 'x' || spelling[1] == 'X');
+    const bool isFloating =
+        spelling.find('.') != std::string::npos ||
+        spelling.find_first_of(isHex ? "pP" : "eE") != std::string::npos;
+    if (isFloating) {
+      fail(Error{ErrorID::NotIntegerConstant, range});
+      return {};
+    }
+
+    const auto literal = integerLiteralValue(spelling);
+    if (literal.overflows) {
+      fail(Error{ErrorID::IntegerLiteralTooLarge, range, {spelling}});
+      return {};
+    }
+    // A literal too large for intmax_t can only be a uintmax_t.
+    return widen(IntegerValue::of(literal.value, 64, false),
+                 literal.isUnsigned || literal.value > INT64_MAX);
+  }
+};
+}  // namespace
+
+std::optional<IntegerValue> evaluatePreprocessorExpression(
+    std::span<const Token> tokens,
+    std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range,
+    IReportError& errOut) {
+  return PreprocessorExpression(tokens, range, errOut).evaluate();
+}
+
+/* ConstantEvaluator */
+
+void ConstantEvaluator::reset() {
+  states.assign(ast.size(), State::Unknown);
+  results.assign(ast.size(), 0);
+}
+
+std::optional<IntegerValue> ConstantEvaluator::evaluate(NodeID id) {
+  switch (states[id]) {
+    case State::Constant: return valueOfType(results[id], sema.typeOf(id));
+    case State::NotConstant: return std::nullopt;
+    default: break;
+  }
+
+  const auto value = compute(id);
+  states[id] = value ? State::Constant : State::NotConstant;
+  if (value) results[id] = value->bits;
+  return value;
+}
+
+// Integer constant expressions as C99 6.6p6 defines them, except that
+// floating constants are only allowed as the immediate operands of casts.
+std::optional<IntegerValue> ConstantEvaluator::compute(NodeID id) {
+  const auto& node = ast[id];
+  const auto type = sema.typeOf(id);
+  if (!sema.typeTable().isInteger(type)) return std::nullopt;
+
+  switch (node.kind) {
+    case NodeKind::IntegerLiteral:
+    case NodeKind::CharacterLiteral:
+      return valueOfType(sema.valueOf(id), type);
+    case NodeKind::SizeofExpr:
+    case NodeKind::SizeofType:
+      if (isVariablyModified(sema.typeOf(node.a))) return std::nullopt;
+      return valueOfType(sema.valueOf(id), type);
+    case NodeKind::Identifier:
+      if (node.a == 0 || ast[node.a].kind != NodeKind::EnumConstantDecl) {
+        return std::nullopt;
+      }
+      return valueOfType(sema.valueOf(node.a), type);
+    case NodeKind::Unary: {
+      const auto op = node.oper();
+      if (op != Operator::Plus && op != Operator::Minus &&
+          op != Operator::BitwiseNot && op != Operator::LogicalNot) {
+        return std::nullopt;
+      }
+      const auto value = operand(node.a);
+      if (!value) return std::nullopt;
+      return convert(check(foldUnary(op, *value), id), type);
+    }
+    case NodeKind::Binary: {
+      const auto op = node.oper();
+      if (op == Operator::Comma) return std::nullopt;
+      const auto left = operand(node.a);
+      if (!left) return std::nullopt;
+      // The right operand isn't evaluated if the left one decides, so it
+      // doesn't have to be a constant.
+      if ((op == Operator::LogicalAnd || op == Operator::LogicalOr) &&
+          left->isZero() == (op == Operator::LogicalAnd)) {
+        return valueOfType(op == Operator::LogicalOr, type);
+      }
+      const auto right = operand(node.b);
+      if (!right) return std::nullopt;
+      return convert(check(foldBinary(op, *left, *right), id), type);
+    }
+    case NodeKind::Conditional: {
+      const auto condition = operand(node.a);
+      if (!condition) return std::nullopt;
+      const auto value = operand(condition->isZero() ? node.c : node.b);
+      if (!value) return std::nullopt;
+      return convert(*value, type);
+    }
+    case NodeKind::Cast: {
+      if (ast[node.b].kind == NodeKind::FloatingLiteral) {
+        return castFloatingLiteral(node.b, type);
+      }
+      const auto value = operand(node.b);
+      if (!value) return std::nullopt;
+      return convert(*value, type);
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
+std::optional<IntegerValue> ConstantEvaluator::operand(NodeID id) {
+  const auto type = sema.convertedTypeOf(id);
+  if (!sema.typeTable().isInteger(type)) return std::nullopt;
+  const auto value = evaluate(id);
+  if (!value) return std::nullopt;
+  return convert(*value, type);
+}
+
+std::optional<IntegerValue> ConstantEvaluator::castFloatingLiteral(
+    NodeID literal, TypeID type) {
+  std::string spelling(strings.view(ast[literal].name));
+  while (!spelling.empty() && std::strchr("fFlL", spelling.back())) {
+    spelling.pop_back();
+  }
+  const double value = std::strtod(spelling.c_str(), nullptr);
+  if (sema.typeTable().kind(type) == TypeKind::Bool) {
+    return IntegerValue::of(value != 0, 8, true);
+  }
+
+  // The value is truncated toward zero, it has to fit in the type
+  // (C99 6.3.1.4p1).
+  const auto result = valueOfType(0, type);
+  const double truncated = std::trunc(value);
+  const double limit =
+      std::ldexp(1.0, result.isUnsigned ? result.width : result.width - 1);
+  const double lowest = result.isUnsigned ? 0 : -limit;
+  if (!(truncated >= lowest && truncated < limit)) {
+    check({result, FoldStatus::Overflow}, literal);
+    return result;
+  }
+  const auto bits =
+      result.isUnsigned
+          ? static_cast<std::uint64_t>(truncated)
+          : static_cast<std::uint64_t>(static_cast<std::int64_t>(truncated));
+  return valueOfType(bits, type);
+}
+
+IntegerValue ConstantEvaluator::valueOfType(std::uint64_t bits,
+                                            TypeID type) const {
+  const auto width = static_cast<std::uint8_t>(sema.sizeOf(type) * 8);
+  return IntegerValue::of(bits, width, !sema.typeTable().isSigned(type));
+}
+
+IntegerValue ConstantEvaluator::convert(IntegerValue value,
+                                        TypeID type) const {
+  if (sema.typeTable().kind(type) == TypeKind::Bool) {
+    return IntegerValue::of(!value.isZero(), 8, true);
+  }
+  return valueOfType(value.bits, type);
+}
+
+// sizeof isn't a constant if its operand is a variable length array.
+bool ConstantEvaluator::isVariablyModified(TypeID type) const {
+  const auto& types = sema.typeTable();
+  while (types.kind(type) == TypeKind::Array) {
+    if (types[type].flags & TypeFlag::VariableLength) return true;
+    type = types[type].base;
+  }
+  return false;
+}
+
+IntegerValue ConstantEvaluator::check(FoldResult result, NodeID id) {
+  if (result.status != FoldStatus::Ok) {
+    const auto offset = ast[id].offset;
+    errOut.reportsError(
+        Error{foldErrorID(result.status), {offset, offset + 1}});
+  }
+  return result.value;
+}
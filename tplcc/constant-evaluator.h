@@ -0,0 +1,115 @@
+#ifndef TPLCC_CONSTANT_EVALUATOR_H
+#define TPLCC_CONSTANT_EVALUATOR_H
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include "Lexer.h"
+#include "ast.h"
+#include "code-buffer.h"
+#include "error.h"
+#include "string-interner.h"
+#include "types.h"
+
+class Sema;
+
+// Integer constant expressions are needed in #if lines, enumerators, array
+// sizes, case labels and bit-field widths. All of them share the arithmetic
+// below, only the way the operands are found differs: the preprocessor reads
+// them off a line of tokens, the compiler off the typed AST.
+
+// An integer value together with the width and the signedness of its type.
+// The bits above the width are always a sign (or zero) extension of the
+// value, so comparing two values of the same type is comparing their bits.
+struct IntegerValue {
+  std::uint64_t bits = 0;
+  std::uint8_t width = 32;
+  bool isUnsigned = false;
+
+  // Wrap bits around to a value of the type, like a conversion to it does.
+  static IntegerValue of(std::uint64_t bits, std::uint8_t width,
+                         bool isUnsigned);
+
+  std::int64_t asSigned() const { return static_cast<std::int64_t>(bits); }
+  bool isZero() const { return bits == 0; }
+  bool operator==(const IntegerValue&) const = default;
+};
+
+enum class FoldStatus : std::uint8_t {
+  Ok,
+  // The result isn't representable in its type (C99 6.6p4), the value is
+  // wrapped around.
+  Overflow,
+  DivisionByZero,
+  // The shift count is negative or not less than the width of the type.
+  InvalidShift,
+};
+
+struct FoldResult {
+  IntegerValue value;
+  FoldStatus status = FoldStatus::Ok;
+};
+
+// The operands must be converted already: the promoted operand of a unary
+// operator, the operands of a binary operator to their common type (the
+// right operand of a shift is only promoted). Comparisons and the logical
+// operators give an int. The logical operators don't short-circuit here, the
+// callers decide which operands to evaluate.
+FoldResult foldUnary(Operator op, IntegerValue operand);
+FoldResult foldBinary(Operator op, IntegerValue left, IntegerValue right);
+
+// Evaluate the expression of an #if or #elif line after its macros have been
+// expanded and its "defined" operators replaced. Every integer acts as if it
+// had the type intmax_t or uintmax_t, the identifiers left are 0 (C99
+// 6.10.1p4). Tokens don't carry their ranges, so errors are reported at the
+// range of the whole expression. Returns nothing if the line isn't a valid
+// expression.
+std::optional<IntegerValue> evaluatePreprocessorExpression(
+    std::span<const Token> tokens,
+    std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range,
+    IReportError& errOut);
+
+// Evaluates the expressions of a translation unit that Sema has typed. The
+// value of a node is kept once it has been computed, so asking again, e.g.
+// for an enumerator used in many array sizes, costs nothing. Errors in the
+// arithmetic are reported only the first time.
+class ConstantEvaluator {
+  enum class State : std::uint8_t { Unknown, Constant, NotConstant };
+
+  const AST& ast;
+  const StringInterner& strings;
+  const Sema& sema;
+  IReportError& errOut;
+
+  std::vector<State> states;
+  std::vector<std::uint64_t> results;
+
+ public:
+  ConstantEvaluator(const AST& ast, const StringInterner& strings,
+                    const Sema& sema, IReportError& errOut)
+      : ast(ast), strings(strings), sema(sema), errOut(errOut) {}
+
+  // Forget all values, e.g. before the tree is checked again.
+  void reset();
+
+  // The value of an integer constant expression in the type of the
+  // expression, nothing if the expression isn't one. The node and its
+  // operands must have been typed.
+  std::optional<IntegerValue> evaluate(NodeID id);
+
+ private:
+  std::optional<IntegerValue> compute(NodeID id);
+  // The value of an operand converted to the type it is used as.
+  std::optional<IntegerValue> operand(NodeID id);
+  std::optional<IntegerValue> castFloatingLiteral(NodeID literal,
+                                                  TypeID type);
+  IntegerValue valueOfType(std::uint64_t bits, TypeID type) const;
+  IntegerValue convert(IntegerValue value, TypeID type) const;
+  bool isVariablyModified(TypeID type) const;
+  IntegerValue check(FoldResult result, NodeID id);
+};
+
+#endif
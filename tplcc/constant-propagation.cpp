@@ -0,0 +1,294 @@
+#include "constant-propagation.h"
+
+#include <array>
+#include <optional>
+#include <vector>
+
+#include "constant-evaluator.h"
+
+namespace {
+// The lattice of a value. Constants keep their bits sign-extended from the
+// width of their type, like Const instructions do.
+enum class State : std::uint8_t { Unknown, Constant, Overdefined };
+
+struct Lattice {
+  State state = State::Unknown;
+  std::uint64_t bits = 0;
+
+  bool operator==(const Lattice&) const = default;
+};
+
+constexpr Lattice OVERDEFINED{State::Overdefined, 0};
+
+std::uint8_t widthOf(IRType type) {
+  return static_cast<std::uint8_t>(sizeOf(type) * 8);
+}
+
+// The operator of the constant expression an opcode computes, and whether it
+// treats its operands as unsigned.
+std::optional<std::pair<Operator, bool>> operatorOf(Opcode op) {
+  switch (op) {
+    case Opcode::Add: return {{Operator::Add, false}};
+    case Opcode::Sub: return {{Operator::Subtract, false}};
+    case Opcode::Mul: return {{Operator::Multiply, false}};
+    case Opcode::SDiv: return {{Operator::Divide, false}};
+    case Opcode::UDiv: return {{Operator::Divide, true}};
+    case Opcode::SRem: return {{Operator::Remainder, false}};
+    case Opcode::URem: return {{Operator::Remainder, true}};
+    case Opcode::And: return {{Operator::BitwiseAnd, false}};
+    case Opcode::Or: return {{Operator::BitwiseOr, false}};
+    case Opcode::Xor: return {{Operator::BitwiseXor, false}};
+    case Opcode::Shl: return {{Operator::ShiftLeft, true}};
+    case Opcode::LShr: return {{Operator::ShiftRight, true}};
+    case Opcode::AShr: return {{Operator::ShiftRight, false}};
+    case Opcode::Eq: return {{Operator::Equal, false}};
+    case Opcode::Ne: return {{Operator::NotEqual, false}};
+    case Opcode::SLt: return {{Operator::Less, false}};
+    case Opcode::SLe: return {{Operator::LessEqual, false}};
+    case Opcode::SGt: return {{Operator::Greater, false}};
+    case Opcode::SGe: return {{Operator::GreaterEqual, false}};
+    case Opcode::ULt: return {{Operator::Less, true}};
+    case Opcode::ULe: return {{Operator::LessEqual, true}};
+    case Opcode::UGt: return {{Operator::Greater, true}};
+    case Opcode::UGe: return {{Operator::GreaterEqual, true}};
+    case Opcode::Neg: return {{Operator::Minus, false}};
+    case Opcode::Not: return {{Operator::BitwiseNot, false}};
+    default: return std::nullopt;
+  }
+}
+
+class ConstantPropagation {
+  Function& function;
+  const UseLists uses;
+  std::vector<Lattice> values;
+  std::vector<bool> executableBlocks;
+  // Whether the edges to the successors of every block can be taken.
+  std::vector<std::array<bool, 2>> executableEdges;
+  std::vector<BlockID> blockWorklist;
+  std::vector<ValueID> valueWorklist;
+
+ public:
+  explicit ConstantPropagation(Function& function)
+      : function(function),
+        uses(function),
+        values(function.size()),
+        executableBlocks(function.numberOfBlocks()),
+        executableEdges(function.numberOfBlocks()) {}
+
+  void analyze();
+  bool rewrite();
+
+ private:
+  void markEdge(BlockID from, std::size_t index);
+  void visitBlock(BlockID id, bool isFirstVisit);
+  void visit(ValueID id);
+  Lattice evaluate(ValueID id) const;
+  Lattice evaluatePhi(ValueID id) const;
+  bool isExecutableEdge(BlockID from, BlockID to) const;
+};
+
+void ConstantPropagation::analyze() {
+  // Values outside the blocks are known from the start.
+  for (ValueID id = 1; id < values.size(); id++) {
+    const auto& inst = function[id];
+    if (inst.op == Opcode::Const) {
+      values[id] = {State::Constant, inst.imm};
+    } else if (inst.op == Opcode::Param || inst.op == Opcode::Symbol) {
+      values[id] = OVERDEFINED;
+    }
+  }
+  executableBlocks[Function::ENTRY] = true;
+  visitBlock(Function::ENTRY, true);
+
+  while (!blockWorklist.empty() || !valueWorklist.empty()) {
+    while (!blockWorklist.empty()) {
+      const auto id = blockWorklist.back();
+      blockWorklist.pop_back();
+      const bool isFirstVisit = !executableBlocks[id];
+      executableBlocks[id] = true;
+      visitBlock(id, isFirstVisit);
+    }
+    while (!valueWorklist.empty()) {
+      const auto id = valueWorklist.back();
+      valueWorklist.pop_back();
+      for (const auto& use : uses.of(id)) {
+        if (executableBlocks[function[use.user].block]) visit(use.user);
+      }
+    }
+  }
+}
+
+void ConstantPropagation::markEdge(BlockID from, std::size_t index) {
+  if (executableEdges[from][index]) return;
+  executableEdges[from][index] = true;
+  blockWorklist.push_back(function.block(from).successorArray[index]);
+}
+
+// A block is visited completely the first time an edge into it can be
+// taken, later only its phis have something new to meet.
+void ConstantPropagation::visitBlock(BlockID id, bool isFirstVisit) {
+  const auto& block = function.block(id);
+  for (const auto phi : block.phis) visit(phi);
+  if (!isFirstVisit) return;
+  for (const auto inst : block.insts) visit(inst);
+}
+
+void ConstantPropagation::visit(ValueID id) {
+  const auto& inst = function[id];
+  switch (inst.op) {
+    case Opcode::Nop:
+      return;
+    case Opcode::Jump:
+      markEdge(inst.block, 0);
+      return;
+    case Opcode::Branch: {
+      const auto& condition = values[function.operands(id)[0]];
+      if (condition.state == State::Overdefined) {
+        markEdge(inst.block, 0);
+        markEdge(inst.block, 1);
+      } else if (condition.state == State::Constant) {
+        markEdge(inst.block, condition.bits != 0 ? 0 : 1);
+      }
+      return;
+    }
+    default:
+      break;
+  }
+
+  const auto value = evaluate(id);
+  if (value == values[id]) return;
+  values[id] = value;
+  valueWorklist.push_back(id);
+}
+
+Lattice ConstantPropagation::evaluate(ValueID id) const {
+  const auto& inst = function[id];
+  if (inst.op == Opcode::Phi) return evaluatePhi(id);
+
+  const bool isConversion =
+      inst.op == Opcode::SExt || inst.op == Opcode::ZExt ||
+      inst.op == Opcode::Trunc || inst.op == Opcode::Copy;
+  if (!isConversion && !operatorOf(inst.op)) return OVERDEFINED;
+
+  const auto operands = function.operands(id);
+
+  for (const auto operand : operands) {
+    if (values[operand].state != State::Constant) return values[operand];
+  }
+
+  const auto source = function[operands[0]].type;
+  const auto width = widthOf(source);
+  const auto bits = values[operands[0]].bits;
+  switch (inst.op) {
+    case Opcode::SExt:
+    case Opcode::Copy:
+      return {State::Constant, bits};
+    case Opcode::ZExt:
+      return {State::Constant, IntegerValue::of(bits, width, true).bits};
+    case Opcode::Trunc:
+      return {State::Constant,
+              IntegerValue::of(bits, widthOf(inst.type), false).bits};
+    default:
+      break;
+  }
+
+  const auto [op, isUnsigned] = *operatorOf(inst.op);
+  const auto left = IntegerValue::of(bits, width, isUnsigned);
+  FoldResult result;
+  if (operands.size() == 1) {
+    result = foldUnary(op, left);
+  } else {
+    // Shift counts are compared unsigned, so a negative one is too large.
+    const bool isShift = op == Operator::ShiftLeft || op == Operator::ShiftRight;
+    const auto right = IntegerValue::of(values[operands[1]].bits, width,
+                                        isUnsigned || isShift);
+    result = foldBinary(op, left, right);
+  }
+  if (result.status == FoldStatus::DivisionByZero ||
+      result.status == FoldStatus::InvalidShift) {
+    return OVERDEFINED;
+  }
+  return {State::Constant,
+          IntegerValue::of(result.value.bits, widthOf(inst.type), false).bits};
+}
+
+// The meet of the operands for the edges that can be taken.
+Lattice ConstantPropagation::evaluatePhi(ValueID id) const {
+  const auto block = function[id].block;
+  const auto& predecessors = function.block(block).predecessors;
+  const auto operands = function.operands(id);
+  Lattice result;
+  for (std::size_t i = 0; i < operands.size(); i++) {
+    if (!isExecutableEdge(predecessors[i], block)) continue;
+    const auto& value = values[operands[i]];
+    if (value.state == State::Unknown) continue;
+    if (value.state == State::Overdefined ||
+        (result.state == State::Constant && result.bits != value.bits)) {
+      return OVERDEFINED;
+    }
+    result = value;
+  }
+  return result;
+}
+
+bool ConstantPropagation::isExecutableEdge(BlockID from, BlockID to) const {
+  const auto& block = function.block(from);
+  for (std::uint8_t i = 0; i < block.numberOfSuccessors; i++) {
+    if (block.successorArray[i] == to && executableEdges[from][i]) return true;
+  }
+  return false;
+}
+
+bool ConstantPropagation::rewrite() {
+  bool changed = false;
+
+  // The constants replacing the values, created before anything refers to
+  // the instructions, since creating one can move them.
+  std::vector<ValueID> replacements(function.size());
+  for (ValueID id = 1; id < replacements.size(); id++) {
+    const auto& value = values[id];
+    if (value.state != State::Constant || function[id].op == Opcode::Const) {
+      continue;
+    }
+    replacements[id] = function.constant(function[id].type, value.bits);
+  }
+
+  for (const auto id : function.liveBlocks()) {
+    if (!executableBlocks[id]) {
+      function.removeBlock(id);
+      changed = true;
+      continue;
+    }
+    const auto& block = function.block(id);
+    const auto terminator = function.terminator(id);
+    if (function[terminator].op == Opcode::Branch) {
+      const auto& condition = values[function.operands(terminator)[0]];
+      if (condition.state == State::Constant) {
+        function.simplifyBranch(id,
+                                block.successorArray[condition.bits ? 0 : 1]);
+        changed = true;
+      }
+    }
+    for (const auto* list : {&block.phis, &block.insts}) {
+      for (const auto inst : *list) {
+        if (replacements[inst] != 0) {
+          function.remove(inst);
+          changed = true;
+          continue;
+        }
+        for (auto& operand : function.operands(inst)) {
+          if (replacements[operand] != 0) operand = replacements[operand];
+        }
+      }
+    }
+  }
+  function.sweep();
+  return changed;
+}
+}  // namespace
+
+bool propagateConstants(Function& function) {
+  ConstantPropagation propagation(function);
+  propagation.analyze();
+  return propagation.rewrite();
+}
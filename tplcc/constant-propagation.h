@@ -0,0 +1,22 @@
+#ifndef TPLCC_CONSTANT_PROPAGATION_H
+#define TPLCC_CONSTANT_PROPAGATION_H
+
+#include "ir.h"
+
+// Sparse conditional constant propagation (Wegman and Zadeck, "Constant
+// Propagation with Conditional Branches", TOPLAS 1991). Every value starts
+// out unknown and only moves down to a constant and then to "not a
+// constant"; a block is only looked at once an edge into it can be taken,
+// and a phi only meets the operands of such edges. So a constant that flows
+// around a loop stays a constant, and so does the branch on it.
+//
+// The arithmetic is that of the integer constant expressions (foldUnary and
+// foldBinary), in the width of the IR type. A division by zero or a shift by
+// too much is left for the program to do at run time.
+//
+// Afterwards the instructions that compute a constant are replaced by it,
+// branches on a constant become jumps and the blocks that can't be reached
+// are removed. Returns whether the function changed.
+bool propagateConstants(Function& function);
+
+#endif
@@ -0,0 +1,78 @@
+#include "content-hash.h"
+
+#include <cstring>
+
+namespace {
+constexpr std::uint64_t K1 = 0x9E3779B97F4A7C15ull;
+constexpr std::uint64_t K2 = 0xC2B2AE3D27D4EB4Full;
+constexpr std::uint64_t K3 = 0x165667B19E3779F9ull;
+
+std::uint64_t rotateLeft(std::uint64_t x, int bits) {
+  return x << bits | x >> (64 - bits);
+}
+
+// The finalizer of MurmurHash3, every bit of the input flips every bit of
+// the output with about even odds.
+std::uint64_t mix(std::uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDull;
+  x ^= x >> 33;
+  x *= 0xC4CEB9FE1A85EC53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+// Little-endian whatever the host, so the hashes of a cache on disk don't
+// depend on it.
+std::uint64_t wordAt(const char* bytes, std::size_t size) {
+  unsigned char word[8] = {};
+  std::memcpy(word, bytes, size);
+  std::uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) value = value << 8 | word[i];
+  return value;
+}
+}  // namespace
+
+std::string ContentHash::hex() const {
+  static constexpr char DIGITS[] = "0123456789abcdef";
+  std::string digits(32, '0');
+  for (int i = 0; i < 16; i++) {
+    digits[15 - i] = DIGITS[high >> 4 * i & 0xF];
+    digits[31 - i] = DIGITS[low >> 4 * i & 0xF];
+  }
+  return digits;
+}
+
+ContentHasher::ContentHasher() : a(K1), b(K2) {}
+
+ContentHasher& ContentHasher::add(std::string_view bytes) {
+  addWord(bytes.size());
+  std::size_t i = 0;
+  for (; i + 8 <= bytes.size(); i += 8) addWord(wordAt(bytes.data() + i, 8));
+  // The size above tells the zeros padding the last word from the bytes.
+  if (i < bytes.size()) {
+    addWord(wordAt(bytes.data() + i, bytes.size() - i));
+  }
+  numberOfPieces++;
+  return *this;
+}
+
+ContentHasher& ContentHasher::add(std::uint64_t number) {
+  addWord(number);
+  numberOfPieces++;
+  return *this;
+}
+
+ContentHash ContentHasher::finish() const {
+  auto x = a ^ mix(numberOfPieces * K3);
+  auto y = b + x;
+  x = mix(x + y);
+  y = mix(y ^ rotateLeft(x, 29));
+  return {x, y};
+}
+
+void ContentHasher::addWord(std::uint64_t word) {
+  const auto mixed = mix(word);
+  a = rotateLeft(a ^ mixed, 27) * K1 + b;
+  b = rotateLeft(b ^ (mixed * K2), 31) * K3 + a;
+}
@@ -0,0 +1,43 @@
+#ifndef TPLCC_CONTENT_HASH_H
+#define TPLCC_CONTENT_HASH_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// A 128-bit hash of what an output is made from, to find the output again.
+// Good enough against accidental collisions, not against someone making
+// them on purpose.
+struct ContentHash {
+  std::uint64_t high = 0;
+  std::uint64_t low = 0;
+
+  bool operator==(const ContentHash&) const = default;
+
+  // 32 lowercase hex digits.
+  std::string hex() const;
+};
+
+// Hashes the pieces added to it, in order. Every piece is hashed with its
+// size, so ("ab", "c") and ("a", "bc") hash differently.
+class ContentHasher {
+  std::uint64_t a;
+  std::uint64_t b;
+  std::uint64_t numberOfPieces = 0;
+
+ public:
+  ContentHasher();
+
+  ContentHasher& add(std::string_view bytes);
+  ContentHasher& add(std::uint64_t number);
+  ContentHasher& add(const ContentHash& hash) {
+    return add(hash.high).add(hash.low);
+  }
+
+  ContentHash finish() const;
+
+ private:
+  void addWord(std::uint64_t word);
+};
+
+#endif
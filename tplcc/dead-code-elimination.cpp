@@ -0,0 +1,41 @@
+#include "dead-code-elimination.h"
+
+#include <vector>
+
+bool eliminateDeadCode(Function& function) {
+  std::vector<bool> isLive(function.size());
+  std::vector<ValueID> worklist;
+  const auto blocks = function.liveBlocks();
+
+  for (const auto id : blocks) {
+    for (const auto inst : function.block(id).insts) {
+      if (function[inst].op != Opcode::Nop && hasSideEffects(function[inst])) {
+        isLive[inst] = true;
+        worklist.push_back(inst);
+      }
+    }
+  }
+  while (!worklist.empty()) {
+    const auto id = worklist.back();
+    worklist.pop_back();
+    for (const auto operand : function.operands(id)) {
+      if (isLive[operand]) continue;
+      isLive[operand] = true;
+      worklist.push_back(operand);
+    }
+  }
+
+  bool changed = false;
+  for (const auto id : blocks) {
+    const auto& block = function.block(id);
+    for (const auto* list : {&block.phis, &block.insts}) {
+      for (const auto inst : *list) {
+        if (isLive[inst] || function[inst].op == Opcode::Nop) continue;
+        function.remove(inst);
+        changed = true;
+      }
+    }
+  }
+  if (changed) function.sweep();
+  return changed;
+}
@@ -0,0 +1,14 @@
+#ifndef TPLCC_DEAD_CODE_ELIMINATION_H
+#define TPLCC_DEAD_CODE_ELIMINATION_H
+
+#include "ir.h"
+
+// Remove the instructions whose results nothing needs. Rather than deleting
+// unused instructions until none are left, it marks the live ones, starting
+// from the ones with side effects and following operands, and removes the
+// rest. That also removes cycles of phis that only use each other, e.g. a
+// variable incremented in a loop and never read. Every instruction and
+// operand is looked at once. Returns whether the function changed.
+bool eliminateDeadCode(Function& function);
+
+#endif
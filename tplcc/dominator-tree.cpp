@@ -0,0 +1,95 @@
+#include "dominator-tree.h"
+
+#include <algorithm>
+#include <utility>
+
+DominatorTree::DominatorTree(const Function& function)
+    : orderIndices(function.numberOfBlocks()),
+      idoms(function.numberOfBlocks()),
+      childStarts(function.numberOfBlocks() + 1),
+      enterTimes(function.numberOfBlocks()),
+      exitTimes(function.numberOfBlocks()) {
+  // Postorder with an explicit stack of the blocks and the index of the
+  // next successor to look at.
+  std::vector<std::pair<BlockID, std::uint8_t>> stack{{Function::ENTRY, 0}};
+  std::vector<bool> isVisited(function.numberOfBlocks());
+  isVisited[Function::ENTRY] = true;
+  while (!stack.empty()) {
+    auto& [id, next] = stack.back();
+    const auto successors = function.block(id).successors();
+    if (next == successors.size()) {
+      order.push_back(id);
+      stack.pop_back();
+      continue;
+    }
+    const auto successor = successors[next++];
+    if (isVisited[successor]) continue;
+    isVisited[successor] = true;
+    stack.push_back({successor, 0});
+  }
+  std::reverse(order.begin(), order.end());
+  for (std::uint32_t i = 0; i < order.size(); i++) {
+    orderIndices[order[i]] = i + 1;
+  }
+
+  idoms[Function::ENTRY] = Function::ENTRY;
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (std::size_t i = 1; i < order.size(); i++) {
+      const auto id = order[i];
+      BlockID idom = 0;
+      for (const auto predecessor : function.block(id).predecessors) {
+        if (idoms[predecessor] == 0) continue;
+        idom = idom == 0 ? predecessor : intersect(predecessor, idom);
+      }
+      if (idoms[id] == idom) continue;
+      idoms[id] = idom;
+      changed = true;
+    }
+  }
+  idoms[Function::ENTRY] = 0;
+
+  // Children in reverse postorder, stored like the UseLists.
+  for (const auto id : order) childStarts[idoms[id] + 1]++;
+  for (std::size_t i = 1; i < childStarts.size(); i++) {
+    childStarts[i] += childStarts[i - 1];
+  }
+  childList.resize(childStarts.back());
+  std::vector<std::uint32_t> cursors(childStarts.begin(),
+                                     childStarts.end() - 1);
+  for (const auto id : order) {
+    if (idoms[id] != 0) childList[cursors[idoms[id]]++] = id;
+  }
+
+  std::uint32_t time = 0;
+  std::vector<std::pair<BlockID, std::uint32_t>> walk{{Function::ENTRY, 0}};
+  enterTimes[Function::ENTRY] = ++time;
+  while (!walk.empty()) {
+    auto& [id, next] = walk.back();
+    const auto kids = children(id);
+    if (next == kids.size()) {
+      exitTimes[id] = ++time;
+      walk.pop_back();
+      continue;
+    }
+    const auto child = kids[next++];
+    enterTimes[child] = ++time;
+    walk.push_back({child, 0});
+  }
+}
+
+bool DominatorTree::dominates(BlockID a, BlockID b) const {
+  if (!isReachable(a) || !isReachable(b)) return false;
+  return enterTimes[a] <= enterTimes[b] && exitTimes[b] <= exitTimes[a];
+}
+
+// The nearest common dominator of two blocks whose dominators are known so
+// far. Walking up from a block only reaches blocks earlier in reverse
+// postorder.
+BlockID DominatorTree::intersect(BlockID a, BlockID b) const {
+  while (a != b) {
+    while (orderIndices[a] > orderIndices[b]) a = idoms[a];
+    while (orderIndices[b] > orderIndices[a]) b = idoms[b];
+  }
+  return a;
+}
@@ -0,0 +1,54 @@
+#ifndef TPLCC_DOMINATOR_TREE_H
+#define TPLCC_DOMINATOR_TREE_H
+
+#include <span>
+#include <vector>
+
+#include "ir.h"
+
+// The dominator tree of the blocks reachable from the entry, computed with
+// the iterative algorithm of Cooper, Harvey and Kennedy ("A Simple, Fast
+// Dominance Algorithm", 2001): the immediate dominators are refined in
+// reverse postorder until they don't change, which takes two or three
+// passes over the blocks for the CFGs of structured code.
+//
+// The tree is numbered in preorder once it is built, so whether a block
+// dominates another is answered in constant time.
+class DominatorTree {
+  std::vector<BlockID> order;
+  // The index of every block in order plus 1, 0 if it can't be reached.
+  std::vector<std::uint32_t> orderIndices;
+  std::vector<BlockID> idoms;
+  // The children of block b are childList[childStarts[b]] to
+  // childList[childStarts[b + 1]], in reverse postorder.
+  std::vector<std::uint32_t> childStarts;
+  std::vector<BlockID> childList;
+  // The interval of every block in a preorder walk of the tree.
+  std::vector<std::uint32_t> enterTimes;
+  std::vector<std::uint32_t> exitTimes;
+
+ public:
+  explicit DominatorTree(const Function& function);
+
+  // The reachable blocks in reverse postorder, so every block comes after
+  // its dominators. The entry block is the first one.
+  std::span<const BlockID> reversePostorder() const { return order; }
+  bool isReachable(BlockID id) const { return orderIndices[id] != 0; }
+
+  // The immediate dominator of a block, 0 for the entry block and the blocks
+  // that can't be reached.
+  BlockID immediateDominator(BlockID id) const { return idoms[id]; }
+  std::span<const BlockID> children(BlockID id) const {
+    return {childList.data() + childStarts[id],
+            childStarts[id + 1] - childStarts[id]};
+  }
+
+  // Whether every path from the entry to b goes through a. A block dominates
+  // itself.
+  bool dominates(BlockID a, BlockID b) const;
+
+ private:
+  BlockID intersect(BlockID a, BlockID b) const;
+};
+
+#endif
@@ -1,8 +1,9 @@
 #include "encoding.h"
 
 std::tuple<int, int> utf8(const unsigned char *buffer) {
-  unsigned int codepoint;
-  int charlen;
+  // An invalid leading byte is taken as a character by itself.
+  unsigned int codepoint = buffer[0];
+  int charlen = 1;
   if (buffer[0] >> 7 == 0) {
     charlen = 1;
     codepoint = buffer[0];
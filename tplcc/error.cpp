@@ -0,0 +1,638 @@
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include "error.h"
+
+namespace {
+struct ErrorText {
+  const char* name;
+  const char* message;
+  const char* hint;
+};
+
+// Indexed by ErrorID, keep the order in sync with the enum.
+constexpr ErrorText ERROR_TEXTS[] = {
+    {"custom",
+     "{0}", "{1}"},
+
+    {"invalid-number-literal-suffix",
+     "\"{0}\" is not a valid suffix for the number literal {1}.",
+     "invalid suffix."},
+    {"exponent-has-no-digit",
+     "Exponent part of number literal {0} has no digit.",
+     "Exponent has no digit."},
+    {"invalid-octal-number",
+     "Invalid octal number.", "Invalid octal number."},
+    {"hex-float-has-no-exponent",
+     "Hexadecimal floating point {0} has no exponent part.",
+     "Hex float has no exponent part."},
+    {"unterminated-string-literal",
+     "The string literal has no ending quote.", "No ending quote."},
+    {"unterminated-character-literal",
+     "The character literal has no ending quote.", "No ending quote."},
+    {"invalid-string-literal-prefix",
+     "\"{0}\" is not a valid prefix for a string literal.", "Invalid prefix."},
+    {"invalid-character-literal-prefix",
+     "\"{0}\" is not a valid prefix for a character literal.",
+     "Invalid prefix."},
+    {"stray-character",
+     "Stray \"{0}\" in program.", "Invalid character."},
+
+    {"unterminated-comment",
+     "Unterminated comment.", ""},
+    {"macro-argument-count-mismatch",
+     "The macro \"{0}\" requires {1} argument(s), but got {2}.", ""},
+    {"unterminated-macro-argument-list",
+     "unterminated argument list invoking macro \"{0}\"", ""},
+    {"macro-name-must-be-identifier",
+     "macro names must be identifiers", ""},
+    {"unknown-directive",
+     "Unknown preprocessing directive {0}", ""},
+    {"expected-parameter-name",
+     "Expected parameter name before end of line", ""},
+    {"expected-comma-or-right-parenthesis",
+     "Expected ',' or ')' here.", ""},
+    {"expected-right-parenthesis",
+     "Expected ')' before end of line", ""},
+    {"duplicated-macro-parameter",
+     "Duplicated parameter \"{0}\" in the function-like macro \"{1}\".", ""},
+    {"unterminated-conditional",
+     "The conditional directive has no matching #endif.", ""},
+    {"unmatched-conditional-directive",
+     "#{0} without #if.", ""},
+    {"directive-after-else",
+     "#{0} after #else.", ""},
+    {"expected-header-name",
+     "#include expects \"FILENAME\" or <FILENAME>.", ""},
+    {"included-file-not-found",
+     "Can't find the included file {0}.", "File not found."},
+    {"include-nested-too-deeply",
+     "#include nested more than {0} levels deep.", ""},
+
+    {"expected-token",
+     "Expected {0} here.", "Expected {0}."},
+    {"expected-expression",
+     "Expected an expression here.", "Expected an expression."},
+    {"expected-identifier",
+     "Expected an identifier here.", "Expected an identifier."},
+    {"unexpected-token",
+     "Unexpected \"{0}\".", ""},
+    {"invalid-type-specifier-combination",
+     "\"{0}\" cannot be combined with the previous type specifiers.", ""},
+    {"missing-type-specifier",
+     "Type specifier missing, the type is assumed to be int.", ""},
+    {"redefinition",
+     "Redefinition of \"{0}\".", ""},
+    {"tag-kind-mismatch",
+     "\"{0}\" is declared as a different kind of tag.", ""},
+    {"break-outside-loop-or-switch",
+     "The break statement is not in a loop or a switch statement.", ""},
+    {"continue-outside-loop",
+     "The continue statement is not in a loop.", ""},
+    {"label-outside-switch",
+     "The {0} label is not in a switch statement.", ""},
+    {"duplicated-default",
+     "Multiple default labels in one switch statement.", ""},
+    {"duplicated-label",
+     "Duplicated label \"{0}\".", ""},
+    {"undefined-label",
+     "Use of undefined label \"{0}\".", ""},
+    {"unknown-parameter",
+     "\"{0}\" is not in the identifier list of the function.", ""},
+
+    {"undeclared-identifier",
+     "Use of undeclared identifier \"{0}\".", "Undeclared."},
+    {"integer-literal-too-large",
+     "The integer literal {0} is too large for any integer type.", ""},
+    {"invalid-operands",
+     "Invalid operands to \"{0}\" (\"{1}\" and \"{2}\").", ""},
+    {"invalid-operand",
+     "Invalid operand to \"{0}\" (\"{1}\").", ""},
+    {"incompatible-types",
+     "Cannot convert \"{1}\" to \"{0}\".", ""},
+    {"not-assignable",
+     "The expression is not assignable.", ""},
+    {"not-addressable",
+     "Cannot take the address of the expression.", ""},
+    {"not-callable",
+     "The called object of type \"{0}\" is not a function.", ""},
+    {"argument-count-mismatch",
+     "The function takes {0} argument(s), but got {1}.", ""},
+    {"no-such-member",
+     "\"{0}\" has no member named \"{1}\".", ""},
+    {"incomplete-type",
+     "Incomplete type \"{0}\".", ""},
+    {"scalar-required",
+     "A scalar value is required here, but got \"{0}\".", ""},
+    {"not-integer-constant",
+     "The expression is not an integer constant expression.", ""},
+    {"invalid-array-size",
+     "The size of an array must be greater than zero.", ""},
+    {"void-function-returns-value",
+     "A function returning void cannot return a value.", ""},
+    {"missing-return-value",
+     "The function has to return a value of type \"{0}\".", ""},
+
+    {"constant-overflow",
+     "Integer overflow in a constant expression.", "Overflows."},
+    {"division-by-zero",
+     "Division by zero in a constant expression.", "Division by zero."},
+    {"invalid-shift-count",
+     "The shift count is negative or not less than the width of the type.",
+     ""},
+
+    {"unsupported-construct",
+     "{0} are not supported by the code generator yet.", ""},
+    {"not-constant-initializer",
+     "The initializer of an object with static storage duration must be a "
+     "constant.", ""},
+};
+static_assert(std::size(ERROR_TEXTS) ==
+                  static_cast<std::size_t>(ErrorID::NotConstantInitializer) + 1,
+              "ERROR_TEXTS needs a row for every ErrorID");
+
+// Replace every "{N}" in the template with the N-th argument of the error.
+std::string substituteArguments(const char* textTemplate, const Error& error) {
+  std::string output;
+  for (const char* p = textTemplate; *p; p++) {
+    if (p[0] == '{' && p[1] >= '0' && p[1] <= '9' && p[2] == '}') {
+      output += error.argument(p[1] - '0');
+      p += 2;
+    } else {
+      output.push_back(*p);
+    }
+  }
+  return output;
+}
+
+bool isUTF8ContinuationByte(unsigned char byte) {
+  return (byte & 0xC0) == 0x80;
+}
+
+void writeJSONString(BufferedWriter& writer, std::string_view str) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+
+  writer.put('"');
+  for (const char ch : str) {
+    switch (ch) {
+      case '"': writer.write("\\\""); break;
+      case '\\': writer.write("\\\\"); break;
+      case '\n': writer.write("\\n"); break;
+      case '\r': writer.write("\\r"); break;
+      case '\t': writer.write("\\t"); break;
+      default:
+        if (static_cast<unsigned char>(ch) < 0x20) {
+          writer.write("\\u00").put(HEX_DIGITS[ch >> 4]).put(
+              HEX_DIGITS[ch & 0xF]);
+        } else {
+          writer.put(ch);
+        }
+    }
+  }
+  writer.put('"');
+}
+}  // namespace
+
+/* Error */
+
+Error::Error(ErrorID id,
+             std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range,
+             std::initializer_list<std::string_view> arguments)
+    : _id(id), _range(range) {
+  bool isFirst = true;
+  for (const auto& argument : arguments) {
+    if (!isFirst) _arguments.push_back('\0');
+    _arguments.append(argument);
+    isFirst = false;
+  }
+}
+
+std::string_view Error::argument(std::size_t index) const {
+  std::string_view rest = _arguments;
+  for (; index > 0; index--) {
+    const auto separator = rest.find('\0');
+    if (separator == std::string_view::npos) return {};
+    rest.remove_prefix(separator + 1);
+  }
+  return rest.substr(0, rest.find('\0'));
+}
+
+std::string Error::message() const {
+  return substituteArguments(ERROR_TEXTS[static_cast<std::size_t>(_id)].message,
+                             *this);
+}
+
+std::string Error::hint() const {
+  return substituteArguments(ERROR_TEXTS[static_cast<std::size_t>(_id)].hint,
+                             *this);
+}
+
+bool Error::operator==(const Error& other) const {
+  if (_range != other._range) return false;
+  if (_id == other._id) return _arguments == other._arguments;
+  return message() == other.message() && hint() == other.hint();
+}
+
+/* ErrorReporter */
+
+ErrorReporter::ErrorReporter(std::string filename, const CodeBuffer& codeBuffer,
+                             DiagnosticFormat format, std::ostream& outStream,
+                             std::size_t errorLimit)
+    : filename(std::move(filename)),
+      codeBuffer(codeBuffer),
+      errorLimit(errorLimit),
+      format(format),
+      writer(std::make_unique<BufferedWriter>(outStream)) {
+  if (format == DiagnosticFormat::SARIF) {
+    writer->write(
+        "{\"version\":\"2.1.0\","
+        "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+        "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"tplcc\"}},"
+        "\"columnKind\":\"unicodeCodePoints\",\"results\":[\n");
+  }
+}
+
+ErrorReporter::~ErrorReporter() { finish(); }
+
+void ErrorReporter::reportsError(Error error) {
+  if (hasReachedErrorLimit()) {
+    numberOfErrors++;
+    return;
+  }
+
+  if (format == DiagnosticFormat::Text) {
+    listOfErrors.push_back(std::move(error));
+  } else if (format == DiagnosticFormat::JSONLines) {
+    writeJSONLine(error);
+  } else {
+    writeSARIFResult(error);
+  }
+
+  numberOfErrors++;
+}
+
+bool ErrorReporter::hasReachedErrorLimit() const {
+  return errorLimit != 0 && numberOfErrors >= errorLimit;
+}
+
+void ErrorReporter::finish() {
+  if (!writer || hasFinished) return;
+  hasFinished = true;
+  if (format == DiagnosticFormat::SARIF) writer->write("\n]}]}\n");
+  writer->flush();
+}
+
+void ErrorReporter::outputErrorMessagesTo(std::ostream& os) {
+  buildLineStarts();
+
+  for (const auto& error : listOfErrors) {
+    const auto [start, end] = error.range();
+
+    if (const auto& file = fileOf(start); &file != &filename) {
+      os << "In the included file \"" << file << "\"\n\n";
+    }
+    os << filename << ": " << error.message() << "\n\n";
+
+    if (codeBuffer.isFileSection(codeBuffer.sectionOf(start))) {
+      outputSourceLine(os, start, end, error.hint());
+    } else {
+      outputMacroExpansions(os, error);
+    }
+
+    os << "\n";
+  }
+
+  if (format == DiagnosticFormat::Text &&
+      numberOfErrors > listOfErrors.size()) {
+    os << filename << ": too many errors emitted, "
+       << numberOfErrors - listOfErrors.size()
+       << " more error(s) are not shown.\n";
+  }
+}
+
+void ErrorReporter::buildLineStarts() {
+  if (!lineStarts.empty()) return;
+
+  lineStarts.push_back(0);
+  const auto end = codeBuffer.sectionEnd(0);
+  for (CodeBuffer::Offset offset = 0; offset < end; offset++) {
+    if (codeBuffer[offset] == '\n') lineStarts.push_back(offset + 1);
+  }
+}
+
+std::size_t ErrorReporter::lineIndexOf(CodeBuffer::Offset offset) {
+  const auto it =
+      std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+  return it - lineStarts.begin() - 1;
+}
+
+// The number of the line the offset is on and where the line starts. Lines
+// of an included file are counted from its start, the lines of a macro
+// expansion have no number (0). Only the source file has its line starts
+// built ahead, there are few errors in included files.
+std::pair<std::size_t, CodeBuffer::Offset> ErrorReporter::lineOf(
+    CodeBuffer::Offset offset) {
+  const auto sectionID = codeBuffer.sectionOf(offset);
+  if (sectionID == 0) {
+    const auto lineIndex = lineIndexOf(offset);
+    return {lineIndex + 1, lineStarts[lineIndex]};
+  }
+
+  const auto sectionStart = codeBuffer.section(sectionID);
+  auto lineStart = offset;
+  while (lineStart > sectionStart && codeBuffer[lineStart - 1] != '\n') {
+    lineStart--;
+  }
+  if (!codeBuffer.isFileSection(sectionID)) return {0, lineStart};
+
+  std::size_t lineNumber = 1;
+  for (auto i = sectionStart; i < lineStart; i++) {
+    if (codeBuffer[i] == '\n') lineNumber++;
+  }
+  return {lineNumber, lineStart};
+}
+
+// The path of the file the offset is in, or of the file with the invocation
+// of the macro expansion it is in.
+const std::string& ErrorReporter::fileOf(CodeBuffer::Offset offset) {
+  auto sectionID = codeBuffer.sectionOf(offset);
+  while (!codeBuffer.isFileSection(sectionID)) {
+    const auto& origin = codeBuffer.sectionOrigin(sectionID);
+    sectionID = codeBuffer.sectionOf(origin.invocationStart);
+  }
+  return sectionID == 0 ? filename
+                        : codeBuffer.sectionOrigin(sectionID).includedFile;
+}
+
+std::size_t ErrorReporter::columnOf(CodeBuffer::Offset lineStart,
+                                    CodeBuffer::Offset offset) {
+  std::size_t column = 1;
+  for (auto i = lineStart; i < offset; i++) {
+    if (!isUTF8ContinuationByte(codeBuffer[i])) column++;
+  }
+  return column;
+}
+
+// Sections of the macro expansions the offset is in, from the innermost one to
+// the one invoked from the file, the source file or an included one. Empty if
+// the offset is in the file.
+std::vector<CodeBuffer::SectionID> ErrorReporter::expansionsOf(
+    CodeBuffer::Offset offset) {
+  std::vector<CodeBuffer::SectionID> expansions;
+  for (auto sectionID = codeBuffer.sectionOf(offset);
+       !codeBuffer.isFileSection(sectionID);
+       sectionID = codeBuffer.sectionOf(
+           codeBuffer.sectionOrigin(sectionID).invocationStart)) {
+    expansions.push_back(sectionID);
+  }
+  return expansions;
+}
+
+// The error happens inside a macro expansion. Follow the invocations from the
+// section containing the error back to the file, then print the outermost
+// invocation, followed by the definition and the expanded text of every macro
+// on the way, highlighting where the next inner macro is invoked and finally
+// where the error is. See the comment above ErrorReporter for an example.
+void ErrorReporter::outputMacroExpansions(std::ostream& os,
+                                          const Error& error) {
+  const auto [start, end] = error.range();
+  const auto expansions = expansionsOf(start);
+
+  const auto& outermost = codeBuffer.sectionOrigin(expansions.back());
+  os << "It occurs in this macro:\n\n";
+  outputSourceLine(os, outermost.invocationStart, outermost.invocationEnd, "");
+
+  for (auto i = expansions.size(); i-- > 0;) {
+    const auto& origin = codeBuffer.sectionOrigin(expansions[i]);
+
+    if (origin.definitionEnd != origin.definitionStart) {
+      os << "\nThe macro has following definition:\n\n";
+      outputSourceLines(os, origin.definitionStart, origin.definitionEnd);
+    }
+
+    os << "\nand is expanded into following text:\n\n";
+    if (i == 0) {
+      outputSourceLine(os, start, end, error.hint());
+    } else {
+      const auto& inner = codeBuffer.sectionOrigin(expansions[i - 1]);
+      outputSourceLine(os, inner.invocationStart, inner.invocationEnd, "");
+    }
+  }
+}
+
+// Output the line where the range starts and highlight the range with carets,
+// for example:
+//
+// 10 |     int a = 0.3ef;
+//                  ^^^^^ (Hex float has no exponent part.)
+//
+// If the range goes across multiple lines, only the part on the first line is
+// highlighted. Lines of a macro expansion have no line number.
+void ErrorReporter::outputSourceLine(std::ostream& os, CodeBuffer::Offset start,
+                                     CodeBuffer::Offset end,
+                                     const std::string& hint) {
+  const auto sectionEnd = codeBuffer.sectionEnd(codeBuffer.sectionOf(start));
+  const auto [lineNumber, lineStart] = lineOf(start);
+  const auto label = lineNumber != 0 ? std::to_string(lineNumber) : "";
+
+  auto lineEnd = lineStart;
+  while (lineEnd < sectionEnd && codeBuffer[lineEnd] != '\n' &&
+         codeBuffer[lineEnd] != '\r') {
+    lineEnd++;
+  }
+
+  outputLine(os, label, lineStart, lineEnd);
+
+  // Keep tabs so that the carets line up with the code above them however
+  // wide the terminal renders a tab.
+  std::string carets(gutterWidth(label) + 3, ' ');
+  for (auto offset = lineStart; offset < start; offset++) {
+    const auto byte = codeBuffer[offset];
+    if (isUTF8ContinuationByte(byte)) continue;
+    carets.push_back(byte == '\t' ? '\t' : ' ');
+  }
+  const auto highlightEnd =
+      end > start ? std::min(end, lineEnd) : std::min(start + 1, lineEnd);
+  for (auto offset = start; offset < highlightEnd; offset++) {
+    if (!isUTF8ContinuationByte(codeBuffer[offset])) carets.push_back('^');
+  }
+  if (highlightEnd <= start) carets.push_back('^');
+
+  os << carets;
+  if (!hint.empty()) os << " (" << hint << ")";
+  os << "\n";
+}
+
+// Output every line of the file, the source file or an included one, that
+// the range touches.
+void ErrorReporter::outputSourceLines(std::ostream& os,
+                                      CodeBuffer::Offset start,
+                                      CodeBuffer::Offset end) {
+  const auto fileEnd = codeBuffer.sectionEnd(codeBuffer.sectionOf(start));
+  const auto last = end > start ? end - 1 : start;
+  auto [lineNumber, lineStart] = lineOf(start);
+
+  while (lineStart <= last && lineStart < fileEnd) {
+    auto lineEnd = lineStart;
+    while (lineEnd < fileEnd && codeBuffer[lineEnd] != '\n' &&
+           codeBuffer[lineEnd] != '\r') {
+      lineEnd++;
+    }
+    outputLine(os, std::to_string(lineNumber), lineStart, lineEnd);
+
+    lineStart = lineEnd;
+    while (lineStart < fileEnd && codeBuffer[lineStart] != '\n') lineStart++;
+    lineStart++;
+    lineNumber++;
+  }
+}
+
+// The line numbers are left aligned and padded to the width of the largest
+// one of the source file, so that the bars of all lines of the file line up.
+// Lines of included files have the widths of their own numbers if they are
+// wider.
+std::size_t ErrorReporter::gutterWidth(const std::string& label) const {
+  return std::max(std::to_string(lineStarts.size()).size(), label.size());
+}
+
+void ErrorReporter::outputLine(std::ostream& os, const std::string& label,
+                               CodeBuffer::Offset lineStart,
+                               CodeBuffer::Offset lineEnd) {
+  os << label << std::string(gutterWidth(label) - label.size(), ' ') << " | ";
+  os.write(reinterpret_cast<const char*>(codeBuffer.pos(lineStart)),
+           lineEnd - lineStart);
+  os << "\n";
+}
+
+// One JSON object per error, e.g.
+//
+// {"file":"foo.c","startLine":2,"startColumn":9,"endLine":2,"endColumn":13,
+//  "message":"...","hint":"...","expansions":[...]}
+//
+// where the region is the error's own range in the file, or the outermost
+// macro invocation if the error happens in a macro expansion. The file is the
+// source file or the included file the error is in.
+void ErrorReporter::writeJSONLine(const Error& error) {
+  const auto [start, end] = error.range();
+  writer->write("{\"file\":");
+  writeJSONString(*writer, fileOf(start));
+  writer->put(',');
+  const auto expansions = expansionsOf(start);
+  if (expansions.empty()) {
+    writeRegion(start, end);
+  } else {
+    const auto& outermost = codeBuffer.sectionOrigin(expansions.back());
+    writeRegion(outermost.invocationStart, outermost.invocationEnd);
+  }
+  writer->write(",\"message\":");
+  writeJSONString(*writer, error.message());
+  writer->write(",\"hint\":");
+  writeJSONString(*writer, error.hint());
+  writer->put(',');
+  writeExpansions(error);
+  writer->write("}\n");
+}
+
+void ErrorReporter::writeSARIFResult(const Error& error) {
+  if (numberOfErrors != 0) writer->write(",\n");
+
+  const auto [start, end] = error.range();
+  const auto expansions = expansionsOf(start);
+
+  writer->write("{\"ruleId\":\"")
+      .write(ERROR_TEXTS[static_cast<std::size_t>(error.id())].name)
+      .write("\",\"level\":\"error\",\"message\":{\"text\":");
+  writeJSONString(*writer, error.message());
+  writer->write("},\"locations\":[{\"physicalLocation\":{"
+                "\"artifactLocation\":{\"uri\":");
+  writeJSONString(*writer, fileOf(start));
+  writer->write("},\"region\":{");
+  if (expansions.empty()) {
+    writeRegion(start, end);
+  } else {
+    const auto& outermost = codeBuffer.sectionOrigin(expansions.back());
+    writeRegion(outermost.invocationStart, outermost.invocationEnd);
+  }
+  writer->write("}}}]");
+
+  if (!expansions.empty()) {
+    writer->write(",\"relatedLocations\":[");
+    for (std::size_t i = 0; i < expansions.size(); i++) {
+      const auto& origin = codeBuffer.sectionOrigin(expansions[i]);
+      if (i != 0) writer->put(',');
+      writer->write("{\"id\":").writeUnsigned(i).write(
+          ",\"message\":{\"text\":\"macro definition\"},"
+          "\"physicalLocation\":{\"artifactLocation\":{\"uri\":");
+      writeJSONString(*writer, fileOf(origin.definitionStart));
+      writer->write("},\"region\":{");
+      writeRegion(origin.definitionStart, origin.definitionEnd);
+      writer->write("}}}");
+    }
+    writer->put(']');
+  }
+
+  writer->write(",\"properties\":{\"hint\":");
+  writeJSONString(*writer, error.hint());
+  writer->put(',');
+  writeExpansions(error);
+  writer->write("}}");
+}
+
+// "startLine":..,"startColumn":..,"endLine":..,"endColumn":.. of a range in the
+// source file or an included one. Columns count code points and start from
+// 1, the end column is exclusive.
+void ErrorReporter::writeRegion(CodeBuffer::Offset start,
+                                CodeBuffer::Offset end) {
+  buildLineStarts();
+
+  if (end < start) end = start;
+  const auto [startLine, startLineStart] = lineOf(start);
+  const auto [endLine, endLineStart] = lineOf(end);
+  writer->write("\"startLine\":").writeUnsigned(startLine);
+  writer->write(",\"startColumn\":")
+      .writeUnsigned(columnOf(startLineStart, start));
+  writer->write(",\"endLine\":").writeUnsigned(endLine);
+  writer->write(",\"endColumn\":").writeUnsigned(columnOf(endLineStart, end));
+}
+
+// "expansions":[...], the macro expansions the error happens in, from the
+// innermost one outwards. Each of them has the expanded text, the columns
+// highlighted in it (the error, or the invocation of the inner macro) and the
+// region of the macro's definition.
+void ErrorReporter::writeExpansions(const Error& error) {
+  const auto [start, end] = error.range();
+  const auto expansions = expansionsOf(start);
+
+  writer->write("\"expansions\":[");
+  for (std::size_t i = 0; i < expansions.size(); i++) {
+    const auto& origin = codeBuffer.sectionOrigin(expansions[i]);
+    const auto sectionStart = codeBuffer.section(expansions[i]);
+    const auto sectionEnd = codeBuffer.sectionEnd(expansions[i]);
+
+    auto highlightStart = start;
+    auto highlightEnd = end;
+    if (i != 0) {
+      const auto& inner = codeBuffer.sectionOrigin(expansions[i - 1]);
+      highlightStart = inner.invocationStart;
+      highlightEnd = inner.invocationEnd;
+    }
+    highlightEnd = std::clamp(highlightEnd, highlightStart, sectionEnd);
+
+    if (i != 0) writer->put(',');
+    writer->write("{\"expandedText\":");
+    writeJSONString(*writer,
+                    std::string_view(reinterpret_cast<const char*>(
+                                         codeBuffer.pos(sectionStart)),
+                                     sectionEnd - sectionStart));
+    writer->write(",\"startColumn\":")
+        .writeUnsigned(columnOf(sectionStart, highlightStart));
+    writer->write(",\"endColumn\":")
+        .writeUnsigned(columnOf(sectionStart, highlightEnd));
+    writer->write(",\"definition\":{");
+    writeRegion(origin.definitionStart, origin.definitionEnd);
+    writer->write("}}");
+  }
+  writer->put(']');
+}
@@ -4,39 +4,150 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
 #include <vector>
 #include <optional>
+#include <ostream>
+#include <initializer_list>
+#include <cstddef>
 #include <cstdint>
 
 #include "scanner.h" 
 #include "code-buffer.h"
+#include "buffered-writer.h"
+
+// Every kind of error tplcc can report. The text of each error lives in a
+// table in error.cpp, reporting sites only pass the arguments that are
+// substituted into the text ({0}, {1}, ...), so nothing gets formatted until
+// someone actually asks for the message.
+enum class ErrorID : std::uint16_t {
+    // The message and the hint are given by the reporter as the first and the
+    // second argument.
+    Custom,
+
+    // Lexer
+    InvalidNumberLiteralSuffix,
+    ExponentHasNoDigit,
+    InvalidOctalNumber,
+    HexFloatHasNoExponent,
+    UnterminatedStringLiteral,
+    UnterminatedCharacterLiteral,
+    InvalidStringLiteralPrefix,
+    InvalidCharacterLiteralPrefix,
+    StrayCharacter,
+
+    // Preprocessor
+    UnterminatedComment,
+    MacroArgumentCountMismatch,
+    UnterminatedMacroArgumentList,
+    MacroNameMustBeIdentifier,
+    UnknownDirective,
+    ExpectedParameterName,
+    ExpectedCommaOrRightParenthesis,
+    ExpectedRightParenthesis,
+    DuplicatedMacroParameter,
+    UnterminatedConditional,
+    UnmatchedConditionalDirective,
+    DirectiveAfterElse,
+    ExpectedHeaderName,
+    IncludedFileNotFound,
+    IncludeNestedTooDeeply,
+
+    // Parser
+    ExpectedToken,
+    ExpectedExpression,
+    ExpectedIdentifier,
+    UnexpectedToken,
+    InvalidTypeSpecifierCombination,
+    MissingTypeSpecifier,
+    Redefinition,
+    TagKindMismatch,
+    BreakOutsideLoopOrSwitch,
+    ContinueOutsideLoop,
+    LabelOutsideSwitch,
+    DuplicatedDefault,
+    DuplicatedLabel,
+    UndefinedLabel,
+    UnknownParameter,
+
+    // Semantic analysis
+    UndeclaredIdentifier,
+    IntegerLiteralTooLarge,
+    InvalidOperands,
+    InvalidOperand,
+    IncompatibleTypes,
+    NotAssignable,
+    NotAddressable,
+    NotCallable,
+    ArgumentCountMismatch,
+    NoSuchMember,
+    IncompleteType,
+    ScalarRequired,
+    NotIntegerConstant,
+    InvalidArraySize,
+    VoidFunctionReturnsValue,
+    MissingReturnValue,
+
+    // Constant expressions
+    ConstantOverflow,
+    DivisionByZero,
+    InvalidShiftCount,
+
+    // Code generation
+    UnsupportedConstruct,
+    // The last one, error.cpp checks that it has a text for every ID.
+    NotConstantInitializer,
+};
 
+// A compact diagnostic record: what went wrong (the ID), where it happened
+// (the range) and the few words that differ between two errors of the same
+// kind (the arguments, stored back to back and separated by '\0').
 class Error {
-    std::string _message;
-    std::string _hint;
-    std::tuple<std::uint32_t, std::uint32_t> _range;
+    ErrorID _id = ErrorID::Custom;
+    std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> _range;
+    std::string _arguments;
 
 public:
     Error() = default;
+    Error(ErrorID id, std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range,
+          std::initializer_list<std::string_view> arguments = {});
     Error(std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range,
-          std::string msg, std::string hintMsg = "")
-        : _range(range), _message(std::move(msg)), _hint(std::move(hintMsg)) {}
+          std::string_view msg, std::string_view hintMsg = "")
+        : Error(ErrorID::Custom, range, {msg, hintMsg}) {}
 
-    std::string hint() const {
-        return _hint;
+    ErrorID id() const {
+        return _id;
     }
 
-    std::string message() const {
-        return _message;
-    }
+    std::string_view argument(std::size_t index) const;
+
+    std::string hint() const;
+
+    std::string message() const;
 
     std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range() const {
         return _range;
     }
+
+    // Move the error, from the preprocessed text to the code buffer e.g.
+    void setRange(std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range) {
+        _range = range;
+    }
+
+    bool operator==(const Error& other) const;
 };
 
 struct IReportError {
     virtual void reportsError(Error error) = 0;
+
+    // Callers doing expensive work (lexing, preprocessing, ...) poll this and
+    // stop early once no more errors will be shown to the user anyway.
+    virtual bool hasReachedErrorLimit() const {
+        return false;
+    }
+
     virtual ~IReportError() = default;
 };
 
@@ -106,21 +217,95 @@ foo.c: Undefined varaible "abc"
 
 */
 
+// How ErrorReporter outputs errors. Text is meant for humans and is output
+// all at once by outputErrorMessagesTo. The other formats are meant for tools:
+// every error is streamed as soon as it is reported, one JSON object per line
+// for JSONLines, or as the results of a SARIF 2.1.0 log.
+enum class DiagnosticFormat {
+    Text,
+    JSONLines,
+    SARIF
+};
+
 // Collect errors from transformation units (lexer, parser i.e.), add infomation 
 // about the location where the error occurs, shows the macro expansion if the
 // error is under a macro expansion, and finally output these error message to
 // an ostream.
-class ErrorReporter: IReportError {
+//
+// Errors are kept as they were reported and only rendered in
+// outputErrorMessagesTo, so a compilation whose errors are never printed
+// doesn't pay for formatting them. Once errorLimit errors (if it's not zero)
+// have been collected, further errors are only counted.
+//
+// In the machine-readable formats nothing is collected, errors are written
+// through a buffered writer when they are reported, so a flood of errors
+// doesn't grow the memory usage.
+class ErrorReporter: public IReportError {
     std::string filename;
+    const CodeBuffer& codeBuffer;
+    std::size_t errorLimit;
+    std::size_t numberOfErrors = 0;
     std::vector<Error> listOfErrors;
+
+    DiagnosticFormat format = DiagnosticFormat::Text;
+    std::unique_ptr<BufferedWriter> writer;
+    bool hasFinished = false;
+
+    // Offsets where each line of the source file (section 0) starts, built the
+    // first time we render an error.
+    std::vector<CodeBuffer::Offset> lineStarts;
+
 public:
     ErrorReporter(
         std::string filename,
-        std::ostream& outStream
-    ) : filename(filename) {}
+        const CodeBuffer& codeBuffer,
+        std::size_t errorLimit = 0
+    ) : filename(std::move(filename)), codeBuffer(codeBuffer), errorLimit(errorLimit) {}
+
+    ErrorReporter(
+        std::string filename,
+        const CodeBuffer& codeBuffer,
+        DiagnosticFormat format,
+        std::ostream& outStream,
+        std::size_t errorLimit = 0
+    );
 
-    void reportsError(Error error);
+    ~ErrorReporter();
+
+    void reportsError(Error error) override;
+    bool hasReachedErrorLimit() const override;
     void outputErrorMessagesTo(std::ostream& os);
+
+    // Complete the output of a streaming format (closing the SARIF log for
+    // instance) and flush it. Called by the destructor if nobody did it.
+    void finish();
+
+    // Number of errors reported so far, including the ones dropped because of
+    // the error limit.
+    std::size_t errorCount() const {
+        return numberOfErrors;
+    }
+
+private:
+    void buildLineStarts();
+    std::size_t lineIndexOf(CodeBuffer::Offset offset);
+    std::pair<std::size_t, CodeBuffer::Offset> lineOf(CodeBuffer::Offset offset);
+    const std::string& fileOf(CodeBuffer::Offset offset);
+    std::size_t columnOf(CodeBuffer::Offset lineStart, CodeBuffer::Offset offset);
+    std::vector<CodeBuffer::SectionID> expansionsOf(CodeBuffer::Offset offset);
+    void outputMacroExpansions(std::ostream& os, const Error& error);
+    void outputSourceLine(std::ostream& os, CodeBuffer::Offset start,
+                          CodeBuffer::Offset end, const std::string& hint);
+    void outputSourceLines(std::ostream& os, CodeBuffer::Offset start,
+                           CodeBuffer::Offset end);
+    std::size_t gutterWidth(const std::string& label) const;
+    void outputLine(std::ostream& os, const std::string& label,
+                    CodeBuffer::Offset lineStart, CodeBuffer::Offset lineEnd);
+
+    void writeJSONLine(const Error& error);
+    void writeSARIFResult(const Error& error);
+    void writeRegion(CodeBuffer::Offset start, CodeBuffer::Offset end);
+    void writeExpansions(const Error& error);
 };
 
 #endif
\ No newline at end of file
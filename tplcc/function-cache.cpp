@@ -0,0 +1,297 @@
+#include "function-cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+#include "ir-text.h"
+
+namespace {
+bool hasSymbol(const X86::Operand& operand) {
+  return operand.kind == X86::Operand::Kind::Symbol ||
+         (operand.kind == X86::Operand::Kind::Memory && operand.symbol != 0);
+}
+
+// The start of every function on disk. Code stored by a compiler that
+// stores it differently only misses.
+constexpr std::string_view ENTRY_MAGIC = "tplcc-function 1\n";
+
+// Numbers are stored in the byte order of the machine, the compiler is part
+// of the key anyway.
+template <typename T>
+void put(std::string& out, T value) {
+  if constexpr (std::is_enum_v<T>) {
+    put(out, static_cast<std::underlying_type_t<T>>(value));
+  } else {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+  }
+}
+
+void putString(std::string& out, std::string_view text) {
+  put(out, static_cast<std::uint32_t>(text.size()));
+  out += text;
+}
+
+void put(std::string& out, const X86::Operand& operand) {
+  put(out, operand.kind);
+  put(out, operand.reg);
+  put(out, operand.isExternal);
+  put(out, operand.symbol);
+  put(out, operand.value);
+}
+
+// Reads what put and putString wrote. Once the text ends too early everything read is 0
+// and ok false.
+struct Reader {
+  std::string_view text;
+  bool ok = true;
+
+  template <typename T>
+  T get() {
+    if constexpr (std::is_enum_v<T>) {
+      return static_cast<T>(get<std::underlying_type_t<T>>());
+    } else {
+      T value{};
+      if (text.size() < sizeof(T)) {
+        ok = false;
+        return value;
+      }
+      std::memcpy(&value, text.data(), sizeof(T));
+      text.remove_prefix(sizeof(T));
+      return value;
+    }
+  }
+
+  std::string getString() {
+    const auto size = get<std::uint32_t>();
+    if (text.size() < size) {
+      ok = false;
+      return {};
+    }
+    std::string value(text.substr(0, size));
+    text.remove_prefix(size);
+    return value;
+  }
+
+  X86::Operand getOperand() {
+    X86::Operand operand;
+    operand.kind = get<X86::Operand::Kind>();
+    operand.reg = get<X86::Register>();
+    operand.isExternal = get<bool>();
+    operand.symbol = get<std::uint32_t>();
+    operand.value = get<std::int64_t>();
+    return operand;
+  }
+};
+}  // namespace
+
+ContentHash FunctionCache::fingerprintOf(const Function& function,
+                                         const Module& module, bool optimize) {
+  std::vector<std::uint32_t> symbols{function.symbol};
+  for (ValueID id = 1; id < function.size(); id++) {
+    if (function[id].op == Opcode::Symbol) {
+      symbols.push_back(static_cast<std::uint32_t>(function[id].imm));
+    }
+  }
+  std::sort(symbols.begin(), symbols.end(), [&](auto lhs, auto rhs) {
+    return module[lhs].name < module[rhs].name;
+  });
+
+  ContentHasher hasher;
+  hasher.add(toText(function, module)).add(optimize ? 1 : 0);
+  for (const auto symbol : symbols) {
+    const auto& info = module[symbol];
+    hasher.add(info.name)
+        .add(static_cast<std::uint64_t>(info.isFunction) |
+             static_cast<std::uint64_t>(info.isDefined) << 1 |
+             static_cast<std::uint64_t>(info.isLocal) << 2);
+  }
+  return hasher.finish();
+}
+
+std::optional<MachineFunction> FunctionCache::find(
+    const ContentHash& fingerprint, const Module& module) {
+  {
+    std::shared_lock lock(mutex);
+    if (const auto it = entries.find(fingerprint); it != entries.end()) {
+      return reuse(*it->second, module);
+    }
+  }
+  if (disk == nullptr) return std::nullopt;
+  const auto found = disk->find(diskKeyOf(fingerprint));
+  if (!found) return std::nullopt;
+  auto loaded = deserialize(found->output);
+  if (!loaded) return std::nullopt;
+
+  std::lock_guard lock(mutex);
+  // Another thread may have loaded it too.
+  const auto it = entries.try_emplace(fingerprint, std::move(loaded)).first;
+  return reuse(*it->second, module);
+}
+
+std::optional<MachineFunction> FunctionCache::reuse(Entry& entry,
+                                                    const Module& module) {
+  // The fingerprint has the names of all the symbols, the module has them.
+  std::vector<std::uint32_t> ids(entry.symbols.size());
+  for (std::size_t i = 1; i < entry.symbols.size(); i++) {
+    const auto id = module.findSymbol(entry.symbols[i]);
+    if (!id) return std::nullopt;
+    ids[i] = *id;
+  }
+  const auto self = module.findSymbol(entry.name);
+  if (!self) return std::nullopt;
+
+  MachineFunction function;
+  function.symbol = *self;
+  function.numberOfLabels = entry.numberOfLabels;
+  function.code = entry.code;
+  for (auto& instruction : function.code) {
+    for (auto* operand : {&instruction.destination, &instruction.source}) {
+      if (hasSymbol(*operand)) operand->symbol = ids[operand->symbol];
+    }
+  }
+  entry.lastUsed.store(generation, std::memory_order_relaxed);
+  numberReused.fetch_add(1, std::memory_order_relaxed);
+  return function;
+}
+
+void FunctionCache::store(const ContentHash& fingerprint,
+                          const MachineFunction& function,
+                          const Module& module) {
+  auto entry = std::make_unique<Entry>();
+  entry->numberOfLabels = function.numberOfLabels;
+  entry->name = module[function.symbol].name;
+  entry->symbols.emplace_back();
+  entry->code = function.code;
+  std::unordered_map<std::uint32_t, std::uint32_t> indices;
+  for (auto& instruction : entry->code) {
+    for (auto* operand : {&instruction.destination, &instruction.source}) {
+      if (!hasSymbol(*operand)) continue;
+      const auto [it, isNew] = indices.try_emplace(
+          operand->symbol,
+          static_cast<std::uint32_t>(entry->symbols.size()));
+      if (isNew) entry->symbols.push_back(module[operand->symbol].name);
+      operand->symbol = it->second;
+    }
+  }
+  numberGenerated.fetch_add(1, std::memory_order_relaxed);
+  if (disk != nullptr) {
+    // Only costs a miss later if it can't be written.
+    disk->store(diskKeyOf(fingerprint), {serialize(*entry)});
+  }
+
+  std::lock_guard lock(mutex);
+  entry->lastUsed.store(generation, std::memory_order_relaxed);
+  // Another thread may have stored the same function, the code is the same.
+  entries.try_emplace(fingerprint, std::move(entry));
+}
+
+void FunctionCache::trim(std::size_t maxFunctions) {
+  std::lock_guard lock(mutex);
+  generation++;
+  if (entries.size() <= maxFunctions) return;
+  if (maxFunctions == 0) {
+    entries.clear();
+    return;
+  }
+
+  // The last use of the least recently used function that stays. Of the
+  // functions last used then, only as many as fit stay.
+  std::vector<std::uint64_t> uses;
+  uses.reserve(entries.size());
+  for (const auto& [fingerprint, entry] : entries) {
+    uses.push_back(entry->lastUsed.load(std::memory_order_relaxed));
+  }
+  const auto cut = uses.end() - static_cast<std::ptrdiff_t>(maxFunctions);
+  std::nth_element(uses.begin(), cut, uses.end());
+  const auto oldestKept = *cut;
+  auto numberToForget = entries.size() - maxFunctions;
+  for (const bool isOlder : {true, false}) {
+    for (auto it = entries.begin();
+         it != entries.end() && numberToForget != 0;) {
+      const auto lastUsed =
+          it->second->lastUsed.load(std::memory_order_relaxed);
+      if (isOlder ? lastUsed < oldestKept : lastUsed == oldestKept) {
+        it = entries.erase(it);
+        numberToForget--;
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void FunctionCache::persistIn(const ResultCache* cache, std::string options) {
+  disk = cache;
+  diskOptions = std::move(options);
+}
+
+std::size_t FunctionCache::size() const {
+  std::shared_lock lock(mutex);
+  return entries.size();
+}
+
+FunctionCache::Statistics FunctionCache::statistics() const {
+  return {numberReused.load(std::memory_order_relaxed),
+          numberGenerated.load(std::memory_order_relaxed)};
+}
+
+ContentHash FunctionCache::diskKeyOf(const ContentHash& fingerprint) const {
+  return ResultCache::keyOf(fingerprint.hex(), "function " + diskOptions);
+}
+
+std::string FunctionCache::serialize(const Entry& entry) {
+  std::string text(ENTRY_MAGIC);
+  put(text, entry.numberOfLabels);
+  putString(text, entry.name);
+  put(text, static_cast<std::uint32_t>(entry.symbols.size()));
+  for (const auto& symbol : entry.symbols) putString(text, symbol);
+  put(text, static_cast<std::uint32_t>(entry.code.size()));
+  for (const auto& instruction : entry.code) {
+    put(text, instruction.mnemonic);
+    put(text, instruction.size);
+    put(text, instruction.sourceSize);
+    put(text, instruction.condition);
+    put(text, instruction.destination);
+    put(text, instruction.source);
+  }
+  return text;
+}
+
+std::unique_ptr<FunctionCache::Entry> FunctionCache::deserialize(
+    std::string_view text) {
+  if (!text.starts_with(ENTRY_MAGIC)) return nullptr;
+  Reader reader{text.substr(ENTRY_MAGIC.size())};
+  auto entry = std::make_unique<Entry>();
+  entry->numberOfLabels = reader.get<std::uint32_t>();
+  entry->name = reader.getString();
+  // Every symbol takes 4 bytes at least, and every instruction more, so a
+  // wrong count runs out of text before it allocates much.
+  const auto numberOfSymbols = reader.get<std::uint32_t>();
+  for (std::uint32_t i = 0; i < numberOfSymbols && reader.ok; i++) {
+    entry->symbols.push_back(reader.getString());
+  }
+  const auto numberOfInstructions = reader.get<std::uint32_t>();
+  for (std::uint32_t i = 0; i < numberOfInstructions && reader.ok; i++) {
+    auto& instruction = entry->code.emplace_back();
+    instruction.mnemonic = reader.get<X86::Mnemonic>();
+    instruction.size = reader.get<std::uint8_t>();
+    instruction.sourceSize = reader.get<std::uint8_t>();
+    instruction.condition = reader.get<X86::Condition>();
+    instruction.destination = reader.getOperand();
+    instruction.source = reader.getOperand();
+    for (const auto* operand :
+         {&instruction.destination, &instruction.source}) {
+      if (hasSymbol(*operand) && operand->symbol >= entry->symbols.size()) {
+        return nullptr;
+      }
+    }
+  }
+  if (!reader.ok || !reader.text.empty() || entry->symbols.empty()) {
+    return nullptr;
+  }
+  return entry;
+}
@@ -0,0 +1,111 @@
+#ifndef TPLCC_FUNCTION_CACHE_H
+#define TPLCC_FUNCTION_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "code-generation.h"
+#include "content-hash.h"
+#include "ir.h"
+#include "result-cache.h"
+
+// The machine code of the functions of earlier compilations, by a
+// fingerprint of everything their code is generated from, so compiling a
+// file again only runs the IR passes and the instruction selection for the
+// functions that changed.
+//
+// The fingerprint is taken from the function as lowered: its IR, printed
+// with the names of the symbols instead of their IDs, and, for every symbol
+// it refers to, whether the module defines it and its linkage, which decide
+// how it is addressed. The passes and the instruction selection only read
+// those. Symbol IDs depend on everything lowered before the function, so the
+// cached code refers to symbols by name, and gets the IDs of the module it
+// is used in.
+//
+// The functions can be kept in a result cache on disk too, so a compiler
+// started later, compiling a file that changed, finds the code of the
+// functions that didn't.
+//
+// Safe to share between threads compiling functions at the same time.
+class FunctionCache {
+ public:
+  struct Statistics {
+    // Functions whose code was found, and generated.
+    std::uint64_t reused = 0;
+    std::uint64_t generated = 0;
+  };
+
+ private:
+  struct Entry {
+    std::vector<X86::Instruction> code;
+    std::uint32_t numberOfLabels = 0;
+    // The symbol operands of the code are indices into this, 0 is "none".
+    std::vector<std::string> symbols;
+    std::string name;
+    // The generation it was last found or stored in, see trim.
+    std::atomic<std::uint64_t> lastUsed{0};
+  };
+
+  struct HashOfHash {
+    std::size_t operator()(const ContentHash& hash) const {
+      return static_cast<std::size_t>(hash.low);
+    }
+  };
+
+  std::unordered_map<ContentHash, std::unique_ptr<Entry>, HashOfHash> entries;
+  mutable std::shared_mutex mutex;
+  std::uint64_t generation = 0;
+  // See persistIn.
+  const ResultCache* disk = nullptr;
+  std::string diskOptions;
+  std::atomic<std::uint64_t> numberReused{0};
+  std::atomic<std::uint64_t> numberGenerated{0};
+
+ public:
+  FunctionCache() = default;
+  FunctionCache(const FunctionCache&) = delete;
+  FunctionCache& operator=(const FunctionCache&) = delete;
+
+  // Before the IR passes, with the symbols of the module complete.
+  static ContentHash fingerprintOf(const Function& function,
+                                   const Module& module, bool optimize);
+
+  // The code of the function with the fingerprint, with the symbol IDs of
+  // the module, nullopt if it isn't cached.
+  std::optional<MachineFunction> find(const ContentHash& fingerprint,
+                                      const Module& module);
+  // Keep the code generated for the function with the fingerprint.
+  void store(const ContentHash& fingerprint, const MachineFunction& function,
+             const Module& module);
+
+  // Forget the functions least recently used until at most maxFunctions
+  // are left, and start a new generation. Between compilations, e.g. by
+  // the server, not while one is running.
+  void trim(std::size_t maxFunctions);
+
+  // Store the functions in the cache too, and look the ones that aren't
+  // in memory up there. The options tell what else than the fingerprint
+  // the code depends on, the compiler, see ResultCache::keyOf. Between
+  // compilations, nullptr to stop.
+  void persistIn(const ResultCache* cache, std::string options);
+
+  std::size_t size() const;
+  Statistics statistics() const;
+
+ private:
+  std::optional<MachineFunction> reuse(Entry& entry, const Module& module);
+  ContentHash diskKeyOf(const ContentHash& fingerprint) const;
+  static std::string serialize(const Entry& entry);
+  // nullptr if the text isn't an entry serialize wrote.
+  static std::unique_ptr<Entry> deserialize(std::string_view text);
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "global-value-numbering.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "dominator-tree.h"
+
+namespace {
+// Whether the result of an instruction only depends on what its expression
+// is made of.
+bool isNumbered(const Inst& inst) {
+  if (isBinary(inst.op) || isComparison(inst.op)) return true;
+  switch (inst.op) {
+    case Opcode::Neg:
+    case Opcode::Not:
+    case Opcode::SExt:
+    case Opcode::ZExt:
+    case Opcode::Trunc:
+    case Opcode::Copy:
+      return true;
+    case Opcode::Load:
+      return !(inst.flags & InstFlag::Volatile);
+    default:
+      return false;
+  }
+}
+
+bool isCommutative(Opcode op) {
+  switch (op) {
+    case Opcode::Add:
+    case Opcode::Mul:
+    case Opcode::And:
+    case Opcode::Or:
+    case Opcode::Xor:
+    case Opcode::Eq:
+    case Opcode::Ne:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void combine(std::size_t& hash, std::uint64_t value) {
+  hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+}
+
+class GlobalValueNumbering {
+  Function& function;
+  const DominatorTree tree;
+  std::vector<ValueID> replacements;
+  // Loads are numbered together with the state of memory they read. A new
+  // state begins where memory may have changed.
+  std::vector<std::uint32_t> memoryStates;
+  std::vector<std::uint32_t> exitStates;
+  std::uint32_t numberOfStates = 0;
+
+  struct Hash {
+    const GlobalValueNumbering* pass;
+    std::size_t operator()(ValueID id) const { return pass->hash(id); }
+  };
+  struct Equal {
+    const GlobalValueNumbering* pass;
+    bool operator()(ValueID a, ValueID b) const { return pass->equal(a, b); }
+  };
+  // The expressions available in the block being visited, and the order
+  // they were added in, so leaving a subtree of the dominator tree removes
+  // the ones it added.
+  std::unordered_set<ValueID, Hash, Equal> available;
+  std::vector<ValueID> scope;
+  bool changed = false;
+
+ public:
+  explicit GlobalValueNumbering(Function& function)
+      : function(function),
+        tree(function),
+        replacements(function.size()),
+        memoryStates(function.size()),
+        exitStates(function.numberOfBlocks()),
+        available(0, Hash{this}, Equal{this}) {}
+
+  bool run();
+
+ private:
+  void numberPhis(BlockID id);
+  void visit(BlockID id);
+  std::size_t hash(ValueID id) const;
+  bool equal(ValueID a, ValueID b) const;
+  ValueID resolve(ValueID value) const;
+};
+
+bool GlobalValueNumbering::run() {
+  // Preorder walk of the dominator tree with the number of children of
+  // every block on the stack visited so far and the size of the scope when
+  // it was entered.
+  struct Frame {
+    BlockID id;
+    std::uint32_t next;
+    std::size_t scopeSize;
+  };
+  std::vector<Frame> stack{{Function::ENTRY, 0, 0}};
+  visit(Function::ENTRY);
+  while (!stack.empty()) {
+    auto& frame = stack.back();
+    const auto children = tree.children(frame.id);
+    if (frame.next == children.size()) {
+      while (scope.size() > frame.scopeSize) {
+        available.erase(scope.back());
+        scope.pop_back();
+      }
+      stack.pop_back();
+      continue;
+    }
+    const auto child = children[frame.next++];
+    stack.push_back({child, 0, scope.size()});
+    visit(child);
+  }
+
+  // Phi operands on back edges can refer to values replaced after the phi
+  // was visited, and the blocks that can't be reached weren't visited.
+  for (const auto id : function.liveBlocks()) {
+    const auto& block = function.block(id);
+    for (const auto* list : {&block.phis, &block.insts}) {
+      for (const auto inst : *list) {
+        if (function[inst].op == Opcode::Nop) continue;
+        for (auto& operand : function.operands(inst)) {
+          operand = resolve(operand);
+        }
+      }
+    }
+  }
+  if (changed) function.sweep();
+  return changed;
+}
+
+// Phis are only equal to the phis of the same block, which don't dominate
+// each other, so they are compared with a table of their own.
+void GlobalValueNumbering::numberPhis(BlockID id) {
+  std::map<std::pair<IRType, std::vector<ValueID>>, ValueID> phis;
+  for (const auto phi : function.block(id).phis) {
+    if (function[phi].op != Opcode::Phi) continue;
+    std::vector<ValueID> operands;
+    for (const auto operand : function.operands(phi)) {
+      operands.push_back(resolve(operand));
+    }
+    const auto [it, isNew] =
+        phis.emplace(std::pair{function[phi].type, std::move(operands)}, phi);
+    if (isNew) continue;
+    replacements[phi] = it->second;
+    function.remove(phi);
+    changed = true;
+  }
+}
+
+void GlobalValueNumbering::visit(BlockID id) {
+  numberPhis(id);
+
+  // Memory is what it was at the end of the immediate dominator if that is
+  // the only way in.
+  const auto& block = function.block(id);
+  const auto idom = tree.immediateDominator(id);
+  auto state = block.predecessors.size() == 1 && block.predecessors[0] == idom
+                   ? exitStates[idom]
+                   : ++numberOfStates;
+
+  for (const auto inst : block.insts) {
+    if (function[inst].op == Opcode::Nop) continue;
+    // The operands dominate the instruction, so they were visited already.
+    for (auto& operand : function.operands(inst)) operand = resolve(operand);
+
+    const auto& value = function[inst];
+    if (value.op == Opcode::Load && isNumbered(value)) {
+      memoryStates[inst] = state;
+    } else if (hasSideEffects(value) && !isTerminator(value.op)) {
+      state = ++numberOfStates;
+    }
+    if (!isNumbered(value)) continue;
+
+    const auto [it, isNew] = available.insert(inst);
+    if (isNew) {
+      scope.push_back(inst);
+      continue;
+    }
+    replacements[inst] = *it;
+    function.remove(inst);
+    changed = true;
+  }
+  exitStates[id] = state;
+}
+
+std::size_t GlobalValueNumbering::hash(ValueID id) const {
+  const auto& inst = function[id];
+  std::size_t result = static_cast<std::size_t>(inst.op);
+  combine(result, static_cast<std::uint64_t>(inst.type));
+  combine(result, inst.flags);
+  combine(result, inst.imm);
+  combine(result, memoryStates[id]);
+  const auto operands = function.operands(id);
+  if (isCommutative(inst.op)) {
+    combine(result, std::min(operands[0], operands[1]));
+    combine(result, std::max(operands[0], operands[1]));
+  } else {
+    for (const auto operand : operands) combine(result, operand);
+  }
+  return result;
+}
+
+bool GlobalValueNumbering::equal(ValueID a, ValueID b) const {
+  const auto& first = function[a];
+  const auto& second = function[b];
+  if (first.op != second.op || first.type != second.type ||
+      first.flags != second.flags || first.imm != second.imm ||
+      memoryStates[a] != memoryStates[b]) {
+    return false;
+  }
+  const auto left = function.operands(a);
+  const auto right = function.operands(b);
+  if (std::equal(left.begin(), left.end(), right.begin(), right.end())) {
+    return true;
+  }
+  return isCommutative(first.op) && left[0] == right[1] && left[1] == right[0];
+}
+
+// Replacements are always values that weren't replaced themselves.
+ValueID GlobalValueNumbering::resolve(ValueID value) const {
+  return value < replacements.size() && replacements[value] != 0
+             ? replacements[value]
+             : value;
+}
+}  // namespace
+
+bool numberGlobalValues(Function& function) {
+  return GlobalValueNumbering(function).run();
+}
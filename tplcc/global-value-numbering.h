@@ -0,0 +1,21 @@
+#ifndef TPLCC_GLOBAL_VALUE_NUMBERING_H
+#define TPLCC_GLOBAL_VALUE_NUMBERING_H
+
+#include "ir.h"
+
+// Remove the instructions that compute a value an instruction dominating
+// them already computed, e.g. the address arithmetic and loads of a
+// p->a.b[i] that a macro expands many times. The dominator tree is walked
+// in preorder with a scoped hash table of the expressions of the
+// instructions that dominate the current one (its opcode, type, flags,
+// immediate and operands, sorted for commutative operators), so an
+// expression is only found where its first computation is available.
+//
+// A load is only equal to another one if no store, call or volatile load
+// can come between them: within a block, or down the dominator tree into a
+// block whose only predecessor is its immediate dominator. Phis are equal
+// if they are in the same block and have the same operands. Returns whether
+// the function changed.
+bool numberGlobalValues(Function& function);
+
+#endif
@@ -0,0 +1,247 @@
+#include "include-files.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+namespace {
+// The directory part of a path, with the trailing separator, empty if the
+// path has none.
+std::string_view directoryOf(std::string_view path) {
+  const auto separator = path.find_last_of("/\\");
+  return separator == std::string_view::npos ? std::string_view()
+                                             : path.substr(0, separator + 1);
+}
+
+bool isAbsolute(std::string_view path) {
+  return !path.empty() && (path[0] == '/' || path[0] == '\\' ||
+                           (path.size() > 1 && path[1] == ':'));
+}
+
+std::string join(std::string_view directory, std::string_view name) {
+  std::string path(directory);
+  if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+    path.push_back('/');
+  }
+  path += name;
+  return path;
+}
+bool isIdentifierCharacter(char ch) {
+  return ch == '_' || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+         (ch >= '0' && ch <= '9');
+}
+
+// Reads the content the way the preprocessor sees the structure of its
+// conditional directives, no more: directives start lines, comments and
+// literals can't hide them or be mistaken for them.
+class GuardScanner {
+  std::string_view text;
+  std::size_t pos = 0;
+
+ public:
+  explicit GuardScanner(std::string_view text) : text(text) {}
+
+  bool reachedEnd() const { return pos >= text.size(); }
+
+  // Skip spaces, comments and line splices, on this line only unless
+  // acrossLines. False if a comment doesn't end.
+  bool skipBlanks(bool acrossLines) {
+    while (pos < text.size()) {
+      const char ch = text[pos];
+      if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\f' ||
+          ch == '\v' || (ch == '\n' && acrossLines)) {
+        pos++;
+      } else if (ch == '\\' && (startsWith("\\\n") ||
+                                 startsWith("\\\r\n"))) {
+        pos = text.find('\n', pos) + 1;
+      } else if (startsWith("/*")) {
+        const auto end = text.find("*/", pos + 2);
+        if (end == std::string_view::npos) return false;
+        pos = end + 2;
+      } else if (startsWith("//")) {
+        skipLineComment();
+      } else {
+        break;
+      }
+    }
+    return true;
+  }
+
+  bool skip(std::string_view expected) {
+    if (!startsWith(expected)) return false;
+    pos += expected.size();
+    return true;
+  }
+
+  std::string_view identifier() {
+    const auto start = pos;
+    while (pos < text.size() && isIdentifierCharacter(text[pos])) pos++;
+    return text.substr(start, pos - start);
+  }
+
+  // Whether nothing but blanks is left on the line.
+  bool isAtEndOfLine() {
+    return skipBlanks(false) && (reachedEnd() || text[pos] == '\n');
+  }
+
+  // Skip to the start of the next line with a directive, false if there is
+  // none. Literals are skipped whole.
+  bool skipToNextDirective() {
+    bool isAtLineStart = false;
+    while (skipBlanks(false) && pos < text.size()) {
+      const char ch = text[pos];
+      if (ch == '\n') {
+        isAtLineStart = true;
+        pos++;
+        continue;
+      }
+      if (ch == '#' && isAtLineStart) return true;
+      isAtLineStart = false;
+      pos++;
+      if (ch == '"' || ch == '\'') {
+        while (pos < text.size() && text[pos] != ch && text[pos] != '\n') {
+          pos += text[pos] == '\\' ? 2 : 1;
+        }
+        if (pos < text.size() && text[pos] == ch) pos++;
+      }
+    }
+    return false;
+  }
+
+ private:
+  bool startsWith(std::string_view prefix) const {
+    return pos <= text.size() && text.substr(pos).starts_with(prefix);
+  }
+
+  // Up to the end of the line, which a splice moves to the next one.
+  void skipLineComment() {
+    for (;;) {
+      const auto end = text.find('\n', pos);
+      if (end == std::string_view::npos) {
+        pos = text.size();
+        return;
+      }
+      pos = end;
+      const auto beforeEnd = text.substr(0, end);
+      if (!beforeEnd.ends_with('\\') && !beforeEnd.ends_with("\\\r")) return;
+      pos = end + 1;
+    }
+  }
+};
+}  // namespace
+
+std::string includeGuardOf(std::string_view content) {
+  GuardScanner scanner(content);
+  std::string_view guard;
+  if (!scanner.skipBlanks(true) || !scanner.skip("#") ||
+      !scanner.skipBlanks(false)) {
+    return {};
+  }
+  const auto directive = scanner.identifier();
+  scanner.skipBlanks(false);
+  if (directive == "ifndef") {
+    guard = scanner.identifier();
+  } else if (directive == "if" && scanner.skip("!") &&
+             scanner.skipBlanks(false) && scanner.identifier() == "defined" &&
+             scanner.skipBlanks(false)) {
+    const bool hasParenthesis = scanner.skip("(");
+    scanner.skipBlanks(false);
+    guard = scanner.identifier();
+    scanner.skipBlanks(false);
+    if (hasParenthesis && !scanner.skip(")")) return {};
+  }
+  if (guard.empty() || !scanner.isAtEndOfLine()) return {};
+
+  for (int depth = 1; depth > 0;) {
+    if (!scanner.skipToNextDirective()) return {};
+    scanner.skip("#");
+    scanner.skipBlanks(false);
+    const auto name = scanner.identifier();
+    if (name == "if" || name == "ifdef" || name == "ifndef") {
+      depth++;
+    } else if (name == "endif") {
+      depth--;
+    } else if ((name == "else" || name == "elif") && depth == 1) {
+      return {};
+    }
+  }
+  // Only blanks after the #endif of the guard.
+  if (!scanner.isAtEndOfLine() || !scanner.skipBlanks(true) ||
+      !scanner.reachedEnd()) {
+    return {};
+  }
+  return std::string(guard);
+}
+
+std::optional<IIncludeFiles::File> IncludeFiles::find(
+    std::string_view name, bool isAngled, std::string_view includer) {
+  auto found = [](std::string path, const FileCache::File* file) {
+    return File{std::move(path), file->content, file->includeGuard};
+  };
+
+  if (isAbsolute(name)) {
+    std::string path(name);
+    if (const auto content = cache.read(path)) {
+      return found(std::move(path), content);
+    }
+    return std::nullopt;
+  }
+  if (!isAngled) {
+    auto path = join(directoryOf(includer.empty() ? sourceFile : includer),
+                     name);
+    if (const auto content = cache.read(path)) {
+      return found(std::move(path), content);
+    }
+  }
+  for (const auto& directory : directories) {
+    auto path = join(directory, name);
+    if (const auto content = cache.read(path)) {
+      return found(std::move(path), content);
+    }
+  }
+  return std::nullopt;
+}
+
+const FileCache::File* FileCache::read(const std::string& path) {
+  // Relative paths are the same file only in the same working directory,
+  // which the server changes from one compilation to the next.
+  std::error_code error;
+  const auto absolute = std::filesystem::absolute(path, error).string();
+  const auto& key = error ? path : absolute;
+  {
+    std::shared_lock lock(mutex);
+    if (const auto it = files.find(key); it != files.end()) {
+      return it->second.get();
+    }
+  }
+
+  // Read without the lock, so other threads can look up the files they
+  // need meanwhile. If two threads read the same file, the first one to
+  // take the lock again wins, the contents are the same.
+  std::unique_ptr<File> file;
+  if (std::ifstream stream(path, std::ios::binary); stream) {
+    file = std::make_unique<File>();
+    // Taken before reading, a change while reading is seen next time.
+    file->modified = std::filesystem::last_write_time(path, error);
+    std::ostringstream content;
+    content << stream.rdbuf();
+    file->content = std::move(content).str();
+    file->includeGuard = includeGuardOf(file->content);
+  }
+  std::lock_guard lock(mutex);
+  return files.try_emplace(key, std::move(file)).first->second.get();
+}
+
+void FileCache::forgetChangedFiles() {
+  std::lock_guard lock(mutex);
+  std::erase_if(files, [](const auto& entry) {
+    const auto& [path, file] = entry;
+    if (file == nullptr) return true;
+    std::error_code error;
+    const auto size = std::filesystem::file_size(path, error);
+    if (error || size != file->content.size()) return true;
+    return std::filesystem::last_write_time(path, error) != file->modified ||
+           error;
+  });
+}
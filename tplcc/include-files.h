@@ -0,0 +1,92 @@
+#ifndef TPLCC_INCLUDE_FILES_H
+#define TPLCC_INCLUDE_FILES_H
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Where the preprocessor gets the files named by #include from.
+struct IIncludeFiles {
+  struct File {
+    std::string path;
+    // Owned by the IIncludeFiles, valid as long as it is.
+    std::string_view content;
+    // The macro the whole file is in #ifndef of, see includeGuardOf, empty
+    // if there is none or it isn't known.
+    std::string_view includeGuard;
+  };
+
+  // The file an #include names, as "name" or as <name> if isAngled. The
+  // includer is the path of the file with the directive, empty if it's the
+  // source file given to the preprocessor. nullopt if there is no such file.
+  virtual std::optional<File> find(std::string_view name, bool isAngled,
+                                   std::string_view includer) = 0;
+  virtual ~IIncludeFiles() = default;
+};
+
+// The macro NAME if all of the content, apart from spaces and comments, is
+// in one "#ifndef NAME" or "#if !defined(NAME)" group without #else or
+// #elif, so including it again while NAME is defined adds nothing. Empty if
+// there is no such macro, or the content is too unusual to tell.
+std::string includeGuardOf(std::string_view content);
+
+// The contents of files read from disk, kept for as long as the cache is, so
+// headers included again (by every file of a project, or twice in one file)
+// cost a lookup in a map. Safe to share between threads compiling different
+// files at the same time, a file is only read once.
+class FileCache {
+ public:
+  struct File {
+    std::string content;
+    // See includeGuardOf.
+    std::string includeGuard;
+    std::filesystem::file_time_type modified;
+  };
+
+ private:
+  // Files by absolute path, nullptr if the path has no readable file.
+  std::unordered_map<std::string, std::unique_ptr<const File>> files;
+  mutable std::shared_mutex mutex;
+
+ public:
+  FileCache() = default;
+  FileCache(const FileCache&) = delete;
+  FileCache& operator=(const FileCache&) = delete;
+
+  // The file, nullptr if it can't be read. Valid as long as the cache is,
+  // or until forgetChangedFiles forgets it.
+  const File* read(const std::string& path);
+
+  // Forget the files that changed on disk since they were read, and the
+  // paths that couldn't be read, so the next read sees them as they are
+  // now. For a cache kept from one compilation to the next, e.g. by the
+  // server. Not while the cache is used.
+  void forgetChangedFiles();
+};
+
+// Looks for included files on disk, like -I does: "name" first in the
+// directory of the file that includes it, then, like <name>, in the include
+// directories in order. There are no system directories, the front end
+// can't take the system's headers.
+class IncludeFiles : public IIncludeFiles {
+  std::string sourceFile;
+  std::vector<std::string> directories;
+  FileCache& cache;
+
+ public:
+  IncludeFiles(std::string sourceFile, std::vector<std::string> directories,
+               FileCache& cache)
+      : sourceFile(std::move(sourceFile)),
+        directories(std::move(directories)),
+        cache(cache) {}
+
+  std::optional<File> find(std::string_view name, bool isAngled,
+                           std::string_view includer) override;
+};
+
+#endif
@@ -0,0 +1,927 @@
+#include "ir-text.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/* Printer */
+
+namespace {
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+class Printer {
+  const Function& function;
+  const Module& module;
+  std::string& out;
+  // Numbers in the text, 0 for none, otherwise the number plus one.
+  std::vector<std::uint32_t> valueNumbers;
+  std::vector<std::uint32_t> blockNumbers;
+
+ public:
+  Printer(const Function& function, const Module& module, std::string& out)
+      : function(function),
+        module(module),
+        out(out),
+        valueNumbers(function.size()),
+        blockNumbers(function.numberOfBlocks()) {}
+
+  void print() {
+    const auto blocks = function.liveBlocks();
+    std::uint32_t next = 0;
+    for (const auto param : function.parameters()) {
+      valueNumbers[param] = ++next;
+    }
+    for (const auto id : blocks) {
+      const auto& block = function.block(id);
+      for (const auto* list : {&block.phis, &block.insts}) {
+        for (const auto inst : *list) {
+          if (function[inst].op != Opcode::Nop &&
+              function[inst].type != IRType::Void) {
+            valueNumbers[inst] = ++next;
+          }
+        }
+      }
+    }
+    for (std::uint32_t i = 0; i < blocks.size(); i++) {
+      blockNumbers[blocks[i]] = i + 1;
+    }
+
+    const auto& symbol = module[function.symbol];
+    if (symbol.isLocal) out += "static ";
+    out += "function ";
+    out += typeSpelling(function.returnType);
+    out += " @";
+    out += symbol.name;
+    out += '(';
+    const auto params = function.parameters();
+    for (std::size_t i = 0; i < params.size(); i++) {
+      if (i != 0) out += ", ";
+      out += typeSpelling(function[params[i]].type);
+      out += ' ';
+      value(params[i]);
+    }
+    if (function.isVariadic) out += params.empty() ? "..." : ", ...";
+    out += ") {\n";
+
+    for (const auto id : blocks) {
+      const auto& block = function.block(id);
+      blockName(id);
+      out += ":\n";
+      for (const auto* list : {&block.phis, &block.insts}) {
+        for (const auto inst : *list) {
+          if (function[inst].op != Opcode::Nop) instruction(inst);
+        }
+      }
+    }
+    out += "}\n";
+  }
+
+ private:
+  void blockName(BlockID id) {
+    out += 'b';
+    out += std::to_string(blockNumbers[id] - 1);
+  }
+
+  void value(ValueID id) {
+    if (valueNumbers[id] != 0) {
+      out += '%';
+      out += std::to_string(valueNumbers[id] - 1);
+    } else {
+      // A removed value, or one without a result; the verifier complains
+      // about those.
+      out += "%!";
+      out += std::to_string(id);
+    }
+  }
+
+  void operand(ValueID id) {
+    const auto& inst = function[id];
+    if (inst.op == Opcode::Const) {
+      out += typeSpelling(inst.type);
+      out += ' ';
+      out += std::to_string(inst.signedImm());
+    } else if (inst.op == Opcode::Symbol) {
+      out += '@';
+      out += module[static_cast<std::uint32_t>(inst.imm)].name;
+    } else {
+      value(id);
+    }
+  }
+
+  void operandList(std::span<const ValueID> operands) {
+    for (std::size_t i = 0; i < operands.size(); i++) {
+      if (i != 0) out += ", ";
+      operand(operands[i]);
+    }
+  }
+
+  void instruction(ValueID id) {
+    const auto& inst = function[id];
+    const auto operands = function.operands(id);
+    const auto& block = function.block(inst.block);
+
+    out += "  ";
+    if (valueNumbers[id] != 0) {
+      value(id);
+      out += " = ";
+    }
+    out += opcodeSpelling(inst.op);
+
+    switch (inst.op) {
+      case Opcode::Alloca:
+        out += ' ';
+        out += std::to_string(inst.imm);
+        out += ", ";
+        out += std::to_string(inst.flags);
+        break;
+      case Opcode::Load:
+        if (inst.flags & InstFlag::Volatile) out += " volatile";
+        out += ' ';
+        out += typeSpelling(inst.type);
+        out += ' ';
+        operandList(operands);
+        break;
+      case Opcode::Store:
+        if (inst.flags & InstFlag::Volatile) out += " volatile";
+        out += ' ';
+        operandList(operands);
+        break;
+      case Opcode::Call:
+        if (inst.flags & InstFlag::Variadic) out += " variadic";
+        out += ' ';
+        out += typeSpelling(inst.type);
+        out += ' ';
+        operand(operands[0]);
+        out += '(';
+        operandList(operands.subspan(1));
+        out += ')';
+        break;
+      case Opcode::Phi:
+        out += ' ';
+        out += typeSpelling(inst.type);
+        for (std::size_t i = 0; i < operands.size(); i++) {
+          out += i == 0 ? " [" : ", [";
+          operand(operands[i]);
+          out += ", ";
+          if (i < block.predecessors.size()) {
+            blockName(block.predecessors[i]);
+          } else {
+            out += '?';
+          }
+          out += ']';
+        }
+        break;
+      case Opcode::Jump:
+      case Opcode::Branch:
+        out += ' ';
+        if (!operands.empty()) {
+          operandList(operands);
+          out += ", ";
+        }
+        for (std::size_t i = 0; i < block.numberOfSuccessors; i++) {
+          if (i != 0) out += ", ";
+          blockName(block.successorArray[i]);
+        }
+        break;
+      case Opcode::Ret:
+      case Opcode::Unreachable:
+        if (!operands.empty()) out += ' ';
+        operandList(operands);
+        break;
+      default:
+        out += ' ';
+        out += typeSpelling(inst.type);
+        out += ' ';
+        operandList(operands);
+        break;
+    }
+    out += '\n';
+  }
+};
+
+void printGlobal(const GlobalData& global, const Module& module,
+                 std::string& out) {
+  const auto& symbol = module[global.symbol];
+  if (symbol.isLocal) out += "static ";
+  out += "global @";
+  out += symbol.name;
+  out += ", size ";
+  out += std::to_string(global.size);
+  out += ", align ";
+  out += std::to_string(global.align);
+  if (global.isReadOnly) out += ", readonly";
+  if (!global.bytes.empty()) {
+    out += ", bytes \"";
+    for (const auto c : global.bytes) {
+      const auto byte = static_cast<unsigned char>(c);
+      if (byte >= 0x20 && byte < 0x7F && c != '"' && c != '\\') {
+        out += c;
+      } else {
+        out += '\\';
+        out += HEX_DIGITS[byte >> 4];
+        out += HEX_DIGITS[byte & 0xF];
+      }
+    }
+    out += '"';
+  }
+  for (const auto& relocation : global.relocations) {
+    out += ", reloc ";
+    out += std::to_string(relocation.offset);
+    out += " @";
+    out += module[relocation.symbol].name;
+    if (relocation.addend != 0) {
+      out += relocation.addend < 0 ? " - " : " + ";
+      // Negate as unsigned so INT64_MIN survives.
+      const auto magnitude =
+          relocation.addend < 0
+              ? 0 - static_cast<std::uint64_t>(relocation.addend)
+              : static_cast<std::uint64_t>(relocation.addend);
+      out += std::to_string(magnitude);
+    }
+  }
+  out += '\n';
+}
+}  // namespace
+
+std::string toText(const Function& function, const Module& module) {
+  std::string out;
+  Printer(function, module, out).print();
+  return out;
+}
+
+std::string toText(const Module& module) {
+  std::string out;
+  for (std::uint32_t id = 1; id < module.numberOfSymbols(); id++) {
+    const auto& symbol = module[id];
+    if (symbol.isDefined) continue;
+    out += symbol.isFunction ? "extern function @" : "extern @";
+    out += symbol.name;
+    out += '\n';
+  }
+  for (const auto& global : module.globals) printGlobal(global, module, out);
+  for (const auto& function : module.functions) {
+    if (!out.empty()) out += '\n';
+    Printer(function, module, out).print();
+  }
+  return out;
+}
+
+/* Parser */
+
+namespace {
+enum class TokenKind : std::uint8_t {
+  Identifier,  // also block names and keywords
+  Value,       // %name
+  Global,      // @name
+  Number,
+  String,
+  Punctuator,
+  Ellipsis,
+  EndOfLine,
+  EndOfInput,
+};
+
+struct TextToken {
+  TokenKind kind;
+  std::string_view text;  // without the sigil or the quotes
+  CodeBuffer::Offset start;
+  CodeBuffer::Offset end;
+};
+
+bool isNameChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+std::optional<IRType> typeNamed(std::string_view name) {
+  for (const auto type : {IRType::Void, IRType::I8, IRType::I16, IRType::I32,
+                          IRType::I64, IRType::Ptr}) {
+    if (name == typeSpelling(type)) return type;
+  }
+  return std::nullopt;
+}
+
+std::optional<Opcode> opcodeNamed(std::string_view name) {
+  for (auto op = static_cast<int>(Opcode::Add);
+       op <= static_cast<int>(Opcode::Unreachable); op++) {
+    if (name == opcodeSpelling(static_cast<Opcode>(op))) {
+      return static_cast<Opcode>(op);
+    }
+  }
+  return std::nullopt;
+}
+
+class TextParser {
+  // An operand whose value may not be known yet: either the value, or the
+  // name of a value defined later in the function.
+  struct PendingOperand {
+    ValueID value = 0;
+    const TextToken* name = nullptr;
+  };
+  struct Fixup {
+    ValueID user;
+    std::uint32_t index;
+    const TextToken* name;
+  };
+  struct PendingPhi {
+    ValueID phi;
+    std::vector<std::pair<PendingOperand, BlockID>> incoming;
+    const TextToken* start;
+  };
+
+  std::string_view text;
+  Module& module;
+  IReportError& errOut;
+  std::vector<TextToken> tokens;
+  std::size_t position = 0;
+
+  // The state of the function being parsed.
+  Function* function = nullptr;
+  std::unordered_map<std::string_view, ValueID> values;
+  std::unordered_map<std::string_view, BlockID> blocks;
+  std::vector<Fixup> fixups;
+  std::vector<PendingPhi> phis;
+
+ public:
+  TextParser(std::string_view text, Module& module, IReportError& errOut)
+      : text(text), module(module), errOut(errOut) {}
+
+  bool parse() {
+    if (!tokenize()) return false;
+    for (;;) {
+      skipEmptyLines();
+      if (peek().kind == TokenKind::EndOfInput) return true;
+      if (!item()) return false;
+    }
+  }
+
+ private:
+  bool tokenize() {
+    std::size_t i = 0;
+    const auto add = [&](TokenKind kind, std::size_t start, std::size_t end,
+                         std::string_view content) {
+      tokens.push_back({kind, content, static_cast<CodeBuffer::Offset>(start),
+                        static_cast<CodeBuffer::Offset>(end)});
+    };
+    while (i < text.size()) {
+      const auto start = i;
+      const auto c = text[i];
+      if (c == '\n') {
+        add(TokenKind::EndOfLine, i, i + 1, text.substr(i, 1));
+        i++;
+      } else if (c == ' ' || c == '\t' || c == '\r') {
+        i++;
+      } else if (c == ';') {
+        while (i < text.size() && text[i] != '\n') i++;
+      } else if (c == '%' || c == '@') {
+        i++;
+        while (i < text.size() && (isNameChar(text[i]) || text[i] == '!')) i++;
+        if (i == start + 1) return fail(start, i, "Expected a name here.");
+        add(c == '%' ? TokenKind::Value : TokenKind::Global, start, i,
+            text.substr(start + 1, i - start - 1));
+      } else if ((c >= '0' && c <= '9') ||
+                 (c == '-' && i + 1 < text.size() && text[i + 1] >= '0' &&
+                  text[i + 1] <= '9')) {
+        i++;
+        while (i < text.size() && text[i] >= '0' && text[i] <= '9') i++;
+        add(TokenKind::Number, start, i, text.substr(start, i - start));
+      } else if (text.substr(i, 3) == "...") {
+        i += 3;
+        add(TokenKind::Ellipsis, start, i, text.substr(start, 3));
+      } else if (isNameChar(c)) {
+        while (i < text.size() && isNameChar(text[i])) i++;
+        add(TokenKind::Identifier, start, i, text.substr(start, i - start));
+      } else if (c == '"') {
+        i++;
+        while (i < text.size() && text[i] != '"' && text[i] != '\n') i++;
+        if (i == text.size() || text[i] != '"') {
+          return fail(start, i, "Unterminated string.");
+        }
+        i++;
+        add(TokenKind::String, start, i, text.substr(start + 1, i - start - 2));
+      } else if (std::string_view(",()[]{}=:+-").find(c) !=
+                 std::string_view::npos) {
+        i++;
+        add(TokenKind::Punctuator, start, i, text.substr(start, 1));
+      } else {
+        return fail(start, start + 1,
+                    "Unexpected \"" + std::string(1, c) + "\".");
+      }
+    }
+    add(TokenKind::EndOfLine, text.size(), text.size(), {});
+    add(TokenKind::EndOfInput, text.size(), text.size(), {});
+    return true;
+  }
+
+  /* Helpers */
+
+  const TextToken& peek(std::size_t ahead = 0) const {
+    return tokens[std::min(position + ahead, tokens.size() - 1)];
+  }
+  const TextToken& take() {
+    const auto& token = peek();
+    if (token.kind != TokenKind::EndOfInput) position++;
+    return token;
+  }
+
+  bool fail(std::size_t start, std::size_t end, std::string_view message) {
+    errOut.reportsError(Error({static_cast<CodeBuffer::Offset>(start),
+                               static_cast<CodeBuffer::Offset>(end)},
+                              message));
+    return false;
+  }
+  bool fail(const TextToken& at, std::string_view message) {
+    return fail(at.start, at.end, message);
+  }
+  bool unexpected() {
+    const auto& token = peek();
+    if (token.kind == TokenKind::EndOfLine ||
+        token.kind == TokenKind::EndOfInput) {
+      return fail(token, "Unexpected end of line.");
+    }
+    return fail(token, "Unexpected \"" +
+                           std::string(text.substr(token.start,
+                                                   token.end - token.start)) +
+                           "\".");
+  }
+
+  bool isPunctuator(char c, std::size_t ahead = 0) const {
+    return peek(ahead).kind == TokenKind::Punctuator &&
+           peek(ahead).text[0] == c;
+  }
+  bool isKeyword(std::string_view keyword) const {
+    return peek().kind == TokenKind::Identifier && peek().text == keyword;
+  }
+  bool acceptPunctuator(char c) {
+    if (!isPunctuator(c)) return false;
+    take();
+    return true;
+  }
+  bool acceptKeyword(std::string_view keyword) {
+    if (!isKeyword(keyword)) return false;
+    take();
+    return true;
+  }
+  bool expectPunctuator(char c) {
+    return acceptPunctuator(c) ||
+           fail(peek(), "Expected \"" + std::string(1, c) + "\" here.");
+  }
+  bool expectKeyword(std::string_view keyword) {
+    return acceptKeyword(keyword) ||
+           fail(peek(), "Expected \"" + std::string(keyword) + "\" here.");
+  }
+  bool expectEndOfLine() {
+    if (peek().kind != TokenKind::EndOfLine) return unexpected();
+    take();
+    return true;
+  }
+  void skipEmptyLines() {
+    while (peek().kind == TokenKind::EndOfLine) take();
+  }
+
+  std::optional<IRType> type() {
+    if (peek().kind == TokenKind::Identifier) {
+      if (const auto type = typeNamed(peek().text)) {
+        take();
+        return type;
+      }
+    }
+    fail(peek(), "Expected a type here.");
+    return std::nullopt;
+  }
+
+  std::optional<std::uint64_t> number() {
+    const auto& token = peek();
+    if (token.kind != TokenKind::Number) {
+      fail(token, "Expected a number here.");
+      return std::nullopt;
+    }
+    const auto isNegative = token.text[0] == '-';
+    const auto digits = token.text.substr(isNegative ? 1 : 0);
+    std::uint64_t value = 0;
+    const auto [end, ec] =
+        std::from_chars(digits.data(), digits.data() + digits.size(), value);
+    if (digits.empty() || ec != std::errc() ||
+        end != digits.data() + digits.size()) {
+      fail(token, "Invalid number.");
+      return std::nullopt;
+    }
+    take();
+    return isNegative ? 0 - value : value;
+  }
+
+  /* Module items */
+
+  bool item() {
+    if (acceptKeyword("extern")) {
+      const auto isFunction = acceptKeyword("function");
+      if (peek().kind != TokenKind::Global) return unexpected();
+      auto& symbol = module[module.symbol(take().text)];
+      symbol.isFunction = isFunction;
+      return expectEndOfLine();
+    }
+    const auto isLocal = acceptKeyword("static");
+    if (acceptKeyword("global")) return global(isLocal);
+    if (isKeyword("function")) return functionDefinition(isLocal);
+    return unexpected();
+  }
+
+  bool global(bool isLocal) {
+    if (peek().kind != TokenKind::Global) return unexpected();
+    GlobalData global;
+    global.symbol = define(take().text, false, isLocal);
+
+    if (!expectPunctuator(',') || !expectKeyword("size")) return false;
+    const auto size = number();
+    if (!size || !expectPunctuator(',') || !expectKeyword("align")) {
+      return false;
+    }
+    const auto align = number();
+    if (!align) return false;
+    global.size = *size;
+    global.align = static_cast<std::uint32_t>(*align);
+
+    while (acceptPunctuator(',')) {
+      if (acceptKeyword("readonly")) {
+        global.isReadOnly = true;
+      } else if (acceptKeyword("bytes")) {
+        if (peek().kind != TokenKind::String) return unexpected();
+        if (!decodeBytes(take(), global.bytes)) return false;
+      } else if (acceptKeyword("reloc")) {
+        const auto offset = number();
+        if (!offset) return false;
+        if (peek().kind != TokenKind::Global) return unexpected();
+        const auto symbol = module.symbol(take().text);
+        std::int64_t addend = 0;
+        const auto isNegative = isPunctuator('-');
+        if (acceptPunctuator('+') || acceptPunctuator('-')) {
+          const auto value = number();
+          if (!value) return false;
+          addend = static_cast<std::int64_t>(isNegative ? 0 - *value : *value);
+        }
+        global.relocations.push_back({*offset, symbol, addend});
+      } else {
+        return unexpected();
+      }
+    }
+    module.globals.push_back(std::move(global));
+    return expectEndOfLine();
+  }
+
+  bool decodeBytes(const TextToken& token, std::string& bytes) {
+    const auto hexValue = [](char c) -> int {
+      if (c >= '0' && c <= '9') return c - '0';
+      if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+      if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+      return -1;
+    };
+    const auto& content = token.text;
+    for (std::size_t i = 0; i < content.size(); i++) {
+      if (content[i] != '\\') {
+        bytes += content[i];
+        continue;
+      }
+      const auto high = i + 1 < content.size() ? hexValue(content[i + 1]) : -1;
+      const auto low = i + 2 < content.size() ? hexValue(content[i + 2]) : -1;
+      if (high < 0 || low < 0) {
+        const auto at = token.start + 1 + i;
+        return fail(at, at + 1, "Expected two hex digits after \"\\\".");
+      }
+      bytes += static_cast<char>(high * 16 + low);
+      i += 2;
+    }
+    return true;
+  }
+
+  std::uint32_t define(std::string_view name, bool isFunction, bool isLocal) {
+    const auto id = module.symbol(name);
+    auto& symbol = module[id];
+    symbol.isFunction = isFunction;
+    symbol.isDefined = true;
+    symbol.isLocal = isLocal;
+    return id;
+  }
+
+  /* Functions */
+
+  bool functionDefinition(bool isLocal) {
+    const auto& header = take();
+    module.functions.emplace_back();
+    function = &module.functions.back();
+    values.clear();
+    blocks.clear();
+    fixups.clear();
+    phis.clear();
+
+    const auto returnType = type();
+    if (!returnType) return false;
+    function->returnType = *returnType;
+    if (peek().kind != TokenKind::Global) return unexpected();
+    function->symbol = define(take().text, true, isLocal);
+
+    if (!expectPunctuator('(')) return false;
+    if (!isPunctuator(')')) {
+      do {
+        if (peek().kind == TokenKind::Ellipsis) {
+          take();
+          function->isVariadic = true;
+          break;
+        }
+        const auto paramType = type();
+        if (!paramType) return false;
+        if (peek().kind != TokenKind::Value) return unexpected();
+        if (!defineValue(take(), function->addParam(*paramType))) {
+          return false;
+        }
+      } while (acceptPunctuator(','));
+    }
+    if (!expectPunctuator(')') || !expectPunctuator('{') ||
+        !expectEndOfLine()) {
+      return false;
+    }
+
+    if (!collectBlocks()) return false;
+    BlockID current = 0;
+    for (;;) {
+      skipEmptyLines();
+      if (acceptPunctuator('}')) break;
+      if (peek().kind == TokenKind::EndOfInput) return unexpected();
+      if (peek().kind == TokenKind::Identifier && isPunctuator(':', 1)) {
+        current = blocks[take().text];
+        take();
+        if (!expectEndOfLine()) return false;
+        continue;
+      }
+      if (current == 0) return fail(peek(), "Expected a block name here.");
+      if (!instruction(current)) return false;
+    }
+    if (!resolveOperands()) return false;
+
+    std::string problem;
+    if (!verify(*function, &problem)) return fail(header, problem);
+    return expectEndOfLine();
+  }
+
+  // Create the blocks in the order of their labels, so branches can go to
+  // blocks that come later.
+  bool collectBlocks() {
+    const auto start = position;
+    bool atLineStart = true;
+    while (peek().kind != TokenKind::EndOfInput &&
+           !(atLineStart && isPunctuator('}'))) {
+      if (atLineStart && peek().kind == TokenKind::Identifier &&
+          isPunctuator(':', 1)) {
+        const auto& label = peek();
+        if (blocks.contains(label.text)) {
+          return fail(label, "Redefinition of block " +
+                                 std::string(label.text) + ".");
+        }
+        blocks.emplace(label.text, function->addBlock());
+      }
+      atLineStart = take().kind == TokenKind::EndOfLine;
+    }
+    position = start;
+    return true;
+  }
+
+  bool defineValue(const TextToken& name, ValueID id) {
+    if (!values.emplace(name.text, id).second) {
+      return fail(name, "Redefinition of %" + std::string(name.text) + ".");
+    }
+    return true;
+  }
+
+  std::optional<BlockID> blockReference() {
+    const auto& token = peek();
+    if (token.kind == TokenKind::Identifier) {
+      if (const auto it = blocks.find(token.text); it != blocks.end()) {
+        take();
+        return it->second;
+      }
+    }
+    fail(token, "Expected a block name here.");
+    return std::nullopt;
+  }
+
+  std::optional<PendingOperand> operand() {
+    const auto& token = peek();
+    if (token.kind == TokenKind::Value) {
+      take();
+      return PendingOperand{0, &token};
+    }
+    if (token.kind == TokenKind::Global) {
+      take();
+      return PendingOperand{
+          function->symbolAddress(module.symbol(token.text)), nullptr};
+    }
+    const auto constantType = type();
+    if (!constantType) return std::nullopt;
+    const auto bits = number();
+    if (!bits) return std::nullopt;
+    return PendingOperand{function->constant(*constantType, *bits), nullptr};
+  }
+
+  bool operandList(std::vector<PendingOperand>& operands, char end) {
+    if (isPunctuator(end) || (end == '\n' && peek().kind == TokenKind::EndOfLine)) {
+      return true;
+    }
+    do {
+      const auto next = operand();
+      if (!next) return false;
+      operands.push_back(*next);
+    } while (acceptPunctuator(','));
+    return true;
+  }
+
+  ValueID append(BlockID block, Opcode op, IRType type,
+                 const std::vector<PendingOperand>& operands,
+                 std::uint64_t imm = 0, std::uint16_t flags = 0) {
+    std::vector<ValueID> ids;
+    for (const auto& operand : operands) ids.push_back(operand.value);
+    const auto id = function->append(block, op, type, ids, imm, flags);
+    for (std::uint32_t i = 0; i < operands.size(); i++) {
+      if (operands[i].name) fixups.push_back({id, i, operands[i].name});
+    }
+    return id;
+  }
+
+  bool instruction(BlockID block) {
+    const TextToken* result = nullptr;
+    if (peek().kind == TokenKind::Value && isPunctuator('=', 1)) {
+      result = &take();
+      take();
+    }
+    const auto& name = peek();
+    const auto op = name.kind == TokenKind::Identifier ? opcodeNamed(name.text)
+                                                       : std::nullopt;
+    if (!op) return fail(name, "Expected an instruction here.");
+    take();
+
+    if (function->terminator(block) != 0) {
+      return fail(name, "The block has ended already.");
+    }
+
+    ValueID id = 0;
+    std::vector<PendingOperand> operands;
+    switch (*op) {
+      case Opcode::Alloca: {
+        const auto size = number();
+        if (!size || !expectPunctuator(',')) return false;
+        const auto align = number();
+        if (!align) return false;
+        id = append(block, *op, IRType::Ptr, operands, *size,
+                    static_cast<std::uint16_t>(*align));
+        break;
+      }
+      case Opcode::Load:
+      case Opcode::Store: {
+        const auto flags = acceptKeyword("volatile") ? InstFlag::Volatile : 0;
+        auto resultType = IRType::Void;
+        if (*op == Opcode::Load) {
+          const auto loaded = type();
+          if (!loaded) return false;
+          resultType = *loaded;
+        }
+        if (!operandList(operands, '\n')) return false;
+        if (operands.size() != (*op == Opcode::Load ? 1u : 2u)) {
+          return fail(name, "Wrong number of operands.");
+        }
+        id = append(block, *op, resultType, operands, 0, flags);
+        break;
+      }
+      case Opcode::Call: {
+        const auto flags = acceptKeyword("variadic") ? InstFlag::Variadic : 0;
+        const auto resultType = type();
+        if (!resultType) return false;
+        const auto callee = operand();
+        if (!callee) return false;
+        operands.push_back(*callee);
+        if (!expectPunctuator('(') || !operandList(operands, ')') ||
+            !expectPunctuator(')')) {
+          return false;
+        }
+        id = append(block, *op, *resultType, operands, 0, flags);
+        break;
+      }
+      case Opcode::Phi: {
+        const auto phiType = type();
+        if (!phiType) return false;
+        id = function->addPhi(block, *phiType);
+        PendingPhi pending{id, {}, &name};
+        while (acceptPunctuator('[')) {
+          const auto value = operand();
+          if (!value || !expectPunctuator(',')) return false;
+          const auto from = blockReference();
+          if (!from || !expectPunctuator(']')) return false;
+          pending.incoming.emplace_back(*value, *from);
+          if (!acceptPunctuator(',')) break;
+        }
+        phis.push_back(std::move(pending));
+        break;
+      }
+      case Opcode::Jump: {
+        const auto target = blockReference();
+        if (!target) return false;
+        function->jump(block, *target);
+        break;
+      }
+      case Opcode::Branch: {
+        const auto condition = operand();
+        if (!condition || !expectPunctuator(',')) return false;
+        const auto ifTrue = blockReference();
+        if (!ifTrue || !expectPunctuator(',')) return false;
+        const auto ifFalse = blockReference();
+        if (!ifFalse) return false;
+        function->branch(block, condition->value, *ifTrue, *ifFalse);
+        if (condition->name) {
+          fixups.push_back({function->terminator(block), 0, condition->name});
+        }
+        break;
+      }
+      case Opcode::Ret:
+      case Opcode::Unreachable: {
+        // Neither has successors, so they need nothing from terminate().
+        if (!operandList(operands, '\n')) return false;
+        if (operands.size() > (*op == Opcode::Ret ? 1u : 0u)) {
+          return fail(name, "Wrong number of operands.");
+        }
+        id = append(block, *op, IRType::Void, operands);
+        break;
+      }
+      default: {
+        const auto resultType = type();
+        if (!resultType || !operandList(operands, '\n')) return false;
+        const auto expected = isBinary(*op) || isComparison(*op) ? 2u : 1u;
+        if (operands.size() != expected) {
+          return fail(name, "Wrong number of operands.");
+        }
+        id = append(block, *op, *resultType, operands);
+        break;
+      }
+    }
+
+    const auto hasResult = id != 0 && (*function)[id].type != IRType::Void;
+    if (result && !hasResult) {
+      return fail(*result, "The instruction has no result.");
+    }
+    if (!result && hasResult) {
+      return fail(name, "Expected a name for the result.");
+    }
+    if (result && !defineValue(*result, id)) return false;
+    return expectEndOfLine();
+  }
+
+  std::optional<ValueID> resolve(const PendingOperand& operand) {
+    if (!operand.name) return operand.value;
+    const auto it = values.find(operand.name->text);
+    if (it == values.end()) {
+      fail(*operand.name,
+           "Undefined value %" + std::string(operand.name->text) + ".");
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  bool resolveOperands() {
+    for (const auto& fixup : fixups) {
+      const auto value = resolve({0, fixup.name});
+      if (!value) return false;
+      function->operands(fixup.user)[fixup.index] = *value;
+    }
+
+    // The operands of a phi have to follow the order of the predecessors,
+    // which is only known once all terminators have been read.
+    for (auto& pending : phis) {
+      const auto block = (*function)[pending.phi].block;
+      for (const auto predecessor : function->block(block).predecessors) {
+        const auto it = std::find_if(
+            pending.incoming.begin(), pending.incoming.end(),
+            [&](const auto& incoming) { return incoming.second == predecessor; });
+        if (it == pending.incoming.end()) {
+          return fail(*pending.start,
+                      "The phi has no operand for every predecessor.");
+        }
+        const auto value = resolve(it->first);
+        if (!value) return false;
+        function->addPhiOperand(pending.phi, *value);
+        // The same predecessor can come twice, from the two edges of a
+        // branch; every entry is used once.
+        pending.incoming.erase(it);
+      }
+      if (!pending.incoming.empty()) {
+        return fail(*pending.start,
+                    "The phi has an operand for a block that isn't a "
+                    "predecessor.");
+      }
+    }
+    return true;
+  }
+};
+}  // namespace
+
+bool parseModule(std::string_view text, Module& module, IReportError& errOut) {
+  return TextParser(text, module, errOut).parse();
+}
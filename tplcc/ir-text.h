@@ -0,0 +1,44 @@
+#ifndef TPLCC_IR_TEXT_H
+#define TPLCC_IR_TEXT_H
+
+#include <string>
+#include <string_view>
+
+#include "error.h"
+#include "ir.h"
+
+// A textual form of the IR, so passes can be tested on hand-written input and
+// their output compared as text. One line per item:
+//
+//   extern function @printf
+//   static global @s, size 6, align 1, readonly, bytes "hello"
+//   global @p, size 8, align 8, reloc 0 @s + 1
+//
+//   function i32 @f(i32 %0, ptr %1, ...) {
+//   b0:
+//     %2 = add i32 %0, i32 1
+//     %3 = slt i32 %2, i32 10
+//     br %3, b1, b2
+//   b1:
+//     %4 = phi i32 [%2, b0], [%5, b1]
+//     %5 = load i32 %1
+//     ...
+//
+// An operand is a value (%name), the address of a symbol (@name) or a
+// constant, written with its type. Instructions give the type of their
+// result, for comparisons always i32. Anything after a ';' is a comment.
+//
+// The printer numbers the values and the live blocks from 0 in the order they
+// appear, so two functions print the same when they only differ in IDs and
+// removed instructions. The parser accepts any names and uses before
+// definitions; the operands of a phi can be in any order.
+
+std::string toText(const Function& function, const Module& module);
+std::string toText(const Module& module);
+
+// Add the functions, globals and symbols in the text to the module. Reports
+// the first syntax error or the first function that doesn't verify (at its
+// header), with ranges that are offsets into the text.
+bool parseModule(std::string_view text, Module& module, IReportError& errOut);
+
+#endif
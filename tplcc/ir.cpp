@@ -0,0 +1,480 @@
+#include "ir.h"
+
+#include <algorithm>
+
+std::uint32_t sizeOf(IRType type) {
+  switch (type) {
+    case IRType::Void: return 0;
+    case IRType::I8: return 1;
+    case IRType::I16: return 2;
+    case IRType::I32: return 4;
+    case IRType::I64:
+    case IRType::Ptr: return 8;
+  }
+  return 0;
+}
+
+const char* typeSpelling(IRType type) {
+  switch (type) {
+    case IRType::Void: return "void";
+    case IRType::I8: return "i8";
+    case IRType::I16: return "i16";
+    case IRType::I32: return "i32";
+    case IRType::I64: return "i64";
+    case IRType::Ptr: return "ptr";
+  }
+  return "";
+}
+
+const char* opcodeSpelling(Opcode op) {
+  switch (op) {
+    case Opcode::Nop: return "nop";
+    case Opcode::Const: return "const";
+    case Opcode::Param: return "param";
+    case Opcode::Symbol: return "symbol";
+    case Opcode::Add: return "add";
+    case Opcode::Sub: return "sub";
+    case Opcode::Mul: return "mul";
+    case Opcode::SDiv: return "sdiv";
+    case Opcode::UDiv: return "udiv";
+    case Opcode::SRem: return "srem";
+    case Opcode::URem: return "urem";
+    case Opcode::And: return "and";
+    case Opcode::Or: return "or";
+    case Opcode::Xor: return "xor";
+    case Opcode::Shl: return "shl";
+    case Opcode::LShr: return "lshr";
+    case Opcode::AShr: return "ashr";
+    case Opcode::Eq: return "eq";
+    case Opcode::Ne: return "ne";
+    case Opcode::SLt: return "slt";
+    case Opcode::SLe: return "sle";
+    case Opcode::SGt: return "sgt";
+    case Opcode::SGe: return "sge";
+    case Opcode::ULt: return "ult";
+    case Opcode::ULe: return "ule";
+    case Opcode::UGt: return "ugt";
+    case Opcode::UGe: return "uge";
+    case Opcode::Neg: return "neg";
+    case Opcode::Not: return "not";
+    case Opcode::SExt: return "sext";
+    case Opcode::ZExt: return "zext";
+    case Opcode::Trunc: return "trunc";
+    case Opcode::Copy: return "copy";
+    case Opcode::Alloca: return "alloca";
+    case Opcode::Load: return "load";
+    case Opcode::Store: return "store";
+    case Opcode::Call: return "call";
+    case Opcode::Phi: return "phi";
+    case Opcode::Jump: return "jmp";
+    case Opcode::Branch: return "br";
+    case Opcode::Ret: return "ret";
+    case Opcode::Unreachable: return "unreachable";
+  }
+  return "";
+}
+
+bool isTerminator(Opcode op) { return op >= Opcode::Jump; }
+
+bool isBinary(Opcode op) { return op >= Opcode::Add && op <= Opcode::AShr; }
+
+bool isComparison(Opcode op) { return op >= Opcode::Eq && op <= Opcode::UGe; }
+
+bool hasSideEffects(const Inst& inst) {
+  switch (inst.op) {
+    case Opcode::Store:
+    case Opcode::Call:
+      return true;
+    case Opcode::Load:
+      return inst.flags & InstFlag::Volatile;
+    default:
+      return isTerminator(inst.op);
+  }
+}
+
+/* Function */
+
+Function::Function() {
+  insts.emplace_back();
+  blocks.emplace_back();
+  blocks[0].isRemoved = true;
+}
+
+BlockID Function::addBlock() {
+  blocks.emplace_back();
+  return static_cast<BlockID>(blocks.size() - 1);
+}
+
+ValueID Function::addParam(IRType type) {
+  Inst inst;
+  inst.op = Opcode::Param;
+  inst.type = type;
+  inst.imm = params.size();
+  const auto id = addInst(inst, {});
+  params.push_back(id);
+  return id;
+}
+
+ValueID Function::constant(IRType type, std::uint64_t bits) {
+  // Sign-extend from the width of the type, so -1 is the same constant
+  // however it was computed.
+  const auto width = sizeOf(type) * 8;
+  if (width != 0 && width < 64) {
+    const auto shift = 64 - width;
+    bits = static_cast<std::uint64_t>(static_cast<std::int64_t>(bits << shift) >>
+                                      shift);
+  }
+
+  auto& table = constants[static_cast<std::size_t>(type)];
+  if (const auto it = table.find(bits); it != table.end()) return it->second;
+
+  Inst inst;
+  inst.op = Opcode::Const;
+  inst.type = type;
+  inst.imm = bits;
+  const auto id = addInst(inst, {});
+  table.emplace(bits, id);
+  return id;
+}
+
+ValueID Function::symbolAddress(std::uint32_t symbol) {
+  if (const auto it = symbols.find(symbol); it != symbols.end()) {
+    return it->second;
+  }
+  Inst inst;
+  inst.op = Opcode::Symbol;
+  inst.type = IRType::Ptr;
+  inst.imm = symbol;
+  const auto id = addInst(inst, {});
+  symbols.emplace(symbol, id);
+  return id;
+}
+
+ValueID Function::append(BlockID block, Opcode op, IRType type,
+                         std::span<const ValueID> operands, std::uint64_t imm,
+                         std::uint16_t flags) {
+  Inst inst;
+  inst.op = op;
+  inst.type = type;
+  inst.flags = flags;
+  inst.block = block;
+  inst.imm = imm;
+  const auto id = addInst(inst, operands);
+  blocks[block].insts.push_back(id);
+  return id;
+}
+
+ValueID Function::addPhi(BlockID block, IRType type) {
+  Inst inst;
+  inst.op = Opcode::Phi;
+  inst.type = type;
+  inst.block = block;
+  const auto id = addInst(inst, {});
+  blocks[block].phis.push_back(id);
+  return id;
+}
+
+void Function::addPhiOperand(ValueID phi, ValueID value) {
+  auto& inst = insts[phi];
+  // The operands have to stay contiguous, so they move to the end of the
+  // pool unless they are there already. The old copy is left as garbage,
+  // phis rarely grow after their block is filled.
+  if (inst.firstOperand + inst.numberOfOperands != operandPool.size()) {
+    const auto first = static_cast<std::uint32_t>(operandPool.size());
+    for (std::uint32_t i = 0; i < inst.numberOfOperands; i++) {
+      operandPool.push_back(operandPool[inst.firstOperand + i]);
+    }
+    inst.firstOperand = first;
+  }
+  operandPool.push_back(value);
+  inst.numberOfOperands++;
+}
+
+void Function::jump(BlockID from, BlockID to) {
+  const BlockID targets[] = {to};
+  terminate(from, Opcode::Jump, {}, targets);
+}
+
+void Function::branch(BlockID from, ValueID condition, BlockID ifTrue,
+                      BlockID ifFalse) {
+  const ValueID operands[] = {condition};
+  const BlockID targets[] = {ifTrue, ifFalse};
+  terminate(from, Opcode::Branch, operands, targets);
+}
+
+void Function::ret(BlockID from, ValueID value) {
+  if (value == 0) {
+    terminate(from, Opcode::Ret, {}, {});
+  } else {
+    const ValueID operands[] = {value};
+    terminate(from, Opcode::Ret, operands, {});
+  }
+}
+
+void Function::unreachable(BlockID from) {
+  terminate(from, Opcode::Unreachable, {}, {});
+}
+
+ValueID Function::terminator(BlockID id) const {
+  const auto& list = blocks[id].insts;
+  if (list.empty()) return 0;
+  const auto last = list.back();
+  return isTerminator(insts[last].op) ? last : 0;
+}
+
+void Function::redirectEdge(BlockID from, BlockID oldTarget,
+                            BlockID newTarget) {
+  auto& block = blocks[from];
+  for (std::uint8_t i = 0; i < block.numberOfSuccessors; i++) {
+    if (block.successorArray[i] != oldTarget) continue;
+    block.successorArray[i] = newTarget;
+    removePredecessor(oldTarget, from);
+    blocks[newTarget].predecessors.push_back(from);
+    return;
+  }
+}
+
+void Function::removePredecessor(BlockID id, BlockID predecessor) {
+  auto& block = blocks[id];
+  const auto it = std::find(block.predecessors.begin(),
+                            block.predecessors.end(), predecessor);
+  if (it == block.predecessors.end()) return;
+  const auto index = static_cast<std::uint32_t>(it - block.predecessors.begin());
+  block.predecessors.erase(it);
+
+  for (const auto phi : block.phis) {
+    auto& inst = insts[phi];
+    if (inst.op != Opcode::Phi || index >= inst.numberOfOperands) continue;
+    const auto first = operandPool.begin() + inst.firstOperand;
+    std::copy(first + index + 1, first + inst.numberOfOperands, first + index);
+    inst.numberOfOperands--;
+  }
+}
+
+void Function::simplifyBranch(BlockID from, BlockID target) {
+  auto& block = blocks[from];
+  const auto other = block.successorArray[0] == target
+                         ? block.successorArray[1]
+                         : block.successorArray[0];
+  removePredecessor(other, from);
+  block.successorArray = {target, 0};
+  block.numberOfSuccessors = 1;
+
+  auto& inst = insts[terminator(from)];
+  inst.op = Opcode::Jump;
+  inst.numberOfOperands = 0;
+}
+
+BlockID Function::splitEdge(BlockID from, BlockID to) {
+  const auto middle = addBlock();
+  append(middle, Opcode::Jump, IRType::Void);
+  blocks[middle].successorArray[0] = to;
+  blocks[middle].numberOfSuccessors = 1;
+  blocks[middle].predecessors.push_back(from);
+
+  auto& block = blocks[from];
+  *std::find(block.successorArray.begin(),
+             block.successorArray.begin() + block.numberOfSuccessors, to) =
+      middle;
+  auto& predecessors = blocks[to].predecessors;
+  *std::find(predecessors.begin(), predecessors.end(), from) = middle;
+  return middle;
+}
+
+void Function::removeBlock(BlockID id) {
+  auto& block = blocks[id];
+  for (const auto phi : block.phis) remove(phi);
+  for (const auto inst : block.insts) remove(inst);
+  for (std::uint8_t i = 0; i < block.numberOfSuccessors; i++) {
+    removePredecessor(block.successorArray[i], id);
+  }
+  block.numberOfSuccessors = 0;
+  block.isRemoved = true;
+}
+
+void Function::sweep() {
+  const auto isRemoved = [this](ValueID id) {
+    return insts[id].op == Opcode::Nop;
+  };
+  for (auto& block : blocks) {
+    std::erase_if(block.phis, isRemoved);
+    std::erase_if(block.insts, isRemoved);
+  }
+}
+
+std::vector<BlockID> Function::liveBlocks() const {
+  std::vector<BlockID> live;
+  for (BlockID id = 1; id < blocks.size(); id++) {
+    if (!blocks[id].isRemoved) live.push_back(id);
+  }
+  return live;
+}
+
+ValueID Function::addInst(const Inst& inst, std::span<const ValueID> operands) {
+  const auto id = static_cast<ValueID>(insts.size());
+  insts.push_back(inst);
+  insts.back().firstOperand = static_cast<std::uint32_t>(operandPool.size());
+  insts.back().numberOfOperands = static_cast<std::uint32_t>(operands.size());
+  operandPool.insert(operandPool.end(), operands.begin(), operands.end());
+  return id;
+}
+
+void Function::terminate(BlockID from, Opcode op,
+                         std::span<const ValueID> operands,
+                         std::span<const BlockID> targets) {
+  append(from, op, IRType::Void, operands);
+  auto& block = blocks[from];
+  block.numberOfSuccessors = static_cast<std::uint8_t>(targets.size());
+  for (std::size_t i = 0; i < targets.size(); i++) {
+    block.successorArray[i] = targets[i];
+    blocks[targets[i]].predecessors.push_back(from);
+  }
+}
+
+/* UseLists */
+
+UseLists::UseLists(const Function& function) {
+  starts.assign(function.size() + 1, 0);
+
+  // Count the uses of every value, turn the counts into the starts of the
+  // lists, then fill the lists in.
+  const auto forEachUser = [&](auto&& visit) {
+    for (const auto id : function.liveBlocks()) {
+      const auto& block = function.block(id);
+      for (const auto phi : block.phis) visit(phi);
+      for (const auto inst : block.insts) visit(inst);
+    }
+  };
+  forEachUser([&](ValueID user) {
+    if (function[user].op == Opcode::Nop) return;
+    for (const auto operand : function.operands(user)) starts[operand + 1]++;
+  });
+  for (std::size_t i = 1; i < starts.size(); i++) starts[i] += starts[i - 1];
+
+  uses.resize(starts.back());
+  std::vector<std::uint32_t> cursors(starts.begin(), starts.end() - 1);
+  forEachUser([&](ValueID user) {
+    if (function[user].op == Opcode::Nop) return;
+    const auto operands = function.operands(user);
+    for (std::uint32_t i = 0; i < operands.size(); i++) {
+      uses[cursors[operands[i]]++] = {user, i};
+    }
+  });
+}
+
+/* Module */
+
+Module::Module() { symbolList.emplace_back(); }
+
+std::uint32_t Module::symbol(std::string_view name) {
+  const std::string key(name);
+  if (const auto it = symbolIndex.find(key); it != symbolIndex.end()) {
+    return it->second;
+  }
+  const auto id = static_cast<std::uint32_t>(symbolList.size());
+  symbolList.push_back({key});
+  symbolIndex.emplace(key, id);
+  return id;
+}
+
+std::optional<std::uint32_t> Module::findSymbol(std::string_view name) const {
+  const auto it = symbolIndex.find(std::string(name));
+  if (it == symbolIndex.end()) return std::nullopt;
+  return it->second;
+}
+
+/* Verifier */
+
+namespace {
+std::string blockName(BlockID id) { return "b" + std::to_string(id); }
+std::string valueName(ValueID id) { return "%" + std::to_string(id); }
+}  // namespace
+
+bool verify(const Function& function, std::string* problem) {
+  const auto fail = [&](std::string description) {
+    if (problem) *problem = std::move(description);
+    return false;
+  };
+  const auto isLiveValue = [&](ValueID id) {
+    if (id == 0 || id >= function.size()) return false;
+    const auto& inst = function[id];
+    return inst.op != Opcode::Nop &&
+           (inst.block == 0 || !function.block(inst.block).isRemoved);
+  };
+
+  for (const auto id : function.liveBlocks()) {
+    const auto& block = function.block(id);
+    const auto name = blockName(id);
+
+    if (block.insts.empty() || function.terminator(id) == 0) {
+      return fail(name + " has no terminator.");
+    }
+    const auto& last = function[block.insts.back()];
+    const std::size_t expectedSuccessors = last.op == Opcode::Jump     ? 1
+                                           : last.op == Opcode::Branch ? 2
+                                                                       : 0;
+    if (block.numberOfSuccessors != expectedSuccessors) {
+      return fail(name + " has " + std::to_string(block.numberOfSuccessors) +
+                  " successor(s) for a " + opcodeSpelling(last.op) + ".");
+    }
+
+    for (const auto successor : block.successors()) {
+      const auto& target = function.block(successor);
+      const auto edges = std::count(block.successors().begin(),
+                                    block.successors().end(), successor);
+      if (target.isRemoved ||
+          std::count(target.predecessors.begin(), target.predecessors.end(),
+                     id) != edges) {
+        return fail("The edge from " + name + " to " + blockName(successor) +
+                    " is not in its predecessors.");
+      }
+    }
+    for (const auto predecessor : block.predecessors) {
+      const auto successors = function.block(predecessor).successors();
+      if (function.block(predecessor).isRemoved ||
+          std::find(successors.begin(), successors.end(), id) ==
+              successors.end()) {
+        return fail(blockName(predecessor) + " is a predecessor of " + name +
+                    " but doesn't branch to it.");
+      }
+    }
+
+    for (const auto phi : block.phis) {
+      if (function[phi].op != Opcode::Phi || function[phi].block != id) {
+        return fail(valueName(phi) + " in the phis of " + name +
+                    " is not a phi of the block.");
+      }
+      if (function.operands(phi).size() != block.predecessors.size()) {
+        return fail("The phi " + valueName(phi) + " has " +
+                    std::to_string(function.operands(phi).size()) +
+                    " operand(s) for " +
+                    std::to_string(block.predecessors.size()) +
+                    " predecessor(s).");
+      }
+    }
+
+    for (std::size_t i = 0; i < block.insts.size(); i++) {
+      const auto& inst = function[block.insts[i]];
+      if (inst.op == Opcode::Nop || inst.op == Opcode::Phi ||
+          inst.block != id) {
+        return fail(valueName(block.insts[i]) +
+                    " doesn't belong in the instructions of " + name + ".");
+      }
+      if (isTerminator(inst.op) && i + 1 != block.insts.size()) {
+        return fail(name + " has a terminator before its end.");
+      }
+    }
+
+    for (const auto* list : {&block.phis, &block.insts}) {
+      for (const auto user : *list) {
+        for (const auto operand : function.operands(user)) {
+          if (!isLiveValue(operand)) {
+            return fail(valueName(user) + " uses " + valueName(operand) +
+                        ", which is not a value.");
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,319 @@
+#ifndef TPLCC_IR_H
+#define TPLCC_IR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The intermediate representation between the AST and machine code, in SSA
+// form. Like the AST it is stored in a few contiguous arrays and refers to
+// its parts by 32-bit indices, 0 meaning "none":
+//
+// - Every value is an Inst in Function::insts, whether it is computed by an
+//   instruction or not: constants, parameters and the addresses of symbols
+//   are Insts that don't belong to a block.
+// - The operands of all instructions of a function are in one array, an
+//   Inst only knows where its operands start and how many there are.
+// - A Block lists its instructions in order, phis separately so they can be
+//   added while the block is being filled, see addPhi.
+//
+// Only integers and pointers are represented so far.
+
+using ValueID = std::uint32_t;
+using BlockID = std::uint32_t;
+
+enum class IRType : std::uint8_t { Void, I8, I16, I32, I64, Ptr };
+
+// Size in bytes, the width of a Ptr is that of I64.
+std::uint32_t sizeOf(IRType type);
+const char* typeSpelling(IRType type);
+
+enum class Opcode : std::uint8_t {
+  // Removed from its block, see Function::remove.
+  Nop,
+
+  // Values that don't belong to a block. imm is the value of a Const,
+  // sign-extended from its type, the index of a Param and the symbol of a
+  // Symbol (its address).
+  Const,
+  Param,
+  Symbol,
+
+  // Binary operators, on operands of the type of the result. An I64 can be
+  // added to or subtracted from a pointer.
+  Add,
+  Sub,
+  Mul,
+  SDiv,
+  UDiv,
+  SRem,
+  URem,
+  And,
+  Or,
+  Xor,
+  Shl,
+  LShr,
+  AShr,
+
+  // Comparisons give an I32 that is 0 or 1.
+  Eq,
+  Ne,
+  SLt,
+  SLe,
+  SGt,
+  SGe,
+  ULt,
+  ULe,
+  UGt,
+  UGe,
+
+  // Unary operators. Copy gives its operand in the type of the result, which
+  // has the same size, e.g. a pointer as an I64.
+  Neg,
+  Not,
+  SExt,
+  ZExt,
+  Trunc,
+  Copy,
+
+  // Memory. Alloca reserves imm bytes aligned to flags in the stack frame
+  // and gives the address. Load reads the type of the result from its
+  // operand, Store writes operand 0 to the address in operand 1.
+  Alloca,
+  Load,
+  Store,
+
+  // Operand 0 is the callee, the rest are the arguments.
+  Call,
+
+  // One operand for every predecessor of the block, in the same order.
+  Phi,
+
+  // Terminators. The targets of Jump and Branch are the successors of the
+  // block, Branch goes to the first one if its operand isn't 0.
+  Jump,
+  Branch,
+  Ret,
+  Unreachable,
+};
+
+const char* opcodeSpelling(Opcode op);
+bool isTerminator(Opcode op);
+bool isBinary(Opcode op);
+bool isComparison(Opcode op);
+
+namespace InstFlag {
+constexpr std::uint16_t Variadic = 1 << 0;  // Call
+constexpr std::uint16_t Volatile = 1 << 0;  // Load, Store
+}  // namespace InstFlag
+
+struct Inst {
+  Opcode op = Opcode::Nop;
+  IRType type = IRType::Void;
+  // The alignment of an Alloca, InstFlags otherwise.
+  std::uint16_t flags = 0;
+  BlockID block = 0;
+  std::uint32_t firstOperand = 0;
+  std::uint32_t numberOfOperands = 0;
+  std::uint64_t imm = 0;
+
+  std::int64_t signedImm() const { return static_cast<std::int64_t>(imm); }
+};
+
+static_assert(sizeof(Inst) == 24);
+
+// Whether the instruction does more than computing its result, so it has to
+// stay even if nothing uses the result.
+bool hasSideEffects(const Inst& inst);
+
+struct Block {
+  std::vector<ValueID> phis;
+  // The terminator is the last one once the block is complete.
+  std::vector<ValueID> insts;
+  std::vector<BlockID> predecessors;
+  std::array<BlockID, 2> successorArray{};
+  std::uint8_t numberOfSuccessors = 0;
+  bool isRemoved = false;
+
+  std::span<const BlockID> successors() const {
+    return {successorArray.data(), numberOfSuccessors};
+  }
+};
+
+class Function {
+  std::vector<Inst> insts;
+  std::vector<ValueID> operandPool;
+  std::vector<Block> blocks;
+  std::vector<ValueID> params;
+  std::array<std::unordered_map<std::uint64_t, ValueID>, 6> constants;
+  std::unordered_map<std::uint32_t, ValueID> symbols;
+
+ public:
+  // The symbol of the function in its Module.
+  std::uint32_t symbol = 0;
+  IRType returnType = IRType::Void;
+  bool isVariadic = false;
+
+  Function();
+
+  const Inst& operator[](ValueID id) const { return insts[id]; }
+  Inst& operator[](ValueID id) { return insts[id]; }
+  // Number of values, including the "no value" at index 0.
+  std::size_t size() const { return insts.size(); }
+
+  const Block& block(BlockID id) const { return blocks[id]; }
+  Block& block(BlockID id) { return blocks[id]; }
+  // Number of blocks, including the "no block" at index 0. The entry block
+  // is block 1.
+  std::size_t numberOfBlocks() const { return blocks.size(); }
+  static constexpr BlockID ENTRY = 1;
+
+  std::span<const ValueID> parameters() const { return params; }
+
+  std::span<const ValueID> operands(ValueID id) const {
+    return {operandPool.data() + insts[id].firstOperand,
+            insts[id].numberOfOperands};
+  }
+  std::span<ValueID> operands(ValueID id) {
+    return {operandPool.data() + insts[id].firstOperand,
+            insts[id].numberOfOperands};
+  }
+
+  BlockID addBlock();
+  ValueID addParam(IRType type);
+
+  // Constants and symbols are created once per function, so equal ones have
+  // the same ID.
+  ValueID constant(IRType type, std::uint64_t bits);
+  ValueID symbolAddress(std::uint32_t symbol);
+
+  // Append an instruction to the block.
+  ValueID append(BlockID block, Opcode op, IRType type,
+                 std::span<const ValueID> operands = {},
+                 std::uint64_t imm = 0, std::uint16_t flags = 0);
+
+  // Add a phi to the start of the block, its operands are added one by one
+  // as the predecessors become known.
+  ValueID addPhi(BlockID block, IRType type);
+  void addPhiOperand(ValueID phi, ValueID value);
+
+  // Terminate the block. They record the edges of the CFG.
+  void jump(BlockID from, BlockID to);
+  void branch(BlockID from, ValueID condition, BlockID ifTrue,
+              BlockID ifFalse);
+  void ret(BlockID from, ValueID value = 0);
+  void unreachable(BlockID from);
+
+  // The terminator of a block, 0 if it hasn't got one yet.
+  ValueID terminator(BlockID id) const;
+
+  // Change the target of the edge from a block to one of its successors.
+  // Phi operands are left to the caller.
+  void redirectEdge(BlockID from, BlockID oldTarget, BlockID newTarget);
+  // Remove the edge from a block to one of its successors from the list of
+  // predecessors of the successor, along with the phi operands for it.
+  void removePredecessor(BlockID block, BlockID predecessor);
+  // Turn the Branch that ends a block into a Jump to one of its targets. The
+  // edge to the other one is removed.
+  void simplifyBranch(BlockID from, BlockID target);
+  // Put a new block that only jumps on on the edge from a block to one of
+  // its successors. It takes the place of the block among the predecessors
+  // of the successor, so the phi operands stay where they are.
+  BlockID splitEdge(BlockID from, BlockID to);
+
+  // Mark an instruction removed. The lists of the blocks keep it until
+  // sweep() is called, so passes can remove instructions while they walk
+  // those lists.
+  void remove(ValueID id) { insts[id].op = Opcode::Nop; }
+  void removeBlock(BlockID id);
+  void sweep();
+
+  // The live blocks, in the order they were added.
+  std::vector<BlockID> liveBlocks() const;
+
+ private:
+  ValueID addInst(const Inst& inst, std::span<const ValueID> operands);
+  void terminate(BlockID from, Opcode op, std::span<const ValueID> operands,
+                 std::span<const BlockID> targets);
+};
+
+// The users of every value, built in one pass over a function and stored in
+// one array: the uses of value v are uses[starts[v]] to uses[starts[v + 1]].
+// They have to be built again once the function changes.
+class UseLists {
+ public:
+  struct Use {
+    ValueID user;
+    std::uint32_t index;
+  };
+
+ private:
+  std::vector<std::uint32_t> starts;
+  std::vector<Use> uses;
+
+ public:
+  explicit UseLists(const Function& function);
+
+  std::span<const Use> of(ValueID id) const {
+    return {uses.data() + starts[id], starts[id + 1] - starts[id]};
+  }
+};
+
+struct Symbol {
+  std::string name;
+  bool isFunction = false;
+  bool isDefined = false;
+  // Has internal linkage.
+  bool isLocal = false;
+};
+
+// The initial content of a global variable or a string literal. The bytes
+// after the end of bytes are 0, the relocations write the address of a
+// symbol plus an addend at an offset.
+struct GlobalData {
+  struct Relocation {
+    std::uint64_t offset;
+    std::uint32_t symbol;
+    std::int64_t addend;
+  };
+
+  std::uint32_t symbol = 0;
+  std::uint64_t size = 0;
+  std::uint32_t align = 1;
+  bool isReadOnly = false;
+  std::string bytes;
+  std::vector<Relocation> relocations;
+};
+
+class Module {
+  std::vector<Symbol> symbolList;
+  std::unordered_map<std::string, std::uint32_t> symbolIndex;
+
+ public:
+  std::vector<Function> functions;
+  std::vector<GlobalData> globals;
+
+  Module();
+
+  // The symbol with the name, added if it doesn't exist yet.
+  std::uint32_t symbol(std::string_view name);
+  // The symbol with the name, nullopt if it doesn't exist.
+  std::optional<std::uint32_t> findSymbol(std::string_view name) const;
+  const Symbol& operator[](std::uint32_t id) const { return symbolList[id]; }
+  Symbol& operator[](std::uint32_t id) { return symbolList[id]; }
+  std::size_t numberOfSymbols() const { return symbolList.size(); }
+};
+
+// Check the structure of a function: every block ends with its only
+// terminator, the CFG edges agree with the terminators, every phi has one
+// operand per predecessor and every operand is a value that hasn't been
+// removed. Describes the first problem found.
+bool verify(const Function& function, std::string* problem);
+
+#endif
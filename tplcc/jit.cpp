@@ -0,0 +1,240 @@
+#include "jit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "machine-code.h"
+
+namespace {
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t align) {
+  return (value + align - 1) / align * align;
+}
+
+// JMP through the GOT entry of a function, padded with INT3.
+constexpr std::size_t STUB_SIZE = 8;
+
+// The parts of the mapping, each starting on a page of its own: the code
+// and the stubs, then the GOT and the read-only globals, then the rest.
+enum Segment : std::uint8_t { CODE, READ_ONLY, WRITABLE, NONE };
+
+struct Place {
+  Segment segment = NONE;
+  std::uint64_t offset = 0;
+};
+
+#ifndef _WIN32
+void* lookUpInProcess(const std::string& name) {
+  return dlsym(RTLD_DEFAULT, name.c_str());
+}
+#endif
+}  // namespace
+
+LoadedModule::LoadedModule(LoadedModule&& other) noexcept
+    : memory(std::exchange(other.memory, nullptr)),
+      size(std::exchange(other.size, 0)),
+      definitions(std::move(other.definitions)) {}
+
+LoadedModule& LoadedModule::operator=(LoadedModule&& other) noexcept {
+  if (this != &other) {
+    unload();
+    memory = std::exchange(other.memory, nullptr);
+    size = std::exchange(other.size, 0);
+    definitions = std::move(other.definitions);
+  }
+  return *this;
+}
+
+LoadedModule::~LoadedModule() { unload(); }
+
+void LoadedModule::unload() {
+#ifndef _WIN32
+  if (memory != nullptr) munmap(memory, size);
+#endif
+  memory = nullptr;
+  size = 0;
+  definitions.clear();
+}
+
+bool LoadedModule::load(const Module& module,
+                        std::span<const MachineFunction> functions,
+                        std::string* problem, const Resolver& resolve) {
+  unload();
+#ifdef _WIN32
+  (void)module;
+  (void)functions;
+  (void)resolve;
+  *problem = "Running code in process needs a System V x86-64 host.";
+  return false;
+#else
+  const auto numberOfSymbols = module.numberOfSymbols();
+  std::vector<Place> places(numberOfSymbols);
+  std::uint64_t sizes[NONE] = {};
+
+  MachineCode code;
+  for (const auto& function : functions) {
+    places[function.symbol] = {CODE, code.bytes.size()};
+    encode(function, code);
+  }
+
+  // Calls to functions outside the module go through a stub, the stub and
+  // any other use of their addresses through the GOT.
+  std::vector<std::uint32_t> stubs(numberOfSymbols);
+  std::vector<std::uint32_t> entries(numberOfSymbols);
+  std::uint32_t numberOfStubs = 0;
+  std::uint32_t numberOfEntries = 0;
+  for (const auto& relocation : code.relocations) {
+    const auto symbol = relocation.symbol;
+    const bool isOutside = places[symbol].segment == NONE;
+    if (relocation.kind == CodeRelocation::Kind::PLT32 && isOutside &&
+        stubs[symbol] == 0) {
+      stubs[symbol] = ++numberOfStubs;
+    }
+    if ((relocation.kind == CodeRelocation::Kind::GOTPCREL ||
+         stubs[symbol] != 0) &&
+        entries[symbol] == 0) {
+      entries[symbol] = ++numberOfEntries;
+    }
+  }
+  const auto stubsOffset = alignUp(code.bytes.size(), STUB_SIZE);
+  sizes[CODE] = stubsOffset + STUB_SIZE * numberOfStubs;
+  sizes[READ_ONLY] = 8 * std::uint64_t{numberOfEntries};
+
+  for (const auto& global : module.globals) {
+    const bool isZero = global.bytes.empty() && global.relocations.empty();
+    const auto segment = global.isReadOnly && !isZero ? READ_ONLY : WRITABLE;
+    const auto offset = alignUp(sizes[segment], global.align);
+    places[global.symbol] = {segment, offset};
+    sizes[segment] = offset + global.size;
+  }
+
+  const auto page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+  std::uint64_t bases[NONE] = {};
+  std::uint64_t total = 0;
+  for (int segment = CODE; segment < NONE; segment++) {
+    bases[segment] = total;
+    total = alignUp(total + sizes[segment], page);
+  }
+  void* mapping = mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    *problem = "Can't map memory for the code.";
+    return false;
+  }
+  memory = mapping;
+  size = total;
+  auto fail = [&](std::string message) {
+    *problem = std::move(message);
+    unload();
+    return false;
+  };
+  auto* const start = static_cast<unsigned char*>(memory);
+  const auto startAddress = reinterpret_cast<std::uint64_t>(start);
+
+  // The addresses of all symbols used, the ones outside the module
+  // resolved in the process.
+  std::vector<std::uint64_t> addresses(numberOfSymbols);
+  std::string unresolved;
+  auto resolveSymbol = [&](std::uint32_t symbol) {
+    if (addresses[symbol] != 0) return true;
+    const auto& place = places[symbol];
+    if (place.segment != NONE) {
+      addresses[symbol] = startAddress + bases[place.segment] + place.offset;
+      return true;
+    }
+    const auto& name = module[symbol].name;
+    void* found = resolve ? resolve(name) : lookUpInProcess(name);
+    if (found == nullptr) {
+      unresolved = "Can't resolve the symbol " + name + ".";
+      return false;
+    }
+    addresses[symbol] = reinterpret_cast<std::uint64_t>(found);
+    return true;
+  };
+
+  std::memcpy(start, code.bytes.data(), code.bytes.size());
+  for (const auto& global : module.globals) {
+    const auto& place = places[global.symbol];
+    auto* const to = start + bases[place.segment] + place.offset;
+    std::memcpy(to, global.bytes.data(),
+                std::min<std::uint64_t>(global.bytes.size(), global.size));
+    for (const auto& relocation : global.relocations) {
+      if (!resolveSymbol(relocation.symbol)) return fail(unresolved);
+      const std::uint64_t value =
+          addresses[relocation.symbol] + relocation.addend;
+      std::memcpy(to + relocation.offset, &value, sizeof(value));
+    }
+  }
+
+  const auto entriesAddress = startAddress + bases[READ_ONLY];
+  const auto stubsAddress = startAddress + bases[CODE] + stubsOffset;
+  for (std::uint32_t symbol = 0; symbol < numberOfSymbols; symbol++) {
+    if (entries[symbol] == 0) continue;
+    if (!resolveSymbol(symbol)) return fail(unresolved);
+    const auto entry = entriesAddress + 8 * (entries[symbol] - 1);
+    std::memcpy(reinterpret_cast<void*>(entry), &addresses[symbol], 8);
+    if (stubs[symbol] == 0) continue;
+    auto* const stub = reinterpret_cast<unsigned char*>(
+        stubsAddress + STUB_SIZE * (stubs[symbol] - 1));
+    const auto displacement = static_cast<std::int32_t>(
+        static_cast<std::int64_t>(entry) -
+        static_cast<std::int64_t>(reinterpret_cast<std::uint64_t>(stub) + 6));
+    const unsigned char jump[STUB_SIZE] = {0xFF, 0x25, 0, 0, 0, 0, 0xCC, 0xCC};
+    std::memcpy(stub, jump, STUB_SIZE);
+    std::memcpy(stub + 2, &displacement, 4);
+  }
+
+  for (const auto& relocation : code.relocations) {
+    const auto symbol = relocation.symbol;
+    if (!resolveSymbol(symbol)) return fail(unresolved);
+    std::uint64_t target = addresses[symbol];
+    if (relocation.kind == CodeRelocation::Kind::GOTPCREL) {
+      target = entriesAddress + 8 * (entries[symbol] - 1);
+    } else if (stubs[symbol] != 0) {
+      target = stubsAddress + STUB_SIZE * (stubs[symbol] - 1);
+    }
+    const auto at = startAddress + bases[CODE] + relocation.offset;
+    const auto value = static_cast<std::int64_t>(target + relocation.addend) -
+                       static_cast<std::int64_t>(at);
+    if (value != static_cast<std::int32_t>(value)) {
+      return fail("The symbol " + module[symbol].name +
+                  " is out of reach of 32-bit displacements.");
+    }
+    const auto displacement = static_cast<std::int32_t>(value);
+    std::memcpy(reinterpret_cast<void*>(at), &displacement, 4);
+  }
+
+  if (mprotect(start + bases[CODE], bases[READ_ONLY] - bases[CODE],
+               PROT_READ | PROT_EXEC) != 0 ||
+      mprotect(start + bases[READ_ONLY], bases[WRITABLE] - bases[READ_ONLY],
+               PROT_READ) != 0) {
+    return fail("Can't make the code executable.");
+  }
+
+  for (std::uint32_t symbol = 1; symbol < numberOfSymbols; symbol++) {
+    const auto& place = places[symbol];
+    if (place.segment == NONE) continue;
+    definitions.emplace(module[symbol].name,
+                        start + bases[place.segment] + place.offset);
+  }
+  return true;
+#endif
+}
+
+void* LoadedModule::address(std::string_view name) const {
+  const auto it = definitions.find(std::string(name));
+  return it == definitions.end() ? nullptr : it->second;
+}
+
+int LoadedModule::runMain(int argc, char** argv) const {
+  using Main = int (*)(int, char**);
+  const auto main = reinterpret_cast<Main>(address("main"));
+  return main == nullptr ? -1 : main(argc, argv);
+}
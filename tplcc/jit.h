@@ -0,0 +1,59 @@
+#ifndef TPLCC_JIT_H
+#define TPLCC_JIT_H
+
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "code-generation.h"
+#include "ir.h"
+
+// A module loaded into the memory of this process to run it there, without
+// an object file, an assembler or a linker.
+//
+// The functions are encoded into one mapping together with the globals, so
+// RIP-relative references between them always reach. The symbols the module
+// doesn't define are looked up in the process, by default with dlsym, and
+// reached through a GOT and a stub per function called, since they may be
+// further away than 32 bits. Once relocated, the code is made executable and
+// read-only, as are the read-only globals.
+//
+// Only on System V x86-64 hosts, the code follows their calling convention.
+class LoadedModule {
+  void* memory = nullptr;
+  std::size_t size = 0;
+  std::unordered_map<std::string, void*> definitions;
+
+ public:
+  // The address of a symbol the module doesn't define, nullptr if it
+  // doesn't exist.
+  using Resolver = std::function<void*(const std::string& name)>;
+
+  LoadedModule() = default;
+  LoadedModule(const LoadedModule&) = delete;
+  LoadedModule& operator=(const LoadedModule&) = delete;
+  LoadedModule(LoadedModule&& other) noexcept;
+  LoadedModule& operator=(LoadedModule&& other) noexcept;
+  ~LoadedModule();
+
+  // Load the module, replacing what was loaded before. Describes the
+  // problem if a symbol can't be resolved or the memory can't be had.
+  bool load(const Module& module, std::span<const MachineFunction> functions,
+            std::string* problem, const Resolver& resolve = nullptr);
+
+  // The address of a function or global the module defines, nullptr if
+  // there is none.
+  void* address(std::string_view name) const;
+
+  // Call the main function of the module with the arguments, -1 if it
+  // doesn't define one.
+  int runMain(int argc, char** argv) const;
+
+ private:
+  void unload();
+};
+
+#endif
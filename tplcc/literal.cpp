@@ -0,0 +1,163 @@
+#include "literal.h"
+
+#include <tuple>
+
+#include "encoding.h"
+
+namespace {
+bool isOctalDigit(char ch) { return ch >= '0' && ch <= '7'; }
+
+int hexDigitValue(char ch) {
+  if (ch >= '0' && ch <= '9') return ch - '0';
+  if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+  return -1;
+}
+
+void appendUTF8(std::string& output, std::uint32_t codepoint) {
+  if (codepoint < 0x80) {
+    output.push_back(static_cast<char>(codepoint));
+  } else if (codepoint < 0x800) {
+    output.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+    output.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  } else if (codepoint < 0x10000) {
+    output.push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+    output.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    output.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  } else {
+    output.push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+    output.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+    output.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    output.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  }
+}
+
+void appendWideElement(std::string& output, std::uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    output.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+  }
+}
+
+// Decode one element of the literal starting at content[i] and advance i.
+// Returns the value and whether it is a code point (as opposed to a raw
+// value given by an octal or hex escape).
+std::tuple<std::uint32_t, bool> decodeElement(std::string_view content,
+                                              std::size_t& i) {
+  if (content[i] != '\\' || i + 1 == content.size()) {
+    const auto [codepoint, length] =
+        utf8(reinterpret_cast<const unsigned char*>(content.data() + i));
+    i += length > 0 ? length : 1;
+    return {static_cast<std::uint32_t>(codepoint), true};
+  }
+
+  const char escape = content[i + 1];
+  i += 2;
+  switch (escape) {
+    case 'n': return {'\n', false};
+    case 't': return {'\t', false};
+    case 'r': return {'\r', false};
+    case 'a': return {'\a', false};
+    case 'b': return {'\b', false};
+    case 'f': return {'\f', false};
+    case 'v': return {'\v', false};
+    case 'x': {
+      std::uint32_t value = 0;
+      while (i < content.size() && hexDigitValue(content[i]) >= 0) {
+        value = value * 16 + hexDigitValue(content[i++]);
+      }
+      return {value, false};
+    }
+    case 'u':
+    case 'U': {
+      std::uint32_t value = 0;
+      const std::size_t digits = escape == 'u' ? 4 : 8;
+      for (std::size_t n = 0;
+           n < digits && i < content.size() && hexDigitValue(content[i]) >= 0;
+           n++) {
+        value = value * 16 + hexDigitValue(content[i++]);
+      }
+      return {value, true};
+    }
+    default:
+      if (isOctalDigit(escape)) {
+        std::uint32_t value = escape - '0';
+        for (int n = 0; n < 2 && i < content.size() && isOctalDigit(content[i]);
+             n++) {
+          value = value * 8 + (content[i++] - '0');
+        }
+        return {value, false};
+      }
+      // \\, \', \", \? and unknown escapes stand for the character itself.
+      return {static_cast<unsigned char>(escape), false};
+  }
+}
+}  // namespace
+
+void appendDecodedCharSequence(std::string& output, std::string_view content,
+                               bool isWide) {
+  std::size_t i = 0;
+  while (i < content.size()) {
+    // Copy narrow source characters byte by byte, so invalid UTF-8 survives.
+    if (!isWide && content[i] != '\\') {
+      output.push_back(content[i++]);
+      continue;
+    }
+
+    const auto [value, isCodePoint] = decodeElement(content, i);
+    if (isWide) {
+      appendWideElement(output, value);
+    } else if (isCodePoint) {
+      appendUTF8(output, value);
+    } else {
+      output.push_back(static_cast<char>(value & 0xFF));
+    }
+  }
+}
+
+std::uint32_t characterLiteralValue(std::string_view content, bool isWide) {
+  std::uint32_t value = 0;
+  std::size_t i = 0;
+  while (i < content.size()) {
+    if (!isWide && content[i] != '\\') {
+      // A plain char is signed, like GCC and Clang do on x86-64.
+      value = static_cast<std::uint32_t>(
+          static_cast<std::int32_t>(static_cast<signed char>(content[i++])));
+      continue;
+    }
+    const auto [element, isCodePoint] = decodeElement(content, i);
+    value = isWide ? element
+                   : static_cast<std::uint32_t>(static_cast<std::int32_t>(
+                         static_cast<signed char>(element & 0xFF)));
+  }
+  return value;
+}
+
+IntegerLiteralValue integerLiteralValue(std::string_view spelling) {
+  IntegerLiteralValue literal;
+  std::size_t i = 0;
+  std::uint64_t base = 10;
+  if (spelling.size() > 1 && spelling[0] == '0' &&
+      (spelling[1] == 'x' || spelling[1] == 'X')) {
+    base = 16;
+    i = 2;
+  } else if (!spelling.empty() && spelling[0] == '0') {
+    base = 8;
+  }
+  literal.isDecimal = base == 10;
+
+  for (; i < spelling.size(); i++) {
+    const auto digit = hexDigitValue(spelling[i]);
+    if (digit < 0 || static_cast<std::uint64_t>(digit) >= base) break;
+    if (literal.value > (UINT64_MAX - digit) / base) literal.overflows = true;
+    literal.value = literal.value * base + digit;
+  }
+
+  for (; i < spelling.size(); i++) {
+    if (spelling[i] == 'u' || spelling[i] == 'U') {
+      literal.isUnsigned = true;
+    } else if (spelling[i] == 'l' || spelling[i] == 'L') {
+      literal.longs++;
+    }
+  }
+  return literal;
+}
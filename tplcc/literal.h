@@ -0,0 +1,36 @@
+#ifndef TPLCC_LITERAL_H
+#define TPLCC_LITERAL_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// The lexer keeps string and character literals exactly as they are written,
+// these helpers give them their meaning.
+
+// Decode the escape sequences of a literal's content and append the result to
+// output. Each element of a wide literal is appended as 4 little-endian
+// bytes, source characters are read as UTF-8. Universal character names in a
+// narrow literal are encoded in UTF-8.
+void appendDecodedCharSequence(std::string& output, std::string_view content,
+                               bool isWide);
+
+// The value of a character literal, a multi-character constant takes the
+// value of its last character.
+std::uint32_t characterLiteralValue(std::string_view content, bool isWide);
+
+// An integer literal split into its value and its suffix. The lexer has
+// checked the spelling already.
+struct IntegerLiteralValue {
+  std::uint64_t value = 0;
+  bool isDecimal = true;
+  bool isUnsigned = false;
+  // 1 for an "l" suffix, 2 for "ll".
+  std::uint8_t longs = 0;
+  // The value doesn't fit in 64 bits.
+  bool overflows = false;
+};
+
+IntegerLiteralValue integerLiteralValue(std::string_view spelling);
+
+#endif
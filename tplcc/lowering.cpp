@@ -0,0 +1,1510 @@
+#include "lowering.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+constexpr TypeID VOID = TypeTable::builtin(TypeKind::Void);
+constexpr TypeID LONG = TypeTable::builtin(TypeKind::Long);
+
+std::uint64_t definitionKey(std::uint32_t variable, BlockID block) {
+  return (static_cast<std::uint64_t>(variable) << 32) | block;
+}
+
+// Locals declared static or extern, which aren't objects of the function.
+bool isStaticOrExtern(StorageClass storage) {
+  return storage == StorageClass::Static || storage == StorageClass::Extern;
+}
+}  // namespace
+
+Lowering::Lowering(const AST& ast, const StringInterner& strings,
+                   const Sema& sema, Module& module, IReportError& errOut)
+    : ast(ast),
+      strings(strings),
+      sema(sema),
+      types(sema.typeTable()),
+      module(module),
+      errOut(errOut) {}
+
+void Lowering::lower(NodeID translationUnit) {
+  for (const auto item : ast.list(ast[translationUnit].list)) {
+    if (ast[item].kind == NodeKind::FunctionDef) {
+      lowerFunction(item);
+      continue;
+    }
+    for (const auto decl : ast.list(ast[item].list)) {
+      const auto& node = ast[decl];
+      if (node.kind == NodeKind::FunctionDecl) {
+        symbolOf(decl);
+      } else if (node.kind == NodeKind::VarDecl) {
+        const auto symbol = symbolOf(decl);
+        const auto storage = static_cast<StorageClass>(node.op);
+        if (storage != StorageClass::Extern || node.b != 0) {
+          lowerGlobal(decl, symbol);
+        }
+      }
+    }
+  }
+}
+
+/* Declarations */
+
+void Lowering::lowerFunction(NodeID definition) {
+  const auto decl = ast[definition].a;
+  const auto type = sema.typeOf(decl);
+  const auto result = types[type].base;
+
+  module.functions.emplace_back();
+  function = &module.functions.back();
+  functionDecl = decl;
+  function->symbol = symbolOf(decl);
+  module[function->symbol].isDefined = true;
+  function->returnType = irType(result);
+  function->isVariadic = types[type].flags & TypeFlag::Variadic;
+  if (types.isRecord(result)) {
+    unsupported(decl, "Structures returned by value");
+  }
+
+  addresses.clear();
+  variableIndex.clear();
+  variableTypes.clear();
+  definitions.clear();
+  sealed.assign(1, true);
+  incompletePhis.assign(1, {});
+  replacements.clear();
+  labelBlocks.clear();
+
+  current = newBlock();
+  sealBlock(current);
+  collectLocals(definition);
+
+  for (const auto param : ast.list(ast[ast[decl].a].list)) {
+    const auto paramType = sema.typeOf(param);
+    if (types.isRecord(paramType)) {
+      unsupported(param, "Structures passed by value");
+    } else if (types.isFloating(paramType)) {
+      unsupported(param, "Floating-point types");
+    }
+    const auto value = function->addParam(irType(paramType));
+    if (const auto it = variableIndex.find(param); it != variableIndex.end()) {
+      writeVariable(it->second, current, value);
+    } else {
+      store(addresses.at(param), value, paramType);
+    }
+  }
+
+  statement(ast[definition].b);
+
+  // Falling off the end returns 0 rather than garbage, which is what main
+  // has to do anyway.
+  if (current != 0) {
+    if (function->returnType == IRType::Void) {
+      function->ret(current);
+    } else {
+      function->ret(current, function->constant(function->returnType, 0));
+    }
+    current = 0;
+  }
+  finishFunction();
+  function = nullptr;
+}
+
+void Lowering::lowerGlobal(NodeID decl, std::uint32_t symbol) {
+  const auto& node = ast[decl];
+  const auto type = sema.typeOf(decl);
+
+  const auto existing = globalIndex.find(symbol);
+  // A tentative definition after the real one.
+  if (existing != globalIndex.end() && node.b == 0) return;
+
+  auto element = type;
+  while (types.kind(element) == TypeKind::Array) element = types[element].base;
+
+  GlobalData global;
+  global.symbol = symbol;
+  global.size = sema.sizeOf(type);
+  global.align = sema.alignOf(type);
+  global.isReadOnly = types[element].qualifiers & TypeQualifier::Const;
+  if (node.b != 0) constantInitializer(global, type, node.b, 0);
+  module[symbol].isDefined = true;
+
+  if (existing != globalIndex.end()) {
+    module.globals[existing->second] = std::move(global);
+  } else {
+    globalIndex.emplace(symbol, module.globals.size());
+    module.globals.push_back(std::move(global));
+  }
+}
+
+std::uint32_t Lowering::symbolOf(NodeID decl) {
+  if (const auto it = staticLocals.find(decl); it != staticLocals.end()) {
+    return it->second;
+  }
+  const auto& node = ast[decl];
+  const auto id = module.symbol(strings.view(node.name));
+  auto& symbol = module[id];
+  if (node.kind == NodeKind::FunctionDecl) symbol.isFunction = true;
+  if (static_cast<StorageClass>(node.op) == StorageClass::Static) {
+    symbol.isLocal = true;
+  }
+  return id;
+}
+
+// String literals that aren't initializing an array are read-only objects,
+// the same literal twice is one object.
+std::uint32_t Lowering::stringLiteral(NodeID id) {
+  const auto& node = ast[id];
+  const bool isWide = node.flags & NodeFlag::Wide;
+  auto key = std::string(isWide ? "L" : "\"");
+  key += strings.view(node.name);
+  if (const auto it = stringLiterals.find(key); it != stringLiterals.end()) {
+    return it->second;
+  }
+
+  const auto symbol =
+      module.symbol(".L.str." + std::to_string(stringLiterals.size()));
+  module[symbol].isLocal = module[symbol].isDefined = true;
+  GlobalData global;
+  global.symbol = symbol;
+  global.size = sema.sizeOf(sema.typeOf(id));
+  global.align = isWide ? 4 : 1;
+  global.isReadOnly = true;
+  global.bytes = strings.view(node.name);
+  module.globals.push_back(std::move(global));
+  stringLiterals.emplace(std::move(key), symbol);
+  return symbol;
+}
+
+// Decide where every local of the function lives: a scalar whose address
+// isn't taken is a variable, anything else gets a slot in the entry block.
+// Static locals become globals named like GCC does, "name.N".
+void Lowering::collectLocals(NodeID definition) {
+  const auto decl = ast[definition].a;
+  std::unordered_set<NodeID> addressTaken;
+  std::vector<NodeID> locals;
+
+  for (const auto param : ast.list(ast[ast[decl].a].list)) {
+    locals.push_back(param);
+  }
+  for (NodeID id = decl + 1; id < definition; id++) {
+    const auto& node = ast[id];
+    if (node.kind == NodeKind::VarDecl) {
+      locals.push_back(id);
+    } else if (node.kind == NodeKind::CompoundLiteral) {
+      const auto type = sema.typeOf(id);
+      addresses[id] = emit(Opcode::Alloca, IRType::Ptr, {},
+                           std::max<std::uint64_t>(sema.sizeOf(type), 1),
+                           sema.alignOf(type));
+    } else if (node.kind == NodeKind::Unary &&
+               node.oper() == Operator::AddressOf &&
+               ast[node.a].kind == NodeKind::Identifier) {
+      addressTaken.insert(ast[node.a].a);
+    }
+  }
+
+  for (const auto local : locals) {
+    const auto& node = ast[local];
+    const auto type = sema.typeOf(local);
+    if (node.kind == NodeKind::VarDecl) {
+      const auto storage = static_cast<StorageClass>(node.op);
+      if (storage == StorageClass::Extern) continue;
+      if (storage == StorageClass::Static) {
+        const auto name = std::string(strings.view(node.name)) + "." +
+                          std::to_string(staticLocals.size());
+        const auto symbol = module.symbol(name);
+        module[symbol].isLocal = true;
+        staticLocals.emplace(local, symbol);
+        lowerGlobal(local, symbol);
+        continue;
+      }
+      if (types.kind(type) == TypeKind::Array &&
+          types[type].flags & TypeFlag::VariableLength) {
+        unsupported(local, "Variable length arrays");
+      }
+    }
+
+    const bool isVolatile = types[type].qualifiers & TypeQualifier::Volatile;
+    if (addressTaken.contains(local) || !types.isScalar(type) ||
+        types.isFloating(type) || isVolatile) {
+      addresses[local] = emit(Opcode::Alloca, IRType::Ptr, {},
+                              std::max<std::uint64_t>(sema.sizeOf(type), 1),
+                              sema.alignOf(type));
+    } else {
+      variableIndex[local] = static_cast<std::uint32_t>(variableTypes.size());
+      variableTypes.push_back(irType(type));
+    }
+  }
+}
+
+void Lowering::localDeclarations(NodeID group) {
+  for (const auto decl : ast.list(ast[group].list)) {
+    const auto& node = ast[decl];
+    if (node.kind != NodeKind::VarDecl || node.b == 0) continue;
+    if (isStaticOrExtern(static_cast<StorageClass>(node.op))) continue;
+
+    const auto it = variableIndex.find(decl);
+    if (it == variableIndex.end()) {
+      initialize(addresses.at(decl), sema.typeOf(decl), node.b);
+      continue;
+    }
+    // Braces around a scalar initializer.
+    auto init = node.b;
+    while (init != 0 && ast[init].kind == NodeKind::InitList) {
+      const auto items = ast.list(ast[init].list);
+      init = items.empty() ? 0 : items[0];
+    }
+    const auto value = init != 0
+                           ? rvalue(init)
+                           : function->constant(variableTypes[it->second], 0);
+    writeVariable(it->second, block(), value);
+  }
+}
+
+/* Initializers */
+
+// Mirrors Sema::checkInitializer and Sema::checkInitList, with offsets.
+template <typename Visit>
+void Lowering::walkInitializer(TypeID type, NodeID init, std::uint64_t offset,
+                               Visit& visit) {
+  const auto& node = ast[init];
+  const auto kind = types.kind(type);
+  if (kind == TypeKind::Array || types.isRecord(type)) {
+    if (node.kind == NodeKind::InitList) {
+      walkInitList(type, init, offset, visit);
+    } else {
+      visit(type, init, offset);
+    }
+    return;
+  }
+  if (node.kind == NodeKind::InitList) {
+    const auto items = ast.list(node.list);
+    if (!items.empty()) walkInitializer(type, items[0], offset, visit);
+    return;
+  }
+  visit(type, init, offset);
+}
+
+template <typename Visit>
+void Lowering::walkInitList(TypeID type, NodeID list, std::uint64_t offset,
+                            Visit& visit) {
+  const auto isAggregate = [&](TypeID t) {
+    return types.kind(t) == TypeKind::Array || types.isRecord(t);
+  };
+
+  const auto items = ast.list(ast[list].list);
+  std::size_t position = 0;
+  const auto elide = [&](const auto& self, TypeID t,
+                         std::uint64_t at) -> void {
+    if (!isAggregate(t)) {
+      walkInitializer(t, items[position++], at, visit);
+      return;
+    }
+    for (std::size_t index = 0; position < items.size(); index++) {
+      if (ast[items[position]].kind == NodeKind::Designation) return;
+      TypeID member = 0;
+      std::uint64_t memberOffset = 0;
+      if (!memberAt(t, index, &member, &memberOffset)) return;
+      self(self, member, at + memberOffset);
+    }
+  };
+
+  std::size_t index = 0;
+  while (position < items.size()) {
+    const auto item = items[position];
+
+    if (ast[item].kind == NodeKind::Designation) {
+      auto target = types.unqualified(type);
+      std::uint64_t at = 0;
+      bool isFirst = true;
+      for (const auto designator : ast.list(ast[item].list)) {
+        if (ast[designator].kind == NodeKind::ArrayDesignator) {
+          const auto value = sema.integerConstantValue(ast[designator].a);
+          const auto designated = value ? value->bits : 0;
+          if (isFirst) index = designated;
+          target = types[target].base;
+          at += designated * sema.sizeOf(target);
+        } else {
+          const auto definition = ast[types[target].count].b;
+          std::uint64_t fieldOffset = 0;
+          const auto field =
+              findField(definition, ast[designator].name, &fieldOffset);
+          if (isFirst) {
+            index = 0;
+            for (const auto member : ast.list(ast[definition].list)) {
+              if (member == field) break;
+              if (!(ast[member].name == 0 && ast[member].b != 0)) index++;
+            }
+          }
+          target = types.unqualified(sema.typeOf(field));
+          at += fieldOffset;
+        }
+        isFirst = false;
+      }
+      walkInitializer(target, ast[item].b, offset + at, visit);
+      position++;
+      index++;
+      continue;
+    }
+
+    TypeID member = 0;
+    std::uint64_t memberOffset = 0;
+    if (!memberAt(type, index, &member, &memberOffset)) {
+      position++;
+      continue;
+    }
+    const auto itemType = sema.typeOf(item);
+    const bool takesItem =
+        !isAggregate(member) || ast[item].kind == NodeKind::InitList ||
+        (ast[item].kind == NodeKind::StringLiteral &&
+         types.kind(member) == TypeKind::Array) ||
+        (types.isRecord(member) &&
+         types.isCompatible(types.unqualified(itemType),
+                            types.unqualified(member)));
+    if (takesItem) {
+      walkInitializer(member, item, offset + memberOffset, visit);
+      position++;
+    } else {
+      elide(elide, member, offset + memberOffset);
+    }
+    index++;
+  }
+}
+
+// The type and offset of the index-th member of an aggregate in the order
+// initializers are given, like Sema's memberType.
+bool Lowering::memberAt(TypeID aggregate, std::size_t index, TypeID* type,
+                        std::uint64_t* offset) {
+  aggregate = types.unqualified(aggregate);
+  if (types.kind(aggregate) == TypeKind::Array) {
+    const auto& array = types[aggregate];
+    if (array.flags == 0 && index >= array.count) return false;
+    *type = array.base;
+    *offset = index * sema.sizeOf(array.base);
+    return true;
+  }
+  if (!types.isRecord(aggregate)) return false;
+  const auto definition = ast[types[aggregate].count].b;
+  if (definition == 0) return false;
+  std::size_t position = 0;
+  for (const auto member : ast.list(ast[definition].list)) {
+    if (ast[member].name == 0 && ast[member].b != 0) continue;
+    if (position++ == index) {
+      if (ast[member].b != 0) unsupported(member, "Bit-fields");
+      *type = sema.typeOf(member);
+      *offset = sema.valueOf(member) / 8;
+      return true;
+    }
+    if (types.kind(aggregate) == TypeKind::Union) break;
+  }
+  return false;
+}
+
+// Sema lays the members of anonymous structs and unions out relative to the
+// record containing them, so the offset of a field found in one is its own.
+NodeID Lowering::findField(NodeID definition, StringID name,
+                           std::uint64_t* offset) const {
+  for (const auto member : ast.list(ast[definition].list)) {
+    const auto& node = ast[member];
+    if (node.name == name && name != 0) {
+      *offset = sema.valueOf(member) / 8;
+      return member;
+    }
+    const auto type = sema.typeOf(member);
+    if (node.name == 0 && node.b == 0 && types.isRecord(type)) {
+      const auto inner = ast[types[types.unqualified(type)].count].b;
+      if (inner == 0) continue;
+      if (const auto found = findField(inner, name, offset)) return found;
+    }
+  }
+  return 0;
+}
+
+// Initialize an object in memory. An aggregate is cleared first, since
+// members without an initializer are zero.
+void Lowering::initialize(ValueID address, TypeID type, NodeID init) {
+  const bool isAggregate =
+      types.kind(type) == TypeKind::Array || types.isRecord(type);
+  if (isAggregate && ast[init].kind == NodeKind::InitList) {
+    const auto zero = function->constant(IRType::I32, 0);
+    const auto size = function->constant(IRType::I64, sema.sizeOf(type));
+    callLibrary("memset", {address, zero, size});
+  }
+
+  auto visit = [&](TypeID target, NodeID expr, std::uint64_t offset) {
+    if (types.kind(target) == TypeKind::Array) {
+      // A string literal, without its terminator if the array is too short.
+      const auto size = std::min(sema.sizeOf(target),
+                                 sema.sizeOf(sema.typeOf(expr)));
+      const auto destination = offsetAddress(address, offset);
+      const auto source = function->symbolAddress(stringLiteral(expr));
+      callLibrary("memcpy",
+                  {destination, source, function->constant(IRType::I64, size)});
+      return;
+    }
+    const auto value = rvalue(expr);
+    store(offsetAddress(address, offset), value, target);
+  };
+  walkInitializer(type, init, 0, visit);
+}
+
+void Lowering::constantInitializer(GlobalData& global, TypeID type,
+                                   NodeID init, std::uint64_t offset) {
+  const auto write = [&](std::uint64_t at, std::uint64_t bits,
+                         std::uint64_t size) {
+    if (global.bytes.size() < at + size) global.bytes.resize(at + size);
+    for (std::uint64_t i = 0; i < size; i++) {
+      global.bytes[at + i] = static_cast<char>(bits >> (i * 8));
+    }
+  };
+
+  auto visit = [&](TypeID target, NodeID expr, std::uint64_t at) {
+    if (types.kind(target) == TypeKind::Array) {
+      const auto content = strings.view(ast[expr].name);
+      const auto size = std::min<std::uint64_t>(sema.sizeOf(target),
+                                                content.size());
+      if (global.bytes.size() < at + size) global.bytes.resize(at + size);
+      std::copy_n(content.begin(), size, global.bytes.begin() + at);
+      return;
+    }
+    if (types.isFloating(target) || types.isFloating(sema.typeOf(expr))) {
+      unsupported(expr, "Floating-point types");
+      return;
+    }
+    if (types.isPointer(target)) {
+      std::uint32_t symbol = 0;
+      std::int64_t addend = 0;
+      if (addressConstant(expr, &symbol, &addend)) {
+        global.relocations.push_back({at, symbol, addend});
+        return;
+      }
+    }
+    const auto value = types.isRecord(target)
+                           ? std::nullopt
+                           : sema.integerConstantValue(expr);
+    if (!value) {
+      const auto start = ast[expr].offset;
+      errOut.reportsError(
+          Error{ErrorID::NotConstantInitializer, {start, start + 1}});
+      return;
+    }
+    const auto bits = types.kind(target) == TypeKind::Bool
+                          ? static_cast<std::uint64_t>(!value->isZero())
+                          : value->bits;
+    write(at, bits, sema.sizeOf(target));
+  };
+  walkInitializer(type, init, offset, visit);
+}
+
+// Whether a pointer-valued expression is an address constant, the address of
+// an object or function with static storage duration plus a constant.
+bool Lowering::addressConstant(NodeID id, std::uint32_t* symbol,
+                               std::int64_t* addend) {
+  const auto& node = ast[id];
+  switch (node.kind) {
+    case NodeKind::Cast: {
+      const auto operandType = sema.typeOf(node.b);
+      const auto kind = types.kind(operandType);
+      if (kind != TypeKind::Pointer && kind != TypeKind::Array &&
+          kind != TypeKind::Function) {
+        return false;
+      }
+      return addressConstant(node.b, symbol, addend);
+    }
+    case NodeKind::StringLiteral:
+    case NodeKind::Identifier: {
+      const auto kind = types.kind(sema.typeOf(id));
+      if (kind != TypeKind::Array && kind != TypeKind::Function) return false;
+      return objectAddressConstant(id, symbol, addend);
+    }
+    case NodeKind::Unary:
+      if (node.oper() != Operator::AddressOf) return false;
+      return objectAddressConstant(node.a, symbol, addend);
+    case NodeKind::Binary: {
+      if (node.oper() != Operator::Add && node.oper() != Operator::Subtract) {
+        return false;
+      }
+      const bool isLeftPointer = types.isPointer(sema.convertedTypeOf(node.a));
+      const auto pointer = isLeftPointer ? node.a : node.b;
+      const auto index = isLeftPointer ? node.b : node.a;
+      if (types.isPointer(sema.convertedTypeOf(index))) return false;
+      const auto value = sema.integerConstantValue(index);
+      if (!value || !addressConstant(pointer, symbol, addend)) return false;
+      const auto element = types[sema.convertedTypeOf(pointer)].base;
+      const auto size =
+          static_cast<std::int64_t>(std::max<std::uint64_t>(
+              sema.sizeOf(element), 1));
+      const auto scaled = value->asSigned() * size;
+      *addend += node.oper() == Operator::Subtract ? -scaled : scaled;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool Lowering::objectAddressConstant(NodeID id, std::uint32_t* symbol,
+                                     std::int64_t* addend) {
+  const auto& node = ast[id];
+  switch (node.kind) {
+    case NodeKind::StringLiteral:
+      *symbol = stringLiteral(id);
+      *addend = 0;
+      return true;
+    case NodeKind::Identifier: {
+      const auto decl = node.a;
+      const auto kind = ast[decl].kind;
+      if (kind != NodeKind::VarDecl && kind != NodeKind::FunctionDecl) {
+        return false;
+      }
+      // Locals of the function being lowered.
+      if (addresses.contains(decl) || variableIndex.contains(decl)) {
+        return false;
+      }
+      *symbol = symbolOf(decl);
+      *addend = 0;
+      return true;
+    }
+    case NodeKind::Member: {
+      if (node.flags & NodeFlag::Arrow) {
+        if (!addressConstant(node.a, symbol, addend)) return false;
+      } else if (!objectAddressConstant(node.a, symbol, addend)) {
+        return false;
+      }
+      auto record = sema.typeOf(node.a);
+      if (node.flags & NodeFlag::Arrow) record = types[record].base;
+      const auto definition = ast[types[types.unqualified(record)].count].b;
+      std::uint64_t offset = 0;
+      findField(definition, node.name, &offset);
+      *addend += static_cast<std::int64_t>(offset);
+      return true;
+    }
+    case NodeKind::Subscript: {
+      const bool isLeftPointer = types.isPointer(sema.convertedTypeOf(node.a));
+      const auto pointer = isLeftPointer ? node.a : node.b;
+      const auto index = isLeftPointer ? node.b : node.a;
+      const auto value = sema.integerConstantValue(index);
+      if (!value || !addressConstant(pointer, symbol, addend)) return false;
+      const auto size = static_cast<std::int64_t>(sema.sizeOf(sema.typeOf(id)));
+      *addend += value->asSigned() * size;
+      return true;
+    }
+    case NodeKind::Unary:
+      if (node.oper() != Operator::Dereference) return false;
+      return addressConstant(node.a, symbol, addend);
+    default:
+      return false;
+  }
+}
+
+/* Statements */
+
+void Lowering::statement(NodeID id) {
+  if (id == 0) return;
+  const auto& node = ast[id];
+  switch (node.kind) {
+    case NodeKind::CompoundStmt:
+      for (const auto item : ast.list(node.list)) statement(item);
+      break;
+    case NodeKind::DeclGroup:
+      localDeclarations(id);
+      break;
+    case NodeKind::ExprStmt:
+      if (node.a != 0) effect(node.a);
+      break;
+    case NodeKind::IfStmt:
+      ifStatement(id);
+      break;
+    case NodeKind::WhileStmt:
+      whileStatement(id);
+      break;
+    case NodeKind::DoStmt:
+      doStatement(id);
+      break;
+    case NodeKind::ForStmt:
+      forStatement(id);
+      break;
+    case NodeKind::SwitchStmt:
+      switchStatement(id);
+      break;
+    case NodeKind::CaseStmt:
+    case NodeKind::DefaultStmt:
+    case NodeKind::LabelStmt:
+      enter(labelBlock(id));
+      statement(node.b);
+      break;
+    case NodeKind::GotoStmt:
+      jumpTo(labelBlock(node.a));
+      break;
+    case NodeKind::BreakStmt:
+      jumpTo(breakTargets.back());
+      break;
+    case NodeKind::ContinueStmt:
+      jumpTo(continueTargets.back());
+      break;
+    case NodeKind::ReturnStmt:
+      returnStatement(id);
+      break;
+    default:
+      break;
+  }
+}
+
+void Lowering::ifStatement(NodeID id) {
+  const auto& node = ast[id];
+  const auto then = newBlock();
+  const auto otherwise = node.c != 0 ? newBlock() : 0;
+  const auto join = newBlock();
+
+  condition(node.a, then, otherwise != 0 ? otherwise : join);
+  sealBlock(then);
+  current = then;
+  statement(node.b);
+  jumpTo(join);
+  if (otherwise != 0) {
+    sealBlock(otherwise);
+    current = otherwise;
+    statement(node.c);
+    jumpTo(join);
+  }
+  continueAt(join);
+}
+
+// The header of a loop is sealed once the body, which jumps back to it, is
+// done.
+void Lowering::whileStatement(NodeID id) {
+  const auto& node = ast[id];
+  const auto header = newBlock();
+  const auto body = newBlock();
+  const auto exit = newBlock();
+
+  enter(header);
+  condition(node.a, body, exit);
+  sealBlock(body);
+  current = body;
+  breakTargets.push_back(exit);
+  continueTargets.push_back(header);
+  statement(node.b);
+  breakTargets.pop_back();
+  continueTargets.pop_back();
+  jumpTo(header);
+  sealBlock(header);
+  continueAt(exit);
+}
+
+void Lowering::doStatement(NodeID id) {
+  const auto& node = ast[id];
+  const auto body = newBlock();
+  const auto test = newBlock();
+  const auto exit = newBlock();
+
+  enter(body);
+  breakTargets.push_back(exit);
+  continueTargets.push_back(test);
+  statement(node.a);
+  breakTargets.pop_back();
+  continueTargets.pop_back();
+  jumpTo(test);
+  continueAt(test);
+  if (current != 0) condition(node.b, body, exit);
+  sealBlock(body);
+  continueAt(exit);
+}
+
+void Lowering::forStatement(NodeID id) {
+  const auto& node = ast[id];
+  statement(node.a);
+
+  const auto header = newBlock();
+  const auto body = newBlock();
+  const auto step = newBlock();
+  const auto exit = newBlock();
+
+  enter(header);
+  if (node.b != 0) {
+    condition(node.b, body, exit);
+  } else {
+    jumpTo(body);
+  }
+  sealBlock(body);
+  current = body;
+  breakTargets.push_back(exit);
+  continueTargets.push_back(step);
+  statement(node.d);
+  breakTargets.pop_back();
+  continueTargets.pop_back();
+  jumpTo(step);
+  continueAt(step);
+  if (current != 0) {
+    if (node.c != 0) effect(node.c);
+    jumpTo(header);
+  }
+  sealBlock(header);
+  continueAt(exit);
+}
+
+// A switch compares the value with the cases one after the other. The case
+// blocks are sealed after the body, where falling through into them ends.
+void Lowering::switchStatement(NodeID id) {
+  const auto& node = ast[id];
+  const auto value = rvalue(node.a);
+  const auto type = irType(sema.convertedTypeOf(node.a));
+  const auto labels = ast.list(node.list);
+  const auto exit = newBlock();
+
+  auto otherwise = exit;
+  for (const auto label : labels) {
+    const auto target = labelBlock(label);
+    if (ast[label].kind == NodeKind::DefaultStmt) otherwise = target;
+  }
+  for (const auto label : labels) {
+    if (ast[label].kind != NodeKind::CaseStmt) continue;
+    const auto caseValue = sema.integerConstantValue(ast[label].a);
+    const auto constant =
+        function->constant(type, caseValue ? caseValue->bits : 0);
+    const auto equal = emit(Opcode::Eq, IRType::I32, {value, constant});
+    const auto next = newBlock();
+    function->branch(block(), equal, labelBlocks.at(label), next);
+    sealBlock(next);
+    current = next;
+  }
+  jumpTo(otherwise);
+
+  breakTargets.push_back(exit);
+  statement(node.b);
+  breakTargets.pop_back();
+  jumpTo(exit);
+  for (const auto label : labels) sealBlock(labelBlocks.at(label));
+  continueAt(exit);
+}
+
+void Lowering::returnStatement(NodeID id) {
+  const auto value = ast[id].a;
+  if (value == 0) {
+    function->ret(block());
+  } else if (function->returnType == IRType::Void) {
+    effect(value);
+    function->ret(block());
+  } else {
+    const auto result = rvalue(value);
+    function->ret(block(), result);
+  }
+  current = 0;
+}
+
+/* Expressions */
+
+// The value of an expression after the conversions Sema found for it. Arrays
+// and functions are their address, structs and unions too.
+ValueID Lowering::rvalue(NodeID id) {
+  const auto type = sema.typeOf(id);
+  const auto converted = sema.convertedTypeOf(id);
+  if (types.isFloating(type) || types.isFloating(converted)) {
+    unsupported(id, "Floating-point types");
+    return function->constant(IRType::I64, 0);
+  }
+  const auto kind = types.kind(type);
+  if (kind == TypeKind::Array || kind == TypeKind::Function) {
+    return address(id);
+  }
+  const auto value = compute(id);
+  return convert(value, type, converted);
+}
+
+ValueID Lowering::compute(NodeID id) {
+  const auto& node = ast[id];
+  const auto type = sema.typeOf(id);
+  switch (node.kind) {
+    case NodeKind::IntegerLiteral:
+    case NodeKind::CharacterLiteral:
+    case NodeKind::SizeofExpr:
+    case NodeKind::SizeofType:
+      return function->constant(irType(type), sema.valueOf(id));
+    case NodeKind::Identifier: {
+      const auto decl = node.a;
+      if (ast[decl].kind == NodeKind::EnumConstantDecl) {
+        return function->constant(irType(type), sema.valueOf(decl));
+      }
+      if (const auto it = variableIndex.find(decl); it != variableIndex.end()) {
+        return readVariable(it->second, block());
+      }
+      return load(address(id), type);
+    }
+    case NodeKind::Unary:
+      return unary(id);
+    case NodeKind::Binary:
+      return binary(id);
+    case NodeKind::Assign:
+      return assign(id);
+    case NodeKind::Conditional:
+      return conditional(id);
+    case NodeKind::Cast:
+      if (types.kind(type) == TypeKind::Void) {
+        effect(node.b);
+        return 0;
+      }
+      // Sema converts the operand to the type of the cast.
+      return rvalue(node.b);
+    case NodeKind::Call:
+      return call(id);
+    case NodeKind::Subscript:
+    case NodeKind::Member:
+    case NodeKind::StringLiteral:
+    case NodeKind::CompoundLiteral:
+      return load(address(id), type);
+    default:
+      unsupported(id, "These expressions");
+      return function->constant(IRType::I32, 0);
+  }
+}
+
+ValueID Lowering::address(NodeID id) {
+  const auto& node = ast[id];
+  switch (node.kind) {
+    case NodeKind::Identifier: {
+      if (const auto it = addresses.find(node.a); it != addresses.end()) {
+        return it->second;
+      }
+      return function->symbolAddress(symbolOf(node.a));
+    }
+    case NodeKind::Unary:
+      if (node.oper() == Operator::Dereference) return rvalue(node.a);
+      break;
+    case NodeKind::Subscript: {
+      // a[b] is *(a + b), either of them can be the pointer.
+      const bool isLeftPointer = types.isPointer(sema.convertedTypeOf(node.a));
+      const auto pointerNode = isLeftPointer ? node.a : node.b;
+      const auto indexNode = isLeftPointer ? node.b : node.a;
+      const auto pointer = rvalue(pointerNode);
+      const auto index = rvalue(indexNode);
+      return elementAddress(pointer, index, sema.convertedTypeOf(indexNode),
+                            sema.typeOf(id));
+    }
+    case NodeKind::Member: {
+      const bool isArrow = node.flags & NodeFlag::Arrow;
+      auto record = isArrow ? types[sema.convertedTypeOf(node.a)].base
+                            : sema.typeOf(node.a);
+      const auto base = isArrow ? rvalue(node.a) : address(node.a);
+      const auto definition = ast[types[types.unqualified(record)].count].b;
+      std::uint64_t offset = 0;
+      const auto field = findField(definition, node.name, &offset);
+      if (ast[field].b != 0) unsupported(id, "Bit-fields");
+      return offsetAddress(base, offset);
+    }
+    case NodeKind::StringLiteral:
+      return function->symbolAddress(stringLiteral(id));
+    case NodeKind::CompoundLiteral: {
+      const auto slot = addresses.at(id);
+      initialize(slot, sema.typeOf(id), node.b);
+      return slot;
+    }
+    default:
+      break;
+  }
+  // A struct or union that isn't an lvalue, e.g. the result of an
+  // assignment, is already its address.
+  return compute(id);
+}
+
+Lowering::LValue Lowering::lvalue(NodeID id) {
+  const auto type = sema.typeOf(id);
+  if (ast[id].kind == NodeKind::Identifier) {
+    if (const auto it = variableIndex.find(ast[id].a);
+        it != variableIndex.end()) {
+      return {0, it->second + 1, type};
+    }
+  }
+  return {address(id), 0, type};
+}
+
+ValueID Lowering::read(const LValue& lvalue) {
+  if (lvalue.variable != 0) return readVariable(lvalue.variable - 1, block());
+  return load(lvalue.address, lvalue.type);
+}
+
+void Lowering::write(const LValue& lvalue, ValueID value) {
+  if (lvalue.variable != 0) {
+    writeVariable(lvalue.variable - 1, block(), value);
+  } else {
+    store(lvalue.address, value, lvalue.type);
+  }
+}
+
+// Evaluate an expression for its side effects only.
+void Lowering::effect(NodeID id) {
+  const auto type = sema.typeOf(id);
+  if (types.kind(type) == TypeKind::Void || types.isRecord(type)) {
+    compute(id);
+  } else if (ast[id].kind != NodeKind::Identifier) {
+    rvalue(id);
+  }
+}
+
+// Branch on a condition, with && || and ! as control flow rather than values.
+void Lowering::condition(NodeID id, BlockID ifTrue, BlockID ifFalse) {
+  const auto& node = ast[id];
+  if (node.kind == NodeKind::Binary && (node.oper() == Operator::LogicalAnd ||
+                                        node.oper() == Operator::LogicalOr)) {
+    const auto right = newBlock();
+    if (node.oper() == Operator::LogicalAnd) {
+      condition(node.a, right, ifFalse);
+    } else {
+      condition(node.a, ifTrue, right);
+    }
+    sealBlock(right);
+    current = right;
+    condition(node.b, ifTrue, ifFalse);
+    return;
+  }
+  if (node.kind == NodeKind::Unary && node.oper() == Operator::LogicalNot) {
+    condition(node.a, ifFalse, ifTrue);
+    return;
+  }
+  const auto value = rvalue(id);
+  function->branch(block(), value, ifTrue, ifFalse);
+  current = 0;
+}
+
+// The value of && or ||, 1 or 0.
+ValueID Lowering::conditionValue(NodeID id) {
+  const auto ifTrue = newBlock();
+  const auto ifFalse = newBlock();
+  const auto join = newBlock();
+  condition(id, ifTrue, ifFalse);
+  sealBlock(ifTrue);
+  sealBlock(ifFalse);
+  current = ifTrue;
+  jumpTo(join);
+  current = ifFalse;
+  jumpTo(join);
+  sealBlock(join);
+  current = join;
+
+  const auto phi = function->addPhi(join, IRType::I32);
+  function->addPhiOperand(phi, function->constant(IRType::I32, 1));
+  function->addPhiOperand(phi, function->constant(IRType::I32, 0));
+  return phi;
+}
+
+ValueID Lowering::unary(NodeID id) {
+  const auto& node = ast[id];
+  const auto type = irType(sema.typeOf(id));
+  switch (node.oper()) {
+    case Operator::Plus:
+      return rvalue(node.a);
+    case Operator::Minus:
+      return emit(Opcode::Neg, type, {rvalue(node.a)});
+    case Operator::BitwiseNot:
+      return emit(Opcode::Not, type, {rvalue(node.a)});
+    case Operator::LogicalNot: {
+      const auto value = rvalue(node.a);
+      const auto zero = function->constant((*function)[value].type, 0);
+      return emit(Opcode::Eq, IRType::I32, {value, zero});
+    }
+    case Operator::Dereference:
+      return load(rvalue(node.a), sema.typeOf(id));
+    case Operator::AddressOf:
+      return address(node.a);
+    default:
+      return increment(id);
+  }
+}
+
+ValueID Lowering::increment(NodeID id) {
+  const auto& node = ast[id];
+  const auto op = node.oper();
+  const bool isIncrement =
+      op == Operator::PreIncrement || op == Operator::PostIncrement;
+  const bool isPostfix =
+      op == Operator::PostIncrement || op == Operator::PostDecrement;
+
+  const auto target = lvalue(node.a);
+  const auto type = types.unqualified(target.type);
+  const auto old = read(target);
+  ValueID updated = 0;
+  if (types.isPointer(type)) {
+    const auto step = function->constant(IRType::I64, isIncrement ? 1 : -1);
+    updated = elementAddress(old, step, LONG, types[type].base);
+  } else if (types.kind(type) == TypeKind::Bool) {
+    // ++ sets a _Bool, -- flips it.
+    const auto one = function->constant(IRType::I8, 1);
+    updated = isIncrement ? one : emit(Opcode::Xor, IRType::I8, {old, one});
+  } else {
+    const auto irtype = irType(type);
+    const auto one = function->constant(irtype, 1);
+    updated = emit(isIncrement ? Opcode::Add : Opcode::Sub, irtype, {old, one});
+  }
+  write(target, updated);
+  return isPostfix ? old : updated;
+}
+
+ValueID Lowering::binary(NodeID id) {
+  const auto& node = ast[id];
+  switch (node.oper()) {
+    case Operator::LogicalAnd:
+    case Operator::LogicalOr:
+      return conditionValue(id);
+    case Operator::Comma:
+      effect(node.a);
+      return rvalue(node.b);
+    default:
+      break;
+  }
+  const auto left = rvalue(node.a);
+  const auto right = rvalue(node.b);
+  return arithmetic(node.oper(), left, right, sema.convertedTypeOf(node.a),
+                    sema.convertedTypeOf(node.b), sema.typeOf(id));
+}
+
+ValueID Lowering::arithmetic(Operator op, ValueID left, ValueID right,
+                             TypeID leftType, TypeID rightType,
+                             TypeID resultType) {
+  leftType = types.unqualified(leftType);
+  rightType = types.unqualified(rightType);
+  const bool isLeftPointer = types.isPointer(leftType);
+  const bool isRightPointer = types.isPointer(rightType);
+
+  if (op == Operator::Add && (isLeftPointer || isRightPointer)) {
+    if (isLeftPointer) {
+      return elementAddress(left, right, rightType, types[leftType].base);
+    }
+    return elementAddress(right, left, leftType, types[rightType].base);
+  }
+  if (op == Operator::Subtract && isLeftPointer) {
+    const auto element = types[leftType].base;
+    if (isRightPointer) {
+      const auto size = std::max<std::uint64_t>(sema.sizeOf(element), 1);
+      const auto a = convert(left, leftType, LONG);
+      const auto b = convert(right, rightType, LONG);
+      const auto difference = emit(Opcode::Sub, IRType::I64, {a, b});
+      if (size == 1) return difference;
+      return emit(Opcode::SDiv, IRType::I64,
+                  {difference, function->constant(IRType::I64, size)});
+    }
+    const auto index = convert(right, rightType, LONG);
+    const auto negated =
+        (*function)[index].op == Opcode::Const
+            ? function->constant(IRType::I64, 0 - (*function)[index].imm)
+            : emit(Opcode::Neg, IRType::I64, {index});
+    return elementAddress(left, negated, LONG, element);
+  }
+
+  // Pointers compare unsigned.
+  const bool isSigned = types.isSigned(leftType);
+  Opcode opcode = Opcode::Nop;
+  switch (op) {
+    case Operator::Less: opcode = isSigned ? Opcode::SLt : Opcode::ULt; break;
+    case Operator::Greater: opcode = isSigned ? Opcode::SGt : Opcode::UGt; break;
+    case Operator::LessEqual: opcode = isSigned ? Opcode::SLe : Opcode::ULe; break;
+    case Operator::GreaterEqual: opcode = isSigned ? Opcode::SGe : Opcode::UGe; break;
+    case Operator::Equal: opcode = Opcode::Eq; break;
+    case Operator::NotEqual: opcode = Opcode::Ne; break;
+    default: break;
+  }
+  if (opcode != Opcode::Nop) return emit(opcode, IRType::I32, {left, right});
+
+  const auto type = irType(resultType);
+  const bool isSignedResult = types.isSigned(resultType);
+  switch (op) {
+    case Operator::Multiply: opcode = Opcode::Mul; break;
+    case Operator::Divide: opcode = isSignedResult ? Opcode::SDiv : Opcode::UDiv; break;
+    case Operator::Remainder: opcode = isSignedResult ? Opcode::SRem : Opcode::URem; break;
+    case Operator::Add: opcode = Opcode::Add; break;
+    case Operator::Subtract: opcode = Opcode::Sub; break;
+    case Operator::BitwiseAnd: opcode = Opcode::And; break;
+    case Operator::BitwiseXor: opcode = Opcode::Xor; break;
+    case Operator::BitwiseOr: opcode = Opcode::Or; break;
+    case Operator::ShiftLeft: opcode = Opcode::Shl; break;
+    case Operator::ShiftRight: opcode = isSigned ? Opcode::AShr : Opcode::LShr; break;
+    default: break;
+  }
+  // The operands of a shift are promoted separately.
+  if (op == Operator::ShiftLeft || op == Operator::ShiftRight) {
+    right = convert(right, rightType, leftType);
+  }
+  return emit(opcode, type, {left, right});
+}
+
+ValueID Lowering::assign(NodeID id) {
+  const auto& node = ast[id];
+  const auto target = lvalue(node.a);
+  if (node.oper() == Operator::None) {
+    const auto value = rvalue(node.b);
+    write(target, value);
+    return value;
+  }
+
+  // A compound assignment computes in the type Sema gave the left operand.
+  const auto operationType = sema.convertedTypeOf(node.a);
+  const auto old = convert(read(target), target.type, operationType);
+  const auto right = rvalue(node.b);
+  const auto result =
+      arithmetic(node.oper(), old, right, operationType,
+                 sema.convertedTypeOf(node.b), operationType);
+  const auto value = convert(result, operationType, target.type);
+  write(target, value);
+  return value;
+}
+
+ValueID Lowering::conditional(NodeID id) {
+  const auto& node = ast[id];
+  const auto type = sema.typeOf(id);
+  const bool hasValue = types.kind(type) != TypeKind::Void;
+  const auto then = newBlock();
+  const auto otherwise = newBlock();
+  const auto join = newBlock();
+
+  condition(node.a, then, otherwise);
+  sealBlock(then);
+  sealBlock(otherwise);
+
+  current = then;
+  ValueID thenValue = 0;
+  if (hasValue) {
+    thenValue = rvalue(node.b);
+  } else {
+    effect(node.b);
+  }
+  jumpTo(join);
+  current = otherwise;
+  ValueID otherwiseValue = 0;
+  if (hasValue) {
+    otherwiseValue = rvalue(node.c);
+  } else {
+    effect(node.c);
+  }
+  jumpTo(join);
+  sealBlock(join);
+  current = join;
+  if (!hasValue) return 0;
+
+  const auto phi = function->addPhi(join, irType(type));
+  function->addPhiOperand(phi, thenValue);
+  function->addPhiOperand(phi, otherwiseValue);
+  return phi;
+}
+
+ValueID Lowering::call(NodeID id) {
+  const auto& node = ast[id];
+  const auto functionType = types[sema.convertedTypeOf(node.a)].base;
+  const auto result = types[functionType].base;
+  if (types.isRecord(result)) unsupported(id, "Structures returned by value");
+
+  std::vector<ValueID> operands;
+  operands.push_back(rvalue(node.a));
+  for (const auto argument : ast.list(node.list)) {
+    if (types.isRecord(sema.convertedTypeOf(argument))) {
+      unsupported(argument, "Structures passed by value");
+    }
+    operands.push_back(rvalue(argument));
+  }
+  // Calls without a prototype are made like variadic ones, which works for
+  // both kinds of callee.
+  const auto flags = types[functionType].flags &
+                             (TypeFlag::Variadic | TypeFlag::NoPrototype)
+                         ? InstFlag::Variadic
+                         : 0;
+  return function->append(block(), Opcode::Call, irType(result), operands, 0,
+                          flags);
+}
+
+ValueID Lowering::elementAddress(ValueID pointer, ValueID index,
+                                 TypeID indexType, TypeID element) {
+  // GNU C: void and function pointers step by one byte.
+  const auto size = std::max<std::uint64_t>(sema.sizeOf(element), 1);
+  auto offset = convert(index, indexType, LONG);
+  if ((*function)[offset].op == Opcode::Const) {
+    const auto bits = (*function)[offset].imm * size;
+    if (bits == 0) return pointer;
+    offset = function->constant(IRType::I64, bits);
+  } else if (size != 1) {
+    offset = emit(Opcode::Mul, IRType::I64,
+                  {offset, function->constant(IRType::I64, size)});
+  }
+  return emit(Opcode::Add, IRType::Ptr, {pointer, offset});
+}
+
+ValueID Lowering::convert(ValueID value, TypeID from, TypeID to) {
+  from = types.unqualified(from);
+  to = types.unqualified(to);
+  if (from == to || to == VOID || from == TypeTable::ERROR ||
+      to == TypeTable::ERROR || types.isRecord(to)) {
+    return value;
+  }
+
+  const auto source = (*function)[value].type;
+  const auto isConstant = (*function)[value].op == Opcode::Const;
+  const auto bits = (*function)[value].imm;
+
+  if (types.kind(to) == TypeKind::Bool) {
+    if (isConstant) return function->constant(IRType::I8, bits != 0);
+    const auto zero = function->constant(source, 0);
+    const auto isTrue = emit(Opcode::Ne, IRType::I32, {value, zero});
+    return emit(Opcode::Trunc, IRType::I8, {isTrue});
+  }
+
+  const auto target = irType(to);
+  if (source == target) return value;
+  const bool isSigned = types.isSigned(from);
+  const auto sourceSize = sizeOf(source);
+  const auto targetSize = sizeOf(target);
+  if (isConstant) {
+    // Constants are kept sign-extended from their width.
+    const auto mask = sourceSize == 8 ? ~std::uint64_t{0}
+                                      : (std::uint64_t{1} << sourceSize * 8) - 1;
+    return function->constant(target, isSigned ? bits : bits & mask);
+  }
+  if (targetSize > sourceSize) {
+    return emit(isSigned ? Opcode::SExt : Opcode::ZExt, target, {value});
+  }
+  if (targetSize < sourceSize) return emit(Opcode::Trunc, target, {value});
+  return emit(Opcode::Copy, target, {value});
+}
+
+ValueID Lowering::load(ValueID address, TypeID type) {
+  if (types.isRecord(type)) return address;
+  const std::uint16_t flags =
+      types[type].qualifiers & TypeQualifier::Volatile ? InstFlag::Volatile : 0;
+  return emit(Opcode::Load, irType(type), {address}, 0, flags);
+}
+
+void Lowering::store(ValueID address, ValueID value, TypeID type) {
+  if (types.isRecord(type)) {
+    const auto size = function->constant(IRType::I64, sema.sizeOf(type));
+    callLibrary("memcpy", {address, value, size});
+    return;
+  }
+  const std::uint16_t flags =
+      types[type].qualifiers & TypeQualifier::Volatile ? InstFlag::Volatile : 0;
+  emit(Opcode::Store, IRType::Void, {value, address}, 0, flags);
+}
+
+ValueID Lowering::offsetAddress(ValueID address, std::uint64_t offset) {
+  if (offset == 0) return address;
+  return emit(Opcode::Add, IRType::Ptr,
+              {address, function->constant(IRType::I64, offset)});
+}
+
+void Lowering::callLibrary(const char* name,
+                           std::initializer_list<ValueID> args) {
+  const auto symbol = module.symbol(name);
+  module[symbol].isFunction = true;
+  std::vector<ValueID> operands;
+  operands.push_back(function->symbolAddress(symbol));
+  operands.insert(operands.end(), args.begin(), args.end());
+  function->append(block(), Opcode::Call, IRType::Ptr, operands);
+}
+
+/* Building */
+
+IRType Lowering::irType(TypeID type) {
+  switch (types.kind(type)) {
+    case TypeKind::Void:
+      return IRType::Void;
+    case TypeKind::Bool:
+    case TypeKind::Char:
+    case TypeKind::SignedChar:
+    case TypeKind::UnsignedChar:
+      return IRType::I8;
+    case TypeKind::Short:
+    case TypeKind::UnsignedShort:
+      return IRType::I16;
+    case TypeKind::Error:
+    case TypeKind::Int:
+    case TypeKind::UnsignedInt:
+    case TypeKind::Float:
+    case TypeKind::Enum:
+      return IRType::I32;
+    case TypeKind::Long:
+    case TypeKind::UnsignedLong:
+    case TypeKind::LongLong:
+    case TypeKind::UnsignedLongLong:
+    case TypeKind::Double:
+    case TypeKind::LongDouble:
+      return IRType::I64;
+    default:
+      // Pointers, and the objects handled through their address.
+      return IRType::Ptr;
+  }
+}
+
+BlockID Lowering::newBlock() {
+  const auto id = function->addBlock();
+  sealed.push_back(false);
+  incompletePhis.emplace_back();
+  return id;
+}
+
+// The block to append to. Code after a jump or return that no label makes
+// reachable goes into a block without predecessors.
+BlockID Lowering::block() {
+  if (current == 0) {
+    current = newBlock();
+    sealBlock(current);
+  }
+  return current;
+}
+
+ValueID Lowering::emit(Opcode op, IRType type,
+                       std::initializer_list<ValueID> operands,
+                       std::uint64_t imm, std::uint16_t flags) {
+  return function->append(block(), op, type,
+                          {operands.begin(), operands.size()}, imm, flags);
+}
+
+void Lowering::jumpTo(BlockID target) {
+  if (current != 0) function->jump(current, target);
+  current = 0;
+}
+
+void Lowering::enter(BlockID target) {
+  jumpTo(target);
+  current = target;
+}
+
+// Continue at a block whose predecessors are all known now, unless there are
+// none, e.g. after a loop that is only left by return.
+void Lowering::continueAt(BlockID target) {
+  sealBlock(target);
+  if (function->block(target).predecessors.empty()) {
+    function->removeBlock(target);
+    current = 0;
+  } else {
+    current = target;
+  }
+}
+
+// The block of a label, case or default. Goto can jump to a label from
+// anywhere, so these are sealed when the function is complete.
+BlockID Lowering::labelBlock(NodeID label) {
+  if (const auto it = labelBlocks.find(label); it != labelBlocks.end()) {
+    return it->second;
+  }
+  const auto id = newBlock();
+  labelBlocks.emplace(label, id);
+  return id;
+}
+
+/* SSA construction */
+
+void Lowering::writeVariable(std::uint32_t variable, BlockID block,
+                             ValueID value) {
+  definitions[definitionKey(variable, block)] = value;
+}
+
+ValueID Lowering::readVariable(std::uint32_t variable, BlockID block) {
+  const auto it = definitions.find(definitionKey(variable, block));
+  if (it != definitions.end()) return resolve(it->second);
+  return readVariableRecursive(variable, block);
+}
+
+ValueID Lowering::readVariableRecursive(std::uint32_t variable,
+                                        BlockID block) {
+  const auto type = variableTypes[variable];
+  const auto& predecessors = function->block(block).predecessors;
+  ValueID value = 0;
+  if (!sealed[block]) {
+    value = function->addPhi(block, type);
+    incompletePhis[block].emplace_back(value, variable);
+  } else if (predecessors.empty()) {
+    // Read before it is assigned, any value will do.
+    value = function->constant(type, 0);
+  } else if (predecessors.size() == 1) {
+    value = readVariable(variable, predecessors[0]);
+  } else {
+    // The phi is the definition while its operands are read, which ends the
+    // recursion at loops.
+    value = function->addPhi(block, type);
+    writeVariable(variable, block, value);
+    value = addPhiOperands(variable, value);
+  }
+  writeVariable(variable, block, value);
+  return value;
+}
+
+ValueID Lowering::addPhiOperands(std::uint32_t variable, ValueID phi) {
+  const auto block = (*function)[phi].block;
+  const auto count = function->block(block).predecessors.size();
+  for (std::size_t i = 0; i < count; i++) {
+    const auto predecessor = function->block(block).predecessors[i];
+    function->addPhiOperand(phi, readVariable(variable, predecessor));
+  }
+  return tryRemoveTrivialPhi(phi);
+}
+
+ValueID Lowering::tryRemoveTrivialPhi(ValueID phi) {
+  ValueID same = 0;
+  for (const auto operand : function->operands(phi)) {
+    const auto value = resolve(operand);
+    if (value == same || value == phi) continue;
+    if (same != 0) return phi;
+    same = value;
+  }
+  // Only reachable from itself.
+  if (same == 0) same = function->constant((*function)[phi].type, 0);
+
+  if (replacements.size() <= phi) replacements.resize(function->size());
+  replacements[phi] = same;
+  function->remove(phi);
+  return same;
+}
+
+void Lowering::sealBlock(BlockID block) {
+  if (sealed[block]) return;
+  for (std::size_t i = 0; i < incompletePhis[block].size(); i++) {
+    const auto [phi, variable] = incompletePhis[block][i];
+    addPhiOperands(variable, phi);
+  }
+  incompletePhis[block].clear();
+  sealed[block] = true;
+}
+
+ValueID Lowering::resolve(ValueID value) {
+  auto root = value;
+  while (root < replacements.size() && replacements[root] != 0) {
+    root = replacements[root];
+  }
+  while (value != root) {
+    const auto next = replacements[value];
+    replacements[value] = root;
+    value = next;
+  }
+  return root;
+}
+
+// Seal the label blocks, remove the phis that became trivial when a phi they
+// use was removed and forward the uses of removed phis.
+void Lowering::finishFunction() {
+  for (BlockID id = 1; id < function->numberOfBlocks(); id++) sealBlock(id);
+
+  const auto blocks = function->liveBlocks();
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (const auto id : blocks) {
+      for (const auto phi : function->block(id).phis) {
+        if ((*function)[phi].op != Opcode::Phi) continue;
+        if (tryRemoveTrivialPhi(phi) != phi) changed = true;
+      }
+    }
+  }
+
+  if (!replacements.empty()) {
+    for (const auto id : blocks) {
+      const auto& block = function->block(id);
+      for (const auto* list : {&block.phis, &block.insts}) {
+        for (const auto inst : *list) {
+          if ((*function)[inst].op == Opcode::Nop) continue;
+          for (auto& operand : function->operands(inst)) {
+            operand = resolve(operand);
+          }
+        }
+      }
+    }
+  }
+  function->sweep();
+}
+
+void Lowering::unsupported(NodeID node, std::string_view what) {
+  const auto start = ast[node].offset;
+  errOut.reportsError(
+      Error{ErrorID::UnsupportedConstruct, {start, start + 1}, {what}});
+}
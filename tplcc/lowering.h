@@ -0,0 +1,180 @@
+#ifndef TPLCC_LOWERING_H
+#define TPLCC_LOWERING_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ast.h"
+#include "error.h"
+#include "ir.h"
+#include "sema.h"
+#include "string-interner.h"
+#include "types.h"
+
+// Translates a checked translation unit into the IR, building SSA form as it
+// goes (Braun et al., "Simple and Efficient Construction of Static Single
+// Assignment Form", CC 2013), so no separate phi placement or mem2reg pass is
+// needed:
+//
+// - A local scalar whose address is never taken is a variable. Assigning to
+//   it records the value as its current definition in the current block,
+//   reading it looks the definition up, in the predecessors if the block
+//   hasn't got one, with a phi where several of them meet.
+// - A block is sealed once all its predecessors are known. Reading a
+//   variable in a block that isn't sealed yet gives an incomplete phi, whose
+//   operands are added when the block is sealed.
+// - A phi whose operands are all the same value (or the phi itself) is
+//   replaced by that value. Uses are forwarded to the replacement when the
+//   function is complete.
+//
+// All other objects (arrays, structs, locals whose address is taken,
+// volatile ones) live in an Alloca in the entry block and are loaded and
+// stored.
+//
+// Floating point, bit-fields, variable length arrays and passing or
+// returning structs by value are reported as unsupported.
+class Lowering {
+  // Where the value of an lvalue is: a variable (its index plus one) or the
+  // address of an object in memory.
+  struct LValue {
+    ValueID address = 0;
+    std::uint32_t variable = 0;
+    TypeID type = 0;
+  };
+
+  const AST& ast;
+  const StringInterner& strings;
+  const Sema& sema;
+  const TypeTable& types;
+  Module& module;
+  IReportError& errOut;
+
+  // Symbols of the static locals, by VarDecl, and the globals by symbol.
+  std::unordered_map<NodeID, std::uint32_t> staticLocals;
+  std::unordered_map<std::uint32_t, std::size_t> globalIndex;
+  std::unordered_map<std::string, std::uint32_t> stringLiterals;
+
+  // The function being lowered and the block instructions are appended to,
+  // 0 after a terminator until the next reachable block starts.
+  Function* function = nullptr;
+  NodeID functionDecl = 0;
+  BlockID current = 0;
+
+  // Locals in memory by their declaration, and the variables.
+  std::unordered_map<NodeID, ValueID> addresses;
+  std::unordered_map<NodeID, std::uint32_t> variableIndex;
+  std::vector<IRType> variableTypes;
+
+  // The current definition of every variable, by variable and block.
+  std::unordered_map<std::uint64_t, ValueID> definitions;
+  std::vector<bool> sealed;
+  std::vector<std::vector<std::pair<ValueID, std::uint32_t>>> incompletePhis;
+  // The values the removed phis were replaced by, 0 if not replaced.
+  std::vector<ValueID> replacements;
+
+  std::vector<BlockID> breakTargets;
+  std::vector<BlockID> continueTargets;
+  // The blocks of LabelStmts, CaseStmts and DefaultStmts.
+  std::unordered_map<NodeID, BlockID> labelBlocks;
+
+ public:
+  Lowering(const AST& ast, const StringInterner& strings, const Sema& sema,
+           Module& module, IReportError& errOut);
+
+  // Add the functions and the objects defined by the translation unit to
+  // the module.
+  void lower(NodeID translationUnit);
+
+ private:
+  // Declarations
+  void lowerFunction(NodeID definition);
+  void lowerGlobal(NodeID decl, std::uint32_t symbol);
+  std::uint32_t symbolOf(NodeID decl);
+  std::uint32_t stringLiteral(NodeID id);
+  void collectLocals(NodeID definition);
+  void localDeclarations(NodeID group);
+
+  // Initializers. walkInitializer calls visit(type, expression, offset) for
+  // every scalar, every string literal initializing an array and every
+  // struct initialized by an expression.
+  template <typename Visit>
+  void walkInitializer(TypeID type, NodeID init, std::uint64_t offset,
+                       Visit& visit);
+  template <typename Visit>
+  void walkInitList(TypeID type, NodeID list, std::uint64_t offset,
+                    Visit& visit);
+  bool memberAt(TypeID aggregate, std::size_t index, TypeID* type,
+                std::uint64_t* offset);
+  NodeID findField(NodeID definition, StringID name,
+                   std::uint64_t* offset) const;
+  void initialize(ValueID address, TypeID type, NodeID init);
+  void constantInitializer(GlobalData& global, TypeID type, NodeID init,
+                           std::uint64_t offset);
+  bool addressConstant(NodeID id, std::uint32_t* symbol,
+                       std::int64_t* addend);
+  bool objectAddressConstant(NodeID id, std::uint32_t* symbol,
+                             std::int64_t* addend);
+
+  // Statements
+  void statement(NodeID id);
+  void ifStatement(NodeID id);
+  void whileStatement(NodeID id);
+  void doStatement(NodeID id);
+  void forStatement(NodeID id);
+  void switchStatement(NodeID id);
+  void returnStatement(NodeID id);
+
+  // Expressions
+  ValueID rvalue(NodeID id);
+  ValueID compute(NodeID id);
+  ValueID address(NodeID id);
+  LValue lvalue(NodeID id);
+  ValueID read(const LValue& lvalue);
+  void write(const LValue& lvalue, ValueID value);
+  void effect(NodeID id);
+  void condition(NodeID id, BlockID ifTrue, BlockID ifFalse);
+  ValueID conditionValue(NodeID id);
+  ValueID unary(NodeID id);
+  ValueID increment(NodeID id);
+  ValueID binary(NodeID id);
+  ValueID arithmetic(Operator op, ValueID left, ValueID right,
+                     TypeID leftType, TypeID rightType, TypeID resultType);
+  ValueID assign(NodeID id);
+  ValueID conditional(NodeID id);
+  ValueID call(NodeID id);
+  ValueID elementAddress(ValueID pointer, ValueID index, TypeID indexType,
+                         TypeID element);
+  ValueID convert(ValueID value, TypeID from, TypeID to);
+  ValueID load(ValueID address, TypeID type);
+  void store(ValueID address, ValueID value, TypeID type);
+  ValueID offsetAddress(ValueID address, std::uint64_t offset);
+  void callLibrary(const char* name, std::initializer_list<ValueID> args);
+
+  // Building
+  IRType irType(TypeID type);
+  BlockID newBlock();
+  BlockID block();
+  ValueID emit(Opcode op, IRType type, std::initializer_list<ValueID> operands,
+               std::uint64_t imm = 0, std::uint16_t flags = 0);
+  void jumpTo(BlockID target);
+  void enter(BlockID target);
+  void continueAt(BlockID target);
+  BlockID labelBlock(NodeID label);
+
+  // SSA construction
+  void writeVariable(std::uint32_t variable, BlockID block, ValueID value);
+  ValueID readVariable(std::uint32_t variable, BlockID block);
+  ValueID readVariableRecursive(std::uint32_t variable, BlockID block);
+  ValueID addPhiOperands(std::uint32_t variable, ValueID phi);
+  ValueID tryRemoveTrivialPhi(ValueID phi);
+  void sealBlock(BlockID block);
+  ValueID resolve(ValueID value);
+  void finishFunction();
+
+  void unsupported(NodeID node, std::string_view what);
+};
+
+#endif
@@ -0,0 +1,441 @@
+#include "machine-code.h"
+
+#include <initializer_list>
+
+namespace {
+using X86::Condition;
+using X86::Instruction;
+using X86::Mnemonic;
+using X86::Operand;
+
+bool fitsInInt8(std::int64_t value) {
+  return value == static_cast<std::int8_t>(value);
+}
+
+// The number in the ModRM reg field of ADD, OR, AND, SUB, XOR and CMP, the
+// group 1 instructions, and of the shifts in group 2.
+std::uint8_t extensionOf(Mnemonic mnemonic) {
+  switch (mnemonic) {
+    case Mnemonic::Add: return 0;
+    case Mnemonic::Or: return 1;
+    case Mnemonic::And: return 4;
+    case Mnemonic::Sub: return 5;
+    case Mnemonic::Xor: return 6;
+    case Mnemonic::Cmp: return 7;
+    case Mnemonic::Shl: return 4;
+    case Mnemonic::Shr: return 5;
+    case Mnemonic::Sar: return 7;
+    case Mnemonic::Neg: return 3;
+    case Mnemonic::Not: return 2;
+    case Mnemonic::Div: return 6;
+    default: return 7;  // IDiv
+  }
+}
+
+// SPL, BPL, SIL and DIL are only there with a REX prefix, without one
+// their numbers are AH, CH, DH and BH.
+bool needsRexAsByte(X86::Register reg) { return reg >= 4 && reg < 8; }
+
+class Encoder {
+  MachineCode& code;
+  // The code of the function without the jumps, which are put in once
+  // their sizes are known, and its relocations.
+  std::string bytes;
+  std::vector<CodeRelocation> relocations;
+
+  struct Jump {
+    // Where it goes in bytes.
+    std::uint64_t offset;
+    std::uint32_t label;
+    bool isConditional;
+    Condition condition;
+    bool isLong = false;
+  };
+  std::vector<Jump> jumps;
+  // The size of the jumps before each one, and of all of them at the end.
+  std::vector<std::uint64_t> before;
+
+  struct LabelPosition {
+    std::uint64_t offset = 0;
+    // The number of jumps before it.
+    std::size_t jumps = 0;
+  };
+  std::vector<LabelPosition> labels;
+
+ public:
+  explicit Encoder(MachineCode& code) : code(code) {}
+
+  void run(const MachineFunction& function);
+
+ private:
+  void instruction(const Instruction& inst);
+  void move(const Instruction& inst);
+  void arithmetic(const Instruction& inst);
+  void shift(const Instruction& inst);
+  void relaxJumps();
+  void finish();
+
+  void put(std::uint8_t byte) { bytes.push_back(static_cast<char>(byte)); }
+  void putImmediate(std::int64_t value, std::uint32_t size);
+  void putRex(bool isWide, std::uint8_t reg, std::uint8_t base, bool force);
+  void withModRM(std::initializer_list<std::uint8_t> opcode,
+                 std::uint32_t size, std::uint8_t reg, std::uint32_t regSize,
+                 const Operand& rm, std::uint32_t rmSize,
+                 std::uint32_t immediateSize = 0, std::int64_t immediate = 0);
+};
+
+void Encoder::run(const MachineFunction& function) {
+  labels.resize(function.numberOfLabels);
+  for (const auto& inst : function.code) instruction(inst);
+  relaxJumps();
+  finish();
+}
+
+void Encoder::instruction(const Instruction& inst) {
+  const auto& destination = inst.destination;
+  const auto& source = inst.source;
+  const auto size = static_cast<std::uint32_t>(inst.size);
+  switch (inst.mnemonic) {
+    case Mnemonic::Label:
+      labels[destination.symbol] = {bytes.size(), jumps.size()};
+      return;
+    case Mnemonic::Mov:
+      return move(inst);
+    case Mnemonic::MovSX:
+    case Mnemonic::MovZX: {
+      const bool isSigned = inst.mnemonic == Mnemonic::MovSX;
+      if (isSigned && inst.sourceSize == 4) {
+        return withModRM({0x63}, size, destination.reg, size, source, 4);
+      }
+      const std::uint8_t opcode = (isSigned ? 0xBE : 0xB6) +
+                                  (inst.sourceSize == 2 ? 1 : 0);
+      return withModRM({0x0F, opcode}, size, destination.reg, size, source,
+                       inst.sourceSize);
+    }
+    case Mnemonic::Lea:
+      return withModRM({0x8D}, 8, destination.reg, 8, source, 8);
+    case Mnemonic::Add:
+    case Mnemonic::Sub:
+    case Mnemonic::And:
+    case Mnemonic::Or:
+    case Mnemonic::Xor:
+    case Mnemonic::Cmp:
+      return arithmetic(inst);
+    case Mnemonic::IMul:
+      if (source.kind == Operand::Kind::Immediate) {
+        const bool isShort = fitsInInt8(source.value);
+        return withModRM({static_cast<std::uint8_t>(isShort ? 0x6B : 0x69)},
+                         size, destination.reg, size, destination, size,
+                         isShort ? 1 : 4, source.value);
+      }
+      return withModRM({0x0F, 0xAF}, size, destination.reg, size, source,
+                       size);
+    case Mnemonic::Test:
+      return withModRM({static_cast<std::uint8_t>(size == 1 ? 0x84 : 0x85)},
+                       size, source.reg, size, destination, size);
+    case Mnemonic::Shl:
+    case Mnemonic::Shr:
+    case Mnemonic::Sar:
+      return shift(inst);
+    case Mnemonic::Neg:
+    case Mnemonic::Not:
+    case Mnemonic::IDiv:
+    case Mnemonic::Div:
+      return withModRM({static_cast<std::uint8_t>(size == 1 ? 0xF6 : 0xF7)},
+                       size, extensionOf(inst.mnemonic), 0, destination,
+                       size);
+    case Mnemonic::SignExtendAccumulator:
+      if (size == 8) put(0x48);
+      return put(0x99);
+    case Mnemonic::SetCC:
+      return withModRM(
+          {0x0F, static_cast<std::uint8_t>(
+                     0x90 + static_cast<std::uint8_t>(inst.condition))},
+          1, 0, 0, destination, 1);
+    case Mnemonic::Jcc:
+    case Mnemonic::Jmp:
+      if (destination.kind == Operand::Kind::Label) {
+        jumps.push_back({bytes.size(), destination.symbol,
+                         inst.mnemonic == Mnemonic::Jcc, inst.condition});
+        return;
+      }
+      // JMP and CALL are 64 bits without REX.W.
+      return withModRM({0xFF}, 4, 4, 0, destination, 8);
+    case Mnemonic::Call:
+      if (destination.kind == Operand::Kind::Symbol) {
+        put(0xE8);
+        relocations.push_back({bytes.size(), destination.symbol,
+                               CodeRelocation::Kind::PLT32, -4});
+        return putImmediate(0, 4);
+      }
+      return withModRM({0xFF}, 4, 2, 0, destination, 8);
+    case Mnemonic::Ret:
+      return put(0xC3);
+    case Mnemonic::Push:
+      if (destination.kind == Operand::Kind::Register) {
+        if (destination.reg >= 8) put(0x41);
+        return put(0x50 + (destination.reg & 7));
+      }
+      if (destination.kind == Operand::Kind::Immediate) {
+        const bool isShort = fitsInInt8(destination.value);
+        put(isShort ? 0x6A : 0x68);
+        return putImmediate(destination.value, isShort ? 1 : 4);
+      }
+      return withModRM({0xFF}, 4, 6, 0, destination, 8);
+    case Mnemonic::Pop:
+      if (destination.reg >= 8) put(0x41);
+      return put(0x58 + (destination.reg & 7));
+    case Mnemonic::Leave:
+      return put(0xC9);
+    case Mnemonic::Ud2:
+      put(0x0F);
+      return put(0x0B);
+  }
+}
+
+void Encoder::move(const Instruction& inst) {
+  const auto& destination = inst.destination;
+  const auto& source = inst.source;
+  const auto size = static_cast<std::uint32_t>(inst.size);
+  if (source.kind == Operand::Kind::Immediate) {
+    const bool fitsInInt32 =
+        source.value == static_cast<std::int32_t>(source.value);
+    if (destination.kind == Operand::Kind::Register &&
+        (size != 8 || !fitsInInt32)) {
+      // B8+r with an immediate of the full size, MOVABS for 64 bits.
+      if (size == 2) put(0x66);
+      putRex(size == 8, 0, destination.reg,
+             size == 1 && needsRexAsByte(destination.reg));
+      put((size == 1 ? 0xB0 : 0xB8) + (destination.reg & 7));
+      return putImmediate(source.value, size);
+    }
+    return withModRM({static_cast<std::uint8_t>(size == 1 ? 0xC6 : 0xC7)},
+                     size, 0, 0, destination, size, size < 4 ? size : 4,
+                     source.value);
+  }
+  if (source.kind == Operand::Kind::Register) {
+    return withModRM({static_cast<std::uint8_t>(size == 1 ? 0x88 : 0x89)},
+                     size, source.reg, size, destination, size);
+  }
+  withModRM({static_cast<std::uint8_t>(size == 1 ? 0x8A : 0x8B)}, size,
+            destination.reg, size, source, size);
+}
+
+void Encoder::arithmetic(const Instruction& inst) {
+  const auto& destination = inst.destination;
+  const auto& source = inst.source;
+  const auto size = static_cast<std::uint32_t>(inst.size);
+  const auto extension = extensionOf(inst.mnemonic);
+  const std::uint8_t base = extension * 8 + (size == 1 ? 0 : 1);
+  if (source.kind == Operand::Kind::Register) {
+    return withModRM({base}, size, source.reg, size, destination, size);
+  }
+  if (source.kind == Operand::Kind::Memory) {
+    return withModRM({static_cast<std::uint8_t>(base + 2)}, size,
+                     destination.reg, size, source, size);
+  }
+
+  const auto immediateSize = size < 4 ? size : 4;
+  if (size == 1) {
+    return withModRM({0x80}, size, extension, 0, destination, size, 1,
+                     source.value);
+  }
+  if (fitsInInt8(source.value)) {
+    return withModRM({0x83}, size, extension, 0, destination, size, 1,
+                     source.value);
+  }
+  if (destination.isRegister(X86::RAX)) {
+    // The short form with the accumulator.
+    if (size == 2) put(0x66);
+    putRex(size == 8, 0, 0, false);
+    put(base + 4);
+    return putImmediate(source.value, immediateSize);
+  }
+  withModRM({0x81}, size, extension, 0, destination, size, immediateSize,
+            source.value);
+}
+
+void Encoder::shift(const Instruction& inst) {
+  const auto& destination = inst.destination;
+  const auto& source = inst.source;
+  const auto size = static_cast<std::uint32_t>(inst.size);
+  const auto extension = extensionOf(inst.mnemonic);
+  const std::uint8_t isWord = size == 1 ? 0 : 1;
+  if (source.kind == Operand::Kind::Register) {
+    // By CL.
+    return withModRM({static_cast<std::uint8_t>(0xD2 + isWord)}, size,
+                     extension, 0, destination, size);
+  }
+  if (source.value == 1) {
+    return withModRM({static_cast<std::uint8_t>(0xD0 + isWord)}, size,
+                     extension, 0, destination, size);
+  }
+  withModRM({static_cast<std::uint8_t>(0xC0 + isWord)}, size, extension, 0,
+            destination, size, 1, source.value);
+}
+
+void Encoder::putImmediate(std::int64_t value, std::uint32_t size) {
+  const auto bits = static_cast<std::uint64_t>(value);
+  for (std::uint32_t i = 0; i < size; i++) put((bits >> (8 * i)) & 0xFF);
+}
+
+void Encoder::putRex(bool isWide, std::uint8_t reg, std::uint8_t base,
+                     bool force) {
+  const std::uint8_t rex = (isWide ? 8 : 0) | ((reg >> 3) << 2) | (base >> 3);
+  if (rex != 0 || force) put(0x40 | rex);
+}
+
+// The prefixes for the operand size, the opcode, the ModRM byte with reg
+// and the register or memory operand rm, and an immediate. regSize and
+// rmSize are the sizes they are accessed with, 0 for reg if it extends the
+// opcode.
+void Encoder::withModRM(std::initializer_list<std::uint8_t> opcode,
+                        std::uint32_t size, std::uint8_t reg,
+                        std::uint32_t regSize, const Operand& rm,
+                        std::uint32_t rmSize, std::uint32_t immediateSize,
+                        std::int64_t immediate) {
+  const bool isRegister = rm.kind == Operand::Kind::Register;
+  const bool isRipRelative = rm.isRipRelative();
+  const std::uint8_t base = isRipRelative ? 0 : rm.reg;
+  const bool forceRex =
+      (regSize == 1 && needsRexAsByte(static_cast<X86::Register>(reg))) ||
+      (isRegister && rmSize == 1 && needsRexAsByte(rm.reg));
+  if (size == 2) put(0x66);
+  putRex(size == 8, reg, base, forceRex);
+  for (const auto byte : opcode) put(byte);
+
+  const std::uint8_t regBits = (reg & 7) << 3;
+  if (isRegister) {
+    put(0xC0 | regBits | (rm.reg & 7));
+    return putImmediate(immediate, immediateSize);
+  }
+  if (isRipRelative) {
+    put(0x05 | regBits);
+    // Relative to the end of the instruction, after the immediate.
+    relocations.push_back(
+        {bytes.size(), rm.symbol,
+         rm.isExternal ? CodeRelocation::Kind::GOTPCREL
+                       : CodeRelocation::Kind::PC32,
+         rm.value - 4 - static_cast<std::int64_t>(immediateSize)});
+    putImmediate(0, 4);
+    return putImmediate(immediate, immediateSize);
+  }
+
+  // RBP and R13 as the base without a displacement mean RIP-relative, RSP
+  // and R12 need a SIB byte.
+  const std::uint8_t mod = rm.value == 0 && (base & 7) != X86::RBP ? 0x00
+                           : fitsInInt8(rm.value)                  ? 0x40
+                                                                   : 0x80;
+  put(mod | regBits | (base & 7));
+  if ((base & 7) == X86::RSP) put(0x24);
+  if (mod == 0x40) putImmediate(rm.value, 1);
+  if (mod == 0x80) putImmediate(rm.value, 4);
+  putImmediate(immediate, immediateSize);
+}
+
+// Makes the jumps that don't reach their labels with 8 bits long until all
+// of them do. Jumps only get longer, so it ends.
+void Encoder::relaxJumps() {
+  before.assign(jumps.size() + 1, 0);
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (std::size_t i = 0; i < jumps.size(); i++) {
+      const auto& jump = jumps[i];
+      before[i + 1] = before[i] + (jump.isLong ? (jump.isConditional ? 6 : 5)
+                                               : 2);
+    }
+    for (std::size_t i = 0; i < jumps.size(); i++) {
+      auto& jump = jumps[i];
+      if (jump.isLong) continue;
+      const auto& label = labels[jump.label];
+      const auto target = static_cast<std::int64_t>(label.offset +
+                                                    before[label.jumps]);
+      const auto end = static_cast<std::int64_t>(jump.offset + before[i + 1]);
+      if (!fitsInInt8(target - end)) {
+        jump.isLong = true;
+        changed = true;
+      }
+    }
+  }
+}
+
+// Appends the function with its jumps to the code.
+void Encoder::finish() {
+  const auto start = code.bytes.size();
+  code.bytes.reserve(start + bytes.size() + 6 * jumps.size());
+  auto putTo = [&](std::uint8_t byte) {
+    code.bytes.push_back(static_cast<char>(byte));
+  };
+  std::size_t relocation = 0;
+  auto copyUpTo = [&](std::uint64_t end, std::size_t jumpsBefore) {
+    const auto from = code.bytes.size() - start - before[jumpsBefore];
+    code.bytes.append(bytes, from, end - from);
+    for (; relocation < relocations.size() &&
+           relocations[relocation].offset < end;
+         relocation++) {
+      auto moved = relocations[relocation];
+      moved.offset += start + before[jumpsBefore];
+      code.relocations.push_back(moved);
+    }
+  };
+  for (std::size_t i = 0; i < jumps.size(); i++) {
+    const auto& jump = jumps[i];
+    copyUpTo(jump.offset, i);
+    const auto& label = labels[jump.label];
+    const auto target =
+        static_cast<std::int64_t>(label.offset + before[label.jumps]);
+    const auto end = static_cast<std::int64_t>(jump.offset + before[i + 1]);
+    const auto displacement = target - end;
+    const auto condition = static_cast<std::uint8_t>(jump.condition);
+    if (!jump.isLong) {
+      putTo(jump.isConditional ? 0x70 + condition : 0xEB);
+      putTo(static_cast<std::uint8_t>(displacement));
+      continue;
+    }
+    if (jump.isConditional) {
+      putTo(0x0F);
+      putTo(0x80 + condition);
+    } else {
+      putTo(0xE9);
+    }
+    const auto bits = static_cast<std::uint32_t>(displacement);
+    for (int j = 0; j < 4; j++) putTo((bits >> (8 * j)) & 0xFF);
+  }
+  copyUpTo(bytes.size(), jumps.size());
+}
+}  // namespace
+
+void encode(const MachineFunction& function, MachineCode& code) {
+  Encoder(code).run(function);
+}
+
+std::vector<std::uint64_t> encodeAll(
+    std::span<const MachineFunction> functions, MachineCode& code,
+    ThreadPool* pool, TimeReport* report) {
+  std::vector<std::uint64_t> starts(functions.size());
+  if (pool == nullptr) {
+    for (std::size_t i = 0; i < functions.size(); i++) {
+      starts[i] = code.bytes.size();
+      encode(functions[i], code);
+    }
+    return starts;
+  }
+
+  // The code of a function doesn't depend on where it is, only the offsets
+  // of its relocations move.
+  std::vector<MachineCode> pieces(functions.size());
+  parallelFor(pool, functions.size(), [&](std::size_t i) {
+    TimeReport::HelperScope scope(report, Phase::Codegen);
+    encode(functions[i], pieces[i]);
+  });
+  for (std::size_t i = 0; i < functions.size(); i++) {
+    const auto start = code.bytes.size();
+    starts[i] = start;
+    code.bytes += pieces[i].bytes;
+    for (auto relocation : pieces[i].relocations) {
+      relocation.offset += start;
+      code.relocations.push_back(relocation);
+    }
+  }
+  return starts;
+}
@@ -0,0 +1,55 @@
+#ifndef TPLCC_MACHINE_CODE_H
+#define TPLCC_MACHINE_CODE_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "code-generation.h"
+#include "thread-pool.h"
+#include "time-report.h"
+
+// A place in encoded code that refers to a symbol, filled in by the linker
+// or, when the code is run in place, by whoever loads it. All of them are
+// 32 bits relative to their own address P, the value written is
+//
+// - PC32: S + A - P, the symbol S itself.
+// - PLT32: L + A - P, the entry L in the PLT for a call, or the symbol if
+//   the call can go there directly.
+// - GOTPCREL: G + A - P, the entry G in the GOT that holds the address of
+//   the symbol.
+struct CodeRelocation {
+  enum class Kind : std::uint8_t { PC32, PLT32, GOTPCREL };
+
+  std::uint64_t offset = 0;
+  std::uint32_t symbol = 0;
+  Kind kind = Kind::PC32;
+  std::int64_t addend = 0;
+};
+
+// The code of one or more functions one after the other.
+struct MachineCode {
+  std::string bytes;
+  std::vector<CodeRelocation> relocations;
+};
+
+// Append the machine code of a function to code, the relocations at offsets
+// from the start of code.bytes.
+//
+// Every jump is first assumed to reach its label with an 8-bit
+// displacement, the ones that don't get a 32-bit one and the code after
+// them moves, until all of them reach. Everything else is encoded in the
+// same form GNU as picks for the assembly writer's output, apart from the
+// occasional redundant REX prefix.
+void encode(const MachineFunction& function, MachineCode& code);
+
+// Encode the functions one after the other, the same as encode does, and
+// return where each one starts in code.bytes. With a pool, its threads
+// encode the functions into pieces of their own, which are joined in order
+// afterwards, their allocations counted for Codegen in the report.
+std::vector<std::uint64_t> encodeAll(
+    std::span<const MachineFunction> functions, MachineCode& code,
+    ThreadPool* pool = nullptr, TimeReport* report = nullptr);
+
+#endif
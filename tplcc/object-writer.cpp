@@ -0,0 +1,346 @@
+#include "object-writer.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "machine-code.h"
+
+namespace {
+// From the System V ABI and its x86-64 supplement.
+constexpr std::uint16_t ET_REL = 1;
+constexpr std::uint16_t EM_X86_64 = 62;
+constexpr std::uint32_t SHT_PROGBITS = 1;
+constexpr std::uint32_t SHT_SYMTAB = 2;
+constexpr std::uint32_t SHT_STRTAB = 3;
+constexpr std::uint32_t SHT_RELA = 4;
+constexpr std::uint32_t SHT_NOBITS = 8;
+constexpr std::uint64_t SHF_WRITE = 0x1;
+constexpr std::uint64_t SHF_ALLOC = 0x2;
+constexpr std::uint64_t SHF_EXECINSTR = 0x4;
+constexpr std::uint64_t SHF_INFO_LINK = 0x40;
+constexpr std::uint8_t STB_LOCAL = 0;
+constexpr std::uint8_t STB_GLOBAL = 1;
+constexpr std::uint8_t STT_NOTYPE = 0;
+constexpr std::uint8_t STT_OBJECT = 1;
+constexpr std::uint8_t STT_FUNC = 2;
+constexpr std::uint32_t R_X86_64_64 = 1;
+constexpr std::uint32_t R_X86_64_PC32 = 2;
+constexpr std::uint32_t R_X86_64_GOTPCREL = 9;
+constexpr std::uint32_t R_X86_64_PLT32 = 4;
+
+constexpr std::uint64_t HEADER_SIZE = 64;
+constexpr std::uint64_t SECTION_HEADER_SIZE = 64;
+constexpr std::uint64_t SYMBOL_SIZE = 24;
+constexpr std::uint64_t RELOCATION_SIZE = 24;
+
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t align) {
+  return (value + align - 1) / align * align;
+}
+
+// Little-endian fields.
+void putField(std::string& to, std::uint64_t value, std::uint32_t size) {
+  for (std::uint32_t i = 0; i < size; i++) {
+    to.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+std::uint32_t relocationType(CodeRelocation::Kind kind) {
+  switch (kind) {
+    case CodeRelocation::Kind::PC32: return R_X86_64_PC32;
+    case CodeRelocation::Kind::PLT32: return R_X86_64_PLT32;
+    default: return R_X86_64_GOTPCREL;
+  }
+}
+
+struct Section {
+  const char* name;
+  std::uint32_t type;
+  std::uint64_t flags;
+  std::uint64_t align = 1;
+  std::string bytes{};
+  // Differs from the size of the bytes for .bss.
+  std::uint64_t size = 0;
+  std::uint32_t link = 0;
+  std::uint32_t info = 0;
+  std::uint64_t entrySize = 0;
+  std::uint32_t nameOffset = 0;
+  std::uint64_t offset = 0;
+};
+
+struct Relocation {
+  std::uint64_t offset;
+  std::uint32_t symbol;
+  std::uint32_t type;
+  std::int64_t addend;
+};
+
+// Where a symbol is defined.
+struct Definition {
+  std::uint16_t section = 0;
+  std::uint64_t value = 0;
+  std::uint64_t size = 0;
+};
+
+class ObjectWriter {
+  const Module& module;
+  std::span<const MachineFunction> functions;
+  ThreadPool* pool;
+  TimeReport* report;
+
+  // The sections with content, in the order of their headers after the
+  // null one, the .rela sections come after them.
+  enum : std::uint16_t { TEXT = 1, DATA, RELRO, RODATA, BSS, NOTE, COUNT };
+  std::vector<Section> sections;
+  std::vector<std::vector<Relocation>> relocations;
+  std::vector<Definition> definitions;
+  // The index of each symbol in the symbol table, 0 if it isn't in there.
+  std::vector<std::uint32_t> symbolIndex;
+
+ public:
+  ObjectWriter(const Module& module,
+               std::span<const MachineFunction> functions, ThreadPool* pool,
+               TimeReport* report)
+      : module(module),
+        functions(functions),
+        pool(pool),
+        report(report),
+        relocations(COUNT),
+        definitions(module.numberOfSymbols()),
+        symbolIndex(module.numberOfSymbols()) {
+    sections.push_back({"", 0, 0, 0});
+    sections.push_back(
+        {".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16});
+    sections.push_back({".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE});
+    sections.push_back({".data.rel.ro", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE});
+    sections.push_back({".rodata", SHT_PROGBITS, SHF_ALLOC});
+    sections.push_back({".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE});
+    // The stack doesn't have to be executable.
+    sections.push_back({".note.GNU-stack", SHT_PROGBITS, 0});
+  }
+
+  void write(BufferedWriter& out);
+
+ private:
+  void text();
+  void globals();
+  void symbolTable();
+  void relocationSections(std::uint32_t symbolTable);
+  void reference(std::uint32_t symbol) {
+    if (symbolIndex[symbol] == 0) symbolIndex[symbol] = 1;
+  }
+};
+
+void ObjectWriter::write(BufferedWriter& out) {
+  text();
+  globals();
+  symbolTable();
+
+  std::string sectionNames(1, '\0');
+  for (auto& section : sections) {
+    if (*section.name == '\0') continue;
+    section.nameOffset = static_cast<std::uint32_t>(sectionNames.size());
+    sectionNames += section.name;
+    sectionNames.push_back('\0');
+  }
+  const auto namesIndex = static_cast<std::uint16_t>(sections.size());
+  sections.push_back({".shstrtab", SHT_STRTAB, 0});
+  sections.back().nameOffset = static_cast<std::uint32_t>(sectionNames.size());
+  sectionNames += ".shstrtab";
+  sectionNames.push_back('\0');
+  sections.back().bytes = std::move(sectionNames);
+  sections.back().size = sections.back().bytes.size();
+
+  std::uint64_t offset = HEADER_SIZE;
+  for (auto& section : sections) {
+    if (section.type == 0) continue;
+    offset = alignUp(offset, section.align);
+    section.offset = offset;
+    offset += section.bytes.size();
+  }
+  const auto headersOffset = alignUp(offset, 8);
+
+  std::string header;
+  header.reserve(HEADER_SIZE);
+  header += "\x7f" "ELF";
+  // 64 bits, little-endian, version 1, System V ABI.
+  header += std::string("\x02\x01\x01\x00", 4);
+  header.resize(16, '\0');
+  putField(header, ET_REL, 2);
+  putField(header, EM_X86_64, 2);
+  putField(header, 1, 4);
+  putField(header, 0, 8);
+  putField(header, 0, 8);
+  putField(header, headersOffset, 8);
+  putField(header, 0, 4);
+  putField(header, HEADER_SIZE, 2);
+  putField(header, 0, 2);
+  putField(header, 0, 2);
+  putField(header, SECTION_HEADER_SIZE, 2);
+  putField(header, sections.size(), 2);
+  putField(header, namesIndex, 2);
+  out.write(header);
+
+  std::uint64_t written = HEADER_SIZE;
+  for (const auto& section : sections) {
+    if (section.type == 0) continue;
+    for (; written < section.offset; written++) out.put('\0');
+    out.write(section.bytes);
+    written += section.bytes.size();
+  }
+  for (; written < headersOffset; written++) out.put('\0');
+
+  std::string headers;
+  headers.reserve(SECTION_HEADER_SIZE * sections.size());
+  for (const auto& section : sections) {
+    putField(headers, section.nameOffset, 4);
+    putField(headers, section.type, 4);
+    putField(headers, section.flags, 8);
+    putField(headers, 0, 8);
+    putField(headers, section.offset, 8);
+    putField(headers, section.size, 8);
+    putField(headers, section.link, 4);
+    putField(headers, section.info, 4);
+    putField(headers, section.align, 8);
+    putField(headers, section.entrySize, 8);
+  }
+  out.write(headers);
+}
+
+void ObjectWriter::text() {
+  MachineCode code;
+  const auto starts = encodeAll(functions, code, pool, report);
+  for (std::size_t i = 0; i < functions.size(); i++) {
+    const auto end =
+        i + 1 < functions.size() ? starts[i + 1] : code.bytes.size();
+    definitions[functions[i].symbol] = {TEXT, starts[i], end - starts[i]};
+  }
+  for (const auto& relocation : code.relocations) {
+    relocations[TEXT].push_back({relocation.offset, relocation.symbol,
+                                 relocationType(relocation.kind),
+                                 relocation.addend});
+    reference(relocation.symbol);
+  }
+  sections[TEXT].size = code.bytes.size();
+  sections[TEXT].bytes = std::move(code.bytes);
+}
+
+void ObjectWriter::globals() {
+  for (const auto& global : module.globals) {
+    const bool isZero = global.bytes.empty() && global.relocations.empty();
+    // Read-only data with addresses in it is written by the dynamic linker
+    // in position-independent executables.
+    const std::uint16_t index = global.isReadOnly
+                                    ? (global.relocations.empty() ? RODATA
+                                                                  : RELRO)
+                                : isZero ? BSS
+                                         : DATA;
+    auto& section = sections[index];
+    const auto offset = alignUp(section.size, global.align);
+    section.align = std::max<std::uint64_t>(section.align, global.align);
+    section.size = offset + global.size;
+    definitions[global.symbol] = {index, offset, global.size};
+    if (index == BSS) continue;
+
+    section.bytes.resize(offset, '\0');
+    section.bytes += global.bytes.substr(0, global.size);
+    section.bytes.resize(section.size, '\0');
+    for (const auto& relocation : global.relocations) {
+      relocations[index].push_back({offset + relocation.offset,
+                                    relocation.symbol, R_X86_64_64,
+                                    relocation.addend});
+      reference(relocation.symbol);
+    }
+  }
+}
+
+// The local symbols, then the defined global ones, then the undefined ones
+// the module uses.
+void ObjectWriter::symbolTable() {
+  Section symbols{".symtab", SHT_SYMTAB, 0, 8};
+  Section names{".strtab", SHT_STRTAB, 0};
+  symbols.entrySize = SYMBOL_SIZE;
+  names.bytes.push_back('\0');
+  putField(symbols.bytes, 0, SYMBOL_SIZE);
+
+  std::uint32_t count = 1;
+  auto add = [&](std::uint32_t id, std::uint8_t binding) {
+    const auto& symbol = module[id];
+    const auto& definition = definitions[id];
+    const std::uint8_t type = definition.section == 0 ? STT_NOTYPE
+                              : symbol.isFunction     ? STT_FUNC
+                                                      : STT_OBJECT;
+    putField(symbols.bytes, names.bytes.size(), 4);
+    names.bytes += symbol.name;
+    names.bytes.push_back('\0');
+    putField(symbols.bytes, (binding << 4) | type, 1);
+    putField(symbols.bytes, 0, 1);
+    putField(symbols.bytes, definition.section, 2);
+    putField(symbols.bytes, definition.value, 8);
+    putField(symbols.bytes, definition.size, 8);
+    symbolIndex[id] = count++;
+  };
+  const auto numberOfSymbols =
+      static_cast<std::uint32_t>(module.numberOfSymbols());
+  for (std::uint32_t id = 1; id < numberOfSymbols; id++) {
+    if (definitions[id].section != 0 && module[id].isLocal) {
+      add(id, STB_LOCAL);
+    }
+  }
+  symbols.info = count;
+  for (std::uint32_t id = 1; id < numberOfSymbols; id++) {
+    if (definitions[id].section != 0 && !module[id].isLocal) {
+      add(id, STB_GLOBAL);
+    }
+  }
+  for (std::uint32_t id = 1; id < numberOfSymbols; id++) {
+    if (definitions[id].section == 0 && symbolIndex[id] != 0) {
+      add(id, STB_GLOBAL);
+    }
+  }
+
+  symbols.size = symbols.bytes.size();
+  names.size = names.bytes.size();
+
+  // The .rela sections go before it.
+  auto index = static_cast<std::uint32_t>(sections.size());
+  for (std::uint16_t i = TEXT; i < COUNT; i++) {
+    if (!relocations[i].empty()) index++;
+  }
+  symbols.link = index + 1;
+  relocationSections(index);
+  sections.push_back(std::move(symbols));
+  sections.push_back(std::move(names));
+}
+
+void ObjectWriter::relocationSections(std::uint32_t symbolTable) {
+  static constexpr const char* NAMES[COUNT] = {
+      "", ".rela.text", ".rela.data", ".rela.data.rel.ro", ".rela.rodata",
+      "", ""};
+  for (std::uint16_t i = TEXT; i < COUNT; i++) {
+    if (relocations[i].empty()) continue;
+    Section section{NAMES[i], SHT_RELA, SHF_INFO_LINK, 8};
+    section.link = symbolTable;
+    section.info = i;
+    section.entrySize = RELOCATION_SIZE;
+    for (const auto& relocation : relocations[i]) {
+      putField(section.bytes, relocation.offset, 8);
+      putField(section.bytes,
+               (std::uint64_t{symbolIndex[relocation.symbol]} << 32) |
+                   relocation.type,
+               8);
+      putField(section.bytes, static_cast<std::uint64_t>(relocation.addend),
+               8);
+    }
+    section.size = section.bytes.size();
+    sections.push_back(std::move(section));
+  }
+}
+}  // namespace
+
+void writeObject(const Module& module,
+                 std::span<const MachineFunction> functions,
+                 BufferedWriter& out, ThreadPool* pool,
+                 TimeReport* report) {
+  ObjectWriter(module, functions, pool, report).write(out);
+}
@@ -0,0 +1,26 @@
+#ifndef TPLCC_OBJECT_WRITER_H
+#define TPLCC_OBJECT_WRITER_H
+
+#include <span>
+
+#include "buffered-writer.h"
+#include "code-generation.h"
+#include "ir.h"
+#include "thread-pool.h"
+#include "time-report.h"
+
+// Write a module as an ELF64 relocatable object for x86-64, what the GNU
+// assembler makes of writeAssembly's output: the functions, in the order
+// given, encoded into .text, the globals in .data, .data.rel.ro, .rodata or
+// .bss, a symbol table with the local symbols first, and a .rela section
+// for every section with relocations. The object can be linked with the
+// system linker.
+//
+// The functions are encoded by encodeAll, on the pool's threads if there
+// is a pool.
+void writeObject(const Module& module,
+                 std::span<const MachineFunction> functions,
+                 BufferedWriter& out, ThreadPool* pool = nullptr,
+                 TimeReport* report = nullptr);
+
+#endif
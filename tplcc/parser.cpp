@@ -0,0 +1,1432 @@
+#include "parser.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+
+#include "literal.h"
+
+namespace {
+// Thrown after a syntax error has been reported, caught where the parser can
+// resume.
+struct ParseError {};
+
+const char* PUNCTUATOR_SPELLINGS[NUMBER_OF_PUNCTUATOR_KINDS] = {
+    "[",  "]",  "(",  ")",  "{",  "}",  ".",  "->", "++",  "--",  "&",  "*",
+    "+",  "-",  "~",  "!",  "/",  "%",  "<<", ">>", "<",   ">",   "<=", ">=",
+    "==", "!=", "^",  "|",  "&&", "||", "?",  ":",  ";",   "...", "=",  "*=",
+    "/=", "%=", "+=", "-=", "<<=", ">>=", "&=", "^=", "|=", ",",
+};
+
+// How an infix operator is parsed: the node it makes, its operator and how
+// tightly it binds. Tokens that are not infix operators have no precedence.
+struct InfixOperator {
+  Precedence precedence = Precedence::None;
+  NodeKind kind = NodeKind::Invalid;
+  Operator op = Operator::None;
+  bool isRightAssociative = false;
+};
+
+constexpr auto INFIX_OPERATORS = [] {
+  std::array<InfixOperator, NUMBER_OF_PUNCTUATOR_KINDS> table{};
+  const auto binary = [&table](PunctuatorKind punctuator,
+                               Precedence precedence, Operator op) {
+    table[static_cast<std::size_t>(punctuator)] = {precedence, NodeKind::Binary,
+                                                   op, false};
+  };
+  const auto assign = [&table](PunctuatorKind punctuator, Operator op) {
+    table[static_cast<std::size_t>(punctuator)] = {
+        Precedence::Assignment, NodeKind::Assign, op, true};
+  };
+
+  binary(PunctuatorKind::Comma, Precedence::Comma, Operator::Comma);
+  assign(PunctuatorKind::Assign, Operator::None);
+  assign(PunctuatorKind::StarAssign, Operator::Multiply);
+  assign(PunctuatorKind::SlashAssign, Operator::Divide);
+  assign(PunctuatorKind::PercentAssign, Operator::Remainder);
+  assign(PunctuatorKind::PlusAssign, Operator::Add);
+  assign(PunctuatorKind::MinusAssign, Operator::Subtract);
+  assign(PunctuatorKind::LeftShiftAssign, Operator::ShiftLeft);
+  assign(PunctuatorKind::RightShiftAssign, Operator::ShiftRight);
+  assign(PunctuatorKind::AmpersandAssign, Operator::BitwiseAnd);
+  assign(PunctuatorKind::CaretAssign, Operator::BitwiseXor);
+  assign(PunctuatorKind::PipeAssign, Operator::BitwiseOr);
+  table[static_cast<std::size_t>(PunctuatorKind::Question)] = {
+      Precedence::Conditional, NodeKind::Conditional, Operator::None, true};
+  binary(PunctuatorKind::LogicalOr, Precedence::LogicalOr, Operator::LogicalOr);
+  binary(PunctuatorKind::LogicalAnd, Precedence::LogicalAnd, Operator::LogicalAnd);
+  binary(PunctuatorKind::Pipe, Precedence::BitwiseOr, Operator::BitwiseOr);
+  binary(PunctuatorKind::Caret, Precedence::BitwiseXor, Operator::BitwiseXor);
+  binary(PunctuatorKind::Ampersand, Precedence::BitwiseAnd, Operator::BitwiseAnd);
+  binary(PunctuatorKind::Equal, Precedence::Equality, Operator::Equal);
+  binary(PunctuatorKind::NotEqual, Precedence::Equality, Operator::NotEqual);
+  binary(PunctuatorKind::Less, Precedence::Relational, Operator::Less);
+  binary(PunctuatorKind::Greater, Precedence::Relational, Operator::Greater);
+  binary(PunctuatorKind::LessEqual, Precedence::Relational, Operator::LessEqual);
+  binary(PunctuatorKind::GreaterEqual, Precedence::Relational,
+         Operator::GreaterEqual);
+  binary(PunctuatorKind::LeftShift, Precedence::Shift, Operator::ShiftLeft);
+  binary(PunctuatorKind::RightShift, Precedence::Shift, Operator::ShiftRight);
+  binary(PunctuatorKind::Plus, Precedence::Additive, Operator::Add);
+  binary(PunctuatorKind::Minus, Precedence::Additive, Operator::Subtract);
+  binary(PunctuatorKind::Star, Precedence::Multiplicative, Operator::Multiply);
+  binary(PunctuatorKind::Slash, Precedence::Multiplicative, Operator::Divide);
+  binary(PunctuatorKind::Percent, Precedence::Multiplicative,
+         Operator::Remainder);
+  return table;
+}();
+
+const InfixOperator& infixOperator(const ParserToken& token) {
+  static constexpr InfixOperator NOT_AN_OPERATOR;
+  if (token.kind != ParserToken::Kind::Punctuator) return NOT_AN_OPERATOR;
+  return INFIX_OPERATORS[static_cast<std::size_t>(token.punctuator)];
+}
+
+std::optional<Operator> prefixOperator(const ParserToken& token) {
+  if (token.kind != ParserToken::Kind::Punctuator) return std::nullopt;
+  switch (token.punctuator) {
+    case PunctuatorKind::Ampersand: return Operator::AddressOf;
+    case PunctuatorKind::Star: return Operator::Dereference;
+    case PunctuatorKind::Plus: return Operator::Plus;
+    case PunctuatorKind::Minus: return Operator::Minus;
+    case PunctuatorKind::Tilde: return Operator::BitwiseNot;
+    case PunctuatorKind::Exclamation: return Operator::LogicalNot;
+    default: return std::nullopt;
+  }
+}
+
+bool isFloatingLiteral(std::string_view spelling) {
+  const bool isHex = spelling.size() > 1 && spelling[0] == '0' &&
+                     (spelling[1] == 'x' || spelling[1] == 'X');
+  return spelling.find_first_of(isHex ? ".pP" : ".eE") != std::string_view::npos;
+}
+
+std::optional<std::uint8_t> typeQualifier(const ParserToken& token) {
+  if (token.kind != ParserToken::Kind::Keyword) return std::nullopt;
+  switch (token.keyword) {
+    case Keyword::Const: return TypeQualifier::Const;
+    case Keyword::Volatile: return TypeQualifier::Volatile;
+    case Keyword::Restrict: return TypeQualifier::Restrict;
+    default: return std::nullopt;
+  }
+}
+
+std::optional<StorageClass> storageClass(const ParserToken& token) {
+  if (token.kind != ParserToken::Kind::Keyword) return std::nullopt;
+  switch (token.keyword) {
+    case Keyword::Typedef: return StorageClass::Typedef;
+    case Keyword::Extern: return StorageClass::Extern;
+    case Keyword::Static: return StorageClass::Static;
+    case Keyword::Auto: return StorageClass::Auto;
+    case Keyword::Register: return StorageClass::Register;
+    default: return std::nullopt;
+  }
+}
+
+std::uint16_t typeSpecifier(const ParserToken& token) {
+  if (token.kind != ParserToken::Kind::Keyword) return 0;
+  switch (token.keyword) {
+    case Keyword::Void: return TypeSpecifier::Void;
+    case Keyword::Char: return TypeSpecifier::Char;
+    case Keyword::Short: return TypeSpecifier::Short;
+    case Keyword::Int: return TypeSpecifier::Int;
+    case Keyword::Long: return TypeSpecifier::Long;
+    case Keyword::Float: return TypeSpecifier::Float;
+    case Keyword::Double: return TypeSpecifier::Double;
+    case Keyword::Signed: return TypeSpecifier::Signed;
+    case Keyword::Unsigned: return TypeSpecifier::Unsigned;
+    case Keyword::_Bool: return TypeSpecifier::Bool;
+    case Keyword::_Complex: return TypeSpecifier::Complex;
+    default: return 0;
+  }
+}
+
+// Whether the specifiers can still be completed to a valid type, e.g.
+// "unsigned long" is fine, "short double" is not.
+bool isValidSpecifierCombination(std::uint16_t specifiers) {
+  using namespace TypeSpecifier;
+  const std::uint16_t base = specifiers & (Void | Char | Int | Float | Double | Bool);
+  if (base & (base - 1)) return false;
+
+  const auto allows = [base](std::uint16_t allowed) {
+    return (base & ~allowed) == 0;
+  };
+  if ((specifiers & Short) && ((specifiers & Long) || !allows(Int))) return false;
+  if ((specifiers & Long) && !allows(Int | Double)) return false;
+  if ((specifiers & LongLong) && !allows(Int)) return false;
+  if ((specifiers & Signed) && (specifiers & Unsigned)) return false;
+  if ((specifiers & (Signed | Unsigned)) && !allows(Char | Int)) return false;
+  if ((specifiers & Complex) &&
+      ((specifiers & (Short | LongLong | Signed | Unsigned)) ||
+       !allows(Float | Double)))
+    return false;
+  return true;
+}
+}  // namespace
+
+Parser::Parser(Lexer& lexer, AST& ast, StringInterner& strings,
+               IReportError& errOut, TimeReport* timeReport)
+    : lexer(lexer),
+      ast(ast),
+      strings(strings),
+      errOut(errOut),
+      timeReport(timeReport) {}
+
+/* Tokens */
+
+ParserToken Parser::readToken() {
+  std::optional<Token> token;
+  {
+    TimeReport::Scope scope(timeReport, Phase::Lex);
+    // The lexer has reported the error if it gives nothing back.
+    while (!(token = lexer.next())) {
+    }
+  }
+
+  ParserToken result;
+  std::tie(result.start, result.end) = lexer.lastTokenRange();
+
+  if (const auto punctuator = std::get_if<Punctuator>(&*token)) {
+    if (const auto kind = punctuatorKind(*punctuator)) {
+      result.kind = ParserToken::Kind::Punctuator;
+      result.punctuator = *kind;
+    } else {
+      result.kind = ParserToken::Kind::Stray;
+      result.text = strings.intern(punctuator->str);
+    }
+  } else if (const auto identifier = std::get_if<Identifier>(&*token)) {
+    result.kind = ParserToken::Kind::Identifier;
+    result.text = strings.intern(identifier->str);
+  } else if (const auto keyword = std::get_if<Keyword>(&*token)) {
+    result.kind = ParserToken::Kind::Keyword;
+    result.keyword = *keyword;
+  } else if (const auto number = std::get_if<NumberLiteral>(&*token)) {
+    result.kind = ParserToken::Kind::NumberLiteral;
+    result.text = strings.intern(number->str);
+  } else if (const auto literal = std::get_if<StringLiteral>(&*token)) {
+    result.kind = ParserToken::Kind::StringLiteral;
+    result.text = strings.intern(literal->str);
+    result.isWide = literal->prefix == CharSequenceLiteralPrefix::L;
+  } else if (const auto character = std::get_if<CharacterLiteral>(&*token)) {
+    result.kind = ParserToken::Kind::CharacterLiteral;
+    result.text = strings.intern(character->str);
+    result.isWide = character->prefix == CharSequenceLiteralPrefix::L;
+  } else if (const auto stray = std::get_if<char>(&*token)) {
+    result.kind = ParserToken::Kind::Stray;
+    result.text = strings.intern(std::string_view(stray, 1));
+  }
+  return result;
+}
+
+const ParserToken& Parser::current() {
+  if (numberOfPeekedTokens == 0) {
+    tokens[0] = readToken();
+    numberOfPeekedTokens = 1;
+  }
+  return tokens[0];
+}
+
+const ParserToken& Parser::peek() {
+  current();
+  if (numberOfPeekedTokens == 1) {
+    tokens[1] = readToken();
+    numberOfPeekedTokens = 2;
+  }
+  return tokens[1];
+}
+
+ParserToken Parser::consume() {
+  const ParserToken token = current();
+  tokens[0] = tokens[1];
+  numberOfPeekedTokens--;
+  previousTokenEnd = token.end;
+  return token;
+}
+
+bool Parser::accept(PunctuatorKind kind) {
+  if (!current().is(kind)) return false;
+  consume();
+  return true;
+}
+
+bool Parser::accept(Keyword keyword) {
+  if (!current().is(keyword)) return false;
+  consume();
+  return true;
+}
+
+ParserToken Parser::expect(PunctuatorKind kind, const char* spelling) {
+  if (!current().is(kind)) fail(ErrorID::ExpectedToken, {spelling});
+  return consume();
+}
+
+StringID Parser::expectIdentifier() {
+  if (current().kind != ParserToken::Kind::Identifier) {
+    fail(ErrorID::ExpectedIdentifier);
+  }
+  return consume().text;
+}
+
+void Parser::fail(ErrorID id, std::initializer_list<std::string_view> arguments) {
+  errOut.reportsError({id, {current().start, current().end}, arguments});
+  throw ParseError{};
+}
+
+std::string_view Parser::spelling(const ParserToken& token) const {
+  switch (token.kind) {
+    case ParserToken::Kind::EndOfInput: return "end of input";
+    case ParserToken::Kind::Punctuator:
+      return PUNCTUATOR_SPELLINGS[static_cast<std::size_t>(token.punctuator)];
+    case ParserToken::Kind::Keyword: return keywordSpelling(token.keyword);
+    default: return strings.view(token.text);
+  }
+}
+
+Parser::Checkpoint Parser::checkpoint() const {
+  return {ast.beginList(), derivations.size(), symbols.depth(),
+          switchLabels.size(), loopDepth, switchDepth};
+}
+
+void Parser::restore(const Checkpoint& checkpoint) {
+  ast.abandonList(checkpoint.listMark);
+  derivations.resize(checkpoint.numberOfDerivations);
+  while (symbols.depth() > checkpoint.numberOfScopes) exitScope();
+  switchLabels.resize(checkpoint.numberOfSwitchLabels);
+  loopDepth = checkpoint.loopDepth;
+  switchDepth = checkpoint.switchDepth;
+}
+
+// Skip to the end of the statement or declaration that has an error, i.e.
+// after the next ";" or the "}" closing a block, or to the "}" that closes the
+// enclosing block.
+void Parser::synchronize(bool stopsAtRightBrace) {
+  std::size_t depth = 0;
+  while (current().kind != ParserToken::Kind::EndOfInput) {
+    if (current().is(PunctuatorKind::LeftBrace)) {
+      depth++;
+    } else if (current().is(PunctuatorKind::RightBrace)) {
+      if (depth == 0 && stopsAtRightBrace) return;
+      consume();
+      if (depth <= 1) return;
+      depth--;
+      continue;
+    } else if (current().is(PunctuatorKind::Semicolon) && depth == 0) {
+      consume();
+      return;
+    }
+    consume();
+  }
+}
+
+/* Scopes */
+
+void Parser::enterScope() {
+  symbols.enterScope();
+  tags.enterScope();
+}
+
+void Parser::exitScope() {
+  symbols.exitScope();
+  tags.exitScope();
+}
+
+void Parser::declare(StringID name, NodeID decl, CodeBuffer::Offset offset) {
+  if (name == 0) return;
+
+  const auto previous = symbols.declare(name, decl);
+  if (previous == 0) return;
+
+  // Variables and functions can be declared many times, whether the
+  // declarations agree is up to the type checker.
+  const auto isRedeclarable = [this](NodeID id) {
+    return ast[id].kind == NodeKind::VarDecl ||
+           ast[id].kind == NodeKind::FunctionDecl;
+  };
+  if (!isRedeclarable(previous) || !isRedeclarable(decl)) {
+    const auto spelling = strings.view(name);
+    errOut.reportsError({ErrorID::Redefinition,
+                         {offset, offset + spelling.size()},
+                         {spelling}});
+  }
+}
+
+bool Parser::isTypedefName(const ParserToken& token) const {
+  if (token.kind != ParserToken::Kind::Identifier) return false;
+  const auto decl = symbols.lookup(token.text);
+  return decl != 0 && ast[decl].kind == NodeKind::TypedefDecl;
+}
+
+bool Parser::isTypeNameStart(const ParserToken& token) const {
+  if (typeSpecifier(token) != 0 || typeQualifier(token)) return true;
+  if (token.is(Keyword::Struct) || token.is(Keyword::Union) ||
+      token.is(Keyword::Enum))
+    return true;
+  return isTypedefName(token);
+}
+
+bool Parser::isDeclarationStart(const ParserToken& token) const {
+  return isTypeNameStart(token) || storageClass(token) ||
+         token.is(Keyword::Inline);
+}
+
+NodeID Parser::node(NodeKind kind, CodeBuffer::Offset offset, NodeID a,
+                    NodeID b, NodeID c) {
+  Node node;
+  node.kind = kind;
+  node.offset = offset;
+  node.a = a;
+  node.b = b;
+  node.c = c;
+  return ast.add(node);
+}
+
+/* Declarations */
+
+NodeID Parser::parseTranslationUnit() {
+  const auto mark = ast.beginList();
+  while (current().kind != ParserToken::Kind::EndOfInput) {
+    // A stray semicolon at file scope is harmless.
+    if (accept(PunctuatorKind::Semicolon)) continue;
+
+    const auto state = checkpoint();
+    try {
+      if (!isDeclarationStart(current()) &&
+          current().kind != ParserToken::Kind::Identifier) {
+        fail(ErrorID::UnexpectedToken, {spelling(current())});
+      }
+      const auto decl = parseDeclaration(true);
+      ast.pushToList(decl);
+    } catch (const ParseError&) {
+      restore(state);
+      synchronize(false);
+    }
+  }
+
+  const auto unit = node(NodeKind::TranslationUnit, 0);
+  ast[unit].list = ast.endList(mark);
+  return unit;
+}
+
+// Parse a declaration, or a function definition if isExternal is true.
+NodeID Parser::parseDeclaration(bool isExternal) {
+  const auto spec = parseDeclarationSpecifiers(true);
+  const auto base = makeSpecifiedType(spec);
+  const auto mark = ast.beginList();
+
+  while (!current().is(PunctuatorKind::Semicolon)) {
+    const auto derivationMark = derivations.size();
+    CodeBuffer::Offset offset = 0;
+    const auto name = parseDeclarator(false, &offset);
+    const auto type = applyDerivations(base, derivationMark);
+
+    if (spec.storage == StorageClass::Typedef) {
+      const auto decl = node(NodeKind::TypedefDecl, offset, type);
+      ast[decl].name = name;
+      declare(name, decl, offset);
+      ast.pushToList(decl);
+    } else if (ast[type].kind == NodeKind::FunctionType) {
+      const auto decl = node(NodeKind::FunctionDecl, offset, type);
+      ast[decl].op = static_cast<std::uint8_t>(spec.storage);
+      ast[decl].name = name;
+      if (spec.isInline) ast[decl].flags |= NodeFlag::Inline;
+      declare(name, decl, offset);
+
+      const bool isFirstDeclarator = ast.beginList() == mark;
+      const bool hasOldStyleDeclarations =
+          (ast[type].flags & NodeFlag::NoPrototype) &&
+          isDeclarationStart(current());
+      if (isExternal && isFirstDeclarator &&
+          (current().is(PunctuatorKind::LeftBrace) || hasOldStyleDeclarations)) {
+        return parseFunctionDefinition(decl);
+      }
+      ast.pushToList(decl);
+    } else {
+      const auto decl = node(NodeKind::VarDecl, offset, type);
+      ast[decl].op = static_cast<std::uint8_t>(spec.storage);
+      ast[decl].name = name;
+      // The scope of a variable begins right after its declarator, so the
+      // initializer can refer to it.
+      declare(name, decl, offset);
+      ast.pushToList(decl);
+      if (accept(PunctuatorKind::Assign)) {
+        const auto initializer = parseInitializer();
+        ast[decl].b = initializer;
+      }
+    }
+
+    if (!accept(PunctuatorKind::Comma)) break;
+  }
+  expect(PunctuatorKind::Semicolon, "';'");
+
+  const auto group = node(NodeKind::DeclGroup, spec.offset, base);
+  ast[group].list = ast.endList(mark);
+  return group;
+}
+
+Parser::DeclSpec Parser::parseDeclarationSpecifiers(bool allowStorageClass) {
+  DeclSpec spec;
+  spec.offset = current().start;
+
+  while (true) {
+    const auto& token = current();
+
+    if (const auto storage = storageClass(token)) {
+      if (!allowStorageClass || spec.storage != StorageClass::None) {
+        fail(ErrorID::UnexpectedToken, {spelling(token)});
+      }
+      spec.storage = *storage;
+    } else if (token.is(Keyword::Inline)) {
+      if (!allowStorageClass) fail(ErrorID::UnexpectedToken, {spelling(token)});
+      spec.isInline = true;
+    } else if (const auto qualifier = typeQualifier(token)) {
+      spec.qualifiers |= *qualifier;
+    } else if (auto specifier = typeSpecifier(token)) {
+      if (specifier == TypeSpecifier::Long && (spec.specifiers & specifier)) {
+        specifier = TypeSpecifier::LongLong;
+      }
+      if (spec.type != 0 || (spec.specifiers & specifier) ||
+          !isValidSpecifierCombination(spec.specifiers | specifier)) {
+        errOut.reportsError({ErrorID::InvalidTypeSpecifierCombination,
+                             {token.start, token.end},
+                             {spelling(token)}});
+      } else {
+        spec.specifiers |= specifier;
+      }
+    } else if (token.is(Keyword::Struct) || token.is(Keyword::Union) ||
+               token.is(Keyword::Enum)) {
+      if (spec.type != 0 || spec.specifiers != 0) {
+        errOut.reportsError({ErrorID::InvalidTypeSpecifierCombination,
+                             {token.start, token.end},
+                             {spelling(token)}});
+      }
+      spec.type = token.is(Keyword::Enum) ? parseEnumSpecifier()
+                                          : parseRecordSpecifier();
+      continue;
+    } else if (spec.type == 0 && spec.specifiers == 0 && isTypedefName(token)) {
+      spec.type = node(NodeKind::TypedefType, token.start,
+                       symbols.lookup(token.text));
+      ast[spec.type].name = token.text;
+    } else {
+      break;
+    }
+    consume();
+  }
+
+  if (spec.type == 0 && spec.specifiers == 0) {
+    const auto end =
+        spec.offset == current().start ? current().end : previousTokenEnd;
+    errOut.reportsError({ErrorID::MissingTypeSpecifier, {spec.offset, end}});
+    spec.specifiers = TypeSpecifier::Int;
+  }
+  return spec;
+}
+
+NodeID Parser::parseRecordSpecifier() {
+  const auto keyword = consume();
+  const bool isUnion = keyword.is(Keyword::Union);
+  const auto tagOffset = current().start;
+  StringID tag = 0;
+  if (current().kind == ParserToken::Kind::Identifier) {
+    tag = consume().text;
+  } else if (!current().is(PunctuatorKind::LeftBrace)) {
+    fail(ErrorID::ExpectedIdentifier);
+  }
+
+  const auto type = node(NodeKind::RecordType, keyword.start);
+  ast[type].name = tag;
+  if (isUnion) ast[type].flags |= NodeFlag::Union;
+
+  const auto checkKind = [&](NodeID decl) {
+    if (ast[decl].kind != NodeKind::RecordType ||
+        (ast[decl].flags & NodeFlag::Union) != (ast[type].flags & NodeFlag::Union)) {
+      const auto spelling = strings.view(tag);
+      errOut.reportsError({ErrorID::TagKindMismatch,
+                           {tagOffset, tagOffset + spelling.size()},
+                           {spelling}});
+    }
+  };
+
+  const bool hasDefinition = current().is(PunctuatorKind::LeftBrace);
+  NodeID decl = 0;
+  if (tag != 0) {
+    // "struct S;" and definitions always declare the tag in the current
+    // scope, other references find the tag in the enclosing scopes first.
+    if (hasDefinition || current().is(PunctuatorKind::Semicolon)) {
+      decl = tags.lookupInCurrentScope(tag);
+    } else {
+      decl = tags.lookup(tag);
+    }
+    if (decl == 0) {
+      tags.declare(tag, type);
+    } else {
+      checkKind(decl);
+      if (hasDefinition && ast[decl].b != 0) {
+        const auto spelling = strings.view(tag);
+        errOut.reportsError({ErrorID::Redefinition,
+                             {tagOffset, tagOffset + spelling.size()},
+                             {spelling}});
+      }
+    }
+  }
+  ast[type].a = decl != 0 ? decl : type;
+  if (!hasDefinition) return type;
+
+  const auto start = consume().start;
+  const auto mark = ast.beginList();
+  while (!current().is(PunctuatorKind::RightBrace) &&
+         current().kind != ParserToken::Kind::EndOfInput) {
+    parseStructDeclaration();
+  }
+  expect(PunctuatorKind::RightBrace, "'}'");
+
+  const auto definition = node(NodeKind::RecordDefinition, start, type);
+  ast[definition].list = ast.endList(mark);
+  ast[type].b = definition;
+  ast[ast[type].a].b = definition;
+  return type;
+}
+
+void Parser::parseStructDeclaration() {
+  const auto spec = parseDeclarationSpecifiers(false);
+  const auto base = makeSpecifiedType(spec);
+
+  // An anonymous struct or union.
+  if (current().is(PunctuatorKind::Semicolon)) {
+    ast.pushToList(node(NodeKind::FieldDecl, spec.offset, base));
+    consume();
+    return;
+  }
+
+  do {
+    const auto derivationMark = derivations.size();
+    CodeBuffer::Offset offset = current().start;
+    StringID name = 0;
+    if (!current().is(PunctuatorKind::Colon)) {
+      name = parseDeclarator(false, &offset);
+    }
+    const auto type = applyDerivations(base, derivationMark);
+    NodeID width = 0;
+    if (accept(PunctuatorKind::Colon)) width = parseConditionalExpression();
+
+    const auto field = node(NodeKind::FieldDecl, offset, type, width);
+    ast[field].name = name;
+    ast.pushToList(field);
+  } while (accept(PunctuatorKind::Comma));
+  expect(PunctuatorKind::Semicolon, "';'");
+}
+
+NodeID Parser::parseEnumSpecifier() {
+  const auto keyword = consume();
+  const auto tagOffset = current().start;
+  StringID tag = 0;
+  if (current().kind == ParserToken::Kind::Identifier) {
+    tag = consume().text;
+  } else if (!current().is(PunctuatorKind::LeftBrace)) {
+    fail(ErrorID::ExpectedIdentifier);
+  }
+
+  const auto type = node(NodeKind::EnumType, keyword.start);
+  ast[type].name = tag;
+
+  const bool hasDefinition = current().is(PunctuatorKind::LeftBrace);
+  NodeID decl = 0;
+  if (tag != 0) {
+    if (hasDefinition) {
+      decl = tags.lookupInCurrentScope(tag);
+    } else {
+      decl = tags.lookup(tag);
+    }
+    if (decl == 0) {
+      tags.declare(tag, type);
+    } else if (ast[decl].kind != NodeKind::EnumType ||
+               (hasDefinition && ast[decl].b != 0)) {
+      const auto spelling = strings.view(tag);
+      errOut.reportsError({ast[decl].kind != NodeKind::EnumType
+                               ? ErrorID::TagKindMismatch
+                               : ErrorID::Redefinition,
+                           {tagOffset, tagOffset + spelling.size()},
+                           {spelling}});
+    }
+  }
+  ast[type].a = decl != 0 ? decl : type;
+  if (!hasDefinition) return type;
+
+  const auto start = consume().start;
+  const auto mark = ast.beginList();
+  while (!current().is(PunctuatorKind::RightBrace)) {
+    const auto offset = current().start;
+    const auto name = expectIdentifier();
+    NodeID value = 0;
+    if (accept(PunctuatorKind::Assign)) value = parseConditionalExpression();
+
+    const auto constant = node(NodeKind::EnumConstantDecl, offset, value, 0, type);
+    ast[constant].name = name;
+    declare(name, constant, offset);
+    ast.pushToList(constant);
+    if (!accept(PunctuatorKind::Comma)) break;
+  }
+  expect(PunctuatorKind::RightBrace, "'}'");
+
+  const auto definition = node(NodeKind::EnumDefinition, start, type);
+  ast[definition].list = ast.endList(mark);
+  ast[type].b = definition;
+  ast[ast[type].a].b = definition;
+  return type;
+}
+
+NodeID Parser::makeSpecifiedType(const DeclSpec& spec) {
+  if (spec.type == 0) {
+    const auto type = node(NodeKind::BuiltinType, spec.offset);
+    ast[type].op = spec.qualifiers;
+    ast[type].flags = spec.specifiers;
+    return type;
+  }
+  if (spec.qualifiers == 0) return spec.type;
+
+  const auto type = node(NodeKind::QualifiedType, spec.offset, spec.type);
+  ast[type].op = spec.qualifiers;
+  return type;
+}
+
+// Read a declarator and push its derivations to the derivation stack in the
+// order they apply to the base type. For example "*a[3]" declares an array of
+// pointers, so it pushes "pointer to" and then "array of". The declarator is
+// laid out as [pointers][nested declarator][suffixes] while it is read, and
+// rearranged to [pointers][suffixes in reverse][nested declarator] at the end.
+//
+// Returns the declared name, which is 0 for an abstract declarator.
+StringID Parser::parseDeclarator(bool allowAbstract, CodeBuffer::Offset* offset) {
+  while (current().is(PunctuatorKind::Star)) {
+    Derivation pointer;
+    pointer.kind = NodeKind::PointerType;
+    pointer.offset = consume().start;
+    while (const auto qualifier = typeQualifier(current())) {
+      pointer.qualifiers |= *qualifier;
+      consume();
+    }
+    derivations.push_back(pointer);
+  }
+
+  const auto nestedStart = derivations.size();
+  StringID name = 0;
+  *offset = current().start;
+  if (current().kind == ParserToken::Kind::Identifier) {
+    name = consume().text;
+  } else if (current().is(PunctuatorKind::LeftParenthesis) &&
+             isNestedDeclaratorStart(allowAbstract)) {
+    consume();
+    name = parseDeclarator(allowAbstract, offset);
+    expect(PunctuatorKind::RightParenthesis, "')'");
+  } else if (!allowAbstract) {
+    fail(ErrorID::ExpectedIdentifier);
+  }
+
+  const auto suffixStart = derivations.size();
+  parseDeclaratorSuffixes();
+  std::reverse(derivations.begin() + suffixStart, derivations.end());
+  std::rotate(derivations.begin() + nestedStart,
+              derivations.begin() + suffixStart, derivations.end());
+  return name;
+}
+
+// Whether the "(" at the current token starts a nested declarator like in
+// "int (*f)(void)" rather than the parameter list of an abstract declarator
+// like in "int (int)".
+bool Parser::isNestedDeclaratorStart(bool allowAbstract) {
+  const auto& next = peek();
+  if (next.is(PunctuatorKind::Star) || next.is(PunctuatorKind::LeftParenthesis)) {
+    return true;
+  }
+  if (next.is(PunctuatorKind::LeftBracket)) return allowAbstract;
+  // In a parameter declaration an identifier that can be a typedef name is
+  // taken as a typedef name (C99 6.7.5.3p11).
+  return next.kind == ParserToken::Kind::Identifier &&
+         !(allowAbstract && isTypedefName(next));
+}
+
+void Parser::parseDeclaratorSuffixes() {
+  while (true) {
+    if (current().is(PunctuatorKind::LeftBracket)) {
+      Derivation array;
+      array.kind = NodeKind::ArrayType;
+      array.offset = consume().start;
+      while (true) {
+        if (accept(Keyword::Static)) {
+          array.flags |= NodeFlag::StaticSize;
+        } else if (const auto qualifier = typeQualifier(current())) {
+          array.qualifiers |= *qualifier;
+          consume();
+        } else {
+          break;
+        }
+      }
+      if (current().is(PunctuatorKind::Star) &&
+          peek().is(PunctuatorKind::RightBracket)) {
+        consume();
+        array.flags |= NodeFlag::VLAStar;
+      } else if (!current().is(PunctuatorKind::RightBracket)) {
+        array.operand = parseAssignmentExpression();
+      }
+      expect(PunctuatorKind::RightBracket, "']'");
+      derivations.push_back(array);
+    } else if (current().is(PunctuatorKind::LeftParenthesis)) {
+      const auto offset = consume().start;
+      const auto function = parseParameterList(offset);
+      derivations.push_back(function);
+    } else {
+      return;
+    }
+  }
+}
+
+// Parse the parameters after "(", up to and including the ")".
+Parser::Derivation Parser::parseParameterList(CodeBuffer::Offset offset) {
+  Derivation function;
+  function.kind = NodeKind::FunctionType;
+  function.offset = offset;
+
+  // Parameters live in their own scope, a function definition brings them
+  // back for its body.
+  enterScope();
+  const auto mark = ast.beginList();
+
+  if (current().is(PunctuatorKind::RightParenthesis)) {
+    function.flags |= NodeFlag::NoPrototype;
+  } else if (current().is(Keyword::Void) &&
+             peek().is(PunctuatorKind::RightParenthesis)) {
+    consume();
+  } else if (current().kind == ParserToken::Kind::Identifier &&
+             !isTypedefName(current())) {
+    // An identifier list of an old style function definition.
+    function.flags |= NodeFlag::NoPrototype;
+    do {
+      const auto paramOffset = current().start;
+      const auto param = node(NodeKind::ParamDecl, paramOffset);
+      ast[param].name = expectIdentifier();
+      declare(ast[param].name, param, paramOffset);
+      ast.pushToList(param);
+    } while (accept(PunctuatorKind::Comma));
+  } else {
+    do {
+      if (accept(PunctuatorKind::Ellipsis)) {
+        function.flags |= NodeFlag::Variadic;
+        break;
+      }
+      const auto spec = parseDeclarationSpecifiers(true);
+      const auto base = makeSpecifiedType(spec);
+      const auto derivationMark = derivations.size();
+      CodeBuffer::Offset paramOffset = 0;
+      const auto name = parseDeclarator(true, &paramOffset);
+      const auto type = applyDerivations(base, derivationMark);
+
+      const auto param = node(NodeKind::ParamDecl, paramOffset, type);
+      ast[param].name = name;
+      declare(name, param, paramOffset);
+      ast.pushToList(param);
+    } while (accept(PunctuatorKind::Comma));
+  }
+  expect(PunctuatorKind::RightParenthesis, "')'");
+
+  function.parameters = ast.endList(mark);
+  exitScope();
+  return function;
+}
+
+NodeID Parser::applyDerivations(NodeID type, std::size_t mark) {
+  for (std::size_t i = mark; i < derivations.size(); i++) {
+    const auto& derivation = derivations[i];
+    const auto derived = node(derivation.kind, derivation.offset, type,
+                              derivation.operand);
+    ast[derived].op = derivation.qualifiers;
+    ast[derived].flags = derivation.flags;
+    ast[derived].list = derivation.parameters;
+    type = derived;
+  }
+  derivations.resize(mark);
+  return type;
+}
+
+NodeID Parser::parseTypeName() {
+  const auto spec = parseDeclarationSpecifiers(false);
+  const auto base = makeSpecifiedType(spec);
+  const auto derivationMark = derivations.size();
+  CodeBuffer::Offset offset = 0;
+  if (parseDeclarator(true, &offset) != 0) {
+    errOut.reportsError({ErrorID::UnexpectedToken,
+                         {offset, previousTokenEnd},
+                         {"identifier"}});
+  }
+  return applyDerivations(base, derivationMark);
+}
+
+NodeID Parser::parseInitializer() {
+  if (!current().is(PunctuatorKind::LeftBrace)) {
+    return parseAssignmentExpression();
+  }
+
+  const auto start = consume().start;
+  const auto mark = ast.beginList();
+  while (!current().is(PunctuatorKind::RightBrace)) {
+    if (current().is(PunctuatorKind::Dot) ||
+        current().is(PunctuatorKind::LeftBracket)) {
+      const auto designationStart = current().start;
+      const auto designatorMark = ast.beginList();
+      do {
+        const auto offset = current().start;
+        if (accept(PunctuatorKind::Dot)) {
+          const auto designator = node(NodeKind::FieldDesignator, offset);
+          ast[designator].name = expectIdentifier();
+          ast.pushToList(designator);
+        } else if (accept(PunctuatorKind::LeftBracket)) {
+          const auto index = parseConditionalExpression();
+          expect(PunctuatorKind::RightBracket, "']'");
+          ast.pushToList(node(NodeKind::ArrayDesignator, offset, index));
+        } else {
+          expect(PunctuatorKind::Assign, "'='");
+        }
+      } while (!accept(PunctuatorKind::Assign));
+      const auto designators = ast.endList(designatorMark);
+
+      const auto initializer = parseInitializer();
+      const auto designation =
+          node(NodeKind::Designation, designationStart, 0, initializer);
+      ast[designation].list = designators;
+      ast.pushToList(designation);
+    } else {
+      const auto initializer = parseInitializer();
+      ast.pushToList(initializer);
+    }
+    if (!accept(PunctuatorKind::Comma)) break;
+  }
+  expect(PunctuatorKind::RightBrace, "'}'");
+
+  const auto list = node(NodeKind::InitList, start);
+  ast[list].list = ast.endList(mark);
+  return list;
+}
+
+NodeID Parser::parseFunctionDefinition(NodeID function) {
+  const auto type = ast[function].a;
+  if (!current().is(PunctuatorKind::LeftBrace)) {
+    parseOldStyleParameterDeclarations(type);
+  }
+
+  enterScope();
+  for (const auto param : ast.list(ast[type].list)) {
+    declare(ast[param].name, param, ast[param].offset);
+  }
+
+  labels.clear();
+  gotos.clear();
+  const auto body = parseCompoundStatement(false);
+  exitScope();
+
+  for (const auto jump : gotos) {
+    const auto name = ast[jump].name;
+    if (const auto it = labels.find(name); it != labels.end()) {
+      ast[jump].a = it->second;
+    } else {
+      const auto spelling = strings.view(name);
+      errOut.reportsError({ErrorID::UndefinedLabel,
+                           {ast[jump].offset, ast[jump].offset + spelling.size()},
+                           {spelling}});
+    }
+  }
+
+  return node(NodeKind::FunctionDef, ast[function].offset, function, body);
+}
+
+// The declaration list between the identifier list and the body of an old
+// style function definition, e.g. "int f(a, b) int a; char b; { ... }".
+void Parser::parseOldStyleParameterDeclarations(NodeID functionType) {
+  const auto params = ast.list(ast[functionType].list);
+  while (isDeclarationStart(current())) {
+    const auto spec = parseDeclarationSpecifiers(true);
+    const auto base = makeSpecifiedType(spec);
+    do {
+      const auto derivationMark = derivations.size();
+      CodeBuffer::Offset offset = 0;
+      const auto name = parseDeclarator(false, &offset);
+      const auto type = applyDerivations(base, derivationMark);
+
+      const auto param = std::find_if(params.begin(), params.end(), [&](NodeID id) {
+        return ast[id].name == name;
+      });
+      if (param == params.end()) {
+        const auto spelling = strings.view(name);
+        errOut.reportsError({ErrorID::UnknownParameter,
+                             {offset, offset + spelling.size()},
+                             {spelling}});
+      } else {
+        ast[*param].a = type;
+      }
+    } while (accept(PunctuatorKind::Comma));
+    expect(PunctuatorKind::Semicolon, "';'");
+  }
+}
+
+/* Statements */
+
+NodeID Parser::parseStatement() {
+  const auto& token = current();
+  if (token.kind == ParserToken::Kind::Keyword) {
+    switch (token.keyword) {
+      case Keyword::If: return parseIfStatement();
+      case Keyword::Switch: return parseSwitchStatement();
+      case Keyword::While: return parseWhileStatement();
+      case Keyword::Do: return parseDoStatement();
+      case Keyword::For: return parseForStatement();
+      case Keyword::Case:
+      case Keyword::Default: return parseLabeledStatement();
+      case Keyword::Goto:
+      case Keyword::Continue:
+      case Keyword::Break:
+      case Keyword::Return: return parseJumpStatement();
+      default: break;
+    }
+  }
+  if (token.is(PunctuatorKind::LeftBrace)) return parseCompoundStatement();
+  if (token.kind == ParserToken::Kind::Identifier &&
+      peek().is(PunctuatorKind::Colon)) {
+    return parseLabeledStatement();
+  }
+
+  const auto start = token.start;
+  if (accept(PunctuatorKind::Semicolon)) return node(NodeKind::ExprStmt, start);
+  const auto expr = parseExpression();
+  expect(PunctuatorKind::Semicolon, "';'");
+  return node(NodeKind::ExprStmt, start, expr);
+}
+
+NodeID Parser::parseCompoundStatement(bool opensScope) {
+  const auto start = expect(PunctuatorKind::LeftBrace, "'{'").start;
+  if (opensScope) enterScope();
+
+  const auto mark = ast.beginList();
+  while (!current().is(PunctuatorKind::RightBrace) &&
+         current().kind != ParserToken::Kind::EndOfInput) {
+    const auto state = checkpoint();
+    try {
+      const bool isLabel = current().kind == ParserToken::Kind::Identifier &&
+                           peek().is(PunctuatorKind::Colon);
+      const auto item = !isLabel && isDeclarationStart(current())
+                            ? parseDeclaration(false)
+                            : parseStatement();
+      ast.pushToList(item);
+    } catch (const ParseError&) {
+      restore(state);
+      synchronize(true);
+    }
+  }
+  const auto items = ast.endList(mark);
+  expect(PunctuatorKind::RightBrace, "'}'");
+
+  if (opensScope) exitScope();
+  const auto compound = node(NodeKind::CompoundStmt, start);
+  ast[compound].list = items;
+  return compound;
+}
+
+NodeID Parser::parseIfStatement() {
+  const auto start = consume().start;
+  expect(PunctuatorKind::LeftParenthesis, "'('");
+  const auto condition = parseExpression();
+  expect(PunctuatorKind::RightParenthesis, "')'");
+  const auto then = parseStatement();
+  const auto otherwise = accept(Keyword::Else) ? parseStatement() : 0;
+  return node(NodeKind::IfStmt, start, condition, then, otherwise);
+}
+
+NodeID Parser::parseSwitchStatement() {
+  const auto start = consume().start;
+  expect(PunctuatorKind::LeftParenthesis, "'('");
+  const auto condition = parseExpression();
+  expect(PunctuatorKind::RightParenthesis, "')'");
+
+  const auto labelMark = switchLabels.size();
+  switchDepth++;
+  const auto body = parseStatement();
+  switchDepth--;
+
+  const auto statement = node(NodeKind::SwitchStmt, start, condition, body);
+  const auto mark = ast.beginList();
+  bool hasDefault = false;
+  for (auto i = labelMark; i < switchLabels.size(); i++) {
+    const auto label = switchLabels[i];
+    if (ast[label].kind == NodeKind::DefaultStmt) {
+      if (hasDefault) {
+        const auto offset = ast[label].offset;
+        errOut.reportsError({ErrorID::DuplicatedDefault, {offset, offset + 7}});
+      }
+      hasDefault = true;
+    }
+    ast.pushToList(label);
+  }
+  ast[statement].list = ast.endList(mark);
+  switchLabels.resize(labelMark);
+  return statement;
+}
+
+NodeID Parser::parseWhileStatement() {
+  const auto start = consume().start;
+  expect(PunctuatorKind::LeftParenthesis, "'('");
+  const auto condition = parseExpression();
+  expect(PunctuatorKind::RightParenthesis, "')'");
+
+  loopDepth++;
+  const auto body = parseStatement();
+  loopDepth--;
+  return node(NodeKind::WhileStmt, start, condition, body);
+}
+
+NodeID Parser::parseDoStatement() {
+  const auto start = consume().start;
+  loopDepth++;
+  const auto body = parseStatement();
+  loopDepth--;
+
+  if (!accept(Keyword::While)) fail(ErrorID::ExpectedToken, {"\"while\""});
+  expect(PunctuatorKind::LeftParenthesis, "'('");
+  const auto condition = parseExpression();
+  expect(PunctuatorKind::RightParenthesis, "')'");
+  expect(PunctuatorKind::Semicolon, "';'");
+  return node(NodeKind::DoStmt, start, body, condition);
+}
+
+NodeID Parser::parseForStatement() {
+  const auto start = consume().start;
+  expect(PunctuatorKind::LeftParenthesis, "'('");
+
+  // The declaration in the first clause is only visible inside the loop.
+  enterScope();
+  NodeID init = 0;
+  if (isDeclarationStart(current())) {
+    init = parseDeclaration(false);
+  } else if (!accept(PunctuatorKind::Semicolon)) {
+    const auto offset = current().start;
+    const auto expr = parseExpression();
+    init = node(NodeKind::ExprStmt, offset, expr);
+    expect(PunctuatorKind::Semicolon, "';'");
+  }
+
+  NodeID condition = 0;
+  if (!current().is(PunctuatorKind::Semicolon)) condition = parseExpression();
+  expect(PunctuatorKind::Semicolon, "';'");
+
+  NodeID step = 0;
+  if (!current().is(PunctuatorKind::RightParenthesis)) step = parseExpression();
+  expect(PunctuatorKind::RightParenthesis, "')'");
+
+  loopDepth++;
+  const auto body = parseStatement();
+  loopDepth--;
+  exitScope();
+
+  const auto statement = node(NodeKind::ForStmt, start, init, condition, step);
+  ast[statement].d = body;
+  return statement;
+}
+
+NodeID Parser::parseLabeledStatement() {
+  const auto token = consume();
+
+  if (token.is(Keyword::Case) || token.is(Keyword::Default)) {
+    const bool isCase = token.is(Keyword::Case);
+    const auto value = isCase ? parseConditionalExpression() : 0;
+    expect(PunctuatorKind::Colon, "':'");
+    const auto statement = parseStatement();
+
+    const auto label = node(isCase ? NodeKind::CaseStmt : NodeKind::DefaultStmt,
+                            token.start, value, statement);
+    if (switchDepth == 0) {
+      errOut.reportsError({ErrorID::LabelOutsideSwitch,
+                           {token.start, token.end},
+                           {spelling(token)}});
+    } else {
+      switchLabels.push_back(label);
+    }
+    return label;
+  }
+
+  expect(PunctuatorKind::Colon, "':'");
+  const auto statement = parseStatement();
+  const auto label = node(NodeKind::LabelStmt, token.start, 0, statement);
+  ast[label].name = token.text;
+  if (!labels.emplace(token.text, label).second) {
+    errOut.reportsError({ErrorID::DuplicatedLabel,
+                         {token.start, token.end},
+                         {strings.view(token.text)}});
+  }
+  return label;
+}
+
+NodeID Parser::parseJumpStatement() {
+  const auto token = consume();
+  NodeID statement = 0;
+
+  switch (token.keyword) {
+    case Keyword::Goto: {
+      const auto offset = current().start;
+      const auto name = expectIdentifier();
+      statement = node(NodeKind::GotoStmt, offset);
+      ast[statement].name = name;
+      gotos.push_back(statement);
+      break;
+    }
+    case Keyword::Continue:
+      if (loopDepth == 0) {
+        errOut.reportsError({ErrorID::ContinueOutsideLoop, {token.start, token.end}});
+      }
+      statement = node(NodeKind::ContinueStmt, token.start);
+      break;
+    case Keyword::Break:
+      if (loopDepth == 0 && switchDepth == 0) {
+        errOut.reportsError({ErrorID::BreakOutsideLoopOrSwitch,
+                             {token.start, token.end}});
+      }
+      statement = node(NodeKind::BreakStmt, token.start);
+      break;
+    default: {
+      const auto value =
+          current().is(PunctuatorKind::Semicolon) ? 0 : parseExpression();
+      statement = node(NodeKind::ReturnStmt, token.start, value);
+      break;
+    }
+  }
+
+  expect(PunctuatorKind::Semicolon, "';'");
+  return statement;
+}
+
+/* Expressions */
+
+NodeID Parser::parseExpression() {
+  return parseExpression(Precedence::Comma);
+}
+
+NodeID Parser::parseAssignmentExpression() {
+  return parseExpression(Precedence::Assignment);
+}
+
+NodeID Parser::parseConditionalExpression() {
+  return parseExpression(Precedence::Conditional);
+}
+
+// Parse an expression whose infix operators bind at least as tightly as
+// minPrecedence. Each operand costs one call no matter how many precedence
+// levels there are: the loop folds operators of the same or lower level into
+// the left operand, and the recursion only goes deeper for operators that
+// bind more tightly than the previous one.
+NodeID Parser::parseExpression(Precedence minPrecedence) {
+  statistics.expressionCalls++;
+
+  auto left = parseCastExpression();
+  while (true) {
+    const auto& infix = infixOperator(current());
+    if (infix.precedence == Precedence::None ||
+        infix.precedence < minPrecedence) {
+      return left;
+    }
+
+    const auto offset = consume().start;
+    const auto nextPrecedence =
+        infix.isRightAssociative
+            ? infix.precedence
+            : static_cast<Precedence>(static_cast<int>(infix.precedence) + 1);
+
+    if (infix.kind == NodeKind::Conditional) {
+      const auto then = parseExpression(Precedence::Comma);
+      expect(PunctuatorKind::Colon, "':'");
+      const auto otherwise = parseExpression(nextPrecedence);
+      left = node(NodeKind::Conditional, offset, left, then, otherwise);
+      continue;
+    }
+
+    const auto right = parseExpression(nextPrecedence);
+    left = node(infix.kind, offset, left, right);
+    ast[left].op = static_cast<std::uint8_t>(infix.op);
+  }
+}
+
+NodeID Parser::parseCastExpression() {
+  statistics.expressionCalls++;
+  if (!current().is(PunctuatorKind::LeftParenthesis) ||
+      !isTypeNameStart(peek())) {
+    return parseUnaryExpression();
+  }
+
+  const auto offset = consume().start;
+  const auto type = parseTypeName();
+  expect(PunctuatorKind::RightParenthesis, "')'");
+  if (current().is(PunctuatorKind::LeftBrace)) {
+    return parsePostfixExpression(parseCompoundLiteral(type, offset));
+  }
+  const auto operand = parseCastExpression();
+  return node(NodeKind::Cast, offset, type, operand);
+}
+
+NodeID Parser::parseUnaryExpression() {
+  statistics.expressionCalls++;
+  const auto& token = current();
+
+  if (token.is(PunctuatorKind::Increment) || token.is(PunctuatorKind::Decrement)) {
+    const auto op = token.is(PunctuatorKind::Increment) ? Operator::PreIncrement
+                                                        : Operator::PreDecrement;
+    const auto offset = consume().start;
+    const auto operand = parseUnaryExpression();
+    const auto expr = node(NodeKind::Unary, offset, operand);
+    ast[expr].op = static_cast<std::uint8_t>(op);
+    return expr;
+  }
+
+  if (const auto op = prefixOperator(token)) {
+    const auto offset = consume().start;
+    const auto operand = parseCastExpression();
+    const auto expr = node(NodeKind::Unary, offset, operand);
+    ast[expr].op = static_cast<std::uint8_t>(*op);
+    return expr;
+  }
+
+  if (token.is(Keyword::Sizeof)) {
+    const auto offset = consume().start;
+    if (current().is(PunctuatorKind::LeftParenthesis) &&
+        isTypeNameStart(peek())) {
+      const auto typeOffset = consume().start;
+      const auto type = parseTypeName();
+      expect(PunctuatorKind::RightParenthesis, "')'");
+      if (!current().is(PunctuatorKind::LeftBrace)) {
+        return node(NodeKind::SizeofType, offset, type);
+      }
+      const auto literal =
+          parsePostfixExpression(parseCompoundLiteral(type, typeOffset));
+      return node(NodeKind::SizeofExpr, offset, literal);
+    }
+    const auto operand = parseUnaryExpression();
+    return node(NodeKind::SizeofExpr, offset, operand);
+  }
+
+  return parsePostfixExpression(parsePrimaryExpression());
+}
+
+NodeID Parser::parsePostfixExpression(NodeID expr) {
+  while (true) {
+    const auto& token = current();
+    if (token.kind != ParserToken::Kind::Punctuator) return expr;
+
+    switch (token.punctuator) {
+      case PunctuatorKind::LeftBracket: {
+        const auto offset = consume().start;
+        const auto index = parseExpression();
+        expect(PunctuatorKind::RightBracket, "']'");
+        expr = node(NodeKind::Subscript, offset, expr, index);
+        break;
+      }
+      case PunctuatorKind::LeftParenthesis: {
+        const auto offset = consume().start;
+        const auto mark = ast.beginList();
+        if (!current().is(PunctuatorKind::RightParenthesis)) {
+          do {
+            ast.pushToList(parseAssignmentExpression());
+          } while (accept(PunctuatorKind::Comma));
+        }
+        expect(PunctuatorKind::RightParenthesis, "')'");
+        const auto arguments = ast.endList(mark);
+        expr = node(NodeKind::Call, offset, expr);
+        ast[expr].list = arguments;
+        break;
+      }
+      case PunctuatorKind::Dot:
+      case PunctuatorKind::Arrow: {
+        const bool isArrow = token.punctuator == PunctuatorKind::Arrow;
+        const auto offset = consume().start;
+        const auto name = expectIdentifier();
+        expr = node(NodeKind::Member, offset, expr);
+        ast[expr].name = name;
+        if (isArrow) ast[expr].flags |= NodeFlag::Arrow;
+        break;
+      }
+      case PunctuatorKind::Increment:
+      case PunctuatorKind::Decrement: {
+        const auto op = token.punctuator == PunctuatorKind::Increment
+                            ? Operator::PostIncrement
+                            : Operator::PostDecrement;
+        const auto offset = consume().start;
+        expr = node(NodeKind::Unary, offset, expr);
+        ast[expr].op = static_cast<std::uint8_t>(op);
+        break;
+      }
+      default:
+        return expr;
+    }
+  }
+}
+
+NodeID Parser::parsePrimaryExpression() {
+  statistics.expressionCalls++;
+  statistics.primaryExpressions++;
+  const auto& token = current();
+  switch (token.kind) {
+    case ParserToken::Kind::Identifier: {
+      if (isTypedefName(token)) fail(ErrorID::ExpectedExpression);
+      const auto expr =
+          node(NodeKind::Identifier, token.start, symbols.lookup(token.text));
+      ast[expr].name = token.text;
+      consume();
+      return expr;
+    }
+    case ParserToken::Kind::NumberLiteral: {
+      const auto kind = isFloatingLiteral(strings.view(token.text))
+                            ? NodeKind::FloatingLiteral
+                            : NodeKind::IntegerLiteral;
+      const auto expr = node(kind, token.start);
+      ast[expr].name = token.text;
+      consume();
+      return expr;
+    }
+    case ParserToken::Kind::CharacterLiteral: {
+      const auto expr = node(NodeKind::CharacterLiteral, token.start);
+      ast[expr].name = token.text;
+      if (token.isWide) ast[expr].flags |= NodeFlag::Wide;
+      consume();
+      return expr;
+    }
+    case ParserToken::Kind::StringLiteral:
+      return parseStringLiteral();
+    default:
+      break;
+  }
+
+  if (accept(PunctuatorKind::LeftParenthesis)) {
+    const auto expr = parseExpression();
+    expect(PunctuatorKind::RightParenthesis, "')'");
+    return expr;
+  }
+  fail(ErrorID::ExpectedExpression);
+}
+
+// Adjacent string literals are concatenated into one literal, which is wide
+// if any of them is.
+NodeID Parser::parseStringLiteral() {
+  const auto start = current().start;
+  std::vector<StringID> pieces;
+  bool isWide = false;
+  while (current().kind == ParserToken::Kind::StringLiteral) {
+    isWide = isWide || current().isWide;
+    pieces.push_back(consume().text);
+  }
+
+  std::string content;
+  for (const auto piece : pieces) {
+    appendDecodedCharSequence(content, strings.view(piece), isWide);
+  }
+
+  const auto literal = node(NodeKind::StringLiteral, start);
+  ast[literal].name = strings.intern(content);
+  if (isWide) ast[literal].flags |= NodeFlag::Wide;
+  return literal;
+}
+
+NodeID Parser::parseCompoundLiteral(NodeID type, CodeBuffer::Offset offset) {
+  const auto initializer = parseInitializer();
+  return node(NodeKind::CompoundLiteral, offset, type, initializer);
+}
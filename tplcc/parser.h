@@ -0,0 +1,222 @@
+#ifndef TPLCC_PARSER_H
+#define TPLCC_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "error.h"
+#include "Lexer.h"
+#include "string-interner.h"
+#include "symbol-table.h"
+#include "time-report.h"
+
+// The token as the parser sees it: every piece of text is interned and
+// punctuators are turned into PunctuatorKinds, so looking at a token never
+// compares strings.
+struct ParserToken {
+  enum class Kind : std::uint8_t {
+    EndOfInput,
+    Punctuator,
+    Identifier,
+    Keyword,
+    NumberLiteral,
+    StringLiteral,
+    CharacterLiteral,
+    Stray,
+  };
+
+  Kind kind = Kind::EndOfInput;
+  PunctuatorKind punctuator = PunctuatorKind::Semicolon;
+  Keyword keyword = Keyword::Auto;
+  bool isWide = false;
+  StringID text = 0;
+  CodeBuffer::Offset start = 0;
+  CodeBuffer::Offset end = 0;
+
+  bool is(PunctuatorKind kind) const {
+    return this->kind == Kind::Punctuator && punctuator == kind;
+  }
+  bool is(Keyword kind) const {
+    return this->kind == Kind::Keyword && keyword == kind;
+  }
+};
+
+// How tightly an infix operator binds, a higher precedence binds tighter.
+enum class Precedence : std::uint8_t {
+  None,
+  Comma,
+  Assignment,
+  Conditional,
+  LogicalOr,
+  LogicalAnd,
+  BitwiseOr,
+  BitwiseXor,
+  BitwiseAnd,
+  Equality,
+  Relational,
+  Shift,
+  Additive,
+  Multiplicative,
+};
+
+// A recursive-descent parser for C99. It reads tokens from the lexer and
+// appends the nodes to the AST, see ast.h for the shape of the tree. Binary
+// operators are parsed by precedence climbing over a table of operators.
+//
+// C cannot be parsed without knowing which identifiers are typedef names, so
+// the parser keeps track of the scopes and resolves every identifier to its
+// declaration as it goes.
+//
+// Syntax errors are reported and the parser skips to the end of the
+// statement or declaration, so one mistake doesn't hide the rest.
+class Parser {
+  struct DeclSpec {
+    StorageClass storage = StorageClass::None;
+    std::uint8_t qualifiers = 0;
+    std::uint16_t specifiers = 0;
+    bool isInline = false;
+    // The RecordType, EnumType or TypedefType, if the specifiers have one.
+    NodeID type = 0;
+    CodeBuffer::Offset offset = 0;
+  };
+
+  // One step of building the type of a declarator, e.g. "pointer to" or
+  // "array of".
+  struct Derivation {
+    NodeKind kind = NodeKind::PointerType;
+    std::uint8_t qualifiers = 0;
+    std::uint16_t flags = 0;
+    CodeBuffer::Offset offset = 0;
+    // The size of an array.
+    NodeID operand = 0;
+    ListRef parameters;
+  };
+
+  // What has to be rolled back when the parser gives up on a statement or a
+  // declaration halfway.
+  struct Checkpoint {
+    std::size_t listMark;
+    std::size_t numberOfDerivations;
+    std::size_t numberOfScopes;
+    std::size_t numberOfSwitchLabels;
+    std::uint32_t loopDepth;
+    std::uint32_t switchDepth;
+  };
+
+  Lexer& lexer;
+  AST& ast;
+  StringInterner& strings;
+  IReportError& errOut;
+  // Measures the lexer if it isn't nullptr.
+  TimeReport* timeReport;
+
+  ParserToken tokens[2];
+  std::size_t numberOfPeekedTokens = 0;
+  CodeBuffer::Offset previousTokenEnd = 0;
+
+  // Ordinary identifiers and tags have separate name spaces.
+  SymbolTable symbols;
+  SymbolTable tags;
+
+  // Declarators are read into this stack, see parseDeclarator.
+  std::vector<Derivation> derivations;
+
+  // State of the function being parsed.
+  std::unordered_map<StringID, NodeID> labels;
+  std::vector<NodeID> gotos;
+  std::vector<NodeID> switchLabels;
+  std::uint32_t loopDepth = 0;
+  std::uint32_t switchDepth = 0;
+
+ public:
+  Parser(Lexer& lexer, AST& ast, StringInterner& strings,
+         IReportError& errOut, TimeReport* timeReport = nullptr);
+
+  struct Statistics {
+    std::uint64_t expressionCalls = 0;
+    std::uint64_t primaryExpressions = 0;
+  };
+
+  NodeID parseTranslationUnit();
+  NodeID parseExpression();
+
+  // Counters for benchmarking the parser.
+  const Statistics& stats() const { return statistics; }
+
+  // The declarations of the file scope, complete after parseTranslationUnit.
+  const SymbolTable& fileScope() const { return symbols; }
+
+ private:
+  // Tokens
+  const ParserToken& current();
+  const ParserToken& peek();
+  ParserToken consume();
+  bool accept(PunctuatorKind kind);
+  bool accept(Keyword keyword);
+  ParserToken expect(PunctuatorKind kind, const char* spelling);
+  StringID expectIdentifier();
+  ParserToken readToken();
+  [[noreturn]] void fail(ErrorID id,
+                         std::initializer_list<std::string_view> arguments = {});
+  std::string_view spelling(const ParserToken& token) const;
+  Checkpoint checkpoint() const;
+  void restore(const Checkpoint& checkpoint);
+  void synchronize(bool stopsAtRightBrace);
+
+  // Scopes
+  void enterScope();
+  void exitScope();
+  void declare(StringID name, NodeID decl, CodeBuffer::Offset offset);
+  bool isTypedefName(const ParserToken& token) const;
+  bool isTypeNameStart(const ParserToken& token) const;
+  bool isDeclarationStart(const ParserToken& token) const;
+
+  NodeID node(NodeKind kind, CodeBuffer::Offset offset, NodeID a = 0,
+              NodeID b = 0, NodeID c = 0);
+
+  // Declarations
+  NodeID parseDeclaration(bool isExternal);
+  DeclSpec parseDeclarationSpecifiers(bool allowStorageClass);
+  NodeID parseRecordSpecifier();
+  NodeID parseEnumSpecifier();
+  NodeID makeSpecifiedType(const DeclSpec& spec);
+  StringID parseDeclarator(bool allowAbstract, CodeBuffer::Offset* offset);
+  bool isNestedDeclaratorStart(bool allowAbstract);
+  void parseDeclaratorSuffixes();
+  void parseStructDeclaration();
+  Derivation parseParameterList(CodeBuffer::Offset offset);
+  NodeID applyDerivations(NodeID type, std::size_t mark);
+  NodeID parseTypeName();
+  NodeID parseInitializer();
+  NodeID parseFunctionDefinition(NodeID function);
+  void parseOldStyleParameterDeclarations(NodeID functionType);
+
+  // Statements
+  NodeID parseStatement();
+  NodeID parseCompoundStatement(bool opensScope = true);
+  NodeID parseIfStatement();
+  NodeID parseSwitchStatement();
+  NodeID parseWhileStatement();
+  NodeID parseDoStatement();
+  NodeID parseForStatement();
+  NodeID parseLabeledStatement();
+  NodeID parseJumpStatement();
+
+  // Expressions
+  NodeID parseExpression(Precedence minPrecedence);
+  NodeID parseAssignmentExpression();
+  NodeID parseConditionalExpression();
+  NodeID parseCastExpression();
+  NodeID parseUnaryExpression();
+  NodeID parsePostfixExpression(NodeID expr);
+  NodeID parsePrimaryExpression();
+  NodeID parseStringLiteral();
+  NodeID parseCompoundLiteral(NodeID type, CodeBuffer::Offset offset);
+
+  Statistics statistics;
+};
+
+#endif
@@ -7,7 +7,7 @@
 #include <compare>
 #include <concepts>
 #include <cstdint>
-#include <format>
+#include <map>
 #include <memory>
 #include <optional>
 #include <set>
@@ -19,10 +19,14 @@
 #include <variant>
 #include <vector>
 
+#include "Lexer.h"
 #include "code-buffer.h"
+#include "constant-evaluator.h"
 #include "encoding.h"
 #include "error.h"
 #include "helper.h"
+#include "include-files.h"
+#include "string-scanner.h"
 
 template <typename F>
 concept ByteDecoderConcept = requires(F func, const unsigned char* addr) {
@@ -36,6 +40,9 @@ struct MacroDefinition {
   std::string name;
   std::vector<std::string> parameters;
   std::string body;
+  // Range of the #define directive, from the '#' to the end of the body.
+  CodeBuffer::Offset definitionStart = 0;
+  CodeBuffer::Offset definitionEnd = 0;
 
   MacroDefinition(std::string name, std::string body,
                   MacroType type = MacroType::OBJECT_LIKE_MACRO)
@@ -52,6 +59,47 @@ struct MacroDefinition {
 
 using PreprocessorDirective = std::variant<MacroDefinition>;
 
+struct CompareMacroDefinition {
+  using is_transparent = std::true_type;
+
+  bool operator()(const MacroDefinition& lhs,
+                  const MacroDefinition& rhs) const {
+    return lhs.name < rhs.name;
+  }
+
+  bool operator()(const std::string& lhs, const MacroDefinition& rhs) const {
+    return lhs < rhs.name;
+  }
+
+  bool operator()(const MacroDefinition& lhs, const std::string& rhs) const {
+    return lhs.name < rhs;
+  }
+};
+
+using MacroTable = std::set<MacroDefinition, CompareMacroDefinition>;
+
+// Add the macro to the table, replacing the one with the same name.
+inline void defineMacro(MacroTable& table, MacroDefinition macro) {
+  if (const auto it = table.find(macro.name); it != table.end()) {
+    table.erase(it);
+  }
+  table.insert(std::move(macro));
+}
+
+struct PreprocessorOptions {
+  // Macros defined before the first line, built once to be shared by the
+  // preprocessors of many files. Each one starts with a copy of it.
+  const MacroTable* predefinedMacroTable = nullptr;
+  // Defined before the first line too, after the table, like the macros
+  // given by -D.
+  std::vector<MacroDefinition> predefinedMacros;
+  // Where #include finds files, it can't find any if this is nullptr.
+  IIncludeFiles* includeFiles = nullptr;
+};
+
+// Deeper nesting of #include is taken for a file including itself.
+constexpr std::size_t MAX_INCLUDE_DEPTH = 200;
+
 struct Loc {
   size_t lineNumber;
   size_t charOffset;
@@ -89,23 +137,6 @@ concept CreatescannerFunc =
       { func(buffer, offset) };
     };
 
-struct CompareMacroDefinition {
-  using is_transparent = std::true_type;
-
-  bool operator()(const MacroDefinition& lhs,
-                  const MacroDefinition& rhs) const {
-    return lhs.name < rhs.name;
-  }
-
-  bool operator()(const std::string& lhs, const MacroDefinition& rhs) const {
-    return lhs < rhs.name;
-  }
-
-  bool operator()(const MacroDefinition& lhs, const std::string& rhs) const {
-    return lhs.name < rhs;
-  }
-};
-
 std::string parseIdentifier(IBaseScanner& scanner);
 bool isStartOfIdentifier(int ch);
 
@@ -118,6 +149,8 @@ class PPCharacter {
   PPCharacter(int codepoint, CodeBuffer::Offset offset)
       : _codepoint(codepoint), _offset(offset) {}
   operator int() const { return _codepoint; }
+  // Where the character starts in the code buffer. A space standing for a
+  // row of spaces and comments starts where the row does.
   int offset() const { return _offset; }
 
   static PPCharacter eof() { return PPCharacter(EOF, 0); }
@@ -262,7 +295,7 @@ class PPScanner : public IOffsetLookaheadable<PPLookaheadScanner<F>> {
     const auto charOffset = _offset;
     const auto [codepoint, codelen] = _decodeChar(_codeBuffer.pos(_offset));
     _offset += codelen;
-    if (currentSectionID() == 0) skipBackslashReturn();
+    if (_codeBuffer.isFileSection(currentSectionID())) skipBackslashReturn();
     return codepoint;
   }
 
@@ -326,7 +359,9 @@ int PPLookaheadScanner<F>::get() {
   const auto [codepoint, codelen] =
       _pps._decodeChar(_pps._codeBuffer.pos(_offset));
   _offset += codelen;
-  if (currentSectionID() == 0) skipBackslashReturn();
+  if (_pps._codeBuffer.isFileSection(currentSectionID())) {
+    skipBackslashReturn();
+  }
   return codepoint;
 }
 
@@ -503,25 +538,44 @@ template <ByteDecoderConcept F>
 class PPImpl {
   CodeBuffer& codeBuffer;
   IReportError& errOut;
+  IIncludeFiles* includeFiles;
 
-  // A cache for macro that has been expanded before.
-  std::map<std::string, CodeBuffer::SectionID> codeCache;
+  // The texts of macros expanded before, by the macro and its arguments.
+  // Every invocation still gets a section of its own, for its origin.
+  std::map<std::string, std::string> expansionCache;
   std::map<CodeBuffer::SectionID, std::string> mapOfSectionIDToMacroName;
-  std::set<MacroDefinition, CompareMacroDefinition> setOfMacroDefinitions;
+  MacroTable setOfMacroDefinitions;
 
   std::unique_ptr<OffsetCharScanner<F>> identScanner;
   PPScanner<F> scanner;
 
+  // The #if, #ifdef and #ifndef groups the scanner is in, innermost last.
+  struct ConditionalGroup {
+    // The range of the "#if" that starts the group.
+    CodeBuffer::Offset start;
+    CodeBuffer::Offset end;
+    bool hasTakenBranch;
+    bool hasSeenElse;
+  };
+  std::vector<ConditionalGroup> conditionalStack;
+
   bool canParseDirectives = true;
   bool justOuputedSpace = false;
 
  public:
-  PPImpl(CodeBuffer& codeBuffer, IReportError& errOut, F&& readUTF32)
+  PPImpl(CodeBuffer& codeBuffer, IReportError& errOut,
+         PreprocessorOptions options, F&& readUTF32)
       : codeBuffer(codeBuffer),
         errOut(errOut),
-        setOfMacroDefinitions(setOfMacroDefinitions),
-        codeCache(codeCache),
+        includeFiles(options.includeFiles),
         scanner(codeBuffer, std::forward<F>(readUTF32)) {
+    if (options.predefinedMacroTable != nullptr) {
+      setOfMacroDefinitions = *options.predefinedMacroTable;
+    }
+    // A later definition of the same macro replaces the earlier one.
+    for (auto& macroDef : options.predefinedMacros) {
+      defineMacro(setOfMacroDefinitions, std::move(macroDef));
+    }
     fastForwardToFirstOutputCharacter();
   }
 
@@ -541,6 +595,21 @@ class PPImpl {
   }
   void fastForwardToFirstOutputCharacter();
   void parseDirective();
+  void includeFile(const std::string& name, bool isAngled,
+                   CodeBuffer::Offset start, CodeBuffer::Offset end);
+  const std::string& currentFile() const;
+
+  // Conditional inclusion
+  void enterConditionalGroup(CodeBuffer::Offset start, CodeBuffer::Offset end,
+                             bool isTaken);
+  void skipConditionalGroup();
+  void skipRestOfLine();
+  bool evaluateCondition(PPDirectiveScanner<F>& ppds);
+  std::optional<Error> expandConditionMacros(
+      std::string_view text,
+      std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range,
+      std::vector<std::string>& disabledMacros, std::string& output);
+  void reportUnterminatedConditionals();
   void skipNewline(IBaseScanner& scanner) {
     if (scanner.peek() == '\r') scanner.get();
     if (scanner.peek() == '\n') scanner.get();
@@ -551,8 +620,9 @@ class PPImpl {
     return skipSpaces(scanner, ::isSpace);
   }
 
-  MacroExpansionResult::Type tryExpandingMacro(const std::string& macroName,
-                                               PPScanner<F>& scanner);
+  MacroExpansionResult::Type tryExpandingMacro(
+      const std::string& macroName, CodeBuffer::Offset invocationStart,
+      PPScanner<F>& scanner);
 
   template <std::derived_from<IBaseScanner> T>
   std::variant<std::vector<std::string>, Error>
@@ -618,8 +688,8 @@ std::optional<Error> PPImpl<F>::skipSpacesAndComments(
       }
 
       if (scanner.reachedEndOfInput()) {
-        return Error{
-            {startOffset, startOffset + 2}, "Unterminated comment.", ""};
+        return Error{ErrorID::UnterminatedComment,
+                     {startOffset, startOffset + 2}};
       }
 
       scanner.get();
@@ -649,7 +719,10 @@ class Preprocessor {
  public:
   Preprocessor(CodeBuffer& codeBuffer, IReportError& errOut,
                F&& readUTF32 = utf8)
-      : ppImpl(codeBuffer, errOut, std::move(readUTF32)) {}
+      : ppImpl(codeBuffer, errOut, {}, std::move(readUTF32)) {}
+  Preprocessor(CodeBuffer& codeBuffer, IReportError& errOut,
+               PreprocessorOptions options, F&& readUTF32 = utf8)
+      : ppImpl(codeBuffer, errOut, std::move(options), std::move(readUTF32)) {}
 
   PPCharacter get() {
     if (lookaheadBuffer) {
@@ -673,7 +746,7 @@ class Preprocessor {
   bool reachedEndOfInput() const { return peek() == EOF; }
 };
 
-std::optional<std::size_t> findIndexOfParameter(
+inline std::optional<std::size_t> findIndexOfParameter(
     const MacroDefinition& macroDef, const std::string& parameterName) {
   const auto& parameters = macroDef.parameters;
   const auto it =
@@ -718,30 +791,32 @@ std::string readAll(T&& scanner) {
 // The MSVC's std::isspace will throw a runtime error when we pass a codepoint
 // that is larger than 255. We have to write our own version of isspace here to
 // avoid this error.
-bool isSpace(int ch) {
+inline bool isSpace(int ch) {
   return ch == ' ' || ch == '\f' || ch == '\n' || ch == '\r' || ch == '\t' ||
          ch == '\v';
 }
-bool isDirectiveSpace(int ch) { return ch == ' ' || ch == '\t'; }
-bool isNewlineCharacter(int ch) { return ch == '\r' || ch == '\n'; }
+inline bool isDirectiveSpace(int ch) { return ch == ' ' || ch == '\t'; }
+inline bool isNewlineCharacter(int ch) { return ch == '\r' || ch == '\n'; }
 
-bool isStartOfIdentifier(int ch) {
+inline bool isStartOfIdentifier(int ch) {
   return ch == '_' || ch >= 'A' && ch <= 'Z' || ch >= 'a' && ch <= 'z';
 }
 
-std::string parseIdentifier(IBaseScanner& scanner) {
+inline std::string parseIdentifier(IBaseScanner& scanner) {
   std::string result;
 
   result.push_back(scanner.get());
 
-  while (!scanner.reachedEndOfInput() && std::isalnum(scanner.peek())) {
+  while (!scanner.reachedEndOfInput() &&
+         (isStartOfIdentifier(scanner.peek()) ||
+          scanner.peek() >= '0' && scanner.peek() <= '9')) {
     result.push_back(scanner.get());
   }
 
   return result;
 }
 
-bool isFirstCharOfIdentifier(const char ch) {
+inline bool isFirstCharOfIdentifier(const char ch) {
   return std::isalpha(ch) || ch == '_';
 }
 
@@ -749,6 +824,8 @@ bool isFirstCharOfIdentifier(const char ch) {
 
 template <ByteDecoderConcept F>
 PPCharacter PPImpl<F>::get() {
+  if (errOut.hasReachedErrorLimit()) return PPCharacter::eof();
+
   if (identScanner) {
     const auto offset = identScanner->offset();
     const auto ch = identScanner->get();
@@ -760,6 +837,7 @@ PPCharacter PPImpl<F>::get() {
   }
 
   if (scanner.reachedEndOfInput()) {
+    reportUnterminatedConditionals();
     justOuputedSpace = false;
     return PPCharacter::eof();
   }
@@ -774,12 +852,19 @@ PPCharacter PPImpl<F>::get() {
     const auto offset = scanner.offset();
     skipSpacesAndComments(scanner);
 
-    if (scanner.peek() == '#' && canParseDirectives) {
+    // The lines of directives go with the spaces, the tokens around them
+    // stay apart, if there are tokens after them.
+    bool hasParsedDirectives = false;
+    while (scanner.peek() == '#' && canParseDirectives) {
       parseDirective();
-      return get();
+      skipSpacesAndComments(scanner);
+      hasParsedDirectives = true;
     }
 
-    if (justOuputedSpace) return get();
+    if (justOuputedSpace ||
+        (hasParsedDirectives && scanner.reachedEndOfInput())) {
+      return get();
+    }
 
     justOuputedSpace = true;
     return PPCharacter(' ', offset);
@@ -795,11 +880,14 @@ PPCharacter PPImpl<F>::get() {
   // until reaching the next line.
   canParseDirectives = false;
 
+  // Leave the sections the scanner is at the end of, so the offsets of the
+  // characters are where they are read.
+  scanner.exitFullyScannedSections();
   if (isStartOfIdentifier(scanner.peek())) {
     using namespace MacroExpansionResult;
     CharOffsetRecorder recorder(scanner);
     const auto identifier = parseIdentifier(recorder);
-    auto res = tryExpandingMacro(identifier, scanner);
+    auto res = tryExpandingMacro(identifier, recorder.offsets()[0], scanner);
 
     if (const auto ptr = std::get_if<Error>(&res)) {
       identScanner = std::make_unique<OffsetCharScanner<F>>(
@@ -827,14 +915,15 @@ PPCharacter PPImpl<F>::get() {
   }
 
   justOuputedSpace = false;
-  const auto ch = scanner.get();
   const auto offset = scanner.offset();
+  const auto ch = scanner.get();
   return PPCharacter(ch, offset);
 }
 
 template <ByteDecoderConcept F>
 MacroExpansionResult::Type PPImpl<F>::tryExpandingMacro(
-    const std::string& macroName, PPScanner<F>& scanner) {
+    const std::string& macroName, CodeBuffer::Offset invocationStart,
+    PPScanner<F>& scanner) {
   const auto startOffset = scanner.offset();
 
   const auto macroDef = setOfMacroDefinitions.find(macroName);
@@ -873,31 +962,33 @@ MacroExpansionResult::Type PPImpl<F>::tryExpandingMacro(
       arguments.push_back("");
     }
     if (macroDef->parameters.size() != arguments.size()) {
-      return Error{
-          {startOffset, scanner.offset()},
-          std::format("The macro \"{}\" requires {} argument(s), but got {}.",
-                      macroDef->name, macroDef->parameters.size(),
-                      arguments.size()),
-          ""};
+      return Error{ErrorID::MacroArgumentCountMismatch,
+                   {startOffset, scanner.offset()},
+                   {macroDef->name,
+                    std::to_string(macroDef->parameters.size()),
+                    std::to_string(arguments.size())}};
     }
     key = createFunctionLikeMacroCacheKey(macroDef->name, arguments);
   } else {
     key = macroDef->name;
   }
 
-  if (const auto iter = codeCache.find(key); iter != codeCache.end()) {
-    return MacroExpansionResult::Ok{iter->second};
-  }
-
-  std::string expandedText;
-  if (macroDef->type == MacroType::FUNCTION_LIKE_MACRO) {
-    expandedText = expandFunctionLikeMacro(*macroDef, arguments);
-  } else {
-    expandedText = macroDef->body.empty() ? " " : macroDef->body;
+  auto cached = expansionCache.find(key);
+  if (cached == expansionCache.end()) {
+    std::string expandedText;
+    if (macroDef->type == MacroType::FUNCTION_LIKE_MACRO) {
+      expandedText = expandFunctionLikeMacro(*macroDef, arguments);
+    } else {
+      expandedText = macroDef->body.empty() ? " " : macroDef->body;
+    }
+    cached = expansionCache.emplace(std::move(key), std::move(expandedText))
+                 .first;
   }
 
-  CodeBuffer::SectionID sectionID = codeBuffer.addSection(expandedText);
-  codeCache.insert({macroDef->name, sectionID});
+  // Diagnostics inside the expansion point back to this invocation.
+  CodeBuffer::SectionID sectionID = codeBuffer.addSection(
+      cached->second, {invocationStart, scanner.offset(),
+                       macroDef->definitionStart, macroDef->definitionEnd});
   mapOfSectionIDToMacroName[sectionID] = macroDef->name;
 
   return MacroExpansionResult::Ok{sectionID};
@@ -938,10 +1029,9 @@ PPImpl<F>::parseFunctionLikeMacroArgumentList(PPScanner<F>& scanner,
     const auto ch = scanner.get();  // will get an EOF here
     const auto endOffset = scanner.offset();
 
-    return Error{{startOffset, endOffset},
-                 std::format("unterminated argument list invoking macro \"{}\"",
-                             macroDef.name),
-                 ""};
+    return Error{ErrorID::UnterminatedMacroArgumentList,
+                 {startOffset, endOffset},
+                 {macroDef.name}};
   }
 
   scanner.get();  // skip the ending ')'
@@ -1011,7 +1101,7 @@ std::string PPImpl<F>::parseFunctionLikeMacroArgument(PPScanner<F>& scanner) {
       const auto startOffset = scanner.offset();
       const auto identifier = parseIdentifier(scanner);
 
-      auto res = tryExpandingMacro(identifier, scanner);
+      auto res = tryExpandingMacro(identifier, startOffset, scanner);
 
       if (const auto ptr = std::get_if<Error>(&res)) {
         errOut.reportsError(std::get<Error>(std::move(res)));
@@ -1071,8 +1161,8 @@ void PPImpl<F>::parseDirective() {
       const auto startOffset = ppds.offset();
       ppds.get();
       const auto endOffset = ppds.offset();
-      error = Error({startOffset, endOffset}, "macro names must be identifiers",
-                    "");
+      error = Error(ErrorID::MacroNameMustBeIdentifier,
+                    {startOffset, endOffset});
       goto fail;
     }
 
@@ -1091,19 +1181,96 @@ void PPImpl<F>::parseDirective() {
     skipSpacesAndComments(ppds, isDirectiveSpace);
     std::string macroBody = readAll(ppds);
 
-    if (macroType == MacroType::OBJECT_LIKE_MACRO) {
-      setOfMacroDefinitions.insert(MacroDefinition(macroName, macroBody));
+    auto macroDef =
+        macroType == MacroType::OBJECT_LIKE_MACRO
+            ? MacroDefinition(macroName, macroBody)
+            : MacroDefinition(macroName, parameters, macroBody);
+    macroDef.definitionStart = startOffset;
+    macroDef.definitionEnd = ppds.offset();
+    setOfMacroDefinitions.insert(std::move(macroDef));
+
+    skipNewline(scanner);
+  } else if (directiveName == "include") {
+    skipSpacesAndComments(ppds, isDirectiveSpace);
+    const auto nameStart = ppds.offset();
+    const int opening = ppds.get();
+    const int closing = opening == '<' ? '>' : '"';
+    std::string name;
+    if (opening == '"' || opening == '<') {
+      while (!ppds.reachedEndOfInput() && ppds.peek() != closing) {
+        name.push_back(ppds.get());
+      }
+    }
+    if ((opening != '"' && opening != '<') || ppds.get() != closing ||
+        name.empty()) {
+      error = Error{ErrorID::ExpectedHeaderName, {nameStart, ppds.offset()}};
+      goto fail;
+    }
+    const auto nameEnd = ppds.offset();
+    skipAll(ppds);
+    skipNewline(scanner);
+    includeFile(name, opening == '<', startOffset, nameEnd);
+  } else if (directiveName == "if") {
+    const bool isTaken = evaluateCondition(ppds);
+    enterConditionalGroup(startOffset, offsetAfterParsingDirectiveName,
+                          isTaken);
+    skipNewline(scanner);
+  } else if (directiveName == "ifdef" || directiveName == "ifndef") {
+    skipSpacesAndComments(ppds, isDirectiveSpace);
+    bool isTaken = false;
+    if (isStartOfIdentifier(ppds.peek())) {
+      const bool isDefined =
+          setOfMacroDefinitions.contains(parseIdentifier(ppds));
+      isTaken = isDefined == (directiveName == "ifdef");
     } else {
-      setOfMacroDefinitions.insert(
-          MacroDefinition(macroName, parameters, macroBody));
+      const auto startOffset = ppds.offset();
+      ppds.get();
+      errOut.reportsError(Error{ErrorID::MacroNameMustBeIdentifier,
+                                {startOffset, ppds.offset()}});
+    }
+    skipAll(ppds);
+    enterConditionalGroup(startOffset, offsetAfterParsingDirectiveName,
+                          isTaken);
+    skipNewline(scanner);
+  } else if (directiveName == "elif" || directiveName == "else") {
+    if (conditionalStack.empty()) {
+      error = Error{
+          ErrorID::UnmatchedConditionalDirective,
+          {offsetBeforeParsingDirectiveName, offsetAfterParsingDirectiveName},
+          {directiveName}};
+      goto fail;
+    }
+
+    auto& group = conditionalStack.back();
+    if (group.hasSeenElse) {
+      errOut.reportsError(Error{
+          ErrorID::DirectiveAfterElse,
+          {offsetBeforeParsingDirectiveName, offsetAfterParsingDirectiveName},
+          {directiveName}});
     }
+    if (directiveName == "else") group.hasSeenElse = true;
 
+    // The text before it has been output, so a branch of the group has been
+    // taken already.
+    skipAll(ppds);
+    skipConditionalGroup();
+    skipNewline(scanner);
+  } else if (directiveName == "endif") {
+    if (conditionalStack.empty()) {
+      error = Error{
+          ErrorID::UnmatchedConditionalDirective,
+          {offsetBeforeParsingDirectiveName, offsetAfterParsingDirectiveName},
+          {directiveName}};
+      goto fail;
+    }
+    conditionalStack.pop_back();
+    skipAll(ppds);
     skipNewline(scanner);
   } else {
     error = Error{
+        ErrorID::UnknownDirective,
         {offsetBeforeParsingDirectiveName, offsetAfterParsingDirectiveName},
-        "Unknown preprocessing directive " + directiveName,
-        ""};
+        {directiveName}};
     goto fail;
   }
 
@@ -1115,6 +1282,326 @@ fail:
   errOut.reportsError(error);
 }
 
+// Continue with the content of the file in a section of its own, the
+// scanner returns to the line after the directive when it's done with it.
+template <ByteDecoderConcept F>
+void PPImpl<F>::includeFile(const std::string& name, bool isAngled,
+                            CodeBuffer::Offset start, CodeBuffer::Offset end) {
+  std::size_t depth = 0;
+  for (const auto& item : scanner.sectionStack()) {
+    if (codeBuffer.isFileSection(item.sectionID)) depth++;
+  }
+  if (depth >= MAX_INCLUDE_DEPTH) {
+    errOut.reportsError(Error{ErrorID::IncludeNestedTooDeeply,
+                              {start, end},
+                              {std::to_string(MAX_INCLUDE_DEPTH)}});
+    return;
+  }
+
+  const auto file = includeFiles != nullptr
+                        ? includeFiles->find(name, isAngled, currentFile())
+                        : std::nullopt;
+  if (!file) {
+    errOut.reportsError(
+        Error{ErrorID::IncludedFileNotFound, {start, end}, {name}});
+    return;
+  }
+  // Everything in the file would be skipped, e.g. a header included again.
+  if (!file->includeGuard.empty() &&
+      setOfMacroDefinitions.find(std::string(file->includeGuard)) !=
+          setOfMacroDefinitions.end()) {
+    return;
+  }
+
+  // The directive after the file has to start a line of its own.
+  std::string content(file->content);
+  if (!content.empty() && content.back() != '\n') content.push_back('\n');
+  CodeBuffer::SectionOrigin origin{start, end};
+  origin.includedFile = file->path;
+  scanner.enterSection(
+      codeBuffer.addSection(std::move(content), std::move(origin)));
+  canParseDirectives = true;
+}
+
+// The path of the file the scanner is in, empty for the source file.
+template <ByteDecoderConcept F>
+const std::string& PPImpl<F>::currentFile() const {
+  const auto& sectionStack = scanner.sectionStack();
+  for (auto it = sectionStack.rbegin(); it != sectionStack.rend(); ++it) {
+    const auto& origin = codeBuffer.sectionOrigin(it->sectionID);
+    if (!origin.includedFile.empty()) return origin.includedFile;
+  }
+  return codeBuffer.sectionOrigin(0).includedFile;
+}
+
+template <ByteDecoderConcept F>
+void PPImpl<F>::enterConditionalGroup(CodeBuffer::Offset start,
+                                      CodeBuffer::Offset end, bool isTaken) {
+  conditionalStack.push_back({start, end, isTaken, false});
+  if (!isTaken) skipConditionalGroup();
+}
+
+// Skip the lines of the innermost group up to the #elif or #else that starts
+// a branch to take, or up to the #endif that ends the group. The scanner is
+// left at the end of that directive's line. Directives in the skipped lines
+// only matter for the nesting of the groups.
+template <ByteDecoderConcept F>
+void PPImpl<F>::skipConditionalGroup() {
+  int depth = 0;
+  for (;;) {
+    skipSpacesAndComments(scanner, isDirectiveSpace);
+    if (scanner.reachedEndOfInput()) return;
+    if (scanner.peek() != '#') {
+      skipRestOfLine();
+      continue;
+    }
+
+    PPDirectiveScanner<F> ppds{scanner};
+    ppds.get();  // ignore the leading #
+    skipSpaces(ppds, isDirectiveSpace);
+    const auto nameStart = ppds.offset();
+    const auto name = parseIdentifier(ppds);
+    const auto nameEnd = ppds.offset();
+
+    if (name == "if" || name == "ifdef" || name == "ifndef") {
+      depth++;
+    } else if (depth > 0) {
+      if (name == "endif") depth--;
+    } else if (name == "endif") {
+      conditionalStack.pop_back();
+      skipAll(ppds);
+      return;
+    } else if (name == "elif" || name == "else") {
+      auto& group = conditionalStack.back();
+      if (group.hasSeenElse) {
+        errOut.reportsError(
+            Error{ErrorID::DirectiveAfterElse, {nameStart, nameEnd}, {name}});
+      } else if (name == "else") {
+        group.hasSeenElse = true;
+        if (!group.hasTakenBranch) {
+          group.hasTakenBranch = true;
+          skipAll(ppds);
+          return;
+        }
+      } else if (!group.hasTakenBranch && evaluateCondition(ppds)) {
+        group.hasTakenBranch = true;
+        return;
+      }
+    }
+    skipAll(ppds);
+  }
+}
+
+// Skip a line that isn't a directive. Quotes are not matched, skipped text
+// often has apostrophes in it, but comments are, since a block comment can
+// hide a line that looks like a directive.
+template <ByteDecoderConcept F>
+void PPImpl<F>::skipRestOfLine() {
+  while (!scanner.reachedEndOfInput() && !isNewlineCharacter(scanner.peek())) {
+    // The line comment is skipped by skipSpacesAndComments.
+    if (lookaheadMatches(scanner, "//")) return;
+    if (lookaheadMatches(scanner, "/*")) {
+      scanner.get();
+      scanner.get();
+      while (!scanner.reachedEndOfInput() && !lookaheadMatches(scanner, "*/")) {
+        scanner.get();
+      }
+      scanner.get();
+      scanner.get();
+      continue;
+    }
+    scanner.get();
+  }
+}
+
+// Evaluate the rest of an #if or #elif line.
+template <ByteDecoderConcept F>
+bool PPImpl<F>::evaluateCondition(PPDirectiveScanner<F>& ppds) {
+  skipSpaces(ppds, isDirectiveSpace);
+  const auto startOffset = ppds.offset();
+  const auto text = readAll(ppds);
+  const std::tuple range{startOffset, ppds.offset()};
+
+  std::string expandedText;
+  std::vector<std::string> disabledMacros;
+  if (auto error =
+          expandConditionMacros(text, range, disabledMacros, expandedText)) {
+    errOut.reportsError(std::move(*error));
+    return false;
+  }
+
+  // The offsets of the expanded text mean nothing to the user, so the
+  // lexer's errors are moved to the line.
+  struct LineErrors : IReportError {
+    IReportError& errOut;
+    std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range;
+    LineErrors(IReportError& errOut,
+               std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range)
+        : errOut(errOut), range(range) {}
+    void reportsError(Error error) override {
+      errOut.reportsError(Error{range, error.message(), error.hint()});
+    }
+  } lineErrors(errOut, range);
+
+  StringScanner stringScanner(expandedText);
+  Lexer lexer(stringScanner, lineErrors);
+  std::vector<Token> tokens;
+  for (;;) {
+    auto token = lexer.next();
+    if (!token) return false;
+    if (std::holds_alternative<EndOfInput>(*token)) break;
+    tokens.push_back(std::move(*token));
+  }
+
+  const auto value = evaluatePreprocessorExpression(tokens, range, errOut);
+  return value && !value->isZero();
+}
+
+// Replace the "defined" operators of an #if line with 1 or 0, then expand
+// its macros. A macro is not expanded again inside its own expansion.
+template <ByteDecoderConcept F>
+std::optional<Error> PPImpl<F>::expandConditionMacros(
+    std::string_view text,
+    std::tuple<CodeBuffer::Offset, CodeBuffer::Offset> range,
+    std::vector<std::string>& disabledMacros, std::string& output) {
+  RawBufferScanner<F> rbs(text.data(), text.size(), scanner.byteDecoder());
+  const auto isDigit = [](int ch) { return ch >= '0' && ch <= '9'; };
+
+  while (!rbs.reachedEndOfInput()) {
+    const auto ch = rbs.peek();
+
+    // A number can have letters in it (0x1F, 10u), they aren't identifiers.
+    if (isDigit(ch)) {
+      while (isStartOfIdentifier(rbs.peek()) || isDigit(rbs.peek()) ||
+             rbs.peek() == '.') {
+        const auto digit = rbs.get();
+        output += digit;
+        if ((digit == 'e' || digit == 'E' || digit == 'p' || digit == 'P') &&
+            (rbs.peek() == '+' || rbs.peek() == '-')) {
+          output += rbs.get();
+        }
+      }
+      continue;
+    }
+
+    if (ch == '\'' || ch == '"') {
+      output += rbs.get();
+      while (!rbs.reachedEndOfInput() && rbs.peek() != ch) {
+        const auto c = rbs.get();
+        output += c;
+        if (c == '\\' && !rbs.reachedEndOfInput()) output += rbs.get();
+      }
+      if (!rbs.reachedEndOfInput()) output += rbs.get();
+      continue;
+    }
+
+    if (!isStartOfIdentifier(ch)) {
+      output += rbs.get();
+      continue;
+    }
+
+    const auto identifier = parseIdentifier(rbs);
+    if (identifier == "defined") {
+      skipSpaces(rbs);
+      const bool hasParenthesis = rbs.peek() == '(';
+      if (hasParenthesis) {
+        rbs.get();
+        skipSpaces(rbs);
+      }
+      if (!isStartOfIdentifier(rbs.peek())) {
+        return Error{ErrorID::MacroNameMustBeIdentifier, range};
+      }
+      const auto macroName = parseIdentifier(rbs);
+      if (hasParenthesis) {
+        skipSpaces(rbs);
+        if (rbs.peek() != ')') {
+          return Error{ErrorID::ExpectedRightParenthesis, range};
+        }
+        rbs.get();
+      }
+      output += setOfMacroDefinitions.contains(macroName) ? " 1 " : " 0 ";
+      continue;
+    }
+
+    const auto macroDef = setOfMacroDefinitions.find(identifier);
+    if (macroDef == setOfMacroDefinitions.end() ||
+        std::find(disabledMacros.begin(), disabledMacros.end(), identifier) !=
+            disabledMacros.end()) {
+      output += identifier;
+      continue;
+    }
+
+    std::string body = macroDef->body;
+    if (macroDef->type == MacroType::FUNCTION_LIKE_MACRO) {
+      skipSpaces(rbs);
+      if (rbs.peek() != '(') {
+        output += identifier;
+        output += ' ';
+        continue;
+      }
+      rbs.get();
+
+      std::vector<std::string> arguments(1);
+      int parenthesisLevel = 0;
+      for (;;) {
+        if (rbs.reachedEndOfInput()) {
+          return Error{ErrorID::UnterminatedMacroArgumentList,
+                       range,
+                       {identifier}};
+        }
+        const auto c = rbs.get();
+        if (parenthesisLevel == 0 && c == ')') break;
+        if (parenthesisLevel == 0 && c == ',') {
+          arguments.emplace_back();
+          continue;
+        }
+        if (c == '(') parenthesisLevel++;
+        if (c == ')') parenthesisLevel--;
+        arguments.back() += c;
+      }
+      if (macroDef->parameters.empty() && arguments.size() == 1 &&
+          std::all_of(arguments[0].begin(), arguments[0].end(), ::isSpace)) {
+        arguments.clear();
+      }
+      if (arguments.size() != macroDef->parameters.size()) {
+        return Error{ErrorID::MacroArgumentCountMismatch,
+                     range,
+                     {identifier, std::to_string(macroDef->parameters.size()),
+                      std::to_string(arguments.size())}};
+      }
+
+      // The arguments are expanded before they are substituted.
+      for (auto& argument : arguments) {
+        std::string expandedArgument;
+        if (auto error = expandConditionMacros(argument, range, disabledMacros,
+                                               expandedArgument)) {
+          return error;
+        }
+        argument = std::move(expandedArgument);
+      }
+      body = expandFunctionLikeMacro(*macroDef, arguments);
+    }
+
+    disabledMacros.push_back(identifier);
+    output += ' ';
+    auto error = expandConditionMacros(body, range, disabledMacros, output);
+    output += ' ';
+    disabledMacros.pop_back();
+    if (error) return error;
+  }
+
+  return std::nullopt;
+}
+
+template <ByteDecoderConcept F>
+void PPImpl<F>::reportUnterminatedConditionals() {
+  for (const auto& group : conditionalStack) {
+    errOut.reportsError(
+        Error{ErrorID::UnterminatedConditional, {group.start, group.end}});
+  }
+  conditionalStack.clear();
+}
+
 // paraList -> ( )
 // paraList | ( id restOfParameters )
 // restOfParameters -> ''
@@ -1142,16 +1629,16 @@ PPImpl<F>::parseFunctionLikeMacroParameters(const std::string& macroName,
   }
 
   if (scanner.reachedEndOfInput()) {
-    return Error{{scanner.offset(), scanner.offset() + 1},
-                 "Expected parameter name before end of line",
-                 ""};
+    return Error{ErrorID::ExpectedParameterName,
+                 {scanner.offset(), scanner.offset() + 1}};
   }
 
   if (!isStartOfIdentifier(scanner.peek())) {
     const auto startOffset = scanner.offset();
     scanner.get();
     const auto endOffset = scanner.offset();
-    return Error{{startOffset, endOffset}, "Expected ',' or ')' here.", ""};
+    return Error{ErrorID::ExpectedCommaOrRightParenthesis,
+                   {startOffset, endOffset}};
   }
 
   const auto identStartOffset = scanner.offset();
@@ -1160,42 +1647,40 @@ PPImpl<F>::parseFunctionLikeMacroParameters(const std::string& macroName,
 
   while (scanner.peek() != ')') {
     if (scanner.reachedEndOfInput()) {
-      return Error{{scanner.offset(), scanner.offset() + 1},
-                   "Expected ')' before end of line",
-                   ""};
+      return Error{ErrorID::ExpectedRightParenthesis,
+                   {scanner.offset(), scanner.offset() + 1}};
     }
 
     if (scanner.peek() != ',') {
       const auto startOffset = scanner.offset();
       scanner.get();
       const auto endOffset = scanner.offset();
-      return Error{{startOffset, endOffset}, "Expected ',' or ')' here.", ""};
+      return Error{ErrorID::ExpectedCommaOrRightParenthesis,
+                   {startOffset, endOffset}};
     }
 
     scanner.get();  // skip , (ignore error conditions for now)
     skipSpacesAndComments(scanner);
 
     if (scanner.reachedEndOfInput()) {
-      return Error{{scanner.offset(), scanner.offset() + 1},
-                   "Expected parameter name before end of line",
-                   ""};
+      return Error{ErrorID::ExpectedParameterName,
+                   {scanner.offset(), scanner.offset() + 1}};
     }
 
     if (!isStartOfIdentifier(scanner.peek())) {
       const auto startOffset = scanner.offset();
       scanner.get();
       const auto endOffset = scanner.offset();
-      return Error{{startOffset, endOffset}, "Expected ',' or ')' here.", ""};
+      return Error{ErrorID::ExpectedCommaOrRightParenthesis,
+                   {startOffset, endOffset}};
     }
 
     const auto parameter = parseIdentifier(scanner);
     if (parameterHasDefined(parameter)) {
       const auto identEndOffset = scanner.offset();
-      return Error{
-          {identStartOffset, identEndOffset},
-          std::format(
-              "Duplicated parameter \"{}\" in the function-like macro \"{}\".",
-              parameter, macroName)};
+      return Error{ErrorID::DuplicatedMacroParameter,
+                   {identStartOffset, identEndOffset},
+                   {parameter, macroName}};
     }
     parameters.push_back(parameter);
   }
@@ -1209,7 +1694,9 @@ bool PPImpl<F>::isMacroPaintedBlue(const std::string& macroName) const {
   const auto& sectionStack = scanner.sectionStack();
   for (const auto& stackItem : sectionStack) {
     const auto it = mapOfSectionIDToMacroName.find(stackItem.sectionID);
-    if (it->second == macroName) return true;
+    if (it != mapOfSectionIDToMacroName.end() && it->second == macroName) {
+      return true;
+    }
   }
   return false;
 }
@@ -0,0 +1,875 @@
+#include "register-allocation.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include "dominator-tree.h"
+
+namespace {
+constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+
+// Free registers are taken in this order, caller-saved ones first, so
+// callee-saved ones are only used, and saved, by values that live across
+// calls. X86::SCRATCH, X86::TEMPORARY, RSP and RBP aren't allocated.
+constexpr std::array<X86::Register, 12> ALLOCATION_ORDER{
+    X86::RAX, X86::RCX, X86::RDX, X86::RSI, X86::RDI, X86::R8,
+    X86::R9,  X86::RBX, X86::R12, X86::R13, X86::R14, X86::R15};
+constexpr std::array<X86::Register, 7> CALLER_SAVED{
+    X86::RAX, X86::RCX, X86::RDX, X86::RSI, X86::RDI, X86::R8, X86::R9};
+constexpr std::array<X86::Register, 2> DIVISION_REGISTERS{X86::RAX,
+                                                          X86::RDX};
+constexpr std::array<X86::Register, 1> SHIFT_REGISTERS{X86::RCX};
+
+struct Range {
+  std::uint32_t from;
+  std::uint32_t to;
+};
+
+struct UsePosition {
+  std::uint32_t position;
+  bool requiresRegister;
+};
+
+// The positions where a value is live, or a part of them after the
+// interval is split. The parts are linked through next in order.
+struct Interval {
+  ValueID value = 0;
+  // Sorted, disjoint and not adjacent.
+  std::vector<Range> ranges;
+  std::vector<UsePosition> uses;
+  // The position this part holds the value from, its first range can start
+  // later if it was split in a hole.
+  std::uint32_t start = 0;
+  Location location;
+  std::uint32_t next = 0;
+  // The register the value should be in, -1 if there is none.
+  std::int8_t hint = -1;
+
+  std::uint32_t from() const { return ranges.front().from; }
+  std::uint32_t to() const { return ranges.back().to; }
+
+  bool covers(std::uint32_t position) const {
+    const auto it = firstRangeEndingAfter(position);
+    return it != ranges.end() && it->from <= position;
+  }
+
+  std::vector<Range>::const_iterator firstRangeEndingAfter(
+      std::uint32_t position) const {
+    return std::upper_bound(
+        ranges.begin(), ranges.end(), position,
+        [](std::uint32_t position, const Range& range) {
+          return position < range.to;
+        });
+  }
+
+  // The first use from a position on, NONE if there is none.
+  std::uint32_t nextUse(std::uint32_t position, bool requiresRegister) const {
+    for (const auto& use : uses) {
+      if (use.position < position) continue;
+      if (!requiresRegister || use.requiresRegister) return use.position;
+    }
+    return NONE;
+  }
+};
+
+// The first position both intervals cover, NONE if there is none.
+std::uint32_t intersection(const Interval& a, const Interval& b) {
+  if (a.ranges.empty() || b.ranges.empty()) return NONE;
+  auto i = a.ranges.begin();
+  auto j = b.firstRangeEndingAfter(a.from());
+  while (i != a.ranges.end() && j != b.ranges.end()) {
+    const auto from = std::max(i->from, j->from);
+    if (from < std::min(i->to, j->to)) return from;
+    if (i->to < j->to) {
+      ++i;
+    } else {
+      ++j;
+    }
+  }
+  return NONE;
+}
+
+bool isAllocated(const Inst& inst) {
+  switch (inst.op) {
+    case Opcode::Nop:
+    case Opcode::Const:
+    case Opcode::Symbol:
+    case Opcode::Alloca:
+      return false;
+    default:
+      return inst.type != IRType::Void;
+  }
+}
+
+// The registers an instruction overwrites besides its result.
+std::span<const X86::Register> clobbers(const Function& function,
+                                        ValueID id) {
+  switch (function[id].op) {
+    case Opcode::Call:
+      return CALLER_SAVED;
+    case Opcode::SDiv:
+    case Opcode::UDiv:
+    case Opcode::SRem:
+    case Opcode::URem:
+      return DIVISION_REGISTERS;
+    case Opcode::Shl:
+    case Opcode::LShr:
+    case Opcode::AShr:
+      if (function[function.operands(id)[1]].op != Opcode::Const) {
+        return SHIFT_REGISTERS;
+      }
+      return {};
+    default:
+      return {};
+  }
+}
+
+// Calls and returns take their operands from wherever they are, everything
+// else from registers.
+bool requiresRegister(Opcode op) {
+  return op != Opcode::Call && op != Opcode::Ret;
+}
+
+class BitSet {
+  std::vector<std::uint64_t> words;
+
+ public:
+  explicit BitSet(std::size_t size = 0) : words((size + 63) / 64) {}
+
+  void insert(std::uint32_t bit) { words[bit / 64] |= 1ull << (bit % 64); }
+  void erase(std::uint32_t bit) { words[bit / 64] &= ~(1ull << (bit % 64)); }
+  bool contains(std::uint32_t bit) const {
+    return words[bit / 64] >> (bit % 64) & 1;
+  }
+
+  // this = this | other, returns whether it changed.
+  bool unite(const BitSet& other) {
+    bool changed = false;
+    for (std::size_t i = 0; i < words.size(); i++) {
+      const auto word = words[i] | other.words[i];
+      changed |= word != words[i];
+      words[i] = word;
+    }
+    return changed;
+  }
+  // this = this & ~other
+  void subtract(const BitSet& other) {
+    for (std::size_t i = 0; i < words.size(); i++) words[i] &= ~other.words[i];
+  }
+
+  template <typename Visit>
+  void forEach(Visit&& visit) const {
+    for (std::size_t i = 0; i < words.size(); i++) {
+      for (auto word = words[i]; word != 0; word &= word - 1) {
+        visit(static_cast<std::uint32_t>(i * 64 + std::countr_zero(word)));
+      }
+    }
+  }
+};
+}  // namespace
+
+bool lateResultRegister(const Inst& inst, X86::Register* reg) {
+  switch (inst.op) {
+    case Opcode::Call:
+    case Opcode::SDiv:
+    case Opcode::UDiv:
+      *reg = X86::RAX;
+      return true;
+    case Opcode::SRem:
+    case Opcode::URem:
+      *reg = X86::RDX;
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::vector<Move> sequentialize(std::vector<Move> moves) {
+  std::erase_if(moves, [](const Move& move) {
+    return move.from.kind != Location::Kind::None && move.from == move.to;
+  });
+
+  std::vector<Move> ordered;
+  while (!moves.empty()) {
+    // A move is ready once no other one reads its destination.
+    const auto ready = std::find_if(
+        moves.begin(), moves.end(), [&](const Move& move) {
+          return std::none_of(moves.begin(), moves.end(),
+                              [&](const Move& other) {
+                                return &other != &move && other.from == move.to;
+                              });
+        });
+    if (ready != moves.end()) {
+      ordered.push_back(*ready);
+      moves.erase(ready);
+      continue;
+    }
+    // Only cycles are left. Save the source of one move, the move writing
+    // it becomes ready.
+    const auto saved = moves.front().from;
+    const auto scratch = Location::inRegister(X86::SCRATCH);
+    ordered.push_back({moves.front().value, saved, scratch});
+    for (auto& move : moves) {
+      if (move.from == saved) move.from = scratch;
+    }
+  }
+  return ordered;
+}
+
+class RegisterAllocation::LinearScan {
+  Function& function;
+  RegisterAllocation& result;
+  const UseLists uses;
+
+  std::vector<std::uint32_t> blockEnds;
+  std::vector<bool> isBlockStart;
+
+  // The allocated values are numbered densely for the bit sets.
+  std::vector<std::uint32_t> bitOf;
+  std::vector<ValueID> values;
+  std::vector<BitSet> liveIns;
+  std::vector<BitSet> liveOuts;
+
+  std::vector<Interval> intervals;
+  std::vector<std::uint32_t> firstIntervals;
+  std::array<Interval, X86::NUMBER_OF_REGISTERS> fixed;
+  std::vector<std::uint32_t> valueEnds;
+  std::vector<std::uint32_t> valueSlots;
+  std::vector<std::uint32_t> slotsFreeFrom;
+
+  using Entry = std::pair<std::uint32_t, std::uint32_t>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<>> unhandled;
+  std::vector<std::uint32_t> active;
+  std::vector<std::uint32_t> inactive;
+
+ public:
+  LinearScan(Function& function, RegisterAllocation& result)
+      : function(function),
+        result(result),
+        uses(function),
+        blockEnds(function.numberOfBlocks()),
+        bitOf(function.size(), NONE),
+        intervals(1),
+        firstIntervals(function.size()),
+        valueEnds(function.size()),
+        valueSlots(function.size()) {
+    intervals.reserve(function.size() + 1);
+  }
+
+  void run();
+
+ private:
+  void number();
+  void computeLiveness();
+  void buildIntervals();
+  void addRange(ValueID value, std::uint32_t from, std::uint32_t to);
+  void define(ValueID value, std::uint32_t position);
+
+  void allocate();
+  bool tryAllocateFreeRegister(std::uint32_t index);
+  void allocateBlockedRegister(std::uint32_t index);
+  void spillFrom(std::uint32_t index, std::uint32_t position);
+  void assignStack(std::uint32_t index);
+  std::uint32_t split(std::uint32_t index, std::uint32_t position);
+  std::uint32_t splitPosition(std::uint32_t position) const;
+  int hintFor(std::uint32_t index) const;
+  Location allocatedLocation(ValueID value, std::uint32_t position) const;
+
+  void recordLocations();
+  void resolve();
+};
+
+void RegisterAllocation::LinearScan::run() {
+  number();
+  computeLiveness();
+  buildIntervals();
+  allocate();
+  recordLocations();
+  resolve();
+}
+
+void RegisterAllocation::LinearScan::number() {
+  const DominatorTree tree(function);
+  result.order.assign(tree.reversePostorder().begin(),
+                      tree.reversePostorder().end());
+  result.blockStarts.assign(function.numberOfBlocks(), 0);
+  result.positions.assign(function.size(), 0);
+  result.entryMoveLists.resize(function.numberOfBlocks());
+  result.exitMoveLists.resize(function.numberOfBlocks());
+
+  const auto addValue = [&](ValueID id) {
+    bitOf[id] = static_cast<std::uint32_t>(values.size());
+    values.push_back(id);
+    firstIntervals[id] = static_cast<std::uint32_t>(intervals.size());
+    intervals.emplace_back().value = id;
+  };
+  for (const auto param : function.parameters()) addValue(param);
+
+  std::uint32_t position = 0;
+  for (const auto id : result.order) {
+    const auto& block = function.block(id);
+    result.blockStarts[id] = position;
+    for (const auto phi : block.phis) {
+      if (function[phi].op == Opcode::Nop) continue;
+      result.positions[phi] = position;
+      addValue(phi);
+    }
+    position += 2;
+    for (const auto inst : block.insts) {
+      if (function[inst].op == Opcode::Nop) continue;
+      result.positions[inst] = position;
+      position += 2;
+      result.stats.instructions++;
+      if (isAllocated(function[inst])) addValue(inst);
+    }
+    blockEnds[id] = position;
+  }
+
+  isBlockStart.assign(position + 1, false);
+  for (const auto id : result.order) isBlockStart[result.blockStarts[id]] = true;
+}
+
+void RegisterAllocation::LinearScan::computeLiveness() {
+  const auto& order = result.order;
+  std::vector<BitSet> generated(function.numberOfBlocks());
+  std::vector<BitSet> killed(function.numberOfBlocks());
+  std::vector<BitSet> phiUses(function.numberOfBlocks());
+  liveIns.assign(function.numberOfBlocks(), BitSet());
+  liveOuts.assign(function.numberOfBlocks(), BitSet());
+
+  for (const auto id : order) {
+    const auto& block = function.block(id);
+    auto& gen = generated[id] = BitSet(values.size());
+    auto& kill = killed[id] = BitSet(values.size());
+    phiUses[id] = BitSet(values.size());
+    liveIns[id] = BitSet(values.size());
+    liveOuts[id] = BitSet(values.size());
+    if (id == Function::ENTRY) {
+      for (const auto param : function.parameters()) kill.insert(bitOf[param]);
+    }
+    for (const auto phi : block.phis) {
+      if (bitOf[phi] != NONE) kill.insert(bitOf[phi]);
+    }
+    for (const auto inst : block.insts) {
+      if (function[inst].op == Opcode::Nop) continue;
+      for (const auto operand : function.operands(inst)) {
+        const auto bit = bitOf[operand];
+        if (bit != NONE && !kill.contains(bit)) gen.insert(bit);
+      }
+      if (bitOf[inst] != NONE) kill.insert(bitOf[inst]);
+    }
+    for (const auto successor : block.successors()) {
+      const auto& predecessors = function.block(successor).predecessors;
+      const auto index = static_cast<std::size_t>(
+          std::find(predecessors.begin(), predecessors.end(), id) -
+          predecessors.begin());
+      for (const auto phi : function.block(successor).phis) {
+        if (function[phi].op == Opcode::Nop) continue;
+        const auto bit = bitOf[function.operands(phi)[index]];
+        if (bit != NONE) phiUses[id].insert(bit);
+      }
+    }
+  }
+
+  // Backwards in postorder, so a block mostly comes after its successors.
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      auto out = phiUses[*it];
+      for (const auto successor : function.block(*it).successors()) {
+        out.unite(liveIns[successor]);
+      }
+      out.subtract(killed[*it]);
+      out.unite(generated[*it]);
+      changed |= liveIns[*it].unite(out);
+    }
+  }
+  for (const auto id : order) {
+    liveOuts[id].unite(phiUses[id]);
+    for (const auto successor : function.block(id).successors()) {
+      liveOuts[id].unite(liveIns[successor]);
+    }
+  }
+}
+
+// Ranges are added backwards, the first range of an interval is its last
+// one until all are built.
+void RegisterAllocation::LinearScan::addRange(ValueID value,
+                                              std::uint32_t from,
+                                              std::uint32_t to) {
+  auto& ranges = intervals[firstIntervals[value]].ranges;
+  if (ranges.empty() || to < ranges.back().from) {
+    ranges.push_back({from, to});
+    return;
+  }
+  ranges.back().from = std::min(ranges.back().from, from);
+  ranges.back().to = std::max(ranges.back().to, to);
+}
+
+void RegisterAllocation::LinearScan::define(ValueID value,
+                                            std::uint32_t position) {
+  auto& ranges = intervals[firstIntervals[value]].ranges;
+  // A result nothing uses still has to be written somewhere.
+  if (ranges.empty()) {
+    ranges.push_back({position, position + 1});
+  } else {
+    ranges.back().from = position;
+  }
+}
+
+void RegisterAllocation::LinearScan::buildIntervals() {
+  for (auto it = result.order.rbegin(); it != result.order.rend(); ++it) {
+    const auto id = *it;
+    const auto& block = function.block(id);
+    const auto from = result.blockStarts[id];
+    liveOuts[id].forEach(
+        [&](std::uint32_t bit) { addRange(values[bit], from, blockEnds[id]); });
+
+    for (auto inst = block.insts.rbegin(); inst != block.insts.rend();
+         ++inst) {
+      const auto& value = function[*inst];
+      if (value.op == Opcode::Nop) continue;
+      const auto position = result.positions[*inst];
+      for (const auto reg : clobbers(function, *inst)) {
+        fixed[reg].ranges.push_back({position, position + 1});
+      }
+      X86::Register late;
+      const bool isLate = lateResultRegister(value, &late);
+      if (firstIntervals[*inst] != 0) {
+        define(*inst, isLate ? position + 1 : position);
+        if (isLate) intervals[firstIntervals[*inst]].hint = late;
+      }
+
+      const auto operands = function.operands(*inst);
+      for (std::size_t i = 0; i < operands.size(); i++) {
+        const auto interval = firstIntervals[operands[i]];
+        if (interval == 0) continue;
+        addRange(operands[i], from, position);
+        intervals[interval].uses.push_back(
+            {position, requiresRegister(value.op)});
+        auto& hint = intervals[interval].hint;
+        if (value.op == Opcode::Ret) {
+          hint = X86::RAX;
+        } else if (value.op == Opcode::Call && i >= 1 &&
+                   i - 1 < X86::ARGUMENT_REGISTERS.size() && hint < 0) {
+          hint = X86::ARGUMENT_REGISTERS[i - 1];
+        }
+      }
+    }
+    for (const auto phi : block.phis) {
+      if (function[phi].op != Opcode::Nop) define(phi, from);
+    }
+  }
+
+  const auto params = function.parameters();
+  for (std::size_t i = 0; i < params.size(); i++) {
+    define(params[i], 0);
+    if (i < X86::ARGUMENT_REGISTERS.size()) {
+      intervals[firstIntervals[params[i]]].hint = X86::ARGUMENT_REGISTERS[i];
+    }
+  }
+
+  for (auto& interval : intervals) {
+    std::reverse(interval.ranges.begin(), interval.ranges.end());
+    std::reverse(interval.uses.begin(), interval.uses.end());
+    if (interval.ranges.empty()) continue;
+    interval.start = interval.from();
+    valueEnds[interval.value] = interval.to();
+  }
+  for (auto& interval : fixed) {
+    std::reverse(interval.ranges.begin(), interval.ranges.end());
+  }
+  result.stats.intervals = values.size();
+}
+
+void RegisterAllocation::LinearScan::allocate() {
+  for (std::uint32_t i = 1; i < intervals.size(); i++) {
+    if (!intervals[i].ranges.empty()) unhandled.push({intervals[i].from(), i});
+  }
+
+  while (!unhandled.empty()) {
+    const auto [position, index] = unhandled.top();
+    unhandled.pop();
+
+    // Intervals that ended are dropped, the others move between active and
+    // inactive as they enter and leave holes.
+    active.insert(active.end(), inactive.begin(), inactive.end());
+    inactive.clear();
+    std::erase_if(active, [&](std::uint32_t i) {
+      const auto& interval = intervals[i];
+      if (interval.to() <= position) return true;
+      if (interval.covers(position)) return false;
+      inactive.push_back(i);
+      return true;
+    });
+
+    if (!tryAllocateFreeRegister(index)) allocateBlockedRegister(index);
+    if (intervals[index].location.kind == Location::Kind::Register) {
+      active.push_back(index);
+    }
+  }
+}
+
+bool RegisterAllocation::LinearScan::tryAllocateFreeRegister(
+    std::uint32_t index) {
+  std::array<std::uint32_t, X86::NUMBER_OF_REGISTERS> freeUntil{};
+  for (const auto reg : ALLOCATION_ORDER) freeUntil[reg] = NONE;
+  const auto& current = intervals[index];
+  for (const auto i : active) freeUntil[intervals[i].location.reg] = 0;
+  for (const auto i : inactive) {
+    auto& until = freeUntil[intervals[i].location.reg];
+    until = std::min(until, intersection(intervals[i], current));
+  }
+  for (const auto reg : ALLOCATION_ORDER) {
+    freeUntil[reg] = std::min(freeUntil[reg], intersection(fixed[reg], current));
+  }
+
+  auto reg = ALLOCATION_ORDER[0];
+  for (const auto candidate : ALLOCATION_ORDER) {
+    if (freeUntil[candidate] > freeUntil[reg]) reg = candidate;
+  }
+  const auto hint = hintFor(index);
+  if (hint >= 0 && freeUntil[hint] >= current.to()) {
+    reg = static_cast<X86::Register>(hint);
+  }
+
+  const auto until = freeUntil[reg];
+  if (until <= current.from()) return false;
+  if (until < current.to()) {
+    const auto position = splitPosition(until);
+    if (position <= current.from()) return false;
+    const auto child = split(index, position);
+    unhandled.push({intervals[child].from(), child});
+  }
+  intervals[index].location = Location::inRegister(reg);
+  return true;
+}
+
+void RegisterAllocation::LinearScan::allocateBlockedRegister(
+    std::uint32_t index) {
+  const auto from = intervals[index].from();
+  const auto firstUse = intervals[index].nextUse(from, true);
+  if (firstUse == NONE) {
+    assignStack(index);
+    return;
+  }
+
+  std::array<std::uint32_t, X86::NUMBER_OF_REGISTERS> nextUse{};
+  std::array<std::uint32_t, X86::NUMBER_OF_REGISTERS> blockedFrom{};
+  for (const auto reg : ALLOCATION_ORDER) nextUse[reg] = blockedFrom[reg] = NONE;
+  for (const auto i : active) {
+    auto& use = nextUse[intervals[i].location.reg];
+    use = std::min(use, intervals[i].nextUse(from, true));
+  }
+  for (const auto i : inactive) {
+    if (intersection(intervals[i], intervals[index]) == NONE) continue;
+    auto& use = nextUse[intervals[i].location.reg];
+    use = std::min(use, intervals[i].nextUse(from, true));
+  }
+  for (const auto reg : ALLOCATION_ORDER) {
+    blockedFrom[reg] = intersection(fixed[reg], intervals[index]);
+    nextUse[reg] = std::min(nextUse[reg], blockedFrom[reg]);
+    // A register overwritten before the first use is no use.
+    if (blockedFrom[reg] <= firstUse) nextUse[reg] = 0;
+  }
+
+  auto reg = ALLOCATION_ORDER[0];
+  for (const auto candidate : ALLOCATION_ORDER) {
+    if (nextUse[candidate] > nextUse[reg]) reg = candidate;
+  }
+
+  if (nextUse[reg] <= firstUse) {
+    // Every register is needed before this interval needs one, spill it
+    // until then.
+    const auto position = splitPosition(firstUse);
+    if (position > from) {
+      const auto child = split(index, position);
+      unhandled.push({intervals[child].from(), child});
+    }
+    assignStack(index);
+    return;
+  }
+
+  intervals[index].location = Location::inRegister(reg);
+  if (blockedFrom[reg] < intervals[index].to()) {
+    const auto child = split(index, splitPosition(blockedFrom[reg]));
+    unhandled.push({intervals[child].from(), child});
+  }
+
+  // Evict the intervals holding the register where they overlap this one.
+  const auto evictAt = splitPosition(from);
+  for (auto it = active.begin(); it != active.end();) {
+    if (intervals[*it].location.reg != reg) {
+      ++it;
+      continue;
+    }
+    const auto evicted = *it;
+    it = active.erase(it);
+    spillFrom(evicted, evictAt);
+  }
+  for (auto it = inactive.begin(); it != inactive.end();) {
+    const auto evicted = *it;
+    if (intervals[evicted].location.reg != reg ||
+        intersection(intervals[evicted], intervals[index]) == NONE) {
+      ++it;
+      continue;
+    }
+    it = inactive.erase(it);
+    // It is in a hole, which ends at the start of its next range.
+    spillFrom(evicted, intervals[evicted].firstRangeEndingAfter(from)->from);
+  }
+}
+
+// Move the part of an interval from a position on to a spill slot, until
+// shortly before it needs a register again.
+void RegisterAllocation::LinearScan::spillFrom(std::uint32_t index,
+                                               std::uint32_t position) {
+  const auto spilled =
+      position > intervals[index].from() ? split(index, position) : index;
+  assignStack(spilled);
+  const auto use = intervals[spilled].nextUse(position, true);
+  if (use == NONE) return;
+  const auto reload = splitPosition(use);
+  if (reload > intervals[spilled].from()) {
+    const auto child = split(spilled, reload);
+    unhandled.push({intervals[child].from(), child});
+  } else {
+    // It needs a register right away, so it has to compete for one again.
+    intervals[spilled].location = {};
+    unhandled.push({intervals[spilled].from(), spilled});
+  }
+}
+
+void RegisterAllocation::LinearScan::assignStack(std::uint32_t index) {
+  auto& interval = intervals[index];
+  auto& slot = valueSlots[interval.value];
+  if (slot == 0) {
+    // A slot is free again once the value it was given to is dead.
+    std::uint32_t free = 0;
+    while (free < slotsFreeFrom.size() &&
+           slotsFreeFrom[free] > interval.start) {
+      free++;
+    }
+    if (free == slotsFreeFrom.size()) slotsFreeFrom.push_back(0);
+    slotsFreeFrom[free] = valueEnds[interval.value];
+    slot = free + 1;
+  }
+  interval.location = Location::onStack(slot - 1);
+  result.stats.spilledIntervals++;
+}
+
+// Split an interval into the part before a position and the part from it
+// on, which is returned.
+std::uint32_t RegisterAllocation::LinearScan::split(std::uint32_t index,
+                                                    std::uint32_t position) {
+  Interval child;
+  auto& interval = intervals[index];
+  child.value = interval.value;
+  child.start = position;
+
+  auto range = std::find_if(interval.ranges.begin(), interval.ranges.end(),
+                            [&](const Range& range) {
+                              return range.to > position;
+                            });
+  if (range != interval.ranges.end() && range->from < position) {
+    child.ranges.push_back({position, range->to});
+    range->to = position;
+    ++range;
+  }
+  child.ranges.insert(child.ranges.end(), range, interval.ranges.end());
+  interval.ranges.erase(range, interval.ranges.end());
+
+  const auto use = std::find_if(
+      interval.uses.begin(), interval.uses.end(),
+      [&](const UsePosition& use) { return use.position >= position; });
+  child.uses.assign(use, interval.uses.end());
+  interval.uses.erase(use, interval.uses.end());
+
+  child.next = interval.next;
+  const auto childIndex = static_cast<std::uint32_t>(intervals.size());
+  interval.next = childIndex;
+  intervals.push_back(std::move(child));
+  result.stats.splits++;
+  return childIndex;
+}
+
+// Where to split before a position: between two instructions, or at the
+// start of a block, where the moves are on the edges.
+std::uint32_t RegisterAllocation::LinearScan::splitPosition(
+    std::uint32_t position) const {
+  if (position < isBlockStart.size() && isBlockStart[position]) {
+    return position;
+  }
+  return position % 2 == 0 ? position - 1 : position;
+}
+
+// A register that saves a move: the fixed one for the value, the one of
+// the part before a split, of a phi using the value or of the first operand
+// of the instruction.
+int RegisterAllocation::LinearScan::hintFor(std::uint32_t index) const {
+  const auto& interval = intervals[index];
+  if (interval.hint >= 0) return interval.hint;
+
+  const auto value = interval.value;
+  auto previous = firstIntervals[value];
+  if (previous != index) {
+    while (intervals[previous].next != index) previous = intervals[previous].next;
+    const auto& location = intervals[previous].location;
+    return location.kind == Location::Kind::Register ? location.reg : -1;
+  }
+
+  for (const auto& use : uses.of(value)) {
+    if (function[use.user].op != Opcode::Phi) continue;
+    const auto& location = intervals[firstIntervals[use.user]].location;
+    if (location.kind == Location::Kind::Register) return location.reg;
+  }
+  const auto operands = function.operands(value);
+  if (function[value].op != Opcode::Param && !operands.empty() &&
+      firstIntervals[operands[0]] != 0) {
+    const auto location =
+        allocatedLocation(operands[0], result.positions[value]);
+    if (location.kind == Location::Kind::Register) return location.reg;
+  }
+  return -1;
+}
+
+Location RegisterAllocation::LinearScan::allocatedLocation(
+    ValueID value, std::uint32_t position) const {
+  Location location;
+  for (auto i = firstIntervals[value]; i != 0 && intervals[i].start <= position;
+       i = intervals[i].next) {
+    location = intervals[i].location;
+  }
+  return location;
+}
+
+void RegisterAllocation::LinearScan::recordLocations() {
+  result.locationStarts.assign(function.size() + 1, 0);
+  std::array<bool, X86::NUMBER_OF_REGISTERS> isUsed{};
+  for (ValueID value = 0; value < function.size(); value++) {
+    result.locationStarts[value] =
+        static_cast<std::uint32_t>(result.locationList.size());
+    for (auto i = firstIntervals[value]; i != 0; i = intervals[i].next) {
+      const auto& interval = intervals[i];
+      if (interval.ranges.empty()) continue;
+      result.locationList.push_back({interval.start, interval.location});
+      if (interval.location.kind == Location::Kind::Register) {
+        isUsed[interval.location.reg] = true;
+      }
+    }
+  }
+  result.locationStarts.back() =
+      static_cast<std::uint32_t>(result.locationList.size());
+
+  for (const auto reg : ALLOCATION_ORDER) {
+    if (isUsed[reg] && X86::isCalleeSaved(reg)) result.calleeSaved.push_back(reg);
+  }
+  result.spillSlots = static_cast<std::uint32_t>(slotsFreeFrom.size());
+}
+
+void RegisterAllocation::LinearScan::resolve() {
+  // Where a value was split inside a block.
+  std::vector<std::pair<std::uint32_t, Move>> moves;
+  for (const auto value : values) {
+    for (auto i = firstIntervals[value]; intervals[i].next != 0;
+         i = intervals[i].next) {
+      const auto& before = intervals[i];
+      const auto& after = intervals[intervals[i].next];
+      if (before.location == after.location || isBlockStart[after.start] ||
+          after.from() != after.start) {
+        continue;
+      }
+      moves.push_back({after.start, {value, before.location, after.location}});
+    }
+  }
+  std::stable_sort(
+      moves.begin(), moves.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (const auto& [position, move] : moves) {
+    result.movePositions.push_back(position);
+    result.moveList.push_back(move);
+  }
+  result.stats.moves = moves.size();
+
+  // Values live across an edge whose location differs, and phis.
+  for (const auto id : result.order) {
+    const auto& block = function.block(id);
+    const auto end = blockEnds[id] - 2;
+    for (const auto successor : block.successors()) {
+      auto& moves = block.numberOfSuccessors == 1
+                        ? result.exitMoveLists[id]
+                        : result.entryMoveLists[successor];
+      const auto start = result.blockStarts[successor];
+      liveIns[successor].forEach([&](std::uint32_t bit) {
+        const auto value = values[bit];
+        const auto from = result.locationAt(value, end);
+        const auto to = result.locationAt(value, start);
+        if (from != to) moves.push_back({value, from, to});
+      });
+
+      const auto& predecessors = function.block(successor).predecessors;
+      const auto index = static_cast<std::size_t>(
+          std::find(predecessors.begin(), predecessors.end(), id) -
+          predecessors.begin());
+      for (const auto phi : function.block(successor).phis) {
+        if (function[phi].op == Opcode::Nop) continue;
+        const auto operand = function.operands(phi)[index];
+        const auto from = result.locationAt(operand, end);
+        const auto to = result.locationAt(phi, start);
+        if (from.kind == Location::Kind::None || from != to) {
+          moves.push_back({operand, from, to});
+        }
+      }
+      result.stats.moves += moves.size();
+    }
+  }
+}
+
+RegisterAllocation::RegisterAllocation(Function& function) {
+  // Every edge needs a place for its moves: an edge from a block with two
+  // successors into one with several predecessors gets a block of its own.
+  for (const auto id : function.liveBlocks()) {
+    const auto& block = function.block(id);
+    if (block.numberOfSuccessors < 2) continue;
+    const auto successors = block.successorArray;
+    for (std::uint8_t i = 0; i < 2; i++) {
+      if (function.block(successors[i]).predecessors.size() > 1) {
+        function.splitEdge(id, successors[i]);
+      }
+    }
+  }
+  LinearScan(function, *this).run();
+}
+
+Location RegisterAllocation::locationAt(ValueID value,
+                                        std::uint32_t position) const {
+  if (value + 1 >= locationStarts.size()) return {};
+  const auto begin = locationList.begin() + locationStarts[value];
+  const auto end = locationList.begin() + locationStarts[value + 1];
+  if (begin == end) return {};
+  auto it = std::upper_bound(
+      begin, end, position,
+      [](std::uint32_t position, const auto& entry) {
+        return position < entry.first;
+      });
+  return it == begin ? begin->second : std::prev(it)->second;
+}
+
+Location RegisterAllocation::resultLocation(const Function& function,
+                                            ValueID id) const {
+  X86::Register reg;
+  const bool isLate = lateResultRegister(function[id], &reg);
+  return locationAt(id, positions[id] + (isLate ? 1 : 0));
+}
+
+std::span<const Move> RegisterAllocation::movesAt(
+    std::uint32_t position) const {
+  const auto [first, last] =
+      std::equal_range(movePositions.begin(), movePositions.end(), position);
+  return {moveList.data() + (first - movePositions.begin()),
+          static_cast<std::size_t>(last - first)};
+}
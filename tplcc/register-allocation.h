@@ -0,0 +1,145 @@
+#ifndef TPLCC_REGISTER_ALLOCATION_H
+#define TPLCC_REGISTER_ALLOCATION_H
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "ir.h"
+#include "x86-64.h"
+
+// Where a value is at some point of a function: in a register or in a spill
+// slot, 8 bytes in the stack frame. Constants, symbol addresses and allocas
+// have no location, the code generators compute them where they are used.
+struct Location {
+  enum class Kind : std::uint8_t { None, Register, Stack };
+
+  Kind kind = Kind::None;
+  X86::Register reg = X86::RAX;
+  std::uint32_t slot = 0;
+
+  static Location inRegister(X86::Register reg) {
+    return {Kind::Register, reg, 0};
+  }
+  static Location onStack(std::uint32_t slot) {
+    return {Kind::Stack, X86::RAX, slot};
+  }
+
+  bool operator==(const Location&) const = default;
+};
+
+// Copy a value from one location to another, all 8 bytes of it. A value
+// without a location is computed into the destination.
+struct Move {
+  ValueID value = 0;
+  Location from;
+  Location to;
+};
+
+// Calls and divisions overwrite registers and leave their result in a fixed
+// one, so their result is defined one position after them and moved to its
+// location with the moves there. Returns whether the instruction is one of
+// them.
+bool lateResultRegister(const Inst& inst, X86::Register* reg);
+
+// Order the moves that happen at the same time so none overwrites a
+// location another one still has to read. Cycles, which can only be of
+// registers, are broken through X86::SCRATCH. Moves to where the value
+// already is are dropped.
+std::vector<Move> sequentialize(std::vector<Move> moves);
+
+// Linear scan register allocation on SSA form (Wimmer and Franz, "Linear
+// Scan Register Allocation on SSA Form", CGO 2010) for x86-64 and the
+// System V calling convention. Chosen over graph colouring because it
+// allocates in one pass over the lifetime intervals:
+//
+// - The blocks reachable from the entry are laid out in reverse postorder
+//   and their instructions numbered 2, 4, 6, ..., leaving the odd positions
+//   between them for moves. Critical edges are split first so every edge
+//   has a place for its moves.
+// - Liveness is solved over bit sets, then the lifetime interval of every
+//   value is built in one backwards pass over the blocks: a list of ranges
+//   with holes where the value isn't live, and the positions where it is
+//   used. The registers an instruction overwrites (the caller-saved ones at
+//   a call, RAX and RDX at a division, RCX at a shift) get a fixed range
+//   there, so no value lives across it in one.
+// - The intervals are visited in the order they start. An interval gets
+//   the register that stays free longest; if that is only free for a part
+//   of it, the interval is split and the rest visited later. If no register
+//   is free, the interval whose next use is furthest away, this one or one
+//   holding a register, is split and spilled until shortly before it needs
+//   a register again.
+// - A spilled value has one spill slot for its whole lifetime, slots are
+//   reused once the value they were given to is dead.
+// - Where the location of a value changes inside a block there is a move,
+//   where it differs across an edge, or for a phi, a move on the edge: at
+//   the end of its source if it has one successor, at the start of its
+//   target otherwise.
+//
+// The function is changed by splitting critical edges.
+class RegisterAllocation {
+ public:
+  struct Statistics {
+    std::size_t instructions = 0;
+    std::size_t intervals = 0;
+    std::size_t splits = 0;
+    // Intervals (parts of the lifetime of a value) that live in a slot.
+    std::size_t spilledIntervals = 0;
+    std::size_t moves = 0;
+  };
+
+ private:
+  class LinearScan;
+
+  std::vector<BlockID> order;
+  std::vector<std::uint32_t> blockStarts;
+  std::vector<std::uint32_t> positions;
+  // The locations of value v from the positions where they start on are
+  // locationList[locationStarts[v]] to locationList[locationStarts[v + 1]].
+  std::vector<std::uint32_t> locationStarts;
+  std::vector<std::pair<std::uint32_t, Location>> locationList;
+  // Moves inside blocks, sorted by position.
+  std::vector<std::uint32_t> movePositions;
+  std::vector<Move> moveList;
+  std::vector<std::vector<Move>> entryMoveLists;
+  std::vector<std::vector<Move>> exitMoveLists;
+  std::vector<X86::Register> calleeSaved;
+  std::uint32_t spillSlots = 0;
+  Statistics stats;
+
+ public:
+  explicit RegisterAllocation(Function& function);
+
+  // The blocks to emit, in order. The entry block is the first one.
+  std::span<const BlockID> blockOrder() const { return order; }
+  std::uint32_t blockStart(BlockID id) const { return blockStarts[id]; }
+  // The position of an instruction, of the block of a phi, 0 for a
+  // parameter.
+  std::uint32_t position(ValueID id) const { return positions[id]; }
+
+  // The location of a value at a position where it is live.
+  Location locationAt(ValueID value, std::uint32_t position) const;
+  // Where the result of an instruction is put, see lateResultRegister.
+  Location resultLocation(const Function& function, ValueID id) const;
+
+  // The moves at an odd position, after the instruction before it.
+  std::span<const Move> movesAt(std::uint32_t position) const;
+  // The moves on the edges into a block, before its first instruction, and
+  // out of it, before its terminator.
+  std::span<const Move> entryMoves(BlockID id) const {
+    return entryMoveLists[id];
+  }
+  std::span<const Move> exitMoves(BlockID id) const {
+    return exitMoveLists[id];
+  }
+
+  std::uint32_t numberOfSpillSlots() const { return spillSlots; }
+  // The callee-saved registers the function uses, it has to save them.
+  std::span<const X86::Register> calleeSavedRegisters() const {
+    return calleeSaved;
+  }
+  const Statistics& statistics() const { return stats; }
+};
+
+#endif
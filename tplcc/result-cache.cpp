@@ -0,0 +1,162 @@
+#include "result-cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+namespace {
+// The first line of every entry. A cache written by a compiler that stores
+// its entries differently only misses.
+constexpr std::string_view ENTRY_MAGIC = "tplcc-result 1\n";
+
+// A name no other thread or process writes to at the same time.
+std::string temporaryPathFor(const std::string& path) {
+  static std::atomic<std::uint64_t> counter{0};
+  const auto unique =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+      static_cast<std::size_t>(
+          std::chrono::steady_clock::now().time_since_epoch().count());
+  return path + ".tmp." + std::to_string(unique) + "." +
+         std::to_string(counter.fetch_add(1, std::memory_order_relaxed));
+}
+
+// Write the content to the path at once: readers see the old file or the
+// new one, never a part.
+bool replaceFile(const std::string& path, std::string_view content) {
+  const auto temporary = temporaryPathFor(path);
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    file.write(content.data(), static_cast<std::streamsize>(content.size()));
+    if (!file) {
+      file.close();
+      std::error_code error;
+      std::filesystem::remove(temporary, error);
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) std::filesystem::remove(temporary, error);
+  return !error;
+}
+
+bool readFile(const std::string& path, std::string& content) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  content = std::move(stream).str();
+  return true;
+}
+}  // namespace
+
+ResultCache::Statistics& ResultCache::Statistics::operator+=(
+    const Statistics& other) {
+  hits += other.hits;
+  misses += other.misses;
+  savedSeconds += other.savedSeconds;
+  return *this;
+}
+
+ResultCache::ResultCache(std::string directory)
+    : directory(std::move(directory)) {}
+
+ContentHash ResultCache::keyOf(std::string_view preprocessedText,
+                               std::string_view options) {
+  return ContentHasher().add(preprocessedText).add(options).finish();
+}
+
+std::optional<ResultCache::Entry> ResultCache::find(
+    const ContentHash& key) const {
+  std::string content;
+  if (!readFile(pathOf(key), content) || !content.starts_with(ENTRY_MAGIC)) {
+    return std::nullopt;
+  }
+  // The compile time is the second line.
+  const auto start = ENTRY_MAGIC.size();
+  const auto end = content.find('\n', start);
+  if (end == std::string::npos) return std::nullopt;
+  Entry entry;
+  entry.compileSeconds = std::strtod(content.c_str() + start, nullptr);
+  entry.output = content.substr(end + 1);
+  return entry;
+}
+
+bool ResultCache::store(const ContentHash& key, const Entry& entry) const {
+  const auto path = pathOf(key);
+  std::error_code error;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), error);
+  if (error) return false;
+  char time[32];
+  std::snprintf(time, sizeof(time), "%.6f\n", entry.compileSeconds);
+  std::string content(ENTRY_MAGIC);
+  content += time;
+  content += entry.output;
+  return replaceFile(path, content);
+}
+
+ResultCache::Statistics ResultCache::statistics() const {
+  Statistics statistics;
+  std::string content;
+  if (!readFile(statisticsPath(), content)) return statistics;
+  std::istringstream lines(content);
+  std::string name;
+  while (lines >> name) {
+    if (name == "hits") {
+      lines >> statistics.hits;
+    } else if (name == "misses") {
+      lines >> statistics.misses;
+    } else if (name == "saved-seconds") {
+      lines >> statistics.savedSeconds;
+    } else {
+      break;
+    }
+  }
+  return statistics;
+}
+
+bool ResultCache::addToStatistics(const Statistics& statistics) const {
+  auto total = this->statistics();
+  total += statistics;
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (error) return false;
+  char content[128];
+  std::snprintf(content, sizeof(content),
+                "hits %llu\nmisses %llu\nsaved-seconds %.6f\n",
+                static_cast<unsigned long long>(total.hits),
+                static_cast<unsigned long long>(total.misses),
+                total.savedSeconds);
+  return replaceFile(statisticsPath(), content);
+}
+
+std::string ResultCache::pathOf(const ContentHash& key) const {
+  // Split by the first two digits, so no directory gets too many files.
+  const auto hex = key.hex();
+  return (std::filesystem::path(directory) / hex.substr(0, 2) / hex.substr(2))
+      .string();
+}
+
+std::string ResultCache::statisticsPath() const {
+  return (std::filesystem::path(directory) / "statistics").string();
+}
+
+void printStatistics(std::ostream& os, std::string_view directory,
+                     const ResultCache::Statistics& statistics) {
+  char rows[160];
+  std::snprintf(rows, sizeof(rows),
+                "  hits         %12llu\n"
+                "  misses       %12llu\n"
+                "  saved time   %12.3f s\n",
+                static_cast<unsigned long long>(statistics.hits),
+                static_cast<unsigned long long>(statistics.misses),
+                statistics.savedSeconds);
+  os << "Cache in " << directory << ":\n" << rows;
+}
@@ -0,0 +1,77 @@
+#ifndef TPLCC_RESULT_CACHE_H
+#define TPLCC_RESULT_CACHE_H
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "content-hash.h"
+
+// The outputs of earlier compilations on disk, by the hash of what they were
+// compiled from: the preprocessed text, which is all that parsing and code
+// generation see of the source, and the options that change the output. A
+// file preprocessed to the same text as before is only looked up, whatever
+// its name, wherever the headers it included came from.
+//
+// Every output is a file of its own, written to a temporary file first and
+// renamed, so compilers running at the same time, in other processes too,
+// can share a cache. Nothing is ever removed from it, the directory can be
+// emptied at any time.
+class ResultCache {
+ public:
+  struct Entry {
+    std::string output;
+    // How long compiling it took, what finding it saves.
+    double compileSeconds = 0;
+  };
+
+  struct Statistics {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    // The compile times of the outputs found less the time finding them.
+    double savedSeconds = 0;
+
+    Statistics& operator+=(const Statistics& other);
+  };
+
+ private:
+  std::string directory;
+
+ public:
+  // The directory is made when the first output is stored.
+  explicit ResultCache(std::string directory);
+
+  // The key of an output: the preprocessed text and, as text, the options
+  // and the compiler that made it.
+  static ContentHash keyOf(std::string_view preprocessedText,
+                           std::string_view options);
+
+  // The output stored under the key, nullopt if there is none, or it can't
+  // be read.
+  std::optional<Entry> find(const ContentHash& key) const;
+  // Returns false if it can't be written, which only costs a miss later.
+  bool store(const ContentHash& key, const Entry& entry) const;
+
+  // What the compilations using the cache found in it so far.
+  Statistics statistics() const;
+  // Add to the statistics on disk. Two processes adding at the same time
+  // may lose one of the additions.
+  bool addToStatistics(const Statistics& statistics) const;
+
+ private:
+  std::string pathOf(const ContentHash& key) const;
+  std::string statisticsPath() const;
+};
+
+// E.g.
+//
+// Cache in /home/me/.tplcc-cache:
+//   hits                   12
+//   misses                  3
+//   saved time          4.207 s
+void printStatistics(std::ostream& os, std::string_view directory,
+                     const ResultCache::Statistics& statistics);
+
+#endif
@@ -0,0 +1,1367 @@
+#include "sema.h"
+
+#include <algorithm>
+#include <string>
+
+#include "literal.h"
+
+namespace {
+constexpr TypeID VOID = TypeTable::builtin(TypeKind::Void);
+constexpr TypeID BOOL = TypeTable::builtin(TypeKind::Bool);
+constexpr TypeID CHAR = TypeTable::builtin(TypeKind::Char);
+constexpr TypeID INT = TypeTable::builtin(TypeKind::Int);
+constexpr TypeID UNSIGNED_INT = TypeTable::builtin(TypeKind::UnsignedInt);
+constexpr TypeID LONG = TypeTable::builtin(TypeKind::Long);
+constexpr TypeID UNSIGNED_LONG = TypeTable::builtin(TypeKind::UnsignedLong);
+constexpr TypeID LONG_LONG = TypeTable::builtin(TypeKind::LongLong);
+constexpr TypeID UNSIGNED_LONG_LONG =
+    TypeTable::builtin(TypeKind::UnsignedLongLong);
+constexpr TypeID FLOAT = TypeTable::builtin(TypeKind::Float);
+constexpr TypeID DOUBLE = TypeTable::builtin(TypeKind::Double);
+constexpr TypeID LONG_DOUBLE = TypeTable::builtin(TypeKind::LongDouble);
+
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t align) {
+  return align == 0 ? value : (value + align - 1) / align * align;
+}
+
+TypeID unsignedVersion(TypeID type) {
+  switch (static_cast<TypeKind>(type)) {
+    case TypeKind::Int: return UNSIGNED_INT;
+    case TypeKind::Long: return UNSIGNED_LONG;
+    case TypeKind::LongLong: return UNSIGNED_LONG_LONG;
+    default: return type;
+  }
+}
+
+// The type of an integer literal is the first of a list of types that can
+// represent its value, which list depends on the suffix and the base (C99
+// 6.4.4.1p5).
+TypeID integerLiteralType(const IntegerLiteralValue& literal) {
+  static constexpr TypeID DECIMAL[] = {INT, LONG, LONG_LONG};
+  static constexpr TypeID OTHER[] = {INT,  UNSIGNED_INT, LONG, UNSIGNED_LONG,
+                                     LONG_LONG, UNSIGNED_LONG_LONG};
+  static constexpr TypeID UNSIGNED[] = {UNSIGNED_INT, UNSIGNED_LONG,
+                                        UNSIGNED_LONG_LONG};
+
+  const auto fits = [&](TypeID type) {
+    switch (static_cast<TypeKind>(type)) {
+      case TypeKind::Int: return literal.value <= INT32_MAX;
+      case TypeKind::UnsignedInt: return literal.value <= UINT32_MAX;
+      case TypeKind::Long:
+      case TypeKind::LongLong: return literal.value <= INT64_MAX;
+      default: return true;
+    }
+  };
+  const auto rankOf = [](TypeID type) {
+    switch (static_cast<TypeKind>(type)) {
+      case TypeKind::Int:
+      case TypeKind::UnsignedInt: return 0;
+      case TypeKind::Long:
+      case TypeKind::UnsignedLong: return 1;
+      default: return 2;
+    }
+  };
+
+  std::span<const TypeID> candidates =
+      literal.isUnsigned ? std::span<const TypeID>(UNSIGNED)
+      : literal.isDecimal ? std::span<const TypeID>(DECIMAL)
+                          : std::span<const TypeID>(OTHER);
+  for (const auto type : candidates) {
+    if (rankOf(type) >= literal.longs && fits(type)) return type;
+  }
+  // A decimal literal too large for long long, GCC and Clang make it
+  // unsigned long long too.
+  return UNSIGNED_LONG_LONG;
+}
+}  // namespace
+
+Sema::Sema(const AST& ast, const StringInterner& strings, TypeTable& types,
+           IReportError& errOut)
+    : ast(ast),
+      strings(strings),
+      types(types),
+      errOut(errOut),
+      constants(ast, strings, *this, errOut) {}
+
+void Sema::check() {
+  nodeTypes.assign(ast.size(), TypeTable::ERROR);
+  convertedTypes.assign(ast.size(), TypeTable::ERROR);
+  values.assign(ast.size(), 0);
+  layouts.clear();
+  constants.reset();
+  returns.clear();
+  previousEnumerator = 0;
+
+  for (NodeID id = 1; id < ast.size(); id++) {
+    visit(id);
+    convertedTypes[id] = nodeTypes[id];
+  }
+}
+
+void Sema::visit(NodeID id) {
+  const auto& node = ast[id];
+  auto& type = nodeTypes[id];
+  switch (node.kind) {
+    // Expressions
+    case NodeKind::IntegerLiteral:
+      checkIntegerLiteral(id);
+      break;
+    case NodeKind::FloatingLiteral:
+      type = floatingLiteralType(id);
+      break;
+    case NodeKind::CharacterLiteral: {
+      const auto value = characterLiteralValue(strings.view(node.name),
+                                               node.flags & NodeFlag::Wide);
+      values[id] = static_cast<std::uint64_t>(
+          static_cast<std::int64_t>(static_cast<std::int32_t>(value)));
+      type = INT;
+      break;
+    }
+    case NodeKind::StringLiteral:
+      type = stringLiteralType(id);
+      break;
+    case NodeKind::Identifier:
+      type = identifierType(id);
+      break;
+    case NodeKind::Unary:
+      type = unaryType(id);
+      break;
+    case NodeKind::Binary:
+      type = binaryType(id, node.oper(), node.a, node.b);
+      break;
+    case NodeKind::Assign:
+      type = assignType(id);
+      break;
+    case NodeKind::Conditional:
+      type = conditionalType(id);
+      break;
+    case NodeKind::Cast:
+      type = castType(id);
+      break;
+    case NodeKind::SizeofExpr:
+    case NodeKind::SizeofType:
+      type = sizeofType(id, nodeTypes[node.a]);
+      break;
+    case NodeKind::Call:
+      type = callType(id);
+      break;
+    case NodeKind::Subscript:
+      type = subscriptType(id);
+      break;
+    case NodeKind::Member:
+      type = memberType(id);
+      break;
+    case NodeKind::CompoundLiteral: {
+      auto literalType = nodeTypes[node.a];
+      if (types.kind(literalType) == TypeKind::Array) {
+        literalType = completeArrayType(literalType, node.b);
+      }
+      checkInitList(literalType, node.b);
+      type = literalType;
+      break;
+    }
+
+    // Statements
+    case NodeKind::IfStmt:
+    case NodeKind::WhileStmt:
+      checkScalar(node.a);
+      break;
+    case NodeKind::DoStmt:
+      checkScalar(node.b);
+      break;
+    case NodeKind::ForStmt:
+      if (node.b != 0) checkScalar(node.b);
+      break;
+    case NodeKind::SwitchStmt: {
+      const auto condition = convertPromoted(node.a);
+      if (!types.isInteger(condition) && condition != TypeTable::ERROR) {
+        report(ErrorID::InvalidOperand, node.a, {"switch", typeName(condition)});
+      }
+      break;
+    }
+    case NodeKind::CaseStmt: {
+      std::uint64_t value = 0;
+      if (!integerConstant(node.a, &value)) {
+        report(ErrorID::NotIntegerConstant, node.a);
+      }
+      break;
+    }
+    case NodeKind::ReturnStmt:
+      returns.push_back(id);
+      break;
+
+    // Declarations
+    case NodeKind::DeclGroup:
+      checkDeclGroup(id);
+      break;
+    case NodeKind::VarDecl:
+    case NodeKind::FunctionDecl:
+    case NodeKind::TypedefDecl:
+      type = nodeTypes[node.a];
+      break;
+    case NodeKind::FunctionDef:
+      checkFunctionDefinition(id);
+      break;
+    case NodeKind::ParamDecl:
+      // The parameters of an old style definition get their types after
+      // them, see checkFunctionDefinition.
+      if (node.a < id) type = parameterType(id);
+      break;
+    case NodeKind::FieldDecl:
+      type = nodeTypes[node.a];
+      if (node.b != 0) {
+        std::uint64_t width = 0;
+        if (!integerConstant(node.b, &width)) {
+          report(ErrorID::NotIntegerConstant, node.b);
+        }
+      }
+      break;
+    case NodeKind::EnumConstantDecl:
+      checkEnumConstant(id);
+      break;
+    case NodeKind::RecordDefinition:
+      layOutRecord(id);
+      break;
+
+    // Types
+    case NodeKind::BuiltinType:
+      type = types.qualified(builtinType(node), node.op);
+      break;
+    case NodeKind::PointerType:
+      type = types.qualified(types.pointerTo(nodeTypes[node.a]), node.op);
+      break;
+    case NodeKind::ArrayType:
+      type = arrayType(id);
+      break;
+    case NodeKind::FunctionType:
+      type = functionType(id);
+      break;
+    case NodeKind::RecordType:
+      type = types.tagged((node.flags & NodeFlag::Union) ? TypeKind::Union
+                                                        : TypeKind::Struct,
+                          node.a, node.name);
+      break;
+    case NodeKind::EnumType:
+      type = types.tagged(TypeKind::Enum, node.a, node.name);
+      break;
+    case NodeKind::TypedefType:
+      type = nodeTypes[node.a];
+      break;
+    case NodeKind::QualifiedType:
+      type = types.qualified(nodeTypes[node.a], node.op);
+      break;
+
+    default:
+      type = VOID;
+      break;
+  }
+}
+
+/* Sizes and conversions */
+
+std::uint64_t Sema::sizeOf(TypeID type) const {
+  switch (types.kind(type)) {
+    case TypeKind::Bool:
+    case TypeKind::Char:
+    case TypeKind::SignedChar:
+    case TypeKind::UnsignedChar: return 1;
+    case TypeKind::Short:
+    case TypeKind::UnsignedShort: return 2;
+    case TypeKind::Int:
+    case TypeKind::UnsignedInt:
+    case TypeKind::Float:
+    case TypeKind::Enum: return 4;
+    case TypeKind::Long:
+    case TypeKind::UnsignedLong:
+    case TypeKind::LongLong:
+    case TypeKind::UnsignedLongLong:
+    case TypeKind::Double:
+    case TypeKind::Pointer: return 8;
+    case TypeKind::LongDouble: return 16;
+    case TypeKind::Array:
+      return types[type].count * sizeOf(types[type].base);
+    case TypeKind::Struct:
+    case TypeKind::Union: {
+      const auto layout = layoutOf(type);
+      return layout ? layout->size : 0;
+    }
+    default: return 0;
+  }
+}
+
+std::uint32_t Sema::alignOf(TypeID type) const {
+  switch (types.kind(type)) {
+    case TypeKind::Array: return alignOf(types[type].base);
+    case TypeKind::Struct:
+    case TypeKind::Union: {
+      const auto layout = layoutOf(type);
+      return layout ? layout->align : 1;
+    }
+    default: {
+      const auto size = sizeOf(type);
+      return size == 0 ? 1 : static_cast<std::uint32_t>(size);
+    }
+  }
+}
+
+bool Sema::isComplete(TypeID type) const {
+  switch (types.kind(type)) {
+    case TypeKind::Void:
+    case TypeKind::Function: return false;
+    case TypeKind::Array:
+      return !(types[type].flags & TypeFlag::Incomplete) &&
+             isComplete(types[type].base);
+    case TypeKind::Struct:
+    case TypeKind::Union: return layoutOf(type) != nullptr;
+    default: return true;
+  }
+}
+
+const Sema::RecordLayout* Sema::layoutOf(TypeID record) const {
+  const auto definition = ast[types[record].count].b;
+  const auto it = layouts.find(definition);
+  return it == layouts.end() ? nullptr : &it->second;
+}
+
+TypeID Sema::promote(TypeID type) const {
+  type = types.unqualified(type);
+  if (types.kind(type) == TypeKind::Enum) return INT;
+  if (types.isInteger(type) && types.rank(type) < types.rank(INT)) return INT;
+  return type;
+}
+
+TypeID Sema::usualArithmeticConversion(TypeID a, TypeID b) const {
+  a = promote(a);
+  b = promote(b);
+  if (a == TypeTable::ERROR || b == TypeTable::ERROR) return TypeTable::ERROR;
+  for (const auto floating : {LONG_DOUBLE, DOUBLE, FLOAT}) {
+    if (a == floating || b == floating) return floating;
+  }
+  if (a == b) return a;
+
+  if (types.isSigned(a) == types.isSigned(b)) {
+    return types.rank(a) >= types.rank(b) ? a : b;
+  }
+  const auto unsignedType = types.isSigned(a) ? b : a;
+  const auto signedType = types.isSigned(a) ? a : b;
+  if (types.rank(unsignedType) >= types.rank(signedType)) return unsignedType;
+  if (sizeOf(signedType) > sizeOf(unsignedType)) return signedType;
+  return unsignedVersion(signedType);
+}
+
+TypeID Sema::convertValue(NodeID id) {
+  const auto type = nodeTypes[id];
+  TypeID converted = types.unqualified(type);
+  if (types.kind(type) == TypeKind::Array) {
+    converted = types.pointerTo(types[type].base);
+  } else if (types.kind(type) == TypeKind::Function) {
+    converted = types.pointerTo(type);
+  }
+  convertedTypes[id] = converted;
+  return converted;
+}
+
+TypeID Sema::convertPromoted(NodeID id) {
+  const auto type = convertValue(id);
+  if (!types.isInteger(type)) return type;
+  return convertedTypes[id] = promote(type);
+}
+
+TypeID Sema::convertArgument(NodeID id) {
+  const auto type = convertPromoted(id);
+  return type == FLOAT ? convertedTypes[id] = DOUBLE : type;
+}
+
+bool Sema::convertAsIfByAssignment(NodeID id, TypeID target) {
+  const auto source = convertValue(id);
+  target = types.unqualified(target);
+
+  bool isAllowed = false;
+  if (source == TypeTable::ERROR || target == TypeTable::ERROR) {
+    isAllowed = true;
+  } else if (types.isArithmetic(target) && types.isArithmetic(source)) {
+    isAllowed = true;
+  } else if (types.isRecord(target)) {
+    isAllowed = types.isCompatible(source, target);
+  } else if (types.isPointer(target)) {
+    if (types.isPointer(source)) {
+      // The pointee may gain qualifiers but not lose them (C99 6.5.16.1).
+      const auto& to = types[types[target].base];
+      const auto& from = types[types[source].base];
+      const bool keepsQualifiers =
+          (from.qualifiers & to.qualifiers) == from.qualifiers;
+      isAllowed =
+          keepsQualifiers &&
+          (to.kind == TypeKind::Void || from.kind == TypeKind::Void ||
+           types.isCompatible(to.unqualified, from.unqualified));
+    } else {
+      isAllowed = isNullPointerConstant(id);
+    }
+  } else if (target == BOOL) {
+    isAllowed = types.isPointer(source);
+  }
+
+  if (!isAllowed) {
+    report(ErrorID::IncompatibleTypes, id, {typeName(target), typeName(source)});
+    return false;
+  }
+  convertedTypes[id] = target;
+  return true;
+}
+
+bool Sema::isLValue(NodeID id) const {
+  const auto& node = ast[id];
+  switch (node.kind) {
+    case NodeKind::Identifier:
+      return node.a != 0 && (ast[node.a].kind == NodeKind::VarDecl ||
+                             ast[node.a].kind == NodeKind::ParamDecl);
+    case NodeKind::Unary:
+      return node.oper() == Operator::Dereference;
+    case NodeKind::Member:
+      return (node.flags & NodeFlag::Arrow) || isLValue(node.a);
+    case NodeKind::Subscript:
+    case NodeKind::StringLiteral:
+    case NodeKind::CompoundLiteral:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool Sema::isModifiableLValue(NodeID id) const {
+  const auto type = nodeTypes[id];
+  if (type == TypeTable::ERROR) return true;
+  return isLValue(id) && !(types[type].qualifiers & TypeQualifier::Const) &&
+         types.kind(type) != TypeKind::Array && isComplete(type);
+}
+
+bool Sema::isNullPointerConstant(NodeID id) const {
+  const auto& node = ast[id];
+  if (node.kind == NodeKind::Cast) {
+    const auto type = nodeTypes[id];
+    if (types.isPointer(type) && types[type].base == VOID) {
+      return isNullPointerConstant(node.b);
+    }
+  }
+  std::uint64_t value = 0;
+  return types.isInteger(nodeTypes[id]) && integerConstant(id, &value) &&
+         value == 0;
+}
+
+bool Sema::checkScalar(NodeID id) {
+  const auto type = convertValue(id);
+  if (type == TypeTable::ERROR || types.isScalar(type)) return true;
+  report(ErrorID::ScalarRequired, id, {typeName(type)});
+  return false;
+}
+
+// See ConstantEvaluator, the value is in the type of the expression.
+bool Sema::integerConstant(NodeID id, std::uint64_t* value) const {
+  const auto constant = constants.evaluate(id);
+  if (!constant) return false;
+  *value = constant->bits;
+  return true;
+}
+
+void Sema::report(ErrorID id, NodeID node,
+                  std::initializer_list<std::string_view> arguments) {
+  const auto offset = ast[node].offset;
+  const auto length = ast[node].kind == NodeKind::Identifier
+                          ? strings.view(ast[node].name).size()
+                          : 1;
+  errOut.reportsError({id, {offset, offset + length}, arguments});
+}
+
+std::string Sema::typeName(TypeID type) const {
+  return types.toString(type, strings);
+}
+
+/* Types and declarations */
+
+TypeID Sema::builtinType(const Node& node) const {
+  const auto specifiers = node.flags;
+  const bool isUnsigned = specifiers & TypeSpecifier::Unsigned;
+  if (specifiers & TypeSpecifier::Void) return VOID;
+  if (specifiers & TypeSpecifier::Bool) return BOOL;
+  if (specifiers & TypeSpecifier::Char) {
+    if (specifiers & TypeSpecifier::Signed) {
+      return TypeTable::builtin(TypeKind::SignedChar);
+    }
+    return isUnsigned ? TypeTable::builtin(TypeKind::UnsignedChar) : CHAR;
+  }
+  if (specifiers & TypeSpecifier::Short) {
+    return TypeTable::builtin(isUnsigned ? TypeKind::UnsignedShort
+                                         : TypeKind::Short);
+  }
+  if (specifiers & TypeSpecifier::Float) return FLOAT;
+  if (specifiers & TypeSpecifier::Double) {
+    return (specifiers & TypeSpecifier::Long) ? LONG_DOUBLE : DOUBLE;
+  }
+  if (specifiers & TypeSpecifier::LongLong) {
+    return isUnsigned ? UNSIGNED_LONG_LONG : LONG_LONG;
+  }
+  if (specifiers & TypeSpecifier::Long) {
+    return isUnsigned ? UNSIGNED_LONG : LONG;
+  }
+  return isUnsigned ? UNSIGNED_INT : INT;
+}
+
+TypeID Sema::arrayType(NodeID id) {
+  const auto& node = ast[id];
+  const auto element = nodeTypes[node.a];
+  if (!isComplete(element) && element != TypeTable::ERROR) {
+    report(ErrorID::IncompleteType, id, {typeName(element)});
+    return TypeTable::ERROR;
+  }
+
+  if (node.b == 0) {
+    return types.arrayOf(element, 0,
+                         (node.flags & NodeFlag::VLAStar)
+                             ? TypeFlag::VariableLength
+                             : TypeFlag::Incomplete);
+  }
+
+  const auto sizeType = convertPromoted(node.b);
+  if (!types.isInteger(sizeType) && sizeType != TypeTable::ERROR) {
+    report(ErrorID::InvalidOperand, node.b, {"[]", typeName(sizeType)});
+  }
+  std::uint64_t size = 0;
+  if (!integerConstant(node.b, &size)) {
+    return types.arrayOf(element, 0, TypeFlag::VariableLength);
+  }
+  if (types.isSigned(sizeType) && static_cast<std::int64_t>(size) < 0) {
+    report(ErrorID::InvalidArraySize, node.b);
+    return TypeTable::ERROR;
+  }
+  return types.arrayOf(element, static_cast<std::uint32_t>(size));
+}
+
+TypeID Sema::functionType(NodeID id) {
+  const auto& node = ast[id];
+  std::uint16_t flags = 0;
+  if (node.flags & NodeFlag::Variadic) flags |= TypeFlag::Variadic;
+  if (node.flags & NodeFlag::NoPrototype) flags |= TypeFlag::NoPrototype;
+
+  std::vector<TypeID> params;
+  if (!(flags & TypeFlag::NoPrototype)) {
+    for (const auto param : ast.list(node.list)) {
+      params.push_back(nodeTypes[param]);
+    }
+  }
+  return types.function(types.unqualified(nodeTypes[node.a]), params, flags);
+}
+
+// Array and function parameters are adjusted to pointers (C99 6.7.5.3p7).
+TypeID Sema::parameterType(NodeID param) const {
+  const auto typeNode = ast[param].a;
+  if (typeNode == 0) return INT;
+
+  const auto type = nodeTypes[typeNode];
+  if (types.kind(type) == TypeKind::Array) {
+    // The qualifiers in "int a[const]" belong to the pointer.
+    const auto qualifiers =
+        ast[typeNode].kind == NodeKind::ArrayType ? ast[typeNode].op : 0;
+    return types.qualified(types.pointerTo(types[type].base), qualifiers);
+  }
+  if (types.kind(type) == TypeKind::Function) return types.pointerTo(type);
+  return type;
+}
+
+TypeID Sema::declaredType(NodeID decl) const {
+  if (ast[decl].kind == NodeKind::ParamDecl && ast[decl].a > decl) {
+    return parameterType(decl);
+  }
+  return nodeTypes[decl];
+}
+
+void Sema::checkEnumConstant(NodeID id) {
+  const auto& node = ast[id];
+  std::uint64_t value = 0;
+  if (node.a != 0) {
+    convertPromoted(node.a);
+    if (!integerConstant(node.a, &value)) {
+      report(ErrorID::NotIntegerConstant, node.a);
+    }
+  } else if (previousEnumerator != 0 &&
+             ast[previousEnumerator].c == node.c) {
+    // Every enumerator has to be representable as an int (C99 6.7.2.2p2).
+    const auto previous =
+        IntegerValue::of(values[previousEnumerator], 32, false);
+    const auto next = foldBinary(Operator::Add, previous,
+                                 IntegerValue::of(1, 32, false));
+    if (next.status != FoldStatus::Ok) report(ErrorID::ConstantOverflow, id);
+    value = next.value.bits;
+  }
+  values[id] = value;
+  nodeTypes[id] = INT;
+  previousEnumerator = id;
+}
+
+// Lay out the members like the System V ABI does: every member is aligned
+// to its type, and a bit-field is put right after the previous one unless
+// it would cross a boundary of its type.
+void Sema::layOutRecord(NodeID definition) {
+  const auto& node = ast[definition];
+  const bool isUnion = ast[node.a].flags & NodeFlag::Union;
+  const auto fields = ast.list(node.list);
+
+  std::uint64_t offset = 0;  // in bits
+  std::uint64_t size = 0;    // in bits
+  std::uint32_t align = 1;
+
+  for (std::size_t i = 0; i < fields.size(); i++) {
+    const auto field = fields[i];
+    const auto type = nodeTypes[field];
+    const auto& decl = ast[field];
+
+    if (!isComplete(type)) {
+      // A flexible array member.
+      const bool isLast = i + 1 == fields.size();
+      if (!isLast || types.kind(type) != TypeKind::Array) {
+        report(ErrorID::IncompleteType, field, {typeName(type)});
+        continue;
+      }
+    }
+
+    const std::uint64_t typeBits = sizeOf(type) * 8;
+    const auto typeAlign = alignOf(type);
+    if (decl.b != 0) {
+      std::uint64_t width = 0;
+      integerConstant(decl.b, &width);
+      if (width == 0) {
+        if (!isUnion) offset = alignUp(offset, typeBits);
+        values[field] = offset;
+        continue;
+      }
+      if (isUnion) {
+        values[field] = 0;
+        size = std::max(size, width);
+      } else {
+        if (offset / typeBits != (offset + width - 1) / typeBits) {
+          offset = alignUp(offset, typeBits);
+        }
+        values[field] = offset;
+        offset += width;
+      }
+    } else if (isUnion) {
+      values[field] = 0;
+      size = std::max(size, typeBits);
+    } else {
+      offset = alignUp(offset, typeAlign * 8);
+      values[field] = offset;
+      offset += typeBits;
+    }
+    // Unnamed bit-fields don't affect the alignment.
+    if (decl.b == 0 || decl.name != 0) align = std::max(align, typeAlign);
+
+    // The members of an anonymous struct or union are members of this one,
+    // so their offsets are made relative to this record.
+    if (decl.name == 0 && decl.b == 0 && types.isRecord(type)) {
+      const auto base = values[field];
+      const auto rebase = [&](const auto& self, TypeID record) -> void {
+        const auto inner = ast[types[record].count].b;
+        for (const auto member : ast.list(ast[inner].list)) {
+          values[member] += base;
+          if (ast[member].name == 0 && ast[member].b == 0 &&
+              types.isRecord(nodeTypes[member])) {
+            self(self, nodeTypes[member]);
+          }
+        }
+      };
+      rebase(rebase, types.unqualified(type));
+    }
+  }
+
+  const auto bits = isUnion ? size : offset;
+  layouts[definition] = {alignUp((bits + 7) / 8, align), align};
+}
+
+void Sema::checkDeclGroup(NodeID id) {
+  for (const auto decl : ast.list(ast[id].list)) {
+    const auto& node = ast[decl];
+    if (node.kind != NodeKind::VarDecl) continue;
+
+    if (types.kind(nodeTypes[decl]) == TypeKind::Void) {
+      report(ErrorID::IncompleteType, decl, {"void"});
+      continue;
+    }
+    if (node.b != 0) {
+      nodeTypes[decl] = checkInitializer(nodeTypes[decl], node.b);
+    }
+  }
+}
+
+void Sema::checkFunctionDefinition(NodeID id) {
+  const auto function = ast[id].a;
+  const auto type = nodeTypes[function];
+  const auto result = types[type].base;
+
+  // The parameters of an old style definition have their types now.
+  for (const auto param : ast.list(ast[ast[function].a].list)) {
+    nodeTypes[param] = parameterType(param);
+  }
+
+  for (const auto statement : returns) {
+    const auto value = ast[statement].a;
+    if (value == 0) {
+      if (result != VOID) {
+        report(ErrorID::MissingReturnValue, statement, {typeName(result)});
+      }
+    } else if (result == VOID) {
+      if (types.kind(nodeTypes[value]) != TypeKind::Void) {
+        report(ErrorID::VoidFunctionReturnsValue, value);
+      }
+    } else {
+      convertAsIfByAssignment(value, result);
+    }
+  }
+  returns.clear();
+}
+
+/* Initializers */
+
+// Check the initializer of an object of the type, and return the type with
+// the length of an array of unknown size filled in.
+TypeID Sema::checkInitializer(TypeID target, NodeID init) {
+  const auto& node = ast[init];
+  switch (types.kind(target)) {
+    case TypeKind::Error:
+      return target;
+    case TypeKind::Array: {
+      const auto element = types.unqualified(types[target].base);
+      const bool isCharArray =
+          element == CHAR || element == TypeTable::builtin(TypeKind::SignedChar) ||
+          element == TypeTable::builtin(TypeKind::UnsignedChar);
+      if (node.kind == NodeKind::StringLiteral &&
+          (node.flags & NodeFlag::Wide ? element == INT : isCharArray)) {
+        convertedTypes[init] = nodeTypes[init];
+        if (types[target].flags & TypeFlag::Incomplete) {
+          return types.arrayOf(types[target].base,
+                               types[nodeTypes[init]].count);
+        }
+        return target;
+      }
+      if (node.kind != NodeKind::InitList) {
+        report(ErrorID::IncompatibleTypes, init,
+               {typeName(target), typeName(nodeTypes[init])});
+        return target;
+      }
+      target = completeArrayType(target, init);
+      checkInitList(target, init);
+      return target;
+    }
+    case TypeKind::Struct:
+    case TypeKind::Union:
+      if (node.kind == NodeKind::InitList) {
+        checkInitList(target, init);
+      } else {
+        convertAsIfByAssignment(init, target);
+      }
+      return target;
+    default:
+      // Braces around a scalar initializer are allowed.
+      if (node.kind == NodeKind::InitList) {
+        nodeTypes[init] = target;
+        const auto items = ast.list(node.list);
+        if (!items.empty()) checkInitializer(target, items[0]);
+        return target;
+      }
+      convertAsIfByAssignment(init, target);
+      return target;
+  }
+}
+
+TypeID Sema::completeArrayType(TypeID array, NodeID init) {
+  if (!(types[array].flags & TypeFlag::Incomplete)) return array;
+  if (ast[init].kind != NodeKind::InitList) return array;
+
+  // Elements initialized without braces around them take as many
+  // initializers as they have scalars.
+  const auto element = types[array].base;
+  std::uint64_t scalars = 1;
+  for (auto type = element; types.kind(type) == TypeKind::Array;
+       type = types[type].base) {
+    scalars *= std::max<std::uint64_t>(types[type].count, 1);
+  }
+
+  std::uint64_t index = 0;
+  std::uint64_t length = 0;
+  std::uint64_t scalarsOfElement = 0;
+  for (const auto item : ast.list(ast[init].list)) {
+    if (ast[item].kind == NodeKind::Designation) {
+      const auto first = ast.list(ast[item].list)[0];
+      std::uint64_t designated = 0;
+      if (ast[first].kind == NodeKind::ArrayDesignator &&
+          integerConstant(ast[first].a, &designated)) {
+        index = designated;
+        scalarsOfElement = 0;
+      }
+    }
+    const bool isAggregateItem = ast[item].kind == NodeKind::InitList ||
+                                 ast[item].kind == NodeKind::Designation ||
+                                 types.kind(element) != TypeKind::Array;
+    if (isAggregateItem || ++scalarsOfElement == scalars) {
+      length = std::max(length, index + 1);
+      index++;
+      scalarsOfElement = 0;
+    } else {
+      length = std::max(length, index + 1);
+    }
+  }
+  return types.arrayOf(element, static_cast<std::uint32_t>(length));
+}
+
+void Sema::checkInitList(TypeID target, NodeID list) {
+  if (ast[list].kind != NodeKind::InitList) {
+    checkInitializer(target, list);
+    return;
+  }
+  nodeTypes[list] = target;
+
+  // The members of an aggregate in the order they are initialized, i.e. the
+  // elements of an array or the named members of a struct, the first member
+  // of a union.
+  const auto memberType = [&](TypeID aggregate, std::size_t index,
+                              NodeID* field) -> TypeID {
+    if (types.kind(aggregate) == TypeKind::Array) {
+      const auto& array = types[aggregate];
+      if (array.flags == 0 && index >= array.count) return TypeTable::ERROR;
+      return array.base;
+    }
+    if (!types.isRecord(aggregate)) return TypeTable::ERROR;
+    const auto definition = ast[types[aggregate].count].b;
+    if (definition == 0) return TypeTable::ERROR;
+    std::size_t position = 0;
+    for (const auto member : ast.list(ast[definition].list)) {
+      if (ast[member].name == 0 && ast[member].b != 0) continue;
+      if (position++ == index) {
+        if (field) *field = member;
+        return nodeTypes[member];
+      }
+      if (types.kind(aggregate) == TypeKind::Union) break;
+    }
+    return TypeTable::ERROR;
+  };
+  const auto isAggregate = [&](TypeID type) {
+    return types.kind(type) == TypeKind::Array || types.isRecord(type);
+  };
+
+  // Initialize the aggregate from the items without braces around it
+  // (C99 6.7.8p20), taking as many items as it has scalars.
+  const auto items = ast.list(ast[list].list);
+  std::size_t position = 0;
+  const auto elide = [&](const auto& self, TypeID type) -> void {
+    if (!isAggregate(type)) {
+      checkInitializer(type, items[position++]);
+      return;
+    }
+    for (std::size_t index = 0; position < items.size(); index++) {
+      if (ast[items[position]].kind == NodeKind::Designation) return;
+      const auto member = memberType(type, index, nullptr);
+      if (member == TypeTable::ERROR) return;
+      self(self, member);
+    }
+  };
+
+  std::size_t index = 0;
+  while (position < items.size()) {
+    auto item = items[position];
+    auto type = TypeTable::ERROR;
+
+    if (ast[item].kind == NodeKind::Designation) {
+      type = types.unqualified(target);
+      for (const auto designator : ast.list(ast[item].list)) {
+        if (ast[designator].kind == NodeKind::ArrayDesignator) {
+          std::uint64_t designated = 0;
+          if (!integerConstant(ast[designator].a, &designated)) {
+            report(ErrorID::NotIntegerConstant, ast[designator].a);
+          }
+          if (type == types.unqualified(target)) index = designated;
+          type = types.kind(type) == TypeKind::Array ? types[type].base
+                                                     : TypeTable::ERROR;
+        } else {
+          const auto definition =
+              types.isRecord(type) ? ast[types[type].count].b : 0;
+          const auto field =
+              definition != 0 ? findField(definition, ast[designator].name) : 0;
+          if (field == 0) {
+            report(ErrorID::NoSuchMember, designator,
+                   {typeName(type), strings.view(ast[designator].name)});
+            type = TypeTable::ERROR;
+            break;
+          }
+          if (type == types.unqualified(target)) {
+            // Continue after the designated member.
+            const auto members = ast.list(ast[definition].list);
+            index = 0;
+            for (const auto member : members) {
+              if (member == field) break;
+              if (!(ast[member].name == 0 && ast[member].b != 0)) index++;
+            }
+          }
+          type = nodeTypes[field];
+        }
+      }
+      nodeTypes[item] = type;
+      item = ast[item].b;
+      checkInitializer(type, item);
+      position++;
+      index++;
+      continue;
+    }
+
+    type = memberType(target, index, nullptr);
+    if (type == TypeTable::ERROR) {
+      // Excess initializers are checked against nothing.
+      position++;
+      continue;
+    }
+
+    const auto itemType = nodeTypes[item];
+    const bool takesItem =
+        !isAggregate(type) || ast[item].kind == NodeKind::InitList ||
+        (ast[item].kind == NodeKind::StringLiteral &&
+         types.kind(type) == TypeKind::Array) ||
+        (types.isRecord(type) && types.isCompatible(types.unqualified(itemType),
+                                                    types.unqualified(type)));
+    if (takesItem) {
+      checkInitializer(type, item);
+      position++;
+    } else {
+      elide(elide, type);
+    }
+    index++;
+  }
+}
+
+/* Expressions */
+
+void Sema::checkIntegerLiteral(NodeID id) {
+  const auto spelling = strings.view(ast[id].name);
+  const auto literal = integerLiteralValue(spelling);
+  if (literal.overflows) {
+    report(ErrorID::IntegerLiteralTooLarge, id, {spelling});
+  }
+  values[id] = literal.value;
+  nodeTypes[id] = integerLiteralType(literal);
+}
+
+TypeID Sema::floatingLiteralType(NodeID id) const {
+  const auto spelling = strings.view(ast[id].name);
+  switch (spelling.back()) {
+    case 'f':
+    case 'F': return FLOAT;
+    case 'l':
+    case 'L': return LONG_DOUBLE;
+    default: return DOUBLE;
+  }
+}
+
+TypeID Sema::stringLiteralType(NodeID id) {
+  const auto& node = ast[id];
+  const auto length = strings.view(node.name).size();
+  if (node.flags & NodeFlag::Wide) {
+    return types.arrayOf(INT, static_cast<std::uint32_t>(length / 4 + 1));
+  }
+  return types.arrayOf(CHAR, static_cast<std::uint32_t>(length + 1));
+}
+
+TypeID Sema::identifierType(NodeID id) {
+  const auto decl = ast[id].a;
+  if (decl == 0) {
+    report(ErrorID::UndeclaredIdentifier, id, {strings.view(ast[id].name)});
+    return TypeTable::ERROR;
+  }
+  switch (ast[decl].kind) {
+    case NodeKind::EnumConstantDecl:
+      return INT;
+    case NodeKind::VarDecl:
+    case NodeKind::ParamDecl:
+    case NodeKind::FunctionDecl:
+      return declaredType(decl);
+    default:
+      return TypeTable::ERROR;
+  }
+}
+
+TypeID Sema::unaryType(NodeID id) {
+  const auto& node = ast[id];
+  const auto op = node.oper();
+  const auto operand = node.a;
+  if (nodeTypes[operand] == TypeTable::ERROR) return TypeTable::ERROR;
+
+  TypeID result = TypeTable::ERROR;
+  switch (op) {
+    case Operator::Plus:
+    case Operator::Minus: {
+      const auto type = convertPromoted(operand);
+      if (types.isArithmetic(type)) result = type;
+      break;
+    }
+    case Operator::BitwiseNot: {
+      const auto type = convertPromoted(operand);
+      if (types.isInteger(type)) result = type;
+      break;
+    }
+    case Operator::LogicalNot:
+      if (types.isScalar(convertValue(operand))) result = INT;
+      break;
+    case Operator::Dereference: {
+      const auto type = convertValue(operand);
+      if (types.isPointer(type)) result = types[type].base;
+      break;
+    }
+    case Operator::AddressOf: {
+      const auto type = nodeTypes[operand];
+      if (types.kind(type) != TypeKind::Function && !isLValue(operand)) {
+        report(ErrorID::NotAddressable, id);
+        return TypeTable::ERROR;
+      }
+      return types.pointerTo(type);
+    }
+    case Operator::PreIncrement:
+    case Operator::PreDecrement:
+    case Operator::PostIncrement:
+    case Operator::PostDecrement: {
+      if (!isModifiableLValue(operand)) {
+        report(ErrorID::NotAssignable, operand);
+        return TypeTable::ERROR;
+      }
+      const auto type = convertValue(operand);
+      if (types.isArithmetic(type) ||
+          (types.isPointer(type) && isComplete(types[type].base))) {
+        result = type;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  if (result == TypeTable::ERROR) {
+    const auto spelling =
+        op == Operator::PreIncrement || op == Operator::PostIncrement ? "++"
+        : op == Operator::PreDecrement || op == Operator::PostDecrement
+            ? "--"
+            : operatorSpelling(op);
+    report(ErrorID::InvalidOperand, id,
+           {spelling, typeName(nodeTypes[operand])});
+  }
+  return result;
+}
+
+TypeID Sema::binaryType(NodeID id, Operator op, NodeID left, NodeID right) {
+  const auto leftType = convertValue(left);
+  const auto rightType = convertValue(right);
+  if (leftType == TypeTable::ERROR || rightType == TypeTable::ERROR) {
+    return TypeTable::ERROR;
+  }
+
+  const bool bothArithmetic =
+      types.isArithmetic(leftType) && types.isArithmetic(rightType);
+  const bool bothInteger =
+      types.isInteger(leftType) && types.isInteger(rightType);
+  const auto arithmetic = [&]() {
+    const auto type = usualArithmeticConversion(leftType, rightType);
+    convertedTypes[left] = type;
+    convertedTypes[right] = type;
+    return type;
+  };
+  const auto isObjectPointer = [&](TypeID type) {
+    return types.isPointer(type) &&
+           types.kind(types[type].base) != TypeKind::Function;
+  };
+  const auto haveCompatiblePointees = [&]() {
+    return types.isCompatible(types.unqualified(types[leftType].base),
+                              types.unqualified(types[rightType].base));
+  };
+
+  switch (op) {
+    case Operator::Multiply:
+    case Operator::Divide:
+      if (bothArithmetic) return arithmetic();
+      break;
+    case Operator::Remainder:
+    case Operator::BitwiseAnd:
+    case Operator::BitwiseXor:
+    case Operator::BitwiseOr:
+      if (bothInteger) return arithmetic();
+      break;
+    case Operator::Add:
+      if (bothArithmetic) return arithmetic();
+      if (isObjectPointer(leftType) && types.isInteger(rightType)) {
+        convertPromoted(right);
+        return leftType;
+      }
+      if (types.isInteger(leftType) && isObjectPointer(rightType)) {
+        convertPromoted(left);
+        return rightType;
+      }
+      break;
+    case Operator::Subtract:
+      if (bothArithmetic) return arithmetic();
+      if (isObjectPointer(leftType) && types.isInteger(rightType)) {
+        convertPromoted(right);
+        return leftType;
+      }
+      // The difference of two pointers is a ptrdiff_t.
+      if (isObjectPointer(leftType) && isObjectPointer(rightType) &&
+          haveCompatiblePointees()) {
+        return LONG;
+      }
+      break;
+    case Operator::ShiftLeft:
+    case Operator::ShiftRight:
+      if (bothInteger) {
+        convertPromoted(right);
+        return convertPromoted(left);
+      }
+      break;
+    case Operator::Less:
+    case Operator::Greater:
+    case Operator::LessEqual:
+    case Operator::GreaterEqual:
+      if (bothArithmetic) {
+        arithmetic();
+        return INT;
+      }
+      if (types.isPointer(leftType) && types.isPointer(rightType) &&
+          haveCompatiblePointees()) {
+        return INT;
+      }
+      break;
+    case Operator::Equal:
+    case Operator::NotEqual:
+      if (bothArithmetic) {
+        arithmetic();
+        return INT;
+      }
+      if (types.isPointer(leftType) && types.isPointer(rightType)) {
+        const bool hasVoidPointer =
+            types.kind(types[leftType].base) == TypeKind::Void ||
+            types.kind(types[rightType].base) == TypeKind::Void;
+        if (hasVoidPointer || haveCompatiblePointees()) return INT;
+      }
+      if (types.isPointer(leftType) && isNullPointerConstant(right)) {
+        convertedTypes[right] = leftType;
+        return INT;
+      }
+      if (types.isPointer(rightType) && isNullPointerConstant(left)) {
+        convertedTypes[left] = rightType;
+        return INT;
+      }
+      break;
+    case Operator::LogicalAnd:
+    case Operator::LogicalOr:
+      if (types.isScalar(leftType) && types.isScalar(rightType)) return INT;
+      break;
+    case Operator::Comma:
+      return rightType;
+    default:
+      break;
+  }
+
+  report(ErrorID::InvalidOperands, id,
+         {operatorSpelling(op), typeName(leftType), typeName(rightType)});
+  return TypeTable::ERROR;
+}
+
+TypeID Sema::assignType(NodeID id) {
+  const auto& node = ast[id];
+  const auto target = types.unqualified(nodeTypes[node.a]);
+  if (!isModifiableLValue(node.a)) {
+    report(ErrorID::NotAssignable, node.a);
+    return TypeTable::ERROR;
+  }
+
+  if (node.oper() == Operator::None) {
+    convertAsIfByAssignment(node.b, target);
+    return target;
+  }
+
+  // The result of the operation is converted back to the type of the left
+  // operand.
+  const auto result = binaryType(id, node.oper(), node.a, node.b);
+  if (result == TypeTable::ERROR) return TypeTable::ERROR;
+  return target;
+}
+
+TypeID Sema::conditionalType(NodeID id) {
+  const auto& node = ast[id];
+  checkScalar(node.a);
+  const auto thenType = convertValue(node.b);
+  const auto elseType = convertValue(node.c);
+  if (thenType == TypeTable::ERROR || elseType == TypeTable::ERROR) {
+    return TypeTable::ERROR;
+  }
+
+  if (types.isArithmetic(thenType) && types.isArithmetic(elseType)) {
+    const auto type = usualArithmeticConversion(thenType, elseType);
+    convertedTypes[node.b] = type;
+    convertedTypes[node.c] = type;
+    return type;
+  }
+  if (thenType == VOID && elseType == VOID) return VOID;
+  if (types.isRecord(thenType) && types.isCompatible(thenType, elseType)) {
+    return thenType;
+  }
+  if (types.isPointer(thenType) && types.isPointer(elseType)) {
+    const auto thenPointee = types[thenType].base;
+    const auto elsePointee = types[elseType].base;
+    if (types.kind(thenPointee) == TypeKind::Void) return thenType;
+    if (types.kind(elsePointee) == TypeKind::Void) return elseType;
+    if (types.isCompatible(types.unqualified(thenPointee),
+                           types.unqualified(elsePointee))) {
+      // The pointee has the qualifiers of both.
+      return types.pointerTo(types.qualified(
+          thenPointee, types[elsePointee].qualifiers));
+    }
+  }
+  if (types.isPointer(thenType) && isNullPointerConstant(node.c)) {
+    return convertedTypes[node.c] = thenType;
+  }
+  if (types.isPointer(elseType) && isNullPointerConstant(node.b)) {
+    return convertedTypes[node.b] = elseType;
+  }
+
+  report(ErrorID::InvalidOperands, id,
+         {"?:", typeName(thenType), typeName(elseType)});
+  return TypeTable::ERROR;
+}
+
+TypeID Sema::castType(NodeID id) {
+  const auto& node = ast[id];
+  const auto target = types.unqualified(nodeTypes[node.a]);
+  const auto operand = convertValue(node.b);
+  if (target == VOID) return VOID;
+  if (target == TypeTable::ERROR || operand == TypeTable::ERROR) {
+    return TypeTable::ERROR;
+  }
+
+  // Pointers can't be converted from and to floating types.
+  const bool isValid =
+      types.isScalar(target) && types.isScalar(operand) &&
+      !(types.isPointer(target) && types.isFloating(operand)) &&
+      !(types.isFloating(target) && types.isPointer(operand));
+  if (!isValid) {
+    report(ErrorID::InvalidOperand, id, {"cast", typeName(operand)});
+    return TypeTable::ERROR;
+  }
+  convertedTypes[node.b] = target;
+  return target;
+}
+
+TypeID Sema::callType(NodeID id) {
+  const auto& node = ast[id];
+  const auto arguments = ast.list(node.list);
+  const auto callee = convertValue(node.a);
+  if (callee == TypeTable::ERROR) {
+    for (const auto argument : arguments) convertValue(argument);
+    return TypeTable::ERROR;
+  }
+  if (!types.isPointer(callee) ||
+      types.kind(types[callee].base) != TypeKind::Function) {
+    report(ErrorID::NotCallable, id, {typeName(callee)});
+    return TypeTable::ERROR;
+  }
+
+  const auto function = types[callee].base;
+  const auto& type = types[function];
+  if (type.flags & TypeFlag::NoPrototype) {
+    for (const auto argument : arguments) convertArgument(argument);
+    return type.base;
+  }
+
+  const auto params = types.params(function);
+  const bool isVariadic = type.flags & TypeFlag::Variadic;
+  if (arguments.size() < params.size() ||
+      (arguments.size() > params.size() && !isVariadic)) {
+    report(ErrorID::ArgumentCountMismatch, id,
+           {std::to_string(params.size()), std::to_string(arguments.size())});
+  }
+  for (std::size_t i = 0; i < arguments.size(); i++) {
+    if (i < params.size()) {
+      convertAsIfByAssignment(arguments[i], params[i]);
+    } else {
+      convertArgument(arguments[i]);
+    }
+  }
+  return type.base;
+}
+
+TypeID Sema::subscriptType(NodeID id) {
+  const auto& node = ast[id];
+  const auto base = convertValue(node.a);
+  const auto index = convertValue(node.b);
+  if (base == TypeTable::ERROR || index == TypeTable::ERROR) {
+    return TypeTable::ERROR;
+  }
+
+  // a[i] is *(a + i), so the operands can be either way around.
+  if (types.isPointer(base) && types.isInteger(index)) {
+    convertPromoted(node.b);
+    return types[base].base;
+  }
+  if (types.isInteger(base) && types.isPointer(index)) {
+    convertPromoted(node.a);
+    return types[index].base;
+  }
+  report(ErrorID::InvalidOperands, id, {"[]", typeName(base), typeName(index)});
+  return TypeTable::ERROR;
+}
+
+TypeID Sema::memberType(NodeID id) {
+  const auto& node = ast[id];
+  auto object = nodeTypes[node.a];
+  if (object == TypeTable::ERROR) return TypeTable::ERROR;
+
+  const bool isArrow = node.flags & NodeFlag::Arrow;
+  if (isArrow) {
+    const auto pointer = convertValue(node.a);
+    object = types.isPointer(pointer) ? types[pointer].base : TypeTable::ERROR;
+  }
+  if (!types.isRecord(object)) {
+    report(ErrorID::InvalidOperand, id,
+           {isArrow ? "->" : ".", typeName(nodeTypes[node.a])});
+    return TypeTable::ERROR;
+  }
+
+  const auto definition = ast[types[object].count].b;
+  if (definition == 0) {
+    report(ErrorID::IncompleteType, id, {typeName(object)});
+    return TypeTable::ERROR;
+  }
+  const auto field = findField(definition, node.name);
+  if (field == 0) {
+    report(ErrorID::NoSuchMember, id,
+           {typeName(types.unqualified(object)), strings.view(node.name)});
+    return TypeTable::ERROR;
+  }
+  values[id] = field;
+  // A member of a const struct is const too.
+  return types.qualified(nodeTypes[field], types[object].qualifiers);
+}
+
+TypeID Sema::sizeofType(NodeID id, TypeID type) {
+  if (type == TypeTable::ERROR) return UNSIGNED_LONG;
+  if (!isComplete(type)) {
+    report(ErrorID::IncompleteType, id, {typeName(type)});
+  }
+  values[id] = sizeOf(type);
+  return UNSIGNED_LONG;
+}
+
+// Find the member of a struct or union, looking into its anonymous members
+// too.
+NodeID Sema::findField(NodeID definition, StringID name) const {
+  for (const auto member : ast.list(ast[definition].list)) {
+    const auto& node = ast[member];
+    if (node.name == name && name != 0) return member;
+    if (node.name == 0 && node.b == 0 && types.isRecord(nodeTypes[member])) {
+      const auto inner = ast[types[nodeTypes[member]].count].b;
+      if (inner == 0) continue;
+      if (const auto found = findField(inner, name)) return found;
+    }
+  }
+  return 0;
+}
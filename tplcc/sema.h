@@ -0,0 +1,155 @@
+#ifndef TPLCC_SEMA_H
+#define TPLCC_SEMA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "constant-evaluator.h"
+#include "error.h"
+#include "string-interner.h"
+#include "types.h"
+
+// Semantic analysis of a parsed translation unit. It gives every expression
+// its type, applies the implicit conversions of C, lays out structs and
+// unions and reports the constraint violations the parser can't see.
+//
+// The AST isn't changed, the results are kept in side tables indexed by
+// NodeID:
+//
+// typeOf           the type of an expression (qualified if it is an lvalue),
+//                  the type a type node denotes, or the declared type of a
+//                  declaration (a ParamDecl's type is already adjusted, so an
+//                  array parameter is a pointer)
+// convertedTypeOf  the type the value of an expression is converted to where
+//                  it is used: arrays and functions decay to pointers, and
+//                  operands go through the integer promotions, the usual
+//                  arithmetic conversions or the conversion as if by
+//                  assignment
+// valueOf          IntegerLiteral, CharacterLiteral, EnumConstantDecl: value
+//                  SizeofExpr, SizeofType: the size in bytes
+//                  FieldDecl: offset in bits from the start of the record
+//                  Member: the FieldDecl it refers to
+//
+// Since the nodes are in post-order (see ast.h), check() is one linear walk
+// over the node array: when a node is visited its children already have
+// their types. The few checks that need a parent's context (initializers and
+// return statements) are done when the DeclGroup, CompoundLiteral or
+// FunctionDef is reached.
+//
+// The checker expects a tree without syntax errors, the nodes the parser has
+// abandoned while recovering from an error are still in the array.
+class Sema {
+ public:
+  struct RecordLayout {
+    std::uint64_t size = 0;
+    std::uint32_t align = 1;
+  };
+
+ private:
+  const AST& ast;
+  const StringInterner& strings;
+  TypeTable& types;
+  IReportError& errOut;
+
+  std::vector<TypeID> nodeTypes;
+  std::vector<TypeID> convertedTypes;
+  std::vector<std::uint64_t> values;
+
+  // Layouts of the defined structs and unions, by their RecordDefinition.
+  std::unordered_map<NodeID, RecordLayout> layouts;
+
+  // Only a cache of values, so the const checks can fill it.
+  mutable ConstantEvaluator constants;
+
+  // The return statements of the function being checked.
+  std::vector<NodeID> returns;
+  NodeID previousEnumerator = 0;
+
+ public:
+  Sema(const AST& ast, const StringInterner& strings, TypeTable& types,
+       IReportError& errOut);
+
+  void check();
+
+  TypeID typeOf(NodeID id) const { return nodeTypes[id]; }
+  TypeID convertedTypeOf(NodeID id) const { return convertedTypes[id]; }
+  std::uint64_t valueOf(NodeID id) const { return values[id]; }
+
+  const TypeTable& typeTable() const { return types; }
+
+  // The value of an integer constant expression in the type of the
+  // expression, nothing if it isn't one, see ConstantEvaluator.
+  std::optional<IntegerValue> integerConstantValue(NodeID id) const {
+    return constants.evaluate(id);
+  }
+
+  // Sizes and alignments on x86-64 Linux, in bytes. Incomplete types have a
+  // size of 0.
+  std::uint64_t sizeOf(TypeID type) const;
+  std::uint32_t alignOf(TypeID type) const;
+  bool isComplete(TypeID type) const;
+  const RecordLayout* layoutOf(TypeID record) const;
+
+  // The integer promotions and the usual arithmetic conversions (C99
+  // 6.3.1.1, 6.3.1.8).
+  TypeID promote(TypeID type) const;
+  TypeID usualArithmeticConversion(TypeID a, TypeID b) const;
+
+ private:
+  void visit(NodeID id);
+
+  // Types and declarations
+  TypeID builtinType(const Node& node) const;
+  TypeID arrayType(NodeID id);
+  TypeID functionType(NodeID id);
+  TypeID parameterType(NodeID param) const;
+  TypeID declaredType(NodeID decl) const;
+  void checkEnumConstant(NodeID id);
+  void layOutRecord(NodeID definition);
+  void checkDeclGroup(NodeID id);
+  void checkFunctionDefinition(NodeID id);
+
+  // Initializers
+  TypeID checkInitializer(TypeID target, NodeID init);
+  void checkInitList(TypeID target, NodeID list);
+  TypeID completeArrayType(TypeID array, NodeID init);
+
+  // Expressions
+  void checkIntegerLiteral(NodeID id);
+  TypeID floatingLiteralType(NodeID id) const;
+  TypeID stringLiteralType(NodeID id);
+  TypeID identifierType(NodeID id);
+  TypeID unaryType(NodeID id);
+  TypeID binaryType(NodeID id, Operator op, NodeID left, NodeID right);
+  TypeID assignType(NodeID id);
+  TypeID conditionalType(NodeID id);
+  TypeID castType(NodeID id);
+  TypeID callType(NodeID id);
+  TypeID subscriptType(NodeID id);
+  TypeID memberType(NodeID id);
+  TypeID sizeofType(NodeID id, TypeID type);
+
+  // Conversions of an operand. Each of them records the converted type and
+  // returns it.
+  TypeID convertValue(NodeID id);
+  TypeID convertPromoted(NodeID id);
+  bool convertAsIfByAssignment(NodeID id, TypeID target);
+  TypeID convertArgument(NodeID id);
+
+  bool isLValue(NodeID id) const;
+  bool isModifiableLValue(NodeID id) const;
+  bool isNullPointerConstant(NodeID id) const;
+  bool checkScalar(NodeID id);
+  bool integerConstant(NodeID id, std::uint64_t* value) const;
+  NodeID findField(NodeID definition, StringID name) const;
+
+  void report(ErrorID id, NodeID node,
+              std::initializer_list<std::string_view> arguments = {});
+  std::string typeName(TypeID type) const;
+};
+
+#endif
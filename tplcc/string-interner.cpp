@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <cstring>
+
+#include "string-interner.h"
+
+StringInterner::StringInterner(const StringInterner* base)
+    : base(base),
+      baseSize(base != nullptr ? static_cast<StringID>(base->size()) : 0) {
+  if (base != nullptr) return;
+  strings.push_back(std::string_view());
+  ids.emplace(std::string_view(), 0);
+}
+
+StringID StringInterner::intern(std::string_view str) {
+  if (base != nullptr) {
+    if (const auto id = base->find(str)) return *id;
+  }
+  if (const auto it = ids.find(str); it != ids.end()) return it->second;
+
+  const auto stored = copyToBlock(str);
+  const auto id = static_cast<StringID>(size());
+  strings.push_back(stored);
+  ids.emplace(stored, id);
+  return id;
+}
+
+const StringID* StringInterner::find(std::string_view str) const {
+  if (base != nullptr) {
+    if (const auto id = base->find(str)) return id;
+  }
+  const auto it = ids.find(str);
+  return it == ids.end() ? nullptr : &it->second;
+}
+
+std::string_view StringInterner::copyToBlock(std::string_view str) {
+  if (str.size() > spaceLeftInBlock) {
+    const auto blockSize = std::max(BLOCK_SIZE, str.size());
+    blocks.push_back(std::unique_ptr<char[]>(new char[blockSize]));
+    blockCursor = blocks.back().get();
+    spaceLeftInBlock = blockSize;
+  }
+
+  std::memcpy(blockCursor, str.data(), str.size());
+  const std::string_view stored(blockCursor, str.size());
+  blockCursor += str.size();
+  spaceLeftInBlock -= str.size();
+  return stored;
+}
+
+void WarmStrings::learn(const StringInterner& interner) {
+  std::vector<std::string> added;
+  for (auto id = interner.firstOwnID(); id < interner.size(); id++) {
+    added.emplace_back(interner.view(id));
+  }
+  std::lock_guard lock(mutex);
+  for (auto& str : added) learned.push_back(std::move(str));
+}
+
+void WarmStrings::update(std::size_t maxStrings) {
+  if (strings->size() + learned.size() > maxStrings) {
+    strings = std::make_unique<StringInterner>();
+  }
+  for (const auto& str : learned) {
+    if (strings->size() >= maxStrings) break;
+    strings->intern(str);
+  }
+  learned.clear();
+}
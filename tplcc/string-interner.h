@@ -0,0 +1,79 @@
+#ifndef TPLCC_STRING_INTERNER_H
+#define TPLCC_STRING_INTERNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using StringID = std::uint32_t;
+
+// Stores every distinct string once and hands out small integer IDs for
+// them, so identifiers and literal spellings can be kept in AST nodes and
+// compared as integers. The characters live in large blocks that are never
+// moved, so a view returned by view() stays valid as long as the interner.
+// ID 0 is always the empty string.
+//
+// An interner can be put on top of a base interner, which is only read: the
+// strings of the base keep their IDs and the new ones get the IDs after
+// them. The base must not change as long as the interner on top is used.
+class StringInterner {
+  static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  std::size_t spaceLeftInBlock = 0;
+  char* blockCursor = nullptr;
+
+  const StringInterner* base;
+  // The number of strings in the base, the ID of the first string of this
+  // interner's own.
+  StringID baseSize;
+  std::vector<std::string_view> strings;
+  std::unordered_map<std::string_view, StringID> ids;
+
+ public:
+  explicit StringInterner(const StringInterner* base = nullptr);
+  StringInterner(const StringInterner&) = delete;
+  StringInterner& operator=(const StringInterner&) = delete;
+
+  StringID intern(std::string_view str);
+
+  // The ID of the string if it has been interned before.
+  const StringID* find(std::string_view str) const;
+
+  std::string_view view(StringID id) const {
+    return id < baseSize ? base->view(id) : strings[id - baseSize];
+  }
+  std::size_t size() const { return baseSize + strings.size(); }
+  StringID firstOwnID() const { return baseSize; }
+
+ private:
+  std::string_view copyToBlock(std::string_view str);
+};
+
+// The strings of earlier compilations, the base of the interners of the
+// next ones, e.g. the identifiers of the headers every file includes. The
+// compilations, any number at the same time, hand the strings they added in
+// to learn, which keeps them until update adds them to the base, when no
+// compilation is running.
+class WarmStrings {
+  std::unique_ptr<StringInterner> strings = std::make_unique<StringInterner>();
+  std::mutex mutex;  // guards `learned`.
+  std::vector<std::string> learned;
+
+ public:
+  const StringInterner& base() const { return *strings; }
+
+  // Keep the strings the interner added on top of the base. Thread-safe.
+  void learn(const StringInterner& interner);
+  // Add the strings learned to the base. Not while it is used. A base that
+  // would have more than maxStrings starts over with the strings learned
+  // last, the older ones are learned again when they are seen again.
+  void update(std::size_t maxStrings);
+};
+
+#endif
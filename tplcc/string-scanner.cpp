@@ -0,0 +1,8 @@
+#include "string-scanner.h"
+
+std::string StringScanner::peekN(std::size_t n) {
+  std::string output(input.substr(cursor, n));
+  // Pad with EOF like the other scanners, so callers can index the result.
+  output.resize(n, static_cast<char>(EOF));
+  return output;
+}
@@ -0,0 +1,38 @@
+#ifndef TPLCC_STRING_SCANNER_H
+#define TPLCC_STRING_SCANNER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "Lexer.h"
+
+// Feeds the lexer from text that is already in memory, e.g. the output of
+// the preprocessor. The text is not copied, it has to outlive the scanner.
+class StringScanner : public ILexerScanner {
+  std::string_view input;
+  std::size_t cursor = 0;
+
+ public:
+  explicit StringScanner(std::string_view input) : input(input) {}
+
+  int get() override {
+    return reachedEndOfInput() ? EOF
+                               : static_cast<unsigned char>(input[cursor++]);
+  }
+  int peek() const override {
+    return reachedEndOfInput() ? EOF : static_cast<unsigned char>(input[cursor]);
+  }
+  bool reachedEndOfInput() const override { return cursor >= input.size(); }
+
+  std::string peekN(std::size_t n) override;
+  void ignore() override { cursor = cursor < input.size() ? cursor + 1 : cursor; }
+  void ignoreN(std::size_t n) override {
+    cursor = n < input.size() - cursor ? cursor + n : input.size();
+  }
+  std::uint32_t offset() override { return static_cast<std::uint32_t>(cursor); }
+};
+
+#endif
@@ -0,0 +1,37 @@
+#include "symbol-table.h"
+
+void SymbolTable::exitScope() {
+  const auto start = scopeStarts.back();
+  scopeStarts.pop_back();
+
+  while (undoLog.size() > start) {
+    const auto& shadowed = undoLog.back();
+    if (shadowed.binding.decl == 0) {
+      bindings.erase(shadowed.name);
+    } else {
+      bindings[shadowed.name] = shadowed.binding;
+    }
+    undoLog.pop_back();
+  }
+}
+
+NodeID SymbolTable::declare(StringID name, NodeID decl) {
+  const auto currentDepth = static_cast<std::uint32_t>(depth());
+  auto [it, isNew] = bindings.try_emplace(name, Binding{decl, currentDepth});
+  if (isNew) {
+    // Names declared in the file scope stay until the table is destroyed.
+    if (currentDepth > 1) undoLog.push_back({name, {}});
+    return 0;
+  }
+
+  auto& binding = it->second;
+  if (binding.depth == currentDepth) {
+    const auto previous = binding.decl;
+    binding.decl = decl;
+    return previous;
+  }
+
+  undoLog.push_back({name, binding});
+  binding = {decl, currentDepth};
+  return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef TPLCC_SYMBOL_TABLE_H
+#define TPLCC_SYMBOL_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "string-interner.h"
+
+// Maps names to the declarations they refer to at the current point of a
+// translation unit. All scopes share one hash map that only holds the
+// innermost visible declaration of each name. Declaring a name that shadows
+// an outer one writes the outer binding to an undo log, and leaving a scope
+// replays the log back to where the scope started. So lookups are a single
+// hash lookup however deep the scopes are nested, and leaving a scope costs
+// as much as the declarations it had.
+class SymbolTable {
+  struct Binding {
+    NodeID decl = 0;
+    std::uint32_t depth = 0;
+  };
+
+  struct Shadowed {
+    StringID name;
+    Binding binding;
+  };
+
+  std::unordered_map<StringID, Binding> bindings;
+  std::vector<Shadowed> undoLog;
+  std::vector<std::size_t> scopeStarts;
+
+ public:
+  // The table starts with the file scope entered.
+  SymbolTable() { scopeStarts.push_back(0); }
+
+  void enterScope() { scopeStarts.push_back(undoLog.size()); }
+  void exitScope();
+
+  // Number of scopes entered, 1 for the file scope.
+  std::size_t depth() const { return scopeStarts.size(); }
+
+  // Declare the name in the current scope. If it has been declared in the
+  // current scope already, the new declaration replaces the old one and the
+  // old one is returned, otherwise it returns 0.
+  NodeID declare(StringID name, NodeID decl);
+
+  // The innermost visible declaration of the name, 0 if there is none.
+  NodeID lookup(StringID name) const {
+    const auto it = bindings.find(name);
+    return it == bindings.end() ? 0 : it->second.decl;
+  }
+
+  // The declaration of the name in the current scope, 0 if there is none.
+  NodeID lookupInCurrentScope(StringID name) const {
+    const auto it = bindings.find(name);
+    return it == bindings.end() || it->second.depth != depth() ? 0
+                                                               : it->second.decl;
+  }
+
+  void reserve(std::size_t numberOfNames) { bindings.reserve(numberOfNames); }
+};
+
+#endif
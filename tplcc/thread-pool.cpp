@@ -0,0 +1,158 @@
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <utility>
+
+namespace {
+// The pool the current thread works for and the index of its queue, so
+// submit and wait know which queue is the thread's own.
+struct CurrentWorker {
+  const ThreadPool* pool = nullptr;
+  std::size_t queueIndex = 0;
+};
+
+thread_local CurrentWorker currentWorker;
+}  // namespace
+
+ThreadPool::ThreadPool(std::size_t numberOfWorkers) {
+  queues.reserve(numberOfWorkers + 1);
+  for (std::size_t i = 0; i <= numberOfWorkers; i++) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  threads.reserve(numberOfWorkers);
+  for (std::size_t i = 1; i <= numberOfWorkers; i++) {
+    threads.emplace_back([this, i] { work(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(sleepMutex);
+    isShuttingDown = true;
+  }
+  wakeUp.notify_all();
+  for (auto& thread : threads) thread.join();
+  // Without workers, nobody else would run what is left.
+  while (auto task = take(0)) execute(*task);
+}
+
+void ThreadPool::submit(TaskGroup& group, std::function<void()> task) {
+  group.pending.fetch_add(1, std::memory_order_relaxed);
+  group.queued.fetch_add(1, std::memory_order_relaxed);
+  auto& queue = *queues[queueOfThisThread()];
+  {
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back({std::move(task), &group});
+  }
+  numberOfQueuedTasks.fetch_add(1, std::memory_order_release);
+  {
+    // Taking the lock orders this with a worker about to sleep, which
+    // checks the number of queued tasks under it.
+    std::lock_guard lock(sleepMutex);
+  }
+  wakeUp.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+  const auto queueIndex = queueOfThisThread();
+  while (group.pending.load(std::memory_order_acquire) != 0) {
+    if (auto task = take(queueIndex, &group)) {
+      execute(*task);
+      continue;
+    }
+    // The rest of the group is running on other threads. The timeout only
+    // guards against a missed wake up, the last task of a group notifies.
+    std::unique_lock lock(sleepMutex);
+    wakeUp.wait_for(lock, std::chrono::milliseconds(10), [&] {
+      return group.pending.load(std::memory_order_acquire) == 0 ||
+             group.queued.load(std::memory_order_acquire) != 0;
+    });
+  }
+}
+
+void ThreadPool::work(std::size_t queueIndex) {
+  currentWorker = {this, queueIndex};
+  for (;;) {
+    if (auto task = take(queueIndex)) {
+      execute(*task);
+      continue;
+    }
+    std::unique_lock lock(sleepMutex);
+    wakeUp.wait(lock, [&] {
+      return isShuttingDown ||
+             numberOfQueuedTasks.load(std::memory_order_acquire) != 0;
+    });
+    if (isShuttingDown &&
+        numberOfQueuedTasks.load(std::memory_order_acquire) == 0) {
+      return;
+    }
+  }
+}
+
+std::size_t ThreadPool::queueOfThisThread() const {
+  return currentWorker.pool == this ? currentWorker.queueIndex : 0;
+}
+
+std::optional<ThreadPool::Task> ThreadPool::take(std::size_t queueIndex,
+                                                 const TaskGroup* group) {
+  const auto& queued = group != nullptr ? group->queued : numberOfQueuedTasks;
+  if (queued.load(std::memory_order_acquire) == 0) return std::nullopt;
+  auto takeFrom = [&](std::size_t index, bool isOwn) -> std::optional<Task> {
+    auto& queue = *queues[index];
+    std::lock_guard lock(queue.mutex);
+    auto isTaken = [&](const Task& task) {
+      return group == nullptr || task.group == group;
+    };
+    // Outside threads take the oldest of their queue, so a pool without
+    // workers runs the tasks in the order they were submitted.
+    const bool takesNewest = isOwn && index != 0;
+    auto chosen = queue.tasks.end();
+    if (takesNewest) {
+      const auto newest =
+          std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), isTaken);
+      if (newest != queue.tasks.rend()) chosen = std::prev(newest.base());
+    } else {
+      chosen = std::find_if(queue.tasks.begin(), queue.tasks.end(), isTaken);
+    }
+    if (chosen == queue.tasks.end()) return std::nullopt;
+    Task task = std::move(*chosen);
+    queue.tasks.erase(chosen);
+    numberOfQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+    task.group->queued.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+  };
+
+  if (auto task = takeFrom(queueIndex, true)) return task;
+  for (std::size_t i = 1; i < queues.size(); i++) {
+    if (auto task = takeFrom((queueIndex + i) % queues.size(), false)) {
+      return task;
+    }
+  }
+  return std::nullopt;
+}
+
+void ThreadPool::execute(Task& task) {
+  task.run();
+  if (task.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // Whoever waits for the group may be asleep.
+    {
+      std::lock_guard lock(sleepMutex);
+    }
+    wakeUp.notify_all();
+  }
+}
+
+void parallelFor(ThreadPool* pool, std::size_t count,
+                 const std::function<void(std::size_t)>& task) {
+  if (pool == nullptr || count < 2) {
+    for (std::size_t i = 0; i < count; i++) task(i);
+    return;
+  }
+  ThreadPool::TaskGroup group;
+  for (std::size_t i = 0; i < count; i++) {
+    pool->submit(group, [&task, i] { task(i); });
+  }
+  pool->wait(group);
+}
@@ -0,0 +1,101 @@
+#ifndef TPLCC_THREAD_POOL_H
+#define TPLCC_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// A work-stealing pool of threads to compile translation units, or the
+// functions of one, at the same time.
+//
+// Every worker has a queue of its own. A task submitted by a worker goes to
+// the back of its queue and the worker takes its next task from the back
+// too, so nested work stays on the thread whose caches it is warm in. A
+// worker that runs out of tasks steals from the front of the others'
+// queues, taking the oldest, usually biggest, pieces of work. Tasks
+// submitted from outside the pool go to a queue of their own, which the
+// workers steal from as well.
+//
+// A thread waiting for a task group runs the queued tasks of the group until
+// it is done instead of blocking, so a task can wait for the tasks it
+// submitted without tying up a worker, and a pool without workers runs
+// every task on the waiting thread, in the order they were submitted. It
+// runs no tasks of other groups, a file waiting for its functions doesn't
+// compile another file on its stack meanwhile.
+class ThreadPool {
+ public:
+  // Tasks that are waited for together.
+  class TaskGroup {
+    friend class ThreadPool;
+    std::atomic<std::size_t> pending{0};
+    // Of the pending tasks, the ones no thread has taken yet.
+    std::atomic<std::size_t> queued{0};
+
+   public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+  };
+
+ private:
+  struct Task {
+    std::function<void()> run;
+    TaskGroup* group;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // queues[0] is for the threads that aren't workers, queues[i] for the
+  // worker threads[i - 1].
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+
+  // Workers with nothing to do, and waiters whose groups aren't done, sleep
+  // on this until a task is queued or a group finishes.
+  std::mutex sleepMutex;
+  std::condition_variable wakeUp;
+  std::atomic<std::size_t> numberOfQueuedTasks{0};
+  bool isShuttingDown = false;
+
+ public:
+  // Starts numberOfWorkers threads. With none, tasks run when waited for.
+  explicit ThreadPool(std::size_t numberOfWorkers);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  // Waits for the tasks already queued, then stops the workers.
+  ~ThreadPool();
+
+  std::size_t numberOfWorkers() const { return threads.size(); }
+
+  // Queue a task of the group. It must not throw.
+  void submit(TaskGroup& group, std::function<void()> task);
+
+  // Run queued tasks of the group until every task of it is done.
+  void wait(TaskGroup& group);
+
+ private:
+  void work(std::size_t queueIndex);
+  std::size_t queueOfThisThread() const;
+  // A task of the group, of any group if it is nullptr.
+  std::optional<Task> take(std::size_t queueIndex,
+                           const TaskGroup* group = nullptr);
+  void execute(Task& task);
+};
+
+// Run task(i) for every i below count on the pool's threads and this one,
+// and wait for all of them. Without a pool, they run on this thread in
+// order.
+void parallelFor(ThreadPool* pool, std::size_t count,
+                 const std::function<void(std::size_t)>& task);
+
+#endif
@@ -0,0 +1,93 @@
+#include "time-report.h"
+
+#include <cstdio>
+
+namespace {
+constexpr const char* PHASE_NAMES[NUMBER_OF_PHASES] = {
+    "read", "preprocess", "lex", "parse", "sema", "codegen"};
+
+void printRow(std::ostream& os, const char* name, double milliseconds,
+              const AllocationCount& allocated) {
+  char row[96];
+  std::snprintf(row, sizeof(row), "  %-10s %11.3f %14llu %12llu\n", name,
+                milliseconds,
+                static_cast<unsigned long long>(allocated.bytes),
+                static_cast<unsigned long long>(allocated.allocations));
+  os << row;
+}
+}  // namespace
+
+TimeReport::Scope::Scope(TimeReport* report, Phase phase)
+    : report(report), phase(phase) {
+  if (report == nullptr) return;
+  outer = report->innermost;
+  report->innermost = this;
+  allocatedBefore = report->allocationsSoFar();
+  start = std::chrono::steady_clock::now();
+}
+
+TimeReport::Scope::~Scope() {
+  if (report == nullptr) return;
+  const auto end = std::chrono::steady_clock::now();
+  const auto allocatedAfter = report->allocationsSoFar();
+  auto& entry = report->entries[static_cast<std::size_t>(phase)];
+  entry.time += end - start;
+  entry.allocated.bytes += allocatedAfter.bytes - allocatedBefore.bytes;
+  entry.allocated.allocations +=
+      allocatedAfter.allocations - allocatedBefore.allocations;
+  entry.hasRun = true;
+
+  report->innermost = outer;
+  if (outer != nullptr) {
+    auto& outerEntry = report->entries[static_cast<std::size_t>(outer->phase)];
+    outerEntry.time -= end - start;
+    outerEntry.allocated.bytes -= allocatedAfter.bytes - allocatedBefore.bytes;
+    outerEntry.allocated.allocations -=
+        allocatedAfter.allocations - allocatedBefore.allocations;
+  }
+}
+
+TimeReport::HelperScope::HelperScope(TimeReport* report, Phase phase)
+    : report(report), phase(phase) {
+  if (report == nullptr) return;
+  // The phase's Scope counts these.
+  if (report->owner == std::this_thread::get_id()) {
+    this->report = nullptr;
+    return;
+  }
+  allocatedBefore = report->allocationsSoFar();
+}
+
+TimeReport::HelperScope::~HelperScope() {
+  if (report == nullptr) return;
+  const auto allocatedAfter = report->allocationsSoFar();
+  const auto index = static_cast<std::size_t>(phase);
+  report->helperBytes[index].fetch_add(
+      allocatedAfter.bytes - allocatedBefore.bytes, std::memory_order_relaxed);
+  report->helperAllocations[index].fetch_add(
+      allocatedAfter.allocations - allocatedBefore.allocations,
+      std::memory_order_relaxed);
+}
+
+void TimeReport::print(std::ostream& os, std::string_view filename) const {
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  os << "Time report for " << filename << ":\n"
+     << "  phase        wall (ms)  allocated (B)  allocations\n";
+  std::chrono::steady_clock::duration totalTime{};
+  AllocationCount total;
+  for (std::size_t phase = 0; phase < NUMBER_OF_PHASES; phase++) {
+    const auto& entry = entries[phase];
+    if (!entry.hasRun) continue;
+    auto allocated = entry.allocated;
+    allocated.bytes += helperBytes[phase].load(std::memory_order_relaxed);
+    allocated.allocations +=
+        helperAllocations[phase].load(std::memory_order_relaxed);
+    printRow(os, PHASE_NAMES[phase], Milliseconds(entry.time).count(),
+             allocated);
+    totalTime += entry.time;
+    total.bytes += allocated.bytes;
+    total.allocations += allocated.allocations;
+  }
+  printRow(os, "total", Milliseconds(totalTime).count(), total);
+}
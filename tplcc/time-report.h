@@ -0,0 +1,116 @@
+#ifndef TPLCC_TIME_REPORT_H
+#define TPLCC_TIME_REPORT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <thread>
+
+// The phases of compiling a file, in the order they run.
+enum class Phase : std::uint8_t {
+  Read,
+  Preprocess,
+  // The tokens the parser reads, measured token by token, which is left
+  // out of Parse.
+  Lex,
+  Parse,
+  Sema,
+  // Lowering, the IR passes, instruction selection, register allocation and
+  // writing the output.
+  Codegen
+};
+
+constexpr std::size_t NUMBER_OF_PHASES = 6;
+
+struct AllocationCount {
+  std::uint64_t bytes = 0;
+  std::uint64_t allocations = 0;
+};
+
+// Where the time and the memory of a compilation go, what -ftime-report
+// prints: the wall time, the bytes allocated and the number of allocations
+// of every phase.
+//
+// The allocations are counted by whoever replaces operator new (the driver
+// does), by thread, the report only takes the difference of the counts
+// before and after each phase. Without a counter they are left out.
+class TimeReport {
+ public:
+  using CountAllocations = AllocationCount (*)();
+
+ private:
+  struct Entry {
+    std::chrono::steady_clock::duration time{};
+    AllocationCount allocated;
+    bool hasRun = false;
+  };
+
+  CountAllocations countAllocations;
+  // The thread the Scopes measure on.
+  std::thread::id owner;
+  Entry entries[NUMBER_OF_PHASES];
+  // Allocated by the threads helping with a phase, see HelperScope.
+  std::atomic<std::uint64_t> helperBytes[NUMBER_OF_PHASES] = {};
+  std::atomic<std::uint64_t> helperAllocations[NUMBER_OF_PHASES] = {};
+
+ public:
+  explicit TimeReport(CountAllocations countAllocations = nullptr)
+      : countAllocations(countAllocations),
+        owner(std::this_thread::get_id()) {}
+
+  // Measures a phase from its construction to its destruction, adding to
+  // what has been measured for the phase before. A Scope made while another
+  // one measures takes its time and allocations out of the other one's
+  // phase. Measures nothing if the report is nullptr.
+  class Scope {
+    TimeReport* report;
+    Phase phase;
+    Scope* outer = nullptr;
+    std::chrono::steady_clock::time_point start;
+    AllocationCount allocatedBefore;
+
+   public:
+    Scope(TimeReport* report, Phase phase);
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope();
+  };
+
+  // Counts the allocations of a part of a phase that a thread pool may run
+  // on another thread than the one the report was made on, which the
+  // phase's Scope measures. Its time is part of the phase's wall time
+  // already. Any number of them can measure at the same time. Measures
+  // nothing on the report's own thread or if the report is nullptr.
+  class HelperScope {
+    TimeReport* report;
+    Phase phase;
+    AllocationCount allocatedBefore;
+
+   public:
+    HelperScope(TimeReport* report, Phase phase);
+    HelperScope(const HelperScope&) = delete;
+    HelperScope& operator=(const HelperScope&) = delete;
+    ~HelperScope();
+  };
+
+  // A table with a row per phase that has run and their total, e.g.
+  //
+  // Time report for foo.c:
+  //   phase        wall (ms)  allocated (B)  allocations
+  //   read             0.021           8312            4
+  //   ...
+  void print(std::ostream& os, std::string_view filename) const;
+
+ private:
+  // The Scope measuring now, the others are outside it.
+  Scope* innermost = nullptr;
+
+  AllocationCount allocationsSoFar() const {
+    return countAllocations != nullptr ? countAllocations() : AllocationCount{};
+  }
+};
+
+#endif
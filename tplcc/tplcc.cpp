@@ -3,11 +3,780 @@
 
 #include "tplcc.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "assembly-writer.h"
+#include "buffered-writer.h"
+#include "code-buffer.h"
+#include "compile-server.h"
+#include "compilation.h"
+#include "concurrent-error-sink.h"
+#include "error.h"
+#include "function-cache.h"
+#include "include-files.h"
+#include "jit.h"
+#include "object-writer.h"
+#include "preprocessor.h"
+#include "result-cache.h"
+#include "string-interner.h"
+#include "thread-pool.h"
+#include "time-report.h"
+
 using namespace std;
 
-int main()
+namespace {
+// Counted by thread: a file is compiled on one thread, so its report doesn't
+// count the allocations of the files compiled next to it.
+thread_local uint64_t allocatedBytes = 0;
+thread_local uint64_t numberOfAllocations = 0;
+// Only with -ftime-report, set before any file is compiled.
+atomic<bool> countsAllocations{false};
+
+AllocationCount countAllocations()
+{
+	return {allocatedBytes, numberOfAllocations};
+}
+}  // namespace
+
+// Counted for -ftime-report. new[] and the nothrow forms end up here too,
+// the aligned forms don't and aren't counted.
+void* operator new(size_t size)
+{
+	if (countsAllocations.load(memory_order_relaxed)) {
+		numberOfAllocations++;
+		allocatedBytes += size;
+	}
+	if (void* memory = malloc(size != 0 ? size : 1)) return memory;
+	throw bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+namespace {
+const char USAGE[] =
+	"Usage: tplcc [options] file...\n"
+	"       tplcc [options] --run file [arguments...]\n"
+	"       tplcc --server <socket>\n"
+	"       tplcc --client <socket> [options] file...\n"
+	"       tplcc --stop-server <socket>\n"
+	"\n"
+	"  -E              Preprocess only, to standard output or -o\n"
+	"  -S              Compile to assembly, file.s for every file.c\n"
+	"  -c              Compile to an object, file.o for every file.c\n"
+	"  -o <file>       Write the output of the only file to <file>, to\n"
+	"                  standard output if it is -\n"
+	"  -I <dir>        Look for included files in <dir>\n"
+	"  -D <name>[=<body>]\n"
+	"                  Define a macro, as 1 if there is no body\n"
+	"  -O0             Don't optimize\n"
+	"  -j <n>          Compile on <n> threads, files and their functions at\n"
+	"                  the same time\n"
+	"  -ftime-report   Print the time and allocations of every phase\n"
+	"  -ferror-limit=<n>\n"
+	"                  Stop reporting errors of a file after <n>, 0 for no\n"
+	"                  limit\n"
+	"  -fdiagnostics-format=<format>\n"
+	"                  Print errors as text, json (a JSON object on every\n"
+	"                  line) or sarif (a SARIF log for every file)\n"
+	"  --cache <dir>   Keep the outputs of -S and -c in <dir> and take them\n"
+	"                  from there for files preprocessed the same way again,\n"
+	"                  and the code of their functions for files that\n"
+	"                  changed\n"
+	"  --cache-stats   Print the hits, misses and time saved of the cache, after\n"
+	"                  compiling if there are files\n"
+	"  --run <file>    Compile the file and run its main in this process\n"
+	"  --server <socket>\n"
+	"                  Run the command lines sent to <socket>, keeping the\n"
+	"                  files read, the strings seen and the code of the\n"
+	"                  functions compiled from one to the next, so only\n"
+	"                  the functions that changed are compiled again\n"
+	"  --client <socket>\n"
+	"                  Have the server at <socket> run the command line\n"
+	"  --stop-server <socket>\n"
+	"                  Stop the server at <socket>\n";
+
+enum class Action { None, Preprocess, Assemble, Compile, Run };
+
+struct DriverOptions {
+	Action action = Action::None;
+	string outputFile;
+	vector<string> inputFiles;
+	vector<string> includeDirectories;
+	vector<string> macros;
+	bool optimize = true;
+	bool reportsTime = false;
+	// Of every file, 0 for no limit.
+	size_t errorLimit = 0;
+	DiagnosticFormat diagnosticFormat = DiagnosticFormat::Text;
+	size_t numberOfJobs = 1;
+	bool showsHelp = false;
+	string cacheDirectory;
+	bool printsCacheStatistics = false;
+	// The file given to --run and the arguments after it.
+	vector<string> runArguments;
+};
+
+// The arguments come without the program name. Returns false, after
+// saying why, if the command line can't be taken.
+bool parseCommandLine(const vector<string>& arguments, DriverOptions& options,
+                      ostream& output, ostream& diagnostics)
+{
+	const auto argc = arguments.size();
+	auto setAction = [&](Action action) {
+		if (options.action != Action::None && options.action != action) {
+			diagnostics << "tplcc: only one of -E, -S, -c and --run can be "
+			               "given"
+			            << endl;
+			return false;
+		}
+		options.action = action;
+		return true;
+	};
+	// The value of an option, glued to it ("-Idir") or the next argument.
+	auto valueOf = [&](size_t& i, string_view option, string& value) {
+		const string_view argument = arguments[i];
+		if (argument.size() > option.size()) {
+			value = argument.substr(option.size());
+			return true;
+		}
+		if (i + 1 == argc) {
+			diagnostics << "tplcc: " << option << " needs a value" << endl;
+			return false;
+		}
+		value = arguments[++i];
+		return true;
+	};
+
+	for (size_t i = 0; i < argc; i++) {
+		const string_view argument = arguments[i];
+		string value;
+		if (argument == "-E" || argument == "-S" || argument == "-c") {
+			const auto action = argument == "-E"   ? Action::Preprocess
+			                    : argument == "-S" ? Action::Assemble
+			                                       : Action::Compile;
+			if (!setAction(action)) return false;
+		} else if (argument == "--run") {
+			if (!setAction(Action::Run)) return false;
+			if (i + 1 == argc) {
+				diagnostics << "tplcc: --run needs a file" << endl;
+				return false;
+			}
+			options.inputFiles.push_back(arguments[++i]);
+			// argv[0] of the program is the file.
+			options.runArguments.assign(arguments.begin() + i,
+			                            arguments.end());
+			break;
+		} else if (argument.starts_with("-o")) {
+			if (!valueOf(i, "-o", options.outputFile)) return false;
+		} else if (argument.starts_with("-I")) {
+			if (!valueOf(i, "-I", value)) return false;
+			options.includeDirectories.push_back(std::move(value));
+		} else if (argument.starts_with("-D")) {
+			if (!valueOf(i, "-D", value)) return false;
+			options.macros.push_back(std::move(value));
+		} else if (argument.starts_with("-j")) {
+			if (!valueOf(i, "-j", value)) return false;
+			const auto jobs = strtoul(value.c_str(), nullptr, 10);
+			if (jobs == 0) {
+				diagnostics << "tplcc: -j needs a positive number of jobs"
+				            << endl;
+				return false;
+			}
+			options.numberOfJobs = jobs;
+		} else if (argument == "-O0") {
+			options.optimize = false;
+		} else if (argument.starts_with("-O")) {
+			options.optimize = true;
+		} else if (argument == "-ftime-report") {
+			options.reportsTime = true;
+		} else if (argument.starts_with("-ferror-limit=")) {
+			value = argument.substr(argument.find('=') + 1);
+			char* end = nullptr;
+			options.errorLimit = strtoul(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0') {
+				diagnostics << "tplcc: -ferror-limit= needs a number" << endl;
+				return false;
+			}
+		} else if (argument.starts_with("-fdiagnostics-format=")) {
+			value = argument.substr(argument.find('=') + 1);
+			if (value == "text") {
+				options.diagnosticFormat = DiagnosticFormat::Text;
+			} else if (value == "json") {
+				options.diagnosticFormat = DiagnosticFormat::JSONLines;
+			} else if (value == "sarif") {
+				options.diagnosticFormat = DiagnosticFormat::SARIF;
+			} else {
+				diagnostics << "tplcc: unknown diagnostics format " << value
+				            << ", give text, json or sarif" << endl;
+				return false;
+			}
+		} else if (argument == "--cache") {
+			if (!valueOf(i, "--cache", options.cacheDirectory)) return false;
+		} else if (argument == "--cache-stats") {
+			options.printsCacheStatistics = true;
+		} else if (argument == "-h" || argument == "--help") {
+			output << USAGE;
+			options.showsHelp = true;
+			return true;
+		} else if (argument.size() > 1 && argument[0] == '-') {
+			diagnostics << "tplcc: unknown option " << argument << endl;
+			return false;
+		} else {
+			options.inputFiles.emplace_back(argument);
+		}
+	}
+
+	if (options.printsCacheStatistics && options.cacheDirectory.empty()) {
+		diagnostics << "tplcc: --cache-stats needs --cache" << endl;
+		return false;
+	}
+	// Only the statistics.
+	if (options.printsCacheStatistics && options.inputFiles.empty() &&
+	    options.action == Action::None) {
+		return true;
+	}
+	if (options.inputFiles.empty() || options.action == Action::None) {
+		if (options.action == Action::None && !options.inputFiles.empty()) {
+			diagnostics << "tplcc: linking isn't supported, give -E, -S, -c "
+			               "or --run"
+			            << endl;
+		}
+		diagnostics << USAGE;
+		return false;
+	}
+	if (!options.outputFile.empty() && options.inputFiles.size() > 1) {
+		diagnostics << "tplcc: -o can't be given for more than one file"
+		            << endl;
+		return false;
+	}
+	return true;
+}
+
+// file.c -> file.o in the current directory, like other compilers do.
+string outputFileOf(const string& inputFile, string_view extension)
+{
+	const auto separator = inputFile.find_last_of("/\\");
+	string name = inputFile.substr(
+		separator == string::npos ? 0 : separator + 1);
+	const auto dot = name.rfind('.');
+	if (dot != string::npos && dot != 0) name.resize(dot);
+	return name + string(extension);
+}
+
+// The output file of every input, or nullopt, after saying why, if two of
+// them would be written to the same file.
+optional<vector<string>> outputFilesOf(const DriverOptions& options,
+                                       ostream& diagnostics)
+{
+	vector<string> outputFiles;
+	if (options.action == Action::Preprocess && options.outputFile.empty()) {
+		outputFiles.resize(options.inputFiles.size());
+		return outputFiles;
+	}
+	for (const auto& inputFile : options.inputFiles) {
+		auto outputFile = !options.outputFile.empty()
+			? options.outputFile
+			: outputFileOf(inputFile,
+			               options.action == Action::Assemble ? ".s" : ".o");
+		for (size_t i = 0; i < outputFiles.size(); i++) {
+			if (outputFiles[i] == outputFile) {
+				diagnostics << "tplcc: " << options.inputFiles[i] << " and "
+				            << inputFile << " would both be written to "
+				            << outputFile << endl;
+				return nullopt;
+			}
+		}
+		outputFiles.push_back(std::move(outputFile));
+	}
+	return outputFiles;
+}
+
+// What is the same for every file of the command line, built before and
+// then only read by the threads compiling the files, apart from the file
+// cache, which is thread-safe. The server keeps it for all the command
+// lines it runs.
+struct SharedCaches {
+	// Source files and headers, a header is read once for all files. It is
+	// still preprocessed by every file including it, what it expands to
+	// depends on the macros defined before.
+	FileCache files;
+	// The tables of the -D macros of the command lines, by their -D options.
+	map<vector<string>, MacroTable> macroTables;
+	// The strings of the command lines before, nullptr if they aren't kept.
+	WarmStrings* strings = nullptr;
+	// The code of the functions compiled before, nullptr if it isn't kept.
+	FunctionCache* functions = nullptr;
+
+	const MacroTable& macrosOf(const vector<string>& macros)
+	{
+		auto it = macroTables.find(macros);
+		if (it == macroTables.end()) {
+			it = macroTables.emplace(macros, macroTableOf(macros)).first;
+		}
+		return it->second;
+	}
+};
+
+// What compiling a file prints, held back until the files before it have
+// printed theirs, so the output doesn't depend on which file finishes
+// first.
+struct FileResult {
+	bool hasSucceeded = false;
+	string output;
+	string diagnostics;
+	ResultCache::Statistics cacheStatistics;
+};
+
+using Clock = chrono::steady_clock;
+
+double secondsSince(Clock::time_point start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// The running compiler, so the outputs of another build of it aren't taken
+// from the cache: when this file was compiled and, where the executable can
+// be found, its size and time. The executable also changes when only other
+// files of the compiler do.
+const string& compilerIdentity()
 {
-	cout << "Hello CMake." << endl;
+	static const string identity = [] {
+		const string identity = __DATE__ " " __TIME__;
+		error_code error;
+		const filesystem::path executable =
+			filesystem::read_symlink("/proc/self/exe", error);
+		if (error) return identity;
+		const auto size = filesystem::file_size(executable, error);
+		if (error) return identity;
+		const auto modified = filesystem::last_write_time(executable, error);
+		if (error) return identity;
+		return identity + " " + to_string(size) + " " +
+		       to_string(modified.time_since_epoch().count());
+	}();
+	return identity;
+}
+
+// Looking up the output of a file in the result cache, and storing it if it
+// isn't there.
+struct CacheLookup {
+	const ResultCache& cache;
+	ContentHash key{};
+	// Compiling is skipped if the output is found.
+	optional<ResultCache::Entry> found{};
+	Clock::time_point lookupStart{};
+	Clock::time_point compileStart{};
+};
+
+// What else than the preprocessed text decides the output. -j doesn't.
+string cacheOptionsOf(const DriverOptions& options)
+{
+	string cacheOptions = options.action == Action::Assemble ? "-S" : "-c";
+	cacheOptions += options.optimize ? " -O" : " -O0";
+	return cacheOptions + " " + compilerIdentity();
+}
+
+// Read and preprocess a file, then compile it unless only preprocessing,
+// or its output is found in the cache, if there is a lookup.
+bool translate(const string& path, const DriverOptions& options,
+               SharedCaches& caches, ThreadPool* pool, TimeReport* report,
+               PreprocessedText& text, CompiledModule& compiled,
+               ostream& diagnostics, CacheLookup* lookup = nullptr)
+{
+	const FileCache::File* file = nullptr;
+	{
+		TimeReport::Scope scope(report, Phase::Read);
+		file = caches.files.read(path);
+		if (file == nullptr) {
+			diagnostics << "tplcc: can't read " << path << endl;
+			return false;
+		}
+	}
+
+	CodeBuffer source(file->content);
+	IncludeFiles includeFiles(path, options.includeDirectories, caches.files);
+	CompileOptions compileOptions;
+	compileOptions.optimize = options.optimize;
+	compileOptions.predefinedMacroTable =
+		&caches.macroTables.at(options.macros);
+	compileOptions.includeFiles = &includeFiles;
+	compileOptions.timeReport = report;
+	compileOptions.pool = pool;
+	compileOptions.warmStrings = caches.strings;
+	compileOptions.functionCache = caches.functions;
+
+	ErrorReporter errOut(path, source, options.diagnosticFormat, diagnostics,
+	                     options.errorLimit);
+	// With a pool, parts of the file are compiled on other threads, so the
+	// errors go to the sink, which gives them to errOut in the order of a
+	// serial run.
+	ConcurrentErrorSink sink(source, options.errorLimit);
+	IReportError& errors =
+		pool != nullptr ? static_cast<IReportError&>(sink) : errOut;
+	bool hasSucceeded = preprocess(source, text, errors, compileOptions);
+	if (hasSucceeded && options.action != Action::Preprocess) {
+		if (lookup != nullptr) {
+			lookup->lookupStart = Clock::now();
+			lookup->key =
+				ResultCache::keyOf(text.text, cacheOptionsOf(options));
+			lookup->found = lookup->cache.find(lookup->key);
+			lookup->compileStart = Clock::now();
+		}
+		if (lookup == nullptr || !lookup->found) {
+			hasSucceeded = compile(text, compiled, errors, compileOptions);
+		}
+	}
+	sink.mergeInto(errOut);
+	errOut.outputErrorMessagesTo(diagnostics);
+	errOut.finish();
+	return hasSucceeded;
+}
+
+// Write what the file compiled to, or the output the lookup found, and
+// store it in the cache if the lookup didn't find it.
+bool writeOutput(const string& outputFile, const DriverOptions& options,
+                 const PreprocessedText& text, const CompiledModule& compiled,
+                 ThreadPool* pool, TimeReport* report, ostream& output,
+                 ostream& diagnostics, CacheLookup* lookup = nullptr)
+{
+	if (outputFile.empty()) {
+		output << text.text << '\n';
+		return true;
+	}
+
+	auto writeCompiled = [&](BufferedWriter& out) {
+		if (options.action == Action::Assemble) {
+			writeAssembly(compiled.module, compiled.functions, out);
+		} else {
+			writeObject(compiled.module, compiled.functions, out, pool,
+			            report);
+		}
+	};
+	const auto& path = outputFile;
+	// -o - is the standard output.
+	const bool isStandardOutput = path == "-";
+	ofstream file;
+	if (!isStandardOutput) file.open(path, ios::binary);
+	ostream& stream = isStandardOutput ? output : file;
+	{
+		BufferedWriter out(stream);
+		if (options.action == Action::Preprocess) {
+			out.write(text.text).put('\n');
+		} else if (lookup != nullptr && lookup->found) {
+			out.write(lookup->found->output);
+		} else if (lookup != nullptr) {
+			ostringstream rendered;
+			{
+				BufferedWriter renderedOut(rendered, 1 << 20);
+				writeCompiled(renderedOut);
+			}
+			ResultCache::Entry entry;
+			entry.output = std::move(rendered).str();
+			entry.compileSeconds = secondsSince(lookup->compileStart);
+			out.write(entry.output);
+			lookup->cache.store(lookup->key, entry);
+		} else {
+			writeCompiled(out);
+		}
+	}
+	if (!stream) {
+		diagnostics << "tplcc: can't write " << path << endl;
+		return false;
+	}
+	return true;
+}
+
+// The functions of the file are compiled on the pool's threads if there is
+// a pool. Its output is looked up in the cache if there is one.
+FileResult compileFile(const string& path, const string& outputFile,
+                       const DriverOptions& options, SharedCaches& caches,
+                       ThreadPool* pool, const ResultCache* cache)
+{
+	TimeReport report(countAllocations);
+	TimeReport* const timeReport = options.reportsTime ? &report : nullptr;
+	PreprocessedText text;
+	CompiledModule compiled;
+	ostringstream output;
+	ostringstream diagnostics;
+	FileResult result;
+	optional<CacheLookup> lookup;
+	if (cache != nullptr && options.action != Action::Preprocess) {
+		lookup.emplace(CacheLookup{*cache});
+	}
+	CacheLookup* const cacheLookup = lookup ? &*lookup : nullptr;
+	result.hasSucceeded = translate(path, options, caches, pool, timeReport,
+	                                text, compiled, diagnostics, cacheLookup);
+	if (result.hasSucceeded) {
+		// Writing the output is the end of code generation.
+		const auto phase = options.action == Action::Preprocess
+			? Phase::Preprocess
+			: Phase::Codegen;
+		TimeReport::Scope scope(timeReport, phase);
+		result.hasSucceeded = writeOutput(outputFile, options, text, compiled,
+		                                  pool, timeReport, output,
+		                                  diagnostics, cacheLookup);
+	}
+	// A file that doesn't compile is neither.
+	if (result.hasSucceeded && lookup && lookup->found) {
+		result.cacheStatistics.hits = 1;
+		result.cacheStatistics.savedSeconds =
+			lookup->found->compileSeconds - secondsSince(lookup->lookupStart);
+	} else if (result.hasSucceeded && lookup) {
+		result.cacheStatistics.misses = 1;
+	}
+	if (timeReport != nullptr) report.print(diagnostics, path);
+	result.output = std::move(output).str();
+	result.diagnostics = std::move(diagnostics).str();
+	return result;
+}
+
+// Prints the results of the files in the order of the command line, each
+// as soon as it and the ones before it are done.
+class OrderedOutput {
+	mutex printing;
+	vector<optional<FileResult>> results;
+	size_t numberPrinted = 0;
+	ostream& output;
+	ostream& diagnostics;
+
+public:
+	OrderedOutput(size_t numberOfFiles, ostream& output, ostream& diagnostics)
+		: results(numberOfFiles), output(output), diagnostics(diagnostics)
+	{
+	}
+
+	void finish(size_t file, FileResult result)
+	{
+		lock_guard lock(printing);
+		results[file] = std::move(result);
+		for (; numberPrinted < results.size() && results[numberPrinted];
+		     numberPrinted++) {
+			output << results[numberPrinted]->output << flush;
+			diagnostics << results[numberPrinted]->diagnostics << flush;
+			results[numberPrinted]->output.clear();
+			results[numberPrinted]->diagnostics.clear();
+		}
+	}
+
+	bool hasFailed() const
+	{
+		for (const auto& result : results) {
+			if (!result || !result->hasSucceeded) return true;
+		}
+		return false;
+	}
+
+	ResultCache::Statistics cacheStatistics() const
+	{
+		ResultCache::Statistics statistics;
+		for (const auto& result : results) {
+			if (result) statistics += result->cacheStatistics;
+		}
+		return statistics;
+	}
+};
+
+// Compile the file and run its main in this process, with the file name as
+// argv[0] and the arguments after it. The exit code is the one main
+// returns.
+int run(const DriverOptions& options)
+{
+	countsAllocations = options.reportsTime;
+	const auto& path = options.inputFiles[0];
+	TimeReport report(countAllocations);
+	TimeReport* const timeReport = options.reportsTime ? &report : nullptr;
+	SharedCaches caches;
+	caches.macrosOf(options.macros);
+	PreprocessedText text;
+	CompiledModule compiled;
+	if (!translate(path, options, caches, nullptr, timeReport, text, compiled,
+	               cerr)) {
+		return 1;
+	}
+	if (timeReport != nullptr) report.print(cerr, path);
+
+	LoadedModule loaded;
+	string problem;
+	if (!loaded.load(compiled.module, compiled.functions, &problem)) {
+		cerr << "tplcc: " << problem << endl;
+		return 1;
+	}
+	if (loaded.address("main") == nullptr) {
+		cerr << "tplcc: " << path << " doesn't define main" << endl;
+		return 1;
+	}
+	vector<char*> argv;
+	for (const auto& argument : options.runArguments) {
+		argv.push_back(const_cast<char*>(argument.c_str()));
+	}
+	const auto argc = static_cast<int>(argv.size());
+	argv.push_back(nullptr);
+	const int exitCode = loaded.runMain(argc, argv.data());
+	fflush(stdout);
+	return exitCode;
+}
+// Compile the files of the command line, printing to output and
+// diagnostics. Returns the exit code.
+int compileFiles(const DriverOptions& options, SharedCaches& caches,
+                 ostream& output, ostream& diagnostics)
+{
+	if (!options.cacheDirectory.empty() && compilerIdentity().empty()) {
+		diagnostics << "tplcc: can't tell which build of the compiler this "
+		               "is, so --cache isn't used"
+		            << endl;
+	}
+	optional<ResultCache> cache;
+	if (!options.cacheDirectory.empty() && !compilerIdentity().empty()) {
+		cache.emplace(options.cacheDirectory);
+	}
+	if (options.inputFiles.empty()) {
+		if (!cache) return 1;
+		printStatistics(output, options.cacheDirectory, cache->statistics());
+		return 0;
+	}
+
+	const auto outputFiles = outputFilesOf(options, diagnostics);
+	if (!outputFiles) return 1;
+
+	countsAllocations = options.reportsTime;
+	caches.macrosOf(options.macros);
+	// The code of the functions goes to the cache too, so a file that
+	// changed only compiles the functions that did. The server has a
+	// function cache of its own, which then uses the cache as well.
+	optional<FunctionCache> functionCache;
+	FunctionCache* const functionsBefore = caches.functions;
+	if (cache) {
+		if (caches.functions == nullptr) {
+			caches.functions = &functionCache.emplace();
+		}
+		caches.functions->persistIn(&*cache, compilerIdentity());
+	}
+	const auto& inputFiles = options.inputFiles;
+	OrderedOutput ordered(inputFiles.size(), output, diagnostics);
+	{
+		// This thread compiles too while it waits. The functions of a file
+		// are tasks of their own, so the threads have work even if there
+		// are fewer files than threads.
+		ThreadPool pool(options.numberOfJobs - 1);
+		ThreadPool* const functions =
+			options.numberOfJobs > 1 ? &pool : nullptr;
+		ThreadPool::TaskGroup files;
+		for (size_t i = 0; i < inputFiles.size(); i++) {
+			pool.submit(files, [&, i] {
+				ordered.finish(i, compileFile(inputFiles[i], (*outputFiles)[i],
+				                              options, caches, functions,
+				                              cache ? &*cache : nullptr));
+			});
+		}
+		pool.wait(files);
+	}
+	if (cache) {
+		caches.functions->persistIn(nullptr, "");
+		caches.functions = functionsBefore;
+		cache->addToStatistics(ordered.cacheStatistics());
+		if (options.printsCacheStatistics) {
+			printStatistics(diagnostics, options.cacheDirectory,
+			                cache->statistics());
+		}
+	}
+	return ordered.hasFailed() ? 1 : 0;
+}
+
+// The server keeps the code of this many functions, the most recently
+// compiled, or found, ones.
+constexpr size_t MAX_CACHED_FUNCTIONS = 1 << 16;
+// And this many strings, see WarmStrings::update.
+constexpr size_t MAX_WARM_STRINGS = 1 << 20;
+
+// Run the command lines of the clients until one stops the server, with
+// the caches of the ones before. Returns the exit code of the server.
+int runServer(const string& socketPath)
+{
+	SharedCaches caches;
+	WarmStrings strings;
+	caches.strings = &strings;
+	FunctionCache functions;
+	caches.functions = &functions;
+	auto handle = [&](const vector<string>& arguments, ostream& output,
+	                  ostream& diagnostics) {
+		DriverOptions options;
+		if (!parseCommandLine(arguments, options, output, diagnostics)) {
+			return 1;
+		}
+		if (options.showsHelp) return 0;
+		if (options.action == Action::Run) {
+			// The program would run in the server, printing to its output.
+			diagnostics << "tplcc: the server doesn't --run programs" << endl;
+			return 1;
+		}
+		// Nothing compiles between two command lines.
+		caches.files.forgetChangedFiles();
+		strings.update(MAX_WARM_STRINGS);
+		functions.trim(MAX_CACHED_FUNCTIONS);
+		return compileFiles(options, caches, output, diagnostics);
+	};
+	string problem;
+	if (!serve(socketPath, handle, &problem)) {
+		cerr << "tplcc: " << problem << endl;
+		return 1;
+	}
 	return 0;
 }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+	vector<string> arguments(argv + 1, argv + argc);
+	// The server options come first, --client forwards the rest.
+	const string first = arguments.empty() ? "" : arguments[0];
+	if (first == "--server" || first == "--client" ||
+	    first == "--stop-server") {
+		if (arguments.size() < 2) {
+			cerr << "tplcc: " << first << " needs a socket" << endl;
+			return 1;
+		}
+		const auto socketPath = arguments[1];
+		if (first == "--server") return runServer(socketPath);
+		string problem;
+		if (first == "--stop-server") {
+			if (stopServer(socketPath, &problem)) return 0;
+			cerr << "tplcc: " << problem << endl;
+			return 1;
+		}
+		arguments.erase(arguments.begin(), arguments.begin() + 2);
+		if (const auto exitCode =
+		        runOnServer(socketPath, arguments, cout, cerr, &problem)) {
+			return *exitCode;
+		}
+		cerr << "tplcc: " << problem << endl;
+		return 1;
+	}
 
+	DriverOptions options;
+	if (!parseCommandLine(arguments, options, cout, cerr)) return 1;
+	if (options.showsHelp) return 0;
+	if (options.action == Action::Run) return run(options);
+	SharedCaches caches;
+	return compileFiles(options, caches, cout, cerr);
+}
@@ -0,0 +1,315 @@
+#include "types.h"
+
+#include <algorithm>
+
+namespace {
+std::uint64_t mix(std::uint64_t hash, std::uint64_t value) {
+  // The 64-bit FNV-1a prime, applied to whole words.
+  return (hash ^ value) * 0x100000001b3ULL;
+}
+
+const char* builtinSpelling(TypeKind kind) {
+  switch (kind) {
+    case TypeKind::Error: return "<error>";
+    case TypeKind::Void: return "void";
+    case TypeKind::Bool: return "_Bool";
+    case TypeKind::Char: return "char";
+    case TypeKind::SignedChar: return "signed char";
+    case TypeKind::UnsignedChar: return "unsigned char";
+    case TypeKind::Short: return "short";
+    case TypeKind::UnsignedShort: return "unsigned short";
+    case TypeKind::Int: return "int";
+    case TypeKind::UnsignedInt: return "unsigned int";
+    case TypeKind::Long: return "long";
+    case TypeKind::UnsignedLong: return "unsigned long";
+    case TypeKind::LongLong: return "long long";
+    case TypeKind::UnsignedLongLong: return "unsigned long long";
+    case TypeKind::Float: return "float";
+    case TypeKind::Double: return "double";
+    case TypeKind::LongDouble: return "long double";
+    case TypeKind::Struct: return "struct";
+    case TypeKind::Union: return "union";
+    case TypeKind::Enum: return "enum";
+    default: return "";
+  }
+}
+
+std::string qualifierSpelling(std::uint8_t qualifiers) {
+  std::string output;
+  if (qualifiers & TypeQualifier::Const) output += "const ";
+  if (qualifiers & TypeQualifier::Volatile) output += "volatile ";
+  if (qualifiers & TypeQualifier::Restrict) output += "restrict ";
+  return output;
+}
+}  // namespace
+
+TypeTable::TypeTable() {
+  for (auto kind = TypeKind::Error; kind <= TypeKind::LongDouble;
+       kind = static_cast<TypeKind>(static_cast<int>(kind) + 1)) {
+    Type type;
+    type.kind = kind;
+    intern(type);
+  }
+}
+
+TypeID TypeTable::pointerTo(TypeID pointee) {
+  Type type;
+  type.kind = TypeKind::Pointer;
+  type.base = pointee;
+  return intern(type);
+}
+
+TypeID TypeTable::arrayOf(TypeID element, std::uint32_t length,
+                          std::uint16_t flags) {
+  Type type;
+  type.kind = TypeKind::Array;
+  type.base = element;
+  type.count = (flags & (TypeFlag::Incomplete | TypeFlag::VariableLength))
+                   ? 0
+                   : length;
+  type.flags = flags;
+  return intern(type);
+}
+
+TypeID TypeTable::function(TypeID result, std::span<const TypeID> params,
+                           std::uint16_t flags) {
+  Type type;
+  type.kind = TypeKind::Function;
+  type.base = result;
+  type.flags = flags;
+  return intern(type, params);
+}
+
+TypeID TypeTable::tagged(TypeKind kind, NodeID decl, StringID tag) {
+  Type type;
+  type.kind = kind;
+  type.count = decl;
+  type.first = tag;
+  return intern(type);
+}
+
+TypeID TypeTable::qualified(TypeID id, std::uint8_t qualifiers) {
+  if ((types[id].qualifiers | qualifiers) == types[id].qualifiers) return id;
+
+  // Qualifying an array qualifies its elements (C99 6.7.3p8).
+  if (types[id].kind == TypeKind::Array) {
+    const auto element = qualified(types[id].base, qualifiers);
+    return arrayOf(element, types[id].count, types[id].flags);
+  }
+
+  Type type = types[id];
+  type.qualifiers |= qualifiers;
+  if (type.kind == TypeKind::Function) {
+    return intern(type, params(id));
+  }
+  return intern(type);
+}
+
+std::uint64_t TypeTable::hash(const Type& type,
+                              std::span<const TypeID> params) const {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  hash = mix(hash, static_cast<std::uint64_t>(type.kind) |
+                       static_cast<std::uint64_t>(type.qualifiers) << 8 |
+                       static_cast<std::uint64_t>(type.flags) << 16);
+  hash = mix(hash, type.base);
+  hash = mix(hash, type.count);
+  for (const auto param : params) hash = mix(hash, param);
+  return hash;
+}
+
+TypeID TypeTable::intern(const Type& type, std::span<const TypeID> params) {
+  const auto key = hash(type, params);
+  const auto [begin, end] = index.equal_range(key);
+  for (auto it = begin; it != end; it++) {
+    const auto& candidate = types[it->second];
+    if (candidate.kind == type.kind && candidate.qualifiers == type.qualifiers &&
+        candidate.flags == type.flags && candidate.base == type.base &&
+        candidate.count == type.count &&
+        std::ranges::equal(this->params(it->second), params)) {
+      return it->second;
+    }
+  }
+
+  // The unqualified version is interned first, so it always has a smaller ID
+  // than its qualified versions.
+  TypeID unqualifiedID = 0;
+  if (type.qualifiers != 0) {
+    Type bare = type;
+    bare.qualifiers = 0;
+    unqualifiedID = intern(bare, params);
+  }
+
+  const auto id = static_cast<TypeID>(types.size());
+  Type stored = type;
+  stored.unqualified = type.qualifiers == 0 ? id : unqualifiedID;
+  if (type.kind == TypeKind::Function) {
+    stored.first = static_cast<std::uint32_t>(parameters.size());
+    stored.size = static_cast<std::uint32_t>(params.size());
+    parameters.insert(parameters.end(), params.begin(), params.end());
+  }
+  types.push_back(stored);
+  index.emplace(key, id);
+  return id;
+}
+
+bool TypeTable::isInteger(TypeID type) const {
+  const auto k = kind(type);
+  return (k >= TypeKind::Bool && k <= TypeKind::UnsignedLongLong) ||
+         k == TypeKind::Enum;
+}
+
+bool TypeTable::isSigned(TypeID type) const {
+  switch (kind(type)) {
+    // char is signed on x86-64.
+    case TypeKind::Char:
+    case TypeKind::SignedChar:
+    case TypeKind::Short:
+    case TypeKind::Int:
+    case TypeKind::Long:
+    case TypeKind::LongLong:
+    case TypeKind::Enum:
+      return true;
+    default:
+      return isFloating(type);
+  }
+}
+
+bool TypeTable::isFloating(TypeID type) const {
+  const auto k = kind(type);
+  return k >= TypeKind::Float && k <= TypeKind::LongDouble;
+}
+
+bool TypeTable::isArithmetic(TypeID type) const {
+  return isInteger(type) || isFloating(type);
+}
+
+bool TypeTable::isScalar(TypeID type) const {
+  return isArithmetic(type) || isPointer(type);
+}
+
+int TypeTable::rank(TypeID type) const {
+  switch (kind(type)) {
+    case TypeKind::Bool: return 1;
+    case TypeKind::Char:
+    case TypeKind::SignedChar:
+    case TypeKind::UnsignedChar: return 2;
+    case TypeKind::Short:
+    case TypeKind::UnsignedShort: return 3;
+    case TypeKind::Int:
+    case TypeKind::UnsignedInt:
+    case TypeKind::Enum: return 4;
+    case TypeKind::Long:
+    case TypeKind::UnsignedLong: return 5;
+    case TypeKind::LongLong:
+    case TypeKind::UnsignedLongLong: return 6;
+    default: return 0;
+  }
+}
+
+bool TypeTable::isCompatible(TypeID a, TypeID b) const {
+  if (a == b) return true;
+  const auto& ta = types[a];
+  const auto& tb = types[b];
+  if (ta.kind == TypeKind::Error || tb.kind == TypeKind::Error) return true;
+  if (ta.qualifiers != tb.qualifiers) return false;
+
+  if (ta.kind != tb.kind) {
+    // Enums are represented as int.
+    const auto isEnumAndInt = [](const Type& x, const Type& y) {
+      return x.kind == TypeKind::Enum && y.kind == TypeKind::Int;
+    };
+    return isEnumAndInt(ta, tb) || isEnumAndInt(tb, ta);
+  }
+
+  switch (ta.kind) {
+    case TypeKind::Pointer:
+      return isCompatible(ta.base, tb.base);
+    case TypeKind::Array:
+      if (!isCompatible(ta.base, tb.base)) return false;
+      return ta.flags != 0 || tb.flags != 0 || ta.count == tb.count;
+    case TypeKind::Function:
+      return isCompatibleFunction(ta, tb);
+    default:
+      // Arithmetic types are unique, records and enums are the same type
+      // only if they are declared by the same node.
+      return false;
+  }
+}
+
+bool TypeTable::isCompatibleFunction(const Type& a, const Type& b) const {
+  if (!isCompatible(a.base, b.base)) return false;
+  if ((a.flags & TypeFlag::NoPrototype) || (b.flags & TypeFlag::NoPrototype)) {
+    return true;
+  }
+  if ((a.flags & TypeFlag::Variadic) != (b.flags & TypeFlag::Variadic) ||
+      a.size != b.size) {
+    return false;
+  }
+  for (std::uint32_t i = 0; i < a.size; i++) {
+    if (!isCompatible(unqualified(parameters[a.first + i]),
+                      unqualified(parameters[b.first + i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string TypeTable::toString(TypeID id,
+                                const StringInterner& strings) const {
+  // Declarators are written inside out, e.g. a pointer to an array of int is
+  // "int (*)[3]", so build the declarator part from the outermost type in.
+  std::string declarator;
+  while (true) {
+    const auto& type = types[id];
+    switch (type.kind) {
+      case TypeKind::Pointer: {
+        std::string pointer = "*";
+        if (type.qualifiers != 0) {
+          pointer += " " + qualifierSpelling(type.qualifiers);
+          pointer.pop_back();
+        }
+        declarator = pointer + declarator;
+        const auto pointee = types[type.base].kind;
+        if (pointee == TypeKind::Array || pointee == TypeKind::Function) {
+          declarator = "(" + declarator + ")";
+        }
+        id = type.base;
+        continue;
+      }
+      case TypeKind::Array:
+        declarator += "[";
+        if (type.flags == 0) declarator += std::to_string(type.count);
+        if (type.flags & TypeFlag::VariableLength) declarator += "*";
+        declarator += "]";
+        id = type.base;
+        continue;
+      case TypeKind::Function: {
+        declarator += "(";
+        const auto paramTypes = params(id);
+        for (std::size_t i = 0; i < paramTypes.size(); i++) {
+          if (i > 0) declarator += ", ";
+          declarator += toString(paramTypes[i], strings);
+        }
+        if (type.flags & TypeFlag::Variadic) {
+          declarator += paramTypes.empty() ? "..." : ", ...";
+        } else if (paramTypes.empty() && !(type.flags & TypeFlag::NoPrototype)) {
+          declarator += "void";
+        }
+        declarator += ")";
+        id = type.base;
+        continue;
+      }
+      default: {
+        std::string output = qualifierSpelling(type.qualifiers);
+        output += builtinSpelling(type.kind);
+        if (type.kind >= TypeKind::Struct) {
+          output += " ";
+          output += type.first != 0 ? strings.view(type.first)
+                                    : std::string_view("<anonymous>");
+        }
+        if (!declarator.empty()) output += " " + declarator;
+        return output;
+      }
+    }
+  }
+}
@@ -0,0 +1,135 @@
+#ifndef TPLCC_TYPES_H
+#define TPLCC_TYPES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "string-interner.h"
+
+// Types are referred to by their indices in the TypeTable.
+using TypeID = std::uint32_t;
+
+// The order of the arithmetic types follows their conversion ranks, see
+// TypeTable::rank.
+enum class TypeKind : std::uint8_t {
+  // The type of an expression that has an error, it is compatible with
+  // everything so one error doesn't cause a cascade of others.
+  Error,
+  Void,
+  Bool,
+  Char,
+  SignedChar,
+  UnsignedChar,
+  Short,
+  UnsignedShort,
+  Int,
+  UnsignedInt,
+  Long,
+  UnsignedLong,
+  LongLong,
+  UnsignedLongLong,
+  Float,
+  Double,
+  LongDouble,
+  Pointer,
+  Array,
+  Function,
+  Struct,
+  Union,
+  Enum,
+};
+
+namespace TypeFlag {
+constexpr std::uint16_t Variadic = 1 << 0;     // Function
+constexpr std::uint16_t NoPrototype = 1 << 1;  // Function
+constexpr std::uint16_t Incomplete = 1 << 0;   // Array, "int a[]"
+constexpr std::uint16_t VariableLength = 1 << 1;  // Array
+}  // namespace TypeFlag
+
+// An immutable, hash-consed type: there is exactly one Type for every
+// distinct type of a translation unit, so two TypeIDs are the same type if
+// and only if they are equal.
+struct Type {
+  TypeKind kind = TypeKind::Error;
+  std::uint8_t qualifiers = 0;
+  std::uint16_t flags = 0;
+  // Pointee, element type or return type.
+  TypeID base = 0;
+  // The length of an array, or the RecordType or EnumType node that declares
+  // a struct, union or enum.
+  std::uint32_t count = 0;
+  // Where the parameters of a function are in the parameter array, or the
+  // tag of a struct, union or enum in first.
+  std::uint32_t first = 0;
+  std::uint32_t size = 0;
+  // The type without qualifiers, itself if it has none.
+  TypeID unqualified = 0;
+};
+
+class TypeTable {
+  std::vector<Type> types;
+  std::vector<TypeID> parameters;
+  // Hashes of types to the types with that hash.
+  std::unordered_multimap<std::uint64_t, TypeID> index;
+
+ public:
+  TypeTable();
+  TypeTable(const TypeTable&) = delete;
+  TypeTable& operator=(const TypeTable&) = delete;
+
+  const Type& operator[](TypeID id) const { return types[id]; }
+  std::size_t size() const { return types.size(); }
+
+  // The unqualified arithmetic and void types have fixed IDs.
+  static constexpr TypeID builtin(TypeKind kind) {
+    return static_cast<TypeID>(kind);
+  }
+  static constexpr TypeID ERROR = static_cast<TypeID>(TypeKind::Error);
+
+  TypeID pointerTo(TypeID pointee);
+  TypeID arrayOf(TypeID element, std::uint32_t length, std::uint16_t flags = 0);
+  TypeID function(TypeID result, std::span<const TypeID> params,
+                  std::uint16_t flags = 0);
+  // A struct, union or enum, identified by the node that declares its tag.
+  TypeID tagged(TypeKind kind, NodeID decl, StringID tag);
+
+  TypeID qualified(TypeID type, std::uint8_t qualifiers);
+  TypeID unqualified(TypeID type) const { return types[type].unqualified; }
+
+  std::span<const TypeID> params(TypeID function) const {
+    const auto& type = types[function];
+    return {parameters.data() + type.first, type.size};
+  }
+
+  TypeKind kind(TypeID type) const { return types[type].kind; }
+  bool isInteger(TypeID type) const;
+  bool isSigned(TypeID type) const;
+  bool isFloating(TypeID type) const;
+  bool isArithmetic(TypeID type) const;
+  bool isScalar(TypeID type) const;
+  bool isPointer(TypeID type) const { return kind(type) == TypeKind::Pointer; }
+  bool isRecord(TypeID type) const {
+    return kind(type) == TypeKind::Struct || kind(type) == TypeKind::Union;
+  }
+
+  // The integer conversion rank, higher for the types that have more bits.
+  int rank(TypeID type) const;
+
+  // Whether two types are compatible (C99 6.2.7).
+  bool isCompatible(TypeID a, TypeID b) const;
+
+  // A readable spelling of the type for diagnostics, e.g. "const int *".
+  std::string toString(TypeID type, const StringInterner& strings) const;
+
+ private:
+  TypeID intern(const Type& type, std::span<const TypeID> params = {});
+  std::uint64_t hash(const Type& type, std::span<const TypeID> params) const;
+  bool isCompatibleFunction(const Type& a, const Type& b) const;
+};
+
+#endif
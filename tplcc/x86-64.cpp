@@ -0,0 +1,34 @@
+#include "x86-64.h"
+
+namespace X86 {
+namespace {
+constexpr const char* NAMES[4][NUMBER_OF_REGISTERS] = {
+    {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b",
+     "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"},
+    {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w",
+     "r11w", "r12w", "r13w", "r14w", "r15w"},
+    {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d",
+     "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+    {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9",
+     "r10", "r11", "r12", "r13", "r14", "r15"},
+};
+
+constexpr const char* CONDITION_SUFFIXES[] = {
+    "o", "no", "b", "ae", "e", "ne", "be", "a",
+    "s", "ns", "p", "np", "l", "ge", "le", "g",
+};
+}  // namespace
+
+const char* registerName(Register reg, std::uint32_t size) {
+  switch (size) {
+    case 1: return NAMES[0][reg];
+    case 2: return NAMES[1][reg];
+    case 4: return NAMES[2][reg];
+    default: return NAMES[3][reg];
+  }
+}
+
+const char* conditionSuffix(Condition condition) {
+  return CONDITION_SUFFIXES[static_cast<std::uint8_t>(condition)];
+}
+}  // namespace X86
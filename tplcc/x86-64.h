@@ -0,0 +1,189 @@
+#ifndef TPLCC_X86_64_H
+#define TPLCC_X86_64_H
+
+#include <array>
+#include <cstdint>
+
+// What the backend needs to know about x86-64 and the System V calling
+// convention.
+namespace X86 {
+// In the order of their encoding, so a Register is its number in ModRM and
+// REX.
+enum Register : std::uint8_t {
+  RAX,
+  RCX,
+  RDX,
+  RBX,
+  RSP,
+  RBP,
+  RSI,
+  RDI,
+  R8,
+  R9,
+  R10,
+  R11,
+  R12,
+  R13,
+  R14,
+  R15,
+};
+
+constexpr std::uint8_t NUMBER_OF_REGISTERS = 16;
+
+// The integer arguments of a call, in order. The rest are on the stack.
+constexpr std::array<Register, 6> ARGUMENT_REGISTERS{RDI, RSI, RDX,
+                                                     RCX, R8,  R9};
+
+// Kept out of register allocation for the code generators. SCRATCH breaks
+// cycles of moves (see sequentialize) and holds results that go to a spill
+// slot, TEMPORARY holds operands that can't be encoded in the instruction
+// using them, the source of a move between spill slots and the callee of
+// an indirect call.
+constexpr Register SCRATCH = R11;
+constexpr Register TEMPORARY = R10;
+
+// Preserved across calls, a function that uses one saves it.
+constexpr bool isCalleeSaved(Register reg) {
+  return reg == RBX || reg == RBP || reg == R12 || reg == R13 || reg == R14 ||
+         reg == R15;
+}
+
+// The name of a register accessed with an operand size of 1, 2, 4 or 8
+// bytes, e.g. "eax" for RAX and 4.
+const char* registerName(Register reg, std::uint32_t size);
+
+// The conditions of SETcc and Jcc, in the order of their encoding, so the
+// negation of a condition is the condition with the lowest bit flipped.
+enum class Condition : std::uint8_t {
+  Overflow,
+  NoOverflow,
+  Below,
+  AboveOrEqual,
+  Equal,
+  NotEqual,
+  BelowOrEqual,
+  Above,
+  Sign,
+  NoSign,
+  Parity,
+  NoParity,
+  Less,
+  GreaterOrEqual,
+  LessOrEqual,
+  Greater,
+};
+
+constexpr Condition negate(Condition condition) {
+  return static_cast<Condition>(static_cast<std::uint8_t>(condition) ^ 1);
+}
+
+// The suffix of SETcc and Jcc in assembly, e.g. "ge" for GreaterOrEqual.
+const char* conditionSuffix(Condition condition);
+
+// An operand of an instruction:
+//
+// - A register, accessed with the operand size of the instruction.
+// - An immediate, which has to fit in 32 bits sign-extended unless the
+//   instruction is a MOV to a register.
+// - Memory at a base register plus a displacement, or RIP-relative: at a
+//   symbol plus the displacement, or the GOT entry of a symbol.
+// - A symbol or a label as the target of a CALL or a jump. A call to a
+//   symbol the module doesn't define goes through the PLT.
+struct Operand {
+  enum class Kind : std::uint8_t {
+    None,
+    Register,
+    Immediate,
+    Memory,
+    Symbol,
+    Label
+  };
+
+  Kind kind = Kind::None;
+  Register reg = RAX;
+  // For Memory and Symbol, the symbol is in another module.
+  bool isExternal = false;
+  // The symbol of RIP-relative Memory and of Symbol, the label of Label.
+  std::uint32_t symbol = 0;
+  // The immediate, the displacement of Memory.
+  std::int64_t value = 0;
+
+  static Operand registerOperand(Register reg) {
+    return {Kind::Register, reg, false, 0, 0};
+  }
+  static Operand immediate(std::int64_t value) {
+    return {Kind::Immediate, RAX, false, 0, value};
+  }
+  static Operand memory(Register base, std::int64_t displacement) {
+    return {Kind::Memory, base, false, 0, displacement};
+  }
+  // The symbol plus the displacement, or its GOT entry if it is external.
+  static Operand ripRelative(std::uint32_t symbol, bool isExternal,
+                             std::int64_t displacement = 0) {
+    return {Kind::Memory, RAX, isExternal, symbol, displacement};
+  }
+  static Operand symbolOperand(std::uint32_t symbol, bool isExternal) {
+    return {Kind::Symbol, RAX, isExternal, symbol, 0};
+  }
+  static Operand label(std::uint32_t label) {
+    return {Kind::Label, RAX, false, label, 0};
+  }
+
+  bool isRegister(Register other) const {
+    return kind == Kind::Register && reg == other;
+  }
+  bool isRipRelative() const { return kind == Kind::Memory && symbol != 0; }
+};
+
+// The instructions the code generator uses. Label isn't one, it puts a
+// label, given by its destination, where it is.
+enum class Mnemonic : std::uint8_t {
+  Label,
+  Mov,
+  // Sign and zero extension from sourceSize to size bytes.
+  MovSX,
+  MovZX,
+  Lea,
+  Add,
+  Sub,
+  IMul,
+  And,
+  Or,
+  Xor,
+  Cmp,
+  Test,
+  // The count is an immediate or CL.
+  Shl,
+  Shr,
+  Sar,
+  Neg,
+  Not,
+  // Sign-extend RAX into RDX, CDQ or CQO.
+  SignExtendAccumulator,
+  IDiv,
+  Div,
+  SetCC,
+  Jcc,
+  Jmp,
+  Call,
+  Ret,
+  Push,
+  Pop,
+  Leave,
+  Ud2,
+};
+
+// One instruction in the order of Intel syntax: the destination is the
+// first operand, the only one of single-operand instructions.
+struct Instruction {
+  Mnemonic mnemonic = Mnemonic::Label;
+  // The operand size in bytes.
+  std::uint8_t size = 8;
+  std::uint8_t sourceSize = 0;
+  Condition condition = Condition::Overflow;
+  Operand destination;
+  Operand source{};
+};
+}  // namespace X86
+
+#endif